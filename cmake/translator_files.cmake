@@ -0,0 +1,26 @@
+# Translator core of the aarch64 build, shared with the host harness in tools/jitbench.
+# Paths are relative to the top of the source tree
+set(AARCH64_TRANSLATOR_FILES
+    src/aarch64/M68k_Translator.c
+    src/aarch64/M68k_SR.c
+    src/aarch64/M68k_Peephole.c
+    src/aarch64/M68k_Schedule.c
+    src/aarch64/M68k_BusSite.c
+    src/aarch64/M68k_Idiom.c
+    src/aarch64/M68k_MULDIV.c
+    src/aarch64/M68k_MOVE.c
+    src/aarch64/M68k_EA.c
+    src/aarch64/M68k_LINE0.c
+    src/aarch64/M68k_LINE4.c
+    src/aarch64/M68k_LINE5.c
+    src/aarch64/M68k_LINE6.c
+    src/aarch64/M68k_LINE8.c
+    src/aarch64/M68k_LINE9.c
+    src/aarch64/M68k_LINEB.c
+    src/aarch64/M68k_LINEC.c
+    src/aarch64/M68k_LINED.c
+    src/aarch64/M68k_LINEE.c
+    src/aarch64/M68k_LINEF.c
+    src/aarch64/M68k_Exception.c
+    src/aarch64/M68k_CC.c
+)
@@ -0,0 +1,170 @@
+/*
+    BusLogSave - writes the bus log of Emu68 to a file
+
+    The log is recorded by a PiStorm build of Emu68 started with bus_record=<MiB>. Its address
+    is printed at boot ("[BUSLOG] Recording to ...") and given in the bus-log property of the
+    /emu68 node of the device tree. The log stays mapped read only at that address, this tool
+    copies everything recorded so far into a file which can be replayed on the QEMU virt
+    target with scripts/run-qemu-virt-replay.sh.
+
+    Reads done by the tool itself go to the log too, the replay ends before they matter.
+
+    Usage: BusLogSave <hex address> <file>
+*/
+#include <stdint.h>
+#include <exec/execbase.h>
+#include <dos/dos.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+
+struct ExecBase *SysBase;
+struct DosLibrary *DOSBase;
+
+/* Layout of the first bytes of struct BusLogHeader, see include/buslog.h */
+#define BUSLOG_MAGIC    0x45363842
+
+struct BusLogHeader {
+    uint32_t    bl_Magic;
+    uint16_t    bl_Version;
+    uint16_t    bl_HeaderSize;
+    uint32_t    bl_LengthHi;
+    uint32_t    bl_Length;
+};
+
+static int _main(char *args);
+
+int __start(uint32_t len asm("d0"), const char *args asm("a0"))
+{
+    char cmdline[256];
+    uint32_t i;
+    int rc = RETURN_FAIL;
+
+    /* Shell arguments end with a newline and are not terminated */
+    for (i = 0; i < len && i < sizeof(cmdline) - 1 && args[i] != '\n'; i++)
+        cmdline[i] = args[i];
+    cmdline[i] = 0;
+
+    SysBase = *(struct ExecBase **)4;
+    DOSBase = (struct DosLibrary *)OpenLibrary((CONST_STRPTR)"dos.library", 36);
+    if (DOSBase == NULL)
+        return RETURN_FAIL;
+
+    rc = _main(cmdline);
+
+    CloseLibrary((struct Library *)DOSBase);
+    return rc;
+}
+
+static void put_str(const char *s)
+{
+    const char *e = s;
+
+    while (*e)
+        e++;
+    Write(Output(), (APTR)s, e - s);
+}
+
+static void put_dec(uint32_t v)
+{
+    char tmp[12];
+    int i = sizeof(tmp) - 1;
+
+    tmp[i] = 0;
+    do {
+        tmp[--i] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    put_str(&tmp[i]);
+}
+
+static int _main(char *args)
+{
+    uint32_t addr = 0;
+    int digits = 0;
+
+    while (*args == ' ')
+        args++;
+    if (args[0] == '0' && (args[1] == 'x' || args[1] == 'X'))
+        args += 2;
+
+    for (;; args++, digits++)
+    {
+        char c = *args;
+
+        if (c >= '0' && c <= '9')
+            addr = (addr << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f')
+            addr = (addr << 4) | (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            addr = (addr << 4) | (c - 'A' + 10);
+        else
+            break;
+    }
+
+    while (*args == ' ')
+        args++;
+
+    if (digits == 0 || *args == 0)
+    {
+        put_str("Usage: BusLogSave <hex address> <file>\n");
+        return RETURN_ERROR;
+    }
+
+    /* File name, optionally quoted */
+    char *name = args;
+    if (*name == '"')
+    {
+        name++;
+        for (args = name; *args && *args != '"'; args++);
+    }
+    else
+    {
+        for (args = name; *args && *args != ' '; args++);
+    }
+    *args = 0;
+
+    const struct BusLogHeader *hdr = (const struct BusLogHeader *)addr;
+
+    if (hdr->bl_Magic != BUSLOG_MAGIC)
+    {
+        put_str("No bus log at given address\n");
+        return RETURN_ERROR;
+    }
+
+    /* Length is updated by every record, take it once so the file matches the header */
+    uint32_t size = hdr->bl_HeaderSize + hdr->bl_Length;
+
+    BPTR file = Open((CONST_STRPTR)name, MODE_NEWFILE);
+    if (file == 0)
+    {
+        put_str("Cannot open output file\n");
+        return RETURN_FAIL;
+    }
+
+    int rc = RETURN_OK;
+    const uint8_t *src = (const uint8_t *)addr;
+
+    for (uint32_t done = 0; done < size; )
+    {
+        uint32_t chunk = size - done > 65536 ? 65536 : size - done;
+
+        if (Write(file, (APTR)(src + done), chunk) != (LONG)chunk)
+        {
+            put_str("Write error\n");
+            rc = RETURN_FAIL;
+            break;
+        }
+        done += chunk;
+    }
+
+    Close(file);
+
+    if (rc == RETURN_OK)
+    {
+        put_dec(size);
+        put_str(" bytes of bus log saved\n");
+    }
+
+    return rc;
+}
@@ -0,0 +1,96 @@
+/*
+    Inner loops of MemBench. Every loop moves or visits 64 bytes per iteration, d0 holds the
+    number of iterations. Only d0-d1/a0-a1 are scratch, other registers are saved.
+*/
+
+/* a0 - buffer, d0 - count of 64 byte blocks */
+    .globl _mb_read
+_mb_read:
+    movem.l d2-d7,-(sp)
+    bra.s   2f
+1:  movem.l (a0)+,d1-d7/a1
+    movem.l (a0)+,d1-d7/a1
+2:  subq.l  #1,d0
+    bcc.s   1b
+    movem.l (sp)+,d2-d7
+    rts
+
+/* a0 - buffer, d0 - count of 64 byte blocks */
+    .globl _mb_write
+_mb_write:
+    moveq   #0,d1
+    bra.s   2f
+1:  move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+    move.l  d1,(a0)+
+2:  subq.l  #1,d0
+    bcc.s   1b
+    rts
+
+/* a0 - source, a1 - destination, d0 - count of 64 byte blocks */
+    .globl _mb_copy
+_mb_copy:
+    bra.s   2f
+1:  move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+    move.l  (a0)+,(a1)+
+2:  subq.l  #1,d0
+    bcc.s   1b
+    rts
+
+/* a0 - first element of the pointer chain, d0 - count of 8 dependent loads. Returns last pointer */
+    .globl _mb_chase
+_mb_chase:
+    bra.s   2f
+1:  move.l  (a0),a0
+    move.l  (a0),a0
+    move.l  (a0),a0
+    move.l  (a0),a0
+    move.l  (a0),a0
+    move.l  (a0),a0
+    move.l  (a0),a0
+    move.l  (a0),a0
+2:  subq.l  #1,d0
+    bcc.s   1b
+    move.l  a0,d0
+    rts
+
+/*
+    Emu68 counter registers, privileged. Called through exec Supervisor(), hence the rte.
+    Encoded by hand, assemblers do not know the control register numbers
+*/
+    .globl _mb_counter
+_mb_counter:
+    .word   0x4e7a,0x00e1       /* movec CNTVALLO,d0 */
+    rte
+
+    .globl _mb_frequency
+_mb_frequency:
+    .word   0x4e7a,0x00e0       /* movec CNTFRQ,d0 */
+    rte
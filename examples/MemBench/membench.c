@@ -0,0 +1,336 @@
+/*
+    MemBench - bandwidth and latency of every memory region seen by the m68k
+
+    Runs from the AmigaOS shell on a PiStorm build of Emu68, CHIP, slow, Z2 and ROM regions
+    exist only while Kickstart is running. Every region from exec memory list is tested with
+    read, write, copy and pointer-chase loops, each under several CACR settings. Results are
+    printed as tab separated lines:
+
+        region  base  bytes  cacr  test  MiB/s  ns
+
+    MiB/s is given for read/write/copy, ns is time of one dependent load of the chase test.
+    scripts/membench-table.py turns the output into a table.
+
+    Usage: MemBench [size in KiB, default 256]
+*/
+#include <stdint.h>
+#include <exec/execbase.h>
+#include <exec/memory.h>
+#include <dos/dos.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+
+struct ExecBase *SysBase;
+struct DosLibrary *DOSBase;
+
+extern void mb_read(uint32_t count asm("d0"), void *buf asm("a0"));
+extern void mb_write(uint32_t count asm("d0"), void *buf asm("a0"));
+extern void mb_copy(uint32_t count asm("d0"), const void *src asm("a0"), void *dst asm("a1"));
+extern void *mb_chase(uint32_t count asm("d0"), void *start asm("a0"));
+extern uint32_t mb_counter();
+extern uint32_t mb_frequency();
+
+static void _main(const char *args);
+
+int __start(uint32_t len asm("d0"), const char *args asm("a0"))
+{
+    char cmdline[12];
+    uint32_t i;
+
+    /* Shell arguments end with a newline and are not terminated */
+    for (i = 0; i < len && i < sizeof(cmdline) - 1 && args[i] != '\n'; i++)
+        cmdline[i] = args[i];
+    cmdline[i] = 0;
+
+    SysBase = *(struct ExecBase **)4;
+    DOSBase = (struct DosLibrary *)OpenLibrary((CONST_STRPTR)"dos.library", 36);
+    if (DOSBase == NULL)
+        return RETURN_FAIL;
+
+    _main(cmdline);
+
+    CloseLibrary((struct Library *)DOSBase);
+    return RETURN_OK;
+}
+
+/* Minimal output, no libc */
+static char outbuf[256];
+static int outpos;
+
+static void flush()
+{
+    if (outpos)
+        Write(Output(), outbuf, outpos);
+    outpos = 0;
+}
+
+static void put_char(char c)
+{
+    outbuf[outpos++] = c;
+    if (outpos == sizeof(outbuf) || c == '\n')
+        flush();
+}
+
+static void put_str(const char *s)
+{
+    while (*s)
+        put_char(*s++);
+}
+
+static void put_dec(uint32_t v)
+{
+    char tmp[11];
+    int i = 0;
+
+    do {
+        tmp[i++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (i)
+        put_char(tmp[--i]);
+}
+
+static void put_hex(uint32_t v)
+{
+    put_str("0x");
+    for (int i = 28; i >= 0; i -= 4)
+        put_char("0123456789abcdef"[(v >> i) & 15]);
+}
+
+/* Fixed point print with given number of decimals, values of the benchmark are positive */
+static void put_fixed(double v, int decimals)
+{
+    uint32_t scale = 1;
+
+    for (int i = 0; i < decimals; i++)
+        scale *= 10;
+
+    uint32_t n = (uint32_t)(v * scale + 0.5);
+    put_dec(n / scale);
+    if (decimals)
+    {
+        uint32_t frac = n % scale;
+        put_char('.');
+        for (uint32_t d = scale / 10; d; d /= 10)
+        {
+            put_char('0' + (frac / d) % 10);
+        }
+    }
+}
+
+static uint32_t counter()
+{
+    return Supervisor((ULONG (*)())mb_counter);
+}
+
+static double tick_ns;
+
+/*
+    One test, run often enough to last at least 200ms. Returns time of single pass in ns.
+    Tick deltas are 32 bit, wrap of the counter does not matter as long as a run is shorter
+    than 2^32 ticks
+*/
+enum Test { T_READ, T_WRITE, T_COPY, T_CHASE };
+
+static double run(enum Test test, uint8_t *buf, uint32_t size)
+{
+    uint32_t passes = 1;
+    uint32_t count = test == T_CHASE ? size / 64 / 8 : size / 64;
+
+    if (test == T_COPY)
+        count /= 2;
+
+    for (;;)
+    {
+        uint32_t start = counter();
+
+        for (uint32_t i = 0; i < passes; i++)
+        {
+            switch (test)
+            {
+                case T_READ:
+                    mb_read(count, buf);
+                    break;
+                case T_WRITE:
+                    mb_write(count, buf);
+                    break;
+                case T_COPY:
+                    mb_copy(count, buf, buf + size / 2);
+                    break;
+                case T_CHASE:
+                    /* Each pass continues the cycle from where it stopped */
+                    buf = mb_chase(count, buf);
+                    break;
+            }
+        }
+
+        double ns = (double)(uint32_t)(counter() - start) * tick_ns;
+
+        if (ns >= 200000000.0 || passes >= 0x40000000)
+            return ns / passes;
+
+        passes *= 2;
+    }
+}
+
+/*
+    Pointer chain of one random cycle (Sattolo) over 64 byte slots, every load of the chase
+    depends on the previous one and next slot can not be predicted
+*/
+#define PERM(i) (*(uint32_t *)(buf + (i) * 64 + 4))
+
+static void build_chain(uint8_t *buf, uint32_t size)
+{
+    uint32_t slots = size / 64;
+    uint32_t seed = 0x12345678;
+
+    /* Permutation is kept in the second word of every slot, the first one gets the link */
+    for (uint32_t i = 0; i < slots; i++)
+        PERM(i) = i;
+
+    for (uint32_t i = slots - 1; i > 0; i--)
+    {
+        seed = seed * 1103515245 + 12345;
+        uint32_t j = (seed >> 8) % i;
+        uint32_t t = PERM(i);
+        PERM(i) = PERM(j);
+        PERM(j) = t;
+    }
+
+    /* After Sattolo shuffle i -> PERM(i) is a single cycle through all slots */
+    for (uint32_t i = 0; i < slots; i++)
+        *(uint8_t **)(buf + i * 64) = buf + PERM(i) * 64;
+}
+
+struct CacheSetting {
+    const char *name;
+    ULONG bits;
+};
+
+static const struct CacheSetting settings[] = {
+    { "off",    0 },
+    { "I",      CACRF_EnableI },
+    { "ID",     CACRF_EnableI | CACRF_EnableD },
+    { "IDCB",   CACRF_EnableI | CACRF_EnableD | CACRF_CopyBack },
+};
+
+static const ULONG cache_mask = CACRF_EnableI | CACRF_EnableD | CACRF_CopyBack;
+
+static void print_result(const char *region, void *base, uint32_t size, const char *cacr,
+                         const char *test, double mib, double ns)
+{
+    put_str(region); put_char('\t');
+    put_hex((uint32_t)base); put_char('\t');
+    put_dec(size); put_char('\t');
+    put_str(cacr); put_char('\t');
+    put_str(test); put_char('\t');
+    if (mib > 0) put_fixed(mib, 1); else put_char('-');
+    put_char('\t');
+    put_fixed(ns, 2);
+    put_char('\n');
+}
+
+static void bench(const char *region, uint8_t *buf, uint32_t size, int writable)
+{
+    ULONG old = CacheControl(0, 0);
+
+    for (unsigned s = 0; s < sizeof(settings) / sizeof(settings[0]); s++)
+    {
+        CacheControl(settings[s].bits, cache_mask);
+        CacheClearU();
+
+        double ns = run(T_READ, buf, size);
+        print_result(region, buf, size, settings[s].name, "read", size * 1000.0 / ns / 1.048576, ns);
+
+        if (!writable)
+            continue;
+
+        ns = run(T_WRITE, buf, size);
+        print_result(region, buf, size, settings[s].name, "write", size * 1000.0 / ns / 1.048576, ns);
+
+        ns = run(T_COPY, buf, size);
+        print_result(region, buf, size, settings[s].name, "copy", size / 2 * 1000.0 / ns / 1.048576, ns);
+
+        build_chain(buf, size);
+        ns = run(T_CHASE, buf, size);
+        print_result(region, buf, size, settings[s].name, "chase", 0, ns / (size / 64 / 8 * 8));
+    }
+
+    CacheControl(old, cache_mask);
+}
+
+static const char *classify(struct MemHeader *mh)
+{
+    uint32_t lower = (uint32_t)mh->mh_Lower;
+
+    if (mh->mh_Attributes & MEMF_CHIP)
+        return "CHIP";
+    if (lower >= 0x00c00000 && lower < 0x00dc0000)
+        return "SLOW";
+    if (lower >= 0x00200000 && lower < 0x00a00000)
+        return "Z2";
+    if (lower >= 0x40000000)
+        return "Z3";
+    return "FAST";
+}
+
+static void _main(const char *args)
+{
+    uint32_t size = 0;
+
+    while (*args == ' ')
+        args++;
+    while (*args >= '0' && *args <= '9')
+        size = size * 10 + *args++ - '0';
+    if (size == 0)
+        size = 256;
+    size *= 1024;
+
+    tick_ns = 1000000000.0 / (double)Supervisor((ULONG (*)())mb_frequency);
+
+    put_str("# region\tbase\tbytes\tcacr\ttest\tMiB/s\tns\n");
+
+    /* Take the buffers first, exec list must not change while it is walked */
+    struct { const char *name; uint8_t *buf; struct MemHeader *mh; } regions[16];
+    int nregions = 0;
+
+    Forbid();
+    for (struct Node *n = SysBase->MemList.lh_Head; n->ln_Succ && nregions < 16; n = n->ln_Succ)
+    {
+        struct MemHeader *mh = (struct MemHeader *)n;
+        uint8_t *buf = Allocate(mh, size + 64);
+
+        if (buf == NULL)
+        {
+            put_str("# ");
+            put_str(classify(mh));
+            put_str(" at ");
+            put_hex((uint32_t)mh->mh_Lower);
+            put_str(" skipped, not enough free memory\n");
+            continue;
+        }
+
+        regions[nregions].name = classify(mh);
+        regions[nregions].buf = buf;
+        regions[nregions].mh = mh;
+        nregions++;
+    }
+    Permit();
+
+    for (int i = 0; i < nregions; i++)
+    {
+        /* 64 byte alignment, one slot of the chase is then one cache line */
+        uint8_t *buf = (uint8_t *)(((uint32_t)regions[i].buf + 63) & ~63);
+        bench(regions[i].name, buf, size, 1);
+    }
+
+    bench("ROM", (uint8_t *)0x00f80000, size > 0x80000 ? 0x80000 : size, 0);
+
+    Forbid();
+    for (int i = 0; i < nregions; i++)
+        Deallocate(regions[i].mh, regions[i].buf, size + 64);
+    Permit();
+
+    flush();
+}
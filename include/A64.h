@@ -38,6 +38,14 @@
 
 #define REG_PROTECT ((1 << 30) | (1 << (REG_A0)) | (1 << (REG_A1)) | (1 << (REG_A2)) | (1 << (REG_A3)) | (1 << (REG_A4)) | (1 << (REG_PC)))
 
+/*
+    Registers a helper called from JIT code may change, for RA_GetCallSaveMask. Helpers in C follow
+    AAPCS64. Lean helpers, written in assembly, may change x0-x3 and LR only. The allocator never
+    hands out x0-x3, so calling a lean helper needs LR saved and nothing more
+*/
+#define CALL_CLOBBER_AAPCS  ((1 << 30) | 0x7ffff)
+#define CALL_CLOBBER_LEAN   ((1 << 30) | 0xf)
+
 #define REG_FP0   8
 #define REG_FP1   9
 #define REG_FP2   10
@@ -47,6 +55,9 @@
 #define REG_FP6   14
 #define REG_FP7   15
 
+#define PRFM_PLDL1STRM  0x01
+#define PRFM_PLDL2KEEP  0x02
+
 #define A64_CC_EQ 0x00 /* Z=1 */
 #define A64_CC_NE 0x01 /* Z=0 */
 #define A64_CC_CS 0x02 /* C=1 */
@@ -91,6 +102,7 @@
 #define MMU_ATTR(x)     (((x) & 7) << 2)
 #define MMU_DIR         0x003
 #define MMU_PAGE        0x001
+#define MMU_CONTIGUOUS  (1ULL << 52)
 
 #define ATTR_DEVICE_nGnRnE  0x00
 #define ATTR_DEVICE_nGnRE   0x04
@@ -176,6 +188,7 @@ static inline uint32_t sys(uint8_t rt, uint8_t op1, uint8_t cn, uint8_t cm, uint
 static inline uint32_t sysl(uint8_t rt, uint8_t op1, uint8_t cn, uint8_t cm, uint8_t op2) { ASSERT_REG(rt); return I32(0xd5280000 | ((op1 & 7) << 16) | ((op2 & 7) << 5) | ((cn & 15) << 12) | ((cm & 15) << 8) | (rt & 31)); }
 static inline uint32_t dc_ivac(uint8_t rt) { ASSERT_REG(rt); return sys(rt, 0, 7, 6, 1); }
 static inline uint32_t dc_civac(uint8_t rt) { ASSERT_REG(rt); return sys(rt, 3, 7, 14, 1); }
+static inline uint32_t prfm(uint8_t rn, uint8_t op, uint16_t offset15) { ASSERT_REG(rn); return I32(0xf9800000 | (op & 31) | ((rn & 31) << 5) | (((offset15 >> 3) & 0xfff) << 10)); }
 static inline uint32_t dsb_sy() { return I32(0xd5033f9f); }
 static inline uint32_t dmb_ish() { return I32(0xd5033bbf); }
 static inline uint32_t nop() { return I32(0xd503201f); }
@@ -278,6 +291,12 @@ static inline uint32_t stlxrb(uint8_t rn, uint8_t rt, uint8_t rs) { ASSERT_REG(r
 static inline uint32_t stlxp(uint8_t rn, uint8_t rt, uint8_t rt2, uint8_t rs) { ASSERT_REG(rt); ASSERT_REG(rt2); ASSERT_REG(rn); ASSERT_REG(rs); return I32(0x88208000 | ((rs & 31) << 16) | ((rt2 & 31) << 10) | ((rn & 31) << 5) | (rt & 31)); } 
 static inline uint32_t stlxp64(uint8_t rn, uint8_t rt, uint8_t rt2, uint8_t rs) { ASSERT_REG(rt); ASSERT_REG(rt2); ASSERT_REG(rn); ASSERT_REG(rs); return I32(0xc8208000 | ((rs & 31) << 16) | ((rt2 & 31) << 10) | ((rn & 31) << 5) | (rt & 31)); } 
 
+/* LSE atomics (ARMv8.1), acquire and release semantics */
+static inline uint32_t casal(uint8_t rn, uint8_t rs, uint8_t rt) { ASSERT_REG(rt); ASSERT_REG(rn); ASSERT_REG(rs); return I32(0x88e0fc00 | ((rs & 31) << 16) | ((rn & 31) << 5) | (rt & 31)); }
+static inline uint32_t casalh(uint8_t rn, uint8_t rs, uint8_t rt) { ASSERT_REG(rt); ASSERT_REG(rn); ASSERT_REG(rs); return I32(0x48e0fc00 | ((rs & 31) << 16) | ((rn & 31) << 5) | (rt & 31)); }
+static inline uint32_t casalb(uint8_t rn, uint8_t rs, uint8_t rt) { ASSERT_REG(rt); ASSERT_REG(rn); ASSERT_REG(rs); return I32(0x08e0fc00 | ((rs & 31) << 16) | ((rn & 31) << 5) | (rt & 31)); }
+static inline uint32_t ldsetalb(uint8_t rn, uint8_t rs, uint8_t rt) { ASSERT_REG(rt); ASSERT_REG(rn); ASSERT_REG(rs); return I32(0x38e03000 | ((rs & 31) << 16) | ((rn & 31) << 5) | (rt & 31)); }
+
 /* Load/Store pair */
 static inline uint32_t ldp(uint8_t rn, uint8_t rt1, uint8_t rt2, int16_t imm) { ASSERT_REG(rn); ASSERT_REG(rt1); ASSERT_REG(rt2); return I32(0x29400000 | (rt1 & 31) | ((rt2 & 31) << 10) | ((rn & 31) << 5) | (((imm / 4) & 0x7f) << 15)); }
 static inline uint32_t ldpsw(uint8_t rn, uint8_t rt1, uint8_t rt2, int16_t imm) { ASSERT_REG(rn); ASSERT_REG(rt1); ASSERT_REG(rt2); return I32(0x69400000 | (rt1 & 31) | ((rt2 & 31) << 10) | ((rn & 31) << 5) | (((imm / 4) & 0x7f) << 15)); }
@@ -469,6 +488,10 @@ static inline uint32_t csinc(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t cond) {
 static inline uint32_t csinc64(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t cond) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x9a800400 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16) | ((cond & 15) << 12)); }
 static inline uint32_t csinv(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t cond) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x5a800000 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16) | ((cond & 15) << 12)); }
 static inline uint32_t csinv64(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t cond) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0xda800000 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16) | ((cond & 15) << 12)); }
+static inline uint32_t csneg(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t cond) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x5a800400 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16) | ((cond & 15) << 12)); }
+static inline uint32_t csneg64(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t cond) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0xda800400 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16) | ((cond & 15) << 12)); }
+static inline uint32_t cneg(uint8_t rd, uint8_t rn, uint8_t cond) { return csneg(rd, rn, rn, cond ^ 1); }
+static inline uint32_t cneg64(uint8_t rd, uint8_t rn, uint8_t cond) { return csneg64(rd, rn, rn, cond ^ 1); }
 static inline uint32_t csetm(uint8_t rd, uint8_t cond) { return csinv(rd, 31, 31, cond ^ 1); }
 static inline uint32_t csetm64(uint8_t rd, uint8_t cond) { return csinv64(rd, 31, 31, cond ^ 1); }
 static inline uint32_t cset(uint8_t rd, uint8_t cond) { return csinc(rd, 31, 31, cond ^ 1); }
@@ -527,6 +550,8 @@ static inline uint32_t umaddl(uint8_t rd, uint8_t ra, uint8_t rn, uint8_t rm) {
 static inline uint32_t umsubl(uint8_t rd, uint8_t ra, uint8_t rn, uint8_t rm) { ASSERT_REG(rd); ASSERT_REG(ra); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x9ba08000 | (rd & 31) | ((rn & 31) << 5) | ((ra & 31) << 10) | ((rm & 31) << 16)); }
 static inline uint32_t umnegl(uint8_t rd, uint8_t rn, uint8_t rm) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return umsubl(rd, 31, rn, rm); }
 static inline uint32_t umull(uint8_t rd, uint8_t rn, uint8_t rm) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return umaddl(rd, 31, rn, rm); }
+static inline uint32_t smulh(uint8_t rd, uint8_t rn, uint8_t rm) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x9b407c00 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16)); }
+static inline uint32_t umulh(uint8_t rd, uint8_t rn, uint8_t rm) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x9bc07c00 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16)); }
 
 /* Data processing: divide */
 static inline uint32_t sdiv(uint8_t rd, uint8_t rn, uint8_t rm) { ASSERT_REG(rd); ASSERT_REG(rn); ASSERT_REG(rm); return I32(0x1ac00c00 | (rd & 31) | ((rn & 31) << 5) | ((rm & 31) << 16)); }
@@ -587,6 +612,8 @@ static inline uint32_t fmdxr(uint8_t v_dst, uint8_t src) { return mov_reg_to_sim
 static inline uint32_t fmrs(uint8_t dst, uint8_t v_src) { return mov_simd_to_reg(dst, v_src, TS_S, 0); }
 static inline uint32_t fmov_from_reg(uint8_t v_dst, uint8_t src) { return I32(0x9e670000 | (v_dst & 31) | ((src & 31) << 5)); }
 
+static inline uint32_t fmaddd(uint8_t v_dst, uint8_t v_first, uint8_t v_second, uint8_t v_add) { return I32(0x1f400000 | (v_dst & 31) | ((v_first & 31) << 5) | ((v_add & 31) << 10) | ((v_second & 31) << 16)); }
+static inline uint32_t fmsubd(uint8_t v_dst, uint8_t v_first, uint8_t v_second, uint8_t v_sub) { return I32(0x1f408000 | (v_dst & 31) | ((v_first & 31) << 5) | ((v_sub & 31) << 10) | ((v_second & 31) << 16)); }
 static inline uint32_t fmuld(uint8_t v_dst, uint8_t v_first, uint8_t v_second) { return I32(0x1e600800 | (v_dst & 31) | ((v_first & 31) << 5) | ((v_second & 31) << 16)); }
 static inline uint32_t fnegd(uint8_t v_dst, uint8_t v_src) { return I32(0x1e614000 | (v_dst & 31) | ((v_src & 31) << 5)); }
 static inline uint32_t fsqrtd(uint8_t v_dst, uint8_t v_src) { return I32(0x1e61c000 | (v_dst & 31) | ((v_src & 31) << 5)); }
@@ -632,6 +659,14 @@ static inline uint32_t frint64z(uint8_t v_dst, uint8_t v_src) { return I32(0x1e6
 
 static inline uint32_t vadd_2d(uint8_t v_dst, uint8_t v_rn, uint8_t v_rm) { return I32(0x4ee08400 | (v_dst & 31) | ((v_rn & 31) << 5) | ((v_rm & 31) << 16)); }
 
+/* 128-bit integer vector operations, size is log2 of the element size in bytes */
+static inline uint32_t vadd_q(uint8_t v_dst, uint8_t v_rn, uint8_t v_rm, uint8_t size) { return I32(0x4e208400 | ((size & 3) << 22) | (v_dst & 31) | ((v_rn & 31) << 5) | ((v_rm & 31) << 16)); }
+static inline uint32_t vsub_q(uint8_t v_dst, uint8_t v_rn, uint8_t v_rm, uint8_t size) { return I32(0x6e208400 | ((size & 3) << 22) | (v_dst & 31) | ((v_rn & 31) << 5) | ((v_rm & 31) << 16)); }
+static inline uint32_t vand_q(uint8_t v_dst, uint8_t v_rn, uint8_t v_rm) { return I32(0x4e201c00 | (v_dst & 31) | ((v_rn & 31) << 5) | ((v_rm & 31) << 16)); }
+static inline uint32_t vorr_q(uint8_t v_dst, uint8_t v_rn, uint8_t v_rm) { return I32(0x4ea01c00 | (v_dst & 31) | ((v_rn & 31) << 5) | ((v_rm & 31) << 16)); }
+static inline uint32_t veor_q(uint8_t v_dst, uint8_t v_rn, uint8_t v_rm) { return I32(0x6e201c00 | (v_dst & 31) | ((v_rn & 31) << 5) | ((v_rm & 31) << 16)); }
+static inline uint32_t vdup_q(uint8_t v_dst, uint8_t rn, uint8_t size) { return I32(0x4e000c00 | ((1 << (size & 3)) << 16) | (v_dst & 31) | ((rn & 31) << 5)); }
+
 static inline uint32_t vldur(uint8_t rn, uint8_t v_rt, uint16_t imm9) { return I32(0x3cc00000 | ((rn & 31) << 5) | (v_rt & 31) | ((imm9 & 0x1ff) << 12)); }
 static inline uint32_t vldr_pcrel(uint8_t v_rt, uint32_t imm19) { return I32(0x9c000000 | (v_rt & 31) | ((imm19 & 0x7ffff) << 5)); }
 
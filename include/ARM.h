@@ -104,6 +104,7 @@ static inline uint32_t bfi_cc(uint8_t cc, uint8_t reg, uint8_t src, uint8_t lsb,
 static inline uint32_t bfi(uint8_t reg, uint8_t src, uint8_t lsb, uint8_t width) { return bfi_cc(ARM_CC_AL, reg, src, lsb, width); }
 static inline uint32_t blx_cc_reg(uint8_t cc, uint8_t reg) { return (INSN_TO_LE(0x012fff30 | (cc << 28) | reg));}
 static inline uint32_t bx_lr() { return INSN_TO_LE(0xe12fff1e); }
+static inline uint32_t bx_cc_lr(uint8_t cc) { return INSN_TO_LE(0x012fff1e | (cc << 28)); }
 static inline uint32_t clz_cc(uint8_t cc, uint8_t rd, uint8_t rm) { return INSN_TO_LE(0x016f0f10 | (cc << 28) | (rd << 12) | rm);}
 static inline uint32_t clz(uint8_t rd, uint8_t rm) { return clz_cc(ARM_CC_AL, rd, rm);}
 static inline uint32_t cmp_cc_immed(uint8_t cc, uint8_t src, uint16_t value) { src = src & 15; return INSN_TO_LE(0x03500000 | (cc << 28) | (src << 16) | value); }
@@ -221,6 +222,11 @@ static inline uint32_t orrs_reg(uint8_t dest, uint8_t src, uint8_t reg, uint8_t
 
 static inline uint32_t ldm(uint8_t rd, uint16_t registers) {return INSN_TO_LE(0xe8900000 | ((rd & 15) << 16) | registers);}
 static inline uint32_t stm(uint8_t rd, uint16_t registers) {return INSN_TO_LE(0xe8800000 | ((rd & 15) << 16) | registers);}
+static inline uint32_t ldm_wb(uint8_t rd, uint16_t registers) {return INSN_TO_LE(0xe8b00000 | ((rd & 15) << 16) | registers);}
+static inline uint32_t stm_wb(uint8_t rd, uint16_t registers) {return INSN_TO_LE(0xe8a00000 | ((rd & 15) << 16) | registers);}
+/* NEON vld1.64/vst1.64 {d_first, d_first+1}, [rn:128] */
+static inline uint32_t vld1_64x2(uint8_t d_first, uint8_t rn) {return INSN_TO_LE(0xf4200aef | ((d_first & 16) << 18) | ((rn & 15) << 16) | ((d_first & 15) << 12));}
+static inline uint32_t vst1_64x2(uint8_t d_first, uint8_t rn) {return INSN_TO_LE(0xf4000aef | ((d_first & 16) << 18) | ((rn & 15) << 16) | ((d_first & 15) << 12));}
 
 static inline uint32_t push(uint16_t registers) {return INSN_TO_LE(0xe92d0000 | registers);}
 static inline uint32_t pop(uint16_t registers) { return INSN_TO_LE(0xe8bd0000 | registers); }
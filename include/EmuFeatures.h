@@ -4,6 +4,20 @@
 #include <stdint.h>
 #include "config.h"
 
+/* Host cores with their own code generation profile */
+enum ArmCore {
+    ARM_CORE_GENERIC = 0,
+    ARM_CORE_A53,
+    ARM_CORE_A72,
+    ARM_CORE_A76,
+};
+
+/*
+    ARM_CORE and the fields following it are the code generation profile of the host core, set
+    from MIDR at boot. Loop heads are aligned to ARM_LOOP_ALIGN bytes, ARM_BRANCHLESS_FLAGS
+    prefers data dependencies over short forward branches when flags are built from bits,
+    ARM_SCHEDULE reorders the code of every m68k instruction for an in-order pipeline
+*/
 typedef struct {
     uint8_t ARM_SUPPORTS_DIV;
     uint8_t ARM_SUPPORTS_BITFLD;
@@ -11,8 +25,21 @@ typedef struct {
     uint8_t ARM_SUPPORTS_SWP;
     uint8_t ARM_SUPPORTS_VDIV;
     uint8_t ARM_SUPPORTS_SQRT;
+    uint8_t ARM_SUPPORTS_LSE;
+    uint8_t ARM_SUPPORTS_RCPC;
+    uint8_t ARM_SUPPORTS_DOTPROD;
+    uint8_t ARM_CORE;
+    uint8_t ARM_LOOP_ALIGN;
+    uint8_t ARM_BRANCHLESS_FLAGS;
+    uint8_t ARM_SCHEDULE;
 } features_t;
 
+/*
+    M68K_ALLOW_UNALIGNED_FPU is used by the armhf backend only, VFP loads and stores need word
+    alignment there. AArch64 translates all accesses, FPU ones included, into plain loads and
+    stores which may be unaligned in normal memory. Accesses to the bus fault and are split by
+    the fault handler
+*/
 typedef struct {
     uint32_t M68K_TRANSLATION_DEPTH;
     uint8_t M68K_ALLOW_UNALIGNED_FPU;
@@ -31,6 +58,13 @@ static const features_t Features = {
     ARM_FEATURE_HAS_SWP,
     ARM_FEATURE_HAS_VDIV,
     ARM_FEATURE_HAS_SQRT,
+    ARM_FEATURE_HAS_LSE,
+    ARM_FEATURE_HAS_RCPC,
+    ARM_FEATURE_HAS_DOTPROD,
+    ARM_CORE_GENERIC,
+    0,
+    0,
+    0,
 };
 
 #endif
@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 
+#include "config.h"
 #include "nodes.h"
 #include "md5.h"
 #include "lists.h"
@@ -24,22 +25,128 @@ struct M68KLocalState {
     int32_t         mls_PCRel;
 };
 
+struct M68KTranslationUnit;
+
+/*
+    A chainable exit of a translation unit. Once the target of the exit is known,
+    the exit site is patched to branch directly into the target unit. The link
+    is then put on the mt_ChainIn list of the target, so that it can be reverted
+    when the target goes away
+
+    Exits with dynamic target (JMP/JSR through address register) have several
+    links, one per way. Each way is guarded by a literal holding the m68k address
+    it was chained to, ml_Guard points to it. Static exits have no guard.
+*/
+struct M68KChainLink {
+    struct Node     ml_Node;
+    struct M68KTranslationUnit * ml_Unit;
+    struct M68KTranslationUnit * ml_Target;
+    uint32_t *      ml_Site;
+    uint16_t *      ml_M68kTarget;
+    uint32_t *      ml_Guard;
+};
+
+/* Offset of patched instruction from the beginning of chainable exit */
+#define CHAIN_SITE_OFFSET   6
+#define CHAIN_LINK_LITERAL  8
+
+/* Layout of the indirect exit: patched instructions, guard literals and link literal */
+#define INDIRECT_WAYS           2
+#define INDIRECT_SITE_OFFSET    9
+#define INDIRECT_SITE_STRIDE    4
+#define INDIRECT_GUARD_OFFSET   17
+#define INDIRECT_LINK_LITERAL   20
+#define INDIRECT_GUARD_EMPTY    1     /* Odd address, never matches PC. Not 0xffffffff, the end marker */
+
+/*
+    Tier 0 unit whose entry counter expired returns its address with bit 0 set
+    instead of a link. The main loop translates it again at tier 1
+*/
+#define TIER_UP_FLAG            1
+
+/* Unit entered after a soft flush returns its address with this bit set, the main loop verifies it */
+#define GENERATION_FLAG         2
+
+/* Tier passed to the translator for code which is not stored in a unit */
+#define TIER_NO_UNIT            0xffffffff
+
+/* Layout of conditional branch learned from tier 0 profile */
+#define BRANCH_HINT_NONE        0
+#define BRANCH_HINT_NOT_TAKEN   1
+#define BRANCH_HINT_TAKEN       2
+
+/*
+    Data of translation unit used by debug dumps and statistics only. On AArch64 it is kept
+    in a pool outside of the code cache, so that the unit header takes less space in front
+    of the code.
+*/
+struct M68KUnitInfo {
+    union {
+        struct M68KLocalState * mi_LocalState;
+        struct M68KUnitInfo *   mi_NextFree;
+    };
+    uint32_t        mi_PrologueSize;
+    uint32_t        mi_EpilogueSize;
+    uint32_t        mi_Conditionals;
+    uint32_t        mi_M68kInsnCnt;
+    uint32_t        mi_ARMInsnCnt;
+    uint32_t        mi_PCMapSize;
+    uint8_t *       mi_PCMap;
+};
+
 struct M68KTranslationUnit {
-    struct Node     mt_HashNode;
     struct Node     mt_LRUNode;
+    struct Node     mt_PageNode;
+    struct Node     mt_SegmentNode;
     uint16_t *      mt_M68kAddress;
     uint16_t *      mt_M68kLow;
     uint16_t *      mt_M68kHigh;
+#ifndef __aarch64__
     uint32_t        mt_PrologueSize;
     uint32_t        mt_EpilogueSize;
     uint32_t        mt_Conditionals;
     uint32_t        mt_M68kInsnCnt;
     uint32_t        mt_ARMInsnCnt;
+#endif
     uint64_t        mt_UseCount;
+    uint64_t        mt_ClockUses;       /* mt_UseCount at the last visit of the eviction clock hand */
     uint64_t        mt_FetchCount;
     void *          mt_ARMEntryPoint;
+#ifdef __aarch64__
+    struct M68KUnitInfo *    mt_Info;
+#else
     struct M68KLocalState *  mt_LocalState;
+#endif
+    struct List     mt_ChainIn;
+    struct M68KChainLink * mt_ChainLinks;
+    uint32_t        mt_ChainCount;
+    uint32_t        mt_TableSlot;
+    uint32_t        mt_Tier;
+    uint32_t        mt_TierCount;
+    uint32_t        mt_SideExits;
+#if EMU68_BRANCH_PROFILE
+    uint32_t        mt_BranchPC[EMU68_BRANCH_PROFILE_SLOTS];     /* Bit 0 set if taken direction is inline */
+    uint32_t        mt_BranchExits[EMU68_BRANCH_PROFILE_SLOTS];
+#endif
+#if EMU68_SUPERBLOCKS
+    uint32_t        mt_ExitTarget;      /* Static target of the final jump if all exits are counted, 0 otherwise */
+#endif
+    uint32_t        mt_Protected;
+    uint32_t        mt_Immutable;       /* Translated from read-only ROM copy, never verified nor invalidated */
+#if EMU68_BUS_SITES
+    uint32_t        mt_Stale;           /* Translation is outdated although m68k code has not changed */
+#endif
+    uint32_t        mt_Generation;
     uint32_t        mt_CRC32;
+#if EMU68_UNIT_CRC_PAGES
+    uint32_t        mt_PageCRC[EMU68_UNIT_CRC_PAGES];
+    uint16_t        mt_PageCount;       /* 0 if the unit spans more pages, full checksum is used then */
+    uint16_t        mt_DirtyPages;      /* Pages which may have changed since translation */
+#endif
+#if EMU68_LAZY_RETUNE
+    uint32_t        mt_Control;         /* JITCTRL and JITCTRL2 the unit was translated with */
+    uint32_t        mt_Control2;
+#endif
     uint32_t        mt_ARMCode[]
 #ifdef __aarch64__
     __attribute__((aligned(64)));
@@ -48,6 +155,75 @@ struct M68KTranslationUnit {
 #endif
 };
 
+/*
+    Line of the unit lookup table. Each line holds m68k addresses and entry
+    points of up to UNIT_LINE_SLOTS units, so that a hit costs a single cache
+    line. Empty slots have address set to UNIT_SLOT_EMPTY (an odd address
+    never starts a translation unit). ul_Overflow counts units with home line
+    at or before this one, which were placed behind it. If it is zero the
+    lookup can stop here.
+*/
+#define UNIT_LINE_SLOTS     5
+#define UNIT_SLOT_EMPTY     0xffffffff
+
+struct M68KUnitLine {
+    uint32_t        ul_M68kAddress[UNIT_LINE_SLOTS];
+    uint32_t        ul_Overflow;
+    void *          ul_Entry[UNIT_LINE_SLOTS];
+} __attribute__((aligned(64)));
+
+#ifdef __aarch64__
+/* Get translation unit from its (possibly poisoned) entry point */
+static inline struct M68KTranslationUnit *M68K_UnitFromEntry(void *entry)
+{
+    uintptr_t e = (uintptr_t)entry;
+
+    e |= 0xff00000000000000ULL;     // Fix the topmost bits
+    e &= ~0x0000001000000000ULL;    // Clear the executable region bit
+
+    return (struct M68KTranslationUnit *)(e - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+}
+#endif
+
+/*
+    Instruction decoded once per translation. di_Target is the branch target if known,
+    di_LocalState the last local state entry emitted for the instruction or -1. Fields
+    past di_LocalState belong to the condition code liveness analysis.
+*/
+#define DI_FLOW_NEXT        0   /* Not a branch */
+#define DI_FLOW_JUMP        1   /* BRA, BSR, JMP or JSR to di_Target */
+#define DI_FLOW_COND        2   /* Bcc to di_Target or next instruction */
+#define DI_FLOW_UNKNOWN     3   /* Any other branch, target not known */
+
+struct M68KDecodedInsn {
+    uint16_t *      di_PC;
+    uint16_t *      di_Target;
+    uint16_t        di_Opcode;
+    uint8_t         di_Length;
+    uint8_t         di_Flow;
+    uint8_t         di_SRSets;
+    uint8_t         di_SRNeeds;
+    int16_t         di_LocalState;
+    uint8_t         di_LiveOut;
+    uint8_t         di_State;
+    uint16_t        di_Slot;
+    uint16_t        di_Succ[2];
+};
+
+/* Entry of the jump cache, indexed by low bits of m68k PC */
+struct M68KJumpCacheEntry {
+    uint32_t        jc_M68kAddress;
+    uint32_t        jc_Pad;
+    void *          jc_Entry;
+};
+
+/* Entry of the runtime shadow stack, pushed by BSR/JSR and popped by RTS */
+struct M68KShadowStackEntry {
+    uint32_t        ss_M68kAddress;
+    uint32_t        ss_Pad;
+    void *          ss_Entry;
+};
+
 struct M68KState
 {
     /* Integer part */
@@ -104,7 +280,13 @@ struct M68KState
     uint32_t DTT0;
     uint32_t DTT1;
 
-    /* Async IRQ part */
+    /* FPU part in host registers is the valid one, see EMU68_LAZY_FPU */
+    uint8_t  FP_LIVE;
+
+    /*
+        Async IRQ part. Written by interrupt handlers and by the core polling IPL, it has
+        a cache line of its own so that these writes leave the lines of the emulation core alone
+    */
     union {
         struct {
             uint8_t ARM;
@@ -113,16 +295,32 @@ struct M68KState
             uint8_t RESET;
         } INT;
         uint32_t INT32;
-    };
-    uint64_t INSN_COUNT;
+    } __attribute__((aligned(64)));
+
+    /* Read by the main loop and translated code on every dispatch */
+    uint32_t JIT_CONTROL __attribute__((aligned(64)));
+    uint32_t JIT_CONTROL2;
+    uint32_t JIT_SSTACK_TOP;
+    uint32_t JIT_FLUSH_GEN;
+    uint32_t JIT_SOFTFLUSH_THRESH;
 
+    /* Statistics, written by the emulation core only */
+    uint64_t INSN_COUNT __attribute__((aligned(64)));
     uint32_t JIT_CACHE_MISS;
+    uint32_t JIT_VICTIM_HIT;
+    uint32_t JIT_JCACHE_HIT;
+    uint32_t JIT_JCACHE_MISS;
     uint32_t JIT_UNIT_COUNT;
     uint32_t JIT_CACHE_TOTAL;
     uint32_t JIT_CACHE_FREE;
-    uint32_t JIT_SOFTFLUSH_THRESH;
-    uint32_t JIT_CONTROL;
-    uint32_t JIT_CONTROL2;
+    uint32_t JIT_CACHE_PINNED;
+
+    /* Time of the first and of the last pass of a polling loop, see EMU68_IDLE_WAIT */
+    uint64_t IDLE_START;
+    uint64_t IDLE_LAST;
+
+    struct M68KJumpCacheEntry JIT_JCACHE[EMU68_JCACHE_SIZE] __attribute__((aligned(64)));
+    struct M68KShadowStackEntry JIT_SSTACK[EMU68_SHADOW_STACK_SIZE];
 };
 
 #define JCCB_SOFT               0
@@ -145,6 +343,36 @@ struct M68KState
 #define JC2_CHIP_SLOWDOWN_RATIO_MASK    0x07
 #define JC2B_BLITWAIT                   11
 #define JC2F_BLITWAIT                   (1 << JC2B_BLITWAIT)
+#define JC2B_SMC_PROTECT                12
+#define JC2F_SMC_PROTECT                (1 << JC2B_SMC_PROTECT)
+#define JC2B_ADAPTIVE_DEPTH             13
+#define JC2F_ADAPTIVE_DEPTH             (1 << JC2B_ADAPTIVE_DEPTH)
+#define JC2B_FPU_RELAXED                14
+#define JC2F_FPU_RELAXED                (1 << JC2B_FPU_RELAXED)
+#define JC2B_PROFILE                    15
+#define JC2F_PROFILE                    (1 << JC2B_PROFILE)
+#define JC2B_PROFILE_DUMP               16
+#define JC2F_PROFILE_DUMP               (1 << JC2B_PROFILE_DUMP)
+#define JC2B_M68K_MMU                   17
+#define JC2F_M68K_MMU                   (1 << JC2B_M68K_MMU)
+#define JC2B_LOOP_PACING                18
+#define JC2F_LOOP_PACING                (1 << JC2B_LOOP_PACING)
+#define JC2B_NATIVE_CALLS               19
+#define JC2F_NATIVE_CALLS               (1 << JC2B_NATIVE_CALLS)
+#define JC2B_PREFETCH_DIST              20
+#define JC2_PREFETCH_DIST_MASK          0x0f
+#define JC2B_TRANSLATE_AHEAD            24
+#define JC2F_TRANSLATE_AHEAD            (1 << JC2B_TRANSLATE_AHEAD)
+#define JC2B_IDLE_WAIT                  25
+#define JC2F_IDLE_WAIT                  (1 << JC2B_IDLE_WAIT)
+
+/* Entry of the JIT override table, jo_Control of 0 disables it */
+struct JITOverride {
+    uint32_t    jo_Low;
+    uint32_t    jo_High;
+    uint32_t    jo_Control;
+    uint32_t    jo_Pad;
+};
 
 #define DCB_VERBOSE 0
 #define DCB_VERBOSE_MASK 0x3
@@ -394,6 +622,20 @@ uint32_t *EMIT_HookSpecialLoad(uint32_t *ptr, uint8_t size, uint8_t addr_reg, ui
 uint32_t *EMIT_HookSpecialStore(uint32_t *ptr, uint8_t size, uint8_t addr_reg, uint8_t value_reg);
 uint32_t *EMIT_Exception(uint32_t *ptr, uint16_t exception, uint8_t format, ...);
 uint32_t *EMIT_LocalExit(uint32_t *ptr, uint32_t insn_count_fixup);
+uint32_t *EMIT_ChainedExit(uint32_t *ptr, uint32_t insn_count_fixup, uint16_t *m68k_target);
+uint32_t *EMIT_ColdStub(uint32_t *start, uint32_t *end);
+uint32_t *EMIT_ColdPath(uint32_t *start, uint32_t *end, uint32_t **rejoin);
+void EMIT_Rejoin(uint32_t *branch, uint32_t *target);
+uint32_t *EMIT_PrivilegeCheck(uint32_t *ptr, uint8_t cc, uint32_t **rejoin);
+
+/*
+    Target word of a conditional exit marker. The code of the exit is entered only through the
+    single branch in front of it and may be moved to the cold section. Never a valid m68k target
+*/
+#define EXIT_COLD       1
+uint32_t *EMIT_BranchProfile(uint32_t *ptr, uint16_t *bcc, int taken_inline);
+int M68K_GetBranchHint(uint16_t *bcc);
+uint32_t *EMIT_PushReturnPrediction(uint32_t *ptr, uint16_t *ret_addr);
 uint32_t *EMIT_JumpOnCondition(uint32_t *ptr, uint8_t m68k_condition, uint32_t distance);
 
 uint32_t *EMIT_line0(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
@@ -407,6 +649,7 @@ uint32_t *EMIT_lineB(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 uint32_t *EMIT_lineC(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
 uint32_t *EMIT_lineD(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
 uint32_t *EMIT_lineE(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
+uint32_t *EMIT_ByteSwap(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
 uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
 uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
 uint32_t *EMIT_line7(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
@@ -479,19 +722,200 @@ uint32_t *EMIT_InjectDebugString(uint32_t *ptr, const char * restrict format, ..
 void M68K_PushReturnAddress(uint16_t *ret_addr);
 uint16_t *M68K_PopReturnAddress(uint8_t *success);
 void M68K_ResetReturnStack();
+void M68K_EnterROMLeaf();
 int M68K_GetINSNLength(uint16_t *insn_stream);
+int M68K_DecodeINSNLength(uint16_t *insn_stream);
 int M68K_IsBranch(uint16_t *insn_stream);
+int M68K_IsLeafRoutine(uint16_t *insn_stream, int budget);
 
 uint8_t EMIT_TestCondition(uint32_t **pptr, uint8_t m68k_condition);
 uint8_t EMIT_TestFPUCondition(uint32_t **pptr, uint8_t m68k_condition);
 uint8_t M68K_GetSRMask(uint16_t *m68k_stream);
+void M68K_ResetCCRLiveness();
+struct M68KDecodedInsn *M68K_DecodeInsn(uint16_t *pc);
+uint32_t M68K_DelayLoopCycles(uint16_t *target, uint16_t *branch);
+uint32_t *EMIT_LoopPacing(uint32_t *ptr, uint32_t cycles);
+int M68K_IsIdleLoop(uint16_t *head, uint32_t insns);
+uint32_t *EMIT_IdleWait(uint32_t *ptr);
+uint32_t *M68K_Peephole(uint32_t *start, uint32_t *end, uint8_t ctx);
+void M68K_Schedule(uint32_t *start, uint32_t *end);
+uint32_t *EMIT_BlockIdiom(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
+uint32_t *M68K_EmitINSN(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
+uint8_t M68K_GetSRLiveOut(uint16_t *insn_stream);
+
+/* Source of the condition for a Bcc fused with preceding test or compare */
+#define FUSED_NONE      0
+#define FUSED_ADDS      1   /* Host NZCV set by adds/cmn, m68k C and V are zero */
+#define FUSED_SUBS      2   /* Host NZCV set by subs/cmp, host C is inverted m68k C */
+#define FUSED_ZERO      3   /* Register compared against zero, EQ and NE only */
+
+int M68K_CanFuseBcc(uint16_t *bcc, uint8_t sets, uint8_t kind);
+uint32_t *EMIT_FusedBcc(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed, uint8_t kind, uint8_t reg);
 void M68K_InitializeCache();
 struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *ptr);
 void *M68K_TranslateNoCache(uint16_t *m68kcodeptr);
+#if EMU68_FIRST_RUN
+extern struct M68KTranslationUnit first_run_unit;
+#endif
+#if EMU68_TRACE_CACHE
+void *M68K_GetTraceUnit(uint16_t *m68kcodeptr);
+extern int m68k_single_step;            /* Translation of one instruction, no fusion or lookahead */
+#endif
 struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit);
+void M68K_FreeUnit(struct M68KTranslationUnit *unit);
+void M68K_ReleaseUnitCode(struct M68KTranslationUnit *unit);
+uintptr_t M68K_GetCacheFree();
+uintptr_t M68K_GetCacheTotal();
+uintptr_t M68K_GetCachePinned();
+void M68K_SetEntryPoint(struct M68KTranslationUnit *unit, void *entry);
+void M68K_PoisonUnit(struct M68KTranslationUnit *unit);
+void M68K_ResetUnitTable();
+void M68K_ResetJumpCache();
+void M68K_UnchainUnit(struct M68KTranslationUnit *unit);
+void M68K_ChainUnits(struct M68KChainLink *link, struct M68KTranslationUnit *target);
+struct M68KTranslationUnit *M68K_PromoteUnit(struct M68KTranslationUnit *unit);
+void M68K_LockTranslator();
+void M68K_UnlockTranslator();
+void M68K_DiscardPendingUnits();
+void M68K_TranslationWorker();
+void M68K_AddROMRange(uint32_t base, uint32_t size);
+int M68K_IsROMUnit(struct M68KTranslationUnit *unit);
+int M68K_IsROMCode(uint16_t *address);
+int M68K_HandleCodeWrite(uintptr_t fault_addr);
+void M68K_HostWrite(uintptr_t start, uintptr_t end, int remote);
+
+/* m68k memory for host code, through the -4GB shadow of the kernel table showing the physical space */
+#define M68K_PTR(a) ((uint8_t *)(0xffffffff00000000ULL + (uintptr_t)(a)))
+
+void M68K_InvalidateRange(uintptr_t start, uintptr_t end);
+void M68K_ReleaseRAMUnits(int cause);
+void M68K_RecordProfile();
+void M68K_WarmReset(struct M68KState *ctx);
+void M68K_ResetOverlay();
+void M68K_ChipWritten(uint32_t addr, uint32_t size);
+void M68K_RaiseARMInt();
+void M68K_RevalidateUnit(struct M68KTranslationUnit *unit);
+
+#if EMU68_LAZY_RETUNE
+extern struct JITOverride jit_overrides[EMU68_JIT_OVERRIDES];
+extern uint32_t jit_override_select;    /* Entry of jit_overrides accessed through JITOVR* */
+extern uint32_t jit_soft_flush_gen;     /* JIT_FLUSH_GEN set by the last soft flush */
+#endif
+uint16_t *M68K_GetFaultPC(uint64_t arm_pc);
+#if EMU68_LAZY_FPU
+void M68K_SyncFPUContext(struct M68KState *ctx);
+#endif
+void M68K_MarkBusSite(uint64_t arm_pc);
+int M68K_AddBusSite(uint16_t *m68k_pc, uint32_t opcode);
+uint32_t *M68K_PatchBusSites(uint32_t *start, uint32_t *end, uint16_t *m68k_pc);
+int M68K_IsBusAddress(uint32_t address);
+uint32_t *EMIT_BusAccess(uint32_t *ptr);
+void SYSBusTrampoline();
 void M68K_DumpStats();
+#if EMU68_JIT_EXPORT
+extern uint32_t jit_export_count;       /* Units written by the last JIT export */
+
+void M68K_ExportUnits(uint32_t min_uses);
+#endif
+uint32_t M68K_ResolveCodeAddress(uint64_t arm_pc, uint32_t *m68k_pc);
+uint32_t M68K_CodeDensity(uint64_t arm_pc);
+
+#if EMU68_M68K_MMU
+extern uint8_t m68k_mmu_enabled;        /* TC.E set, lower address space is the translated one */
+
+void M68K_MMUUpdate(uint32_t unused, uint32_t unused2);
+void M68K_MMUFlush(uint32_t address, uint32_t opmode);
+void M68K_MMUTest(uint32_t address, uint32_t write);
+void M68K_MMUReset();
+int M68K_MMUFault(uint64_t far, int write);
+int M68K_MMUBusAddress(uint64_t *far, int write);
+uint64_t M68K_MMUPhysical(uint64_t far);
+void M68K_RecheckRange(uintptr_t start, uintptr_t end);
+void M68K_RecheckUnits();
+uint32_t *EMIT_MMUCall(uint32_t *ptr, void (*func)(uint32_t, uint32_t), uint8_t reg, uint32_t arg);
+#endif
+void M68K_ProfilerTask();
 uint8_t M68K_GetCC(uint32_t **ptr);
 uint8_t M68K_ModifyCC(uint32_t **ptr);
 void M68K_FlushCC(uint32_t **ptr);
 
+#if EMU68_ASYNC_INT && defined(__aarch64__)
+/* SGI telling the emulation core that INT may have changed */
+#define INT_SIGNAL_SGI  1
+
+/* SGI asking the emulation core for the address it runs at, see M68k_Profiler.c */
+#define INT_PROFILE_SGI 2
+
+/* GIC CPU interface of the emulation core, set once changes of INT are signalled by SGI */
+extern volatile uint8_t *int_signal_gicc;
+
+/* INT may have changed, chained exits and inner loops leave to the main loop */
+static inline void M68K_SignalINT()
+{
+    asm volatile("mov v29.s[3], wzr");
+}
+#endif
+
+#if EMU68_PROFILER
+/* Filled by the SGI handler of the emulation core, ps_Seq is advanced last */
+struct ProfileSample {
+    uint64_t    ps_ARM;
+    uint64_t    ps_PC;
+    uint64_t    ps_Seq;
+    uint64_t    ps_Retired;     /* PMU event counter 4, ARM instructions retired */
+};
+
+extern volatile struct ProfileSample prof_sample;
+extern volatile uint32_t prof_mirror_pc;
+#endif
+
+#if defined(PISTORM) && PISTORM_STOP_WAKE
+/*
+    Highest IPL level the sleeping STOP ignores, 0xff while no STOP waits. The housekeeper stores
+    the CNTPCT of the event it sent into m68k_stop_event, the main loop clears it
+*/
+extern volatile uint8_t m68k_stop_level;
+extern volatile uint64_t m68k_stop_event;
+#endif
+
+#if EMU68_LOOP_PREFETCH
+/* Masks of A0-A6 used with (An)+ and -(An) by the unit being translated */
+extern uint8_t loop_stride_inc;
+extern uint8_t loop_stride_dec;
+#endif
+
+#if EMU68_INSN_COUNTER
+/* Exits of translated code add to the instruction counter. Cleared in sampled mode */
+extern uint8_t insn_count_precise;
+#if EMU68_INSN_COUNTER_SAMPLED
+extern volatile uint64_t insn_count_sampled;
+void M68K_InsnSampleInit();
+#endif
+#endif
+
+#if EMU68_PMU_PROFILE
+/* Counters: cycles, L1I refill, L1D refill, branch mispredict, L1D TLB refill */
+#define PMU_COUNTERS    5
+
+struct PMUSlot {
+    uint32_t    pu_Address;
+    uint32_t    pu_Entries;
+    uint64_t    pu_Count[PMU_COUNTERS];
+};
+
+/* pp_Select picks the entry of pp_Top read through PMUADDR..PMUDTLB control registers */
+struct PMUProfile {
+    uint32_t            pp_Select;
+    uint32_t            pp_Dropped;
+    struct PMUSlot *    pp_Top[EMU68_PMU_TOP];
+    struct PMUSlot      pp_Slots[EMU68_PMU_SLOTS];
+};
+
+extern int pmu_profile;
+extern struct PMUProfile pmu_state;
+
+void PMU_Init();
+void PMU_Dump();
+#endif
+
 #endif /* _M68K_H */
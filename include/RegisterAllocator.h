@@ -35,6 +35,7 @@ void RA_RemoveM68kRegister(uint32_t **arm_stream, uint8_t m68k_reg);
 void RA_DiscardM68kRegister(uint32_t **arm_stream, uint8_t m68k_reg);
 void RA_FlushM68kRegs(uint32_t **arm_stream);
 void RA_StoreDirtyM68kRegs(uint32_t **arm_stream);
+void RA_PinM68kRegisters(uint32_t **arm_stream, uint16_t mask);
 
 uint16_t RA_GetChangedMask();
 void RA_ClearChangedMask();
@@ -52,6 +53,7 @@ uint8_t RA_MapM68kRegisterForWrite(uint32_t **arm_stream, uint8_t m68k_reg);
 void RA_UnmapM68kRegister(uint32_t **arm_stream, uint8_t m68k_reg);
 uint8_t RA_CopyFromM68kRegister(uint32_t **arm_stream, uint8_t m68k_reg);
 uint16_t RA_GetTempAllocMask();
+uint32_t RA_GetCallSaveMask(uint32_t clobber);
 
 void RA_ResetFPUAllocator();
 uint8_t RA_AllocFPURegister(uint32_t **arm_stream);
@@ -65,6 +67,8 @@ void RA_StoreDirtyFPURegs(uint32_t **arm_stream);
 uint8_t RA_TryCTX(uint32_t **ptr);
 uint8_t RA_GetCTX(uint32_t **ptr);
 void RA_FlushCTX(uint32_t **ptr);
+uint8_t RA_GetConstBase(uint32_t **ptr, uint32_t address, int32_t *offset);
+void RA_FlushConstBase(uint32_t **ptr);
 int RA_IsCCLoaded();
 int RA_IsCCModified();
 uint8_t RA_GetCC(uint32_t **ptr);
@@ -79,6 +83,28 @@ uint8_t RA_GetFPSR(uint32_t **ptr);
 uint8_t RA_ModifyFPSR(uint32_t **ptr);
 void RA_FlushFPSR(uint32_t **ptr);
 void RA_StoreFPSR(uint32_t **ptr);
+void RA_SetFPSRResult(uint32_t **ptr, uint8_t fp);
+void RA_ResolveFPSR(uint32_t **ptr);
+void RA_DiscardFPSRResult();
+
+/* Lazily loaded values kept in temporary registers */
+#define RA_VAL_CTX      1
+#define RA_VAL_CC       2
+#define RA_VAL_FPCR     4
+#define RA_VAL_FPSR     8
+
+void RA_ResetConstCache();
+void RA_BeginConstWindow(uint32_t *start);
+void RA_CommitConstWindow(uint32_t *start, uint32_t *end);
+uint8_t RA_GetCachedConst(uint32_t **ptr, uint32_t value);
+void RA_SetCachedConst(uint32_t **ptr, uint8_t reg, uint32_t value);
+uint8_t RA_GetCachedFPUConst(uint32_t **ptr, uint64_t value);
+void RA_SetCachedFPUConst(uint32_t **ptr, uint8_t reg, uint64_t value);
+
+uint8_t RA_GetHeldMask();
+uint8_t RA_GetLoadedMask();
+uint8_t RA_GetAllocPeak();
+void RA_ClearLoadedMask();
 
 uint32_t *EMIT_SaveRegFrame(uint32_t *ptr, uint32_t mask);
 uint32_t *EMIT_RestoreRegFrame(uint32_t *ptr, uint32_t mask);
@@ -12,4 +12,10 @@ struct ExpansionBoard {
     void            (*map)(struct ExpansionBoard *);
 };
 
+/* Z3 RAM board, physical RAM below top is cut off for it. Returns size taken */
+uintptr_t Z3RAM_Reserve(uintptr_t bottom, uintptr_t top);
+
+/* RAM disk board, its disk is cut off below top as well. Registers NATIVE_DISK_IO, returns size taken */
+uintptr_t RAMDisk_Reserve(uintptr_t bottom, uintptr_t top);
+
 #endif /* _BOARDS_H */
@@ -0,0 +1,79 @@
+#ifndef _BUSLOG_H
+#define _BUSLOG_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Bus log. On PiStorm every value the m68k obtains from the bus is appended to the log together
+    with the IPL level changes as seen by the main loop, timestamped with the m68k instruction
+    counter. The ROM and RAM ranges of the m68k address space are stored at the start, ranges
+    mapped later (Z2 RAM) at the position they appeared. Given as initrd to other targets the log
+    is replayed: bus reads are served from it, writes are dropped and interrupts are raised at the
+    recorded instruction count, so the m68k repeats the recorded run without an Amiga.
+
+    The log is a header followed by variable length records, all numbers are LEB128 encoded:
+
+        BLR_READ + n        read of 1 << n bytes: zigzag delta to previous address, value
+                            (16 byte reads give two values, upper half first)
+        BLR_REPEAT          count of further reads equal to the previous one
+        BLR_IPL             delta to previous instruction count, new level
+        BLR_RAM             base, size of RAM, zeroed at start
+        BLR_ROM             base, size, size bytes of contents
+*/
+
+#define BUSLOG_MAGIC        0x45363842  /* E68B */
+#define BUSLOG_VERSION      1
+
+enum BusLogRecordType {
+    BLR_READ = 0x00,        /* 0x00 - 0x04 */
+    BLR_REPEAT = 0x08,
+    BLR_IPL = 0x10,
+    BLR_RAM = 0x20,
+    BLR_ROM = 0x21,
+};
+
+struct BusLogHeader {
+    uint32_t    bl_Magic;
+    uint16_t    bl_Version;
+    uint16_t    bl_HeaderSize;
+    uint64_t    bl_Length;      /* Bytes of records following the header, updated while recording */
+    uint64_t    bl_Reads;
+    uint64_t    bl_IPLChanges;
+    uint64_t    bl_InsnCount;   /* Instruction count at the last record */
+    char        bl_BootArgs[216];
+};
+
+enum BusLogMode {
+    BUSLOG_OFF = 0,
+    BUSLOG_RECORD,
+    BUSLOG_REPLAY,
+};
+
+extern enum BusLogMode buslog_mode;
+extern uint8_t buslog_ipl;          /* Level recorded or replayed last */
+extern uint64_t buslog_next_ipl;    /* Replay: instruction count of the next level change */
+
+/* Starts recording or replay, whichever was set up, right before the m68k */
+void BusLog_Start();
+
+/* Recording, PiStorm */
+void BusLog_Configure(const char *bootargs);
+uintptr_t BusLog_Reserve(uintptr_t top);
+void BusLog_Read(int size, uint32_t address, uint64_t value, uint64_t value2);
+void BusLog_Map(uint32_t base, uint32_t size, int read_only);
+
+/* Replay, other targets */
+int BusLog_IsLog(const void *image);
+int BusLog_LoadReplay(void *image, uintptr_t size, uintptr_t *top_of_ram);
+void BusLog_ResetVectors(uint32_t *isp, uint32_t *pc);
+int BusLog_ReplayRead(uint64_t *value, uint64_t *value2, int size, uint32_t address);
+void BusLog_ReplayWrite(int size, uint32_t address);
+
+/*
+    Both, called by the main loop with the level to be taken when it differs from buslog_ipl
+    (recording) or buslog_next_ipl is reached (replay). Returns the level to use
+*/
+int BusLog_IPL(int level);
+
+#endif /* _BUSLOG_H */
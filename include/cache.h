@@ -10,16 +10,53 @@ enum CacheType
     DCACHE
 };
 
+extern uint8_t cache_coherent;
+extern uint32_t cache_dirty_lines[2];
+
+/* Coherent mode and no line written by the m68k, memory holds everything the cache would */
+static inline int cache_bypassed(enum CacheType type)
+{
+    return cache_coherent && cache_dirty_lines[type] == 0;
+}
+
 void cache_setup();
 void cache_invalidate_all(enum CacheType cache);
 void cache_invalidate_line(enum CacheType type, uint32_t address);
 void cache_invalidate_range(enum CacheType type, uint32_t address, uint32_t len);
+void cache_flush_all(enum CacheType type);
+void cache_flush_line(enum CacheType type, uint32_t address);
+void cache_flush_range(enum CacheType type, uint32_t address, uint32_t len);
 uint8_t cache_read_8(enum CacheType type, uint32_t address);
 uint16_t cache_read_16(enum CacheType type, uint32_t address);
 uint32_t cache_read_32(enum CacheType type, uint32_t address);
 uint64_t cache_read_64(enum CacheType type, uint32_t address);
 uint128_t cache_read_128(enum CacheType type, uint32_t address);
 
+/*
+    Opcode fetch of the translator. The window is resolved once per unit by cache_fetch_setup(),
+    words inside come straight from memory, everything else goes through the instruction cache.
+*/
+extern uint32_t cache_fetch_base;
+extern uint32_t cache_fetch_size;
+
+void cache_fetch_setup(uint32_t base, uint32_t size);
+
+static inline uint16_t cache_fetch_16(uint32_t address)
+{
+    if (address - cache_fetch_base < cache_fetch_size)
+        return *(uint16_t *)(uintptr_t)address;
+
+    return cache_read_16(ICACHE, address);
+}
+
+static inline uint32_t cache_fetch_32(uint32_t address)
+{
+    if (address - cache_fetch_base <= cache_fetch_size - 4)
+        return *(uint32_t *)(uintptr_t)address;
+
+    return cache_read_32(ICACHE, address);
+}
+
 int cache_write_8(enum CacheType type, uint32_t address, uint8_t data, uint8_t write_back);
 int cache_write_16(enum CacheType type, uint32_t address, uint16_t data, uint8_t write_back);
 int cache_write_32(enum CacheType type, uint32_t address, uint32_t data, uint8_t write_back);
@@ -0,0 +1,22 @@
+#ifndef _CHIPSHADOW_H
+#define _CHIPSHADOW_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    CPU-private CHIP RAM. A range of CHIP RAM declared with chip_private=<start KB>-<end KB> is
+    backed by ARM RAM, accesses of the m68k never reach the bus. Pages are mapped read-only
+    while they match CHIP RAM, the first write makes them writable and dirty. Dirty pages are
+    written back to CHIP RAM before any register write which may start DMA, so that DMA reading
+    the range sees what the m68k wrote. DMA writing into the range is not seen by the m68k.
+*/
+
+void ChipShadow_Configure(const char *bootargs);
+uintptr_t ChipShadow_Reserve(uintptr_t top);
+void ChipShadow_Map();
+int ChipShadow_Write(uint64_t far);
+void ChipShadow_CustomWrite(uint32_t far, int size);
+int ChipShadow_Overlaps(uint32_t addr, uint32_t size);
+
+#endif /* _CHIPSHADOW_H */
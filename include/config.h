@@ -13,12 +13,18 @@
 #define CACHE_SET_COUNT         128
 #define CACHE_WAY_COUNT         8
 
+/* Invalidate and flush of a range at least that large act on whole emulated cache */
+#define EMU68_CACHE_RANGE_LIMIT (64*1024)
+
 #define ARM_FEATURE_HAS_DIV     1
 #define ARM_FEATURE_HAS_BITFLD  1
 #define ARM_FEATURE_HAS_BITCNT  1
 #define ARM_FEATURE_HAS_SWP     1
 #define ARM_FEATURE_HAS_VDIV    1
 #define ARM_FEATURE_HAS_SQRT    1
+#define ARM_FEATURE_HAS_LSE     0
+#define ARM_FEATURE_HAS_RCPC    0
+#define ARM_FEATURE_HAS_DOTPROD 0
 
 #ifndef SET_FEATURES_AT_RUNTIME
 #define SET_FEATURES_AT_RUNTIME 1
@@ -44,18 +50,545 @@
 #define EMU68_WEAK_CFLUSH_LIMIT 500
 
 #define EMU68_WEAK_CFLUSH_SLOW  0
+#define EMU68_BLOCK_CHAINING    1
 #define EMU68_PC_REG_HISTORY    0
 #define EMU68_CCR_SCAN_DEPTH    20
 
+/*
+    Condition code liveness decodes at most EMU68_CCR_LIVE_NODES instructions per translation.
+    A single query explores up to CCR scan depth times EMU68_CCR_LIVE_STEP new instructions
+*/
+#define EMU68_CCR_LIVE_NODES    1024
+#define EMU68_CCR_LIVE_STEP     8
+
+/* Remove redundant context loads and constants from code emitted for every m68k instruction */
+#define EMU68_PEEPHOLE          1
+
+/* List scheduling of the same code for in-order cores, selected by the code generation profile */
+#define EMU68_SCHEDULE          1
+
+/*
+    Keep the 4K page of repeatedly used absolute addresses in a register for the rest of the
+    unit. The register is bound only while at least EMU68_CONST_BASE_MIN_FREE temporaries are free
+*/
+#define EMU68_CONST_BASE        1
+#define EMU68_CONST_BASE_MIN_FREE 5
+
+/* Translate move.l (Ax)+,(Ay)+ and clr.l (Ax)+ loops closed by dbf as block moves, simple element-wise loops with NEON */
+#define EMU68_BLOCK_IDIOMS      1
+#define EMU68_BLOCK_IDIOM_BASE  0x01000000
+
+/* Branch on host flags of TST/CMP directly if the Bcc following them is the last use of the flags */
+#define EMU68_FUSED_BRANCH      1
+
+/*
+    Bcc after CMP, TST or MOVE to Dn branches on host flags also if CCR is used later. CCR is
+    updated before the branch, none of the instructions doing that changes host NZCV
+*/
+#define EMU68_LIVE_FLAGS_BRANCH 1
+
+/*
+    Bcc skipping forward over up to EMU68_IF_CONVERSION_INSNS instructions which work on registers
+    only is translated without a branch, the changed registers are selected back with csel
+*/
+#define EMU68_IF_CONVERSION         1
+#define EMU68_IF_CONVERSION_INSNS   3
+
+/* Reuse immediates left in freed temporary registers by earlier instructions of the unit */
+#define EMU68_CONST_CACHE       1
+
+/* Keep FPU immediates and FMOVECR constants in v16-v23 for later instructions of the unit. Needs EMU68_CONST_CACHE */
+#define EMU68_FPU_CONST_CACHE   1
+
+/* Divide by immediate with reciprocal multiply, multiply by immediate 2^n or 2^n+1 with shift and add */
+#define EMU68_CONST_MULDIV      1
+
+/* FSIN, FCOS, FSINCOS, FETOX and FLOGN through leaf NEON kernels, arguments out of their range use libm */
+#define EMU68_FPU_FAST_MATH     1
+
+/* Derive FPSR condition codes from the last FP0-FP7 result only when FPSR is read or stored */
+#define EMU68_LAZY_FPSR         1
+
+/* Contract FMUL with dependent FADD/FSUB into fmadd/fmsub when JC2F_FPU_RELAXED is set in JIT_CONTROL2 */
+#define EMU68_FPU_CONTRACT      1
+
+/* FBcc directly after FCMP or FTST branches on host flags of the compare, FPSR codes only computed if read later */
+#define EMU68_FPU_FUSED_BRANCH  1
+
+/* Translate inner loops again with CC, FPCR, FPSR and context loaded once before the loop body */
+#define EMU68_LOOP_HOIST        1
+
+/* Branches back to an instruction within the unit other than its first one close a loop there, the unit is translated twice */
+#define EMU68_LOCAL_LOOPS       1
+
+/*
+    JSR to an absolute or PC-relative address and BSR from ROM continue translation in the callee
+    if it reaches RTS within EMU68_LEAF_INLINE_INSNS instructions without other control flow.
+    The return address is still pushed, RTS checks it against the call site. Callees in ROM are
+    inlined from any code, their words are left out of the checksummed range of the unit
+*/
+#define EMU68_LEAF_INLINE       1
+#define EMU68_LEAF_INLINE_INSNS 16
+
+/* Inner loops closed by DBcc check for pending interrupts every EMU68_DBCC_INT_INTERVAL (power of 2) passes */
+#define EMU68_DBCC_INT_INTERVAL 16
+
+/*
+    Where changes of INT are signalled by an IRQ to the emulation core, chained exits and
+    inner loops test a flag in lane 3 of v29 instead of loading INT from the context
+*/
+#define EMU68_ASYNC_INT         1
+
 #define EMU68_HASHSIZE          65536
 #define EMU68_HASHMASK          (EMU68_HASHSIZE - 1)
 #define EMU68_HASHSHIFT         5
 
+/* Open-addressed table mapping m68k PC to translated code, in 64-byte lines */
+#define EMU68_UNIT_TABLE_BITS   14
+#define EMU68_UNIT_TABLE_SIZE   (1 << EMU68_UNIT_TABLE_BITS)
+#define EMU68_UNIT_TABLE_MASK   (EMU68_UNIT_TABLE_SIZE - 1)
+
+/* Direct-mapped jump cache consulted by the main loop before the unit table */
+#define EMU68_JCACHE_BITS       8
+#define EMU68_JCACHE_SIZE       (1 << EMU68_JCACHE_BITS)
+#define EMU68_JCACHE_MASK       (EMU68_JCACHE_SIZE - 1)
+
+/* Runtime shadow stack of {return PC, entry point} pairs predicting RTS/RTR/RTD targets */
+#define EMU68_SHADOW_STACK      1
+#define EMU68_SHADOW_STACK_BITS 4
+#define EMU68_SHADOW_STACK_SIZE (1 << EMU68_SHADOW_STACK_BITS)
+#define EMU68_SHADOW_STACK_MASK (EMU68_SHADOW_STACK_SIZE - 1)
+
+/*
+    Tiered translation. Units are first translated with short budgets and count their
+    entries, after EMU68_TIER_THRESHOLD entries they are translated again with the
+    full JIT_CONTROL/JIT_CONTROL2 settings. Requires EMU68_BLOCK_CHAINING
+*/
+#define EMU68_TIERED_JIT        1
+#define EMU68_TIER_THRESHOLD    256
+#define EMU68_TIER0_INSN_DEPTH  32
+#define EMU68_TIER0_CCR_DEPTH   2
+
+/*
+    With JC2F_ADAPTIVE_DEPTH set, tier 0 units count conditional side exits taken. On promotion
+    the ratio of side exits to entries selects instruction depth and loop count of the tier 1
+    translation. Code invalidated EMU68_ADAPT_INVALIDATIONS times is translated shorter.
+    Hints are kept in a small table indexed by m68k address
+*/
+#define EMU68_ADAPTIVE_DEPTH    1
+#define EMU68_ADAPT_BITS        10
+#define EMU68_ADAPT_SIZE        (1 << EMU68_ADAPT_BITS)
+#define EMU68_ADAPT_MASK        (EMU68_ADAPT_SIZE - 1)
+#define EMU68_ADAPT_INVALIDATIONS 2
+#define EMU68_ADAPT_MIN_DEPTH   8
+
+/*
+    Code invalidated EMU68_ADAPT_INVALIDATIONS times by CRC mismatch or CINV is translated
+    shorter even without JC2F_ADAPTIVE_DEPTH, and its units cover only the translated
+    instructions: no 32 byte margin past them and no CCR scan beyond the unit. Variables
+    next to the code can be written without throwing the unit away. Requires EMU68_ADAPTIVE_DEPTH
+*/
+#define EMU68_SMC_SPLIT         1
+
+/*
+    Tier 0 units count how often each of their first EMU68_BRANCH_PROFILE_SLOTS Bcc instructions
+    leaves through the out-of-line direction. On promotion, a direction taken at least on every
+    second entry is remembered and tier 1 keeps it inline instead of the static guess
+*/
+#define EMU68_BRANCH_PROFILE    1
+#define EMU68_BRANCH_PROFILE_SLOTS 8
+#define EMU68_BRANCH_HINT_BITS  10
+#define EMU68_BRANCH_HINT_SIZE  (1 << EMU68_BRANCH_HINT_BITS)
+#define EMU68_BRANCH_HINT_MASK  (EMU68_BRANCH_HINT_SIZE - 1)
+
+/*
+    Tier 0 unit ending with a static jump and leaving through side exits on hardly any entry is
+    translated at tier 1 together with the code at the jump target, if the target lies within
+    EMU68_SUPERBLOCK_RANGE bytes of the unit entry. Requires EMU68_BRANCH_PROFILE
+*/
+#define EMU68_SUPERBLOCKS       1
+#define EMU68_SUPERBLOCK_RANGE  16384
+
+/*
+    Background translation on CPU1, enabled with "jit_worker" in bootargs. The emulation
+    core queues speculative and tier 1 requests, the worker builds units and hands them
+    back through a second queue. Queue sizes must be powers of two
+*/
+#define EMU68_JIT_WORKER        1
+#define EMU68_JIT_QUEUE_BITS    6
+#define EMU68_JIT_QUEUE_SIZE    (1 << EMU68_JIT_QUEUE_BITS)
+#define EMU68_JIT_QUEUE_MASK    (EMU68_JIT_QUEUE_SIZE - 1)
+
+/*
+    With JC2_TRANSLATE_AHEAD set, a unit translated on cache miss is followed by translation of
+    up to EMU68_AHEAD_BUDGET targets of its static exits lying within EMU68_AHEAD_RANGE bytes of
+    it, which the worker does not take. Code further away may be data or hardware registers
+*/
+#define EMU68_TRANSLATE_AHEAD   1
+#define EMU68_AHEAD_BUDGET      2
+#define EMU68_AHEAD_RANGE       4096
+
+/*
+    Cache maintenance of units translated back to back under one translator lock, the unit of a
+    miss and those translated ahead, is done once over the range covering all of them. Code
+    that far apart is made visible on its own instead
+*/
+#define EMU68_BATCH_CODE_SYNC   1
+#define EMU68_CODE_SYNC_GAP     4096
+
+/*
+    Units translated from read-only ROM copies survive instruction cache flushes, the
+    code they were built from cannot change
+*/
+#define EMU68_KEEP_ROM_UNITS    1
+#define EMU68_MAX_ROM_RANGES    4
+
+/*
+    Self-modifying code detection through write protection of pages holding translated
+    code. Active when JC2F_SMC_PROTECT is set in JIT_CONTROL2 ("smc_protect" in bootargs)
+*/
+#define EMU68_SMC_PROTECT       1
+
+/*
+    Units spanning up to that many 4K pages keep a checksum of each page part. Verification stops
+    at the first part which has changed, after a write to a protected page only the written parts
+    are checked. 0 disables
+*/
+#define EMU68_UNIT_CRC_PAGES    4
+
+/*
+    Soft flush of the whole cache only bumps JIT_FLUSH_GEN. Units compare it with their own
+    generation on entry and verify their checksum once if it is stale. Requires EMU68_BLOCK_CHAINING
+*/
+#define EMU68_FLUSH_GENERATION  1
+
+/*
+    Translated code lives in an arena of EMU68_ARENA_SEGMENT_SIZE segments. Units are bump
+    allocated in the current segment, when it is full a clock hand selects the next one. A
+    segment whose units were used since the last visit of the hand gets a second chance,
+    otherwise all its units are evicted. A segment has to fit the largest possible unit
+*/
+#define EMU68_CODE_ARENA        1
+#define EMU68_ARENA_SEGMENT_SIZE (1024*1024)
+
+/*
+    Translate straight into the code arena if the current segment has room for the largest
+    possible unit, the temporary buffer and the copy are used near the end of a segment only.
+    Requires EMU68_CODE_ARENA
+*/
+#define EMU68_DIRECT_TRANSLATE  1
+
+/*
+    One of 1 << EMU68_PINNED_SHIFT arena segments is pinned. Pinned segments are never
+    evicted, they take ROM code and units promoted to tier 1 while they have space
+*/
+#define EMU68_PIN_UNITS         1
+#define EMU68_PINNED_SHIFT      3
+
+/*
+    Units evicted for lack of space are copied to a ring buffer of EMU68_VICTIM_CACHE_SIZE
+    bytes in system memory, found by m68k address through EMU68_VICTIM_SLOTS entries. On a miss
+    a saved unit with unchanged m68k code is copied back into the JIT cache instead of being
+    translated again. The size may be changed with victim_cache=<KiB>, 0 disables it
+*/
+#define EMU68_VICTIM_CACHE      1
+#define EMU68_VICTIM_CACHE_SIZE (4*1024*1024)
+#define EMU68_VICTIM_SLOTS      4096
+
+/*
+    Units with memory accesses keep a delta encoded map from ARM code offset to m68k PC, so
+    that the fault handler can find the m68k instruction which has failed
+*/
+#define EMU68_PC_MAP            1
+
+/*
+    Loads and stores faulting EMU68_BUS_SITE_THRESHOLD times are remembered by m68k PC. The
+    unit is translated again with these accesses calling the bus emulation directly instead
+    of going through a data abort. Requires EMU68_PC_MAP
+*/
+#define EMU68_BUS_SITES         1
+#define EMU68_BUS_SITE_THRESHOLD 64
+#define EMU68_BUS_SITE_SLOTS    256
+
+/* Unused Z3 space is backed by one read-only block of the pattern reads of unmapped space return */
+#define EMU68_Z3_PATTERN_BLOCK  1
+
+/* Decoded integer loads and stores of the data abort handler are cached by their ARM address */
+#define EMU68_FAULT_DECODE_CACHE 1
+#define EMU68_FAULT_DECODE_SLOTS 64
+
+/*
+    Data aborts on translation faults take a short path through the vectors: only x0 to x18 and
+    x30 are saved and the access is done from the decode cache straight away. Accesses naming
+    any other register, and all other exceptions, go through SYSHandler with the full frame
+*/
+#define EMU68_FAST_DATA_ABORT   1
+
+/*
+    68040 MMU, "m68k_mmu" in bootargs, experimental. With TC.E set the lower address space gets
+    its own host tables, filled from the m68k page tables on fault and cleared by PFLUSH. Access
+    faults are reported and dropped, no access error exception is raised
+*/
+#define EMU68_M68K_MMU          1
+
+/*
+    Page table pages reserved at boot if "smc_protect" or "m68k_mmu" is given, both change the
+    host tables at run-time. The pool grows in steps of 2MB taken from the top of RAM
+*/
+#define EMU68_MMU_POOL_PAGES    1024
+
+/*
+    Per-core bins of the TLSF allocator for blocks up to 256 bytes, each size class keeps at
+    most EMU68_TLSF_BIN_DEPTH freed blocks for the next allocation on the same core
+*/
+#define EMU68_TLSF_FAST_BINS    1
+#define EMU68_TLSF_BIN_DEPTH    32
+
+/*
+    RTG service on CPU1, "rtg_service" in bootargs. Fills, copies and pixel conversions requested
+    by the P96 driver through a queue at the end of VC4 memory, see rtg.h
+*/
+#define EMU68_RTG_SERVICE       1
+#define EMU68_RTG_QUEUE_SIZE    65536
+#define EMU68_RTG_POLL_HZ       100000
+
+/*
+    Mixing service on CPU1, "mix_service" in bootargs, unless the RTG service takes the core.
+    Channels of software mixers are resampled and mixed into 16-bit stereo through a queue at the
+    end of VC4 memory, see mixer.h
+*/
+#define EMU68_MIX_SERVICE       1
+#define EMU68_MIX_QUEUE_SIZE    16384
+#define EMU68_MIX_POLL_HZ       100000
+
+/*
+    Pacing of delay loops in CHIP, "loop_pacing" in bootargs. DBcc and Bcc loops of at most that
+    many register-only instructions take as long as on a 68000 running at the given clock
+*/
+#define EMU68_LOOP_PACING       1
+#define EMU68_LOOP_PACING_INSNS 8
+#define EMU68_LOOP_PACING_CLOCK 7093790
+
+/*
+    Idle wait of polling loops, "idle_wait" in bootargs. Inner loops of at most that many
+    instructions, which only read memory and compare, sleep in wfe once they have spun for the
+    given time without a longer gap between passes. The housekeeper's event on IPL change or the
+    timer event stream of the given rate wakes them up
+*/
+#define EMU68_IDLE_WAIT         1
+#define EMU68_IDLE_WAIT_INSNS   6
+#define EMU68_IDLE_WAIT_SPIN_US 200
+#define EMU68_IDLE_WAIT_GAP_US  50
+#define EMU68_IDLE_WAIT_TICK_HZ 100000
+
+/*
+    Native calls, "native_calls" in bootargs. LINE A opcodes of this range with a registered
+    routine are translated into a direct call of it, see native.h
+*/
+#define EMU68_NATIVE_CALLS      1
+#define EMU68_NATIVE_BASE       0xae00
+#define EMU68_NATIVE_COUNT      64
+
+/* Compression level of NATIVE_DEFLATE if the caller gives none */
+#define EMU68_NATIVE_DEFLATE_LEVEL  6
+
+/*
+    Exception paths of CHK, CHK2, TRAPcc and division by zero, and the tails of conditional side
+    exits, are moved behind the exit of the unit, the hot code is compare and branch only. Up to
+    this many paths and words per unit
+*/
+#define EMU68_COLD_STUBS        1
+#define EMU68_COLD_STUBS_MAX    128
+#define EMU68_COLD_CODE_SIZE    8192
+
+/*
+    On big.LITTLE machines the m68k runs on the core with the largest capacity-dmips-mhz of the
+    device tree, started through PSCI with a stack of that size, if the boot core is slower
+*/
+#define EMU68_BIG_CORE          1
+#define EMU68_BIG_CORE_STACK    (1024*1024)
+
+/*
+    Inner loops walking memory with (An)+ or -(An) prefetch the streams ahead on the backedge.
+    Default distance in 64 byte lines, JC2_PREFETCH_DIST of JIT_CONTROL2 changes it, 0 disables
+*/
+#define EMU68_LOOP_PREFETCH         1
+#define EMU68_LOOP_PREFETCH_DIST    4
+
+/*
+    Code entered fewer than EMU68_FIRST_RUN_COUNT times is translated quickly into the scratch
+    buffer and run from there, without checksum, unit or entry in the lookup table. Most of the
+    code which runs once never pays for a unit. Entries are counted in a small table indexed by
+    m68k address
+*/
+#define EMU68_FIRST_RUN         1
+#define EMU68_FIRST_RUN_COUNT   1
+#define EMU68_FIRST_RUN_BITS    10
+#define EMU68_FIRST_RUN_SIZE    (1 << EMU68_FIRST_RUN_BITS)
+#define EMU68_FIRST_RUN_MASK    (EMU68_FIRST_RUN_SIZE - 1)
+
+/*
+    Translation on cache miss keeps the m68k registers in host registers. Only x13-x18 are pushed
+    around the call, the translator preserves the rest by the calling convention or by the fixed
+    registers of the build. The context in M68KState is not updated then
+*/
+#define EMU68_LIGHT_MISS        1
+
+/*
+    FP0-FP7 stay in d8-d15, saved by every callee, and FPSR/FPIAR/FPCR in the fixed v29, so C code
+    between M68K_SaveContext and M68K_LoadContext leaves them alone. Both moves skip the FPU part,
+    it is loaded once the copy in M68KState has been changed and stored when it is needed there
+*/
+#define EMU68_LAZY_FPU          1
+
+/*
+    Code run with the T1 trace bit set is executed one instruction at a time from units of its
+    own, each followed by the trace exception raised in the main loop. Such units are kept in a
+    direct mapped table indexed by m68k address and checked against the instruction words
+*/
+#define EMU68_TRACE_CACHE       1
+#define EMU68_TRACE_CACHE_BITS  8
+#define EMU68_TRACE_CACHE_SIZE  (1 << EMU68_TRACE_CACHE_BITS)
+#define EMU68_TRACE_CACHE_MASK  (EMU68_TRACE_CACHE_SIZE - 1)
+
+/*
+    Units of RAM above 16MB which reached tier 1 or were entered EMU68_PROFILE_USES times are
+    recorded at warm reset together with the checksum of their code. After the reset the first
+    translation within EMU68_PROFILE_RANGE bytes of recorded entries lets the worker translate
+    them ahead, units of code which has changed meanwhile are dropped. Requires EMU68_JIT_WORKER
+*/
+#define EMU68_ENTRY_PROFILE     1
+#define EMU68_PROFILE_SIZE      512
+#define EMU68_PROFILE_USES      64
+#define EMU68_PROFILE_RANGE     (256*1024)
+
+/*
+    Writes changing JITCTRL, JITCTRL2 or the override table bump JIT_FLUSH_GEN. Units translated
+    with other settings are released when entered next and come back at tier 0, the new settings
+    apply once they are hot again. JITOVR* registers give JITCTRL for units starting in up to
+    EMU68_JIT_OVERRIDES address ranges. Requires EMU68_FLUSH_GENERATION
+*/
+#define EMU68_LAZY_RETUNE       1
+#define EMU68_JIT_OVERRIDE_BITS 2
+#define EMU68_JIT_OVERRIDES     (1 << EMU68_JIT_OVERRIDE_BITS)
+
+/* armhf: up to this many m68k registers used most by a unit are loaded on entry and never spilled */
+#define EMU68_ARM_PINNED_REGS   4
+
+/* Units are indexed by the 4K page of their lowest m68k address, for precise CINV/CPUSH */
+#define EMU68_PAGE_INDEX_BITS   11
+#define EMU68_PAGE_INDEX_SIZE   (1 << EMU68_PAGE_INDEX_BITS)
+#define EMU68_PAGE_INDEX_MASK   (EMU68_PAGE_INDEX_SIZE - 1)
+
+/*
+    Sampling profiler of m68k code on CPU1, started with "profile" in bootargs and controlled
+    by JC2F_PROFILE bits of JIT_CONTROL2. With GIC-400 every sample interrupts the emulation
+    core by SGI, otherwise the PC of the unit last entered through the main loop is sampled
+*/
+#define EMU68_PROFILER          1
+#define EMU68_PROFILER_HZ       1000
+#define EMU68_PROFILER_SLOTS    4096
+#define EMU68_PROFILER_TOP      32
+
+/*
+    While the profiler runs with SGI samples, translated code does not update the m68k instruction
+    counter at exits. INSNCNTLO/HI return an estimate instead, every sample adds ARM instructions
+    retired since the previous one times m68k/ARM instruction ratio of the sampled unit.
+    "insn_count=precise" in bootargs keeps exact counting. Requires EMU68_PROFILER
+*/
+#define EMU68_INSN_COUNTER_SAMPLED 1
+
+/*
+    Opt-in PMU profile, "pmu_profile" in bootargs. Cycles, L1 cache refills, branch mispredicts
+    and data TLB refills are attributed to the unit entered from the main loop, including all
+    units chained to it. The EMU68_PMU_TOP units with most cycles are tracked
+*/
+#define EMU68_PMU_PROFILE       1
+#define EMU68_PMU_SLOTS         1024
+#define EMU68_PMU_TOP_BITS      4
+#define EMU68_PMU_TOP           (1 << EMU68_PMU_TOP_BITS)
+
+/* Disassembly of translated code done by CPU1 from a ring filled by the translator, EMU68_DISASM_RING bytes */
+#define EMU68_DISASM_DEFERRED   1
+#define EMU68_DISASM_RING       (1 << 18)
+
+/* Independent boot stages run on CPUs 1-3 before those take their runtime roles, at most EMU68_BOOT_JOB_SLOTS */
+#define EMU68_BOOT_JOBS         1
+#define EMU68_BOOT_JOB_SLOTS    16
+
+/* Aggregate JIT statistics, live copy readable through /emu68/jit-stats and JITSTATSEL/JITSTAT */
+#define EMU68_JIT_STATS         1
+
+/*
+    With the bus_profile option every access of the page fault handlers is charged to the m68k
+    instruction behind it and the address region, EMU68_BUS_PROFILE_SETS sets of 4 access sites
+*/
+#define EMU68_BUS_PROFILE       1
+#define EMU68_BUS_PROFILE_SETS  1024
+
+/*
+    MOVEC to JITEXPORT writes a snapshot of the JIT cache (m68k ranges, ARM code, use counts and
+    PC maps of units) to the console, tools/jitexport decodes and disassembles it
+*/
+#define EMU68_JIT_EXPORT        1
+
+/* Always-on binary trace of JIT and bus events, ring of EMU68_TRACE_SIZE records per CPU */
+#define EMU68_TRACE             1
+#define EMU68_TRACE_BITS        11
+#define EMU68_TRACE_SIZE        (1 << EMU68_TRACE_BITS)
+#define EMU68_TRACE_MASK        (EMU68_TRACE_SIZE - 1)
+
+/*
+    Log of bus reads and IPL levels seen by the m68k, recorded on PiStorm with bus_record=<MiB>
+    and replayed on the other targets when the log is given as initrd. Up to EMU68_BUS_LOG_MAPS
+    ROM and RAM ranges of the recording are re-created by the replay
+*/
+#define EMU68_BUS_LOG           1
+#define EMU68_BUS_LOG_MAPS      32
+
 #ifdef PISTORM
 
 /* Speed for bitbang RS232... */
 #define PISTORM_BITBANG_SPEED       921600
 
+/* Sequential CHIP RAM reads in a row before the next 16 bytes are fetched at once */
+#define PISTORM_CHIP_PREFETCH_RUN   2
+
+/* Rate of the event stream the housekeeper polls IPL lines with */
+#define PISTORM_HKEEP_POLL_HZ       2400000
+
+/* Wake the housekeeper by GPIO edge interrupt where possible (GIC-400), poll otherwise */
+#define PISTORM_IPL_IRQ             1
+
+/* Fallback wakeup rate of the housekeeper while it waits for IPL edges */
+#define PISTORM_IPL_IRQ_POLL_HZ     1000
+
+/*
+    STOP sleeps in wfe until an interrupt it would accept arrives. The housekeeper sends the event
+    only then instead of on every IPL read, wake-up latency goes to the JIT statistics
+*/
+#define PISTORM_STOP_WAKE           1
+
+/*
+    With blitwait, blits started by the CPU writing BLTSIZE or BLTSIZH get an end time estimated
+    from size and channels at the given blitter clock. DMACONR is polled only once it has passed
+*/
+#define PISTORM_BLIT_PREDICT        1
+#define PISTORM_BLIT_CCK_HZ         3579545
+
+/* With warm_reset on the command line Ctrl-Amiga-Amiga restarts the m68k, JIT cache and ROM are kept */
+#define PISTORM_WARM_RESET          1
+
+/* CHIP RAM ranges given with chip_private are backed by ARM RAM, see chipshadow.h */
+#define PISTORM_CHIP_SHADOW         1
+
+/* Interrupt vectors at VBR 0 are fetched from a copy, writes to the vector table invalidate it */
+#define PISTORM_VECTOR_SHADOW       1
+
+/* With async_log and console=ttyAMA0 the log CPU feeds PL011 by DMA, in chunks of that many bytes */
+#define PISTORM_SERIAL_DMA          1
+#define PISTORM_SERIAL_DMA_CHUNK    4096
+
 #ifdef PISTORM32
 
 #define PISTORM_BITBANG_DELAY       59
@@ -63,6 +596,20 @@
 #define PISTORM_CIA_DELAY           0
 #define PISTORM_WRITE_BUFFER        0
 #define PISTORM_WRITE_BUFFER_SIZE   32  
+#define PISTORM_CHIP_PREFETCH       1
+
+/* CHIP RAM stores are combined into wide bursts, the aarch64 main loop flushes them on interrupts */
+#ifdef __aarch64__
+#define PISTORM_WRITE_COMBINE       1
+#else
+#define PISTORM_WRITE_COMBINE       0
+#endif
+
+/*
+    Width of the FPGA configuration bus on PiStorm32-lite, 1 or 8. In x8 mode a byte is clocked
+    in per cycle, the bitstream has to be generated for that width then
+*/
+#define PISTORM_EFINIX_WIDTH        1
 
 #else
 
@@ -70,7 +617,23 @@
 #define PISTORM_CHIPSET_DELAY       12
 #define PISTORM_CIA_DELAY           0
 #define PISTORM_WRITE_BUFFER        1
-#define PISTORM_WRITE_BUFFER_SIZE   32  
+#define PISTORM_WRITE_BUFFER_SIZE   128
+
+/* Accesses per test round of the bus delay calibration enabled with bus_calibrate bootarg */
+#define PISTORM_CALIBRATE_ITER      256
+
+/* Reads of CHIP RAM are answered from the write buffer if the newest entries cover them */
+#define PISTORM_WB_FORWARD          1
+#define PISTORM_WB_FORWARD_DEPTH    16
+
+/* Plain PiStorm splits wide reads into word cycles anyway, read-ahead gains nothing there */
+#define PISTORM_CHIP_PREFETCH       0
+
+/*
+    Writes to memory below chipset space do not wait for the end of their bus cycle, the next
+    access does. Chipset and CIA writes complete before the bus delays start
+*/
+#define PISTORM_POSTED_WRITES       1
 
 #endif
 
@@ -84,7 +647,30 @@
 #define KERNEL_JIT_PAGES        32
 #define KERNEL_RSRVD_PAGES      ((KERNEL_JIT_PAGES) + (KERNEL_SYS_PAGES))
 
+/*
+    JIT pool size in 2MB pages is chosen at boot. By default it is 1 / (1 << EMU68_JIT_RAM_SHIFT)
+    of the RAM, the jit_size= bootarg (in MiB) overrides it. KERNEL_JIT_PAGES is the size
+    announced in the image header only
+*/
+#define EMU68_JIT_RAM_SHIFT     4
+#define EMU68_JIT_MIN_PAGES     16
+#define EMU68_JIT_MAX_PAGES     512
+
+/*
+    Map large, aligned regions with 1GB blocks and groups of 16 2MB blocks with the contiguous
+    hint set. It covers the 1:1 map of RAM with its mirrors and the JIT pool
+*/
+#define EMU68_MMU_LARGE_PAGES   1
+
 #define EMU68_LOG_FETCHES       0
 #define EMU68_LOG_USES          0
 
+/*
+    Translator core built as a user space program (tools/jitbench). Privileged instructions
+    on the translation path are left out, the code is never run
+*/
+#ifndef EMU68_HOST_BUILD
+#define EMU68_HOST_BUILD        0
+#endif
+
 #endif /* _CONFIG_H */
@@ -51,6 +51,11 @@ typedef struct of_node {
 
 #define FDT_MAGIC       0xd00dfeed
 
+/* FNV-1a hash of node paths, used by the node cache and the index of the m68k side tree */
+#define DT_HASH_INIT    2166136261U
+
+uint32_t dt_hash(uint32_t hash, const char *str);
+
 void dt_dump_tree();
 of_node_t *dt_parse(void *ptr);
 long dt_total_size();
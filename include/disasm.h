@@ -1,9 +1,17 @@
 #ifndef _DISASM_H
 #define _DISASM_H
 
+#include "config.h"
+
 void disasm_init();
 void disasm_open();
 void disasm_close();
 void disasm_print(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr, size_t arm_size, uint32_t *arm_start);
 
+#if EMU68_DISASM_DEFERRED
+extern int disasm_deferred;
+void disasm_publish();
+void disasm_task();
+#endif
+
 #endif /* _DISASM_H */
@@ -0,0 +1,227 @@
+#ifndef _JITSTATS_H
+#define _JITSTATS_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Aggregate statistics of the JIT. Histograms have JS_BUCKETS buckets, bucket n of size and
+    length histograms counts units below 16 << n ARM or 1 << (n + 1) m68k instructions, the
+    last one anything larger. Ratio buckets are bounded by js_RatioLimit (ARM instructions per
+    m68k instruction). Release counts are per unit, not per event which caused them.
+
+    Bus counters are kept per region of the m68k address space and cover every access emulated
+    by the fault handler, ticks include decoding. Dispatch counters are copies of JITJCHIT and
+    JITJCMISS taken on each jump cache miss.
+
+    The structure is read raw by EmuControl, as 32-bit words in host (big endian) order. New
+    fields go to the end only.
+*/
+
+#define JS_BUCKETS      8
+
+/* Opcode mix: bits 15-6 of the opcode times EA modes 0-6 and 7 with register 0-4 */
+#define JS_OPMIX_MODES  12
+#define JS_OPMIX_SIZE   (1024 * JS_OPMIX_MODES)
+
+enum JITStatCause {
+    JS_RELEASE_LRU = 0,     /* Cache full or lookup table load limit */
+    JS_RELEASE_CRC,         /* Checksum mismatch on verification */
+    JS_RELEASE_CINV_LINE,   /* CINVL/CPUSHL */
+    JS_RELEASE_CINV_PAGE,   /* CINVP/CPUSHP */
+    JS_RELEASE_CINV_ALL,    /* CINVA/CPUSHA without weak flush */
+    JS_RELEASE_SOFT_FLUSH,  /* CINVA/CPUSHA with weak flush, units poisoned or released */
+    JS_RELEASE_WRITTEN,     /* Write to protected code page */
+    JS_RELEASE_STALE,       /* Retranslation with new bus sites or JIT settings */
+    JS_RELEASE_REPLACED,    /* Replaced by unit of higher tier */
+    JS_RELEASE_RESET,       /* Warm reset of the m68k */
+    JS_CAUSE_COUNT
+};
+
+enum JITStatRegion {
+    JS_REGION_CHIP = 0,     /* 000000-1fffff */
+    JS_REGION_FAST,         /* 200000-9fffff, Zorro II RAM */
+    JS_REGION_CIA,          /* a00000-bfffff */
+    JS_REGION_SLOW,         /* c00000-d7ffff */
+    JS_REGION_CUSTOM,       /* d80000-dfffff, custom chips and clock */
+    JS_REGION_ZORRO_IO,     /* e00000-efffff, autoconfig and Zorro II I/O */
+    JS_REGION_ROM,          /* f00000-ffffff */
+    JS_REGION_HIGH,         /* 01000000 and above, Zorro III */
+    JS_REGION_COUNT
+};
+
+struct JITStats {
+    uint32_t    js_Size;                        /* sizeof(struct JITStats) */
+    uint32_t    js_Buckets;                     /* JS_BUCKETS */
+    uint32_t    js_Causes;                      /* JS_CAUSE_COUNT */
+    uint32_t    js_TimerFreq;                   /* CNTFRQ, unit of the tick counters */
+    uint32_t    js_RatioLimit[JS_BUCKETS];      /* Upper bounds of ratio buckets, 1/4 of instruction */
+    uint32_t    js_UnitSize[JS_BUCKETS];        /* ARM instructions */
+    uint32_t    js_UnitLength[JS_BUCKETS];      /* m68k instructions */
+    uint32_t    js_Ratio[JS_BUCKETS];
+    uint32_t    js_Released[JS_CAUSE_COUNT];
+    uint32_t    js_Translated;
+    uint32_t    js_Verified;
+    uint64_t    js_TranslateTicks;
+    uint64_t    js_VerifyTicks;
+    uint32_t    js_TranslateMax;                /* Longest translation, ticks */
+    uint32_t    js_VerifyMax;
+    uint32_t    js_StopWakes;                   /* Interrupts taken by STOP woken by the housekeeper */
+    uint32_t    js_StopWakeMax;                 /* Longest wake-up, ticks */
+    uint64_t    js_StopWakeTicks;
+    uint32_t    js_Regions;                     /* JS_REGION_COUNT */
+    uint32_t    js_DispatchHit;                 /* Jump cache hits of the main loop */
+    uint32_t    js_DispatchMiss;
+    uint32_t    js_Chained;                     /* Exits patched into direct branches */
+    uint32_t    js_Unchained;
+    uint32_t    js_ChainFar;                    /* Exits left to the main loop, target out of branch range */
+    uint64_t    js_BusTicks[JS_REGION_COUNT];
+    uint32_t    js_BusReads[JS_REGION_COUNT];
+    uint32_t    js_BusWrites[JS_REGION_COUNT];
+    uint32_t    js_BusMax[JS_REGION_COUNT];     /* Longest access, ticks */
+    uint32_t    js_OpMixModes;                  /* JS_OPMIX_MODES */
+    uint32_t    js_OpMix[JS_OPMIX_SIZE];        /* Executed instructions, DBGCTRL bit 3 */
+};
+
+extern struct JITStats jit_stats;
+extern uint32_t jit_stats_select;       /* Word of jit_stats read through JITSTAT */
+extern int opmix;                       /* Instrument new units for the opcode mix */
+
+static inline uint32_t JITStats_OpMixIndex(uint16_t opcode)
+{
+    uint32_t mode = (opcode >> 3) & 7;
+
+    if (mode == 7)
+        mode += (opcode & 7) < 4 ? (opcode & 7) : 4;
+
+    return (opcode >> 6) * JS_OPMIX_MODES + mode;
+}
+
+void JITStats_Init();
+void JITStats_Dump();
+
+#if EMU68_JIT_STATS
+
+void JITStats_Unit(uint32_t m68k_insns, uint32_t arm_insns, uint64_t ticks);
+
+static inline uint64_t JITStats_Time()
+{
+    uint64_t time;
+    asm volatile("mrs %0, CNTPCT_EL0":"=r"(time));
+    return time;
+}
+
+static inline void JITStats_Release(int cause, uint32_t count)
+{
+    jit_stats.js_Released[cause] += count;
+}
+
+static inline void JITStats_Verify(uint64_t ticks)
+{
+    jit_stats.js_Verified++;
+    jit_stats.js_VerifyTicks += ticks;
+    if (ticks > jit_stats.js_VerifyMax)
+        jit_stats.js_VerifyMax = ticks;
+}
+
+static inline void JITStats_StopWake(uint64_t ticks)
+{
+    jit_stats.js_StopWakes++;
+    jit_stats.js_StopWakeTicks += ticks;
+    if (ticks > jit_stats.js_StopWakeMax)
+        jit_stats.js_StopWakeMax = ticks;
+}
+
+static inline int JITStats_Region(uint32_t addr)
+{
+    if (addr >= 0x01000000)
+        return JS_REGION_HIGH;
+    if (addr < 0x00200000)
+        return JS_REGION_CHIP;
+    if (addr < 0x00a00000)
+        return JS_REGION_FAST;
+    if (addr < 0x00c00000)
+        return JS_REGION_CIA;
+    if (addr < 0x00d80000)
+        return JS_REGION_SLOW;
+    if (addr < 0x00e00000)
+        return JS_REGION_CUSTOM;
+    if (addr < 0x00f00000)
+        return JS_REGION_ZORRO_IO;
+    return JS_REGION_ROM;
+}
+
+static inline void JITStats_Bus(uint32_t addr, int write, uint64_t ticks)
+{
+    int r = JITStats_Region(addr);
+
+    if (write)
+        jit_stats.js_BusWrites[r]++;
+    else
+        jit_stats.js_BusReads[r]++;
+    jit_stats.js_BusTicks[r] += ticks;
+    if (ticks > jit_stats.js_BusMax[r])
+        jit_stats.js_BusMax[r] = ticks;
+}
+
+#if EMU68_BUS_PROFILE
+extern int bus_profile;
+void JITStats_BusSite(uint64_t elr, uint32_t addr, uint64_t ticks);
+#endif
+
+static inline void JITStats_Dispatch(uint32_t hit, uint32_t miss)
+{
+    jit_stats.js_DispatchHit = hit;
+    jit_stats.js_DispatchMiss = miss;
+}
+
+static inline void JITStats_Count(uint32_t *counter)
+{
+    (*counter)++;
+}
+
+#else
+
+static inline void JITStats_Unit(uint32_t m68k_insns, uint32_t arm_insns, uint64_t ticks)
+{
+    (void)m68k_insns; (void)arm_insns; (void)ticks;
+}
+
+static inline uint64_t JITStats_Time()
+{
+    return 0;
+}
+
+static inline void JITStats_Release(int cause, uint32_t count)
+{
+    (void)cause; (void)count;
+}
+
+static inline void JITStats_Verify(uint64_t ticks)
+{
+    (void)ticks;
+}
+
+static inline void JITStats_StopWake(uint64_t ticks)
+{
+    (void)ticks;
+}
+
+static inline void JITStats_Bus(uint32_t addr, int write, uint64_t ticks)
+{
+    (void)addr; (void)write; (void)ticks;
+}
+
+static inline void JITStats_Dispatch(uint32_t hit, uint32_t miss)
+{
+    (void)hit; (void)miss;
+}
+
+static inline void JITStats_Count(uint32_t *counter)
+{
+    (void)counter;
+}
+
+#endif
+
+#endif /* _JITSTATS_H */
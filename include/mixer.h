@@ -0,0 +1,88 @@
+#ifndef _MIXER_H
+#define _MIXER_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Audio mixing service. A spare ARM core resamples and mixes channels of software mixers like
+    AHI or tracker players into one 16-bit stereo buffer. The command queue sits at the end of
+    VC4 memory below the queue of the RTG service, its address and size are given in the
+    "mix-queue" property of /emu68, the "vc4-mem" property does not include it.
+
+    The queue works as the one of the RTG service: the m68k fills the slot mq_Head % mq_Slots and
+    increments mq_Head afterwards, the ARM core increments mq_Tail when a command is done.
+    Counters are free running, all fields are big endian. Samples, channel array and output
+    buffer are m68k addresses in VC4 memory or in RAM of the m68k, otherwise the command is
+    skipped and mq_Errors incremented.
+
+    MIX_RUN renders mc_Frames frames of interleaved left and right signed 16-bit words. Channels
+    are linearly interpolated at their 16.16 step, scaled by their volumes and summed with
+    saturation. Position fields of the channels are updated when the command is done, so that
+    the next buffer continues where this one ended. A channel without loop is cleared from
+    MIXCF_ACTIVE once it has played its last sample. With MIXF_SIGNAL the completion is raised
+    as an ARM interrupt, the m68k sees it as EXTER at level 6.
+*/
+
+#define MIX_QUEUE_MAGIC     0x4d495851  /* MIXQ */
+#define MIX_QUEUE_VERSION   1
+#define MIX_MAX_CHANNELS    64
+#define MIX_VOLUME_UNITY    0x100
+
+enum MixOp {
+    MIX_NOP = 0,
+    MIX_RUN,
+};
+
+enum MixSampleFormat {
+    MIXS_S8 = 0,        /* Signed 8-bit mono */
+    MIXS_S16,           /* Signed 16-bit mono, big endian */
+    MIXS_COUNT
+};
+
+/* Flags of struct MixCommand */
+#define MIXF_SIGNAL     0x01    /* Raise an ARM interrupt when done */
+#define MIXF_ADD        0x02    /* Add to the contents of the output buffer instead of replacing them */
+
+/* Flags of struct MixChannel */
+#define MIXCF_ACTIVE    0x01
+
+struct MixChannel {
+    uint32_t    ch_Sample;      /* Address of the first sample */
+    uint32_t    ch_Length;      /* Samples */
+    uint32_t    ch_LoopStart;   /* First sample of the loop, ch_Length or more for no loop */
+    uint32_t    ch_Position;    /* Current sample */
+    uint16_t    ch_Fraction;    /* Between ch_Position and the next sample, 1/65536 steps */
+    uint8_t     ch_Format;
+    uint8_t     ch_Flags;
+    uint32_t    ch_Step;        /* 16.16 samples per output frame */
+    uint16_t    ch_VolumeL;     /* MIX_VOLUME_UNITY is 1.0 */
+    uint16_t    ch_VolumeR;
+    uint32_t    ch_Reserved;
+};
+
+struct MixCommand {
+    uint8_t     mc_Op;
+    uint8_t     mc_Flags;
+    uint16_t    mc_Channels;    /* Entries of the channel array, up to MIX_MAX_CHANNELS */
+    uint32_t    mc_Channel;     /* Address of the channel array */
+    uint32_t    mc_Dst;         /* Output buffer */
+    uint32_t    mc_Frames;
+    uint32_t    mc_Reserved[4];
+};
+
+struct MixQueue {
+    uint32_t    mq_Magic;
+    uint16_t    mq_Version;
+    uint16_t    mq_Slots;
+    uint32_t    mq_Head;        /* Written by the m68k */
+    uint32_t    mq_Tail;        /* Written by the ARM core */
+    uint32_t    mq_Errors;
+    uint32_t    mq_Reserved[3];
+    struct MixCommand mq_Cmd[];
+};
+
+uintptr_t Mix_Setup(uintptr_t vc4_base, uintptr_t vc4_size);
+void Mix_ServiceTask();
+
+#endif /* _MIXER_H */
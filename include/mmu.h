@@ -41,5 +41,19 @@
 void mmu_init();
 uintptr_t mmu_virt2phys(uintptr_t addr);
 void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low, uint32_t attr_high);
+void mmu_map_unused(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low, uint32_t attr_high);
+int mmu_protect_page(uintptr_t virt, int read_only);
+void mmu_unmap(uintptr_t virt, uintptr_t length);
+uint32_t mmu_reserve_pages(uint32_t count);
+
+/* Collect TLB maintenance of the map, unmap and protect calls in between and do it once */
+void mmu_batch_begin();
+void mmu_batch_commit();
+
+/* Alternative tables for the lower address space, used by the m68k MMU */
+void *mmu_user_table_new();
+void mmu_user_table_free(void *l1);
+void mmu_user_table_select(void *l1);
+uint64_t mmu_user_entry(uintptr_t addr);
 
 #endif /* _MMU_H */
@@ -0,0 +1,60 @@
+#ifndef _NATIVE_H
+#define _NATIVE_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Native calls. LINE A opcodes EMU68_NATIVE_BASE to EMU68_NATIVE_BASE + EMU68_NATIVE_COUNT - 1
+    with a registered routine are translated into a direct call of it, all other LINE A opcodes
+    raise the exception as usual. The "native-calls" property of /emu68 gives base opcode and
+    number of slots, it is present only if native calls are enabled.
+
+    Arguments are passed in D0-D7 and A0-A6, the result is returned in D0. All other registers
+    are preserved unless the call says otherwise, condition codes are left alone. Addresses are
+    physical and have to lie in a block of m68k RAM, otherwise the call fails with D0 = -1.
+    On PiStorm the bitplanes of NATIVE_C2P may lie in CHIP RAM outside of the chip_private range
+    too.
+    With EMU68_SMC_PROTECT translated code under the destination of a native call is dropped,
+    without it code written by a native call is not seen by the JIT until the caches are cleared,
+    just as with DMA.
+*/
+
+enum NativeCall {
+    NATIVE_COPY = 0,    /* A0 source, A1 destination, D0 size. Areas may overlap, D0 = 0 */
+    NATIVE_FILL,        /* A0 destination, D0 size, D1 byte value. D0 = 0 */
+    NATIVE_STRLEN,      /* A0 string. D0 = length */
+    NATIVE_STRCMP,      /* A0, A1 strings. D0 < 0, 0 or > 0 */
+    NATIVE_INFLATE,     /* A0 source, D0 size, A1 destination, D1 size, D2 format. D0 = bytes written */
+    NATIVE_DEFLATE,     /* As NATIVE_INFLATE, D3 level 1-12 or 0 for default. D1 = 0 returns the bound */
+    NATIVE_CRC32,       /* A0 buffer, D0 size, D1 initial value. D0 = CRC32 */
+    NATIVE_ADLER32,     /* A0 buffer, D0 size, D1 initial value. D0 = Adler-32 */
+    NATIVE_C2P,         /* A0 chunky pixels, A1 plane 0, D0 width, D1 height, D2 depth, D3 plane offset,
+                           D4 destination pitch, D5 source pitch or 0 for width. D0 = 0 */
+    NATIVE_DISK_IO,     /* A1 IOStdReq of the RAM disk board, see ramdisk.h. D0 = io_Error */
+};
+
+/*
+    NATIVE_C2P converts rows of one byte per pixel into depth bitplanes, bit p of a pixel goes to
+    plane p, the leftmost pixel to the highest bit. Width is a multiple of 16 up to C2P_MAX_WIDTH,
+    offsets and pitches of the planes are even
+*/
+#define C2P_MAX_WIDTH   4096
+
+/* Formats of NATIVE_INFLATE and NATIVE_DEFLATE */
+enum NativeFormat {
+    NATIVE_FMT_ZLIB = 0,
+    NATIVE_FMT_DEFLATE,
+    NATIVE_FMT_GZIP,
+};
+
+struct M68KState;
+typedef void (*native_func_t)(struct M68KState *ctx);
+
+void Native_Setup();
+int Native_Register(uint16_t slot, native_func_t func, const char *name);
+native_func_t Native_Find(uint16_t opcode);
+int Native_AreaOK(uint32_t addr, uint32_t size);
+uint32_t *EMIT_NativeCall(uint32_t *ptr, native_func_t func);
+
+#endif /* _NATIVE_H */
@@ -0,0 +1,42 @@
+#ifndef _RAMDISK_H
+#define _RAMDISK_H
+
+#include <stdint.h>
+
+/*
+    RAM disk board. A Zorro III I/O board of 64KB, manufacturer 0x6d73, product RAMDISK_PRODUCT,
+    present with "ramdisk_size=<MB>" and "native_calls" in bootargs. The disk itself lies in ARM
+    memory outside of the m68k address space. The first page of the board shows struct RAMDiskInfo,
+    the rest of the window is not decoded. All fields are big endian.
+
+    A trackdisk compatible driver calls the LINE A opcode ri_Opcode (NATIVE_DISK_IO) with the
+    IOStdReq in A1 from BeginIO. The call does the command, sets io_Actual and io_Error and
+    returns io_Error in D0, the request is replied by the driver. Blocks are copied between the
+    disk and io_Data on the ARM side. io_Length and io_Offset have to be multiples of ri_BlockSize,
+    io_Data may have any alignment but has to lie in a block of m68k RAM (not in CHIP RAM on
+    PiStorm), otherwise the request fails with IOERR_BADADDRESS.
+
+    Supported are CMD_READ, CMD_WRITE, TD_FORMAT and their TD64 and NSCMD 64-bit forms, which take
+    bits 63-32 of the offset from io_Actual, TD_GETGEOMETRY, TD_CHANGENUM, TD_CHANGESTATE,
+    TD_PROTSTATUS, TD_GETDRIVETYPE, TD_GETNUMTRACKS and the commands which do nothing on a RAM
+    disk: CMD_UPDATE, CMD_CLEAR, TD_MOTOR, TD_SEEK, TD_SEEK64, NSCMD_TD_SEEK64 and TD_REMOVE. All
+    others return IOERR_NOCMD, commands keeping state of the driver such as TD_ADDCHANGEINT or
+    NSCMD_DEVICEQUERY are done by the driver itself.
+*/
+
+#define RAMDISK_MAGIC       0x52414d44  /* RAMD */
+#define RAMDISK_VERSION     1
+#define RAMDISK_PRODUCT     0x12
+#define RAMDISK_BLOCK_SIZE  512
+#define RAMDISK_TRACK_BLOCKS 32         /* Geometry is one head and tracks of 32 blocks */
+
+struct RAMDiskInfo {
+    uint32_t    ri_Magic;
+    uint16_t    ri_Version;
+    uint16_t    ri_Opcode;      /* LINE A opcode of NATIVE_DISK_IO */
+    uint32_t    ri_BlockSize;
+    uint32_t    ri_Blocks;
+    uint32_t    ri_Reserved[4];
+};
+
+#endif /* _RAMDISK_H */
@@ -0,0 +1,76 @@
+#ifndef _RTG_H
+#define _RTG_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    RTG service. A spare ARM core performs fills, copies and pixel format conversions for the
+    P96 driver of the m68k. The command queue sits at the end of VC4 memory, its address and size
+    are given in the "rtg-queue" property of /emu68, the "vc4-mem" property does not include it.
+
+    The m68k fills the slot rq_Head % rq_Slots and increments rq_Head afterwards. The ARM core
+    increments rq_Tail when a command is done, rq_Tail == rq_Head means that all commands have
+    completed (WaitBlitter). Counters are free running, all fields are big endian. Addresses
+    are m68k addresses, both areas have to lie in VC4 memory or in RAM of the m68k, otherwise
+    the command is skipped and rq_Errors incremented.
+
+    RTG_SCALE takes rc_SrcWidth x rc_SrcHeight pixels of the source and scales them to
+    rc_Width x rc_Height with nearest neighbour sampling, converting the format on the way.
+    Frames captured by unicam into VC4 memory go to the screen this way without m68k work.
+*/
+
+#define RTG_QUEUE_MAGIC     0x52544751  /* RTGQ */
+#define RTG_QUEUE_VERSION   2
+#define RTG_SCALE_WIDTH     4096        /* Widest destination of RTG_SCALE */
+
+enum RTGOp {
+    RTG_NOP = 0,
+    RTG_FILL,           /* rc_Color in destination format */
+    RTG_COPY,           /* Same format, areas may overlap */
+    RTG_CONVERT,        /* rc_SrcFormat to rc_DstFormat, CLUT8 source takes palette address in rc_Color */
+    RTG_INVERT,         /* All bits of the destination */
+    RTG_SCALE,          /* As RTG_CONVERT, source of rc_SrcWidth x rc_SrcHeight pixels */
+};
+
+enum RTGFormat {
+    RTGF_CLUT8 = 0,
+    RTGF_RGB16,         /* 5-6-5 big endian */
+    RTGF_RGB16PC,       /* 5-6-5 little endian */
+    RTGF_ARGB32,
+    RTGF_BGRA32,
+    RTGF_COUNT
+};
+
+struct RTGCommand {
+    uint8_t     rc_Op;
+    uint8_t     rc_SrcFormat;
+    uint8_t     rc_DstFormat;   /* Format of RTG_FILL, RTG_COPY and RTG_INVERT */
+    uint8_t     rc_Flags;
+    uint32_t    rc_Src;
+    uint32_t    rc_Dst;
+    uint16_t    rc_SrcPitch;    /* Bytes per row */
+    uint16_t    rc_DstPitch;
+    uint16_t    rc_Width;       /* Pixels */
+    uint16_t    rc_Height;
+    uint32_t    rc_Color;
+    uint16_t    rc_SrcWidth;    /* RTG_SCALE only */
+    uint16_t    rc_SrcHeight;
+    uint32_t    rc_Reserved;
+};
+
+struct RTGQueue {
+    uint32_t    rq_Magic;
+    uint16_t    rq_Version;
+    uint16_t    rq_Slots;
+    uint32_t    rq_Head;        /* Written by the m68k */
+    uint32_t    rq_Tail;        /* Written by the ARM core */
+    uint32_t    rq_Errors;
+    uint32_t    rq_Reserved[3];
+    struct RTGCommand rq_Cmd[];
+};
+
+uintptr_t RTG_Setup(uintptr_t vc4_base, uintptr_t vc4_size);
+void RTG_ServiceTask();
+
+#endif /* _RTG_H */
@@ -6,6 +6,8 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct {
     volatile char lock;
@@ -33,6 +35,201 @@ static inline bool spinlock_try_acquire(spinlock_t *s) {
     return !__atomic_test_and_set(&s->lock, __ATOMIC_ACQUIRE);
 }
 
+/*
+    The locks below are built on __atomic builtins, which compile to LSE instructions when the
+    target has them (-march=armv8.1-a or later) and to exclusive load/store pairs otherwise.
+    Waiters sleep in wfe with the lock word held by the exclusive monitor, a store to that
+    word by another core wakes them up.
+*/
+
+/* Wait until *p is different from old, returns the new value with acquire semantics */
+static inline uint32_t __lock_wait_change(volatile uint32_t *p, uint32_t old) {
+    uint32_t v;
+#ifdef __aarch64__
+    __asm__ __volatile__(
+        "       sevl                \n"
+        "1:     wfe                 \n"
+        "       ldaxr   %w0, %1     \n"
+        "       cmp     %w0, %w2    \n"
+        "       b.eq    1b          \n"
+        : "=&r"(v) : "Q"(*p), "r"(old) : "memory", "cc");
+#else
+    while ((v = __atomic_load_n(p, __ATOMIC_ACQUIRE)) == old)
+        __asm__ __volatile__("yield");
+#endif
+    return v;
+}
+
+/* Ticket lock, cores get the lock in the order they asked for it */
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} __attribute__((aligned(64))) ticketlock_t;
+
+static inline void ticketlock_init(ticketlock_t *t) {
+    t->next = 0;
+    t->owner = 0;
+}
+
+static inline void ticketlock_acquire(ticketlock_t *t) {
+    uint32_t ticket = __atomic_fetch_add(&t->next, 1, __ATOMIC_RELAXED);
+    uint32_t owner = __atomic_load_n(&t->owner, __ATOMIC_ACQUIRE);
+
+    while (owner != ticket)
+        owner = __lock_wait_change(&t->owner, owner);
+}
+
+static inline bool ticketlock_try_acquire(ticketlock_t *t) {
+    uint32_t owner = __atomic_load_n(&t->owner, __ATOMIC_ACQUIRE);
+    uint32_t ticket = owner;
+
+    /* Owner cannot move while the lock is free, taking the next ticket is enough */
+    return __atomic_compare_exchange_n(&t->next, &ticket, owner + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void ticketlock_release(ticketlock_t *t) {
+    __atomic_store_n(&t->owner, t->owner + 1, __ATOMIC_RELEASE);
+}
+
+/*
+    MCS lock. Every waiter spins on its own node, so a contended lock does not bounce one
+    cache line between all cores. The node is supplied by the caller, usually on the stack,
+    and has to stay valid until the lock is released.
+*/
+struct mcs_node {
+    struct mcs_node * volatile  next;
+    volatile uint32_t           locked;
+} __attribute__((aligned(64)));
+
+typedef struct {
+    struct mcs_node * volatile  tail;
+} __attribute__((aligned(64))) mcslock_t;
+
+static inline void mcslock_init(mcslock_t *m) {
+    m->tail = NULL;
+}
+
+static inline void mcslock_acquire(mcslock_t *m, struct mcs_node *node) {
+    struct mcs_node *prev;
+
+    node->next = NULL;
+    node->locked = 1;
+
+    prev = __atomic_exchange_n(&m->tail, node, __ATOMIC_ACQ_REL);
+
+    if (prev != NULL)
+    {
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+
+        if (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+            __lock_wait_change(&node->locked, 1);
+    }
+}
+
+static inline void mcslock_release(mcslock_t *m, struct mcs_node *node) {
+    struct mcs_node *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+    if (next == NULL)
+    {
+        struct mcs_node *expected = node;
+
+        if (__atomic_compare_exchange_n(&m->tail, &expected, NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+
+        /* Successor is about to link itself in */
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL)
+            __asm__ __volatile__("yield");
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+    Sequence lock for read-mostly data like statistics. Writers have to be serialised by the
+    caller, readers never block the writer and retry if the data changed while they read it.
+
+        do {
+            seq = seqlock_read_begin(&s);
+            ...copy the data...
+        } while (seqlock_read_retry(&s, seq));
+*/
+typedef struct {
+    volatile uint32_t seq;
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *s) {
+    s->seq = 0;
+}
+
+static inline void seqlock_write_begin(seqlock_t *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t seqlock_read_begin(seqlock_t *s) {
+    uint32_t seq;
+
+    while ((seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE)) & 1)
+        __asm__ __volatile__("yield");
+
+    return seq;
+}
+
+static inline bool seqlock_read_retry(seqlock_t *s, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/*
+    Reader-writer lock. Any number of readers or one writer. A waiting writer keeps new
+    readers out, so that lookups cannot starve an update.
+*/
+#define RWLOCK_WRITER   0x80000000U
+
+typedef struct {
+    volatile uint32_t state;
+} __attribute__((aligned(64))) rwlock_t;
+
+static inline void rwlock_init(rwlock_t *r) {
+    r->state = 0;
+}
+
+static inline void rwlock_read_acquire(rwlock_t *r) {
+    uint32_t v = __atomic_load_n(&r->state, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        if (v & RWLOCK_WRITER)
+            v = __lock_wait_change(&r->state, v);
+        else if (__atomic_compare_exchange_n(&r->state, &v, v + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return;
+    }
+}
+
+static inline void rwlock_read_release(rwlock_t *r) {
+    __atomic_fetch_sub(&r->state, 1, __ATOMIC_RELEASE);
+}
+
+static inline void rwlock_write_acquire(rwlock_t *r) {
+    uint32_t v;
+
+    /* Claim the writer bit first, then wait for the readers to leave */
+    while ((v = __atomic_fetch_or(&r->state, RWLOCK_WRITER, __ATOMIC_ACQUIRE)) & RWLOCK_WRITER)
+        __lock_wait_change(&r->state, v);
+
+    v |= RWLOCK_WRITER;
+    while (v != RWLOCK_WRITER)
+        v = __lock_wait_change(&r->state, v);
+}
+
+static inline void rwlock_write_release(rwlock_t *r) {
+    __atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+}
+
 #ifdef __cplusplus
 }
 #endif
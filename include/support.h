@@ -125,6 +125,8 @@ void kprintf(const char * format, ...);
 void arm_flush_cache(uintptr_t addr, uint32_t length);
 void arm_icache_invalidate(uintptr_t addr, uint32_t length);
 void arm_dcache_invalidate(uintptr_t addr, uint32_t length);
+void arm_cache_init();
+void arm_sync_code(uintptr_t data, uintptr_t code, uint32_t length);
 void clear_entire_dcache();
 const char *remove_path(const char *in);
 size_t strlen(const char *c);
@@ -135,10 +137,13 @@ void *memcpy(void *dst, const void *src, size_t sz);
 void *memset(void *ptr, int fill, size_t sz);
 char *strstr(const char *str, const char *find);
 void bzero(void *ptr, size_t sz);
+uint64_t sum_be32(const void *mem, uintptr_t size);
 void platform_init();
 void platform_post_init();
 void setup_serial();
 const char * find_token(const char * string, const char * token);
+void boot_job(void (*func)(void *), void *arg);
+void boot_jobs_wait();
 
 extern void * firmware_file;
 extern uint32_t firmware_size;
@@ -76,6 +76,24 @@
 #define PL011_ICR_BEIC           (1 << 9)
 #define PL011_ICR_OEIC           (1 << 10)
 
+/* VideoCore tags used. */
+
+#define VCTAG_GET_ARM_MEMORY        0x00010005
+#define VCTAG_GET_VC_MEMORY         0x00010006
+#define VCTAG_GET_CLOCK_RATE        0x00030002
+#define VCTAG_GET_MAX_CLOCK_RATE    0x00030004
+#define VCTAG_GET_MIN_CLOCK_RATE    0x00030007
+#define VCTAG_SET_CLOCK_RATE        0x00038002
+#define VCTAG_GET_DISPLAY_SIZE      0x00040003
+
+/* Several property tags in one mailbox transaction, see support_rpi.c */
+void mbox_batch_begin();
+int mbox_batch_add(uint32_t tag, uint32_t value_words, const uint32_t *args, uint32_t nargs);
+void mbox_batch_submit(int wait);
+int mbox_batch_poll();
+void mbox_batch_wait();
+uint32_t mbox_batch_value(int pos);
+
 uint32_t set_clock_rate(uint32_t clock_id, uint32_t speed);
 uint32_t get_min_clock_rate(uint32_t clock_id);
 uint32_t get_max_clock_rate(uint32_t clock_id);
@@ -19,6 +19,16 @@ void *tlsf_init_with_memory(void *memory, uintptr_t size);
 uintptr_t tlsf_get_total_size(void *memory);
 uintptr_t tlsf_get_free_size(void *memory);
 
+/* Small allocations served by the per-core fast bins (hits) or by the TLSF matrix (misses) */
+struct tlsf_bin_stats {
+    uint64_t    tb_Hits;
+    uint64_t    tb_Misses;
+    uint64_t    tb_Cached;      /* Frees kept in a bin */
+    uint64_t    tb_Returned;    /* Frees of small blocks with the bin full */
+};
+
+void tlsf_get_bin_stats(void *memory, struct tlsf_bin_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
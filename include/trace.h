@@ -0,0 +1,88 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Binary event trace. Every CPU logs into its own ring of fixed size records, old records
+    are overwritten. Producers never block and do no formatting, the records are decoded by
+    Trace_Dump or offline from a memory dump (see trace-buffer property of /emu68).
+*/
+
+enum TraceEvent {
+    TRACE_NONE = 0,
+    TRACE_UNIT_TRANSLATED,      /* m68k address, m68k insn count, ARM insn count */
+    TRACE_UNIT_RELEASED,        /* m68k address, use count (low 32 bits) */
+    TRACE_FAULT_SITE,           /* ARM address (low, high), 0 on first fault or 1 once it became bus site */
+    TRACE_IPL_CHANGE,           /* previous IPL, new IPL */
+    TRACE_WB_FULL,              /* address, value, size */
+    TRACE_EVENT_COUNT
+};
+
+struct TraceRecord {
+    uint64_t    tr_Time;        /* CNTPCT */
+    uint32_t    tr_Seq;         /* Index of record + 1, 0 while being written */
+    uint16_t    tr_Event;
+    uint16_t    tr_Pad;
+    uint32_t    tr_Args[4];
+};
+
+struct TraceRing {
+    volatile uint64_t   tr_Head;
+    uint8_t             tr_Pad[56];
+    struct TraceRecord  tr_Records[EMU68_TRACE_SIZE];
+};
+
+#define TRACE_CPUS      4
+
+extern struct TraceRing trace_rings[TRACE_CPUS];
+
+void Trace_Init();
+void Trace_Dump();
+
+#if EMU68_TRACE
+
+static inline void Trace(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    uintptr_t cpu;
+    uint64_t time;
+
+#ifdef __aarch64__
+    asm volatile("mrs %0, MPIDR_EL1":"=r"(cpu));
+    asm volatile("mrs %0, CNTPCT_EL0":"=r"(time));
+#else
+    uint32_t lo, hi;
+    asm volatile("mrc p15, 0, %0, c0, c0, 5":"=r"(cpu));
+    asm volatile("mrrc p15, 0, %0, %1, c14":"=r"(lo), "=r"(hi));
+    time = ((uint64_t)hi << 32) | lo;
+#endif
+
+    /* Atomic reservation keeps records of an exception handler interrupting the producer apart */
+    struct TraceRing *ring = &trace_rings[cpu & (TRACE_CPUS - 1)];
+    uint64_t idx = __atomic_fetch_add(&ring->tr_Head, 1, __ATOMIC_RELAXED);
+    struct TraceRecord *r = &ring->tr_Records[idx & EMU68_TRACE_MASK];
+
+    __atomic_store_n(&r->tr_Seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    r->tr_Time = time;
+    r->tr_Event = event;
+    r->tr_Args[0] = a0;
+    r->tr_Args[1] = a1;
+    r->tr_Args[2] = a2;
+    r->tr_Args[3] = a3;
+
+    __atomic_store_n(&r->tr_Seq, (uint32_t)idx + 1, __ATOMIC_RELEASE);
+}
+
+#else
+
+static inline void Trace(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    (void)event; (void)a0; (void)a1; (void)a2; (void)a3;
+}
+
+#endif
+
+#endif /* _TRACE_H */
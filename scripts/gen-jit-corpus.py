@@ -0,0 +1,344 @@
+#!/usr/bin/env python3
+#
+# Generator of the JIT microbenchmark corpus.
+#
+# Every kernel repeats one instruction form (opcode family, size and EA mode) REPEAT times
+# in a loop of ITER iterations. All kernels are linked into one Hunk executable, which calls
+# them one after another. Each kernel reads CNTVALLO before and after its loop and prints
+# the difference to the PL011 of the virt machine as "@XXXXXXXX", one line per kernel, in
+# the same order as the map.
+#
+# Map file has one line per kernel: name, offset of the loop head from start of the code
+# hunk and number of m68k instructions in one loop iteration. The loop head is the unit
+# Emu68 runs in steady state, scripts/run-qemu-virt-corpus.sh looks it up in the
+# "[JIT] Unit:" lines.
+#
+# usage: gen-jit-corpus.py <output hunk> <output map> [iterations]
+
+import struct
+import sys
+
+REPEAT = 8
+DATA_SIZE = 128
+UART = 0xf2201000
+
+SIZES = { 'b': 0, 'w': 1, 'l': 2 }
+MOVE_SIZES = { 'b': 1, 'w': 3, 'l': 2 }
+
+# Sources use d1/a1, destinations d0. a0 points to the middle of kernel data, d2 is zero
+def ea(mode, size, dst=False):
+    if mode == 'dn':
+        return (0 << 3) | (0 if dst else 1), []
+    if mode == 'an':
+        return (1 << 3) | 1, []
+    if mode == 'ind':
+        return (2 << 3), []
+    if mode == 'postinc':
+        return (3 << 3), []
+    if mode == 'predec':
+        return (4 << 3), []
+    if mode == 'd16':
+        return (5 << 3), [0x0008]
+    if mode == 'd8x':
+        return (6 << 3), [0x2004]               # 4(a0,d2.w)
+    if mode == 'pcd16':
+        return (7 << 3) | 2, [0xfffe]           # Word before the extension, never zero
+    if mode == 'absw':
+        return (7 << 3) | 0, [0x0100]
+    if mode == 'imm':
+        return (7 << 3) | 4, [0x0000, 0x0003] if size == 'l' else [0x0003]
+    raise ValueError(mode)
+
+SRC_ALL = [ 'dn', 'an', 'ind', 'postinc', 'predec', 'd16', 'd8x', 'pcd16', 'absw', 'imm' ]
+SRC_DATA = [ m for m in SRC_ALL if m != 'an' ]
+DST_ALT = [ 'dn', 'ind', 'postinc', 'predec', 'd16', 'd8x' ]
+DST_MEM = [ 'ind', 'postinc', 'predec', 'd16', 'd8x' ]
+CTRL = [ 'ind', 'd16', 'd8x', 'pcd16', 'absw' ]
+
+def src_modes(size):
+    return SRC_DATA if size == 'b' else SRC_ALL
+
+# Low memory read by absw may hold zeros, divisions do not use it
+DIV_SRC = [ m for m in SRC_DATA if m != 'absw' ]
+
+FAMILIES = []
+
+# Kernel is (name, words of one instruction form, setup code, m68k instructions in the form)
+def family(name, sizes, modes, build, setup=None, count=1):
+    for s in sizes:
+        for m in (modes(s) if callable(modes) else modes):
+            FAMILIES.append(('%s.%s:%s' % (name, s, m) if s else '%s:%s' % (name, m), build(s, m), setup, count))
+
+def single(name, words, setup=None, count=1):
+    FAMILIES.append((name, words, setup, count))
+
+# Line 0, immediate and bit operations, CAS
+for n, base in (('ori', 0x0000), ('andi', 0x0200), ('subi', 0x0400), ('addi', 0x0600), ('eori', 0x0a00), ('cmpi', 0x0c00)):
+    def b(s, m, base=base):
+        f, x = ea(m, s, True)
+        _, imm = ea('imm', s)
+        return [base | (SIZES[s] << 6) | f] + imm + x
+    family(n, 'bwl', DST_ALT, b)
+
+for n, t in (('btst', 0), ('bchg', 1), ('bclr', 2), ('bset', 3)):
+    def b(s, m, t=t):
+        f, x = ea(m, 'b', True)
+        return [0x0100 | (1 << 9) | (t << 6) | f] + x
+    family(n + '_dn', [''], DST_ALT, b)
+    def b(s, m, t=t):
+        f, x = ea(m, 'b', True)
+        return [0x0800 | (t << 6) | f, 0x0003] + x
+    family(n + '_imm', [''], DST_ALT, b)
+
+for s, code in (('b', 1), ('w', 2), ('l', 3)):
+    f, x = ea('ind', s)
+    single('cas.%s:ind' % s, [0x0800 | (code << 9) | 0x00c0 | f, 0x0001] + x)
+
+# Lines 1-3, move and movea
+for dst in [ 'dn', 'ind', 'postinc', 'predec', 'd16' ]:
+    def b(s, m, dst=dst):
+        sf, sx = ea(m, s)
+        df, dx = ea(dst, s, True)
+        # Destination field has register and mode swapped
+        return [(MOVE_SIZES[s] << 12) | ((df & 7) << 9) | ((df >> 3) << 6) | sf] + sx + dx
+    family('move_' + dst, 'bwl', src_modes, b)
+
+def b(s, m):
+    f, x = ea(m, s)
+    return [(MOVE_SIZES[s] << 12) | (3 << 9) | (1 << 6) | f] + x
+family('movea', 'wl', SRC_ALL, b)
+
+# Line 4
+for n, base in (('clr', 0x4200), ('neg', 0x4400), ('not', 0x4600), ('tst', 0x4a00)):
+    def b(s, m, base=base):
+        f, x = ea(m, s, True)
+        return [base | (SIZES[s] << 6) | f] + x
+    family(n, 'bwl', DST_ALT, b)
+
+def b(s, m):
+    f, x = ea(m, s)
+    return [0x47c0 | f] + x
+family('lea', [''], CTRL, b)
+
+def b(s, m):
+    f, x = ea(m, s)
+    return [0x4840 | f] + x + [0x588f]          # addq.l #4,a7 keeps the stack balanced
+family('pea', [''], CTRL, b, count=2)
+
+for n, ext in (('mulu', 0x0000), ('muls', 0x0800)):
+    def b(s, m, ext=ext):
+        f, x = ea(m, 'l')
+        return [0x4c00 | f, ext] + x
+    family(n, 'l', SRC_DATA, b)
+
+for n, ext in (('divu', 0x0000), ('divs', 0x0800)):
+    def b(s, m, ext=ext):
+        f, x = ea(m, 'l')
+        return [0x4c40 | f, ext] + x
+    family(n, 'l', DIV_SRC, b)
+
+def b(s, m):
+    f, x = ea(m, 'b', True)
+    return [0x4ac0 | f] + x
+family('tas', [''], DST_ALT, b)
+
+single('ext.w', [0x4880])
+single('ext.l', [0x48c0])
+single('extb.l', [0x49c0])
+single('swap', [0x4840])
+single('nop', [0x4e71])
+single('move_ccr_dn', [0x42c0])
+single('move_dn_ccr', [0x44c1])
+single('link_unlk', [0x4e56, 0xfff8, 0x4e5e], count=2)
+single('movem.l', [0x48e7, 0xc000, 0x4cdf, 0x0003], count=2)
+
+# Line 5
+for n, base in (('addq', 0x5000), ('subq', 0x5100)):
+    def b(s, m, base=base):
+        f, x = ea(m, s, True)
+        return [base | (3 << 9) | (SIZES[s] << 6) | f] + x
+    family(n, 'bwl', DST_ALT, b)
+    single('%s.l:an' % n, [base | (3 << 9) | (2 << 6) | 0x0b])
+
+for n, cond in (('st', 0), ('shi', 2), ('seq', 7), ('sge', 12)):
+    def b(s, m, cond=cond):
+        f, x = ea(m, 'b', True)
+        return [0x50c0 | (cond << 8) | f] + x
+    family(n, [''], DST_ALT, b)
+
+single('dbf', [0x51cb, 0x0002])
+
+# Line 6, branches to the next instruction
+single('bra.w', [0x6000, 0x0002])
+single('beq.s', [0x6702, 0x4e71], count=2)
+single('bne.s', [0x6602, 0x4e71], count=2)
+
+# Line 7
+single('moveq', [0x7005])
+
+# Lines 8, 9, b, c, d
+for n, base in (('or', 0x8000), ('sub', 0x9000), ('cmp', 0xb000), ('and', 0xc000), ('add', 0xd000)):
+    def b(s, m, base=base):
+        f, x = ea(m, s)
+        return [base | (SIZES[s] << 6) | f] + x
+    family(n + '_ea_dn', 'bwl', src_modes if n in ('sub', 'cmp', 'add') else lambda s: SRC_DATA, b)
+
+for n, base in (('or', 0x8100), ('sub', 0x9100), ('eor', 0xb100), ('and', 0xc100), ('add', 0xd100)):
+    def b(s, m, base=base):
+        f, x = ea(m, s, True)
+        return [base | (SIZES[s] << 6) | f] + x
+    family(n + '_dn_ea', 'bwl', DST_MEM if n != 'eor' else DST_ALT, b)
+
+for n, base in (('suba', 0x97c0), ('cmpa', 0xb3c0), ('adda', 0xd7c0)):
+    def b(s, m, base=base):
+        f, x = ea(m, 'l')
+        return [base | f] + x
+    family(n, 'l', SRC_ALL, b)
+
+for n, base in (('divu', 0x80c0), ('divs', 0x81c0), ('mulu', 0xc0c0), ('muls', 0xc1c0)):
+    def b(s, m, base=base):
+        f, x = ea(m, 'w')
+        return [base | f] + x
+    family(n, 'w', DIV_SRC if n.startswith('div') else SRC_DATA, b)
+
+for n, base in (('subx', 0x9101), ('addx', 0xd101)):
+    for s in 'bwl':
+        single('%s.%s' % (n, s), [base | (SIZES[s] << 6)])
+
+for s in 'bwl':
+    single('cmpm.%s' % s, [0xb108 | (SIZES[s] << 6)])
+
+single('exg', [0xc141])
+
+# Line e, shifts, rotates and bit fields
+for n, t in (('as', 0), ('ls', 1), ('rox', 2), ('ro', 3)):
+    for d, dn in (('r', 0), ('l', 1)):
+        for s in 'bwl':
+            single('%s%s.%s:imm' % (n, d, s), [0xe000 | (3 << 9) | (dn << 8) | (SIZES[s] << 6) | (t << 3)])
+            single('%s%s.%s:dn' % (n, d, s), [0xe000 | (1 << 9) | (dn << 8) | (SIZES[s] << 6) | (1 << 5) | (t << 3)])
+        def b(s, m, t=t, dn=dn):
+            f, x = ea(m, 'w', True)
+            return [0xe0c0 | (t << 9) | (dn << 8) | f] + x
+        family('%s%s_mem' % (n, d), 'w', DST_MEM, b)
+
+for n, base in (('bftst', 0xe8c0), ('bfextu', 0xe9c0), ('bfchg', 0xeac0), ('bfexts', 0xebc0),
+                ('bfclr', 0xecc0), ('bfffo', 0xedc0), ('bfset', 0xeec0), ('bfins', 0xefc0)):
+    def b(s, m, base=base):
+        f, x = ea(m, 'l', True)
+        return [base | f, 0x0108] + x           # d0{4:8}
+    family(n, [''], [ 'dn', 'ind', 'd16', 'd8x' ], b)
+
+# Line f, FPU
+FPU_SETUP = [ 0xf201, 0x4000, 0xf201, 0x4080 ]  # fmove.l d1,fp0 / fmove.l d1,fp1
+for n, op in (('fmove', 0x00), ('fint', 0x01), ('fsqrt', 0x04), ('fabs', 0x18), ('fneg', 0x1a),
+              ('fdiv', 0x20), ('fadd', 0x22), ('fmul', 0x23), ('fsub', 0x28), ('fcmp', 0x38), ('ftst', 0x3a)):
+    single('%s.x:fp' % n, [0xf200, 0x0400 | op], FPU_SETUP)
+    for m in SRC_DATA:
+        if m == 'imm':
+            continue
+        f, x = ea(m, 'l')
+        single('%s.d:%s' % (n, m) if m != 'dn' else '%s.l:dn' % n,
+            [0xf200 | f, 0x4000 | ((0 if m == 'dn' else 5) << 10) | op] + x, FPU_SETUP)
+
+for m in DST_MEM:
+    f, x = ea(m, 'l', True)
+    single('fmove.d_fp_ea:%s' % m, [0xf200 | f, 0x7400] + x, FPU_SETUP)
+
+def assemble(iterations):
+    code = []
+    kernels = []
+    calls = []
+
+    def here():
+        return 2 * len(code)
+
+    def long(value):
+        return [(value >> 16) & 0xffff, value & 0xffff]
+
+    # Main: warm up the print routine, then call every kernel
+    code += [0x7000, 0x61ff] + [0, 0]             # moveq #0,d0; bsr.l print
+    warmup = 1
+    for name, words, setup, count in FAMILIES:
+        calls.append(len(code))
+        code += [0x61ff, 0, 0]                    # bsr.l kernel
+    code += [0x4e75]
+
+    # Print d0 as "@XXXXXXXX\n" on PL011
+    print_at = here()
+    code += [0x49f9] + long(UART)                  # lea UART,a4
+    code += [0x18bc, 0x0040]                       # move.b #'@',(a4)
+    code += [0x7a07]                               # moveq #7,d5
+    loop = here()
+    code += [0xe998]                               # rol.l #4,d0
+    code += [0x1800]                               # move.b d0,d4
+    code += [0x0204, 0x000f]                       # andi.b #15,d4
+    code += [0x0604, 0x0030]                       # addi.b #'0',d4
+    code += [0x0c04, 0x0039]                       # cmpi.b #'9',d4
+    code += [0x6f02]                               # ble.s +2
+    code += [0x5e04]                               # addq.b #7,d4
+    code += [0x1884]                               # move.b d4,(a4)
+    code += [0x51cd, (loop - (here() + 2)) & 0xffff]   # dbf d5,loop
+    code += [0x18bc, 0x000a]                       # move.b #10,(a4)
+    code += [0x4e75]
+
+    for index, (name, words, setup, count) in enumerate(FAMILIES):
+        start = here()
+        patch = calls[index]
+        disp = start - (2 * patch + 2)
+        code[patch + 1:patch + 3] = long(disp & 0xffffffff)
+
+        lea_a1 = len(code)
+        code += [0x7203, 0x7400, 0x43fa, 0]        # moveq #3,d1; moveq #0,d2; lea data(pc),a1
+        code += setup or []
+        code += [0x2e3c] + long(iterations)        # move.l #iterations,d7
+        code += [0x4e7a, 0x00e1, 0x2c00]           # movec CNTVALLO,d0; move.l d0,d6
+
+        loop = here()
+        lea_a0 = len(code)
+        code += [0x41fa, 0]                        # lea data+DATA_SIZE/2(pc),a0
+        for i in range(REPEAT):
+            code += words
+        code += [0x5387]                           # subq.l #1,d7
+        code += [0x6600, (loop - (here() + 2)) & 0xffff]    # bne.w loop
+
+        code += [0x4e7a, 0x00e1, 0x9086]           # movec CNTVALLO,d0; sub.l d6,d0
+        code += [0x61ff] + long((print_at - (here() + 2)) & 0xffffffff)
+        code += [0x4e75]
+
+        data = here()
+        code[lea_a1 + 3] = (data - (2 * lea_a1 + 6)) & 0xffff
+        code[lea_a0 + 1] = (data + DATA_SIZE // 2 - (2 * lea_a0 + 2)) & 0xffff
+        code += [0x0101] * (DATA_SIZE // 2)
+
+        kernels.append((name, loop, count * REPEAT + 3))
+
+    code[warmup + 1:warmup + 3] = long((print_at - (2 * warmup + 2)) & 0xffffffff)
+
+    if len(code) & 1:
+        code.append(0x4e71)
+
+    return code, kernels
+
+def main():
+    if len(sys.argv) < 3:
+        print('usage: %s <output hunk> <output map> [iterations]' % sys.argv[0], file=sys.stderr)
+        return 1
+
+    iterations = int(sys.argv[3]) if len(sys.argv) > 3 else 1000
+    code, kernels = assemble(iterations)
+    longs = len(code) // 2
+
+    with open(sys.argv[1], 'wb') as f:
+        f.write(struct.pack('>IIIIII', 0x3f3, 0, 1, 0, 0, longs))
+        f.write(struct.pack('>II', 0x3e9, longs))
+        f.write(struct.pack('>%dH' % len(code), *code))
+        f.write(struct.pack('>I', 0x3f2))
+
+    with open(sys.argv[2], 'w') as f:
+        for name, offset, insns in kernels:
+            f.write('%s\t%d\t%d\n' % (name, offset, insns))
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
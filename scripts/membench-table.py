@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+#
+# Turns the output of examples/MemBench into a markdown table, one row per region and CACR
+# setting, bandwidths in MiB/s and chase latency in ns:
+#
+#   scripts/membench-table.py membench.log [more logs...]
+#
+# With several logs (e.g. before and after a change) rows of the same region, setting and
+# test are put next to each other, one column per log.
+import sys
+
+TESTS = ("read", "write", "copy", "chase")
+
+
+def parse(path):
+    results = {}
+    order = []
+    with open(path, "r", encoding="utf-8", errors="replace") as f:
+        for line in f:
+            fields = line.rstrip("\r\n").split("\t")
+            if line.startswith("#") or len(fields) != 7:
+                continue
+            region, base, _size, cacr, test, mib, ns = fields
+            key = (region, base, cacr)
+            if key not in results:
+                results[key] = {}
+                order.append(key)
+            results[key][test] = ns if test == "chase" else mib
+    return order, results
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: %s membench.log [more logs...]" % sys.argv[0], file=sys.stderr)
+        return 1
+
+    logs = [parse(p) for p in sys.argv[1:]]
+    order = []
+    for keys, _ in logs:
+        for key in keys:
+            if key not in order:
+                order.append(key)
+
+    header = ["region", "base", "cacr"]
+    for test in TESTS:
+        unit = "ns" if test == "chase" else "MiB/s"
+        for i in range(len(logs)):
+            suffix = " #%d" % (i + 1) if len(logs) > 1 else ""
+            header.append("%s %s%s" % (test, unit, suffix))
+
+    print("| " + " | ".join(header) + " |")
+    print("|" + "|".join("---" if i < 3 else "---:" for i in range(len(header))) + "|")
+    for key in order:
+        row = list(key)
+        for test in TESTS:
+            for _, results in logs:
+                row.append(results.get(key, {}).get(test, "-"))
+        print("| " + " | ".join(row) + " |")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
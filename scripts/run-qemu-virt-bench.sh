@@ -0,0 +1,159 @@
+#!/usr/bin/env bash
+#
+# JIT benchmark on the QEMU virt machine (TARGET=virt).
+#
+# Every payload from the examples is booted as initrd and the counters printed by Emu68 on
+# exit ("[JIT] Result: ...") are collected into one tab separated line per benchmark:
+#
+#   name  insn  us  cycles  cmiss  jchit  jcmiss  units  vhit
+#
+# Results go to stdout and, with EMU68_BENCH_OUTPUT set, into that file. When
+# EMU68_BENCH_BASELINE names a file written by an earlier run, m68k time of every benchmark is
+# compared against it and the script fails if any got slower by more than
+# EMU68_BENCH_TOLERANCE percent. Exit code 77 means the payloads are not built, see
+# examples/Makefile.
+#
+# With EMU68_QEMU_VIRTIO=1 the log goes through a virtio console instead of trapped PL011
+# writes, EMU68_QEMU_ACCEL=kvm runs the guest under KVM on AArch64 hosts (with -cpu host).
+set -euo pipefail
+
+script_dir="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+repo_dir="$(cd "${script_dir}/.." && pwd)"
+img="${1:-${repo_dir}/build-virt/Emu68.img}"
+payload_dir="${EMU68_BENCH_PAYLOADS:-${repo_dir}/Build}"
+benchmarks="${EMU68_BENCH_LIST:-Dhrystone Linpack SmallPT Buddha}"
+timeout_secs="${EMU68_QEMU_TIMEOUT:-300}"
+bootargs="${EMU68_QEMU_BOOTARGS:-console=ttyAMA0}"
+qemu_cpu="${EMU68_QEMU_CPU:-cortex-a72}"
+output="${EMU68_BENCH_OUTPUT:-}"
+baseline="${EMU68_BENCH_BASELINE:-}"
+tolerance="${EMU68_BENCH_TOLERANCE:-10}"
+virtio="${EMU68_QEMU_VIRTIO:-0}"
+accel="${EMU68_QEMU_ACCEL:-}"
+
+if [ "${accel}" = "kvm" ]; then
+    qemu_cpu="${EMU68_QEMU_CPU:-host}"
+fi
+
+for tool in qemu-system-aarch64 timeout mktemp awk; do
+    if ! command -v "${tool}" >/dev/null 2>&1; then
+        echo "missing required tool: ${tool}" >&2
+        exit 1
+    fi
+done
+
+if [ ! -f "${img}" ]; then
+    echo "missing image: ${img}" >&2
+    exit 1
+fi
+
+for bench in ${benchmarks}; do
+    if [ ! -f "${payload_dir}/${bench}" ]; then
+        echo "missing payload: ${payload_dir}/${bench}" >&2
+        exit 77
+    fi
+done
+
+if [ -n "${baseline}" ] && [ ! -f "${baseline}" ]; then
+    echo "missing baseline: ${baseline}" >&2
+    exit 1
+fi
+
+tmpdir="$(mktemp -d)"
+cleanup() {
+    rm -rf "${tmpdir}"
+}
+trap cleanup EXIT
+
+results="${tmpdir}/results.tsv"
+: > "${results}"
+
+for bench in ${benchmarks}; do
+    qemu_log="${tmpdir}/${bench}.log"
+
+    qemu_cmd=(
+        timeout "${timeout_secs}s" qemu-system-aarch64
+        -M virt
+        -cpu "${qemu_cpu}"
+        -m 1024
+        -kernel "${img}"
+        -initrd "${payload_dir}/${bench}"
+        -append "${bootargs}"
+        -display none
+        -monitor none
+    )
+
+    if [ -n "${accel}" ]; then
+        qemu_cmd+=(-accel "${accel}")
+    fi
+
+    # Boot messages before the virtio console is up still go to the PL011
+    if [ "${virtio}" = "1" ]; then
+        qemu_cmd+=(
+            -serial "file:${tmpdir}/${bench}.uart"
+            -global virtio-mmio.force-legacy=false
+            -chardev stdio,id=con0
+            -device virtio-serial-device
+            -device virtconsole,chardev=con0
+        )
+    else
+        qemu_cmd+=(-serial stdio)
+    fi
+
+    # Emu68 does not power off after the payload returns, stop qemu once the result is there
+    "${qemu_cmd[@]}" > "${qemu_log}" 2>&1 &
+    qemu_pid=$!
+    while kill -0 "${qemu_pid}" 2>/dev/null; do
+        if grep -Fq "[JIT] Result:" "${qemu_log}"; then
+            kill "${qemu_pid}" 2>/dev/null || true
+            break
+        fi
+        sleep 1
+    done
+
+    rc=0
+    wait "${qemu_pid}" || rc=$?
+
+    line="$(grep -F "[JIT] Result:" "${qemu_log}" | tail -n 1 || true)"
+    if [ -z "${line}" ]; then
+        cat "${qemu_log}" >&2
+        if [ "${rc}" -eq 124 ]; then
+            echo "${bench}: timed out after ${timeout_secs}s without result" >&2
+        else
+            echo "${bench}: no result, qemu exit code ${rc}" >&2
+        fi
+        exit 1
+    fi
+
+    printf '%s\t%s\n' "${bench}" "$(echo "${line}" | awk '{
+        for (i = 1; i <= NF; i++) {
+            if (split($i, kv, "=") == 2)
+                v[kv[1]] = kv[2]
+        }
+        printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s", v["insn"], v["us"], v["cycles"], v["cmiss"], v["jchit"], v["jcmiss"], v["units"], v["vhit"]
+    }')" >> "${results}"
+done
+
+printf '# name\tinsn\tus\tcycles\tcmiss\tjchit\tjcmiss\tunits\tvhit\n'
+cat "${results}"
+
+if [ -n "${output}" ]; then
+    cp "${results}" "${output}"
+fi
+
+if [ -n "${baseline}" ]; then
+    awk -F '\t' -v tol="${tolerance}" '
+        NR == FNR { if ($1 !~ /^#/) base[$1] = $3; next }
+        $1 in base && base[$1] > 0 {
+            pct = ($3 - base[$1]) * 100.0 / base[$1]
+            printf "%s: %d us, baseline %d us, %+.1f%%\n", $1, $3, base[$1], pct
+            if (pct > tol) slow = 1
+        }
+        END { exit slow }
+    ' "${baseline}" "${results}" || {
+        echo "benchmark slower than baseline by more than ${tolerance}%" >&2
+        exit 1
+    }
+fi
+
+exit 0
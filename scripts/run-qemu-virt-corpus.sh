@@ -0,0 +1,159 @@
+#!/usr/bin/env bash
+#
+# Per-opcode JIT scoreboard on the QEMU virt machine (TARGET=virt).
+#
+# The corpus from gen-jit-corpus.py is booted with jit_report on the command line. For every
+# kernel the steady state unit at its loop head is picked from the "[JIT] Unit:" lines and
+# reported together with the loop time printed by the kernel itself:
+#
+#   name  m68k  arm  ratio  flagstores  exits  ticks
+#
+# ratio is ARM instructions per m68k instruction without prologue and epilogue, ticks are
+# CNTVAL ticks of the whole loop. Results go to stdout and, with EMU68_CORPUS_OUTPUT set,
+# into that file. With EMU68_CORPUS_BASELINE naming a file of an earlier run, kernels whose
+# unit grew by more than EMU68_CORPUS_TOLERANCE percent are listed as BLOAT and the script
+# fails.
+set -euo pipefail
+
+script_dir="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+repo_dir="$(cd "${script_dir}/.." && pwd)"
+img="${1:-${repo_dir}/build-virt/Emu68.img}"
+iterations="${EMU68_CORPUS_ITERATIONS:-1000}"
+timeout_secs="${EMU68_QEMU_TIMEOUT:-600}"
+bootargs="${EMU68_QEMU_BOOTARGS:-console=ttyAMA0}"
+qemu_cpu="${EMU68_QEMU_CPU:-cortex-a72}"
+output="${EMU68_CORPUS_OUTPUT:-}"
+baseline="${EMU68_CORPUS_BASELINE:-}"
+tolerance="${EMU68_CORPUS_TOLERANCE:-0}"
+
+for tool in qemu-system-aarch64 python3 timeout mktemp awk; do
+    if ! command -v "${tool}" >/dev/null 2>&1; then
+        echo "missing required tool: ${tool}" >&2
+        exit 1
+    fi
+done
+
+if [ ! -f "${img}" ]; then
+    echo "missing image: ${img}" >&2
+    exit 1
+fi
+
+if [ -n "${baseline}" ] && [ ! -f "${baseline}" ]; then
+    echo "missing baseline: ${baseline}" >&2
+    exit 1
+fi
+
+tmpdir="$(mktemp -d)"
+cleanup() {
+    rm -rf "${tmpdir}"
+}
+trap cleanup EXIT
+
+corpus="${tmpdir}/corpus.hunk"
+corpus_map="${tmpdir}/corpus.map"
+qemu_log="${tmpdir}/qemu.log"
+results="${tmpdir}/results.tsv"
+
+python3 "${script_dir}/gen-jit-corpus.py" "${corpus}" "${corpus_map}" "${iterations}"
+
+qemu_cmd=(
+    timeout "${timeout_secs}s" qemu-system-aarch64
+    -M virt
+    -cpu "${qemu_cpu}"
+    -m 1024
+    -kernel "${img}"
+    -initrd "${corpus}"
+    -append "${bootargs} jit_report"
+    -display none
+    -serial stdio
+    -monitor none
+)
+
+# Emu68 does not power off after the payload returns, stop qemu once the result is there
+"${qemu_cmd[@]}" > "${qemu_log}" 2>&1 &
+qemu_pid=$!
+while kill -0 "${qemu_pid}" 2>/dev/null; do
+    if grep -Fq "[JIT] Result:" "${qemu_log}"; then
+        kill "${qemu_pid}" 2>/dev/null || true
+        break
+    fi
+    sleep 1
+done
+
+rc=0
+wait "${qemu_pid}" || rc=$?
+
+if ! grep -Fq "[JIT] Result:" "${qemu_log}"; then
+    tail -n 50 "${qemu_log}" >&2
+    echo "corpus did not finish, qemu exit code ${rc}" >&2
+    exit 1
+fi
+
+# First unit is the entry of the corpus, loop heads are relative to it. First time printed
+# comes from the warm up call of the print routine
+awk '
+    function hex(s,    i, r) {
+        r = 0
+        for (i = 1; i <= length(s); i++)
+            r = r * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1
+        return r
+    }
+    NR == FNR { name[NR] = $1; offset[NR] = $2; kernels = NR; next }
+    /\[JIT\] Unit:/ {
+        n = split($0, w, /[ =]+/)
+        for (i = 1; i < n; i++) v[w[i]] = w[i + 1]
+        pc = hex(v["pc"])
+        if (!have_base) { base = pc; have_base = 1 }
+        off = pc - base
+        unit_m68k[off] = v["m68k"]
+        unit_arm[off] = v["arm"]
+        unit_body[off] = v["arm"] - v["prologue"] - v["epilogue"]
+        unit_flags[off] = v["flagstores"]
+        unit_exits[off] = v["exits"]
+        next
+    }
+    {
+        while (match($0, /@[0-9A-F][0-9A-F][0-9A-F][0-9A-F][0-9A-F][0-9A-F][0-9A-F][0-9A-F]/)) {
+            ticks[times++] = hex(substr($0, RSTART + 1, 8))
+            $0 = substr($0, RSTART + RLENGTH)
+        }
+    }
+    END {
+        for (k = 1; k <= kernels; k++) {
+            off = offset[k]
+            if (!(off in unit_arm)) {
+                printf "%s\t-\t-\t-\t-\t-\t%s\n", name[k], (k in ticks) ? ticks[k] : "-"
+                continue
+            }
+            m = unit_m68k[off]
+            printf "%s\t%d\t%d\t%.2f\t%d\t%d\t%s\n", name[k], m, unit_arm[off],
+                m ? unit_body[off] / m : 0, unit_flags[off], unit_exits[off], (k in ticks) ? ticks[k] : "-"
+        }
+    }
+' FS='\t' "${corpus_map}" FS=' ' "${qemu_log}" > "${results}"
+
+printf '# name\tm68k\tarm\tratio\tflagstores\texits\tticks\n'
+cat "${results}"
+
+if [ -n "${output}" ]; then
+    cp "${results}" "${output}"
+fi
+
+if [ -n "${baseline}" ]; then
+    awk -F '\t' -v tol="${tolerance}" '
+        NR == FNR { if ($1 !~ /^#/ && $3 != "-") base[$1] = $3; next }
+        $1 in base && $3 != "-" && base[$1] > 0 {
+            pct = ($3 - base[$1]) * 100.0 / base[$1]
+            if (pct > tol) {
+                printf "BLOAT %s: %d ARM instructions, baseline %d, %+.1f%%\n", $1, $3, base[$1], pct
+                bloat++
+            }
+        }
+        END {
+            if (bloat) printf "%d kernels grew\n", bloat
+            exit bloat != 0
+        }
+    ' "${baseline}" "${results}" || exit 1
+fi
+
+exit 0
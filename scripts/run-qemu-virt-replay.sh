@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+#
+# Replays a bus log recorded on PiStorm (bus_record=<MiB>, saved with examples/BusLogSave) on
+# the QEMU virt machine (TARGET=virt):
+#
+#   scripts/run-qemu-virt-replay.sh buslog.bin [Emu68.img]
+#
+# The log is given as initrd, the kernel starts the m68k from the reset vectors of the recorded
+# ROM and serves every bus read from the log. The script stops qemu once the replay reports
+# completion and prints the summary line with the number of mismatching reads.
+set -euo pipefail
+
+script_dir="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+repo_dir="$(cd "${script_dir}/.." && pwd)"
+log="${1:-}"
+img="${2:-${repo_dir}/build-virt/Emu68.img}"
+timeout_secs="${EMU68_QEMU_TIMEOUT:-600}"
+bootargs="${EMU68_QEMU_BOOTARGS:-console=ttyAMA0}"
+qemu_cpu="${EMU68_QEMU_CPU:-cortex-a72}"
+qemu_mem="${EMU68_QEMU_MEM:-2048}"
+
+for tool in qemu-system-aarch64 timeout mktemp; do
+    if ! command -v "${tool}" >/dev/null 2>&1; then
+        echo "missing required tool: ${tool}" >&2
+        exit 1
+    fi
+done
+
+if [ -z "${log}" ] || [ ! -f "${log}" ]; then
+    echo "usage: $0 buslog.bin [Emu68.img]" >&2
+    exit 1
+fi
+
+if [ ! -f "${img}" ]; then
+    echo "missing image: ${img}" >&2
+    exit 1
+fi
+
+tmpdir="$(mktemp -d)"
+cleanup() {
+    rm -rf "${tmpdir}"
+}
+trap cleanup EXIT
+
+qemu_log="${tmpdir}/qemu.log"
+
+qemu_cmd=(
+    timeout "${timeout_secs}s" qemu-system-aarch64
+    -M virt
+    -cpu "${qemu_cpu}"
+    -m "${qemu_mem}"
+    -kernel "${img}"
+    -initrd "${log}"
+    -append "${bootargs}"
+    -display none
+    -serial stdio
+    -monitor none
+)
+
+# The m68k is stopped at the end of the log, stop qemu once the summary is there
+"${qemu_cmd[@]}" > "${qemu_log}" 2>&1 &
+qemu_pid=$!
+while kill -0 "${qemu_pid}" 2>/dev/null; do
+    if grep -Fq "[BUSLOG] Replay complete" "${qemu_log}"; then
+        kill "${qemu_pid}" 2>/dev/null || true
+        break
+    fi
+    sleep 1
+done
+
+rc=0
+wait "${qemu_pid}" || rc=$?
+
+if ! grep -Fq "[BUSLOG] Replay complete" "${qemu_log}"; then
+    tail -n 50 "${qemu_log}" >&2
+    echo "replay did not finish, qemu exit code ${rc}" >&2
+    exit 1
+fi
+
+grep -F "[BUSLOG]" "${qemu_log}"
+
+# Any mismatch means the replayed run left the recorded path
+grep -Fq "mismatches=0" "${qemu_log}"
@@ -243,13 +243,14 @@ int GetElfSize(void *file, uint32_t *size_rw, uint32_t *size_ro)
 static uintptr_t ptr_ro;
 static uintptr_t ptr_rw;
 
-static int loadHunk(void *mem, Elf32_Shdr *sh)
+/* Assign load address to the section, the contents are pulled later by loadHunk */
+static void placeHunk(Elf32_Shdr *sh)
 {
     void *ptr = (void *)0;
         
     /* empty chunk? Who cares :) */
     if (!sh->sh_size) 
-        return 1;
+        return;
         
     /* Allocate a chunk with write access */
     if (sh->sh_flags & SHF_WRITE)
@@ -267,11 +268,20 @@ static int loadHunk(void *mem, Elf32_Shdr *sh)
     }
         
     sh->sh_addr = (uintptr_t)ptr;
-        
-    /* copy block of memory from ELF file if it exists */
+}
+
+static int loadHunk(void *mem, Elf32_Shdr *sh)
+{
+    void *ptr = (void *)(uintptr_t)sh->sh_addr;
+
+    if (!sh->sh_size)
+        return 1;
+
+    /* copy block of memory from ELF file if it exists and is not at its place already */
     if (sh->sh_type != SHT_NOBITS)
     {       
-        memcpy(ptr, (void*)((uintptr_t)mem + sh->sh_offset), sh->sh_size);
+        if (ptr != (void*)((uintptr_t)mem + sh->sh_offset))
+            memcpy(ptr, (void*)((uintptr_t)mem + sh->sh_offset), sh->sh_size);
     }
     else
     {
@@ -383,9 +393,12 @@ void * LoadELFFile(void *mem, void *load_address)
         ptr_ro = (uintptr_t)load_address;
         ptr_rw = ptr_ro + ((size_ro + 4095) & ~4095);
 
+        /*
+            Place all sections first, symbol values depend on their addresses. Symbol, string
+            and relocation tables are used from the file directly.
+        */
         for (int i = 0; i < elf->e_shnum; i++)
         {
-            /* Load the symbol and string tables */
             if (sh[i].sh_type == SHT_SYMTAB || sh[i].sh_type == SHT_STRTAB)
             {
                 sh[i].sh_addr = ((uintptr_t)elf + sh[i].sh_offset);
@@ -393,32 +406,35 @@ void * LoadELFFile(void *mem, void *load_address)
             /* Does the section require memoy allcation? */
             else if (sh[i].sh_flags & SHF_ALLOC)
             {
-                /* Yup, it does. Load the hunk */
-                if (!loadHunk(mem, &sh[i]))
-                {
-                        return 0;
-                }
-                else
-                {
-                    if (sh[i].sh_size)
-                    {
-                        D(kprintf("[ELF] %s section loaded at %08x\n", 
-                                  sh[i].sh_flags & SHF_WRITE ? "RW":"RO",
-                                  (void*)(intptr_t)(sh[i].sh_addr)));
-                    }
-                }
+                placeHunk(&sh[i]);
             }
         }
 
-        /* For every loaded section perform the relocations */
+        /* Now load every section and relocate it right away, while its contents are still in cache */
         for (int i = 0; i < elf->e_shnum; i++)
         {
-            if (sh[i].sh_type == SHT_RELA && sh[sh[i].sh_info].sh_addr)
+            if (!(sh[i].sh_flags & SHF_ALLOC) || sh[i].sh_type == SHT_SYMTAB || sh[i].sh_type == SHT_STRTAB)
+                continue;
+
+            if (!loadHunk(mem, &sh[i]))
+                return 0;
+
+            if (!sh[i].sh_addr)
+                continue;
+
+            D(kprintf("[ELF] %s section loaded at %08x\n", 
+                      sh[i].sh_flags & SHF_WRITE ? "RW":"RO",
+                      (void*)(intptr_t)(sh[i].sh_addr)));
+
+            for (int j = 0; j < elf->e_shnum; j++)
             {
-                sh[i].sh_addr = ((intptr_t)elf + sh[i].sh_offset);
-                if (!sh[i].sh_addr || !relocate(elf, sh, i))
+                if (sh[j].sh_type == SHT_RELA && sh[j].sh_info == (Elf32_Word)i)
                 {
-                    return 0;
+                    sh[j].sh_addr = ((intptr_t)elf + sh[j].sh_offset);
+                    if (!relocate(elf, sh, j))
+                    {
+                        return 0;
+                    }
                 }
             }
         }
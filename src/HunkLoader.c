@@ -22,6 +22,24 @@ void * _my_malloc(size_t size)
 }
 #define malloc(s) _my_malloc(s)
 
+/*
+    Pull contents of one hunk. Only the part not covered by the file is cleared, the data
+    is not copied at all if the file lies at its load address already.
+*/
+static void LoadBlock(struct SegList *h, uint32_t *src, uint32_t count)
+{
+    uint32_t bytes = count * 4;
+
+    if (bytes > h->h_Size)
+        bytes = h->h_Size;
+
+    if (bytes && (void *)&h->h_Data != (void *)src)
+        memcpy((void *)&h->h_Data, src, bytes);
+
+    if (h->h_Size > bytes)
+        bzero((void *)((uintptr_t)&h->h_Data + bytes), h->h_Size - bytes);
+}
+
 uint32_t GetHunkFileSize(void *buffer)
 {
     uint32_t total_size = 0;
@@ -91,7 +109,6 @@ void * LoadHunkFile(void *buffer, void *p)
     {
         uint32_t size = 4 * (BE32(*words++) & 0x3fffffff);
         struct SegList *h = malloc(size + sizeof(struct SegList));
-        bzero(h, size + sizeof(struct SegList));
 
         h->h_Next = 0;
         h->h_Size = size;
@@ -129,7 +146,7 @@ void * LoadHunkFile(void *buffer, void *p)
                 {
                     D(kprintf("[HUNK] Loading block %d (code hunk) to %08x with size of %d words\n",
                         current_block, (void*)&h->h_Data, BE32(words[1])));
-                    DuffCopy((void*)&h->h_Data, &words[2], BE32(words[1]));
+                    LoadBlock(h, &words[2], BE32(words[1]));
                 }
                 else {
                     D(kprintf("[HUNK] Skipping block %d\n", current_block));
@@ -142,7 +159,7 @@ void * LoadHunkFile(void *buffer, void *p)
                 {
                     D(kprintf("[HUNK] Loading block %d (data hunk) to %08x with size of %d words\n",
                         current_block, (void*)h->h_Data, BE32(words[1])));
-                    DuffCopy((void*)&h->h_Data, &words[2], BE32(words[1]));
+                    LoadBlock(h, &words[2], BE32(words[1]));
                 }
                 else {
                     D(kprintf("[HUNK] Skipping block %d\n", current_block));
@@ -155,6 +172,7 @@ void * LoadHunkFile(void *buffer, void *p)
                 {
                     D(kprintf("[HUNK] Block %d (bss hunk) with size of %d words\n",
                         current_block, BE32(words[1])));
+                    LoadBlock(h, NULL, 0);
                 }
                 else {
                     D(kprintf("[HUNK] Skipping block %d\n", current_block));
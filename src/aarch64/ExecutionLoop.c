@@ -1,6 +1,8 @@
 #include <M68k.h>
 #include <support.h>
 #include <config.h>
+#include <buslog.h>
+#include <jitstats.h>
 #ifdef PISTORM
 #ifndef PISTORM32
 #define PS_PROTOCOL_IMPL
@@ -8,64 +10,270 @@
 #endif
 #endif
 
-extern struct List ICache[EMU68_HASHSIZE];
+extern struct M68KUnitLine UnitTable[EMU68_UNIT_TABLE_SIZE];
 void M68K_LoadContext(struct M68KState *ctx);
 void M68K_SaveContext(struct M68KState *ctx);
 
-static inline void CallARMCode()
+#if defined(PISTORM) && PISTORM_VECTOR_SHADOW
+extern uint32_t vector_shadow[256];
+extern uint32_t vector_shadow_valid[8];
+extern int fast_page0;
+
+/*
+    Interrupt vector at VBR 0 from the shadow copy, one slow bus read the first time. With
+    fast_page_zero or the m68k MMU page 0 is mapped and writes to it are not seen, no shadow then
+*/
+static inline uint16_t *VectorShadowFetch(uint32_t vector)
+{
+    uint32_t i = vector >> 2;
+
+    if (unlikely(!(vector_shadow_valid[i >> 5] & (1U << (i & 31)))))
+    {
+        uint32_t v;
+        asm volatile("ldr %w0, [%1]":"=r"(v):"r"((uintptr_t)vector));
+        vector_shadow[i] = v;
+        vector_shadow_valid[i >> 5] |= 1U << (i & 31);
+    }
+
+    return (uint16_t *)(uintptr_t)vector_shadow[i];
+}
+
+static inline int VectorShadowActive(uint32_t vbr)
+{
+#if EMU68_M68K_MMU
+    if (m68k_mmu_enabled)
+        return 0;
+#endif
+    return vbr == 0 && !fast_page0;
+}
+#endif
+
+#if EMU68_SHADOW_STACK
+/*
+    Interrupted PC goes onto the shadow stack together with its entry point from the jump cache,
+    so that the RTE of the handler can branch back without the main loop. Entry point missing
+    in the jump cache stays NULL until the unit is installed
+*/
+static inline void ShadowStack_PushException(struct M68KState *ctx, uint16_t *pc)
+{
+    struct M68KJumpCacheEntry *jc = &ctx->JIT_JCACHE[((uintptr_t)pc >> 1) & EMU68_JCACHE_MASK];
+    uint32_t top = (ctx->JIT_SSTACK_TOP + 1) & EMU68_SHADOW_STACK_MASK;
+
+    ctx->JIT_SSTACK_TOP = top;
+    ctx->JIT_SSTACK[top].ss_M68kAddress = (uint32_t)(uintptr_t)pc;
+    ctx->JIT_SSTACK[top].ss_Entry = jc->jc_M68kAddress == (uint32_t)(uintptr_t)pc ? jc->jc_Entry : NULL;
+}
+#endif
+
+#if EMU68_PMU_PROFILE
+static inline void PMU_Read(uint32_t *cnt)
+{
+    uint64_t tmp;
+
+    asm volatile("mrs %0, PMCCNTR_EL0":"=r"(tmp)); cnt[0] = tmp;
+    asm volatile("mrs %0, PMEVCNTR0_EL0":"=r"(tmp)); cnt[1] = tmp;
+    asm volatile("mrs %0, PMEVCNTR1_EL0":"=r"(tmp)); cnt[2] = tmp;
+    asm volatile("mrs %0, PMEVCNTR2_EL0":"=r"(tmp)); cnt[3] = tmp;
+    asm volatile("mrs %0, PMEVCNTR3_EL0":"=r"(tmp)); cnt[4] = tmp;
+}
+
+/*
+    Add counter deltas to the slot of the unit entered at pc. Runs inside the main loop with
+    m68k registers loaded, so no calls here. Most expensive slots are kept in pp_Top, sorted
+    by the number of cycles
+*/
+static inline void PMU_Account(uint32_t pc, const uint32_t *start)
+{
+    uint32_t now[PMU_COUNTERS];
+    uint32_t home = (pc >> 1) & (EMU68_PMU_SLOTS - 1);
+    struct PMUSlot *s = NULL;
+
+    PMU_Read(now);
+
+    for (int i=0; i < 8; i++)
+    {
+        struct PMUSlot *p = &pmu_state.pp_Slots[(home + i) & (EMU68_PMU_SLOTS - 1)];
+
+        if (p->pu_Address == pc || p->pu_Entries == 0)
+        {
+            s = p;
+            break;
+        }
+    }
+
+    if (s == NULL)
+    {
+        pmu_state.pp_Dropped++;
+        return;
+    }
+
+    s->pu_Address = pc;
+    s->pu_Entries++;
+    for (int i=0; i < PMU_COUNTERS; i++)
+        s->pu_Count[i] += now[i] - start[i];
+
+    /* Find the slot in the top list or take the last place if it beats the current owner */
+    int pos = EMU68_PMU_TOP - 1;
+    for (int i=0; i < EMU68_PMU_TOP; i++)
+    {
+        if (pmu_state.pp_Top[i] == s || pmu_state.pp_Top[i] == NULL)
+        {
+            pos = i;
+            break;
+        }
+    }
+
+    if (pmu_state.pp_Top[pos] != s)
+    {
+        if (pmu_state.pp_Top[pos] != NULL && pmu_state.pp_Top[pos]->pu_Count[0] >= s->pu_Count[0])
+            return;
+        pmu_state.pp_Top[pos] = s;
+    }
+
+    while (pos > 0 && pmu_state.pp_Top[pos - 1]->pu_Count[0] < s->pu_Count[0])
+    {
+        pmu_state.pp_Top[pos] = pmu_state.pp_Top[pos - 1];
+        pmu_state.pp_Top[--pos] = s;
+    }
+}
+#endif
+
+#if EMU68_LIGHT_MISS
+extern int debug;
+
+/*
+    Translate code at pc with m68k registers kept where they are. x19-x29 and the lower halves of
+    v8-v15 are preserved by the callee, x12 and q28-q31 are fixed in the whole build, so only
+    m68k registers in x13-x18 go onto the stack. SR stays in TPIDR_EL0
+*/
+static inline struct M68KTranslationUnit *TranslateKeepContext(uint16_t *pc)
+{
+    register uintptr_t x0 asm("x0") = (uintptr_t)pc;
+
+    asm volatile(
+        "stp x13, x14, [sp, #-48]!      \n"
+        "stp x15, x16, [sp, #16]        \n"
+        "stp x17, x18, [sp, #32]        \n"
+        "bl M68K_GetTranslationUnit     \n"
+        "ldp x17, x18, [sp, #32]        \n"
+        "ldp x15, x16, [sp, #16]        \n"
+        "ldp x13, x14, [sp], #48        \n"
+        :"+r"(x0)
+        :
+        :"x1","x2","x3","x4","x5","x6","x7","x8","x9","x10","x11","x30",
+         "v0","v1","v2","v3","v4","v5","v6","v7","v16","v17","v18","v19",
+         "v20","v21","v22","v23","v24","v25","v26","v27","cc","memory");
+
+    return (struct M68KTranslationUnit *)x0;
+}
+#endif
+
+/*
+    Call translated code. With block chaining the code returns pointer to the link
+    of the exit it has left through, or NULL if the exit target was not static
+*/
+static inline struct M68KChainLink *CallARMCode()
 {
     register void *ARM asm("x12");
     asm volatile("":"=r"(ARM));
+#if EMU68_BLOCK_CHAINING
+    struct M68KChainLink * (*ptr)() = (void*)ARM;
+#if EMU68_PMU_PROFILE
+    if (unlikely(pmu_profile))
+    {
+        register uint16_t *PC asm("x18");
+        uint32_t start[PMU_COUNTERS];
+        struct M68KChainLink *link;
+
+        asm volatile("":"=r"(PC));
+        uint32_t pc = (uint32_t)(uintptr_t)PC;
+
+        PMU_Read(start);
+        link = ptr();
+        PMU_Account(pc, start);
+
+        return link;
+    }
+#endif
+    return ptr();
+#else
     void (*ptr)() = (void*)ARM;
     ptr();
+    return NULL;
+#endif
 }
 
-static inline struct M68KTranslationUnit *FindUnit()
+/*
+    Find entry point of the unit translated from current PC. Only the lookup table
+    is touched, the hit costs a single cache line and no writes.
+*/
+static inline void *FindEntry()
 {
     register uint16_t *PC asm("x18");
     
-    /* Perform search */
-    uint32_t hash = (uint32_t)(uintptr_t)PC;
-    struct List *bucket = &ICache[(hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK];
-    struct M68KTranslationUnit *node;
-    
-    /* Go through the list of translated units */
-    ForeachNode(bucket, node)
+    /* Force reload of PC*/
+    asm volatile("":"=r"(PC));
+
+    uint32_t pc = (uint32_t)(uintptr_t)PC;
+    uint32_t line = (pc >> EMU68_HASHSHIFT) & EMU68_UNIT_TABLE_MASK;
+    struct M68KUnitLine *l;
+
+    do
     {
-        /* Force reload of PC*/
-        asm volatile("":"=r"(PC));
+        l = &UnitTable[line];
 
-        /* Check if unit is found */
-        if (node->mt_M68kAddress == PC)
+        for (int i=0; i < UNIT_LINE_SLOTS; i++)
         {
-#if 0
-            /* Move node to front of the list */
-            REMOVE(&node->mt_HashNode);
-            ADDHEAD(bucket, &node->mt_HashNode);
-#elif 0
-            struct Node *prev = node->mt_HashNode.ln_Pred;
-            struct Node *succ = node->mt_HashNode.ln_Succ;
-            struct Node *prevprev = prev->ln_Pred;
-            
-            /* If node is not head, then move it one level up */
-            if (prevprev != NULL)
-            {
-                node->mt_HashNode.ln_Pred = prevprev;
-                node->mt_HashNode.ln_Succ = prev;
+            if (l->ul_M68kAddress[i] == pc)
+                return l->ul_Entry[i];
+        }
+
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    } while (l->ul_Overflow != 0);
+
+    return NULL;
+}
 
-                prevprev->ln_Succ = &node->mt_HashNode;
+/*
+    Check the direct-mapped jump cache first, it resolves frequent indirect targets
+    (RTS, JMP (An), jump tables) with a single compare. On miss walk the lookup table
+    and refill the jump cache slot.
+*/
+static inline void *FindEntryCached(struct M68KState *ctx)
+{
+    register uint16_t *PC asm("x18");
 
-                prev->ln_Succ = succ;
-                prev->ln_Pred = &node->mt_HashNode;
+    /* Force reload of PC*/
+    asm volatile("":"=r"(PC));
 
-                succ->ln_Pred = prev;
-            }
-#endif                   
-            return node;    
-        }
+    uint32_t pc = (uint32_t)(uintptr_t)PC;
+    struct M68KJumpCacheEntry *jc = &ctx->JIT_JCACHE[(pc >> 1) & EMU68_JCACHE_MASK];
+
+    if (likely(jc->jc_M68kAddress == pc))
+    {
+        ctx->JIT_JCACHE_HIT++;
+        return jc->jc_Entry;
     }
 
-    return NULL;
+    ctx->JIT_JCACHE_MISS++;
+    JITStats_Dispatch(ctx->JIT_JCACHE_HIT, ctx->JIT_JCACHE_MISS);
+
+    void *entry = FindEntry();
+
+    if (entry != NULL)
+    {
+        jc->jc_M68kAddress = pc;
+        jc->jc_Entry = entry;
+    }
+
+    return entry;
+}
+
+static inline struct M68KTranslationUnit *FindUnit()
+{
+    void *entry = FindEntry();
+
+    return entry ? M68K_UnitFromEntry(entry) : NULL;
 }
 
 #ifdef PISTORM
@@ -89,6 +297,8 @@ static inline int GetIPLLevel()
 
     return (value >> 21) & 7;
 }
+#elif PISTORM_WRITE_COMBINE
+void flush_cdata();
 #endif
 #else
 static inline int GetIPLLevel() { return 0; }
@@ -131,6 +341,7 @@ void MainLoop()
     register void *ARM asm("x12");
     uint16_t *LastPC;
     struct M68KState *ctx = getCTX();
+    struct M68KChainLink *link = NULL;
     
     M68K_LoadContext(ctx);
 
@@ -143,6 +354,15 @@ void MainLoop()
         LastPC = getLastPC();
         ctx = getCTX();
 
+#if EMU68_ASYNC_INT
+        /*
+            Let chained code run until INT is signalled. The flag is set before INT is read,
+            a signal arriving in between clears it again. IRQs may have been masked by STOP
+        */
+        if (int_signal_gicc != NULL)
+            asm volatile("mov v29.s[3], %w0; msr daifclr, #2"::"r"(1):"memory");
+#endif
+
         /* If (unlikely) there was interrupt pending, check if it needs to be processed */
         if (unlikely(ctx->INT32 != 0))
         {
@@ -151,6 +371,34 @@ void MainLoop()
             uint32_t vector;
             uint32_t vbr;
 
+#if EMU68_ASYNC_INT && !defined(PISTORM32)
+            /* While INT is non-zero every exit returns here, same as when INT is polled */
+            M68K_SignalINT();
+#endif
+            /*
+                On PiStorm32 every change of the IPL level is signalled by SGI and every write to SR
+                leaves to the main loop. Chained code keeps running while the pending level is masked
+                or served, instead of returning here at each exit
+            */
+
+#if defined(PISTORM) && PISTORM_WARM_RESET
+            /* Reset line pulled by the keyboard, restart the m68k */
+            if (unlikely(ctx->INT.RESET))
+            {
+#if defined(PISTORM32) && PISTORM_WRITE_COMBINE
+                flush_cdata();
+#endif
+                M68K_SaveContext(ctx);
+                M68K_WarmReset(ctx);
+                M68K_LoadContext(getCTX());
+
+                LastPC = (uint16_t *)~0;
+                setLastPC(LastPC);
+                link = NULL;
+                continue;
+            }
+#endif
+
             /* Find out requested IPL level based on ARM state and real IPL line */
             if (ctx->INT.ARM_err)
             {
@@ -194,16 +442,50 @@ void MainLoop()
 #endif
             }
 
+#if EMU68_BUS_LOG
+            /* Levels seen by the m68k go to the bus log, a replay takes them from there */
+            if (unlikely(buslog_mode != BUSLOG_OFF))
+            {
+                uint64_t cnt;
+                asm volatile("mov %0, v30.d[0]":"=r"(cnt));
+
+                if (buslog_mode == BUSLOG_RECORD ? level != buslog_ipl : cnt >= buslog_next_ipl)
+                {
+                    M68K_SaveContext(ctx);
+                    BusLog_IPL(level);
+                    M68K_LoadContext(getCTX());
+                }
+
+                if (buslog_mode == BUSLOG_REPLAY)
+                    level = buslog_ipl;
+            }
+#endif
+
             /* Get SR and test the IPL mask value */
             SR = getSR();
 
             int IPL_mask = (SR & SR_IPL) >> SRB_IPL;
 
+#if defined(PISTORM) && PISTORM_STOP_WAKE
+            /* The housekeeper has woken STOP, time until the interrupt is taken is the wake-up latency */
+            if (unlikely(m68k_stop_event != 0))
+            {
+                if (level == 7 || level > IPL_mask)
+                    JITStats_StopWake(JITStats_Time() - m68k_stop_event);
+                m68k_stop_event = 0;
+            }
+#endif
+
             /* Any unmasked interrupts? Proceess them */
             if (level == 7 || level > IPL_mask)
             {
                 register uint64_t sp asm("r29");
 
+#if defined(PISTORM32) && PISTORM_WRITE_COMBINE
+                /* CHIP RAM stores held in the combining buffer have to be visible to the handler */
+                flush_cdata();
+#endif
+
                 if (likely((SR & SR_S) == 0))
                 {
                     /* If we are not yet in supervisor mode, the USP needs to be updated */
@@ -236,10 +518,13 @@ void MainLoop()
                 SR &= ~SR_IPL;
                 SR |= ((level & 7) << SRB_IPL);
 
-                /* Push exception frame */
-                asm volatile("strh %w1, [%0, #-8]!":"=r"(sp):"r"(SRcopy),"0"(sp));
-                asm volatile("str %w1, [%0, #2]"::"r"(sp),"r"(PC));
-                asm volatile("strh %w1, [%0, #6]"::"r"(sp),"r"(vector));
+                /* Push format 0 exception frame, SR, PC and vector in one big endian store */
+                uint64_t frame = ((uint64_t)(SRcopy & 0xffff) << 48) | ((uint64_t)(uint32_t)(uintptr_t)PC << 16) | vector;
+                asm volatile("str %1, [%0, #-8]!":"=r"(sp):"r"(frame),"0"(sp));
+
+#if EMU68_SHADOW_STACK
+                ShadowStack_PushException(ctx, PC);
+#endif
 
                 /* Set SR */
                 setSR(SR);
@@ -248,11 +533,100 @@ void MainLoop()
                 vbr = ctx->VBR;
 
                 /* Load PC */
+#if defined(PISTORM) && PISTORM_VECTOR_SHADOW
+                if (VectorShadowActive(vbr))
+                    PC = VectorShadowFetch(vector);
+                else
+#endif
                 asm volatile("ldr %w0, [%1, %2]":"=r"(PC):"r"(vbr),"r"(vector)); 
             }
 
             /* All interrupts masked or new PC loaded and stack swapped, continue with code execution */
         }
+#if EMU68_BUS_LOG
+        /* Level went back to zero while INT was clear, the recording has to know it too */
+        else if (unlikely(buslog_ipl != 0) && buslog_mode == BUSLOG_RECORD)
+        {
+            M68K_SaveContext(ctx);
+            BusLog_IPL(0);
+            M68K_LoadContext(getCTX());
+        }
+#endif
+
+#if EMU68_TRACE_CACHE
+        /* Trace mode, execute single instruction and take the trace exception after it */
+        if (unlikely(getSR() & SR_T1))
+        {
+            register uint64_t sp asm("r29");
+            uint32_t SR, SRcopy, vbr;
+            uint16_t *copyPC;
+            void *entry;
+
+            asm volatile("":"=r"(PC));
+            copyPC = PC;
+
+            M68K_SaveContext(ctx);
+            entry = M68K_GetTraceUnit(copyPC);
+            M68K_LoadContext(getCTX());
+
+            asm volatile("msr TPIDR_EL1, %0"::"r"(PC));
+#if EMU68_PROFILER
+            prof_mirror_pc = (uint32_t)(uintptr_t)copyPC;
+#endif
+            ARM = entry;
+            asm volatile("":"=r"(ARM):"0"(ARM));
+            CallARMCode();
+            link = NULL;
+
+            asm volatile("":"=r"(PC));
+            SR = getSR();
+
+#if defined(PISTORM32) && PISTORM_WRITE_COMBINE
+            flush_cdata();
+#endif
+
+            if (likely((SR & SR_S) == 0))
+            {
+                asm volatile("mov v31.S[1], %w0"::"r"(sp));
+
+                if (unlikely((SR & SR_M) != 0))
+                {
+                    asm volatile("mov %w0, v31.S[3]":"=r"(sp));
+                }
+                else
+                {
+                    asm volatile("mov %w0, v31.S[2]":"=r"(sp));
+                }
+            }
+
+            SRcopy = SR;
+            if ((SRcopy & 3) != 0 && (SRcopy & 3) != 3)
+                SRcopy ^= 3;
+
+            SR |= SR_S;
+            SR &= ~(SR_T0 | SR_T1);
+
+            /* Format 2 frame, SR, PC of the next instruction, vector and address of the traced one */
+            uint64_t frame = ((uint64_t)(SRcopy & 0xffff) << 48) | ((uint64_t)(uint32_t)(uintptr_t)PC << 16) | 0x2000 | VECTOR_TRACE;
+            asm volatile("str %w1, [%0, #-4]!":"=r"(sp):"r"((uint32_t)(uintptr_t)copyPC),"0"(sp));
+            asm volatile("str %1, [%0, #-8]!":"=r"(sp):"r"(frame),"0"(sp));
+
+            setSR(SR);
+
+            vbr = ctx->VBR;
+#if defined(PISTORM) && PISTORM_VECTOR_SHADOW
+            if (VectorShadowActive(vbr))
+                PC = VectorShadowFetch(VECTOR_TRACE);
+            else
+#endif
+            asm volatile("ldr %w0, [%1, %2]":"=r"(PC):"r"(vbr),"r"(VECTOR_TRACE));
+
+            /* The trace unit in x12 is not what FindEntryCached would return for PC */
+            setLastPC((uint16_t *)~0);
+
+            continue;
+        }
+#endif
 
         /* Check if JIT cache is enabled */
         uint32_t cacr;
@@ -263,30 +637,81 @@ void MainLoop()
             /* Force reload of PC*/
             asm volatile("":"=r"(PC));
 
+#if EMU68_TIERED_JIT
+            /* Hot tier 0 unit has returned its address instead of link, translate it again */
+            if (unlikely((uintptr_t)link & TIER_UP_FLAG))
+            {
+                M68K_SaveContext(ctx);
+                M68K_PromoteUnit((struct M68KTranslationUnit *)((uintptr_t)link & ~(uintptr_t)TIER_UP_FLAG));
+                M68K_LoadContext(getCTX());
+
+                /* The unit in x12 is gone */
+                LastPC = (uint16_t *)~0;
+                setLastPC(LastPC);
+                link = NULL;
+            }
+#endif
+
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+            /* Unit entered first time after soft flush, verify it before it is used again */
+            if (unlikely((uintptr_t)link & GENERATION_FLAG))
+            {
+                M68K_SaveContext(ctx);
+                M68K_RevalidateUnit((struct M68KTranslationUnit *)((uintptr_t)link & ~(uintptr_t)GENERATION_FLAG));
+                M68K_LoadContext(getCTX());
+
+                /* The unit in x12 might be gone */
+                LastPC = (uint16_t *)~0;
+                setLastPC(LastPC);
+                link = NULL;
+            }
+#endif
+
+            /*
+                Drop the link if it is chained already or PC was changed by an interrupt.
+                Links of indirect exits have no fixed target, M68K_ChainUnits selects the way.
+            */
+            if (link != NULL && link->ml_Guard == NULL && (link->ml_Target != NULL || link->ml_M68kTarget != PC))
+                link = NULL;
+
             /* The last PC is the same as currently set PC? */
-            if (LastPC == PC)
+            if (LastPC == PC && link == NULL)
             {
                 asm volatile("":"=r"(ARM));
                 /* Jump to the code now */
-                CallARMCode();
+                link = CallARMCode();
                 continue;
             }
             else
             {
-                /* Find unit in the hashtable based on the PC value */
-                struct M68KTranslationUnit *node = FindUnit();
+                /* Find unit in the jump cache or lookup table based on the PC value */
+                void *entry = FindEntryCached(ctx);
 
                 /* Unit exists ? */
-                if (node != NULL)
+                if (entry != NULL)
                 {
+                    /* Keeps the unit and its code segment away from the clock hand */
+                    M68K_UnitFromEntry(entry)->mt_UseCount++;
+
+                    /* Previous unit has left through static exit, chain it with this one */
+                    if (link != NULL)
+                    {
+                        M68K_SaveContext(ctx);
+                        M68K_ChainUnits(link, M68K_UnitFromEntry(entry));
+                        M68K_LoadContext(getCTX());
+                    }
+
                     /* Store m68k PC of corresponding ARM code in TPIDR_EL1 */
                     asm volatile("msr TPIDR_EL1, %0"::"r"(PC));
+#if EMU68_PROFILER
+                    prof_mirror_pc = (uint32_t)(uintptr_t)PC;
+#endif
 
                     /* This is the case, load entry point into x12 */
-                    ARM = node->mt_ARMEntryPoint;
+                    ARM = entry;
                     asm volatile("":"=r"(ARM):"0"(ARM));
                     
-                    CallARMCode();
+                    link = CallARMCode();
 
                     /* Go back to beginning of the loop */
                     continue;
@@ -295,16 +720,38 @@ void MainLoop()
                 /* If we are that far there was no JIT unit found */
                 asm volatile("":"=r"(PC));
                 uint16_t *copyPC = PC;
-                M68K_SaveContext(ctx);
-                /* Get the code. This never fails */
-                node = M68K_GetTranslationUnit(copyPC);
-                /* Load CPU context */
-                M68K_LoadContext(getCTX());
+                struct M68KTranslationUnit *node;
+#if EMU68_LIGHT_MISS
+                /* Context dump of the translator debug needs the registers in M68KState */
+                if (likely(debug < 2))
+                    node = TranslateKeepContext(copyPC);
+                else
+#endif
+                {
+                    M68K_SaveContext(ctx);
+                    /* Get the code. This never fails. It may evict the unit the link belongs to */
+                    node = M68K_GetTranslationUnit(copyPC);
+                    /* Load CPU context */
+                    M68K_LoadContext(getCTX());
+                }
                 asm volatile("msr TPIDR_EL1, %0"::"r"(PC));
+#if EMU68_PROFILER
+                prof_mirror_pc = (uint32_t)(uintptr_t)copyPC;
+#endif
+                /* Fresh unit is likely to be entered again, put it into the jump cache */
+#if EMU68_FIRST_RUN
+                /* Code in the scratch buffer is gone with the next translation */
+                if (node != &first_run_unit)
+#endif
+                {
+                    struct M68KJumpCacheEntry *jc = &ctx->JIT_JCACHE[((uint32_t)(uintptr_t)copyPC >> 1) & EMU68_JCACHE_MASK];
+                    jc->jc_M68kAddress = (uint32_t)(uintptr_t)copyPC;
+                    jc->jc_Entry = node->mt_ARMEntryPoint;
+                }
                 /* Prepare ARM pointer in x12 and call it */
                 ARM = node->mt_ARMEntryPoint;
                 asm volatile("":"=r"(ARM):"0"(ARM));
-                CallARMCode();
+                link = CallARMCode();
             }
         }
         else
@@ -335,6 +782,9 @@ void MainLoop()
             ARM = node->mt_ARMEntryPoint;
             asm volatile("":"=r"(ARM):"0"(ARM));
             CallARMCode();
+
+            /* Units may be released in uncached mode, do not chain */
+            link = NULL;
         }
     }
 }
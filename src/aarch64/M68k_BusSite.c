@@ -0,0 +1,236 @@
+/*
+    Copyright © 2020 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+
+#if EMU68_BUS_SITES
+
+/*
+    Bus sites are loads and stores of translated code which repeatedly end in a data abort,
+    because they access chipset, CIA or other memory emulated by the fault handler. Every
+    site is identified by the m68k PC of its instruction and the AArch64 opcode of the
+    access. When the instruction is translated again, each matching access is replaced by
+
+            stp     x0, x30, [sp, #-16]!
+            mov     x0, #SYSBusTrampoline
+            blr     x0
+            .word   <original load or store>
+            ldp     x0, x30, [sp], #16
+
+    The trampoline emulates the embedded access the same way the page fault handler does,
+    but without the cost of taking and returning from the exception. A learned site may be
+    shared by accesses to fast RAM, e.g. through an address register, so the call is guarded
+    by inline test of the base register for the 24-bit Amiga space.
+
+    Accesses to chipset and CIA registers with absolute address are known to be slow at
+    translation time already, the EA code emits them as unguarded bus calls right away.
+*/
+
+struct BusSite {
+    uint32_t    bs_M68kPC;
+    uint32_t    bs_Opcode;
+};
+
+#define BUS_SITE_PROBES     8
+#define BUS_PATCH_MAX       256
+
+static struct BusSite bus_sites[EMU68_BUS_SITE_SLOTS];
+static uint32_t bus_site_count;
+static uint32_t patch_buffer[BUS_PATCH_MAX];
+
+static inline uint32_t BusSite_Home(uint32_t m68k_pc)
+{
+    return (m68k_pc >> 1) & (EMU68_BUS_SITE_SLOTS - 1);
+}
+
+/* Integer loads and stores with immediate or register offset, the fault handler knows all of them */
+static int IsPatchable(uint32_t insn)
+{
+    uint8_t size = insn >> 30;
+    uint8_t opc = (insn >> 22) & 3;
+
+    /* SP never reaches the bus, x30 holds return address inside the trampoline */
+    if (((insn >> 5) & 31) == 31 || ((insn >> 5) & 31) == 30 || (insn & 31) == 30)
+        return 0;
+
+    /* PRFM and unallocated encodings */
+    if (size >= 2 && opc >= 2 && !(size == 2 && opc == 2))
+        return 0;
+
+    /* Unsigned offset */
+    if ((insn & 0x3f000000) == 0x39000000)
+        return 1;
+
+    /* Unscaled, post- and pre-index. Unprivileged forms are not used by the JIT */
+    if ((insn & 0x3f200000) == 0x38000000)
+        return ((insn >> 10) & 3) != 2;
+
+    /* Register offset */
+    if ((insn & 0x3f200c00) == 0x38200800)
+        return ((insn >> 16) & 31) != 30;
+
+    return 0;
+}
+
+/* Remember new bus site. Returns 0 if the site was known already or table is full */
+int M68K_AddBusSite(uint16_t *m68k_pc, uint32_t opcode)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)m68k_pc;
+    uint32_t slot = BusSite_Home(pc);
+
+    if (!IsPatchable(opcode))
+        return 0;
+
+    for (int i=0; i < BUS_SITE_PROBES; i++)
+    {
+        struct BusSite *s = &bus_sites[(slot + i) & (EMU68_BUS_SITE_SLOTS - 1)];
+
+        if (s->bs_M68kPC == pc && s->bs_Opcode == opcode)
+            return 0;
+
+        if (s->bs_M68kPC == 0)
+        {
+            s->bs_Opcode = opcode;
+            s->bs_M68kPC = pc;
+            bus_site_count++;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Address of chipset or CIA register. These are never mapped, accesses always go to the bus */
+int M68K_IsBusAddress(uint32_t address)
+{
+#ifdef PISTORM
+    if (address >= 0x00bfd000 && address < 0x00bff000)
+        return 1;
+    if (address >= 0x00dff000 && address < 0x00e00000)
+        return 1;
+#else
+    (void)address;
+#endif
+    return 0;
+}
+
+static uint32_t *EmitBusCall(uint32_t *out, uint32_t insn)
+{
+    uintptr_t tramp = (uintptr_t)SYSBusTrampoline;
+
+    *out++ = mov64_immed_u16(0, tramp & 0xffff, 0);
+    *out++ = movk64_immed_u16(0, (tramp >> 16) & 0xffff, 1);
+    *out++ = movk64_immed_u16(0, (tramp >> 32) & 0xffff, 2);
+    *out++ = movk64_immed_u16(0, (tramp >> 48) & 0xffff, 3);
+    *out++ = blr(0);
+    *out++ = insn;
+    *out++ = ldp64_postindex(31, 0, 30, 16);
+
+    return out;
+}
+
+/*
+    Turn the load or store just emitted at ptr[-1] into an unguarded bus call. Returns new
+    end of the code, the code is unchanged if the access cannot be handled by trampoline.
+*/
+uint32_t *EMIT_BusAccess(uint32_t *ptr)
+{
+    uint32_t insn = ptr[-1];
+
+    if (!IsPatchable(INSN_TO_LE(insn)))
+        return ptr;
+
+    ptr[-1] = stp64_preindex(31, 0, 30, -16);
+
+    return EmitBusCall(ptr, insn);
+}
+
+static int IsBusSite(uint32_t pc, uint32_t opcode)
+{
+    uint32_t slot = BusSite_Home(pc);
+
+    for (int i=0; i < BUS_SITE_PROBES; i++)
+    {
+        struct BusSite *s = &bus_sites[(slot + i) & (EMU68_BUS_SITE_SLOTS - 1)];
+
+        if (s->bs_M68kPC == 0)
+            break;
+
+        if (s->bs_M68kPC == pc && s->bs_Opcode == opcode)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+    Patch bus sites in code emitted for the m68k instruction at m68k_pc, range start..end.
+    Like the peephole pass, code with branches, literals or exit markers is left alone.
+    Returns new end of the code.
+*/
+uint32_t *M68K_PatchBusSites(uint32_t *start, uint32_t *end, uint16_t *m68k_pc)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)m68k_pc;
+    uint32_t length = end - start;
+    uint32_t *out = start;
+    int found = 0;
+
+    if (bus_site_count == 0 || length > BUS_PATCH_MAX)
+        return end;
+
+    for (uint32_t *p = start; p < end; p++)
+    {
+        uint32_t insn = INSN_TO_LE(*p);
+
+        if ((insn & 0xfffffff0) == 0xfffffff0)
+            return end;
+        if ((insn & 0x1c000000) == 0x14000000 && (insn & 0xffc00000) != 0xd5000000)
+            return end;
+        if ((insn & 0x1f000000) == 0x10000000 || (insn & 0x3b000000) == 0x18000000)
+            return end;
+        if ((insn & 0x18000000) == 0)
+            return end;
+
+        if (IsPatchable(insn) && IsBusSite(pc, insn))
+            found = 1;
+    }
+
+    if (!found)
+        return end;
+
+    for (uint32_t i=0; i < length; i++)
+        patch_buffer[i] = start[i];
+
+    for (uint32_t i=0; i < length; i++)
+    {
+        uint32_t insn = INSN_TO_LE(patch_buffer[i]);
+
+        if (IsPatchable(insn) && IsBusSite(pc, insn))
+        {
+            /* Base above 24-bit space is fast RAM, do the access directly */
+            *out++ = stp64_preindex(31, 0, 30, -16);
+            *out++ = lsr(0, (insn >> 5) & 31, 24);
+            *out++ = cbz(0, 4);
+            *out++ = ldp64_postindex(31, 0, 30, 16);
+            *out++ = patch_buffer[i];
+            *out++ = b(8);
+            out = EmitBusCall(out, patch_buffer[i]);
+        }
+        else
+        {
+            *out++ = patch_buffer[i];
+        }
+    }
+
+    return out;
+}
+
+#endif
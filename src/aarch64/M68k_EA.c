@@ -497,6 +497,85 @@ static inline __attribute__((always_inline)) uint32_t * store_reg_to_addr(uint32
 #define M68K_EA_BD_SIZE 0x0030
 #define M68K_EA_IIS 0x0007
 
+/*
+    Base plus scaled index of a brief extension word in a single add, a word index is sign
+    extended by the add itself. The displacement is left for the load or store offset.
+*/
+static inline __attribute__((always_inline)) uint32_t * brief_index_add(uint32_t *ptr, uint8_t dest, uint8_t base, uint16_t brief)
+{
+    uint8_t index = RA_MapM68kRegister(&ptr, ((brief & M68K_EA_DA) ? 8 : 0) + ((brief & M68K_EA_REG) >> 12));
+    uint8_t shift = (brief & M68K_EA_SCALE) >> 9;
+
+    if (brief & M68K_EA_WL)
+        *ptr++ = add_reg(dest, base, index, LSL, shift);
+    else
+        *ptr++ = add_reg_ext(dest, base, index, SXTH, shift);
+
+    RA_FreeARMRegister(&ptr, index);
+
+    return ptr;
+}
+
+/*
+    (An,Xn.L) without displacement and scale, the index is the register offset of the access.
+    A sum above 4GB lands in the +4GB shadow of the m68k space.
+*/
+static inline __attribute__((always_inline)) uint32_t * load_reg_from_addr_index(uint32_t *ptr, uint8_t size, uint8_t base, uint8_t reg, uint16_t brief, int sign_ext)
+{
+    uint8_t index = RA_MapM68kRegister(&ptr, ((brief & M68K_EA_DA) ? 8 : 0) + ((brief & M68K_EA_REG) >> 12));
+
+    switch (size)
+    {
+        case 4:
+            *ptr++ = ldr_regoffset(base, reg, index, UXTW, 0);
+            break;
+        case 2:
+            if (sign_ext)
+                *ptr++ = ldrsh_regoffset(base, reg, index, UXTW, 0);
+            else
+                *ptr++ = ldrh_regoffset(base, reg, index, UXTW, 0);
+            break;
+        case 1:
+            if (sign_ext)
+                *ptr++ = ldrsb_regoffset(base, reg, index, UXTW);
+            else
+                *ptr++ = ldrb_regoffset(base, reg, index, UXTW);
+            break;
+        default:
+            kprintf("Unknown size opcode\n");
+            break;
+    }
+
+    RA_FreeARMRegister(&ptr, index);
+
+    return ptr;
+}
+
+static inline __attribute__((always_inline)) uint32_t * store_reg_to_addr_index(uint32_t *ptr, uint8_t size, uint8_t base, uint8_t reg, uint16_t brief)
+{
+    uint8_t index = RA_MapM68kRegister(&ptr, ((brief & M68K_EA_DA) ? 8 : 0) + ((brief & M68K_EA_REG) >> 12));
+
+    switch (size)
+    {
+        case 4:
+            *ptr++ = str_regoffset(base, reg, index, UXTW, 0);
+            break;
+        case 2:
+            *ptr++ = strh_regoffset(base, reg, index, UXTW, 0);
+            break;
+        case 1:
+            *ptr++ = strb_regoffset(base, reg, index, UXTW);
+            break;
+        default:
+            kprintf("Unknown size opcode\n");
+            break;
+    }
+
+    RA_FreeARMRegister(&ptr, index);
+
+    return ptr;
+}
+
 /*
     Emits ARM insns to load effective address and read value from ther to specified register.
 
@@ -523,6 +602,7 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
     uint8_t sign_ext = 0;
     uint8_t mode = ea >> 3;
     uint8_t src_reg = ea & 7;
+    uint8_t own_reg = 0;
 
     if (size & 0x80)
     {
@@ -570,7 +650,7 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                 }
                 break;
             case 0:
-                kprintf("Load form EA: Dn with wrong operand size! Opcode %04x at %08x\n", cache_read_16(ICACHE, (uint32_t)(uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
+                kprintf("Load form EA: Dn with wrong operand size! Opcode %04x at %08x\n", cache_fetch_16((uint32_t)(uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
                 break;
             default:
                 kprintf("Wrong size\n");
@@ -601,7 +681,7 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                 }
                 break;
             case 0:
-                kprintf("Load form EA: An with wrong operand size! Opcode %04x at %08x\n", cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
+                kprintf("Load form EA: An with wrong operand size! Opcode %04x at %08x\n", cache_fetch_16((uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
                 {
                     uint16_t *ptr = &m68k_ptr[-*ext_words] - 8;
                     for (int i=0; i < 16; i++)
@@ -617,7 +697,10 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
     else
     {
         if (*arm_reg == 0xff)
+        {
+            own_reg = 1;
             *arm_reg = RA_AllocARMRegister(&ptr);
+        }
 
         if (mode == 2) /* Mode 002: (An) */
         {
@@ -658,6 +741,10 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
         }
         else if (mode == 3) /* Mode 003: (An)+ */
         {
+#if EMU68_LOOP_PREFETCH
+            if (src_reg != 7)
+                loop_stride_inc |= 1 << src_reg;
+#endif
             if (size == 0) {
                 RA_FreeARMRegister(&ptr, *arm_reg);
                 *arm_reg = RA_MapM68kRegister(&ptr, src_reg + 8);
@@ -706,6 +793,10 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
         }
         else if (mode == 4) /* Mode 004: -(An) */
         {
+#if EMU68_LOOP_PREFETCH
+            if (src_reg != 7)
+                loop_stride_dec |= 1 << src_reg;
+#endif
             if (size == 0) {
                 RA_FreeARMRegister(&ptr, *arm_reg);
                 *arm_reg = RA_MapM68kRegister(&ptr, src_reg + 8);
@@ -757,69 +848,42 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
             {
                 RA_FreeARMRegister(&ptr, *arm_reg);
                 *arm_reg = RA_MapM68kRegister(&ptr, src_reg + 8);
-                *imm_offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                *imm_offset = (int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
             }
             else
             {
                 uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
-                int16_t off16 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                int16_t off16 = (int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 ptr = load_reg_from_addr_offset(ptr, size, reg_An, *arm_reg, off16, 0, sign_ext);
             }
         }
         else if (mode == 6) /* Mode 006: (d8, An, Xn.SIZE*SCALE) */
         {
-            uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+            uint16_t brief = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
             uint8_t extra_reg = (brief >> 12) & 7;
 
             if ((brief & 0x0100) == 0)
             {
                 uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
-                uint8_t tmp1 = 0xff;
-                uint8_t tmp2 = 0xff;
                 int8_t displ = brief & 0xff;
 
-                if (displ > 0)
-                {
-                    tmp1 = RA_AllocARMRegister(&ptr);
-                    *ptr++ = add_immed(tmp1, reg_An, displ);
-                }
-                else if (displ < 0)
-                {
-                    tmp1 = RA_AllocARMRegister(&ptr);
-                    *ptr++ = sub_immed(tmp1, reg_An, -displ);
-                }
-                else
-                {
-                    //*ptr++ = mov_reg(tmp1, reg_An);
-                }
-
-                if (brief & (1 << 11))
+                if (size != 0 && displ == 0 && (brief & (M68K_EA_WL | M68K_EA_SCALE)) == M68K_EA_WL)
                 {
-                    if (brief & 0x8000)
-                        tmp2 = RA_MapM68kRegister(&ptr, 8 + extra_reg); // RA_CopyFromM68kRegister(&ptr, 8 + extra_reg);
-                    else
-                        tmp2 = RA_MapM68kRegister(&ptr, extra_reg); // RA_CopyFromM68kRegister(&ptr, extra_reg);
+                    ptr = load_reg_from_addr_index(ptr, size, reg_An, *arm_reg, brief, sign_ext);
                 }
                 else
                 {
-                    if (brief & 0x8000)
-                        tmp2 = RA_MapM68kRegister(&ptr, 8 + extra_reg);
-                    else
-                        tmp2 = RA_MapM68kRegister(&ptr, extra_reg);
-                    
-                    uint8_t tmp3 = RA_AllocARMRegister(&ptr);
-                    *ptr++ = sxth(tmp3, tmp2);
-                    RA_FreeARMRegister(&ptr, tmp2);
-                    tmp2 = tmp3;
-                }
+                    uint8_t addr = (size == 0 && displ == 0) ? *arm_reg : RA_AllocARMRegister(&ptr);
 
-                ptr = load_reg_from_addr(ptr, size, displ ? tmp1 : reg_An, *arm_reg, tmp2, (brief >> 9) & 3, sign_ext);
+                    ptr = brief_index_add(ptr, addr, reg_An, brief);
 
-                if (displ)
-                    RA_FreeARMRegister(&ptr, tmp1);
-
-                RA_FreeARMRegister(&ptr, tmp2);
+                    if (addr != *arm_reg)
+                    {
+                        ptr = load_reg_from_addr_offset(ptr, size, addr, *arm_reg, displ, 0, sign_ext);
+                        RA_FreeARMRegister(&ptr, addr);
+                    }
+                }
             }
             else
             {
@@ -867,13 +931,13 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                 {
                     case 2: /* Word displacement */
                         bd_reg = RA_AllocARMRegister(&ptr);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         ptr = load_s16_ext32(ptr, bd_reg, lo16);
                         break;
                     case 3: /* Long displacement */
                         bd_reg = RA_AllocARMRegister(&ptr);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         *ptr++ = movw_immed_u16(bd_reg, lo16);
                         if (hi16 != 0)
                             *ptr++ = movt_immed_u16(bd_reg, hi16);
@@ -885,13 +949,13 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                 {
                     case 2: /* Word outer displacement */
                         outer_reg = RA_AllocARMRegister(&ptr);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         ptr = load_s16_ext32(ptr, outer_reg, lo16);
                         break;
                     case 3: /* Long outer displacement */
                         outer_reg = RA_AllocARMRegister(&ptr);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         *ptr++ = movw_immed_u16(outer_reg, lo16);
                         if (hi16 != 0)
                             *ptr++ = movt_immed_u16(outer_reg, hi16);
@@ -987,67 +1051,34 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                     ptr = EMIT_GetOffsetPC(ptr, &off8);
                     RA_FreeARMRegister(&ptr, *arm_reg);
                     *arm_reg = REG_PC;
-                    *imm_offset = off8 + (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                    *imm_offset = off8 + (int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 }
                 else
                 {
                     int8_t off8 = 2 + 2*(*ext_words);
                     ptr = EMIT_GetOffsetPC(ptr, &off8);
-                    int32_t off = off8 + (int16_t)(cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]));
+                    int32_t off = off8 + (int16_t)(cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]));
 
                     ptr = load_reg_from_addr_offset(ptr, size, REG_PC, *arm_reg, off, 1, sign_ext);
                 }
             }
             else if (src_reg == 3)
             {
-                uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                uint16_t brief = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 uint8_t extra_reg = (brief >> 12) & 7;
 
                 if ((brief & 0x0100) == 0)
                 {
-                    uint8_t tmp1 = RA_AllocARMRegister(&ptr);
-                    uint8_t tmp2 = 0xff;
+                    uint8_t addr = RA_AllocARMRegister(&ptr);
                     int8_t displ = brief & 0xff;
                     int8_t off = 2 + 2*(*ext_words - 1);
-                    int16_t full_off = 0;
                     ptr = EMIT_GetOffsetPC(ptr, &off);
 
-                    full_off = off + displ;
+                    /* PC offset and displacement go to the load */
+                    ptr = brief_index_add(ptr, addr, REG_PC, brief);
+                    ptr = load_reg_from_addr_offset(ptr, size, addr, *arm_reg, off + displ, 0, sign_ext);
 
-                    if (full_off >= 0)
-                    {
-                        *ptr++ = add_immed(tmp1, REG_PC, full_off);
-                    }
-                    else
-                    {
-                        *ptr++ = sub_immed(tmp1, REG_PC, -full_off);
-                    }
-
-                    if (brief & (1 << 11))
-                    {
-                        if (brief & 0x8000)
-                            tmp2 = RA_MapM68kRegister(&ptr, 8 + extra_reg); // RA_CopyFromM68kRegister(&ptr, 8 + extra_reg);
-                        else
-                            tmp2 = RA_MapM68kRegister(&ptr, extra_reg); // RA_CopyFromM68kRegister(&ptr, extra_reg);
-                    }
-                    else
-                    {
-                        if (brief & 0x8000)
-                            tmp2 = RA_MapM68kRegister(&ptr, 8 + extra_reg);
-                        else
-                            tmp2 = RA_MapM68kRegister(&ptr, extra_reg);
-
-                        uint8_t tmp3 = RA_AllocARMRegister(&ptr);
-                        *ptr++ = sxth(tmp3, tmp2);
-
-                        RA_FreeARMRegister(&ptr, tmp2);
-                        tmp2 = tmp3;
-                    }
-
-                    ptr = load_reg_from_addr(ptr, size, tmp1, *arm_reg, tmp2, (brief >> 9) & 3, sign_ext);
-
-                    RA_FreeARMRegister(&ptr, tmp1);
-                    RA_FreeARMRegister(&ptr, tmp2);
+                    RA_FreeARMRegister(&ptr, addr);
                 }
                 else
                 {
@@ -1235,11 +1266,18 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
             else if (src_reg == 0)
             {
                 uint16_t lo16;
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+
+                int32_t base_off = 0;
+                uint8_t base_reg = size ? RA_GetConstBase(&ptr, (int16_t)lo16, &base_off) : 0xff;
 
                 if (size == 0) {
                     ptr = load_s16_ext32(ptr, *arm_reg, lo16);
                 }
+                else if (base_reg != 0xff)
+                {
+                    ptr = load_reg_from_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0, sign_ext);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -1247,12 +1285,18 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                     ptr = load_reg_from_addr_offset(ptr, size, tmp_reg, *arm_reg, 0, 0, sign_ext);
                     RA_FreeARMRegister(&ptr, tmp_reg);
                 }
+#if EMU68_BUS_SITES
+                if (size != 0 && M68K_IsBusAddress((int16_t)lo16))
+                    ptr = EMIT_BusAccess(ptr);
+#endif
             }
             else if (src_reg == 1)
             {
                 uint16_t hi16, lo16;
-                hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                int32_t base_off = 0;
+                uint8_t base_reg;
 
                 if (size == 0) {
                     if (lo16 == 0 && hi16 == 0)
@@ -1270,6 +1314,10 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                         *ptr++ = mov_immed_u16(*arm_reg, hi16, 1);
                     }
                 }
+                else if ((base_reg = RA_GetConstBase(&ptr, ((uint32_t)hi16 << 16) | lo16, &base_off)) != 0xff)
+                {
+                    ptr = load_reg_from_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0, sign_ext);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -1309,16 +1357,55 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                     }
                     RA_FreeARMRegister(&ptr, tmp_reg);
                 }
+#if EMU68_BUS_SITES
+                if (size != 0 && M68K_IsBusAddress(((uint32_t)hi16 << 16) | lo16))
+                    ptr = EMIT_BusAccess(ptr);
+#endif
             }
             else if (src_reg == 4)
             {
                 int8_t pc_off;
                 uint16_t lo16, hi16, off;
+                uint32_t value = 0;
+
+                /* Immediate kept from earlier instruction. The caller promised not to change it */
+                if (size != 0 && own_reg && read_only)
+                {
+                    switch (size)
+                    {
+                        case 4:
+                            value = (cache_fetch_16((uintptr_t)&m68k_ptr[*ext_words]) << 16) |
+                                     cache_fetch_16((uintptr_t)&m68k_ptr[*ext_words + 1]);
+                            break;
+                        case 2:
+                            value = cache_fetch_16((uintptr_t)&m68k_ptr[*ext_words]);
+                            if (sign_ext)
+                                value = (int16_t)value;
+                            break;
+                        case 1:
+                            value = cache_fetch_16((uintptr_t)&m68k_ptr[*ext_words]) & 0xff;
+                            if (sign_ext)
+                                value = (int8_t)value;
+                            break;
+                    }
+
+                    uint8_t cached = RA_GetCachedConst(&ptr, value);
+
+                    if (cached != 0xff)
+                    {
+                        RA_FreeARMRegister(&ptr, *arm_reg);
+                        *arm_reg = cached;
+                        *ext_words += (size == 4) ? 2 : 1;
+
+                        return ptr;
+                    }
+                }
+
                 switch (size)
                 {
                     case 4:
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                         if (lo16 == 0 && hi16 == 0)
                         {
@@ -1336,7 +1423,7 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                         }
                         break;
                     case 2:
-                        off = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        off = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                         if (sign_ext && (off & 0x8000))
                             *ptr++ = movn_immed_u16(*arm_reg, ~off, 0);
@@ -1344,7 +1431,7 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                             *ptr++ = mov_immed_u16(*arm_reg, off, 0);
                         break;
                     case 1:
-                        off = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]) & 0xff;
+                        off = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]) & 0xff;
                         if (sign_ext && (off & 0x80))
                             *ptr++ = movn_immed_u16(*arm_reg, ~(off | 0xff00), 0);
                         else
@@ -1356,6 +1443,9 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                         *ptr++ = add_immed(*arm_reg, REG_PC, pc_off);
                         break;
                 }
+
+                if (size != 0 && own_reg && read_only)
+                    RA_SetCachedConst(&ptr, *arm_reg, value);
             }
         }
     }
@@ -1480,6 +1570,10 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
         }
         else if (mode == 3) /* Mode 003: (An)+ */
         {
+#if EMU68_LOOP_PREFETCH
+            if (src_reg != 7)
+                loop_stride_inc |= 1 << src_reg;
+#endif
             if (size == 0) {
                 RA_FreeARMRegister(&ptr, *arm_reg);
                 *arm_reg = RA_MapM68kRegister(&ptr, src_reg + 8);
@@ -1512,6 +1606,10 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
         }
         else if (mode == 4) /* Mode 004: -(An) */
         {
+#if EMU68_LOOP_PREFETCH
+            if (src_reg != 7)
+                loop_stride_dec |= 1 << src_reg;
+#endif
             if (size == 0) {
                 RA_FreeARMRegister(&ptr, *arm_reg);
                 *arm_reg = RA_MapM68kRegister(&ptr, src_reg + 8);
@@ -1545,58 +1643,36 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
         else if (mode == 5) /* Mode 005: (d16, An) */
         {
             uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
-            int16_t off16 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+            int16_t off16 = (int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
             ptr = store_reg_to_addr_offset(ptr, size, reg_An, *arm_reg, off16, 0);
         }
         else if (mode == 6) /* Mode 006: (d8, An, Xn.SIZE*SCALE) */
         {
-            uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+            uint16_t brief = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
             uint8_t extra_reg = (brief >> 12) & 7;
 
             if ((brief & 0x0100) == 0)
             {
                 uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
-                uint8_t tmp1 = 0xff;
-                uint8_t tmp2 = 0xff;
                 int8_t displ = brief & 0xff;
 
-                if (displ > 0)
-                {
-                    tmp1 = RA_AllocARMRegister(&ptr);
-                    *ptr++ = add_immed(tmp1, reg_An, displ);
-                }
-                else if (displ < 0)
+                if (size != 0 && displ == 0 && (brief & (M68K_EA_WL | M68K_EA_SCALE)) == M68K_EA_WL)
                 {
-                    tmp1 = RA_AllocARMRegister(&ptr);
-                    *ptr++ = sub_immed(tmp1, reg_An, -displ);
-                }
-
-                if (brief & (1 << 11))
-                {
-                    if (brief & 0x8000)
-                        tmp2 = RA_MapM68kRegister(&ptr, 8 + extra_reg); // RA_CopyFromM68kRegister(&ptr, 8 + extra_reg);
-                    else
-                        tmp2 = RA_MapM68kRegister(&ptr, extra_reg); // RA_CopyFromM68kRegister(&ptr, extra_reg);
+                    ptr = store_reg_to_addr_index(ptr, size, reg_An, *arm_reg, brief);
                 }
                 else
                 {
-                    if (brief & 0x8000)
-                        tmp2 = RA_MapM68kRegister(&ptr, 8 + extra_reg);
-                    else
-                        tmp2 = RA_MapM68kRegister(&ptr, extra_reg);
+                    uint8_t addr = (size == 0 && displ == 0) ? *arm_reg : RA_AllocARMRegister(&ptr);
 
-                    uint8_t tmp3 = RA_AllocARMRegister(&ptr);
-                    *ptr++ = sxth(tmp3, tmp2);
+                    ptr = brief_index_add(ptr, addr, reg_An, brief);
 
-                    RA_FreeARMRegister(&ptr, tmp2);
-                    tmp2 = tmp3;
+                    if (addr != *arm_reg)
+                    {
+                        ptr = store_reg_to_addr_offset(ptr, size, addr, *arm_reg, displ, 0);
+                        RA_FreeARMRegister(&ptr, addr);
+                    }
                 }
-
-                ptr = store_reg_to_addr(ptr, size, displ ? tmp1 : reg_An, *arm_reg, tmp2, (brief >> 9) & 3);
-
-                if (displ) RA_FreeARMRegister(&ptr, tmp1);
-                RA_FreeARMRegister(&ptr, tmp2);
             }
             else
             {
@@ -1645,13 +1721,13 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                 {
                     case 2: /* Word displacement */
                         bd_reg = RA_AllocARMRegister(&ptr);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         ptr = load_s16_ext32(ptr, bd_reg, lo16);
                         break;
                     case 3: /* Long displacement */
                         bd_reg = RA_AllocARMRegister(&ptr);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         *ptr++ = movw_immed_u16(bd_reg, lo16);
                         if (hi16)
                             *ptr++ = movt_immed_u16(bd_reg, hi16);
@@ -1663,13 +1739,13 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                 {
                     case 2: /* Word outer displacement */
                         outer_reg = RA_AllocARMRegister(&ptr);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         ptr = load_s16_ext32(ptr, outer_reg, lo16);
                         break;
                     case 3: /* Long outer displacement */
                         outer_reg = RA_AllocARMRegister(&ptr);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         *ptr++ = movw_immed_u16(outer_reg, lo16);
                         if (hi16)
                             *ptr++ = movt_immed_u16(outer_reg, hi16);
@@ -1771,7 +1847,7 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
             if (src_reg == 2) /* (d16, PC) mode */
             {
                 int8_t off = 2;
-                int32_t off32 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                int32_t off32 = (int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 ptr = EMIT_GetOffsetPC(ptr, &off);
                 off32 += off;
 
@@ -1779,7 +1855,7 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
             }
             else if (src_reg == 3)
             {
-                uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                uint16_t brief = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 uint8_t extra_reg = (brief >> 12) & 7;
 
                 if ((brief & 0x0100) == 0)
@@ -1886,13 +1962,13 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                     {
                         case 2: /* Word displacement */
                             bd_reg = RA_AllocARMRegister(&ptr);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             ptr = load_s16_ext32(ptr, bd_reg, lo16);
                             break;
                         case 3: /* Long displacement */
                             bd_reg = RA_AllocARMRegister(&ptr);
-                            hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             *ptr++ = movw_immed_u16(bd_reg, lo16);
                             if (hi16)
                                 *ptr++ = movt_immed_u16(bd_reg, hi16);
@@ -1904,13 +1980,13 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                     {
                         case 2: /* Word outer displacement */
                             outer_reg = RA_AllocARMRegister(&ptr);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             ptr = load_s16_ext32(ptr, outer_reg, lo16);
                             break;
                         case 3: /* Long outer displacement */
                             outer_reg = RA_AllocARMRegister(&ptr);
-                            hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             *ptr++ = movw_immed_u16(outer_reg, lo16);
                             if (hi16)
                                 *ptr++ = movt_immed_u16(outer_reg, hi16);
@@ -1997,11 +2073,18 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
             else if (src_reg == 0)
             {
                 uint16_t lo16;
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+
+                int32_t base_off = 0;
+                uint8_t base_reg = size ? RA_GetConstBase(&ptr, (int16_t)lo16, &base_off) : 0xff;
 
                 if (size == 0) {
                     ptr = load_s16_ext32(ptr, *arm_reg, lo16);
                 }
+                else if (base_reg != 0xff)
+                {
+                    ptr = store_reg_to_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -2009,12 +2092,18 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                     ptr = store_reg_to_addr(ptr, size, tmp_reg, *arm_reg, 0xff, 0);
                     RA_FreeARMRegister(&ptr, tmp_reg);
                 }
+#if EMU68_BUS_SITES
+                if (size != 0 && M68K_IsBusAddress((int16_t)lo16))
+                    ptr = EMIT_BusAccess(ptr);
+#endif
             }
             else if (src_reg == 1)
             {
                 uint16_t lo16, hi16;
-                hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                hi16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = cache_fetch_16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                int32_t base_off = 0;
+                uint8_t base_reg;
 
                 if (size == 0) {
                     if (lo16 == 0 && hi16 == 0)
@@ -2032,6 +2121,10 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                         *ptr++ = mov_immed_u16(*arm_reg, hi16, 1);
                     }
                 }
+                else if ((base_reg = RA_GetConstBase(&ptr, ((uint32_t)hi16 << 16) | lo16, &base_off)) != 0xff)
+                {
+                    ptr = store_reg_to_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -2055,6 +2148,10 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
 
                     RA_FreeARMRegister(&ptr, tmp_reg);
                 }
+#if EMU68_BUS_SITES
+                if (size != 0 && M68K_IsBusAddress(((uint32_t)hi16 << 16) | lo16))
+                    ptr = EMIT_BusAccess(ptr);
+#endif
             }
         }
     }
@@ -94,17 +94,17 @@ uint32_t *EMIT_Exception(uint32_t *ptr, uint16_t exception, uint8_t format, ...)
     *ptr++ = mov_reg(cc_copy, cc);
     *ptr++ = rbit(vbr, cc);
     *ptr++ = bfxil(cc_copy, vbr, 30, 2);
-    /* Store SR */
-    *ptr++ = strh_offset_preindex(sp, cc_copy, -8);
 
-    RA_FreeARMRegister(&ptr, cc_copy);
-
-    /* Store program counter */
-    *ptr++ = stur_offset(sp, REG_PC, 2);
-
-    /* Store exception vector and type */
+    /*
+        SR, PC and format/vector word make the 8 bytes common to all frames. Host is big endian,
+        build them in one register and push with a single store
+    */
     *ptr++ = mov_immed_u16(vbr, (format << 12) | (exception & 0xfff), 0);
-    *ptr++ = strh_offset(sp, vbr, 6);
+    *ptr++ = bfi64(vbr, REG_PC, 16, 32);
+    *ptr++ = bfi64(vbr, cc_copy, 48, 16);
+    *ptr++ = str64_offset_preindex(sp, vbr, -8);
+
+    RA_FreeARMRegister(&ptr, cc_copy);
 
     /* Clear trace flags, set supervisor */
     *ptr++ = bic_immed(cc, cc, 2, 32 - SRB_T0);
@@ -124,3 +124,25 @@ uint32_t *EMIT_Exception(uint32_t *ptr, uint16_t exception, uint8_t format, ...)
 
     return ptr;
 }
+
+/*
+    Privilege violation unless the S bit is set. The exception path goes to the cold section if
+    possible. *rejoin is a B placeholder at its end, once the code of the privileged instruction
+    is emitted it has to be pointed behind it with EMIT_Rejoin
+*/
+uint32_t *EMIT_PrivilegeCheck(uint32_t *ptr, uint8_t cc, uint32_t **rejoin)
+{
+    uint32_t *tmp;
+
+    *ptr++ = tst_immed(cc, 1, 31 & (32 - SRB_S));
+    tmp = ptr++;
+    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
+    *rejoin = ptr++;
+    *tmp = b_cc(A64_CC_NE, ptr - tmp);
+
+#if EMU68_COLD_STUBS
+    ptr = EMIT_ColdPath(tmp + 1, ptr, rejoin);
+#endif
+
+    return ptr;
+}
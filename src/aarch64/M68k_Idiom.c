@@ -0,0 +1,717 @@
+/*
+    Copyright © 2020 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+#include "RegisterAllocator.h"
+#include "cache.h"
+
+#if EMU68_BLOCK_IDIOMS
+
+/*
+    Block copy and block fill idioms
+
+        loop:   move.l  (Ax)+,(Ay)+             loop:   clr.l   (Ax)+
+                dbf     Dn,loop                         dbf     Dn,loop
+
+    are translated as a whole. If both memory ranges lie within directly mapped RAM above
+    the 24-bit Amiga space, the block is moved 16 bytes at a time through NEON registers.
+    Otherwise the loop runs one long word per iteration with plain loads and stores, which
+    reach bus emulation the same way the generic translation does, and leaves the unit at
+    the loop head whenever an interrupt is pending.
+
+    On exit An, Dn and the condition codes are exactly as if the loop was executed.
+*/
+
+static uint32_t fast_lo;
+static uint32_t fast_hi;
+static int range_known;
+
+static void FindFastRange()
+{
+    uint64_t best = 0;
+
+    for (int i=0; sys_memory[i].mb_Size != 0; i++)
+    {
+        uint64_t lo = sys_memory[i].mb_Base;
+        uint64_t hi = sys_memory[i].mb_Base + sys_memory[i].mb_Size;
+
+        if (lo < EMU68_BLOCK_IDIOM_BASE)
+            lo = EMU68_BLOCK_IDIOM_BASE;
+        if (hi > 0xffffffffULL)
+            hi = 0xffffffffULL;
+
+        if (hi > lo && hi - lo > best)
+        {
+            best = hi - lo;
+            fast_lo = lo;
+            fast_hi = hi;
+        }
+    }
+
+    /* No usable RAM, make the range check fail always */
+    if (best == 0)
+    {
+        fast_lo = 0xffffffff;
+        fast_hi = 0;
+    }
+}
+
+static uint32_t *EMIT_Load32(uint32_t *ptr, uint8_t reg, uint32_t value)
+{
+    *ptr++ = movw_immed_u16(reg, value & 0xffff);
+    if (value >> 16)
+        *ptr++ = movt_immed_u16(reg, value >> 16);
+
+    return ptr;
+}
+
+/*
+    Element-wise loops closed by dbf
+
+        loop:   move.s  (As)+,Dt                loop:   move.s  (As)+,Dt
+                op.s    Dt,(Ad)+                        op.s    Dk,Dt
+                dbf     Dn,loop                         move.s  Dt,(Ad)+
+                                                        dbf     Dn,loop
+
+    with op being add, sub, and, or or eor on the left and and, or or eor on the right. If
+    both ranges lie within directly mapped RAM and the destination does not start within the
+    source, 16 bytes are processed at a time in NEON registers as long as more than 16 bytes
+    are left. The remaining elements, the last one giving the condition codes, run in scalar
+    code. Otherwise the loop runs one element per iteration and leaves the unit at the loop
+    head whenever an interrupt is pending. Memory is big endian as the host, so the lanes of
+    a vector load hold the elements in m68k order of bytes.
+
+    On exit As, Ad, Dt, Dn and the condition codes are exactly as if the loop was executed.
+*/
+enum { ELEM_ADD, ELEM_SUB, ELEM_AND, ELEM_OR, ELEM_EOR };
+
+struct ElementLoop {
+    uint8_t     el_Op;
+    uint8_t     el_Size;        /* Element size in bytes */
+    uint8_t     el_Log2;
+    uint8_t     el_Src;         /* m68k register numbers */
+    uint8_t     el_Dst;
+    uint8_t     el_Dt;
+    uint8_t     el_Dk;          /* 0xff in the first form */
+    uint8_t     el_Cnt;
+    uint8_t     el_Words;       /* Length of the loop including dbf */
+    uint8_t     el_Last;        /* Offset in words of the instruction setting the flags */
+};
+
+static int DecodeElementLoop(uint16_t *p, struct ElementLoop *l)
+{
+    static const uint8_t move_size[4] = { 0, 1, 4, 2 };
+    uint16_t op1 = cache_fetch_16((uintptr_t)&p[0]);
+    uint16_t op2 = cache_fetch_16((uintptr_t)&p[1]);
+    uint16_t op3 = cache_fetch_16((uintptr_t)&p[2]);
+    uint16_t op4 = cache_fetch_16((uintptr_t)&p[3]);
+    uint16_t op5 = cache_fetch_16((uintptr_t)&p[4]);
+    uint8_t size2 = (op2 >> 6) & 3;
+
+    /* move.s (As)+,Dt */
+    if ((op1 & 0xc1f8) != 0x0018 || move_size[(op1 >> 12) & 3] == 0)
+        return 0;
+
+    l->el_Size = move_size[(op1 >> 12) & 3];
+    l->el_Log2 = l->el_Size == 4 ? 2 : l->el_Size - 1;
+    l->el_Src = 8 + (op1 & 7);
+    l->el_Dt = (op1 >> 9) & 7;
+
+    if (size2 == 3 || (1 << size2) != l->el_Size)
+        return 0;
+
+    switch (op2 >> 12)
+    {
+        case 0xd: l->el_Op = ELEM_ADD; break;
+        case 0x9: l->el_Op = ELEM_SUB; break;
+        case 0xc: l->el_Op = ELEM_AND; break;
+        case 0x8: l->el_Op = ELEM_OR;  break;
+        case 0xb: l->el_Op = ELEM_EOR; break;
+        default:  return 0;
+    }
+
+    /* op.s Dt,(Ad)+ */
+    if ((op2 & 0x0138) == 0x0118 && ((op2 >> 9) & 7) == l->el_Dt)
+    {
+        if ((op3 & 0xfff8) != 0x51c8 || op4 != 0xfffa)
+            return 0;
+
+        l->el_Dst = 8 + (op2 & 7);
+        l->el_Dk = 0xff;
+        l->el_Cnt = op3 & 7;
+        l->el_Words = 4;
+        l->el_Last = 1;
+    }
+    /* and.s Dk,Dt / or.s Dk,Dt / eor.s Dk,Dt followed by move.s Dt,(Ad)+ */
+    else if (l->el_Op >= ELEM_AND && (op2 & 0x0038) == 0)
+    {
+        if (l->el_Op == ELEM_EOR)
+        {
+            if ((op2 & 0x0100) == 0 || (op2 & 7) != l->el_Dt)
+                return 0;
+            l->el_Dk = (op2 >> 9) & 7;
+        }
+        else
+        {
+            if ((op2 & 0x0100) != 0 || ((op2 >> 9) & 7) != l->el_Dt)
+                return 0;
+            l->el_Dk = op2 & 7;
+        }
+
+        if ((op3 & 0xf1ff) != ((op1 & 0x3000) | 0x00c0 | l->el_Dt))
+            return 0;
+        if ((op4 & 0xfff8) != 0x51c8 || op5 != 0xfff8)
+            return 0;
+
+        l->el_Dst = 8 + ((op3 >> 9) & 7);
+        l->el_Cnt = op4 & 7;
+        l->el_Words = 5;
+        l->el_Last = 2;
+
+        if (l->el_Dk == l->el_Dt || l->el_Dk == l->el_Cnt)
+            return 0;
+    }
+    else
+        return 0;
+
+    /* A7 steps by two for bytes, leave it to the generic translation */
+    if (l->el_Src == 15 || l->el_Dst == 15 || l->el_Src == l->el_Dst || l->el_Dt == l->el_Cnt)
+        return 0;
+
+    return 1;
+}
+
+static uint32_t *EMIT_LoadElement(uint32_t *ptr, uint8_t base, uint8_t rt, uint8_t size, int post)
+{
+    switch (size)
+    {
+        case 1:
+            *ptr++ = post ? ldrb_offset_postindex(base, rt, 1) : ldrb_offset(base, rt, 0);
+            break;
+        case 2:
+            *ptr++ = post ? ldrh_offset_postindex(base, rt, 2) : ldrh_offset(base, rt, 0);
+            break;
+        default:
+            *ptr++ = post ? ldr_offset_postindex(base, rt, 4) : ldr_offset(base, rt, 0);
+            break;
+    }
+
+    return ptr;
+}
+
+static uint32_t *EMIT_StoreElement(uint32_t *ptr, uint8_t base, uint8_t rt, uint8_t size)
+{
+    switch (size)
+    {
+        case 1:
+            *ptr++ = strb_offset_postindex(base, rt, 1);
+            break;
+        case 2:
+            *ptr++ = strh_offset_postindex(base, rt, 2);
+            break;
+        default:
+            *ptr++ = str_offset_postindex(base, rt, 4);
+            break;
+    }
+
+    return ptr;
+}
+
+/*
+    One iteration of the loop body in scalar code. The result is left in res, add and sub
+    leave the host flags of the operation on element size. The loop control around it must
+    not change host flags
+*/
+static uint32_t *EMIT_Element(uint32_t *ptr, const struct ElementLoop *l, uint8_t src, uint8_t dst,
+        uint8_t dt, uint8_t dk, uint8_t val, uint8_t res)
+{
+    uint8_t shift = 32 - 8 * l->el_Size;
+
+    ptr = EMIT_LoadElement(ptr, src, val, l->el_Size, 1);
+
+    if (l->el_Dk == 0xff)
+    {
+        if (l->el_Size == 4)
+            *ptr++ = mov_reg(dt, val);
+        else
+            *ptr++ = bfi(dt, val, 0, 8 * l->el_Size);
+
+        ptr = EMIT_LoadElement(ptr, dst, res, l->el_Size, 0);
+
+        switch (l->el_Op)
+        {
+            case ELEM_ADD:
+            case ELEM_SUB:
+                if (shift)
+                    *ptr++ = lsl(res, res, shift);
+                if (l->el_Op == ELEM_ADD)
+                    *ptr++ = adds_reg(res, res, val, LSL, shift);
+                else
+                    *ptr++ = subs_reg(res, res, val, LSL, shift);
+                if (shift)
+                    *ptr++ = lsr(res, res, shift);
+                break;
+            case ELEM_AND:
+                *ptr++ = and_reg(res, res, val, LSL, 0);
+                break;
+            case ELEM_OR:
+                *ptr++ = orr_reg(res, res, val, LSL, 0);
+                break;
+            case ELEM_EOR:
+                *ptr++ = eor_reg(res, res, val, LSL, 0);
+                break;
+        }
+    }
+    else
+    {
+        switch (l->el_Op)
+        {
+            case ELEM_AND:
+                *ptr++ = and_reg(res, val, dk, LSL, 0);
+                break;
+            case ELEM_OR:
+                *ptr++ = orr_reg(res, val, dk, LSL, 0);
+                break;
+            default:
+                *ptr++ = eor_reg(res, val, dk, LSL, 0);
+                break;
+        }
+
+        if (l->el_Size == 4)
+            *ptr++ = mov_reg(dt, res);
+        else
+            *ptr++ = bfi(dt, res, 0, 8 * l->el_Size);
+    }
+
+    return EMIT_StoreElement(ptr, dst, res, l->el_Size);
+}
+
+static uint32_t *EMIT_ElementLoop(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+{
+    struct ElementLoop l;
+
+    if (!DecodeElementLoop(*m68k_ptr, &l))
+        return NULL;
+
+    if (!range_known)
+    {
+        FindFastRange();
+        range_known = 1;
+    }
+
+    uint8_t update_mask = M68K_GetSRMask(*m68k_ptr + l.el_Last);
+    uint8_t src = RA_MapM68kRegister(&ptr, l.el_Src);
+    uint8_t dst = RA_MapM68kRegister(&ptr, l.el_Dst);
+    uint8_t cnt = RA_MapM68kRegister(&ptr, l.el_Cnt);
+    uint8_t dt = RA_MapM68kRegister(&ptr, l.el_Dt);
+    uint8_t dk = l.el_Dk != 0xff ? RA_MapM68kRegister(&ptr, l.el_Dk) : 0xff;
+    uint32_t *slow[5];
+    uint8_t slow_cc[5];
+    int slow_cnt = 0;
+    uint32_t *tmpptr;
+    uint32_t *done;
+    uint32_t *exit_fast;
+    uint32_t *exit_slow;
+
+    /* REG_PC points to the loop head now, interrupted slow path leaves the unit there */
+    ptr = EMIT_FlushPC(ptr);
+
+    uint8_t ctx = RA_GetCTX(&ptr);
+    uint8_t len = RA_AllocARMRegister(&ptr);
+    uint8_t val = RA_AllocARMRegister(&ptr);
+    uint8_t res = RA_AllocARMRegister(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t vsrc = RA_AllocFPURegister(&ptr);
+    uint8_t vdst = RA_AllocFPURegister(&ptr);
+
+    /* Number of bytes to process, one element to 256K */
+    *ptr++ = uxth(len, cnt);
+    *ptr++ = add_immed(len, len, 1);
+    if (l.el_Log2)
+        *ptr++ = lsl(len, len, l.el_Log2);
+
+    /* Both ranges have to fit into fast RAM */
+    ptr = EMIT_Load32(ptr, tmp, fast_lo);
+    *ptr++ = cmp64_reg(dst, tmp, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_CC;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_CC, 0);
+    *ptr++ = cmp64_reg(src, tmp, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_CC;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_CC, 0);
+
+    ptr = EMIT_Load32(ptr, tmp, fast_hi);
+    *ptr++ = add64_reg(val, dst, len, LSL, 0);
+    *ptr++ = cmp64_reg(val, tmp, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_HI;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_HI, 0);
+    *ptr++ = add64_reg(val, src, len, LSL, 0);
+    *ptr++ = cmp64_reg(val, tmp, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_HI;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_HI, 0);
+
+    /* Destination starting within the source would read results of earlier iterations */
+    *ptr++ = sub64_reg(val, dst, src, LSL, 0);
+    *ptr++ = cmp64_reg(val, len, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_CC;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_CC, 0);
+
+    if (dk != 0xff)
+        *ptr++ = vdup_q(vdst, dk, l.el_Log2);
+
+    /* Fast path, 16 bytes per iteration */
+    tmpptr = ptr;
+    *ptr++ = cmp_immed(len, 16);
+    done = ptr;
+    *ptr++ = b_cc(A64_CC_LS, 0);
+    *ptr++ = fldq_postindex(vsrc, src, 16);
+    if (dk == 0xff)
+    {
+        *ptr++ = fldq(vdst, dst, 0);
+        switch (l.el_Op)
+        {
+            case ELEM_ADD: *ptr++ = vadd_q(vsrc, vdst, vsrc, l.el_Log2); break;
+            case ELEM_SUB: *ptr++ = vsub_q(vsrc, vdst, vsrc, l.el_Log2); break;
+            case ELEM_AND: *ptr++ = vand_q(vsrc, vdst, vsrc); break;
+            case ELEM_OR:  *ptr++ = vorr_q(vsrc, vdst, vsrc); break;
+            case ELEM_EOR: *ptr++ = veor_q(vsrc, vdst, vsrc); break;
+        }
+    }
+    else
+    {
+        switch (l.el_Op)
+        {
+            case ELEM_AND: *ptr++ = vand_q(vsrc, vsrc, vdst); break;
+            case ELEM_OR:  *ptr++ = vorr_q(vsrc, vsrc, vdst); break;
+            default:       *ptr++ = veor_q(vsrc, vsrc, vdst); break;
+        }
+    }
+    *ptr++ = fstq_postindex(vsrc, dst, 16);
+    *ptr++ = sub_immed(len, len, 16);
+    *ptr = b(tmpptr - ptr);
+    ptr++;
+    *done = b_cc(A64_CC_LS, ptr - done);
+
+    /* Remaining elements, at least one */
+    tmpptr = ptr;
+    ptr = EMIT_Element(ptr, &l, src, dst, dt, dk, val, res);
+    *ptr++ = sub_immed(len, len, l.el_Size);
+    *ptr = cbnz(len, tmpptr - ptr);
+    ptr++;
+    *ptr++ = orr_immed(cnt, cnt, 16, 0);
+    exit_fast = ptr;
+    *ptr++ = b(0);
+
+    /* Slow path, one element per iteration */
+    tmpptr = ptr;
+    for (int i=0; i < slow_cnt; i++)
+        *slow[i] = b_cc(slow_cc[i], ptr - slow[i]);
+    ptr = EMIT_Element(ptr, &l, src, dst, dt, dk, val, res);
+    *ptr++ = uxth(tmp, cnt);
+    *ptr++ = sub_immed(tmp, tmp, 1);
+    *ptr++ = bfi(cnt, tmp, 0, 16);
+    *ptr++ = sub_immed(len, len, l.el_Size);
+    exit_slow = ptr;
+    *ptr++ = cbz(len, 0);
+    *ptr++ = ldr_offset(ctx, tmp, __builtin_offsetof(struct M68KState, INT));
+    *ptr = cbz(tmp, tmpptr - ptr);
+    ptr++;
+
+    /* Interrupt pending. The iteration is complete, continue at the loop head later */
+    ptr = EMIT_LocalExit(ptr, 0);
+
+    *exit_fast = b(ptr - exit_fast);
+    *exit_slow = cbz(len, ptr - exit_slow);
+
+    RA_SetDirtyM68kRegister(&ptr, l.el_Src);
+    RA_SetDirtyM68kRegister(&ptr, l.el_Dst);
+    RA_SetDirtyM68kRegister(&ptr, l.el_Cnt);
+    RA_SetDirtyM68kRegister(&ptr, l.el_Dt);
+
+    if (update_mask)
+    {
+        /* Host flags are still those of the last element */
+        uint8_t cc = RA_ModifyCC(&ptr);
+
+        if (l.el_Op == ELEM_ADD || l.el_Op == ELEM_SUB)
+        {
+            uint8_t carry = l.el_Op == ELEM_ADD ? ARM_CC_CS : ARM_CC_CC;
+
+            if (l.el_Op == ELEM_ADD)
+                ptr = (update_mask & SR_X) ? EMIT_GetNZCVX(ptr, cc, &update_mask) : EMIT_GetNZCV(ptr, cc, &update_mask);
+            else
+                ptr = (update_mask & SR_X) ? EMIT_GetNZnCVX(ptr, cc, &update_mask) : EMIT_GetNZnCV(ptr, cc, &update_mask);
+
+            if (update_mask & SR_Z)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Z, ARM_CC_EQ);
+            if (update_mask & SR_N)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_N, ARM_CC_MI);
+            if (update_mask & SR_V)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Valt, ARM_CC_VS);
+            if (update_mask & (SR_X | SR_C)) {
+                if ((update_mask & (SR_X | SR_C)) == SR_X)
+                    ptr = EMIT_SetFlagsConditional(ptr, cc, SR_X, carry);
+                else if ((update_mask & (SR_X | SR_C)) == SR_C)
+                    ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Calt, carry);
+                else
+                    ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Calt | SR_X, carry);
+            }
+        }
+        else
+        {
+            /* Last result on element size gives N and Z, V and C are cleared */
+            *ptr++ = cmn_reg(31, res, LSL, 32 - 8 * l.el_Size);
+            ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
+
+            if (update_mask & SR_Z)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Z, ARM_CC_EQ);
+            if (update_mask & SR_N)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_N, ARM_CC_MI);
+        }
+    }
+
+    RA_FreeFPURegister(&ptr, vdst);
+    RA_FreeFPURegister(&ptr, vsrc);
+    RA_FreeARMRegister(&ptr, tmp);
+    RA_FreeARMRegister(&ptr, res);
+    RA_FreeARMRegister(&ptr, val);
+    RA_FreeARMRegister(&ptr, len);
+
+    ptr = EMIT_AdvancePC(ptr, 2 * l.el_Words);
+    (*m68k_ptr) += l.el_Words;
+    *insn_consumed = l.el_Words - 1;
+
+    return ptr;
+}
+
+/*
+    Try to translate block idiom starting at *m68k_ptr. Returns NULL if the code does not
+    match any of the idioms, otherwise the new end of the arm code.
+*/
+uint32_t *EMIT_BlockIdiom(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+{
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t dbf = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
+    uint16_t disp = cache_fetch_16((uintptr_t)&(*m68k_ptr)[2]);
+    int copy = 0;
+    uint8_t src_m68k = 0;
+    uint8_t dst_m68k;
+
+    /* dbf Dn,loop with the loop being the single preceding instruction */
+    if ((dbf & 0xfff8) != 0x51c8 || disp != 0xfffc)
+        return EMIT_ElementLoop(ptr, m68k_ptr, insn_consumed);
+
+    if ((opcode & 0xf1f8) == 0x20d8)
+    {
+        copy = 1;
+        src_m68k = 8 + (opcode & 7);
+        dst_m68k = 8 + ((opcode >> 9) & 7);
+
+        if (src_m68k == dst_m68k)
+            return NULL;
+    }
+    else if ((opcode & 0xfff8) == 0x4298)
+    {
+        dst_m68k = 8 + (opcode & 7);
+    }
+    else
+        return EMIT_ElementLoop(ptr, m68k_ptr, insn_consumed);
+
+    if (!range_known)
+    {
+        FindFastRange();
+        range_known = 1;
+    }
+
+    uint8_t update_mask = M68K_GetSRMask(*m68k_ptr);
+    uint8_t src = copy ? RA_MapM68kRegister(&ptr, src_m68k) : 0xff;
+    uint8_t dst = RA_MapM68kRegister(&ptr, dst_m68k);
+    uint8_t cnt = RA_MapM68kRegister(&ptr, dbf & 7);
+    uint32_t *slow[5];
+    uint8_t slow_cc[5];
+    int slow_cnt = 0;
+    uint32_t *tmpptr;
+    uint32_t *done;
+    uint32_t *exit_fast;
+    uint32_t *exit_slow;
+
+    /* REG_PC points to the loop head now, interrupted slow path leaves the unit there */
+    ptr = EMIT_FlushPC(ptr);
+
+    uint8_t ctx = RA_GetCTX(&ptr);
+    uint8_t len = RA_AllocARMRegister(&ptr);
+    uint8_t val = RA_AllocARMRegister(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t vec = RA_AllocFPURegister(&ptr);
+
+    /* Number of bytes to transfer, 4 to 256K */
+    *ptr++ = uxth(len, cnt);
+    *ptr++ = add_immed(len, len, 1);
+    *ptr++ = lsl(len, len, 2);
+
+    /* Both ranges have to fit into fast RAM */
+    ptr = EMIT_Load32(ptr, tmp, fast_lo);
+    *ptr++ = cmp64_reg(dst, tmp, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_CC;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_CC, 0);
+    if (copy)
+    {
+        *ptr++ = cmp64_reg(src, tmp, LSL, 0);
+        slow_cc[slow_cnt] = A64_CC_CC;
+        slow[slow_cnt++] = ptr;
+        *ptr++ = b_cc(A64_CC_CC, 0);
+    }
+
+    ptr = EMIT_Load32(ptr, tmp, fast_hi);
+    *ptr++ = add64_reg(val, dst, len, LSL, 0);
+    *ptr++ = cmp64_reg(val, tmp, LSL, 0);
+    slow_cc[slow_cnt] = A64_CC_HI;
+    slow[slow_cnt++] = ptr;
+    *ptr++ = b_cc(A64_CC_HI, 0);
+    if (copy)
+    {
+        *ptr++ = add64_reg(val, src, len, LSL, 0);
+        *ptr++ = cmp64_reg(val, tmp, LSL, 0);
+        slow_cc[slow_cnt] = A64_CC_HI;
+        slow[slow_cnt++] = ptr;
+        *ptr++ = b_cc(A64_CC_HI, 0);
+
+        /* Destination starting within the source would replicate the data, leave it to the slow path */
+        *ptr++ = sub64_reg(val, dst, src, LSL, 0);
+        *ptr++ = cmp64_reg(val, len, LSL, 0);
+        slow_cc[slow_cnt] = A64_CC_CC;
+        slow[slow_cnt++] = ptr;
+        *ptr++ = b_cc(A64_CC_CC, 0);
+    }
+
+    /* Fast path, 16 bytes per iteration */
+    tmpptr = ptr;
+    *ptr++ = cmp_immed(len, 16);
+    done = ptr;
+    *ptr++ = b_cc(A64_CC_CC, 0);
+    if (copy)
+    {
+        *ptr++ = fldq_postindex(vec, src, 16);
+        *ptr++ = fstq_postindex(vec, dst, 16);
+    }
+    else
+    {
+        *ptr++ = stp64_postindex(dst, 31, 31, 16);
+    }
+    *ptr++ = sub_immed(len, len, 16);
+    *ptr = b(tmpptr - ptr);
+    ptr++;
+    *done = b_cc(A64_CC_CC, ptr - done);
+
+    /* Remaining long words */
+    tmpptr = ptr;
+    done = ptr;
+    *ptr++ = cbz(len, 0);
+    if (copy)
+    {
+        *ptr++ = ldr_offset_postindex(src, val, 4);
+        *ptr++ = str_offset_postindex(dst, val, 4);
+    }
+    else
+    {
+        *ptr++ = str_offset_postindex(dst, 31, 4);
+    }
+    *ptr++ = sub_immed(len, len, 4);
+    *ptr = b(tmpptr - ptr);
+    ptr++;
+    *done = cbz(len, ptr - done);
+
+    /* Last long word moved gives the flags */
+    if (copy)
+        *ptr++ = ldur_offset(dst, val, -4 & 0x1ff);
+    *ptr++ = orr_immed(cnt, cnt, 16, 0);
+    exit_fast = ptr;
+    *ptr++ = b(0);
+
+    /* Slow path, one long word per iteration */
+    tmpptr = ptr;
+    for (int i=0; i < slow_cnt; i++)
+        *slow[i] = b_cc(slow_cc[i], ptr - slow[i]);
+    if (copy)
+    {
+        *ptr++ = ldr_offset_postindex(src, val, 4);
+        *ptr++ = str_offset_postindex(dst, val, 4);
+    }
+    else
+    {
+        *ptr++ = str_offset_postindex(dst, 31, 4);
+    }
+    *ptr++ = uxth(tmp, cnt);
+    *ptr++ = sub_immed(tmp, tmp, 1);
+    *ptr++ = bfi(cnt, tmp, 0, 16);
+    *ptr++ = subs_immed(len, len, 4);
+    exit_slow = ptr;
+    *ptr++ = b_cc(A64_CC_EQ, 0);
+    *ptr++ = ldr_offset(ctx, tmp, __builtin_offsetof(struct M68KState, INT));
+    *ptr = cbz(tmp, tmpptr - ptr);
+    ptr++;
+
+    /* Interrupt pending. The iteration is complete, continue at the loop head later */
+    ptr = EMIT_LocalExit(ptr, 0);
+
+    *exit_fast = b(ptr - exit_fast);
+    *exit_slow = b_cc(A64_CC_EQ, ptr - exit_slow);
+
+    RA_SetDirtyM68kRegister(&ptr, dst_m68k);
+    if (copy)
+        RA_SetDirtyM68kRegister(&ptr, src_m68k);
+    RA_SetDirtyM68kRegister(&ptr, dbf & 7);
+
+    if (update_mask)
+    {
+        uint8_t cc = RA_ModifyCC(&ptr);
+
+        if (copy)
+        {
+            *ptr++ = cmn_reg(31, val, LSL, 0);
+            ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
+
+            if (update_mask & SR_Z)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Z, ARM_CC_EQ);
+            if (update_mask & SR_N)
+                ptr = EMIT_SetFlagsConditional(ptr, cc, SR_N, ARM_CC_MI);
+        }
+        else
+        {
+            if (update_mask & ~SR_Z)
+            {
+                uint8_t alt_flags = update_mask;
+                if ((alt_flags & 3) != 0 && (alt_flags & 3) < 3)
+                    alt_flags ^= 3;
+                ptr = EMIT_ClearFlags(ptr, cc, alt_flags);
+            }
+            if (update_mask & SR_Z)
+                ptr = EMIT_SetFlags(ptr, cc, SR_Z);
+        }
+    }
+
+    RA_FreeFPURegister(&ptr, vec);
+    RA_FreeARMRegister(&ptr, tmp);
+    RA_FreeARMRegister(&ptr, val);
+    RA_FreeARMRegister(&ptr, len);
+
+    ptr = EMIT_AdvancePC(ptr, 6);
+    (*m68k_ptr) += 3;
+    *insn_consumed = 2;
+
+    return ptr;
+}
+
+#endif
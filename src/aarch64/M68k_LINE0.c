@@ -11,6 +11,7 @@
 #include "M68k.h"
 #include "RegisterAllocator.h"
 #include "cache.h"
+#include "EmuFeatures.h"
 
 uint32_t *EMIT_CMPI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
@@ -27,18 +28,18 @@ uint32_t *EMIT_CMPI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             *ptr++ = mov_immed_u16(immed, (lo16 & 0xff) << 8, 1);
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             *ptr++ = mov_immed_u16(immed, lo16, 1);
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            u32 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
+            u32 |= cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (u32 < 4096)
             {
                 immediate = 1;
@@ -149,22 +150,22 @@ uint32_t *EMIT_SUBI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
             if (!(update_mask == 0)) {
                 *ptr++ = mov_immed_u16(immed, lo16 << 8, 1);
             }
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (!(update_mask == 0)) {
                 *ptr++ = mov_immed_u16(immed, lo16, 1);
             }
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            u32 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
+            u32 |= cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (u32 < 4096)
             {
                 immediate = 1;
@@ -410,22 +411,22 @@ uint32_t *EMIT_ADDI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
             if (!(update_mask == 0)) {
                 *ptr++ = mov_immed_u16(immed, (lo16 & 0xff) << 8, 1);
             }
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (!(update_mask == 0)) {
                 *ptr++ = mov_immed_u16(immed, lo16, 1);
             }
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            u32 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
+            u32 |= cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (u32 < 4096)
             {
                 add_immediate = 1;
@@ -657,7 +658,7 @@ uint32_t *EMIT_ORI_TO_CCR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(&ptr);
-    uint16_t val8 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr[0]));
+    uint16_t val8 = cache_fetch_16((uintptr_t)&(*m68k_ptr[0]));
 
     /* Swap C and V flags in immediate */
     if ((val8 & 3) != 0 && (val8 & 3) < 3)
@@ -683,7 +684,7 @@ uint32_t *EMIT_ORI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(&ptr);
     uint8_t changed = RA_AllocARMRegister(&ptr);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int16_t val = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t sp = RA_MapM68kRegister(&ptr, 15);
     uint32_t *tmp;
     RA_SetDirtyM68kRegister(&ptr, 15);
@@ -697,12 +698,7 @@ uint32_t *EMIT_ORI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     ptr = EMIT_FlushPC(ptr);
     
     /* If supervisor is not active, put an exception here */
-    tmp = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *tmp = tbnz(cc, SRB_S, 1 + ptr - tmp);
-    tmp = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmp);
 
     /* Load immediate into the register */
     *ptr++ = mov_immed_u16(immed, val & 0xf71f, 0); 
@@ -742,7 +738,7 @@ uint32_t *EMIT_ORI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     *ptr++ = b(2);
     *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
 
-    *tmp = b(ptr - tmp);
+    EMIT_Rejoin(tmp, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
@@ -770,7 +766,7 @@ uint32_t *EMIT_ORI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
             if (update_mask == 0) {
                 mask32 = number_to_mask(lo16);
                 if (mask32 == 0 || mask32 == 0xffffffff) {
@@ -784,7 +780,7 @@ uint32_t *EMIT_ORI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (update_mask == 0) {
                 mask32 = number_to_mask(lo16 & 0xffff);
                 if (mask32 == 0 || mask32 == 0xffffffff) {
@@ -798,8 +794,8 @@ uint32_t *EMIT_ORI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            u32 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
+            u32 |= cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             mask32 = number_to_mask(u32);
             if (mask32 == 0 || mask32 == 0xffffffff)
             {
@@ -1030,7 +1026,7 @@ uint32_t *EMIT_ANDI_TO_CCR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(&ptr);
-    uint16_t val = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t val = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
    
     /* Swap C and V flags in immediate */
     if ((val & 3) != 0 && (val & 3) < 3)
@@ -1053,7 +1049,7 @@ uint32_t *EMIT_ANDI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(&ptr);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int16_t val = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint32_t *tmp;
 
     uint8_t changed = RA_AllocARMRegister(&ptr);
@@ -1070,12 +1066,7 @@ uint32_t *EMIT_ANDI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     ptr = EMIT_FlushPC(ptr);
     
     /* If supervisor is not active, put an exception here */
-    tmp = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *tmp = tbnz(cc, SRB_S, 1 + ptr - tmp);
-    tmp = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmp);
 
     /* Load immediate into the register */
     *ptr++ = mov_immed_u16(immed, val & 0xf71f, 0);
@@ -1119,7 +1110,7 @@ uint32_t *EMIT_ANDI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     *ptr++ = b(2);
     *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
 
-    *tmp = b(ptr - tmp);
+    EMIT_Rejoin(tmp, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
@@ -1147,7 +1138,7 @@ uint32_t *EMIT_ANDI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 0xff;
             if (update_mask == 0) {
                 if ((opcode & 0x0038) == 0) {
                     if (lo16 != 0xff) {
@@ -1173,7 +1164,7 @@ uint32_t *EMIT_ANDI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             if (update_mask == 0) {
                 if ((opcode & 0x0038) == 0) {
                     if (lo16 != 0xffff) 
@@ -1199,8 +1190,8 @@ uint32_t *EMIT_ANDI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            u32 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
+            u32 |= cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             mask32 = number_to_mask(u32);
             if (mask32 == 0 || mask32 == 0xffffffff)
             {
@@ -1384,7 +1375,7 @@ uint32_t *EMIT_EORI_TO_CCR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(&ptr);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int16_t val = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
     /* Swap C and V flags in immediate */
     if ((val & 3) != 0 && (val & 3) < 3)
@@ -1407,7 +1398,7 @@ uint32_t *EMIT_EORI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(&ptr);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int16_t val = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint32_t *tmp;
 
     uint8_t orig = RA_AllocARMRegister(&ptr);
@@ -1423,12 +1414,7 @@ uint32_t *EMIT_EORI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     ptr = EMIT_FlushPC(ptr);
     
     /* If supervisor is not active, put an exception here */
-    tmp = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *tmp = tbnz(cc, SRB_S, 1 + ptr - tmp);
-    tmp = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmp);
 
     /* Load immediate into the register */
     *ptr++ = mov_immed_u16(immed, val & 0xf71f, 0);
@@ -1469,7 +1455,7 @@ uint32_t *EMIT_EORI_TO_SR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     *ptr++ = b(2);
     *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
 
-    *tmp = b(ptr - tmp);
+    EMIT_Rejoin(tmp, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
@@ -1497,18 +1483,18 @@ uint32_t *EMIT_EORI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             *ptr++ = mov_immed_u16(immed, (lo16 & 0xff) << 8, 1);
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            lo16 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             *ptr++ = mov_immed_u16(immed, lo16, 1);
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]);
+            u32 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) << 16;
+            u32 |= cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]);
             mask32 = number_to_mask(u32);
             if (mask32 == 0 || mask32 == 0xffffffff)
             {
@@ -1687,7 +1673,7 @@ uint32_t *EMIT_BTST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     if ((opcode & 0xffc0) == 0x0800)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
+        imm_shift = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
     }
     else
     {
@@ -1768,7 +1754,7 @@ uint32_t *EMIT_BCHG(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     if ((opcode & 0xffc0) == 0x0840)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
+        imm_shift = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
     }
     else
     {
@@ -1884,7 +1870,7 @@ uint32_t *EMIT_BCLR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     if ((opcode & 0xffc0) == 0x0880)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
+        imm_shift = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
     }
     else
     {
@@ -1990,7 +1976,7 @@ uint32_t *EMIT_CMP2(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint32_t opcode_address = (uint32_t)(uintptr_t)((*m68k_ptr) - 1);
     uint8_t update_mask = SR_Z | SR_C;
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t ea = -1;
     uint8_t lower = RA_AllocARMRegister(&ptr);
     uint8_t higher = RA_AllocARMRegister(&ptr);
@@ -2091,15 +2077,16 @@ uint32_t *EMIT_CMP2(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         ptr = EMIT_FlushPC(ptr);
 
         /* Skip exception if C is not set */
+        *ptr++ = tst_immed(cc, 1, 31 & (32 - SRB_Calt));
         uint32_t *t = ptr;
         *ptr++ = 0;
 
         /* Emit CHK exception */
         ptr = EMIT_Exception(ptr, VECTOR_CHK, 2, opcode_address);
-        *t = tbz(cc, SRB_Calt, ptr - t);
+        *t = b_cc(A64_CC_EQ, ptr - t);
         *ptr++ = (uint32_t)(uintptr_t)t;
         *ptr++ = 1;
-        *ptr++ = 0;
+        *ptr++ = EXIT_COLD;
         *ptr++ = INSN_TO_LE(0xfffffffe);
     }
 
@@ -2121,7 +2108,7 @@ uint32_t *EMIT_BSET(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     if ((opcode & 0xffc0) == 0x08c0)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
+        imm_shift = cache_fetch_16((uintptr_t)&(*m68k_ptr)[ext_count++]) & 31;
     }
     else
     {
@@ -2278,6 +2265,60 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         }\
 } while(0)
 
+#define CAS_LSE() do { \
+        switch (size) \
+        { \
+            case 1:\
+                *ptr++ = uxtb(tmp, dc);\
+                *ptr++ = casalb(ea, tmp, du);\
+                *ptr++ = lsl(tmp, tmp, 24);\
+                *ptr++ = subs_reg(31, tmp, dc, LSL, 24);\
+                break;\
+            case 2:\
+                *ptr++ = uxth(tmp, dc);\
+                *ptr++ = casalh(ea, tmp, du);\
+                *ptr++ = lsl(tmp, tmp, 16);\
+                *ptr++ = subs_reg(31, tmp, dc, LSL, 16);\
+                break;\
+            case 3:\
+                *ptr++ = mov_reg(tmp, dc);\
+                *ptr++ = casal(ea, tmp, du);\
+                *ptr++ = subs_reg(31, tmp, dc, LSL, 0);\
+                break;\
+        }\
+        *ptr++ = b_cc(A64_CC_EQ, 2);\
+        switch (size) \
+        {\
+            case 1:\
+                *ptr++ = bfxil(dc, tmp, 24, 8);\
+                break;\
+            case 2:\
+                *ptr++ = bfxil(dc, tmp, 16, 16);\
+                break;\
+            case 3:\
+                *ptr++ = mov_reg(dc, tmp);\
+                break;\
+        }\
+} while(0)
+
+/* Bus emulation knows exclusive loads and stores only, LSE is used above the 24-bit Amiga space */
+#define CAS_ATOMIC_ANY() do { \
+        if (Features.ARM_SUPPORTS_LSE) \
+        { \
+            *ptr++ = lsr(status, ea, 24);\
+            uint32_t *b_bus = ptr;\
+            *ptr++ = cbz(status, 0);\
+            CAS_LSE();\
+            uint32_t *b_done = ptr;\
+            *ptr++ = b(0);\
+            *b_bus = cbz(status, ptr - b_bus);\
+            CAS_ATOMIC();\
+            *b_done = b(ptr - b_done);\
+        } \
+        else \
+            CAS_ATOMIC();\
+} while(0)
+
 #define CAS_UNSAFE() do { \
         switch (size) \
         { \
@@ -2331,8 +2372,8 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     {
         uint8_t ext_words = 2;
         uint8_t size = (opcode >> 9) & 3;
-        uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
-        uint16_t opcode3 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+        uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+        uint16_t opcode3 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
 
         uint8_t rn1 = RA_MapM68kRegister(&ptr, (opcode2 >> 12) & 15);
         uint8_t rn2 = RA_MapM68kRegister(&ptr, (opcode3 >> 12) & 15);
@@ -2415,7 +2456,7 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     else
     {
         uint8_t ext_words = 1;
-        uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+        uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
         uint8_t ea = -1;
         uint8_t du = RA_MapM68kRegister(&ptr, (opcode2 >> 6) & 7);
         uint8_t dc = RA_MapM68kRegister(&ptr, opcode2 & 7);
@@ -2452,21 +2493,21 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 
         if (size == 1)
         {
-            CAS_ATOMIC();
+            CAS_ATOMIC_ANY();
         }
         else if ((opcode & 0x3f) == 0x38)
         {
             switch(size)
             {
                 case 2:
-                    if (cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]) & 1)
+                    if (cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]) & 1)
                         CAS_UNSAFE();
                     else
-                        CAS_ATOMIC();
+                        CAS_ATOMIC_ANY();
                     break;
                 case 3:
-                    if ((cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]) & 3) == 0)
-                        CAS_ATOMIC();
+                    if ((cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]) & 3) == 0)
+                        CAS_ATOMIC_ANY();
                     else
                         CAS_UNSAFE();
                     break;
@@ -2477,14 +2518,14 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             switch(size)
             {
                 case 2:
-                    if (cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[2]) & 1)
+                    if (cache_fetch_16((uintptr_t)&(*m68k_ptr)[2]) & 1)
                         CAS_UNSAFE();
                     else
-                        CAS_ATOMIC();
+                        CAS_ATOMIC_ANY();
                     break;
                 case 3:
-                    if ((cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[2]) & 3) == 0)
-                        CAS_ATOMIC();
+                    if ((cache_fetch_16((uintptr_t)&(*m68k_ptr)[2]) & 3) == 0)
+                        CAS_ATOMIC_ANY();
                     else
                         CAS_UNSAFE();
                     break;
@@ -2510,7 +2551,7 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             CAS_UNSAFE();
             b_ = ptr;
             *ptr++ = b(0);
-            CAS_ATOMIC();
+            CAS_ATOMIC_ANY();
             *b_ = b(ptr - b_);
             *b_eq = b_cc(A64_CC_EQ, 1 + b_ - b_eq);
         }
@@ -2566,7 +2607,7 @@ uint32_t *EMIT_CAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 
 uint32_t *EMIT_MOVEP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
-    int32_t offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int32_t offset = (int16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t an = RA_MapM68kRegister(&ptr, 8 + (opcode & 7));
     uint8_t dn = RA_MapM68kRegister(&ptr, (opcode >> 9) & 7);
     uint8_t tmp = RA_AllocARMRegister(&ptr);
@@ -2674,7 +2715,7 @@ uint32_t *EMIT_MOVES(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t cc = RA_GetCC(&ptr);
     uint8_t size = (opcode >> 6) & 3;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint32_t *tmp;
     uint32_t *tmp_priv;
     uint8_t ext_count = 1;
@@ -3015,7 +3056,7 @@ static struct OpcodeDef InsnTable[4096] = {
 uint32_t *EMIT_line0(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
 
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     *insn_consumed = 1;
     (*m68k_ptr)++;
 
@@ -3053,7 +3094,7 @@ uint32_t GetSR_Line0(uint16_t opcode)
 
 int M68K_GetLine0Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*insn_stream));
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*insn_stream));
     
     int length = 0;
     int need_ea = 0;
@@ -11,6 +11,8 @@
 #include "M68k.h"
 #include "RegisterAllocator.h"
 #include "cache.h"
+#include "EmuFeatures.h"
+#include "jitstats.h"
 
 uint32_t *EMIT_MUL_DIV(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr);
 
@@ -22,6 +24,49 @@ uint32_t *EMIT_MUL_DIV_(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uin
 
 
 extern uint32_t insn_count;
+extern int m68k_exit_return;
+extern int m68k_exit_exception;
+extern int m68k_exit_indirect;
+extern uint16_t * m68k_exit_target;
+extern uint32_t jit_control;
+
+/* Set flag of cleared CC if the bit of src is set. Branch or data dependency, as the host core prefers */
+static inline uint32_t *EMIT_FlagFromBit(uint32_t *ptr, uint8_t cc, uint8_t src, uint8_t bit, uint8_t flag)
+{
+    if (Features.ARM_BRANCHLESS_FLAGS)
+    {
+        uint8_t tmp = RA_AllocARMRegister(&ptr);
+        *ptr++ = ubfx(tmp, src, bit, 1);
+        *ptr++ = orr_reg(cc, cc, tmp, LSL, flag);
+        RA_FreeARMRegister(&ptr, tmp);
+    }
+    else
+    {
+        *ptr++ = tbz(src, bit, 2);
+        *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - flag));
+    }
+
+    return ptr;
+}
+
+/*
+    Target of JMP/JSR is static if given as absolute address or relative to PC.
+    Returns 0xffffffff otherwise.
+*/
+static uint16_t *GetStaticJumpTarget(uint16_t opcode, uint16_t *m68k_ptr)
+{
+    switch (opcode & 0x3f)
+    {
+        case 0x38:  /* (xxx).W */
+            return (uint16_t *)(uintptr_t)(uint32_t)(int32_t)(int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[0]);
+        case 0x39:  /* (xxx).L */
+            return (uint16_t *)(uintptr_t)cache_fetch_32((uintptr_t)&m68k_ptr[0]);
+        case 0x3a:  /* (d16, PC) */
+            return (uint16_t *)(uintptr_t)(uint32_t)((uintptr_t)&m68k_ptr[0] + (int16_t)cache_fetch_16((uintptr_t)&m68k_ptr[0]));
+        default:
+            return (uint16_t *)0xffffffff;
+    }
+}
 
 uint32_t *EMIT_CLR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
@@ -519,8 +564,7 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
 
                         if (update_mask & SR_V)
                         {
-                            *ptr++ = tbz(tmp_2, 15, 2);
-                            *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Valt));
+                            ptr = EMIT_FlagFromBit(ptr, cc, tmp_2, 15, SRB_Valt);
                         }
                         
                         if ((update_mask & SR_XC) == SR_XC)
@@ -531,13 +575,11 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
                         }
                         else if ((update_mask & SR_XC) == SR_C)
                         {
-                            *ptr++ = tbz(tmp, 16, 2);
-                            *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Calt));
+                            ptr = EMIT_FlagFromBit(ptr, cc, tmp, 16, SRB_Calt);
                         }
                         else if ((update_mask & SR_XC) == SR_X)
                         {
-                            *ptr++ = tbz(tmp, 16, 2);
-                            *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_X));
+                            ptr = EMIT_FlagFromBit(ptr, cc, tmp, 16, SRB_X);
                         }
 
 
@@ -567,8 +609,7 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
 
                         if (update_mask & SR_V)
                         {
-                            *ptr++ = tbz(tmp_2, 7, 2);
-                            *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Valt));
+                            ptr = EMIT_FlagFromBit(ptr, cc, tmp_2, 7, SRB_Valt);
                         }
                         
                         if ((update_mask & SR_XC) == SR_XC)
@@ -579,13 +620,11 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
                         }
                         else if ((update_mask & SR_XC) == SR_C)
                         {
-                            *ptr++ = tbz(tmp, 8, 2);
-                            *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Calt));
+                            ptr = EMIT_FlagFromBit(ptr, cc, tmp, 8, SRB_Calt);
                         }
                         else if ((update_mask & SR_XC) == SR_X)
                         {
-                            *ptr++ = tbz(tmp, 8, 2);
-                            *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_X));
+                            ptr = EMIT_FlagFromBit(ptr, cc, tmp, 8, SRB_X);
                         }
 
                         update_mask &= ~SR_XVC;             // Don't nag anymore with the flags
@@ -659,8 +698,7 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
 
                 if (update_mask & SR_V)
                 {
-                    *ptr++ = tbz(tmp_2, 15, 2);
-                    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Valt));
+                    ptr = EMIT_FlagFromBit(ptr, cc, tmp_2, 15, SRB_Valt);
                 }
                 
                 if ((update_mask & SR_XC) == SR_XC)
@@ -671,13 +709,11 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
                 }
                 else if ((update_mask & SR_XC) == SR_C)
                 {
-                    *ptr++ = tbz(tmp, 16, 2);
-                    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Calt));
+                    ptr = EMIT_FlagFromBit(ptr, cc, tmp, 16, SRB_Calt);
                 }
                 else if ((update_mask & SR_XC) == SR_X)
                 {
-                    *ptr++ = tbz(tmp, 16, 2);
-                    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_X));
+                    ptr = EMIT_FlagFromBit(ptr, cc, tmp, 16, SRB_X);
                 }
 
                 update_mask &= ~SR_XVC;             // Don't nag anymore with the flags
@@ -719,8 +755,7 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
 
                 if (update_mask & SR_V)
                 {
-                    *ptr++ = tbz(tmp_2, 7, 2);
-                    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Valt));
+                    ptr = EMIT_FlagFromBit(ptr, cc, tmp_2, 7, SRB_Valt);
                 }
                 
                 if ((update_mask & SR_XC) == SR_XC)
@@ -731,13 +766,11 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
                 }
                 else if ((update_mask & SR_XC) == SR_C)
                 {
-                    *ptr++ = tbz(tmp, 8, 2);
-                    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Calt));
+                    ptr = EMIT_FlagFromBit(ptr, cc, tmp, 8, SRB_Calt);
                 }
                 else if ((update_mask & SR_XC) == SR_X)
                 {
-                    *ptr++ = tbz(tmp, 8, 2);
-                    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_X));
+                    ptr = EMIT_FlagFromBit(ptr, cc, tmp, 8, SRB_X);
                 }
                 update_mask &= ~SR_XVC;             // Don't nag anymore with the flags
 
@@ -810,12 +843,12 @@ uint32_t *EMIT_NEGX(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_
 
 uint32_t *EMIT_TST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    (void)insn_consumed;
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
     uint8_t ext_count = 0;
     uint8_t immed = RA_AllocARMRegister(&ptr);
     uint8_t dest = 0xff;
     uint8_t size = 0;
+    uint8_t fused = FUSED_NONE;
 
     /* Load immediate into the register */
     switch (opcode & 0x00c0)
@@ -837,18 +870,24 @@ uint32_t *EMIT_TST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t
         /* Fetch m68k register */
         dest = RA_MapM68kRegister(&ptr, opcode & 7);
 
-        /* Perform add operation */
-        switch (size)
+        /* tst.l Dn followed by beq or bne tests the register itself */
+        if (size == 4 && M68K_CanFuseBcc(*m68k_ptr, SR_NZVC, FUSED_ZERO))
+            fused = FUSED_ZERO;
+        else
         {
-            case 4:
-                *ptr++ = cmn_reg(31, dest, LSL, 0);
-                break;
-            case 2:
-                *ptr++ = cmn_reg(31, dest, LSL, 16);
-                break;
-            case 1:
-                *ptr++ = cmn_reg(31, dest, LSL, 24);
-                break;
+            /* Perform add operation */
+            switch (size)
+            {
+                case 4:
+                    *ptr++ = cmn_reg(31, dest, LSL, 0);
+                    break;
+                case 2:
+                    *ptr++ = cmn_reg(31, dest, LSL, 16);
+                    break;
+                case 1:
+                    *ptr++ = cmn_reg(31, dest, LSL, 24);
+                    break;
+            }
         }
     }
     else
@@ -877,6 +916,13 @@ uint32_t *EMIT_TST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
     (*m68k_ptr) += ext_count;
 
+    /* Following Bcc branches on host flags, CCR is not updated at all */
+    if (fused == FUSED_NONE && M68K_CanFuseBcc(*m68k_ptr, SR_NZVC, FUSED_ADDS))
+        fused = FUSED_ADDS;
+
+    if (fused != FUSED_NONE)
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, fused, dest);
+
     if (update_mask)
     {
         uint8_t cc = RA_ModifyCC(&ptr);
@@ -887,6 +933,12 @@ uint32_t *EMIT_TST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t
         if (update_mask & SR_N)
             ptr = EMIT_SetFlagsConditional(ptr, cc, SR_N, ARM_CC_MI);
     }
+
+#if EMU68_LIVE_FLAGS_BRANCH
+    /* CCR is up to date, host flags still hold the test */
+    if (M68K_CanFuseBcc(*m68k_ptr, 0, FUSED_ADDS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_ADDS, 0xff);
+#endif
     return ptr;
 }
 
@@ -925,12 +977,34 @@ uint32_t *EMIT_TAS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t
             RA_SetDirtyM68kRegister(&ptr, 8 + (opcode & 7));
         }
 
+        uint32_t *b_bus = NULL;
+        uint32_t *b_done = NULL;
+
+        /*
+            Bus emulation knows exclusive loads and stores only, LSE is used above the 24-bit
+            Amiga space
+        */
+        if (Features.ARM_SUPPORTS_LSE)
+        {
+            *ptr++ = lsr(tmpstate, dest, 24);
+            b_bus = ptr;
+            *ptr++ = cbz(tmpstate, 0);
+            *ptr++ = mov_immed_u16(tmpreg, 0x80, 0);
+            *ptr++ = ldsetalb(dest, tmpreg, tmpresult);
+            b_done = ptr;
+            *ptr++ = b(0);
+            *b_bus = cbz(tmpstate, ptr - b_bus);
+        }
+
         *ptr++ = ldxrb(dest, tmpresult);
         *ptr++ = orr_immed(tmpreg, tmpresult, 1, 25);
         *ptr++ = stxrb(dest, tmpreg, tmpstate);
         *ptr++ = cmp_reg(31, tmpstate, LSL, 0);
         *ptr++ = b_cc(A64_CC_NE, -4);
 
+        if (b_done)
+            *b_done = b(ptr - b_done);
+
         if (mode == 3)
         {
             *ptr++ = add_immed(dest, dest, (opcode & 7) == 7 ? 2 : 1);
@@ -977,15 +1051,28 @@ static uint32_t *EMIT_MOVEfromSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k
     tmpptr = ptr;
     *ptr++ = b_cc(A64_CC_EQ, 23);
 
-    uint8_t tmp_cc = RA_AllocARMRegister(&ptr);
+    if ((opcode & 0x38) == 0)
+    {
+        /* Dn direct, insert SR into the register without a copy */
+        uint8_t dest = RA_MapM68kRegister(&ptr, opcode & 7);
+        RA_SetDirtyM68kRegister(&ptr, opcode & 7);
 
-    *ptr++ = mov_reg(tmp_cc, cc);
-    *ptr++ = rbit(0, cc);
-    *ptr++ = bfxil(tmp_cc, 0, 30, 2);
+        *ptr++ = bfi(dest, cc, 0, 16);
+        *ptr++ = rbit(0, cc);
+        *ptr++ = bfxil(dest, 0, 30, 2);
+    }
+    else
+    {
+        uint8_t tmp_cc = RA_AllocARMRegister(&ptr);
+
+        *ptr++ = mov_reg(tmp_cc, cc);
+        *ptr++ = rbit(0, cc);
+        *ptr++ = bfxil(tmp_cc, 0, 30, 2);
 
-    ptr = EMIT_StoreToEffectiveAddress(ptr, 2, &tmp_cc, opcode & 0x3f, *m68k_ptr, &ext_words, 0);
+        ptr = EMIT_StoreToEffectiveAddress(ptr, 2, &tmp_cc, opcode & 0x3f, *m68k_ptr, &ext_words, 0);
 
-    RA_FreeARMRegister(&ptr, tmp_cc);
+        RA_FreeARMRegister(&ptr, tmp_cc);
+    }
 
     *tmpptr = b_cc(A64_CC_EQ, 2 + ptr - tmpptr);
 
@@ -1046,6 +1133,46 @@ static uint32_t *EMIT_MOVEfromCCR(uint32_t *ptr, uint16_t opcode, uint16_t **m68
     return ptr;
 }
 
+/*
+    Stack switch and ARM interrupt mask for a new SR known at translation time, e.g.
+    move #$2700,sr or stop #$2000. Only M of the current SR has to be tested, the code runs in
+    supervisor mode. Must be emitted before cc gets the new value. new_sr has C and V swapped
+*/
+static uint32_t *EMIT_SwitchToKnownSR(uint32_t *ptr, uint8_t cc, uint8_t sp, uint16_t new_sr)
+{
+    if (!(new_sr & SR_S))
+    {
+        /* To user mode. Save A7 to ISP or MSP, load USP */
+        *ptr++ = tbz(cc, SRB_M, 3);
+        *ptr++ = mov_reg_to_simd(31, TS_S, 3, sp);  // Save to MSP
+        *ptr++ = b(2);
+        *ptr++ = mov_reg_to_simd(31, TS_S, 2, sp);  // Save to ISP
+        *ptr++ = mov_simd_to_reg(sp, 31, TS_S, 1);  // Load USP
+    }
+    else if (new_sr & SR_M)
+    {
+        /* To master stack, nothing to do if M was set already */
+        *ptr++ = tbnz(cc, SRB_M, 3);
+        *ptr++ = mov_reg_to_simd(31, TS_S, 2, sp);  // Save to ISP
+        *ptr++ = mov_simd_to_reg(sp, 31, TS_S, 3);  // Load MSP
+    }
+    else
+    {
+        /* To interrupt stack, nothing to do if M was clear already */
+        *ptr++ = tbz(cc, SRB_M, 3);
+        *ptr++ = mov_reg_to_simd(31, TS_S, 3, sp);  // Save to MSP
+        *ptr++ = mov_simd_to_reg(sp, 31, TS_S, 2);  // Load ISP
+    }
+
+    // IPL less than 6 enables ARM interrupts
+    if (((new_sr >> SRB_IPL) & 7) > 5)
+        *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
+    else
+        *ptr++ = msr_imm(3, 7, 7); // Enable interrupts
+
+    return ptr;
+}
+
 static uint32_t *EMIT_MOVEtoSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)insn_consumed;
@@ -1062,13 +1189,31 @@ static uint32_t *EMIT_MOVEtoSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
     ptr = EMIT_FlushPC(ptr);
 
     /* If supervisor is not active, put an exception here */
-    tmpptr = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmpptr);
 
-    *tmpptr = tbnz(cc, SRB_S, 1 + ptr - tmpptr);
-    tmpptr = ptr;
-    ptr++;
+    /* Immediate source, the usual move #$2700,sr and move #$2000,sr. Transition is known */
+    if ((opcode & 0x3f) == 0x3c)
+    {
+        uint16_t new_sr = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]) & 0xf71f;
+
+        /* Swap C and V in new SR */
+        if ((new_sr & 3) != 0 && (new_sr & 3) < 3)
+        {
+            new_sr ^= 3;
+        }
+
+        ptr = EMIT_SwitchToKnownSR(ptr, cc, sp, new_sr);
+        *ptr++ = mov_immed_u16(cc, new_sr, 0);
+        *ptr++ = add_immed(REG_PC, REG_PC, 4);
+
+        EMIT_Rejoin(tmpptr, ptr);
+
+        *ptr++ = INSN_TO_LE(0xffffffff);
+
+        (*m68k_ptr) += 1;
+
+        return ptr;
+    }
 
     *ptr++ = mov_reg(orig, cc);
     *ptr++ = mov_immed_u16(changed, 0xf71f, 0);
@@ -1118,7 +1263,7 @@ static uint32_t *EMIT_MOVEtoSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
     *ptr++ = b(2);
     *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
 
-    *tmpptr = b(ptr - tmpptr);
+    EMIT_Rejoin(tmpptr, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
@@ -1173,7 +1318,11 @@ static uint32_t *EMIT_EXT(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
         then combine both to extb.l 
     */
 
-    if ((mode == 2) && (opcode ^ cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0])) == 0x40) {
+    if ((mode == 2) && (opcode ^ cache_fetch_16((uintptr_t)&(*m68k_ptr)[0])) == 0x40
+#if EMU68_TRACE_CACHE
+        && !m68k_single_step
+#endif
+    ) {
         (*m68k_ptr)++;
         mode = 7;
         (*insn_consumed)++;
@@ -1225,7 +1374,7 @@ static uint32_t *EMIT_LINK32(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr
     uint8_t sp;
     uint8_t displ;
     uint8_t reg;
-    int32_t offset = (cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]) << 16) | cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+    int32_t offset = (cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]) << 16) | cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
 
     displ = RA_AllocARMRegister(&ptr);
     *ptr++ = movw_immed_u16(displ, offset & 0xffff);
@@ -1260,7 +1409,7 @@ static uint32_t *EMIT_LINK16(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr
     uint8_t sp;
     uint8_t displ;
     uint8_t reg;
-    int16_t offset = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int16_t offset = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
     displ = RA_AllocARMRegister(&ptr);
 
@@ -1305,7 +1454,12 @@ static uint32_t *EMIT_LINK16(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr
 
 static uint32_t *EMIT_SWAP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    (void)insn_consumed;
+    /* SWAP, RO(R/L).W #8, SWAP, RO(R/L).W #8 on the same Dn is replaced by REV16 */
+    uint32_t *swapped = EMIT_ByteSwap(ptr, m68k_ptr, insn_consumed);
+
+    if (swapped)
+        return swapped;
+
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
     uint8_t reg = RA_MapM68kRegister(&ptr, opcode & 7);
     RA_SetDirtyM68kRegister(&ptr, opcode & 7);
@@ -1477,15 +1631,18 @@ static uint32_t *EMIT_NOP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     return ptr;
 }
 
+#if defined(PISTORM) && PISTORM_STOP_WAKE
+volatile uint8_t m68k_stop_level = 0xff;
+volatile uint64_t m68k_stop_event;
+#endif
+
 static uint32_t *EMIT_STOP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)insn_consumed;
     (void)opcode;
 
     uint32_t *tmpptr;
-    uint16_t new_sr = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]) & 0xf71f;
-    uint8_t changed = RA_AllocARMRegister(&ptr);
-    uint8_t orig = RA_AllocARMRegister(&ptr);
+    uint16_t new_sr = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]) & 0xf71f;
     uint8_t cc = RA_ModifyCC(&ptr);
     uint8_t sp = RA_MapM68kRegister(&ptr, 15);
 
@@ -1500,52 +1657,17 @@ static uint32_t *EMIT_STOP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     }
 
     /* If supervisor is not active, put an exception here */
-    tmpptr = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *tmpptr = tbnz(cc, SRB_S, 1 + ptr - tmpptr);
-    tmpptr = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmpptr);
 
     cc = RA_ModifyCC(&ptr);
 
-    /* Put new value into SR, check what has changed */
-    *ptr++ = mov_reg(orig, cc);
+    /* New SR is known, switch stack and put it into SR */
+    ptr = EMIT_SwitchToKnownSR(ptr, cc, sp, new_sr);
     *ptr++ = mov_immed_u16(cc, new_sr, 0);
-    *ptr++ = eor_reg(changed, orig, cc, LSL, 0);
-
-    /* Perform eventual stack switch */
-
-    /* If neither S nor M changed, go further */
-    *ptr++ = ands_immed(31, changed, 2, 32 - SRB_M);
-    *ptr++ = b_cc(A64_CC_EQ, 12);
-
-    /* S or M changed. First of all, store stack pointer to either ISP or MSP */
-    *ptr++ = tbz(orig, SRB_M, 3);
-    *ptr++ = mov_reg_to_simd(31, TS_S, 3, sp);  // Save to MSP
-    *ptr++ = b(2);
-    *ptr++ = mov_reg_to_simd(31, TS_S, 2, sp);  // Save to ISP
-
-    /* Check if changing mode to user */
-    *ptr++ = tbz(changed, SRB_S, 3);
-    *ptr++ = mov_simd_to_reg(sp, 31, TS_S, 1);
-    *ptr++ = b(5);
-    *ptr++ = tbz(cc, SRB_M, 3);
-    *ptr++ = mov_simd_to_reg(sp, 31, TS_S, 3);  // Load MSP
-    *ptr++ = b(2);
-    *ptr++ = mov_simd_to_reg(sp, 31, TS_S, 2);  // Load ISP
 
     /* Now do what stop does - wait for interrupt */
     *ptr++ = add_immed(REG_PC, REG_PC, 4);
 
-    // Check if IPL is less than 6. If yes, enable ARM interrupts
-    *ptr++ = and_immed(changed, cc, 3, 32 - SRB_IPL);
-    *ptr++ = cmp_immed(changed, 5 << SRB_IPL);
-    *ptr++ = b_cc(A64_CC_GT, 3);
-    *ptr++ = msr_imm(3, 7, 7); // Enable interrupts
-    *ptr++ = b(2);
-    *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
-
 #ifndef PISTORM
     /* Non pistorm machines wait for interrupt only */
     *ptr++ = wfi();
@@ -1554,6 +1676,60 @@ static uint32_t *EMIT_STOP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     uint8_t ctx = RA_GetCTX(&ptr);
     uint32_t *start, *end;
 
+#if PISTORM_STOP_WAKE
+    uint8_t addr = RA_AllocARMRegister(&ptr);
+    uint8_t level = (new_sr & SR_IPL) >> SRB_IPL;
+    uint32_t *wake_int;
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    /* Level 7 is never masked */
+    if (level > 6)
+        level = 6;
+
+    /*
+        Publish the level before INT is read, the housekeeper stores INT before it reads the level.
+        Either it sees the level and sends the event, or INT is seen here and wfe is skipped
+    */
+    u.u64 = (uintptr_t)&m68k_stop_level;
+    *ptr++ = mov64_immed_u16(addr, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(addr, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(addr, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(addr, u.u16[0], 3);
+    *ptr++ = mov_immed_u16(tmpreg, level, 0);
+    *ptr++ = strb_offset(addr, tmpreg, 0);
+    *ptr++ = dmb_ish();
+
+    start = ptr;
+    *ptr++ = ldr_offset(ctx, tmpreg, __builtin_offsetof(struct M68KState, INT));
+#ifdef PISTORM32
+    /* ARM, ARM_err and RESET wake always, IPL only if above the new mask */
+    *ptr++ = tst_immed(tmpreg, 24, 16);
+    wake_int = ptr++;
+    *ptr++ = ubfx(tmpreg, tmpreg, 8, 8);
+    *ptr++ = cmp_immed(tmpreg, level);
+    uint32_t *wake_ipl = ptr++;
+    *ptr++ = wfe();
+    end = ptr;
+    *ptr++ = b(start - end);
+    *wake_int = b_cc(A64_CC_NE, ptr - wake_int);
+    *wake_ipl = b_cc(A64_CC_HI, ptr - wake_ipl);
+#else
+    /* IPL is only a flag of active line here, any INT wakes */
+    wake_int = ptr++;
+    *ptr++ = wfe();
+    end = ptr;
+    *ptr++ = b(start - end);
+    *wake_int = cbnz(tmpreg, ptr - wake_int);
+#endif
+
+    *ptr++ = mov_immed_u16(tmpreg, 0xff, 0);
+    *ptr++ = strb_offset(addr, tmpreg, 0);
+
+    RA_FreeARMRegister(&ptr, addr);
+#else
     // Don't wait for event if IRQ is already pending
     *ptr++ = ldr_offset(ctx, tmpreg, __builtin_offsetof(struct M68KState, INT));
     *ptr++ = cbnz(tmpreg, 4);
@@ -1565,17 +1741,15 @@ static uint32_t *EMIT_STOP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     *ptr++ = ldr_offset(ctx, tmpreg, __builtin_offsetof(struct M68KState, INT));
     end = ptr;
     *ptr++ = cbz(tmpreg, start - end);
+#endif
 
     RA_FreeARMRegister(&ptr, tmpreg);
 #endif
 
-    *tmpptr = b(ptr - tmpptr);
+    EMIT_Rejoin(tmpptr, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
-    RA_FreeARMRegister(&ptr, changed);
-    RA_FreeARMRegister(&ptr, orig);
-
     (*m68k_ptr) += 1;
 
     return ptr;
@@ -1602,12 +1776,7 @@ static uint32_t *EMIT_RTE(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
 
     // First check if supervisor mode
     /* If supervisor is not active, put an exception here */
-    branch_privilege = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *branch_privilege = tbnz(cc, SRB_S, 1 + ptr - branch_privilege);
-    branch_privilege = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &branch_privilege);
 
     // Now check frame format
     *ptr++ = ldrh_offset(sp, tmp, 6);
@@ -1679,10 +1848,11 @@ static uint32_t *EMIT_RTE(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     *ptr++ = b(2);
     *ptr++ = msr_imm(3, 6, 7); // Mask interrupts
 
-    *branch_privilege = b(ptr - branch_privilege);
+    EMIT_Rejoin(branch_privilege, ptr);
     *branch_format = b(ptr - branch_format);
 
-    // Instruction always breaks translation
+    // Instruction always breaks translation, the exit may return into the interrupted unit
+    m68k_exit_exception = TRUE;
     *ptr++ = INSN_TO_LE(0xffffffff);
 
     RA_FreeARMRegister(&ptr, tmp);
@@ -1701,7 +1871,7 @@ static uint32_t *EMIT_RTD(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     uint8_t tmp = RA_AllocARMRegister(&ptr);
     uint8_t tmp2 = RA_AllocARMRegister(&ptr);
     uint8_t sp = RA_MapM68kRegister(&ptr, 15);
-    int16_t addend = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    int16_t addend = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
     /* Fetch return address from stack */
     *ptr++ = ldr_offset_postindex(sp, tmp2, 4);
@@ -1733,6 +1903,7 @@ static uint32_t *EMIT_RTD(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     ptr = EMIT_ResetOffsetPC(ptr);
     *ptr++ = mov_reg(REG_PC, tmp2);
     RA_SetDirtyM68kRegister(&ptr, 15);
+    m68k_exit_return = TRUE;
     *ptr++ = INSN_TO_LE(0xffffffff);
     RA_FreeARMRegister(&ptr, tmp);
     RA_FreeARMRegister(&ptr, tmp2);
@@ -1783,7 +1954,10 @@ static uint32_t *EMIT_RTS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
         *ptr++ = INSN_TO_LE(0xfffffffe);
     }
     else
+    {
+        m68k_exit_return = TRUE;
         *ptr++ = INSN_TO_LE(0xffffffff);
+    }
 
     return ptr;
 }
@@ -1807,7 +1981,7 @@ static uint32_t *EMIT_TRAPV(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     *tmpptr = b_cc(A64_CC_EQ, ptr - tmpptr);
     *ptr++ = (uint32_t)(uintptr_t)tmpptr;
     *ptr++ = 1;
-    *ptr++ = 0;
+    *ptr++ = EXIT_COLD;
     *ptr++ = INSN_TO_LE(0xfffffffe);
 
     return ptr;
@@ -1836,6 +2010,7 @@ static uint32_t *EMIT_RTR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     *ptr++ = ldr_offset_postindex(sp, REG_PC, 4);
     ptr = EMIT_ResetOffsetPC(ptr);
     RA_SetDirtyM68kRegister(&ptr, 15);
+    m68k_exit_return = TRUE;
     *ptr++ = INSN_TO_LE(0xffffffff);
     RA_FreeARMRegister(&ptr, mask);
     RA_FreeARMRegister(&ptr, tmp);
@@ -1843,11 +2018,81 @@ static uint32_t *EMIT_RTR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     return ptr;
 }
 
+#if EMU68_M68K_MMU
+extern struct M68KState *__m68k_state;
+
+#define MMU_AVAILABLE() (__m68k_state->JIT_CONTROL2 & JC2F_M68K_MMU)
+
+/* MMU register written, host tables follow it */
+static uint32_t *EMIT_MMUUpdate(uint32_t *ptr)
+{
+    if (MMU_AVAILABLE())
+        ptr = EMIT_MMUCall(ptr, M68K_MMUUpdate, 0xff, 0);
+
+    return ptr;
+}
+#else
+#define MMU_AVAILABLE() 0
+#define EMIT_MMUUpdate(ptr) (ptr)
+#endif
+
+#if EMU68_LAZY_RETUNE && EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+/* Units built before leave through the main loop on next entry, see M68K_RevalidateUnit */
+static uint32_t *EMIT_BumpGeneration(uint32_t *ptr, uint8_t ctx, uint8_t tmp)
+{
+    *ptr++ = ldr_offset(ctx, tmp, __builtin_offsetof(struct M68KState, JIT_FLUSH_GEN));
+    *ptr++ = add_immed(tmp, tmp, 1);
+    *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, JIT_FLUSH_GEN));
+
+    return ptr;
+}
+
+/* Store JITCTRL or JITCTRL2, the generation is bumped only if the value has changed */
+static uint32_t *EMIT_SetJITControl(uint32_t *ptr, uint8_t ctx, uint8_t reg, uint32_t offset)
+{
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+
+    *ptr++ = ldr_offset(ctx, tmp, offset);
+    *ptr++ = cmp_reg(tmp, reg, LSL, 0);
+    *ptr++ = b_cc(A64_CC_EQ, 5);
+    *ptr++ = str_offset(ctx, reg, offset);
+    ptr = EMIT_BumpGeneration(ptr, ctx, tmp);
+
+    RA_FreeARMRegister(&ptr, tmp);
+
+    return ptr;
+}
+
+/* Address of the override entry selected by JITOVRSEL into tmp, tmp2 is clobbered */
+static uint32_t *EMIT_OverrideEntry(uint32_t *ptr, uint8_t tmp, uint8_t tmp2)
+{
+    union {
+        uint16_t u16[4];
+        uint64_t u64;
+    } u;
+
+    u.u64 = (uintptr_t)&jit_override_select;
+    *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+    *ptr++ = ldr_offset(tmp, tmp2, 0);
+    u.u64 = (uintptr_t)&jit_overrides[0];
+    *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+    *ptr++ = add64_reg(tmp, tmp, tmp2, LSL, 4);
+
+    return ptr;
+}
+#endif
+
 static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)insn_consumed;
 
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t dr = opcode & 1;
     uint8_t reg = RA_MapM68kRegister(&ptr, opcode2 >> 12);
     uint8_t ctx = RA_GetCTX(&ptr);
@@ -1869,12 +2114,7 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     ptr = EMIT_FlushPC(ptr);
 
     /* If supervisor is not active, put an exception here */
-    tmpptr = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *tmpptr = tbnz(cc, SRB_S, 1 + ptr - tmpptr);
-    tmpptr = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmpptr);
 
     if (dr)
     {
@@ -1923,7 +2163,11 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 *ptr++ = str_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_SOFTFLUSH_THRESH));
                 break;
             case 0x0eb: /* JITCTRL - JIT control register */
+#if EMU68_LAZY_RETUNE && EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+                ptr = EMIT_SetJITControl(ptr, ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL));
+#else
                 *ptr++ = str_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL));
+#endif
                 break;
             case 0x0ed: /* DBGCTRL */
             {
@@ -1953,6 +2197,15 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                     *ptr++ = ubfx(tmp2, reg, 2, 1);
                     *ptr++ = str_offset(tmp, tmp2, 0);
                 }
+#if EMU68_JIT_STATS
+                u.u64 = (uintptr_t)&opmix;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ubfx(tmp2, reg, 3, 1);
+                *ptr++ = str_offset(tmp, tmp2, 0);
+#endif
                 RA_FreeARMRegister(&ptr, tmp);
                 RA_FreeARMRegister(&ptr, tmp2);
                 break;
@@ -1978,14 +2231,87 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 RA_FreeARMRegister(&ptr, tmp);
                 break;
             case 0x1e0: /* JITCTRL2 - JIT second control register */
+#if EMU68_LAZY_RETUNE && EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+                ptr = EMIT_SetJITControl(ptr, ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL2));
+#else
                 *ptr++ = str_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL2));
+#endif
+                break;
+#if EMU68_LAZY_RETUNE && EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+            case 0x1ed: /* JITOVRSEL - Select entry of JIT override table */
+            {
+                uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&jit_override_select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = and_immed(tmp2, reg, EMU68_JIT_OVERRIDE_BITS, 0);
+                *ptr++ = str_offset(tmp, tmp2, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                RA_FreeARMRegister(&ptr, tmp2);
+                break;
+            }
+            case 0x1ee: /* JITOVRLO - Lowest address of selected override */
+            case 0x1ef: /* JITOVRHI - Highest address of selected override */
+            case 0x1f0: /* JITOVRCTRL - JITCTRL for units starting within range, 0 disables */
+            {
+                uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+                tmp = RA_AllocARMRegister(&ptr);
+                ptr = EMIT_OverrideEntry(ptr, tmp, tmp2);
+                *ptr++ = str_offset(tmp, reg, 4 * ((opcode2 & 0xfff) - 0x1ee));
+                ptr = EMIT_BumpGeneration(ptr, ctx, tmp2);
+                RA_FreeARMRegister(&ptr, tmp);
+                RA_FreeARMRegister(&ptr, tmp2);
                 break;
+            }
+#endif
+#if EMU68_JIT_STATS
+            case 0x1eb: /* JITSTATSEL - Select word of JIT statistics */
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&jit_stats_select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = str_offset(tmp, reg, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                break;
+#endif
+#if EMU68_JIT_EXPORT
+            case 0x1f1: /* JITEXPORT - Write snapshot of units used at least given number of times */
+                u.u64 = (uintptr_t)M68K_ExportUnits;
+                ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+                *ptr++ = mov_reg(0, reg);
+                *ptr++ = mov64_immed_u16(1, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(1, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(1, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(1, u.u16[0], 3);
+                *ptr++ = blr(1);
+                ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+                break;
+#endif
+#if EMU68_PMU_PROFILE
+            case 0x1e4: /* PMUSEL - Select entry of PMU top list */
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&pmu_state.pp_Select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = str_offset(tmp, reg, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                break;
+#endif
             case 0x003: // TCR - write bits 15, 14, read all zeros for now
                 tmp = RA_AllocARMRegister(&ptr);
                 *ptr++ = bic_immed(tmp, reg, 30, 16);
-                *ptr++ = bic_immed(tmp, tmp, 1, 32 - 15); // Clear E bit, do not allow turning on MMU
+                if (!MMU_AVAILABLE())
+                    *ptr++ = bic_immed(tmp, tmp, 1, 32 - 15); // Clear E bit, do not allow turning on MMU
                 *ptr++ = strh_offset(ctx, tmp, __builtin_offsetof(struct M68KState, TCR));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             case 0x004: // ITT0
                 tmp = RA_AllocARMRegister(&ptr);
@@ -1993,6 +2319,7 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 *ptr++ = and_reg(tmp, tmp, reg, LSL, 0);
                 *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, ITT0));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             case 0x005: // ITT1
                 tmp = RA_AllocARMRegister(&ptr);
@@ -2000,6 +2327,7 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 *ptr++ = and_reg(tmp, tmp, reg, LSL, 0);
                 *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, ITT1));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             case 0x006: // DTT0
                 tmp = RA_AllocARMRegister(&ptr);
@@ -2007,6 +2335,7 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 *ptr++ = and_reg(tmp, tmp, reg, LSL, 0);
                 *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, DTT0));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             case 0x007: // DTT1
                 tmp = RA_AllocARMRegister(&ptr);
@@ -2014,6 +2343,7 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 *ptr++ = and_reg(tmp, tmp, reg, LSL, 0);
                 *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, DTT1));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             case 0x805: // MMUSR
                 *ptr++ = str_offset(ctx, reg, __builtin_offsetof(struct M68KState, MMUSR));
@@ -2023,12 +2353,14 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 *ptr++ = bic_immed(tmp, reg, 9, 0);
                 *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, URP));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             case 0x807: // SRP
                 tmp = RA_AllocARMRegister(&ptr);
                 *ptr++ = bic_immed(tmp, reg, 9, 0);
                 *ptr++ = str_offset(ctx, tmp, __builtin_offsetof(struct M68KState, SRP));
                 RA_FreeARMRegister(&ptr, tmp);
+                ptr = EMIT_MMUUpdate(ptr);
                 break;
             default:
                 ptr = EMIT_Exception(ptr, VECTOR_ILLEGAL_INSTRUCTION, 0);
@@ -2088,19 +2420,49 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 break;
             case 0x0e3: /* INSNCNTLO - lower 32 bits of m68k instruction counter */
                 tmp = RA_AllocARMRegister(&ptr);
-                *ptr++ = mov_simd_to_reg(tmp, 30, TS_D, 0);
-                *ptr++ = add64_immed(tmp, tmp, insn_count & 0xfff);
-                if (insn_count & 0xfff000)
-                    *ptr++ = add64_immed_lsl12(tmp, tmp, insn_count >> 12);
+#if EMU68_INSN_COUNTER_SAMPLED
+                if (!insn_count_precise)
+                {
+                    /* Estimate kept by the profiler */
+                    u.u64 = (uintptr_t)&insn_count_sampled;
+                    *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                    *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                    *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                    *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                    *ptr++ = ldr64_offset(tmp, tmp, 0);
+                }
+                else
+#endif
+                {
+                    *ptr++ = mov_simd_to_reg(tmp, 30, TS_D, 0);
+                    *ptr++ = add64_immed(tmp, tmp, insn_count & 0xfff);
+                    if (insn_count & 0xfff000)
+                        *ptr++ = add64_immed_lsl12(tmp, tmp, insn_count >> 12);
+                }
                 *ptr++ = mov_reg(reg, tmp);
                 RA_FreeARMRegister(&ptr, tmp);
                 break;
             case 0x0e4: /* INSNCNTHI - higher 32 bits of m68k instruction counter */
                 tmp = RA_AllocARMRegister(&ptr);
-                *ptr++ = mov_simd_to_reg(tmp, 30, TS_D, 0);
-                *ptr++ = add64_immed(tmp, tmp, insn_count & 0xfff);
-                if (insn_count & 0xfff000)
-                    *ptr++ = add64_immed_lsl12(tmp, tmp, insn_count >> 12);
+#if EMU68_INSN_COUNTER_SAMPLED
+                if (!insn_count_precise)
+                {
+                    /* Estimate kept by the profiler */
+                    u.u64 = (uintptr_t)&insn_count_sampled;
+                    *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                    *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                    *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                    *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                    *ptr++ = ldr64_offset(tmp, tmp, 0);
+                }
+                else
+#endif
+                {
+                    *ptr++ = mov_simd_to_reg(tmp, 30, TS_D, 0);
+                    *ptr++ = add64_immed(tmp, tmp, insn_count & 0xfff);
+                    if (insn_count & 0xfff000)
+                        *ptr++ = add64_immed_lsl12(tmp, tmp, insn_count >> 12);
+                }
                 *ptr++ = lsr64(reg, tmp, 32);
                 RA_FreeARMRegister(&ptr, tmp);
                 break;
@@ -2175,6 +2537,16 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 }
                 *ptr++ = cbz(tmp2, 2);
                 *ptr++ = orr_immed(reg, reg, 1, 30);
+#if EMU68_JIT_STATS
+                u.u64 = (uintptr_t)&opmix;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, tmp2, 0);
+                *ptr++ = cbz(tmp2, 2);
+                *ptr++ = orr_immed(reg, reg, 1, 29);
+#endif
 
                 RA_FreeARMRegister(&ptr, tmp);
                 RA_FreeARMRegister(&ptr, tmp2);
@@ -2203,6 +2575,144 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
             case 0x1e0: /* JITCTRL2 - JIT second control register */
                 *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL2));
                 break;
+            case 0x1e1: /* JITJCHIT - Number of jump cache hits */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_JCACHE_HIT));
+                break;
+            case 0x1e2: /* JITJCMISS - Number of jump cache misses */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_JCACHE_MISS));
+                break;
+            case 0x1e3: /* JITPINNED - size of pinned part of JIT cache, in bytes */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CACHE_PINNED));
+                break;
+            case 0x1f2: /* JITVHIT - Number of JIT cache misses served from the victim cache */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_VICTIM_HIT));
+                break;
+#if EMU68_JIT_EXPORT
+            case 0x1f1: /* JITEXPORT - Number of units in the last snapshot */
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&jit_export_count;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, reg, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                break;
+#endif
+#if EMU68_LAZY_RETUNE && EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+            case 0x1ed: /* JITOVRSEL - Selected entry of JIT override table */
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&jit_override_select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, reg, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                break;
+            case 0x1ee: /* JITOVRLO - Lowest address of selected override */
+            case 0x1ef: /* JITOVRHI - Highest address of selected override */
+            case 0x1f0: /* JITOVRCTRL - JITCTRL of selected override */
+            {
+                uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+                tmp = RA_AllocARMRegister(&ptr);
+                ptr = EMIT_OverrideEntry(ptr, tmp, tmp2);
+                *ptr++ = ldr_offset(tmp, reg, 4 * ((opcode2 & 0xfff) - 0x1ee));
+                RA_FreeARMRegister(&ptr, tmp);
+                RA_FreeARMRegister(&ptr, tmp2);
+                break;
+            }
+#endif
+#if EMU68_JIT_STATS
+            case 0x1eb: /* JITSTATSEL - Selected word of JIT statistics */
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&jit_stats_select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, reg, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                break;
+            case 0x1ec: /* JITSTAT - Selected word of JIT statistics, 0 past the end */
+            {
+                uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+                uint32_t *skip;
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&jit_stats_select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, tmp2, 0);
+                /* The opcode mix makes the structure too large for an immediate compare */
+                *ptr++ = movw_immed_u16(reg, sizeof(struct JITStats) / 4);
+                *ptr++ = cmp_reg(tmp2, reg, LSL, 0);
+                *ptr++ = mov_reg(reg, 31);
+                skip = ptr;
+                *ptr++ = b_cc(A64_CC_CS, 0);
+                u.u64 = (uintptr_t)&jit_stats;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_regoffset(tmp, reg, tmp2, UXTW, 1);
+                *skip = b_cc(A64_CC_CS, ptr - skip);
+                RA_FreeARMRegister(&ptr, tmp);
+                RA_FreeARMRegister(&ptr, tmp2);
+                break;
+            }
+#endif
+#if EMU68_PMU_PROFILE
+            case 0x1e4: /* PMUSEL - Selected entry of PMU top list */
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&pmu_state.pp_Select;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, reg, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                break;
+            case 0x1e5: /* PMUADDR - m68k address of selected unit, 0 if none */
+            case 0x1e6: /* PMUCYC - Cycles spent in selected unit, low 32 bits */
+            case 0x1e7: /* PMUL1I - L1 instruction cache refills */
+            case 0x1e8: /* PMUL1D - L1 data cache refills */
+            case 0x1e9: /* PMUBRMISS - Mispredicted branches */
+            case 0x1ea: /* PMUDTLB - Data TLB refills */
+            {
+                uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+                uint32_t *skip;
+                tmp = RA_AllocARMRegister(&ptr);
+                u.u64 = (uintptr_t)&pmu_state;
+                *ptr++ = mov64_immed_u16(tmp, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(tmp, u.u16[0], 3);
+                *ptr++ = ldr_offset(tmp, tmp2, __builtin_offsetof(struct PMUProfile, pp_Select));
+                *ptr++ = and_immed(tmp2, tmp2, EMU68_PMU_TOP_BITS, 0);
+                *ptr++ = add64_reg(tmp, tmp, tmp2, LSL, 3);
+                *ptr++ = ldr64_offset(tmp, tmp, __builtin_offsetof(struct PMUProfile, pp_Top));
+                *ptr++ = mov_reg(reg, 31);
+                skip = ptr;
+                *ptr++ = cbz_64(tmp, 0);
+                if ((opcode2 & 0xfff) == 0x1e5)
+                    *ptr++ = ldr_offset(tmp, reg, __builtin_offsetof(struct PMUSlot, pu_Address));
+                else
+                {
+                    /* Low half of the 64-bit counter */
+                    int off = __builtin_offsetof(struct PMUSlot, pu_Count) + 8 * ((opcode2 & 0xfff) - 0x1e6);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                    off += 4;
+#endif
+                    *ptr++ = ldr_offset(tmp, reg, off);
+                }
+                *skip = cbz_64(tmp, ptr - skip);
+                RA_FreeARMRegister(&ptr, tmp);
+                RA_FreeARMRegister(&ptr, tmp2);
+                break;
+            }
+#endif
             case 0x003: // TCR - write bits 15, 14, read all zeros for now
                 *ptr++ = ldrh_offset(ctx, reg, __builtin_offsetof(struct M68KState, TCR));
                 break;
@@ -2239,7 +2749,7 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
         *ptr++ = add_immed(REG_PC, REG_PC, 4);
     }
 
-    *tmpptr = b(ptr - tmpptr);
+    EMIT_Rejoin(tmpptr, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
@@ -2258,12 +2768,7 @@ static uint32_t *EMIT_MOVEUSP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
     ptr = EMIT_FlushPC(ptr);
 
     /* If supervisor is not active, put an exception here */
-    tmp = ptr;
-    ptr++;
-    ptr = EMIT_Exception(ptr, VECTOR_PRIVILEGE_VIOLATION, 0);
-    *tmp = tbnz(cc, SRB_S, 1 + ptr - tmp);
-    tmp = ptr;
-    ptr++;
+    ptr = EMIT_PrivilegeCheck(ptr, cc, &tmp);
 
     if (opcode & 8)
     {
@@ -2277,7 +2782,7 @@ static uint32_t *EMIT_MOVEUSP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
 
     *ptr++ = add_immed(REG_PC, REG_PC, 2);
 
-    *tmp = b(ptr - tmp);
+    EMIT_Rejoin(tmp, ptr);
 
     *ptr++ = INSN_TO_LE(0xffffffff);
 
@@ -2291,6 +2796,27 @@ static uint32_t *EMIT_JSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     uint8_t ea = 0xff;
     uint8_t sp = 0xff;
 
+    uint16_t *target = GetStaticJumpTarget(opcode, *m68k_ptr);
+    int leaf = 0;
+
+#if EMU68_LEAF_INLINE
+    int32_t var_EMU68_BRANCH_INLINE_DISTANCE = (jit_control >> JCCB_INLINE_RANGE) & JCCB_INLINE_RANGE_MASK;
+    intptr_t distance = (intptr_t)target - (intptr_t)*m68k_ptr;
+
+    /* Subroutines in ROM are inlined from anywhere, those in fast RAM when close to the caller */
+    if (target != (uint16_t *)0xffffffff && var_EMU68_BRANCH_INLINE_DISTANCE != 0)
+    {
+        if (M68K_IsROMCode(target))
+            leaf = 2;
+        else if ((uintptr_t)*m68k_ptr >= 0x01000000 && (uintptr_t)target >= 0x01000000 &&
+                 distance >= -var_EMU68_BRANCH_INLINE_DISTANCE && distance <= var_EMU68_BRANCH_INLINE_DISTANCE)
+            leaf = 1;
+
+        if (leaf && !M68K_IsLeafRoutine(target, EMU68_LEAF_INLINE_INSNS))
+            leaf = 0;
+    }
+#endif
+
     sp = RA_MapM68kRegister(&ptr, 15);
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &ea, opcode & 0x3f, (*m68k_ptr), &ext_words, 1, NULL);
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
@@ -2301,6 +2827,26 @@ static uint32_t *EMIT_JSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     *ptr++ = mov_reg(REG_PC, ea);
     (*m68k_ptr) += ext_words;
     RA_FreeARMRegister(&ptr, ea);
+
+    /* PC is at the callee already, RTS of the inlined subroutine checks the return address */
+    if (leaf)
+    {
+        M68K_PushReturnAddress(*m68k_ptr);
+        if (leaf == 2)
+            M68K_EnterROMLeaf();
+        *m68k_ptr = target;
+
+        return ptr;
+    }
+
+#if EMU68_SHADOW_STACK
+    ptr = EMIT_PushReturnPrediction(ptr, *m68k_ptr);
+#endif
+    /* Chain absolute and PC-relative targets directly, cache the other ones at the exit */
+    if (target != (uint16_t *)0xffffffff)
+        m68k_exit_target = target;
+    else
+        m68k_exit_indirect = TRUE;
     *ptr++ = INSN_TO_LE(0xffffffff);
 
     return ptr;
@@ -2311,11 +2857,17 @@ static uint32_t *EMIT_JMP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     (void)insn_consumed;
     uint8_t ext_words = 0;
     uint8_t ea = REG_PC;
+    uint16_t *target = GetStaticJumpTarget(opcode, *m68k_ptr);
 
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &ea, opcode & 0x3f, (*m68k_ptr), &ext_words, 0, NULL);
     ptr = EMIT_ResetOffsetPC(ptr);
     (*m68k_ptr) += ext_words;
     RA_FreeARMRegister(&ptr, ea);
+    /* Chain absolute and PC-relative targets directly, cache the other ones at the exit */
+    if (target != (uint16_t *)0xffffffff)
+        m68k_exit_target = target;
+    else
+        m68k_exit_indirect = TRUE;
     *ptr++ = INSN_TO_LE(0xffffffff);
 
     return ptr;
@@ -2491,7 +3043,7 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     (void)insn_consumed;
     uint8_t dir = (opcode >> 10) & 1;
     uint8_t size = (opcode >> 6) & 1;
-    uint16_t mask = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t mask = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t block_size = 0;
     uint8_t ext_words = 0;
     extern int debug;
@@ -2605,6 +3157,12 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     {
         uint8_t base = 0xff;
         uint8_t offset = 0;
+        uint8_t postinc = (opcode & 0x38) == 0x18;
+        /*
+            In post-increment mode the first transfer, if it starts at offset 0, writes the
+            incremented base back. Remaining ones use negative offsets from the new base
+        */
+        int wb_done = 0;
 
         ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &base, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
 
@@ -2615,14 +3173,21 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
             if (mask & (1 << i))
             {
                 /* Keep base register high in LRU */
-                if (((opcode & 0x38) == 0x18)) RA_MapM68kRegister(&ptr, (opcode & 7) + 8);
+                if (postinc) RA_MapM68kRegister(&ptr, (opcode & 7) + 8);
 
                 uint8_t reg = RA_MapM68kRegisterForWrite(&ptr, i);
                 if (size) {
-                    if ((((opcode & 0x38) == 0x18) && (i == (opcode & 7) + 8))) {
+                    if (postinc && (i == (opcode & 7) + 8)) {
                         /* If rt1 was set, flush it now and reset, skip the base register */
                         if (rt1 != 0xff) {
-                            *ptr++ = ldr_offset(base, rt1, offset);
+                            if (!wb_done && offset == 0) {
+                                *ptr++ = ldr_offset_postindex(base, rt1, block_size);
+                                wb_done = 1;
+                            }
+                            else if (wb_done)
+                                *ptr++ = ldur_offset(base, rt1, (offset - block_size) & 0x1ff);
+                            else
+                                *ptr++ = ldr_offset(base, rt1, offset);
                             rt1 = 0xff;
                             offset += 4;
                         }
@@ -2633,8 +3198,12 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                     if (rt1 == 0xff)
                         rt1 = reg;
                     else {
-                        if (block_size == 8 && (opcode & 0x38) == 0x18)
-                            *ptr++ = ldp_postindex(base, rt1, reg, 8);
+                        if (postinc && !wb_done && offset == 0) {
+                            *ptr++ = ldp_postindex(base, rt1, reg, block_size);
+                            wb_done = 1;
+                        }
+                        else if (wb_done)
+                            *ptr++ = ldp(base, rt1, reg, offset - block_size);
                         else 
                             *ptr++ = ldp(base, rt1, reg, offset);
                         offset += 8;
@@ -2643,20 +3212,37 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
                 }
                 else
                 {
-                    if (!(((opcode & 0x38) == 0x18) && (i == (opcode & 7) + 8)))
-                        *ptr++ = ldrsh_offset(base, reg, offset);
+                    if (!(postinc && (i == (opcode & 7) + 8)))
+                    {
+                        if (postinc && !wb_done && offset == 0) {
+                            *ptr++ = ldrsh_offset_postindex(base, reg, block_size);
+                            wb_done = 1;
+                        }
+                        else if (wb_done)
+                            *ptr++ = ldursh_offset(base, reg, (offset - block_size) & 0x1ff);
+                        else
+                            *ptr++ = ldrsh_offset(base, reg, offset);
+                    }
                     offset += 2;
                 }
             }
         }
         if (rt1 != 0xff) {
-            *ptr++ = ldr_offset(base, rt1, offset);
+            if (postinc && !wb_done && offset == 0) {
+                *ptr++ = ldr_offset_postindex(base, rt1, block_size);
+                wb_done = 1;
+            }
+            else if (wb_done)
+                *ptr++ = ldur_offset(base, rt1, (offset - block_size) & 0x1ff);
+            else
+                *ptr++ = ldr_offset(base, rt1, offset);
         }
 
-        /* Post-increment mode? Increase the base now */
-        if ((opcode & 0x38) == 0x18 && !(block_size == 8 && size))
+        /* Post-increment mode? Increase the base now unless it was already written back */
+        if (postinc)
         {
-            *ptr++ = add_immed(base, base, block_size);
+            if (!wb_done)
+                *ptr++ = add_immed(base, base, block_size);
             RA_SetDirtyM68kRegister(&ptr, (opcode & 7) + 8);
         }
 
@@ -2726,45 +3312,39 @@ static uint32_t *EMIT_CHK(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     // Clear Z, V and C flags, set Z back if operand is zero
     *ptr++ = mov_immed_u16(tmpreg, SR_NCalt, 0);
     *ptr++ = bic_reg(cc, cc, tmpreg, LSL, 0);
-    *ptr++ = tbz(src, 31, 2);
-    *ptr++ = orr_immed(cc, cc, 1, 32 - SRB_N);
+    ptr = EMIT_FlagFromBit(ptr, cc, src, 31, SRB_N);
 
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
 
     ptr = EMIT_FlushPC(ptr);
 
-    /* Check if Dn < 0 */
+    /* Word operation compares the upper halves */
     if (opcode & 0x80)
-        *ptr++ = adds_reg(31, 31, dn, LSL, 16); 
-    else
-        *ptr++ = adds_reg(31, 31, dn, LSL, 0); 
+    {
+        *ptr++ = lsl(tmpreg, dn, 16);
+        dn = tmpreg;
+    }
 
-    /* Jump to exception generator if negative */
-    *ptr++ = b_cc(A64_CC_MI, 5);
-    
-    /* Check if Dn > src */
-    if (opcode & 0x80)
-        *ptr++ = subs_reg(31, src, dn, LSL, 16);
-    else
-        *ptr++ = subs_reg(31, src, dn, LSL, 0);
-    
-    uint32_t *tmp = ptr;
-    *ptr++ = b_cc(A64_CC_GE, 0);
-    *ptr++ = bic_immed(cc, cc, 1, 31 & (32 - SRB_N));
-    *ptr++ = b(2);
+    /* Skip the exception if 0 <= Dn <= src. Negative Dn forces GT through the alternate flags */
+    *ptr++ = cmp_immed(dn, 0);
+    *ptr++ = ccmp_reg(dn, src, 0, A64_CC_GE);
 
-    *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_N));
+    uint32_t *tmp = ptr;
+    *ptr++ = b_cc(A64_CC_LE, 0);
 
+    /* N is set if Dn < 0, cleared if Dn > src */
+    *ptr++ = bic_immed(cc, cc, 1, 31 & (32 - SRB_N));
+    ptr = EMIT_FlagFromBit(ptr, cc, dn, 31, SRB_N);
     ptr = EMIT_Exception(ptr, VECTOR_CHK, 2, opcode_address);
 
     RA_FreeARMRegister(&ptr, src);
     RA_FreeARMRegister(&ptr, tmpreg);
 
-    *tmp = b_cc(A64_CC_GE, ptr - tmp);
+    *tmp = b_cc(A64_CC_LE, ptr - tmp);
     *ptr++ = (uint32_t)(uintptr_t)tmp;
     *ptr++ = 1;
-    *ptr++ = 0;
+    *ptr++ = EXIT_COLD;
     *ptr++ = INSN_TO_LE(0xfffffffe);
 
     return ptr;
@@ -2981,7 +3561,7 @@ static struct OpcodeDef InsnTable[4096] = {
 
 uint32_t *EMIT_line4(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
@@ -3020,7 +3600,7 @@ uint32_t GetSR_Line4(uint16_t opcode)
 
 int M68K_GetLine4Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*insn_stream));
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*insn_stream));
     
     int length = 0;
     int need_ea = 0;
@@ -3044,10 +3624,14 @@ int M68K_GetLine4Length(uint16_t *insn_stream)
 void do_reset()
 {
     void ps_pulse_reset();
+    extern volatile int ps_reset_self;
 
     struct Size sz = get_display_size();
     init_display(sz, NULL, NULL);
 
+    /* RESET instruction resets peripherals only, housekeeper must not take it for a reset request */
+    ps_reset_self = 1;
     ps_pulse_reset();
+    ps_reset_self = 0;
 }
 #endif
@@ -12,6 +12,11 @@
 #include "RegisterAllocator.h"
 #include "cache.h"
 
+extern uint16_t * m68k_entry_point;
+#if EMU68_DBCC_INT_INTERVAL > 1
+extern uint8_t m68k_loop_counter;
+#endif
+
 uint32_t *EMIT_ADDQ(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
@@ -651,7 +656,7 @@ uint32_t *EMIT_TRAPcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         *tmpptr = b_cc(arm_condition ^ 1, ptr - tmpptr);
         *ptr++ = (uint32_t)(uintptr_t)tmpptr;
         *ptr++ = 1;
-        *ptr++ = 0;
+        *ptr++ = EXIT_COLD;
         *ptr++ = INSN_TO_LE(0xfffffffe);
     }
     
@@ -660,13 +665,13 @@ uint32_t *EMIT_TRAPcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 
 uint32_t *EMIT_DBcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
-    extern struct M68KState *__m68k_state;
+    extern uint32_t jit_control2;
     uint8_t counter_reg = RA_MapM68kRegister(&ptr, opcode & 7);
     uint8_t m68k_condition = (opcode >> 8) & 0x0f;
     uint8_t arm_condition = 0;
     uint32_t *branch_1 = NULL;
     uint32_t *branch_2 = NULL;
-    int32_t branch_offset = 2 + (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
+    int32_t branch_offset = 2 + (int16_t)cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
     uint16_t *bra_rel_ptr = *m68k_ptr - 2;
 
     /* Selcom case of DBT which does nothing */
@@ -678,100 +683,109 @@ uint32_t *EMIT_DBcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     }
     else
     {
-        uint8_t c_true = RA_AllocARMRegister(&ptr);
-        uint8_t c_false = RA_AllocARMRegister(&ptr);
         int8_t off8 = 0;
         int32_t off = 4;
 
         // Suggested by Paraj - a way to allow old code using DBF as busy loop work:
         // For busy loops (of the form l dbf dN,l) in chip mem add extra delay that is
         // at least 10 7MHz clocks (For old school replayer routines)
-        if (__m68k_state->JIT_CONTROL2 & JC2F_DBF_SLOWDOWN)
+        if (jit_control2 & JC2F_DBF_SLOWDOWN)
         {
             if (m68k_condition == M_CC_F && branch_offset == 0 && (uintptr_t)*m68k_ptr < 0x200000)
             {
-                *ptr++ = mov_immed_u16(c_true, 0, 0);
-                *ptr++ = ldrb_offset(c_true, c_false, 0);
-                *ptr++ = ldrb_offset(c_true, c_false, 0);
-                *ptr++ = ldrb_offset(c_true, c_false, 0);
+                uint8_t base = RA_AllocARMRegister(&ptr);
+                uint8_t tmp = RA_AllocARMRegister(&ptr);
+                *ptr++ = mov_immed_u16(base, 0, 0);
+                *ptr++ = ldrb_offset(base, tmp, 0);
+                *ptr++ = ldrb_offset(base, tmp, 0);
+                *ptr++ = ldrb_offset(base, tmp, 0);
+                RA_FreeARMRegister(&ptr, tmp);
+                RA_FreeARMRegister(&ptr, base);
             }
         }
 
-        ptr = EMIT_GetOffsetPC(ptr, &off8);
-        off += off8;
-        ptr = EMIT_ResetOffsetPC(ptr);
-
-        *ptr++ = add_immed(c_true, REG_PC, off);
-
-        off = branch_offset + off8;
-
-        if (off > -4096 && off < 0)
+#if EMU68_LOOP_PACING
+        if (branch_offset <= 0)
         {
-            *ptr++ = sub_immed(c_false, REG_PC, -off);
-        }
-        else if (off > 0 && off < 4096)
-        {
-            *ptr++ = add_immed(c_false, REG_PC, off);
-        }
-        else if (off != 0)
-        {
-            uint8_t reg = RA_AllocARMRegister(&ptr);
-            *ptr++ = movw_immed_u16(reg, off & 0xffff);
-            *ptr++ = movt_immed_u16(reg, (off >> 16) & 0xffff);
-            *ptr++ = add_reg(c_false, REG_PC, reg, LSL, 0);
-            RA_FreeARMRegister(&ptr, reg);
-        } else /* branch_offset == 0 */
-        {
-            *ptr++ = mov_reg(c_false, REG_PC);
+            uint32_t cycles = M68K_DelayLoopCycles((uint16_t *)((uintptr_t)bra_rel_ptr + branch_offset), bra_rel_ptr);
+
+            if (cycles)
+                ptr = EMIT_LoopPacing(ptr, cycles);
         }
+#endif
+
+        ptr = EMIT_GetOffsetPC(ptr, &off8);
+        ptr = EMIT_ResetOffsetPC(ptr);
 
         /* If condition was not false check the condition and eventually break the loop */
         if (m68k_condition != M_CC_F)
         {
             arm_condition = EMIT_TestCondition(&ptr, m68k_condition);
 
-            /* Adjust PC, negated CC is loop condition, CC is loop break condition */
-            *ptr++ = csel(REG_PC, c_true, c_false, arm_condition);
-
             /* conditionally exit loop */
             branch_1 = ptr;
             *ptr++ = b_cc(arm_condition, 0);
         }
 
-        /* Copy register to temporary, shift 16 bits left */
+        /* Decrement lower half of the counter */
         uint8_t reg = RA_AllocARMRegister(&ptr);
 
         *ptr++ = uxth(reg, counter_reg);
-
-        /* Substract 0x10000 from temporary, compare with 0xffff0000 */
         *ptr++ = subs_immed(reg, reg, 1);
         *ptr++ = bfi(counter_reg, reg, 0, 16);
 
         RA_SetDirtyM68kRegister(&ptr, opcode & 7);
+        RA_FreeARMRegister(&ptr, reg);
 
-        /* If counter was 0xffff (temprary reg 0xffff0000) break the loop */
-        *ptr++ = csel(REG_PC, c_true, c_false, A64_CC_MI);
+        /* Counter not expired, continue the loop */
         branch_2 = ptr;
-        *ptr++ = b_cc(A64_CC_PL, 3);
-        
+        *ptr++ = b_cc(A64_CC_PL, 0);
+
         if (branch_1) {
             *branch_1 = b_cc(arm_condition, ptr - branch_1);
         }
 
-        RA_FreeARMRegister(&ptr, reg);
+        /* Loop exit, PC of the next instruction is the only one known here */
+        off += off8;
+        if (off > 0)
+            *ptr++ = add_immed(REG_PC, REG_PC, off);
+        else if (off < 0)
+            *ptr++ = sub_immed(REG_PC, REG_PC, -off);
+
+        ptr = EMIT_ChainedExit(ptr, 1, *m68k_ptr);
 
         *branch_2 = b_cc(A64_CC_PL, ptr - branch_2);
-        
+
+        /* Loop continues, only now the branch target is put into PC */
+        off = branch_offset + off8;
+
+        if (off > -4096 && off < 0)
+        {
+            *ptr++ = sub_immed(REG_PC, REG_PC, -off);
+        }
+        else if (off > 0 && off < 4096)
+        {
+            *ptr++ = add_immed(REG_PC, REG_PC, off);
+        }
+        else if (off != 0)
+        {
+            uint8_t tmp = RA_AllocARMRegister(&ptr);
+            *ptr++ = movw_immed_u16(tmp, off & 0xffff);
+            *ptr++ = movt_immed_u16(tmp, (off >> 16) & 0xffff);
+            *ptr++ = add_reg(REG_PC, REG_PC, tmp, LSL, 0);
+            RA_FreeARMRegister(&ptr, tmp);
+        }
+
         *m68k_ptr = (void *)((uintptr_t)bra_rel_ptr + branch_offset);
 
-        *ptr++ = (uint32_t)(uintptr_t)branch_2;
-        *ptr++ = 1;
-        *ptr++ = 0;
-        *ptr++ = INSN_TO_LE(0xfffffffe);
+#if EMU68_DBCC_INT_INTERVAL > 1
+        /* Tell the translator which counter closes the loop if it returns to the unit entry */
+        if (*m68k_ptr == m68k_entry_point)
+            m68k_loop_counter = opcode & 7;
+#endif
+
         *ptr++ = INSN_TO_LE(0xfffffff1);
 
-        RA_FreeARMRegister(&ptr, c_true);
-        RA_FreeARMRegister(&ptr, c_false);
         RA_FreeARMRegister(&ptr, counter_reg);
     }
 
@@ -822,10 +836,54 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t *EMIT_line5(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
+#if EMU68_IF_CONVERSION
+    /*
+        Scc Dn followed by NEG.B Dn leaves 1 or 0 in the lowest byte. If the flags of NEG.B are
+        not used later, the pair is a single cset
+    */
+    if ((opcode & 0xf0f8) == 0x50c0 &&
+#if EMU68_TRACE_CACHE
+        !m68k_single_step &&
+#endif
+        cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]) == (0x4400 | (opcode & 7)) &&
+        M68K_GetSRMask(*m68k_ptr) == 0)
+    {
+        uint8_t m68k_condition = (opcode >> 8) & 15;
+        uint8_t dest = RA_MapM68kRegister(&ptr, opcode & 7);
+        RA_SetDirtyM68kRegister(&ptr, opcode & 7);
+
+        if (m68k_condition == M_CC_T)
+        {
+            *ptr++ = bic_immed(dest, dest, 8, 0);
+            *ptr++ = orr_immed(dest, dest, 1, 0);
+        }
+        else if (m68k_condition == M_CC_F)
+        {
+            *ptr++ = bic_immed(dest, dest, 8, 0);
+        }
+        else
+        {
+            uint8_t arm_condition = EMIT_TestCondition(&ptr, m68k_condition);
+            uint8_t tmp = RA_AllocARMRegister(&ptr);
+
+            *ptr++ = cset(tmp, arm_condition);
+            *ptr++ = bfi(dest, tmp, 0, 8);
+
+            RA_FreeARMRegister(&ptr, tmp);
+        }
+
+        (*m68k_ptr)++;
+        ptr = EMIT_AdvancePC(ptr, 4);
+        *insn_consumed = 2;
+
+        return ptr;
+    }
+#endif
+
     if (InsnTable[opcode & 0777].od_Emit) {
         ptr = InsnTable[opcode & 0777].od_Emit(ptr, opcode, m68k_ptr);
     }
@@ -861,7 +919,7 @@ uint32_t GetSR_Line5(uint16_t opcode)
 
 int M68K_GetLine5Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*insn_stream));
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*insn_stream));
     
     int length = 0;
     int need_ea = 0;
@@ -15,6 +15,8 @@
 
 extern struct M68KState *__m68k_state;
 extern uint16_t * m68k_entry_point;
+extern uint16_t * m68k_exit_target;
+extern uint32_t jit_control;
 
 uint32_t *EMIT_BRA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
@@ -34,14 +36,14 @@ uint32_t *EMIT_BRA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     if ((opcode & 0x00ff) == 0x00)
     {
         addend = 2;
-        bra_off = (int16_t)(cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]));
+        bra_off = (int16_t)(cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]));
         (*m68k_ptr)++;
     }
     /* use 32-bit offset */
     else if ((opcode & 0x00ff) == 0xff)
     {
         addend = 4;
-        bra_off = (int32_t)(cache_read_32(ICACHE, (uintptr_t)&(*m68k_ptr)[0]));
+        bra_off = (int32_t)(cache_fetch_32((uintptr_t)&(*m68k_ptr)[0]));
         (*m68k_ptr) += 2;
     }
     else
@@ -97,28 +99,438 @@ uint32_t *EMIT_BRA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     }
     RA_FreeARMRegister(&ptr, reg);
 
-    int32_t var_EMU68_BRANCH_INLINE_DISTANCE = (__m68k_state->JIT_CONTROL >> JCCB_INLINE_RANGE) & JCCB_INLINE_RANGE_MASK;
+    int32_t var_EMU68_BRANCH_INLINE_DISTANCE = (jit_control >> JCCB_INLINE_RANGE) & JCCB_INLINE_RANGE_MASK;
+
+    int inline_branch = (bra_off >= -var_EMU68_BRANCH_INLINE_DISTANCE && bra_off <= var_EMU68_BRANCH_INLINE_DISTANCE);
+    int rom_leaf = 0;
+
+#if EMU68_LEAF_INLINE
+    /* Subroutines of the ROM are inlined if they are short leaves */
+    if (inline_branch && bsr && (uintptr_t)*m68k_ptr < 0x01000000 && M68K_IsROMCode(*m68k_ptr))
+        rom_leaf = M68K_IsLeafRoutine((uint16_t *)((uintptr_t)bra_rel_ptr + bra_off), EMU68_LEAF_INLINE_INSNS);
+#endif
 
     /* If branch is done within +- 4KB, try to inline it instead of breaking up the translation unit */
-    if ((uintptr_t)*m68k_ptr >= 0x01000000 && (bra_off >= -var_EMU68_BRANCH_INLINE_DISTANCE && bra_off <= var_EMU68_BRANCH_INLINE_DISTANCE)) {
+    if (((uintptr_t)*m68k_ptr >= 0x01000000 || rom_leaf) && inline_branch) {
         if (bsr) {
             M68K_PushReturnAddress(*m68k_ptr);
         }
+        if (rom_leaf) {
+            M68K_EnterROMLeaf();
+        }
 
         *m68k_ptr = (void *)((uintptr_t)bra_rel_ptr + bra_off);
     }
     else
+    {
+#if EMU68_SHADOW_STACK
+        if (bsr) {
+            ptr = EMIT_PushReturnPrediction(ptr, *m68k_ptr);
+        }
+#endif
+        /* Target is known, the unit exit can be chained */
+        m68k_exit_target = (void *)((uintptr_t)bra_rel_ptr + bra_off);
         *ptr++ = INSN_TO_LE(0xffffffff);
+    }
 
     return ptr;
 }
 
 uint32_t *EMIT_BSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr) __attribute__((alias("EMIT_BRA")));
 
+uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr);
+
+#if EMU68_FUSED_BRANCH && !EMU68_DEF_BRANCH_BREAK
+/* Set by EMIT_FusedBcc for the duration of EMIT_Bcc */
+static uint8_t fused_kind = FUSED_NONE;
+static uint8_t fused_reg;
+
+static const uint8_t fused_cond[16] = {
+    [M_CC_HI] = A64_CC_HI, [M_CC_LS] = A64_CC_LS, [M_CC_CC] = A64_CC_CC, [M_CC_CS] = A64_CC_CS,
+    [M_CC_NE] = A64_CC_NE, [M_CC_EQ] = A64_CC_EQ, [M_CC_VC] = A64_CC_VC, [M_CC_VS] = A64_CC_VS,
+    [M_CC_PL] = A64_CC_PL, [M_CC_MI] = A64_CC_MI, [M_CC_GE] = A64_CC_GE, [M_CC_LT] = A64_CC_LT,
+    [M_CC_GT] = A64_CC_GT, [M_CC_LE] = A64_CC_LE
+};
+
+/* Emit single instruction jump on condition taken from the fused test or compare */
+static uint32_t *EMIT_FusedJump(uint32_t *ptr, uint8_t m68k_condition, uint32_t distance)
+{
+    switch (fused_kind)
+    {
+        case FUSED_ZERO:
+            if (m68k_condition == M_CC_EQ)
+                *ptr++ = cbz(fused_reg, distance);
+            else
+                *ptr++ = cbnz(fused_reg, distance);
+            break;
+
+        case FUSED_SUBS:
+            /* Host carry is set if there was no borrow */
+            if (m68k_condition == M_CC_CC || m68k_condition == M_CC_CS)
+            {
+                *ptr++ = b_cc(fused_cond[m68k_condition] ^ 1, distance);
+                break;
+            }
+            /* Fallthrough */
+
+        default:
+            *ptr++ = b_cc(fused_cond[m68k_condition], distance);
+            break;
+    }
+
+    return ptr;
+}
+#endif
+
+#if EMU68_IF_CONVERSION
+/*
+    If-conversion of short forward Bcc
+
+                bcc     skip
+                insn_1
+                ...                 up to EMU68_IF_CONVERSION_INSNS instructions
+                insn_n
+        skip:
+
+    The skipped instructions may work on registers only, they neither access memory nor trap or
+    branch. They are emitted unconditionally after the condition is kept in a temporary register
+    together with copies of the m68k registers and CCR they change. At the end the copies are
+    selected back with csel if the branch was taken and the translation continues at skip.
+*/
+
+/* Source operand without memory access: Dn, An (not for bytes) or immediate */
+static inline int IfConvSource(uint16_t opcode, int byte)
+{
+    uint8_t mode = (opcode >> 3) & 7;
+
+    return mode == 0 || (mode == 1 && !byte) || (opcode & 0x3f) == 0x3c;
+}
+
+/*
+    Check if instruction can be executed unconditionally. Returns 0 if not, otherwise 1 and
+    sets *writes to the mask of m68k registers changed by it
+*/
+static int IfConvDecode(uint16_t opcode, uint16_t *writes)
+{
+    uint8_t mode = (opcode >> 3) & 7;
+    uint8_t opmode = (opcode >> 6) & 7;
+    uint8_t size = (opcode >> 6) & 3;
+    uint8_t rx = (opcode >> 9) & 7;
+
+    *writes = 0;
+
+    switch (opcode >> 12)
+    {
+        case 1: case 2: case 3:     /* MOVE and MOVEA to register */
+            if (opmode > 1 || !IfConvSource(opcode, (opcode >> 12) == 1))
+                return 0;
+            if (opmode == 1 && (opcode >> 12) == 1)
+                return 0;
+            *writes = 1 << (rx + (opmode == 1 ? 8 : 0));
+            return 1;
+
+        case 4:
+            if (mode != 0)
+            {
+                /* LEA (An), d16(An) and d16(PC) */
+                if ((opcode & 0x01c0) == 0x01c0 && (mode == 2 || mode == 5 || (opcode & 0x3f) == 0x3a))
+                {
+                    *writes = 1 << (rx + 8);
+                    return 1;
+                }
+                return 0;
+            }
+            /* NEGX, CLR, NEG, NOT and TST of Dn */
+            if (((opcode & 0xf900) == 0x4000 || (opcode & 0xff00) == 0x4a00) && size != 3)
+            {
+                *writes = (opcode & 0xff00) == 0x4a00 ? 0 : 1 << (opcode & 7);
+                return 1;
+            }
+            /* SWAP, EXT and EXTB */
+            if ((opcode & 0xfff8) == 0x4840 || (opcode & 0xfff8) == 0x4880 ||
+                (opcode & 0xfff8) == 0x48c0 || (opcode & 0xfff8) == 0x49c0)
+            {
+                *writes = 1 << (opcode & 7);
+                return 1;
+            }
+            return 0;
+
+        case 5:
+            /* Scc Dn */
+            if (size == 3)
+            {
+                if (mode != 0)
+                    return 0;
+                *writes = 1 << (opcode & 7);
+                return 1;
+            }
+            /* ADDQ and SUBQ to register */
+            if (mode > 1 || (mode == 1 && size == 0))
+                return 0;
+            *writes = 1 << ((opcode & 7) + (mode == 1 ? 8 : 0));
+            return 1;
+
+        case 7:                     /* MOVEQ */
+            if (opcode & 0x100)
+                return 0;
+            *writes = 1 << rx;
+            return 1;
+
+        case 8: case 12:            /* OR, AND to Dn, MULU.W and MULS.W (line C only) */
+            if (!IfConvSource(opcode, 1))
+                return 0;
+            if (opmode < 3 || ((opcode >> 12) == 12 && (opmode & 3) == 3))
+            {
+                *writes = 1 << rx;
+                return 1;
+            }
+            return 0;
+
+        case 9: case 13:            /* SUB, ADD to Dn, SUBA and ADDA */
+            if (opmode > 2 && (opmode & 3) != 3)
+                return 0;
+            if (!IfConvSource(opcode, opmode == 0))
+                return 0;
+            *writes = 1 << (rx + ((opmode & 3) == 3 ? 8 : 0));
+            return 1;
+
+        case 11:
+            /* CMP and CMPA */
+            if (opmode < 3 || (opmode & 3) == 3)
+                return IfConvSource(opcode, opmode == 0);
+            /* EOR Dn,Dm */
+            if (mode != 0)
+                return 0;
+            *writes = 1 << (opcode & 7);
+            return 1;
+
+        case 14:                    /* Shifts and rotates of Dn */
+            if (size == 3)
+                return 0;
+            *writes = 1 << (opcode & 7);
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+    Check if the Bcc at bcc can be if-converted. Returns number of skipped instructions or 0,
+    the registers they change are returned in *writes
+*/
+static int IfConvCandidate(uint16_t *bcc, uint16_t *writes)
+{
+    struct M68KDecodedInsn *d = M68K_DecodeInsn(bcc);
+    uint16_t *p;
+    uint16_t opcode;
+    int count = 0;
+
+    *writes = 0;
+
+#if EMU68_TRACE_CACHE
+    if (m68k_single_step)
+        return 0;
+#endif
+
+    if (d == NULL || d->di_Flow != DI_FLOW_COND)
+        return 0;
+
+    p = bcc + d->di_Length;
+
+    if (d->di_Target <= p)
+        return 0;
+
+    while (p < d->di_Target)
+    {
+        struct M68KDecodedInsn *n = M68K_DecodeInsn(p);
+        uint16_t w;
+
+        if (n == NULL || n->di_Flow != DI_FLOW_NEXT || ++count > EMU68_IF_CONVERSION_INSNS)
+            return 0;
+        if (!IfConvDecode(n->di_Opcode, &w))
+            return 0;
+
+        *writes |= w;
+        p += n->di_Length;
+    }
+
+    if (p != d->di_Target)
+        return 0;
+
+    /*
+        The last skipped instruction must not be fused with the one at skip. Bcc is fused with
+        compares and tests, EXT and SWAP with moves and rotates, NEG.B with Scc
+    */
+    opcode = cache_fetch_16((uintptr_t)p);
+    if ((opcode & 0xf000) == 0x6000 || (opcode & 0xf000) == 0xe000 || (opcode & 0xfe00) == 0x4800 ||
+        (opcode & 0xfff8) == 0x4400)
+        return 0;
+
+    return count;
+}
+
+static uint32_t *EMIT_IfConverted(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed,
+        int count, uint16_t writes)
+{
+    uint16_t *bcc = *m68k_ptr;
+    struct M68KDecodedInsn *d = M68K_DecodeInsn(bcc);
+    uint16_t *target = d->di_Target;
+    uint8_t m68k_condition = (d->di_Opcode >> 8) & 15;
+    uint8_t saved[16];
+    uint8_t cc_saved = 0xff;
+    uint8_t update_mask = 0;
+    uint8_t skip = RA_AllocARMRegister(&ptr);
+    uint8_t cond;
+    uint16_t *p = bcc + d->di_Length;
+
+    for (int i=0; i < count; i++)
+    {
+        update_mask |= M68K_GetSRMask(p);
+        p += M68K_GetINSNLength(p);
+    }
+
+    cond = EMIT_TestCondition(&ptr, m68k_condition);
+    *ptr++ = cset(skip, cond);
+
+    for (int r=0; r < 16; r++)
+    {
+        if (writes & (1 << r))
+            saved[r] = RA_CopyFromM68kRegister(&ptr, r);
+    }
+
+    if (update_mask)
+    {
+        uint8_t cc = RA_GetCC(&ptr);
+        cc_saved = RA_AllocARMRegister(&ptr);
+        *ptr++ = mov_reg(cc_saved, cc);
+    }
+
+    ptr = EMIT_AdvancePC(ptr, 2 * d->di_Length);
+    (*m68k_ptr) += d->di_Length;
+
+    while (*m68k_ptr < target)
+    {
+        uint16_t consumed = 0;
+        ptr = M68K_EmitINSN(ptr, m68k_ptr, &consumed);
+    }
+
+    /* Branch taken, put back what the skipped instructions have changed */
+    *ptr++ = cmp_immed(skip, 0);
+
+    for (int r=0; r < 16; r++)
+    {
+        if (writes & (1 << r))
+        {
+            uint8_t reg = RA_MapM68kRegister(&ptr, r);
+            *ptr++ = csel(reg, saved[r], reg, A64_CC_NE);
+            RA_SetDirtyM68kRegister(&ptr, r);
+            RA_FreeARMRegister(&ptr, saved[r]);
+        }
+    }
+
+    if (cc_saved != 0xff)
+    {
+        uint8_t cc = RA_ModifyCC(&ptr);
+        *ptr++ = csel(cc, cc_saved, cc, A64_CC_NE);
+        RA_FreeARMRegister(&ptr, cc_saved);
+    }
+
+    RA_FreeARMRegister(&ptr, skip);
+
+    *insn_consumed = 1 + count;
+
+    return ptr;
+}
+#endif
+
+/*
+    Check if the Bcc at bcc can branch on the result of preceding instruction directly. The
+    condition has to be computable from the kind of result left and none of the flags set by
+    the instruction may be used after the branch. Callers which have updated CCR already and
+    left host flags intact pass sets of 0.
+*/
+int M68K_CanFuseBcc(uint16_t *bcc, uint8_t sets, uint8_t kind)
+{
+#if EMU68_FUSED_BRANCH && !EMU68_DEF_BRANCH_BREAK
+    uint16_t opcode = cache_fetch_16((uintptr_t)bcc);
+    uint8_t m68k_condition = (opcode >> 8) & 15;
+
+    /* Bcc only, BRA and BSR have no condition */
+    if ((opcode & 0xf000) != 0x6000 || m68k_condition < M_CC_HI)
+        return 0;
+
+#if EMU68_TRACE_CACHE
+    if (m68k_single_step)
+        return 0;
+#endif
+
+#if EMU68_IF_CONVERSION
+    /* Bcc translated without a branch tests CCR, it is not fused */
+    {
+        uint16_t writes;
+        if (IfConvCandidate(bcc, &writes))
+            return 0;
+    }
+#endif
+
+    switch (kind)
+    {
+        case FUSED_ADDS:
+            /* Host HI and LS test the carry set differently than m68k does */
+            if (m68k_condition == M_CC_HI || m68k_condition == M_CC_LS)
+                return 0;
+            break;
+        case FUSED_SUBS:
+            break;
+        case FUSED_ZERO:
+            if (m68k_condition != M_CC_EQ && m68k_condition != M_CC_NE)
+                return 0;
+            break;
+        default:
+            return 0;
+    }
+
+    return (M68K_GetSRLiveOut(bcc) & sets) == 0;
+#else
+    (void)bcc;
+    (void)sets;
+    (void)kind;
+
+    return 0;
+#endif
+}
+
+/*
+    Emit Bcc at *m68k_ptr as the second half of a fused pair. Must be called only if
+    M68K_CanFuseBcc agreed and with host flags or reg prepared accordingly.
+*/
+uint32_t *EMIT_FusedBcc(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed, uint8_t kind, uint8_t reg)
+{
+#if EMU68_FUSED_BRANCH && !EMU68_DEF_BRANCH_BREAK
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+    (*m68k_ptr)++;
+
+    fused_kind = kind;
+    fused_reg = reg;
+    ptr = EMIT_Bcc(ptr, opcode, m68k_ptr);
+    fused_kind = FUSED_NONE;
+
+    *insn_consumed = 2;
+#else
+    (void)m68k_ptr;
+    (void)insn_consumed;
+    (void)kind;
+    (void)reg;
+#endif
+
+    return ptr;
+}
+
 uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint32_t *tmpptr;
     uint32_t *distance_ptr;
+    uint16_t *bcc = *m68k_ptr - 1;
     uint8_t m68k_condition = (opcode >> 8) & 15;
     intptr_t branch_target = (intptr_t)(*m68k_ptr);
     intptr_t branch_offset = 0;
@@ -131,14 +543,14 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     /* use 16-bit offset */
     if ((opcode & 0x00ff) == 0x00)
     {
-        branch_offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
+        branch_offset = (int16_t)cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
     }
     /* use 32-bit offset */
     else if ((opcode & 0x00ff) == 0xff)
     {
         uint16_t lo16, hi16;
-        hi16 = cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
-        lo16 = cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
+        hi16 = cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
+        lo16 = cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
         branch_offset = lo16 | (hi16 << 16);
     }
     else
@@ -150,7 +562,18 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     branch_offset += local_pc_off;
     branch_target += branch_offset - local_pc_off;
 
+#if EMU68_LOOP_PACING
+    if (m68k_condition > M_CC_F && branch_target <= (intptr_t)bcc)
+    {
+        uint32_t cycles = M68K_DelayLoopCycles((uint16_t *)branch_target, bcc);
+
+        if (cycles)
+            ptr = EMIT_LoopPacing(ptr, cycles);
+    }
+#endif
+
 #if EMU68_DEF_BRANCH_BREAK
+    (void)bcc;
     (void)take_branch;
     (void)tmpptr;
     (void)distance_ptr;
@@ -233,18 +656,43 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 #endif
 #endif
 
+    /* Direction observed by tier 0 translation wins over the guess */
+    switch (M68K_GetBranchHint(bcc))
+    {
+        case BRANCH_HINT_TAKEN:
+            take_branch = 1;
+            break;
+        case BRANCH_HINT_NOT_TAKEN:
+            take_branch = 0;
+            break;
+        default:
+            break;
+    }
+
     if (!take_branch)
     {
         m68k_condition ^= 1;
     }
 
-    /* Force getting CC in place */
-    RA_GetCC(&ptr);
+#if EMU68_FUSED_BRANCH
+    if (fused_kind != FUSED_NONE)
+    {
+        /* Prepare fake jump on result of the fused instruction */
+        tmpptr = ptr;
+        ptr = EMIT_FusedJump(ptr, m68k_condition, 0);
+        distance_ptr = ptr;
+    }
+    else
+#endif
+    {
+        /* Force getting CC in place */
+        RA_GetCC(&ptr);
 
-    /* Prepare fake jump on condition, assume def branch is taken */
-    tmpptr = ptr;
-    ptr = EMIT_JumpOnCondition(ptr, m68k_condition, 0);
-    distance_ptr = ptr;
+        /* Prepare fake jump on condition, assume def branch is taken */
+        tmpptr = ptr;
+        ptr = EMIT_JumpOnCondition(ptr, m68k_condition, 0);
+        distance_ptr = ptr;
+    }
 
     /* Insert the first case here */
     if (take_branch)
@@ -293,9 +741,15 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     }
 
     /* Insert local exit */
-    ptr = EMIT_LocalExit(ptr, 1);
+    ptr = EMIT_BranchProfile(ptr, bcc, take_branch);
+    ptr = EMIT_ChainedExit(ptr, 1, take_branch ? *m68k_ptr : (uint16_t *)branch_target);
 
     /* Fixup jump on condition */
+#if EMU68_FUSED_BRANCH
+    if (fused_kind != FUSED_NONE)
+        EMIT_FusedJump(tmpptr, m68k_condition, 1 + ptr - distance_ptr);
+    else
+#endif
     EMIT_JumpOnCondition(tmpptr, m68k_condition, 1 + ptr - distance_ptr);
 
     /* Insert the second case here */
@@ -372,8 +826,19 @@ static struct OpcodeDef InsnTable[16] = {
 
 uint32_t *EMIT_line6(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     *insn_consumed = 1;
+
+#if EMU68_IF_CONVERSION
+    {
+        uint16_t writes;
+        int count = IfConvCandidate(*m68k_ptr, &writes);
+
+        if (count)
+            return EMIT_IfConverted(ptr, m68k_ptr, insn_consumed, count, writes);
+    }
+#endif
+
     (*m68k_ptr)++;
 
     ptr = InsnTable[(opcode >> 8) & 15].od_Emit(ptr, opcode, m68k_ptr);
@@ -388,7 +853,7 @@ uint32_t GetSR_Line6(uint16_t opcode)
 
 int M68K_GetLine6Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn_stream);
     int length = 1;
     
     if ((opcode & 0xff) == 0) {
@@ -28,7 +28,7 @@ uint32_t *EMIT_DIVS_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr) __a
 uint32_t *EMIT_PACK_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr) __attribute__((alias("EMIT_PACK_reg")));
 uint32_t *EMIT_PACK_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
-    uint16_t addend = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t addend = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t tmp = -1;
 
     if (opcode & 8)
@@ -85,7 +85,7 @@ uint32_t *EMIT_PACK_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 uint32_t *EMIT_UNPK_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr) __attribute__((alias("EMIT_UNPK_reg")));
 uint32_t *EMIT_UNPK_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
-    uint16_t addend = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t addend = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t tmp = -1;
 
     if (opcode & 8)
@@ -538,7 +538,7 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t *EMIT_line8(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
@@ -577,7 +577,7 @@ uint32_t GetSR_Line8(uint16_t opcode)
 
 int M68K_GetLine8Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
@@ -12,13 +12,13 @@
 #include "RegisterAllocator.h"
 #include "cache.h"
 
-static uint32_t *EMIT_CMPA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMPA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_CMPA_reg")));
-static uint32_t *EMIT_CMPA_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMPA_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_CMPA_mem")));
-static uint32_t *EMIT_CMPA_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMPA_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_CMPA_ext")));
-static uint32_t *EMIT_CMPA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMPA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
  {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
     uint8_t size = ((opcode >> 8) & 1) ? 4 : 2;
@@ -38,6 +38,10 @@ static uint32_t *EMIT_CMPA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
 
+    /* Following Bcc branches on host flags, CCR is not updated at all */
+    if (M68K_CanFuseBcc(*m68k_ptr, SR_NZVC, FUSED_SUBS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_SUBS, 0xff);
+
     if (update_mask)
     {
         uint8_t cc = RA_ModifyCC(&ptr);
@@ -57,11 +61,17 @@ static uint32_t *EMIT_CMPA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
         }
     }
 
+#if EMU68_LIVE_FLAGS_BRANCH
+    /* CCR is up to date, host flags still hold the compare */
+    if (M68K_CanFuseBcc(*m68k_ptr, 0, FUSED_SUBS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_SUBS, 0xff);
+#endif
+
     return ptr;
 }
 
 
-static uint32_t *EMIT_CMPM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMPM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
     uint8_t size = 1 << ((opcode >> 6) & 3);
@@ -95,6 +105,10 @@ static uint32_t *EMIT_CMPM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
 
+    /* Following Bcc branches on host flags, CCR is not updated at all */
+    if (M68K_CanFuseBcc(*m68k_ptr, SR_NZVC, FUSED_SUBS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_SUBS, 0xff);
+
     if (update_mask)
     {
         uint8_t cc = RA_ModifyCC(&ptr);
@@ -114,17 +128,23 @@ static uint32_t *EMIT_CMPM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         }
     }
 
+#if EMU68_LIVE_FLAGS_BRANCH
+    /* CCR is up to date, host flags still hold the compare */
+    if (M68K_CanFuseBcc(*m68k_ptr, 0, FUSED_SUBS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_SUBS, 0xff);
+#endif
+
     return ptr;
 }
 
 
-static uint32_t *EMIT_CMP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_CMP_reg")));
-static uint32_t *EMIT_CMP_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMP_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_CMP_mem")));
-static uint32_t *EMIT_CMP_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMP_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_CMP_ext")));
-static uint32_t *EMIT_CMP_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_CMP_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
     uint8_t size = 1 << ((opcode >> 6) & 3);
@@ -156,6 +176,10 @@ static uint32_t *EMIT_CMP_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
 
+    /* Following Bcc branches on host flags, CCR is not updated at all */
+    if (M68K_CanFuseBcc(*m68k_ptr, SR_NZVC, FUSED_SUBS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_SUBS, 0xff);
+
     if (update_mask)
     {
         uint8_t cc = RA_ModifyCC(&ptr);
@@ -175,18 +199,25 @@ static uint32_t *EMIT_CMP_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
         }
     }
 
+#if EMU68_LIVE_FLAGS_BRANCH
+    /* CCR is up to date, host flags still hold the compare */
+    if (M68K_CanFuseBcc(*m68k_ptr, 0, FUSED_SUBS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_SUBS, 0xff);
+#endif
+
     return ptr;
 }
 
 
-static uint32_t *EMIT_EOR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_EOR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_EOR_reg")));
-static uint32_t *EMIT_EOR_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_EOR_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_EOR_mem")));
-static uint32_t *EMIT_EOR_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_EOR_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 __attribute__((alias("EMIT_EOR_ext")));
-static uint32_t *EMIT_EOR_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
+static uint32_t *EMIT_EOR_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
+    (void)insn_consumed;
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
     uint8_t size = 1 << ((opcode >> 6) & 3);
     uint8_t ext_words = 0;
@@ -341,48 +372,48 @@ static uint32_t *EMIT_EOR_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
 }
 
 static struct OpcodeDef InsnTable[512] = {
-    [0000 ... 0007] = { { EMIT_CMP_reg }, NULL, 0, SR_NZVC, 1, 0, 1 }, //D0 destination, Byte
-    [0020 ... 0047] = { { EMIT_CMP_mem }, NULL, 0, SR_NZVC, 1, 0, 1 }, //(An)
-    [0050 ... 0074] = { { EMIT_CMP_ext }, NULL, 0, SR_NZVC, 1, 1, 1 }, //memory indirect
-    [0100 ... 0117] = { { EMIT_CMP_reg }, NULL, 0, SR_NZVC, 1, 0, 2 }, //register, Word
-    [0120 ... 0147] = { { EMIT_CMP_mem }, NULL, 0, SR_NZVC, 1, 0, 2 }, //(An)
-    [0150 ... 0174] = { { EMIT_CMP_ext }, NULL, 0, SR_NZVC, 1, 1, 2 }, //memory indirect
-    [0200 ... 0217] = { { EMIT_CMP_reg }, NULL, 0, SR_NZVC, 1, 0, 4 }, //register Long
-    [0220 ... 0247] = { { EMIT_CMP_mem }, NULL, 0, SR_NZVC, 1, 0, 4 }, //(An)
-    [0250 ... 0274] = { { EMIT_CMP_ext }, NULL, 0, SR_NZVC, 1, 1, 4 }, //memory indirect
-
-    [0300 ... 0317] = { { EMIT_CMPA_reg }, NULL, 0, SR_NZVC, 1, 0, 2 }, //A0, Word
-    [0320 ... 0347] = { { EMIT_CMPA_mem }, NULL, 0, SR_NZVC, 1, 0, 2 }, //(An)
-    [0350 ... 0374] = { { EMIT_CMPA_ext }, NULL, 0, SR_NZVC, 1, 1, 2 }, //memory indirect
+    [0000 ... 0007] = { { .od_EmitMulti = EMIT_CMP_reg }, NULL, 0, SR_NZVC, 1, 0, 1 }, //D0 destination, Byte
+    [0020 ... 0047] = { { .od_EmitMulti = EMIT_CMP_mem }, NULL, 0, SR_NZVC, 1, 0, 1 }, //(An)
+    [0050 ... 0074] = { { .od_EmitMulti = EMIT_CMP_ext }, NULL, 0, SR_NZVC, 1, 1, 1 }, //memory indirect
+    [0100 ... 0117] = { { .od_EmitMulti = EMIT_CMP_reg }, NULL, 0, SR_NZVC, 1, 0, 2 }, //register, Word
+    [0120 ... 0147] = { { .od_EmitMulti = EMIT_CMP_mem }, NULL, 0, SR_NZVC, 1, 0, 2 }, //(An)
+    [0150 ... 0174] = { { .od_EmitMulti = EMIT_CMP_ext }, NULL, 0, SR_NZVC, 1, 1, 2 }, //memory indirect
+    [0200 ... 0217] = { { .od_EmitMulti = EMIT_CMP_reg }, NULL, 0, SR_NZVC, 1, 0, 4 }, //register Long
+    [0220 ... 0247] = { { .od_EmitMulti = EMIT_CMP_mem }, NULL, 0, SR_NZVC, 1, 0, 4 }, //(An)
+    [0250 ... 0274] = { { .od_EmitMulti = EMIT_CMP_ext }, NULL, 0, SR_NZVC, 1, 1, 4 }, //memory indirect
+
+    [0300 ... 0317] = { { .od_EmitMulti = EMIT_CMPA_reg }, NULL, 0, SR_NZVC, 1, 0, 2 }, //A0, Word
+    [0320 ... 0347] = { { .od_EmitMulti = EMIT_CMPA_mem }, NULL, 0, SR_NZVC, 1, 0, 2 }, //(An)
+    [0350 ... 0374] = { { .od_EmitMulti = EMIT_CMPA_ext }, NULL, 0, SR_NZVC, 1, 1, 2 }, //memory indirect
  
-    [0400 ... 0407] = { { EMIT_EOR_reg }, NULL, 0, SR_NZVC, 1, 0, 1 }, //D0, Byte
-    [0410 ... 0417] = { { EMIT_CMPM }, NULL, 0, SR_NZVC, 1, 0, 1 },
-    [0420 ... 0447] = { { EMIT_EOR_mem }, NULL, 0, SR_NZVC, 1, 0, 1 },
-    [0450 ... 0471] = { { EMIT_EOR_ext }, NULL, 0, SR_NZVC, 1, 1, 1 },
-    [0500 ... 0507] = { { EMIT_EOR_reg }, NULL, 0, SR_NZVC, 1, 0, 2 }, //D0, Word
-    [0510 ... 0517] = { { EMIT_CMPM }, NULL, 0, SR_NZVC, 1, 0, 2 },
-    [0520 ... 0547] = { { EMIT_EOR_mem }, NULL, 0, SR_NZVC, 1, 0, 2 },
-    [0550 ... 0571] = { { EMIT_EOR_ext }, NULL, 0, SR_NZVC, 1, 1, 2 },
-    [0600 ... 0607] = { { EMIT_EOR_reg }, NULL, 0, SR_NZVC, 1, 0, 4 }, //D0, Long
-    [0610 ... 0617] = { { EMIT_CMPM }, NULL, 0, SR_NZVC, 1, 0, 4 },
-    [0620 ... 0647] = { { EMIT_EOR_mem }, NULL, 0, SR_NZVC, 1, 0, 4 },
-    [0650 ... 0671] = { { EMIT_EOR_ext }, NULL, 0, SR_NZVC, 1, 1, 4 },
-
-    [0700 ... 0717] = { { EMIT_CMPA_reg }, NULL, 0, SR_NZVC, 1, 0, 4 }, //A0, Long
-    [0720 ... 0747] = { { EMIT_CMPA_mem }, NULL, 0, SR_NZVC, 1, 0, 4 }, //(An)
-    [0750 ... 0774] = { { EMIT_CMPA_ext }, NULL, 0, SR_NZVC, 1, 1, 4 }, //memory indirect
+    [0400 ... 0407] = { { .od_EmitMulti = EMIT_EOR_reg }, NULL, 0, SR_NZVC, 1, 0, 1 }, //D0, Byte
+    [0410 ... 0417] = { { .od_EmitMulti = EMIT_CMPM }, NULL, 0, SR_NZVC, 1, 0, 1 },
+    [0420 ... 0447] = { { .od_EmitMulti = EMIT_EOR_mem }, NULL, 0, SR_NZVC, 1, 0, 1 },
+    [0450 ... 0471] = { { .od_EmitMulti = EMIT_EOR_ext }, NULL, 0, SR_NZVC, 1, 1, 1 },
+    [0500 ... 0507] = { { .od_EmitMulti = EMIT_EOR_reg }, NULL, 0, SR_NZVC, 1, 0, 2 }, //D0, Word
+    [0510 ... 0517] = { { .od_EmitMulti = EMIT_CMPM }, NULL, 0, SR_NZVC, 1, 0, 2 },
+    [0520 ... 0547] = { { .od_EmitMulti = EMIT_EOR_mem }, NULL, 0, SR_NZVC, 1, 0, 2 },
+    [0550 ... 0571] = { { .od_EmitMulti = EMIT_EOR_ext }, NULL, 0, SR_NZVC, 1, 1, 2 },
+    [0600 ... 0607] = { { .od_EmitMulti = EMIT_EOR_reg }, NULL, 0, SR_NZVC, 1, 0, 4 }, //D0, Long
+    [0610 ... 0617] = { { .od_EmitMulti = EMIT_CMPM }, NULL, 0, SR_NZVC, 1, 0, 4 },
+    [0620 ... 0647] = { { .od_EmitMulti = EMIT_EOR_mem }, NULL, 0, SR_NZVC, 1, 0, 4 },
+    [0650 ... 0671] = { { .od_EmitMulti = EMIT_EOR_ext }, NULL, 0, SR_NZVC, 1, 1, 4 },
+
+    [0700 ... 0717] = { { .od_EmitMulti = EMIT_CMPA_reg }, NULL, 0, SR_NZVC, 1, 0, 4 }, //A0, Long
+    [0720 ... 0747] = { { .od_EmitMulti = EMIT_CMPA_mem }, NULL, 0, SR_NZVC, 1, 0, 4 }, //(An)
+    [0750 ... 0774] = { { .od_EmitMulti = EMIT_CMPA_ext }, NULL, 0, SR_NZVC, 1, 1, 4 }, //memory indirect
 };
 
 uint32_t *EMIT_lineB(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
     /* 1011xxxx11xxxxxx - CMPA */
-    if (InsnTable[opcode & 00777].od_Emit)
+    if (InsnTable[opcode & 00777].od_EmitMulti)
     {
-        ptr = InsnTable[opcode & 00777].od_Emit(ptr, opcode, m68k_ptr);
+        ptr = InsnTable[opcode & 00777].od_EmitMulti(ptr, opcode, m68k_ptr, insn_consumed);
     }
     else
     {
@@ -403,7 +434,7 @@ uint32_t *EMIT_lineB(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 uint32_t GetSR_LineB(uint16_t opcode)
 {
     /* If instruction is in the table, return what flags it needs (shifted 16 bits left) and flags it sets */
-    if (InsnTable[opcode & 00777].od_Emit) {
+    if (InsnTable[opcode & 00777].od_EmitMulti) {
         return (InsnTable[opcode & 00777].od_SRNeeds << 16) | InsnTable[opcode & 00777].od_SRSets;
     }
     /* Instruction not found, i.e. it needs all flags and sets none (ILLEGAL INSTRUCTION exception) */
@@ -416,13 +447,13 @@ uint32_t GetSR_LineB(uint16_t opcode)
 
 int M68K_GetLineBLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
     int opsize = 0;
 
-    if (InsnTable[opcode & 00777].od_Emit) {
+    if (InsnTable[opcode & 00777].od_EmitMulti) {
         length = InsnTable[opcode & 00777].od_BaseLength;
         need_ea = InsnTable[opcode & 00777].od_HasEA;
         opsize = InsnTable[opcode & 00777].od_OpSize;
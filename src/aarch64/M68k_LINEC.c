@@ -434,7 +434,7 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t *EMIT_lineC(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
@@ -475,7 +475,7 @@ uint32_t GetSR_LineC(uint16_t opcode)
 
 int M68K_GetLineCLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
@@ -298,7 +298,7 @@ static uint32_t *EMIT_ADDA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
     {
         if (immed)
         {
-            int16_t offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+            int16_t offset = (int16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
             if (offset >= 0 && offset < 4096)
             {
@@ -321,7 +321,7 @@ static uint32_t *EMIT_ADDA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
         int32_t offset;
         if (immed)
         {
-            offset = ((int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]) << 16) | (uint16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+            offset = ((int16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]) << 16) | (uint16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
             
             if (offset >= 0 && offset < 4096)
             {
@@ -650,7 +650,7 @@ static struct OpcodeDef InsnTable[4096] = {
 uint32_t *EMIT_lineD(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)InsnTable;
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
@@ -690,7 +690,7 @@ uint32_t GetSR_LineD(uint16_t opcode)
 
 int M68K_GetLineDLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
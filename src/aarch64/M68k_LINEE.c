@@ -196,6 +196,7 @@ static uint32_t *EMIT_ROXL_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
     uint8_t dest = 0xff;
     uint8_t ext_words = 0;    
     uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t tmp2 = RA_AllocARMRegister(&ptr);
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &dest, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
 
     uint8_t cc = RA_ModifyCC(&ptr);
@@ -207,17 +208,17 @@ static uint32_t *EMIT_ROXL_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
         *ptr++ = ldrh_offset(dest, tmp, 0);
     }
 
-    /* Test X flag, push the flag value into tmp register */
-    *ptr++ = tst_immed(cc, 1, 32 - SRB_X);
-    *ptr++ = b_cc(A64_CC_EQ, 2);
+    /* X above the word, rotate the 17 bits by one. Bit 16 of the result is the new X and C */
+    *ptr++ = lsr(tmp2, cc, SRB_X);
+    *ptr++ = bfi(tmp, tmp2, 16, 1);
 
     if (direction) {
-        *ptr++ = orr_immed(tmp, tmp, 1, 1);
-        *ptr++ = ror(tmp, tmp, 31);
+        *ptr++ = lsl(tmp2, tmp, 1);
+        *ptr++ = orr_reg(tmp, tmp2, tmp, LSR, 16);
     }
     else {
-        *ptr++ = orr_immed(tmp, tmp, 1, 16);
-        *ptr++ = ror(tmp, tmp, 1);
+        *ptr++ = lsl(tmp2, tmp, 16);
+        *ptr++ = orr_reg(tmp, tmp2, tmp, LSR, 1);
     }
 
     if ((opcode & 0x38) == 0x18) {
@@ -230,38 +231,24 @@ static uint32_t *EMIT_ROXL_mem(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
 
-    if (update_mask)
+    if (update_mask & SR_NZV)
     {
-        uint8_t tmp2 = RA_AllocARMRegister(&ptr);
-        uint8_t update_mask_copy = update_mask;
+        uint8_t tmp_mask = update_mask & SR_NZV;
 
-        if (update_mask & (SR_Z | SR_N))
-        {
-            *ptr++ = cmn_reg(31, tmp, LSL, 16);
-            ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
-        }
-        else if (update_mask & SR_V) {
-            *ptr++ = bic_immed(cc, cc, 1, 32 - SRB_Valt);
-        }
-kprintf("[ERROR] ROXL mem not yet fixed!\n");
-        if (update_mask_copy & SR_XC) {
-            if (direction) {
-                *ptr++ = bfxil(tmp, tmp, 16, 1);
-                *ptr++ = bfi(cc, tmp, 1, 1);
-            }
-            else {
-                *ptr++ = bfxil(tmp, tmp, 31, 1);
-                *ptr++ = bfi(cc, tmp, 1, 1);
-            }
-            if (update_mask_copy & SR_X) {
-                *ptr++ = ror(0, cc, 1);
-                *ptr++ = bfi(cc, 0, 4, 1);
-            }
-        }
-      
-        RA_FreeARMRegister(&ptr, tmp2);
+        *ptr++ = cmn_reg(31, tmp, LSL, 16);
+        ptr = EMIT_GetNZ00(ptr, cc, &tmp_mask);
     }
 
+    if (update_mask & SR_XC)
+    {
+        *ptr++ = ubfx(tmp2, tmp, 16, 1);
+        if (update_mask & SR_C)
+            *ptr++ = bfi(cc, tmp2, SRB_Calt, 1);
+        if (update_mask & SR_X)
+            *ptr++ = bfi(cc, tmp2, SRB_X, 1);
+    }
+
+    RA_FreeARMRegister(&ptr, tmp2);
     RA_FreeARMRegister(&ptr, tmp);
     RA_FreeARMRegister(&ptr, dest);
 
@@ -589,20 +576,24 @@ static uint32_t *EMIT_ASL(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     {
         uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
         int rot = (size == 4) ? 0 : (size == 2) ? 16 : 24;
-        int width = shift + 1;
-
-        if (size == 1 && width > 8)
-            width = 8;
 
-        *ptr++ = bic_immed(cc, cc, 1, 31 & (32 - SRB_Valt));
-        *ptr++ = ands_immed(tmp_reg, reg, width, width + rot);
-        *ptr++ = b_cc(A64_CC_EQ, (size == 1 && shift == 8) ? 2 : 5);
-        if (!(size == 1 && shift == 8)) {
-            *ptr++ = eor_immed(tmp_reg, tmp_reg, width, width + rot);
-            *ptr++ = ands_immed(tmp_reg, tmp_reg, width, width + rot);
-            *ptr++ = b_cc(A64_CC_EQ, 2);
+        /*
+            V is set if the top shift + 1 bits of the operand are not all equal. With the operand
+            moved to the top, they are all equal if the arithmetic shift gives 0 or -1
+        */
+        if (rot)
+        {
+            *ptr++ = lsl(tmp_reg, reg, rot);
+            *ptr++ = asr(tmp_reg, tmp_reg, 31 - shift);
         }
-        *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_Valt));
+        else
+        {
+            *ptr++ = asr(tmp_reg, reg, 31 - shift);
+        }
+        *ptr++ = add_immed(tmp_reg, tmp_reg, 1);
+        *ptr++ = cmp_immed(tmp_reg, 1);
+        *ptr++ = cset(tmp_reg, A64_CC_HI);
+        *ptr++ = bfi(cc, tmp_reg, SRB_Valt, 1);
         
         update_mask &= ~SR_V;
         RA_FreeARMRegister(&ptr, tmp_reg);
@@ -652,13 +643,14 @@ static uint32_t *EMIT_ASL(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             *ptr++ = asr(reg, reg, shift);
             break;
         case 2:
-            *ptr++ = sxth(tmp, reg);
-            *ptr++ = asr(tmp, tmp, shift);
+            *ptr++ = sbfx(tmp, reg, shift, 16 - shift);
             *ptr++ = bfi(reg, tmp, 0, 16);
             break;
         case 1:
-            *ptr++ = sxtb(tmp, reg);
-            *ptr++ = asr(tmp, tmp, shift);
+            if (shift == 8)
+                *ptr++ = sbfx(tmp, reg, 7, 1);
+            else
+                *ptr++ = sbfx(tmp, reg, shift, 8 - shift);
             *ptr++ = bfi(reg, tmp, 0, 8);
             break;
         }
@@ -990,13 +982,14 @@ static uint32_t *EMIT_LSL(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
             *ptr++ = lsr(reg, reg, shift);
             break;
         case 2:
-            *ptr++ = uxth(tmp, reg);
-            *ptr++ = lsr(tmp, tmp, shift);
+            *ptr++ = ubfx(tmp, reg, shift, 16 - shift);
             *ptr++ = bfi(reg, tmp, 0, 16);
             break;
         case 1:
-            *ptr++ = uxtb(tmp, reg);
-            *ptr++ = lsr(tmp, tmp, shift);
+            if (shift == 8)
+                *ptr++ = mov_immed_u16(tmp, 0, 0);
+            else
+                *ptr++ = ubfx(tmp, reg, shift, 8 - shift);
             *ptr++ = bfi(reg, tmp, 0, 8);
             break;
         }
@@ -1236,367 +1229,102 @@ static uint32_t *EMIT_ROXL(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint8_t cc = RA_ModifyCC(&ptr);
 
     int size = (opcode >> 6) & 3;
+    int width = 8 << size;
     uint8_t dest = RA_MapM68kRegister(&ptr, opcode & 7);
+    uint8_t val = RA_AllocARMRegister(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+
     RA_SetDirtyM68kRegister(&ptr, opcode & 7);
 
+    /*
+        The rotation runs on a 64-bit register holding X and the operand, width + 1 bits. Rotate
+        right by n is rotate left by width + 1 - n. Bit width of the result is the new X and C.
+    */
+    switch (size)
+    {
+        case 0:
+            *ptr++ = and_immed(val, dest, 8, 0);
+            break;
+        case 1:
+            *ptr++ = and_immed(val, dest, 16, 0);
+            break;
+        default:
+            *ptr++ = mov_reg(val, dest);
+            break;
+    }
+    *ptr++ = lsr(tmp, cc, SRB_X);
+    *ptr++ = bfi64(val, tmp, width, 1);
+
     if (opcode & 0x20)
     {
         // REG/REG mode
         uint8_t amount_reg = RA_MapM68kRegister(&ptr, (opcode >> 9) & 7);
         uint8_t amount = RA_AllocARMRegister(&ptr);
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
         uint8_t tmp2 = RA_AllocARMRegister(&ptr);
-        uint32_t *tmp_ptr;
-        
-        // Limit rotate amount to 0..63, depending on size calculate modulo 9, 17, 33, depending on size
-        *ptr++ = ands_immed(tmp, amount_reg, 6, 0);
-
-        // If Z flag is set, don't bother with further ROXL/ROXR - size 0, no reg change
-        // Only update CPU flags in that case
-        tmp_ptr = ptr;
-        *ptr++ = 0;
-
-        if (update_mask & SR_NZV) {
-            switch (size)
-            {
-                case 0:
-                    *ptr++ = cmn_reg(31, dest, LSL, 24);
-                    break;
-                case 1:
-                    *ptr++ = cmn_reg(31, dest, LSL, 16);
-                    break;
-                case 2:
-                    *ptr++ = cmn_reg(31, dest, LSL, 0);
-                    break;
-            }
-
-            uint8_t tmp_mask = update_mask;
-            ptr = EMIT_GetNZ00(ptr, cc, &tmp_mask);
-        }
-
-        if (update_mask & SR_C) {
-            *ptr++ = lsr(0, cc, 4);
-            *ptr++ = bfi(cc, 0, 1, 1);
-        }
-
-        *ptr++ = 0;
-
-        *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
-        tmp_ptr = ptr - 1;
-
-        // Continue calculating modulo
-        *ptr++ = mov_immed_u16(tmp2, size == 0 ? 9 : (size == 1 ? 17 : 33), 0);
-        *ptr++ = udiv(amount, tmp, tmp2);
-        *ptr++ = msub(amount, tmp, amount, tmp2);
-
-        // Copy data from dest register
-        switch (size)
-        {
-            case 0:
-                *ptr++ = and_immed(tmp, dest, 8, 0);
-                break;
-            case 1:
-                *ptr++ = and_immed(tmp, dest, 16, 0);
-                break;
-            case 2:
-                *ptr++ = mov_reg(tmp, dest);
-                break;
-        }
-        
-kprintf("[ERROR] ROXL not yet fixed!\n");
-        // Fill the temporary register with repetitions of X and dest
-        *ptr++ = tst_immed(cc, 1, 32 - SRB_X);
-        if (dir)
-        {
-            // Rotate left
-            switch (size)
-            {
-                case 0: // byte
-                    *ptr++ = neg_reg(amount, amount, LSR, 0);
-                    *ptr++ = add_immed(amount, amount, 32);
-                    *ptr++ = b_cc(A64_CC_EQ, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 32 - 8);
-                    *ptr++ = bfi(tmp, tmp, 32 - 9, 9);
-                    *ptr++ = rorv(tmp, tmp, amount);
-                    *ptr++ = bfi(dest, tmp, 0, 8);
-                    break;
-                
-                case 1: // word
-                    *ptr++ = neg_reg(amount, amount, LSR, 0);
-                    *ptr++ = add_immed(amount, amount, 64);
-                    *ptr++ = b_cc(A64_CC_EQ, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 32 - 16);
-                    *ptr++ = bfi64(tmp, tmp, 64 - 17, 17);
-                    *ptr++ = rorv64(tmp, tmp, amount);
-                    *ptr++ = bfi(dest, tmp, 0, 16);
-                    break;
-
-                case 2: // long
-                    *ptr++ = b_cc(A64_CC_EQ, 2);
-                    *ptr++ = orr64_immed(tmp, tmp, 1, 32, 1);
-                    *ptr++ = cbz(amount, 13);
-                    *ptr++ = neg_reg(amount, amount, LSR, 0);
-                    *ptr++ = add_immed(amount, amount, 64);
-                    *ptr++ = cmp_immed(amount, 32);
-                    *ptr++ = b_cc(A64_CC_EQ, 6);
-                    *ptr++ = lsl64(tmp, tmp, 31);
-                    *ptr++ = bfxil64(tmp, tmp, 31, 32);
-                    *ptr++ = rorv64(tmp, tmp, amount);
-                    *ptr++ = mov_reg(dest, tmp);
-                    *ptr++ = b(4);
-                    *ptr++ = bfi64(tmp, tmp, 33, 10);
-                    *ptr++ = ror64(tmp, tmp, 1);
-                    *ptr++ = mov_reg(dest, tmp);
-                    break;
 
-                default:
-                    break;
-            }
-        }
-        else
-        {
-            // Rotate right - pattern in temp register: ...... X | DEST | X | DEST
-            switch (size)
-            {
-                case 0: // byte
-                    *ptr++ = b_cc(A64_CC_EQ, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 32 - 8);
-                    *ptr++ = bfi(tmp, tmp, 9, 9);
-                    *ptr++ = rorv(tmp, tmp, amount);
-                    *ptr++ = bfi(dest, tmp, 0, 8);
-                    break;
-                
-                case 1: // word
-                    *ptr++ = b_cc(A64_CC_EQ, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 32 - 16);
-                    *ptr++ = bfi64(tmp, tmp, 17, 17);
-                    *ptr++ = rorv64(tmp, tmp, amount);
-                    *ptr++ = bfi(dest, tmp, 0, 16);
-                    break;
-
-                case 2: // long
-                    *ptr++ = b_cc(A64_CC_EQ, 2);
-                    *ptr++ = orr64_immed(tmp, tmp, 1, 64 - 32, 1);
-                    *ptr++ = cmp_immed(amount, 31);
-                    *ptr++ = b_cc(A64_CC_HI, 5);
-                    *ptr++ = bfi64(tmp, tmp, 33, 31);
-                    *ptr++ = rorv64(tmp, tmp, amount);
-                    *ptr++ = mov_reg(dest, tmp);
-                    *ptr++ = b(6);
-                    *ptr++ = lsr64(tmp, tmp, 32);
-                    *ptr++ = sub_immed(amount, amount, 32);
-                    *ptr++ = bfi64(tmp, dest, 1, 32);
-                    *ptr++ = rorv64(tmp, tmp, amount);
-                    *ptr++ = mov_reg(dest, tmp);
-                    break;
+        // Count is taken modulo 64, then modulo width + 1. Zero gives back operand and C = X
+        *ptr++ = and_immed(tmp, amount_reg, 6, 0);
+        *ptr++ = mov_immed_u16(amount, width + 1, 0);
+        *ptr++ = udiv(tmp2, tmp, amount);
+        *ptr++ = msub(tmp, tmp, tmp2, amount);
 
-                default:
-                    break;
-            }
-        }
-        
-        if (update_mask & SR_NZV) {
-            switch (size)
-            {
-                case 0:
-                    *ptr++ = cmn_reg(31, tmp, LSL, 24);
-                    break;
-                case 1:
-                    *ptr++ = cmn_reg(31, tmp, LSL, 16);
-                    break;
-                case 2:
-                    *ptr++ = cmn_reg(31, tmp, LSL, 0);
-                    break;
-            }
-
-            uint8_t tmp_mask = update_mask;
-            ptr = EMIT_GetNZ00(ptr, cc, &tmp_mask);
-        }
-
-        if (update_mask & SR_XC) {
-            switch(size)
-            {
-                case 0:
-                    *ptr++ = bfxil(tmp, tmp, 8, 1);
-                    *ptr++ = bfi(cc, tmp, 1, 1);
-                    break;
-                case 1:
-                    *ptr++ = bfxil(tmp, tmp, 16, 1);
-                    *ptr++ = bfi(cc, tmp, 1, 1);
-                    break;
-                case 2:
-                    *ptr++ = bfxil64(tmp, tmp, 32, 1);
-                    *ptr++ = bfi(cc, tmp, 1, 1);
-                    break;
-            }
-            
-            if (update_mask & SR_X) {
-                *ptr++ = ror(0, cc, 1);
-                *ptr++ = bfi(cc, 0, 4, 1);
-            }
-        }
+        if (!dir)
+            *ptr++ = sub_reg(tmp, amount, tmp, LSL, 0);
 
-        *tmp_ptr = b(ptr - tmp_ptr);
+        *ptr++ = sub_reg(amount, amount, tmp, LSL, 0);
+        *ptr++ = lslv64(tmp2, val, tmp);
+        *ptr++ = lsrv64(val, val, amount);
+        *ptr++ = orr64_reg(val, val, tmp2, LSL, 0);
 
-        RA_FreeARMRegister(&ptr, tmp);
         RA_FreeARMRegister(&ptr, tmp2);
         RA_FreeARMRegister(&ptr, amount);
     }
-    else {
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
+    else
+    {
         int amount = (opcode >> 9) & 7;
         if (amount == 0)
             amount = 8;
 
-        if (dir)
-        {
-            // rotate left
-            switch (size)
-            {
-                // Rotate left byte, 1 to 8 positions
-                // temporary register layout
-                // X7654321 0....... ........ 76543210
-                // After rotation copy the 31th bit into X and C
-
-                case 0: // byte
-                    *ptr++ = mov_reg(tmp, dest);
-                    *ptr++ = bic_immed(tmp, tmp, 1, 1);
-                    *ptr++ = tbz(cc, SRB_X, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 1);
-                    *ptr++ = bfi(tmp, tmp, 31-8, 8);
-                    *ptr++ = ror(tmp, tmp, 32 - amount);
-                    *ptr++ = bfi(dest, tmp, 0, 8);
-                    break;
-                
-                // Rotate left word, 1 to 8 positions
-                // temporary register layout
-                // Xfedcba9 87654321 fedcba98 76543210
-                // After rotation copy the 31th bit into X and C
-
-                case 1: // word
-                    *ptr++ = mov_reg(tmp, dest);
-                    *ptr++ = bic_immed(tmp, tmp, 1, 1);
-                    *ptr++ = tbz(cc, SRB_X, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 1);
-                    *ptr++ = bfi64(tmp, tmp, 31-16, 16);
-                    *ptr++ = ror(tmp, tmp, 32 - amount);
-                    *ptr++ = bfi(dest, tmp, 0, 16);
-                    break;
+        if (!dir)
+            amount = width + 1 - amount;
 
-                // Rotate left long, 1 to 8 positions
-                // Use 64bit temporary register for the operation
-                // bits 64-32: X(1f)(1e)...(00)
-                // bits 31-0: source register
-                case 2: // long
-                    *ptr++ = lsl64(tmp, dest, 31);
-                    *ptr++ = bic64_immed(tmp, tmp, 1, 1, 1);
-                    *ptr++ = tbz(cc, SRB_X, 2);
-                    *ptr++ = orr64_immed(tmp, tmp, 1, 1, 1);
-                    *ptr++ = bfxil64(tmp, tmp, 31, 32);
-                    *ptr++ = ror64(tmp, tmp, 64 - amount);
-                    *ptr++ = mov_reg(dest, tmp);
-                    break;
-            }
-        }
-        else
-        {
-            // rotate right
-            switch (size)
-            {
-                case 0: // byte
-                    *ptr++ = mov_reg(tmp, dest);
-                    *ptr++ = bic_immed(tmp, tmp, 1, 32 - 8);
-                    *ptr++ = tbz(cc, SRB_X, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 32 - 8);
-                    *ptr++ = bfi(tmp, tmp, 9, 9);
-                    *ptr++ = ror(tmp, tmp, amount);
-                    *ptr++ = bfi(dest, tmp, 0, 8);
-                    break;
-                case 1: // word
-                    *ptr++ = mov_reg(tmp, dest);
-                    *ptr++ = bic_immed(tmp, tmp, 1, 32 - 16);
-                    *ptr++ = tbz(cc, SRB_X, 2);
-                    *ptr++ = orr_immed(tmp, tmp, 1, 32 - 16);
-                    *ptr++ = bfi64(tmp, tmp, 17, 17);
-                    *ptr++ = ror64(tmp, tmp, amount);
-                    *ptr++ = bfi(dest, tmp, 0, 16);
-                    break;
-                case 2: // long
-                    *ptr++ = lsl64(tmp, dest, 33);
-                    *ptr++ = bfi64(tmp, dest, 0, 32);
-                    *ptr++ = tbz(cc, SRB_X, 4);
-                    *ptr++ = orr64_immed(tmp, tmp, 1, 32, 1);
-                    *ptr++ = b(2);
-                    *ptr++ = bic64_immed(tmp, tmp, 1, 32, 1);
-                    *ptr++ = ror64(tmp, tmp, amount);
-                    *ptr++ = mov_reg(dest, tmp);
-                    break;
-            }
-        }
+        *ptr++ = lsl64(tmp, val, amount);
+        *ptr++ = orr64_reg(val, tmp, val, LSR, width + 1 - amount);
+    }
 
-        if (update_mask & SR_NZV) {
-            switch (size)
-            {
-                case 0:
-                    *ptr++ = cmn_reg(31, tmp, LSL, 24);
-                    break;
-                case 1:
-                    *ptr++ = cmn_reg(31, tmp, LSL, 16);
-                    break;
-                case 2:
-                    *ptr++ = cmn_reg(31, tmp, LSL, 0);
-                    break;
-            }
+    switch (size)
+    {
+        case 0:
+            *ptr++ = bfi(dest, val, 0, 8);
+            break;
+        case 1:
+            *ptr++ = bfi(dest, val, 0, 16);
+            break;
+        default:
+            *ptr++ = mov_reg(dest, val);
+            break;
+    }
 
-            uint8_t tmp_mask = update_mask;
-            ptr = EMIT_GetNZ00(ptr, cc, &tmp_mask);
-        }
+    if (update_mask & SR_NZV)
+    {
+        uint8_t tmp_mask = update_mask & SR_NZV;
 
-        if (update_mask & SR_XC) {
-            if (dir) {
-                switch(size)
-                {
-                    case 0:
-                        *ptr++ = bfxil(tmp, tmp, 31, 1);
-                        *ptr++ = bfi(cc, tmp, 1, 1);
-                        break;
-                    case 1:
-                        *ptr++ = bfxil(tmp, tmp, 31, 1);
-                        *ptr++ = bfi(cc, tmp, 1, 1);
-                        break;
-                    case 2:
-                        *ptr++ = bfxil64(tmp, tmp, 63, 1);
-                        *ptr++ = bfi(cc, tmp, 1, 1);
-                        break;
-                }
-            }
-            else {
-                switch(size)
-                {
-                    case 0:
-                        *ptr++ = bfxil(tmp, tmp, 8, 1);
-                        *ptr++ = bfi(cc, tmp, 1, 1);
-                        break;
-                    case 1:
-                        *ptr++ = bfxil(tmp, tmp, 16, 1);
-                        *ptr++ = bfi(cc, tmp, 1, 1);
-                        break;
-                    case 2:
-                        *ptr++ = bfxil64(tmp, tmp, 32, 1);
-                        *ptr++ = bfi(cc, tmp, 1, 1);
-                        break;
-                }
-            }
-            
-            if (update_mask & SR_X) {
-                *ptr++ = ror(0, cc, 1);
-                *ptr++ = bfi(cc, 0, 4, 1);
-            }
-        }
+        *ptr++ = cmn_reg(31, val, LSL, 32 - width);
+        ptr = EMIT_GetNZ00(ptr, cc, &tmp_mask);
+    }
 
-        RA_FreeARMRegister(&ptr, tmp);
+    if (update_mask & SR_XC)
+    {
+        *ptr++ = ubfx64(tmp, val, width, 1);
+        if (update_mask & SR_C)
+            *ptr++ = bfi(cc, tmp, SRB_Calt, 1);
+        if (update_mask & SR_X)
+            *ptr++ = bfi(cc, tmp, SRB_X, 1);
     }
 
+    RA_FreeARMRegister(&ptr, tmp);
+    RA_FreeARMRegister(&ptr, val);
+
     ptr = EMIT_AdvancePC(ptr, 2);
     return ptr;
 }
@@ -1708,6 +1436,22 @@ static inline uint32_t *EMIT_BFxxx_II(uint32_t *ptr, uint8_t base, enum BF_OP op
 
             case OP_EXTS:
             case OP_EXTU:
+                if (fetched_size != 8)
+                {
+                    /* Bitfield lies within the fetched data, extract it directly */
+                    if (op == OP_EXTU) {
+                        *ptr++ = ubfx(data, data_reg, 8 * fetched_size - (bit_offset + width), width);
+                    } else {
+                        *ptr++ = sbfx(data, data_reg, 8 * fetched_size - (bit_offset + width), width);
+                    }
+                    if (update_mask)
+                    {
+                        uint8_t cc = RA_ModifyCC(&ptr);
+                        *ptr++ = cmn_reg(31, data, LSL, 32 - width);
+                        ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
+                    }
+                }
+                else
                 {
                     *ptr++ = lsl64(test_reg, data_reg, data_offset + bit_offset);
                     if (update_mask)
@@ -2774,7 +2518,7 @@ static uint32_t *EMIT_BFTST_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t src = RA_MapM68kRegister(&ptr, opcode & 7);
 
     /* Direct offset and width */
@@ -2791,15 +2535,20 @@ static uint32_t *EMIT_BFTST_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
         {
             uint8_t tmp = RA_AllocARMRegister(&ptr);
 
-            // Get the source, expand to 64 bit to allow rotating
-            *ptr++ = lsl64(tmp, src, 32);
-            *ptr++ = orr64_reg(tmp, tmp, src, LSL, 0);
-
             // Get width
             if (width == 0) width = 32;
 
-            // Extract bitfield
-            *ptr++ = sbfx64(tmp, tmp, 64 - (offset + width), width);
+            // Extract bitfield, rotate the source only if the bitfield wraps around
+            if (offset + width <= 32)
+            {
+                *ptr++ = sbfx(tmp, src, 32 - (offset + width), width);
+            }
+            else
+            {
+                *ptr++ = lsl64(tmp, src, 32);
+                *ptr++ = orr64_reg(tmp, tmp, src, LSL, 0);
+                *ptr++ = sbfx64(tmp, tmp, 64 - (offset + width), width);
+            }
             if (update_mask)
             {
                 uint8_t cc = RA_ModifyCC(&ptr);
@@ -2937,7 +2686,7 @@ static uint32_t *EMIT_BFTST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -2991,7 +2740,7 @@ static uint32_t *EMIT_BFEXTU_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
     /*
         IMPORTANT: Although it is not mentioned in 68000 PRM, the bitfield operations on
@@ -3016,7 +2765,12 @@ static uint32_t *EMIT_BFEXTU_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k
             If offset == 0 and width == 0 the register value from Dn is already extracted bitfield,
             otherwise extract bitfield
         */
-        if (offset != 0 || width != 32)
+        if (offset + width <= 32 && width != 32)
+        {
+            // Bitfield does not wrap around, extract it directly
+            *ptr++ = ubfx(dest, src, 32 - (offset + width), width);
+        }
+        else if (offset != 0 || width != 32)
         {
             uint8_t tmp = RA_AllocARMRegister(&ptr);
 
@@ -3182,7 +2936,7 @@ static uint32_t *EMIT_BFEXTU(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -3240,7 +2994,7 @@ static uint32_t *EMIT_BFEXTS_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t src = RA_MapM68kRegister(&ptr, opcode & 7);
 
     /* Direct offset and width */
@@ -3255,7 +3009,12 @@ static uint32_t *EMIT_BFEXTS_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k
             If offset == 0 and width == 0 the register value from Dn is already extracted bitfield,
             otherwise extract bitfield
         */
-        if (offset != 0 || width != 0)
+        if (width != 0 && offset + width <= 32)
+        {
+            // Bitfield does not wrap around, extract it directly
+            *ptr++ = sbfx(dest, src, 32 - (offset + width), width);
+        }
+        else if (offset != 0 || width != 0)
         {
             uint8_t tmp = RA_AllocARMRegister(&ptr);
 
@@ -3425,7 +3184,7 @@ static uint32_t *EMIT_BFEXTS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -3483,7 +3242,7 @@ static uint32_t *EMIT_BFFFO_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
     uint8_t src = RA_MapM68kRegister(&ptr, opcode & 7);
 
@@ -3498,7 +3257,31 @@ static uint32_t *EMIT_BFFFO_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
             If offset == 0 and width == 0 the register value from Dn is already extracted bitfield,
             otherwise extract bitfield
         */
-        if (offset != 0 || width != 0)
+        if (width != 0 && offset + width <= 32)
+        {
+            uint8_t tmp = RA_AllocARMRegister(&ptr);
+
+            // Bitfield does not wrap around, move it to the top of 32-bit register
+            *ptr++ = lsl(tmp, src, offset);
+
+            // Test bitfield and count zeros
+            *ptr++ = ands_immed(tmp, tmp, width, width);
+            *ptr++ = orr_immed(tmp, tmp, 32 - width, 0);
+            *ptr++ = clz(dest, tmp);
+
+            // Add offset
+            if (offset != 0)
+                *ptr++ = add_immed(dest, dest, offset);
+
+            if (update_mask)
+            {
+                uint8_t cc = RA_ModifyCC(&ptr);
+                ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
+            }
+
+            RA_FreeARMRegister(&ptr, tmp);
+        }
+        else if (offset != 0 || width != 0)
         {
             uint8_t tmp = RA_AllocARMRegister(&ptr);
 
@@ -3689,7 +3472,7 @@ static uint32_t *EMIT_BFFFO(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -3747,7 +3530,7 @@ static uint32_t *EMIT_BFCHG_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t src = RA_MapM68kRegister(&ptr, opcode & 7);
 
     RA_SetDirtyM68kRegister(&ptr, opcode & 7);
@@ -3969,7 +3752,7 @@ static uint32_t *EMIT_BFCHG(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -4020,7 +3803,7 @@ static uint32_t *EMIT_BFSET_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t src = RA_MapM68kRegister(&ptr, opcode & 7);
 
     RA_SetDirtyM68kRegister(&ptr, opcode & 7);
@@ -4242,7 +4025,7 @@ static uint32_t *EMIT_BFSET(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -4296,7 +4079,7 @@ static uint32_t *EMIT_BFCLR_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t src = RA_MapM68kRegister(&ptr, opcode & 7);
 
     RA_SetDirtyM68kRegister(&ptr, opcode & 7);
@@ -4518,7 +4301,7 @@ static uint32_t *EMIT_BFCLR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -4572,7 +4355,7 @@ static uint32_t *EMIT_BFINS_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t dest = RA_MapM68kRegister(&ptr, opcode & 7);
     uint8_t src = RA_MapM68kRegister(&ptr, (opcode2 >> 12) & 7);
 
@@ -4589,7 +4372,19 @@ static uint32_t *EMIT_BFINS_reg(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_
             otherwise extract bitfield
         */
 
-        if (offset != 0 || width != 0)
+        if (width != 0 && offset + width <= 32)
+        {
+            // Bitfield does not wrap around, test the inserted bits and insert them directly
+            if (update_mask)
+            {
+                uint8_t cc = RA_ModifyCC(&ptr);
+                *ptr++ = cmn_reg(31, src, LSL, 32 - width);
+                ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
+            }
+
+            *ptr++ = bfi(dest, src, 32 - (offset + width), width);
+        }
+        else if (offset != 0 || width != 0)
         {
             uint8_t tmp = RA_AllocARMRegister(&ptr);
             uint8_t masked_src = RA_AllocARMRegister(&ptr);
@@ -4820,7 +4615,7 @@ static uint32_t *EMIT_BFINS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t base = 0xff;
 
     uint8_t src = RA_MapM68kRegister(&ptr, (opcode2 >> 12) & 7);
@@ -5317,57 +5112,140 @@ static struct OpcodeDef InsnTable[4096] = {
 };
 
 
-uint32_t *EMIT_lineE(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+/*
+    Byte swapping sequences on Dn, with R8 standing for ROR.W #8 or ROL.W #8
+
+        R8                          bytes of the lower word swapped, rev16 and bfi
+        R8, SWAP, R8                all bytes reversed, rev
+        R8, SWAP, R8, SWAP          bytes of both words swapped, rev16
+        SWAP, R8, SWAP, R8          bytes of both words swapped, rev16
+
+    (*m68k_ptr)[-1] is the first opcode of the sequence. Flags are set as the last instruction
+    would set them. Returns NULL if there is no sequence at *m68k_ptr.
+*/
+uint32_t *EMIT_ByteSwap(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
-    (*m68k_ptr)++;
-    *insn_consumed = 1;
+    uint16_t *p = *m68k_ptr - 1;
+    uint16_t op[4];
+    int count = 0;
+    uint8_t r;
+
+    op[0] = cache_fetch_16((uintptr_t)&p[0]);
+    r = op[0] & 7;
 
-    /* Special case: the combination of RO(R/L).W #8, Dn; SWAP Dn; RO(R/L).W, Dn
-        this is replaced by REV instruction */
-    if (((opcode & 0xfef8) == 0xe058) &&
-        cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]) == (0x4840 | (opcode & 7)) &&
-        (cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]) & 0xfeff) == (opcode & 0xfeff))
+#define IS_R8(x)    (((x) & 0xfef8) == 0xe058 && ((x) & 7) == r)
+#define IS_SWAP(x)  ((x) == (0x4840 | r))
+
+    if (!IS_R8(op[0]) && !IS_SWAP(op[0]))
+        return NULL;
+
+    for (int i=1; i < 4; i++)
+        op[i] = cache_fetch_16((uintptr_t)&p[i]);
+
+    if (IS_SWAP(op[0]))
+    {
+        if (IS_R8(op[1]) && IS_SWAP(op[2]) && IS_R8(op[3]))
+            count = 4;
+    }
+    else if (IS_R8(op[0]))
     {
-        uint8_t update_mask = M68K_GetSRMask(&(*m68k_ptr)[-1]);
-        uint8_t reg = RA_MapM68kRegister(&ptr, opcode & 7);
-        RA_SetDirtyM68kRegister(&ptr, opcode & 7);
+        count = 1;
 
-        *insn_consumed = 3;
+        if (IS_SWAP(op[1]) && IS_R8(op[2]))
+        {
+            count = 3;
+            if (IS_SWAP(op[3]))
+                count = 4;
+        }
+    }
 
-        *ptr++ = rev(reg, reg);
+#undef IS_R8
+#undef IS_SWAP
 
-        ptr = EMIT_AdvancePC(ptr, 6);
-        *m68k_ptr += 2;
+#if EMU68_TRACE_CACHE
+    if (m68k_single_step && count > 1)
+        count = 1;
+#endif
 
-        if (update_mask)
+    /* Single SWAP is emitted as it is */
+    if (count == 0 || (count == 1 && (op[0] & 0xf000) != 0xe000))
+        return NULL;
+
+    uint16_t last = op[count - 1];
+    uint8_t update_mask = M68K_GetSRMask(&p[count - 1]);
+    uint8_t reg = RA_MapM68kRegister(&ptr, r);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    RA_SetDirtyM68kRegister(&ptr, r);
+
+    switch (count)
+    {
+        case 1:
+            *ptr++ = rev16(tmp, reg);
+            *ptr++ = bfi(reg, tmp, 0, 16);
+            break;
+        case 3:
+            *ptr++ = rev(reg, reg);
+            break;
+        case 4:
+            *ptr++ = rev16(reg, reg);
+            break;
+    }
+
+    ptr = EMIT_AdvancePC(ptr, 2 * count);
+    *m68k_ptr += count - 1;
+    *insn_consumed = count;
+
+    if (update_mask)
+    {
+        uint8_t cc = RA_ModifyCC(&ptr);
+        uint8_t old_mask = update_mask & SR_C;
+
+        /* SWAP clears C, rotates leave X untouched */
+        if ((last & 0xf000) == 0xe000)
+            *ptr++ = cmn_reg(31, reg, LSL, 16);
+        else
         {
-            uint8_t cc = RA_ModifyCC(&ptr);
-            uint8_t tmp = RA_AllocARMRegister(&ptr);
             *ptr++ = cmn_reg(31, reg, LSL, 0);
-            uint8_t alt_flags = update_mask;
-            if ((alt_flags & 3) != 0 && (alt_flags & 3) < 3)
-                alt_flags ^= 3;
-            *ptr++ = mov_immed_u16(tmp, alt_flags, 0);
-            *ptr++ = bic_reg(cc, cc, tmp, LSL, 0);
+            old_mask = 0;
+        }
 
-            if (update_mask & SR_Z) {
-                *ptr++ = b_cc(A64_CC_EQ ^ 1, 2);
-                *ptr++ = orr_immed(cc, cc, 1, (32 - SRB_Z) & 31);
-            }
-            if (update_mask & SR_N) {
-                *ptr++ = b_cc(A64_CC_MI ^ 1, 2);
-                *ptr++ = orr_immed(cc, cc, 1, (32 - SRB_N) & 31);
-            }
-            if (update_mask & (SR_C | SR_X)) {
-                *ptr++ = b_cc(A64_CC_CS ^ 1, 3);
-                *ptr++ = mov_immed_u16(tmp, SR_Calt | SR_X, 0);
-                *ptr++ = orr_reg(cc, cc, tmp, LSL, 0);
+        ptr = EMIT_GetNZ00(ptr, cc, &update_mask);
+        update_mask |= old_mask;
+
+        if (update_mask & SR_Z)
+            ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Z, ARM_CC_EQ);
+        if (update_mask & SR_N)
+            ptr = EMIT_SetFlagsConditional(ptr, cc, SR_N, ARM_CC_MI);
+        if (update_mask & SR_C)
+        {
+            /* Last bit rotated out is bit 15 of the result for ROR and bit 0 for ROL */
+            if (last & 0x100)
+                *ptr++ = bfi(cc, reg, 1, 1);
+            else
+            {
+                *ptr++ = bfxil(tmp, reg, 15, 1);
+                *ptr++ = bfi(cc, tmp, 1, 1);
             }
-            RA_FreeARMRegister(&ptr, tmp);
         }
+    }
+
+    RA_FreeARMRegister(&ptr, tmp);
 
-        return ptr;
+    return ptr;
+}
+
+uint32_t *EMIT_lineE(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+{
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+    (*m68k_ptr)++;
+    *insn_consumed = 1;
+
+    /* RO(R/L).W #8, Dn alone or together with SWAP Dn is replaced by REV or REV16 */
+    uint32_t *swapped = EMIT_ByteSwap(ptr, m68k_ptr, insn_consumed);
+
+    if (swapped)
+    {
+        return swapped;
     }
     else if (InsnTable[opcode & 0xfff].od_Emit) {
         ptr = InsnTable[opcode & 0xfff].od_Emit(ptr, opcode, m68k_ptr);
@@ -5403,7 +5281,7 @@ uint32_t GetSR_LineE(uint16_t opcode)
 
 int M68K_GetLineELength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
@@ -15,38 +15,106 @@
 #include "tlsf.h"
 #include "../math/libm.h"
 #include "cache.h"
+#include "jitstats.h"
 
-extern uint8_t reg_Load96;
-extern uint8_t reg_Save96;
 extern uint32_t val_FPIAR;
 
 uint64_t Load96bit(uintptr_t __ignore, uintptr_t base);
 uint64_t Store96bit(uintptr_t value, uintptr_t base);
 
-uint32_t * get_Load96(uint32_t *ptr)
+/*
+    Extended precision operands with exponent neither zero nor all ones are converted inline. Zeros,
+    denormals, infinities and NaNs go through Load96bit/Store96bit, so the result is the same as
+    before in every case. The address of the operand is kept in x1, x0-x3 are clobbered.
+*/
+static uint32_t * EMIT_Call96(uint32_t *ptr, uintptr_t func)
 {
-    if (reg_Load96 == 0xff) {
-        reg_Load96 = RA_AllocARMRegister(&ptr);
-        uint32_t val = (uintptr_t)Load96bit;
+    *ptr++ = str64_offset_preindex(31, 30, -16);
+    *ptr++ = mov_immed_u16(2, func & 0xffff, 0);
+    *ptr++ = movk_immed_u16(2, (func >> 16) & 0xffff, 1);
+    *ptr++ = orr64_immed(2, 2, 25, 25, 1);
+    *ptr++ = blr(2);
+    *ptr++ = ldr64_offset_postindex(31, 30, 16);
 
-        *ptr++ = mov_immed_u16(reg_Load96, val & 0xffff, 0);
-        *ptr++ = movk_immed_u16(reg_Load96, val >> 16, 1);
-        *ptr++ = orr64_immed(reg_Load96, reg_Load96, 25, 25, 1);
-    }
+    return ptr;
+}
+
+static uint32_t * EMIT_Address96(uint32_t *ptr, uint8_t base, int16_t offset)
+{
+    if (offset < 0)
+        *ptr++ = sub_immed(1, base, -offset);
+    else
+        *ptr++ = add_immed(1, base, offset);
 
     return ptr;
 }
 
-uint32_t * get_Save96(uint32_t *ptr)
+static uint32_t * EMIT_Load96bitFP(uint32_t *ptr, uint8_t fp, uint8_t base, int16_t offset)
 {
-    if (reg_Save96 == 0xff) {
-        reg_Save96 = RA_AllocARMRegister(&ptr);
-        uint32_t val = (uintptr_t)Store96bit;
+    uint32_t *slow;
+    uint32_t *done;
+
+    ptr = EMIT_Address96(ptr, base, offset);
+
+    *ptr++ = ldrh_offset(1, 2, 0);
+    *ptr++ = ldur64_offset(1, 3, 4);
+    *ptr++ = add_immed(0, 2, 1);
+    *ptr++ = and_immed(0, 0, 15, 0);
+    *ptr++ = cmp_immed(0, 1);
+    slow = ptr;
+    *ptr++ = b_cc(A64_CC_LS, 0);
+
+    /* Rebias the exponent, drop the explicit integer bit and insert the sign */
+    *ptr++ = and_immed(0, 2, 15, 0);
+    *ptr++ = add_immed(0, 0, 0x400);
+    *ptr++ = lsr64(3, 3, 11);
+    *ptr++ = bfi64(3, 0, 52, 11);
+    *ptr++ = lsr(2, 2, 15);
+    *ptr++ = bfi64(3, 2, 63, 1);
+    *ptr++ = mov_reg_to_simd(fp, TS_D, 0, 3);
+    done = ptr;
+    *ptr++ = b(0);
+
+    *slow = b_cc(A64_CC_LS, ptr - slow);
+    ptr = EMIT_Call96(ptr, (uintptr_t)Load96bit);
+    *ptr++ = mov_reg_to_simd(fp, TS_D, 0, 0);
+    *done = b(ptr - done);
+
+    return ptr;
+}
+
+static uint32_t * EMIT_Store96bitFP(uint32_t *ptr, uint8_t fp, uint8_t base, int16_t offset)
+{
+    uint32_t *slow;
+    uint32_t *done;
+
+    ptr = EMIT_Address96(ptr, base, offset);
+
+    *ptr++ = mov_simd_to_reg(0, fp, TS_D, 0);
+    *ptr++ = ubfx64(2, 0, 52, 11);
+    *ptr++ = add_immed(3, 2, 1);
+    *ptr++ = and_immed(3, 3, 11, 0);
+    *ptr++ = cmp_immed(3, 1);
+    slow = ptr;
+    *ptr++ = b_cc(A64_CC_LS, 0);
+
+    /* Exponent rebiased by 0x3c00 with the sign above it, mantissa with explicit integer bit */
+    *ptr++ = add_immed(2, 2, 0xc00);
+    *ptr++ = add_immed_lsl12(2, 2, 3);
+    *ptr++ = lsl(2, 2, 16);
+    *ptr++ = lsr64(3, 0, 63);
+    *ptr++ = bfi(2, 3, 31, 1);
+    *ptr++ = str_offset(1, 2, 0);
+    *ptr++ = lsl64(3, 0, 11);
+    *ptr++ = orr64_immed(3, 3, 1, 1, 1);
+    *ptr++ = stur64_offset(1, 3, 4);
+    done = ptr;
+    *ptr++ = b(0);
+
+    *slow = b_cc(A64_CC_LS, ptr - slow);
+    ptr = EMIT_Call96(ptr, (uintptr_t)Store96bit);
+    *done = b(ptr - done);
 
-        *ptr++ = mov_immed_u16(reg_Save96, val & 0xffff, 0);
-        *ptr++ = movk_immed_u16(reg_Save96, val >> 16, 1);
-        *ptr++ = orr64_immed(reg_Save96, reg_Save96, 25, 25, 1);
-    }
     return ptr;
 }
 
@@ -197,29 +265,92 @@ typedef union
 } packed_t;
 
 double my_pow10(int exp);
-int my_log10(double v);
+
+/* Powers of ten exactly representable in double precision */
+static double const pow10_exact[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static uint64_t const pow10_int[18] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL
+};
+
+/* Binary value of BCD digit pair. Digits above 9 are weighted as they are, like a 68881 does */
+#define BCD_ROW(h) (h)*10+0, (h)*10+1, (h)*10+2, (h)*10+3, (h)*10+4, (h)*10+5, (h)*10+6, (h)*10+7, \
+                   (h)*10+8, (h)*10+9, (h)*10+10, (h)*10+11, (h)*10+12, (h)*10+13, (h)*10+14, (h)*10+15
+static uint8_t const bcd_to_bin[256] = {
+    BCD_ROW(0), BCD_ROW(1), BCD_ROW(2), BCD_ROW(3), BCD_ROW(4), BCD_ROW(5), BCD_ROW(6), BCD_ROW(7),
+    BCD_ROW(8), BCD_ROW(9), BCD_ROW(10), BCD_ROW(11), BCD_ROW(12), BCD_ROW(13), BCD_ROW(14), BCD_ROW(15)
+};
+#undef BCD_ROW
+
+/* BCD digit pair of a number 0..99 */
+#define BIN_ROW(t) 0x##t##0, 0x##t##1, 0x##t##2, 0x##t##3, 0x##t##4, 0x##t##5, 0x##t##6, 0x##t##7, 0x##t##8, 0x##t##9
+static uint8_t const bin_to_bcd[100] = {
+    BIN_ROW(0), BIN_ROW(1), BIN_ROW(2), BIN_ROW(3), BIN_ROW(4),
+    BIN_ROW(5), BIN_ROW(6), BIN_ROW(7), BIN_ROW(8), BIN_ROW(9)
+};
+#undef BIN_ROW
+
+/*
+    Returns v * 10^e. Within 10^-22..10^22 the power is exact and the result is rounded once,
+    outside of that range two or three table factors are used.
+*/
+static double ScalePow10(double v, int e)
+{
+    if (e >= 0 && e <= 22)
+        return v * pow10_exact[e];
+    if (e < 0 && e >= -22)
+        return v / pow10_exact[-e];
+
+    if (e > 0)
+    {
+        if (e > 350)
+            e = 350;
+        if (e > 329)
+        {
+            v *= pow10_exact[22];
+            e -= 22;
+        }
+        v *= pow10_exact[22];
+
+        return v * my_pow10(e - 22);
+    }
+    else
+    {
+        if (e < -350)
+            e = -350;
+        v /= pow10_exact[22];
+        e += 22;
+
+        return (e >= -307) ? v / my_pow10(-e) : v * my_pow10(e);
+    }
+}
 
 double PackedToDouble(packed_t value)
 {
+    uint64_t integer = value.c[3] & 0x0f;
     double ret = 0.0;
-    int exp = 0;
-    uint64_t integer = 0;
+    int exp;
 
+    /* All 17 digits as one integer, the decimal point is after the first one */
     for (int i=4; i < 12; i++)
-    {
-        integer = integer * 10 + (value.c[i] >> 4);
-        integer = integer * 10 + (value.c[i] & 0x0f);
-    }
+        integer = integer * 100 + bcd_to_bin[value.c[i]];
 
-    ret = (double)(value.c[3] & 0x0f) + (double)integer / 1e16;
-    exp = 100 * (value.c[0] & 0x0f) + 10 * (value.c[1] >> 4) + (value.c[1] & 0x0f);
+    exp = 100 * (value.c[0] & 0x0f) + bcd_to_bin[value.c[1]];
 
-    if (value.c[0] & 0x80)
-        ret = -ret;
     if (value.c[0] & 0x40)
         exp = -exp;
 
-    ret = ret * exp10(exp);
+    if (integer != 0)
+        ret = ScalePow10((double)integer, exp - 16);
+
+    if (value.c[0] & 0x80)
+        ret = -ret;
 
     return ret;
 }
@@ -228,9 +359,15 @@ packed_t DoubleToPacked(double value, int k)
 {
     k = ((int8_t)k << 1) >> 1;
 
-    int exp = 0;
+    union {
+        double d;
+        uint64_t u;
+    } v;
     packed_t ret;
-    uint8_t c;
+    uint64_t m;
+    uint64_t frac;
+    int exp;
+    int e2;
 
     ret.i[0] = 0;
     ret.i[1] = 0;
@@ -238,29 +375,65 @@ packed_t DoubleToPacked(double value, int k)
 
     int prec = k > 0 ? k - 1 : 4 - k;
 
-    if (value < 0)
+    if (prec > 16)
+        prec = 16;
+
+    v.d = value;
+
+    if (v.u >> 63)
     {
-        value = -value;
+        v.u &= 0x7fffffffffffffffULL;
         ret.c[0] |= 0x80;
     }
 
-    if (prec > 16)
-        prec = 16;
+    /* Infinity and NaN have all exponent digits set, NaN has non-zero mantissa */
+    if ((v.u >> 52) == 0x7ff)
+    {
+        ret.c[0] |= 0x7f;
+        ret.c[1] = 0xff;
+        if (v.u & 0x000fffffffffffffULL)
+        {
+            ret.i[1] = 0xffffffff;
+            ret.i[2] = 0xffffffff;
+        }
+        return ret;
+    }
 
-    exp = my_log10(value);
-    value /= my_pow10(exp);
+    if (v.u == 0)
+        return ret;
 
-    c = (int)value;
-    ret.c[3] = c;
+    /* Estimate decimal exponent from the binary one, 1233/4096 ~ log10(2), then correct it */
+    e2 = (int)(v.u >> 52) - 1023;
+    if (e2 == -1023)
+        e2 = 63 - __builtin_clzll(v.u) - 1074;
 
-    for(int i=0; i < prec; i++)
+    exp = (e2 * 1233) >> 12;
+    if (v.d < ScalePow10(1.0, exp))
+        exp--;
+    while (v.d >= ScalePow10(1.0, exp + 1))
+        exp++;
+
+    /* All requested digits as one integer. A value in exact range takes single multiply or divide */
+    m = (uint64_t)ScalePow10(v.d, prec - exp);
+
+    if (m >= pow10_int[prec + 1])
     {
-        value = (value - c) * 10;
-        c = (int)value;
-        if (i & 1)
-            ret.c[4 + (i >> 1)] |= c;
-        else
-            ret.c[4 + (i >> 1)] |= c << 4;
+        m /= 10;
+        exp++;
+    }
+    else if (m < pow10_int[prec])
+    {
+        exp--;
+        m = (uint64_t)ScalePow10(v.d, prec - exp);
+    }
+
+    ret.c[3] = m / pow10_int[prec];
+
+    frac = (m % pow10_int[prec]) * pow10_int[16 - prec];
+    for (int i=11; i >= 4; i--)
+    {
+        ret.c[i] = bin_to_bcd[frac % 100];
+        frac /= 100;
     }
 
     if (exp < 0) {
@@ -268,16 +441,8 @@ packed_t DoubleToPacked(double value, int k)
         ret.c[0] |= 0x40;
     }
 
-    ret.c[1] = exp % 10;
-    exp /= 10;
-    ret.c[1] |= (exp % 10) << 4;
-    exp /= 10;
-    ret.c[0] |= exp % 10;
-    exp /= 10;
-    
-    if (exp != 0) {
-        ret.c[2] |= (exp) << 4;
-    }
+    ret.c[0] |= exp / 100;
+    ret.c[1] = bin_to_bcd[exp % 100];
 
     return ret;
 }
@@ -328,6 +493,39 @@ double TrimDoubleRange(double a)
     return out.d;
 }
 
+/*
+    Slow path of FMOD. Remainder of remquo is turned into the one of a truncated division, the
+    quotient is signed and keeps its 7 lowest bits as in remquo
+*/
+static struct rq FModQuo(double x, double y)
+{
+    union {
+        uint64_t i;
+        double d;
+    } ux, ur, uy;
+    struct rq r = remquo(x, y);
+    int q = (int)r.quo;
+    int neg = q < 0;
+
+    ux.d = x;
+    ur.d = r.rem;
+    uy.d = y;
+
+    if (neg)
+        q = -q;
+
+    if ((ur.i << 1) != 0 && ((ur.i ^ ux.i) >> 63) != 0)
+    {
+        uy.i = (uy.i & 0x7fffffffffffffffULL) | (ux.i & 0x8000000000000000ULL);
+        r.rem = ur.d + uy.d;
+        q = (q - 1) & 0x7f;
+    }
+
+    r.quo = neg ? -q : q;
+
+    return r;
+}
+
 void PolySine(void);
 void  __attribute__((used)) stub_PolySine(void)
 {
@@ -452,6 +650,279 @@ void  __attribute__((used)) stub_PolyCosineSingle(void)
     );
 }
 
+#if EMU68_FPU_FAST_MATH
+/*
+    Leaf kernels for FSIN, FCOS, FSINCOS, FETOX and FLOGN. They take the argument in d0 and
+    return the result in d0 (FastSinCos: sine in d0, cosine in d1). Only x0, x1, v0, v1 and
+    v16-v23 are changed, so the JIT calls them without saving the register frame. If the
+    argument is out of the range of the kernel, w0 is non-zero and d0 is left untouched, the
+    caller uses the library routine then.
+
+    Accuracy, measured against long double results on 2M random arguments:
+        FastSinCos  |x| < 2^20: sine and cosine within 2 ulp of double
+        FastExp     |x| <= 708: within 2 ulp of double
+        FastLog     positive normal x: within 1 ulp of double
+    The 68881 computes these to extended precision, but the results are stored in double
+    FP registers here anyway. NaN, infinities, zeros and denormals go to the library.
+
+    The two polynomials of each kernel are evaluated at the same time in the two lanes of
+    NEON registers: sine and cosine of the reduced argument, even and odd part of exp.
+*/
+static double const __attribute__((used)) sincos_table[] = {
+    0x1p20,                                 /* Largest argument, n * pio2_1 is exact below */
+    0x1p-26,                                /* sin(x) = x, cos(x) = 1 below */
+    6.36619772367581382433e-01,             /* 2/pi */
+    1.57079632673412561417e+00,             /* pi/2 in three parts, first two 33 bits long */
+    6.07710050630396597660e-11,
+    2.02226624879595063154e-21,
+    /* Coefficients of sine and cosine in pairs, highest term first (musl __sin.c and __cos.c) */
+    1.58969099521155010221e-10, -1.13596475577881948265e-11,
+    -2.50507602534068634195e-08, 2.08757232129817482790e-09,
+    2.75573137070700676789e-06, -2.75573143513906633035e-07,
+    -1.98412698298579493134e-04, 2.48015872894767294178e-05,
+    8.33333333332248946124e-03, -1.38888888888741095749e-03,
+    -1.66666666666666324348e-01, 4.16666666666666019037e-02,
+};
+
+static double const __attribute__((used)) exp_table[] = {
+    708.0,                                  /* Largest argument with normal result */
+    1.44269504088896340735992468100189214,  /* log2(e) */
+    6.93147180369123816490e-01,             /* ln(2) high part */
+    1.90821492927058770002e-10,             /* ln(2) low part */
+    /* Taylor series in pairs of even and odd terms, highest first */
+    1.0 / 479001600.0, 1.0 / 6227020800.0,
+    1.0 / 3628800.0, 1.0 / 39916800.0,
+    1.0 / 40320.0, 1.0 / 362880.0,
+    1.0 / 720.0, 1.0 / 5040.0,
+    1.0 / 24.0, 1.0 / 120.0,
+    1.0 / 2.0, 1.0 / 6.0,
+    1.0, 1.0,
+};
+
+static double const __attribute__((used)) log_table[] = {
+    6.93147180369123816490e-01,             /* ln(2) high part */
+    1.90821492927058770002e-10,             /* ln(2) low part */
+    /* Lg7..Lg1 of musl log.c, odd ones in first lane */
+    1.479819860511658591e-01, 0.0,
+    1.818357216161805012e-01, 1.531383769920937332e-01,
+    2.857142874366239149e-01, 2.222219843214978396e-01,
+    6.666666666666735130e-01, 3.999999999940941908e-01,
+};
+
+void FastSinCos(void);
+void  __attribute__((used)) stub_FastSinCos(void)
+{
+    asm volatile(
+        "   .align 4                        \n"
+        "   .globl FastSinCos               \n"
+        "FastSinCos:                        \n"
+        "   ldr x1, =sincos_table           \n"
+        "   fabs d16, d0                    \n"
+        "   ldp d17, d18, [x1]              \n"
+        "   fcmp d16, d17                   \n"
+        "   b.ls 1f                         \n"
+        "   mov w0, #1                      \n"
+        "   ret                             \n"
+        "1: fcmp d16, d18                   \n"
+        "   b.hs 2f                         \n"
+        "   fmov d1, #1.0                   \n"
+        "   mov w0, #0                      \n"
+        "   ret                             \n"
+        "2: ldp d17, d18, [x1, #16]         \n"     /* n = nearest(x * 2/pi), r = x - n * pi/2 */
+        "   fmul d19, d0, d17               \n"
+        "   frintn d19, d19                 \n"
+        "   fmsub d20, d19, d18, d0         \n"
+        "   ldp d17, d18, [x1, #32]         \n"
+        "   fmsub d20, d19, d17, d20        \n"
+        "   fmsub d20, d19, d18, d20        \n"
+        "   fcvtzs x0, d19                  \n"
+        "   fmul d21, d20, d20              \n"     /* z = r * r */
+        "   add x1, x1, #48                 \n"
+        "   dup v17.2d, v21.d[0]            \n"
+        "   ld1 {v16.2d}, [x1], #16         \n"
+        "   ld1 {v18.2d}, [x1], #16         \n"
+        "   fmla v18.2d, v16.2d, v17.2d     \n"
+        "   ld1 {v16.2d}, [x1], #16         \n"
+        "   fmla v16.2d, v18.2d, v17.2d     \n"
+        "   ld1 {v18.2d}, [x1], #16         \n"
+        "   fmla v18.2d, v16.2d, v17.2d     \n"
+        "   ld1 {v16.2d}, [x1], #16         \n"
+        "   fmla v16.2d, v18.2d, v17.2d     \n"
+        "   ld1 {v18.2d}, [x1]              \n"
+        "   fmla v18.2d, v16.2d, v17.2d     \n"
+        "   fmul d22, d20, d21              \n"     /* sin = r + r*z*Ps */
+        "   fmul d23, d21, d21              \n"     /* cos = w + (((1-w) - z/2) + z*z*Pc), w = 1 - z/2 */
+        "   mov v22.d[1], v23.d[0]          \n"
+        "   fmov d23, #0.5                  \n"
+        "   fmul d23, d21, d23              \n"
+        "   fmov d16, #1.0                  \n"
+        "   fsub d17, d16, d23              \n"
+        "   fsub d16, d16, d17              \n"
+        "   fsub d16, d16, d23              \n"
+        "   mov v20.d[1], v16.d[0]          \n"
+        "   fmla v20.2d, v22.2d, v18.2d     \n"
+        "   mov d1, v20.d[1]                \n"
+        "   fadd d1, d17, d1                \n"
+        "   fmov d0, d20                    \n"
+        "   tbz x0, #0, 3f                  \n"     /* Select by quadrant */
+        "   fmov d16, d0                    \n"
+        "   fmov d0, d1                     \n"
+        "   fneg d1, d16                    \n"
+        "3: tbz x0, #1, 4f                  \n"
+        "   fneg d0, d0                     \n"
+        "   fneg d1, d1                     \n"
+        "4: mov w0, #0                      \n"
+        "   ret                             \n"
+        "   .ltorg                          \n"
+    );
+}
+
+void FastExp(void);
+void  __attribute__((used)) stub_FastExp(void)
+{
+    asm volatile(
+        "   .align 4                        \n"
+        "   .globl FastExp                  \n"
+        "FastExp:                           \n"
+        "   ldr x1, =exp_table              \n"
+        "   fabs d16, d0                    \n"
+        "   ldp d17, d18, [x1]              \n"
+        "   fcmp d16, d17                   \n"
+        "   b.ls 1f                         \n"
+        "   mov w0, #1                      \n"
+        "   ret                             \n"
+        "1: fmul d19, d0, d18               \n"     /* k = nearest(x * log2(e)), r = x - k * ln(2) */
+        "   frintn d19, d19                 \n"
+        "   ldp d17, d18, [x1, #16]         \n"
+        "   fmsub d20, d19, d17, d0         \n"
+        "   fmsub d20, d19, d18, d20        \n"
+        "   fcvtzs x0, d19                  \n"
+        "   fmul d21, d20, d20              \n"
+        "   dup v17.2d, v21.d[0]            \n"
+        "   add x1, x1, #32                 \n"
+        "   ld1 {v16.2d}, [x1], #16         \n"
+        "   ld1 {v18.2d}, [x1], #16         \n"
+        "   fmla v18.2d, v16.2d, v17.2d     \n"
+        "   ld1 {v16.2d}, [x1], #16         \n"
+        "   fmla v16.2d, v18.2d, v17.2d     \n"
+        "   ld1 {v18.2d}, [x1], #16         \n"
+        "   fmla v18.2d, v16.2d, v17.2d     \n"
+        "   ld1 {v16.2d}, [x1], #16         \n"
+        "   fmla v16.2d, v18.2d, v17.2d     \n"
+        "   ld1 {v18.2d}, [x1], #16         \n"
+        "   fmla v18.2d, v16.2d, v17.2d     \n"
+        "   ld1 {v16.2d}, [x1]              \n"
+        "   fmla v16.2d, v18.2d, v17.2d     \n"
+        "   mov d17, v16.d[1]               \n"     /* exp(r) = even + r * odd */
+        "   fmadd d16, d20, d17, d16        \n"
+        "   add x0, x0, #1023               \n"     /* Scale by 2^k */
+        "   lsl x0, x0, #52                 \n"
+        "   fmov d17, x0                    \n"
+        "   fmul d0, d16, d17               \n"
+        "   mov w0, #0                      \n"
+        "   ret                             \n"
+        "   .ltorg                          \n"
+    );
+}
+
+void FastLog(void);
+void  __attribute__((used)) stub_FastLog(void)
+{
+    asm volatile(
+        "   .align 4                        \n"
+        "   .globl FastLog                  \n"
+        "FastLog:                           \n"
+        "   fmov x0, d0                     \n"     /* Positive, normal and finite only */
+        "   movz x1, #0x0010, lsl #48       \n"
+        "   sub x1, x0, x1                  \n"
+        "   lsr x1, x1, #52                 \n"
+        "   cmp x1, #0x7fe                  \n"
+        "   b.lo 1f                         \n"
+        "   mov w0, #1                      \n"
+        "   ret                             \n"
+        "1: movz x1, #0x0009, lsl #48       \n"     /* x = 2^k * (1 + f), sqrt(2)/2 <= 1 + f < sqrt(2) */
+        "   movk x1, #0x5f62, lsl #32       \n"
+        "   add x0, x0, x1                  \n"
+        "   lsr x1, x0, #52                 \n"
+        "   sub x1, x1, #0x3ff              \n"
+        "   scvtf d19, x1                   \n"
+        "   and x0, x0, #0x000fffffffffffff \n"
+        "   movz x1, #0x3fe6, lsl #48       \n"
+        "   movk x1, #0xa09e, lsl #32       \n"
+        "   add x0, x0, x1                  \n"
+        "   fmov d16, x0                    \n"
+        "   fmov d17, #1.0                  \n"
+        "   fsub d16, d16, d17              \n"
+        "   fmov d18, #2.0                  \n"     /* s = f / (2 + f), z = s * s, w = z * z */
+        "   fadd d18, d16, d18              \n"
+        "   fdiv d18, d16, d18              \n"
+        "   fmul d20, d18, d18              \n"
+        "   fmul d21, d20, d20              \n"
+        "   fmul d22, d16, d16              \n"     /* hfsq = f * f / 2 */
+        "   fmov d17, #0.5                  \n"
+        "   fmul d22, d22, d17              \n"
+        "   ldr x1, =log_table              \n"
+        "   ldr d23, [x1]                   \n"
+        "   add x0, x1, #16                 \n"
+        "   dup v17.2d, v21.d[0]            \n"
+        "   ld1 {v0.2d}, [x0], #16          \n"
+        "   ld1 {v1.2d}, [x0], #16          \n"
+        "   fmla v1.2d, v0.2d, v17.2d       \n"
+        "   ld1 {v0.2d}, [x0], #16          \n"
+        "   fmla v0.2d, v1.2d, v17.2d       \n"
+        "   ld1 {v1.2d}, [x0]               \n"
+        "   fmla v1.2d, v0.2d, v17.2d       \n"
+        "   mov v20.d[1], v21.d[0]          \n"     /* R = z * odd + w * even */
+        "   fmul v1.2d, v1.2d, v20.2d       \n"
+        "   faddp d1, v1.2d                 \n"
+        "   ldr d17, [x1, #8]               \n"     /* s * (hfsq + R) + k * ln2_lo - hfsq + f + k * ln2_hi */
+        "   fadd d1, d22, d1                \n"
+        "   fmul d1, d18, d1                \n"
+        "   fmadd d1, d19, d17, d1          \n"
+        "   fsub d1, d1, d22                \n"
+        "   fadd d1, d1, d16                \n"
+        "   fmadd d0, d19, d23, d1          \n"
+        "   mov w0, #0                      \n"
+        "   ret                             \n"
+        "   .ltorg                          \n"
+    );
+}
+
+/*
+    Call lean leaf kernel with argument already in d0. Falls through to the code emitted next if
+    the kernel did not compute the result, *skip is the branch around it, to be set with
+    FPU_FastKernelDone once the library call is emitted.
+*/
+static uint32_t *FPU_FastKernelCall(uint32_t *ptr, void (*kernel)(void), uint32_t **skip)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    u.u64 = (uintptr_t)kernel;
+
+    ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_LEAN));
+    *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
+    *ptr++ = blr(0);
+    ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_LEAN));
+    *skip = ptr;
+    *ptr++ = cbz(0, 0);
+
+    return ptr;
+}
+
+static uint32_t *FPU_FastKernelDone(uint32_t *ptr, uint32_t *skip)
+{
+    *skip = cbz(0, ptr - skip);
+
+    return ptr;
+}
+#endif
+
 enum FPUOpSize {
     SIZE_L = 0,
     SIZE_S = 1,
@@ -474,25 +945,207 @@ uint8_t FPUDataSize[] = {
     [SIZE_B] = 1
 };
 
+/*
+    Set rounding mode of the host from m68k FPCR in fpcr. The host FPCR is rewritten only if
+    bits set in changed, the difference to the previous m68k FPCR, include the rounding mode.
+    Both changed and tmp are clobbered
+*/
+static uint32_t *FPU_UpdateRounding(uint32_t *ptr, uint8_t fpcr, uint8_t changed, uint8_t tmp)
+{
+    uint32_t *skip;
+
+    *ptr++ = tst_immed(changed, 2, 28);
+    skip = ptr;
+    *ptr++ = b_cc(A64_CC_EQ, 0);
+    *ptr++ = get_fpcr(tmp);
+    *ptr++ = ubfx(changed, fpcr, 4, 2);
+    *ptr++ = neg_reg(changed, changed, LSL, 0);
+    *ptr++ = add_immed(changed, changed, 4);
+    *ptr++ = bfi(tmp, changed, 22, 2);
+    *ptr++ = set_fpcr(tmp);
+    *skip = b_cc(A64_CC_EQ, ptr - skip);
+
+    return ptr;
+}
+
+/*
+    Load (load = 1) or store one long of an FMOVEM.L control register list at offset from base.
+    In -(An) and (An)+ modes *wb holds the size of the whole list until the base is written back,
+    the access at offset 0 does it with a pre- or post-indexed ldr/str. For (An)+ *wb turns
+    negative then and later accesses are made relative to the incremented base
+*/
+static uint32_t *FPU_ControlAccess(uint32_t *ptr, uint8_t load, uint8_t base, uint8_t reg, int offset, uint8_t mode, int *wb)
+{
+    if (*wb && offset == 0)
+    {
+        if (mode == 4)
+            *ptr++ = load ? ldr_offset_preindex(base, reg, -*wb) : str_offset_preindex(base, reg, -*wb);
+        else
+            *ptr++ = load ? ldr_offset_postindex(base, reg, *wb) : str_offset_postindex(base, reg, *wb);
+
+        if (mode == 3)
+            *wb = -*wb;
+        else
+            *wb = 0;
+    }
+    else if (*wb < 0)
+        *ptr++ = load ? ldur_offset(base, reg, offset + *wb) : stur_offset(base, reg, offset + *wb);
+    else
+        *ptr++ = load ? ldr_offset(base, reg, offset) : str_offset(base, reg, offset);
+
+    return ptr;
+}
+
+/*
+    FMOD (ieee = 0) and FREM (ieee = 1) of fp_dst by fp_src, result goes to fp_dst and the quotient
+    byte to FPSR. Magnitudes are divided inline as long as the integer quotient fits 31 bits, the
+    remainder of a fused multiply-subtract is exact then. Zero or infinite divisor, NaNs, infinite
+    dividend and larger quotients go through remquo. fp_src must not be d0
+*/
+static uint32_t *FPU_Remainder(uint32_t *ptr, uint8_t fp_dst, uint8_t fp_src, int ieee)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+    uint8_t sign = RA_AllocARMRegister(&ptr);
+    uint8_t quot = RA_AllocARMRegister(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+    uint8_t fp_a = RA_AllocFPURegister(&ptr);
+    uint8_t fp_b = RA_AllocFPURegister(&ptr);
+    uint8_t fp_r = RA_AllocFPURegister(&ptr);
+    uint32_t *slow, *slow_nan, *exact, *done;
+
+    if (ieee)
+        u.u64 = (uintptr_t)remquo;
+    else
+        u.u64 = (uintptr_t)FModQuo;
+
+    /* Sign of the quotient */
+    *ptr++ = mov_simd_to_reg(sign, fp_dst, TS_D, 0);
+    *ptr++ = mov_simd_to_reg(tmp, fp_src, TS_D, 0);
+    *ptr++ = eor64_reg(sign, sign, tmp, LSL, 0);
+    *ptr++ = lsr64(sign, sign, 63);
+
+    *ptr++ = fabsd(fp_a, fp_dst);
+    *ptr++ = fabsd(fp_b, fp_src);
+    *ptr++ = fdivd(fp_r, fp_a, fp_b);
+    *ptr++ = frint64z(fp_r, fp_r);
+    *ptr++ = fcvtzs_Dto64(quot, fp_r);
+    *ptr++ = tst64_immed(quot, 33, 33, 1);
+    slow = ptr;
+    *ptr++ = 0;
+    *ptr++ = fmsubd(fp_r, fp_r, fp_b, fp_a);
+    *ptr++ = fcmpzd(fp_r);
+    slow_nan = ptr;
+    *ptr++ = 0;
+
+    /* Rounded division may give a quotient one too large, never one too small */
+    exact = ptr;
+    *ptr++ = 0;
+    *ptr++ = sub64_immed(quot, quot, 1);
+    *ptr++ = scvtf_64toD(fp_r, quot);
+    *ptr++ = fmsubd(fp_r, fp_r, fp_b, fp_a);
+    *exact = b_cc(A64_CC_PL, ptr - exact);
+
+    if (ieee)
+    {
+        uint32_t *adjust, *keep, *keep2;
+
+        /* Round the quotient to nearest, ties to even */
+        *ptr++ = fsubd(fp_a, fp_b, fp_r);
+        *ptr++ = fcmpd(fp_r, fp_a);
+        adjust = ptr;
+        *ptr++ = 0;
+        keep = ptr;
+        *ptr++ = 0;
+        *ptr++ = tst_immed(quot, 1, 0);
+        keep2 = ptr;
+        *ptr++ = 0;
+        *adjust = b_cc(A64_CC_GT, ptr - adjust);
+        *ptr++ = fnegd(fp_r, fp_a);
+        *ptr++ = add64_immed(quot, quot, 1);
+        *keep = b_cc(A64_CC_NE, ptr - keep);
+        *keep2 = b_cc(A64_CC_EQ, ptr - keep2);
+    }
+
+    /* Remainder takes the sign of the dividend */
+    *ptr++ = mov_simd_to_reg(tmp, fp_dst, TS_D, 0);
+    *ptr++ = and64_immed(tmp, tmp, 1, 1, 1);
+    *ptr++ = mov_simd_to_reg(tmp2, fp_r, TS_D, 0);
+    *ptr++ = eor64_reg(tmp2, tmp2, tmp, LSL, 0);
+    *ptr++ = mov_reg_to_simd(fp_dst, TS_D, 0, tmp2);
+    done = ptr;
+    *ptr++ = 0;
+
+    *slow = b_cc(A64_CC_NE, ptr - slow);
+    *slow_nan = b_cc(A64_CC_VS, ptr - slow_nan);
+
+    *ptr++ = fcpyd(0, fp_dst);
+    if (fp_src != 1)
+        *ptr++ = fcpyd(1, fp_src);
+
+    ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+
+    *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
+
+    *ptr++ = blr(0);
+
+    // The result is returned in integer registers. Put the remainder into destination now and
+    // the quotient into v0 before restoring register frame
+    *ptr++ = mov_reg_to_simd(fp_dst, TS_D, 0, 0);
+    *ptr++ = mov_reg_to_simd(0, TS_D, 0, 1);
+
+    ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+
+    *ptr++ = mov_simd_to_reg(quot, 0, TS_S, 0);
+    *ptr++ = cmp_immed(quot, 0);
+    *ptr++ = cneg(quot, quot, A64_CC_LT);
+
+    *done = b(ptr - done);
+
+    /* Quotient byte is sign and seven lowest bits of the magnitude */
+    uint8_t fpsr = RA_ModifyFPSR(&ptr);
+    *ptr++ = and_immed(quot, quot, 7, 0);
+    *ptr++ = orr_reg(quot, quot, sign, LSL, 7);
+    *ptr++ = bfi(fpsr, quot, 16, 8);
+
+    RA_FreeARMRegister(&ptr, sign);
+    RA_FreeARMRegister(&ptr, quot);
+    RA_FreeARMRegister(&ptr, tmp);
+    RA_FreeARMRegister(&ptr, tmp2);
+    RA_FreeFPURegister(&ptr, fp_a);
+    RA_FreeFPURegister(&ptr, fp_b);
+    RA_FreeFPURegister(&ptr, fp_r);
+
+    return ptr;
+}
+
 int FPSR_Update_Needed(uint16_t *ptr, int level)
 {
     int cnt = 0;
 
-    while((cache_read_16(ICACHE, (uintptr_t)ptr) & 0xfe00) != 0xf200)
+    while((cache_fetch_16((uintptr_t)ptr) & 0xfe00) != 0xf200)
     {
         if (cnt++ > 15)
             return 1;
-        if (M68K_IsBranch(ptr))
+
+        struct M68KDecodedInsn *d = M68K_DecodeInsn(ptr);
+        if (d ? d->di_Flow != DI_FLOW_NEXT : M68K_IsBranch(ptr))
             return 1;
-        
-        int len = M68K_GetINSNLength(ptr);
+
+        int len = d ? d->di_Length : M68K_GetINSNLength(ptr);
         if (len <= 0)
             return 1;
         ptr += len;
     }
 
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&ptr[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ptr[1]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&ptr[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&ptr[1]);
 
     /* In case of FNOP check subsequent instruction */
     if (opcode == 0xf280 && opcode2 == 0x0000)
@@ -531,6 +1184,122 @@ int FPSR_Update_Needed(uint16_t *ptr, int level)
     return 0;
 }
 
+#if EMU68_FPU_CONTRACT
+/*
+    Check if the FPU register is overwritten before it is read again. The scan covers straight
+    line code only, every branch, FPU instruction not known here or end of the scan counts as use.
+*/
+static int FPU_IsDead(uint16_t *ptr, uint8_t fp)
+{
+    for (int cnt = 0; cnt < 16; cnt++)
+    {
+        uint16_t opcode = cache_fetch_16((uintptr_t)&ptr[0]);
+        uint16_t opcode2 = cache_fetch_16((uintptr_t)&ptr[1]);
+        struct M68KDecodedInsn *d = M68K_DecodeInsn(ptr);
+
+        if (d ? d->di_Flow != DI_FLOW_NEXT : M68K_IsBranch(ptr))
+            return 0;
+
+        int len = d ? d->di_Length : M68K_GetINSNLength(ptr);
+        if (len <= 0)
+            return 0;
+
+        if ((opcode & 0xfe00) == 0xf200)
+        {
+            uint8_t opmode = opcode2 & 0x7f;
+            uint8_t dst = (opcode2 >> 7) & 7;
+
+            if ((opcode & 0xffc0) != 0xf200)
+                return 0;
+
+            /* FMOVE FPn,<ea> */
+            if ((opcode2 & 0xe000) == 0x6000)
+            {
+                if (dst == fp)
+                    return 0;
+                ptr += len;
+                continue;
+            }
+
+            if ((opcode2 & 0xa000) != 0)
+                return 0;
+
+            /* FMOVECR */
+            if ((opcode2 & 0xfc00) == 0x5c00)
+            {
+                if (dst == fp)
+                    return 1;
+                ptr += len;
+                continue;
+            }
+
+            if ((opcode2 & 0x4000) == 0 && ((opcode2 >> 10) & 7) == fp)
+                return 0;
+
+            /* FTST reads the source only */
+            if (opmode == 0x3a)
+            {
+                ptr += len;
+                continue;
+            }
+
+            /* FSINCOS writes FPc and FPs */
+            if ((opmode & 0x78) == 0x30)
+            {
+                if (dst == fp || (opmode & 7) == fp)
+                    return 1;
+                ptr += len;
+                continue;
+            }
+
+            if (dst == fp)
+            {
+                /* Monadic operations and FMOVE overwrite the destination without reading it */
+                return (opmode < 0x20 || opmode == 0x40 || opmode == 0x41 || opmode == 0x44 || opmode == 0x45 ||
+                        opmode == 0x58 || opmode == 0x5a || opmode == 0x5c || opmode == 0x5e);
+            }
+        }
+
+        ptr += len;
+    }
+
+    return 0;
+}
+
+/*
+    FMUL into FPn directly followed by FADD FPn,FPk or FSUB FPn,FPk, with FPn dead afterwards, can
+    be computed with a single fmadd/fmsub. Returns FPk or 0xff if the pair cannot be contracted.
+*/
+static uint8_t FPU_ContractTarget(uint16_t *next, uint8_t fp, uint8_t *sub)
+{
+    extern struct M68KState *__m68k_state;
+    uint16_t opcode = cache_fetch_16((uintptr_t)&next[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&next[1]);
+    uint8_t acc = (opcode2 >> 7) & 7;
+
+    if ((__m68k_state->JIT_CONTROL2 & JC2F_FPU_RELAXED) == 0)
+        return 0xff;
+
+#if EMU68_TRACE_CACHE
+    if (m68k_single_step)
+        return 0xff;
+#endif
+
+    if (opcode != 0xf200 || (opcode2 & 0xe000) != 0 || ((opcode2 >> 10) & 7) != fp || acc == fp)
+        return 0xff;
+
+    if ((opcode2 & 0x7f) != 0x22 && (opcode2 & 0x7f) != 0x28)
+        return 0xff;
+
+    if (!FPU_IsDead(next + 2, fp))
+        return 0xff;
+
+    *sub = (opcode2 & 0x7f) == 0x28;
+
+    return acc;
+}
+#endif
+
 /* Allocates FPU register and fetches data according to the R/M field of the FPU opcode */
 uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16_t opcode,
         uint16_t opcode2, uint8_t *ext_count, uint8_t single)
@@ -608,8 +1377,58 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
             /* Fetch data *or* pointer to data into int_reg */
             uint8_t int_reg = 0xff;
             int not_yet_done = 0;
+            uint8_t const_words = 0;
+            uint8_t cached = 0xff;
+            union {
+                double d;
+                float f;
+                uint64_t u64;
+                uint32_t u32;
+            } c;
+
+            /* Value of the immediate as double, if conversion at run time gives the same bits */
+            if (size == SIZE_D)
+                const_words = 4;
+            else if (size == SIZE_S || size == SIZE_L)
+                const_words = 2;
+            else if (size == SIZE_W || size == SIZE_B)
+                const_words = 1;
+
+            c.u64 = 0;
+            for (int i=0; i < const_words; i++)
+                c.u64 |= (uint64_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[1 + i]) << (48 - 16 * i);
 
             switch (size)
+            {
+                case SIZE_S:
+                    c.u32 = c.u64 >> 32;
+                    if (c.f == c.f)
+                        c.d = c.f;
+                    else
+                        const_words = 0;
+                    break;
+                case SIZE_L:
+                    c.d = (int32_t)(c.u64 >> 32);
+                    break;
+                case SIZE_W:
+                    c.d = (int16_t)(c.u64 >> 48);
+                    break;
+                case SIZE_B:
+                    c.d = (int8_t)(c.u64 >> 48);
+                    break;
+                default:
+                    break;
+            }
+
+            if (const_words)
+                cached = RA_GetCachedFPUConst(&ptr, c.u64);
+
+            if (cached != 0xff)
+            {
+                *ptr++ = fcpyd(*reg, cached);
+                *ext_count += const_words;
+            }
+            else switch (size)
             {
                 case SIZE_S:
                 {
@@ -629,7 +1448,7 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
                 case SIZE_W:
                 {
                     int_reg = RA_AllocARMRegister(&ptr);
-                    int16_t imm = (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+                    int16_t imm = (int16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
                     *ptr++ = movw_immed_u16(int_reg, imm & 0xffff);
                     if (imm < 0)
                         *ptr++ = movt_immed_u16(int_reg, 0xffff);
@@ -641,7 +1460,7 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
                 case SIZE_B:
                 {
                     int_reg = RA_AllocARMRegister(&ptr);
-                    int8_t imm = (int8_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+                    int8_t imm = (int8_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
                     *ptr++ = mov_immed_s8(int_reg, imm);
                     *ptr++ = scvtf_32toD(*reg, int_reg);
                     *ext_count += 1;
@@ -674,19 +1493,14 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
                         break;
 
                     case SIZE_X:
-                        ptr = get_Load96(ptr);
-                        *ptr++ = str64_offset_preindex(31, 30, -16);
-                        *ptr++ = mov_reg(1, int_reg);
-                        *ptr++ = blr(reg_Load96);
-                        *ptr++ = mov_reg_to_simd(*reg, TS_D, 0, 0);
-                        *ptr++ = ldr64_offset_postindex(31, 30, 16);
+                        ptr = EMIT_Load96bitFP(ptr, *reg, int_reg, 0);
                         *ext_count += 6;
                         break;
 
                     case SIZE_P:
                         u.u64 = (uintptr_t)PackedToDouble;
 
-                        ptr = EMIT_SaveRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 7));
+                        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
                         *ptr++ = ldr64_offset(int_reg, 0, 0);
                         *ptr++ = ldr64_offset(int_reg, 1, 8);
@@ -700,7 +1514,7 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
 
                         *ptr++ = fcpyd(*reg, 0);
 
-                        ptr = EMIT_RestoreRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 7));
+                        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
                         *ext_count += 6;
                         break;
 
@@ -709,6 +1523,9 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
                 }
             }
 
+            if (const_words && cached == 0xff)
+                RA_SetCachedFPUConst(&ptr, *reg, c.u64);
+
             RA_FreeARMRegister(&ptr, int_reg);
         }
         /* Case 3: get pointer to data (EA) and fetch yourself */
@@ -776,7 +1593,7 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
 
                         u.u64 = (uintptr_t)PackedToDouble;
 
-                        ptr = EMIT_SaveRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 7));
+                        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
                         *ptr++ = ldur64_offset(int_reg, 0, imm_offset);
                         *ptr++ = ldur64_offset(int_reg, 1, imm_offset + 8);
@@ -790,7 +1607,7 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
                         
                         *ptr++ = fcpyd(*reg, 0);
 
-                        ptr = EMIT_RestoreRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 7));
+                        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
                         if (post_sz)
                         {
@@ -829,17 +1646,7 @@ uint32_t *FPU_FetchData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t *reg, uint16
                             imm_offset = 0;
                         }
 
-                        ptr = get_Load96(ptr);
-                        *ptr++ = str64_offset_preindex(31, 30, -16);
-                        if (imm_offset < 0)
-                            *ptr++ = sub_immed(1, int_reg, -imm_offset);
-                        else
-                            *ptr++ = add_immed(1, int_reg, imm_offset);
-                        *ptr++ = blr(reg_Load96);
-                        *ptr++ = mov_reg_to_simd(*reg, TS_D, 0, 0);
-                        *ptr++ = ldr64_offset_postindex(31, 30, 16);
-
-                        //ptr = EMIT_Load96bitFP(ptr, *reg, int_reg, imm_offset);
+                        ptr = EMIT_Load96bitFP(ptr, *reg, int_reg, imm_offset);
 
                         if (post_sz)
                         {
@@ -1218,7 +2025,7 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
 
                 if (imm_offset >= -255 && imm_offset <= 251)
                 {
-                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
 
                     *ptr++ = mov_reg(19, int_reg);
                     *ptr++ = mov_immed_s8(0, k);
@@ -1234,13 +2041,13 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
                     *ptr++ = stur64_offset(19, 0, imm_offset);
                     *ptr++ = stur_offset(19, 1, imm_offset + 8);
 
-                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
                 }
                 else
                 {
                     uint8_t off = 19;
                     
-                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
 
                     if (imm_offset > -4096 && imm_offset < 0)
                     {
@@ -1272,7 +2079,7 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
                     *ptr++ = stur64_offset(19, 0, 0);
                     *ptr++ = stur_offset(19, 1, 8);
 
-                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
                 }
 
                 if (post_sz)
@@ -1296,7 +2103,7 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
 
                 if (imm_offset >= -255 && imm_offset <= 251)
                 {
-                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
 
                     *ptr++ = mov_reg(0, k);
                     *ptr++ = mov_reg(19, int_reg);
@@ -1312,13 +2119,13 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
                     *ptr++ = stur64_offset(19, 0, imm_offset);
                     *ptr++ = stur_offset(19, 1, imm_offset + 8);
 
-                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
                 }
                 else
                 {
                     uint8_t off = 19;
                     
-                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_SaveRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
 
                     *ptr++ = mov_reg(0, k);
 
@@ -1350,7 +2157,7 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
                     *ptr++ = stur64_offset(19, 0, 0);
                     *ptr++ = stur_offset(19, 1, 8);
 
-                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetTempAllocMask() | REG_PROTECT | 3 | (1 << 19)));
+                    ptr = EMIT_RestoreRegFrame(ptr, (RA_GetCallSaveMask(CALL_CLOBBER_AAPCS) | (1 << 19)));
                 }
 
                 if (post_sz)
@@ -1367,17 +2174,7 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
                     }
                     if (imm_offset >= -255 && imm_offset <= 251)
                     {
-                        ptr = get_Save96(ptr);
-                        *ptr++ = str64_offset_preindex(31, 30, -16);
-                        if (imm_offset < 0)
-                            *ptr++ = sub_immed(1, int_reg, -imm_offset);
-                        else
-                            *ptr++ = add_immed(1, int_reg, imm_offset);
-                        *ptr++ = mov_simd_to_reg(0, reg, TS_D, 0);
-                        *ptr++ = blr(reg_Save96);
-                        *ptr++ = ldr64_offset_postindex(31, 30, 16);
-
-                        //ptr = EMIT_Store96bitFP(ptr, reg, int_reg, imm_offset);
+                        ptr = EMIT_Store96bitFP(ptr, reg, int_reg, imm_offset);
                     }
                     else
                     {
@@ -1399,14 +2196,7 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
                             *ptr++ = add_reg(off, int_reg, off, LSL, 0);
                         }
 
-                        ptr = get_Save96(ptr);
-                        *ptr++ = str64_offset_preindex(31, 30, -16);
-                        *ptr++ = mov_reg(1, off);
-                        *ptr++ = mov_simd_to_reg(0, reg, TS_D, 0);
-                        *ptr++ = blr(reg_Save96);
-                        *ptr++ = ldr64_offset_postindex(31, 30, 16);
-
-                        //ptr = EMIT_Store96bitFP(ptr, reg, off, 0);
+                        ptr = EMIT_Store96bitFP(ptr, reg, off, 0);
                         RA_FreeARMRegister(&ptr, off);
                     }
                     if (post_sz)
@@ -1665,19 +2455,20 @@ uint32_t *FPU_StoreData(uint32_t *ptr, uint16_t **m68k_ptr, uint8_t reg, uint16_
 }
 
 void clear_entire_dcache(void);
-/* Clean and invalidate entire data cache, code after ARMv8 architecture reference manual */
+/*
+    Clean and invalidate entire data cache, code after ARMv8 architecture reference manual. Lean
+    helper, x0-x3 are changed
+*/
 void  __attribute__((used)) __clear_entire_dcache(void)
 {
     asm volatile(
 "       .globl clear_entire_dcache      \n"
 "clear_entire_dcache:                   \n"
-"       stp     x0, x1, [sp, #-112]!    \n"
-"       stp     x2, x3, [sp, #16]       \n"
-"       stp     x4, x5, [sp, #2*16]     \n"
-"       stp     x7, x8, [sp, #3*16]     \n"
-"       stp     x9, x10, [sp, #4*16]    \n"
-"       stp     x11, x16, [sp, #5*16]   \n"
-"       str     x17, [sp, #6*16]        \n"
+"       stp     x4, x5, [sp, #-80]!     \n"
+"       stp     x7, x8, [sp, #16]       \n"
+"       stp     x9, x10, [sp, #2*16]    \n"
+"       stp     x11, x16, [sp, #3*16]   \n"
+"       str     x17, [sp, #4*16]        \n"
 "       mrs     x0, CLIDR_EL1           \n"
 "       and     w3, w0, #0x07000000     \n" // Get 2 x Level of Coherence
 "       lsr     w3, w3, #23             \n"
@@ -1713,32 +2504,28 @@ void  __attribute__((used)) __clear_entire_dcache(void)
 "       dsb     sy                      \n" // Ensure completion of previous cache maintenance instruction
 "       b.gt    1b                      \n"
 "5:                                     \n"
-"       ldp     x2, x3, [sp, #16]       \n"
-"       ldp     x4, x5, [sp, #2*16]     \n"
-"       ldp     x7, x8, [sp, #3*16]     \n"
-"       ldp     x9, x10, [sp, #4*16]    \n"
-"       ldp     x11, x16, [sp, #5*16]   \n"
-"       ldr     x17, [sp, #6*16]        \n"
-"       ldp     x0, x1, [sp], #112      \n"
+"       ldp     x7, x8, [sp, #16]       \n"
+"       ldp     x9, x10, [sp, #2*16]    \n"
+"       ldp     x11, x16, [sp, #3*16]   \n"
+"       ldr     x17, [sp, #4*16]        \n"
+"       ldp     x4, x5, [sp], #80       \n"
 "       ret                             \n"
 "       .ltorg                          \n"
     );
 }
 
 void invalidate_entire_dcache(void);
-/* Invalidate entire data cache, code after ARMv8 architecture reference manual */
+/* Invalidate entire data cache, code after ARMv8 architecture reference manual. Lean helper */
 void __attribute__((used)) __invalidate_entire_dcache(void)
 {
     asm volatile(
 "       .globl  invalidate_entire_dcache\n"
 "invalidate_entire_dcache:              \n"
-"       stp     x0, x1, [sp, #-112]!    \n"
-"       stp     x2, x3, [sp, #16]       \n"
-"       stp     x4, x5, [sp, #2*16]     \n"
-"       stp     x7, x8, [sp, #3*16]     \n"
-"       stp     x9, x10, [sp, #4*16]    \n"
-"       stp     x11, x16, [sp, #5*16]   \n"
-"       str     x17, [sp, #6*16]        \n"
+"       stp     x4, x5, [sp, #-80]!     \n"
+"       stp     x7, x8, [sp, #16]       \n"
+"       stp     x9, x10, [sp, #2*16]    \n"
+"       stp     x11, x16, [sp, #3*16]   \n"
+"       str     x17, [sp, #4*16]        \n"
 "       mrs     x0, CLIDR_EL1           \n"
 "       and     w3, w0, #0x07000000     \n" // Get 2 x Level of Coherence
 "       lsr     w3, w3, #23             \n"
@@ -1774,13 +2561,11 @@ void __attribute__((used)) __invalidate_entire_dcache(void)
 "       dsb     sy                      \n" // Ensure completion of previous cache maintenance instruction
 "       b.gt    1b                      \n"
 "5:                                     \n"
-"       ldp     x2, x3, [sp, #16]       \n"
-"       ldp     x4, x5, [sp, #2*16]     \n"
-"       ldp     x7, x8, [sp, #3*16]     \n"
-"       ldp     x9, x10, [sp, #4*16]    \n"
-"       ldp     x11, x16, [sp, #5*16]   \n"
-"       ldr     x17, [sp, #6*16]        \n"
-"       ldp     x0, x1, [sp], #112      \n"
+"       ldp     x7, x8, [sp, #16]       \n"
+"       ldp     x9, x10, [sp, #2*16]    \n"
+"       ldp     x11, x16, [sp, #3*16]   \n"
+"       ldr     x17, [sp, #4*16]        \n"
+"       ldp     x4, x5, [sp], #80       \n"
 "       ret                             \n"
 "       .ltorg                          \n"
     );
@@ -1795,31 +2580,62 @@ uint32_t icache_epilogue[MAX_EPILOGUE_LENGTH];
 void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t *arm_pc)
 {
     int i;
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&pc[0]);
-    struct M68KTranslationUnit *u;
-    struct Node *n, *next;
-    extern struct List LRU;
-    extern void *jit_tlsf;
+    uint16_t opcode = cache_fetch_16((uintptr_t)&pc[0]);
     extern struct M68KState *__m68k_state;
 
-    (void)jit_tlsf;
-
     //kprintf("[LINEF] ICache flush... Opcode=%04x, Target=%08x, PC=%08x, ARM PC=%p\n", opcode, target_addr, pc, arm_pc);
     // kprintf("[LINEF] ARM insn: %08x\n", *arm_pc);
 
-    // Invalidate entire instruction cache
-    // FIXME: Could be more precise (but most of the time everything is probably flushed anyway)
-    // NOT: cache_invalidate_range does not handle length of >16 bytes
-    cache_invalidate_all(ICACHE);
-
-    for (i=0; i < MAX_EPILOGUE_LENGTH; i++)
-    {
+    /* Drop lines of the emulated instruction cache covered by the scope of CINV/CPUSH */
+    switch (opcode & 0x18) {
+        case 0x08:  /* Line */
+            cache_invalidate_range(ICACHE, target_addr & ~15, 16);
+            break;
+        case 0x10:  /* Page */
+            cache_invalidate_range(ICACHE, target_addr & ~4095, 4096);
+            break;
+        default:
+            cache_invalidate_all(ICACHE);
+            break;
+    }
+
+    /* Units built in background from the old code must not enter the cache */
+    M68K_DiscardPendingUnits();
+
+    for (i=0; i < MAX_EPILOGUE_LENGTH; i++)
+    {
         if (arm_pc[i] == 0xffffffff)
             break;
 
         icache_epilogue[i] = arm_pc[i];
     }
 
+#if EMU68_BLOCK_CHAINING
+    /*
+        Chainable exits in the copied epilogue cannot report their links back to the main
+        loop, the unit they belong to may be gone. Turn them into plain returns.
+    */
+    for (int j=0; j < i; j++)
+    {
+        if ((icache_epilogue[j] & INSN_TO_LE(0xff00001f)) == ldr64_pcrel(0, 0))
+        {
+            if (icache_epilogue[j] == ldr64_pcrel(0, INDIRECT_LINK_LITERAL))
+            {
+                for (int way=0; way < INDIRECT_WAYS; way++)
+                {
+                    int site = j + INDIRECT_SITE_OFFSET + way * INDIRECT_SITE_STRIDE;
+                    if (site < i)
+                        icache_epilogue[site] = bx_lr();
+                }
+            }
+            else if (j + CHAIN_SITE_OFFSET < i)
+                icache_epilogue[j + CHAIN_SITE_OFFSET] = bx_lr();
+
+            icache_epilogue[j] = mov64_immed_u16(0, 0, 0);
+        }
+    }
+#endif
+
     //kprintf("[LINEF] Copied %d instructions of epilogue\n", i);
     __clear_cache(&icache_epilogue[0], &icache_epilogue[i]);
 
@@ -1829,124 +2645,100 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
     switch (opcode & 0x18) {
         case 0x08:  /* Line */
             // kprintf("[LINEF] Invalidating line\n");
-            ForeachNodeSafe(&LRU, n, next)
-            {
-                u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-
-                // If highest address of unit is lower than the begin flushed area, or lowest address of unit higher than the flushed area end
-                // then skip the unit
-                if ((uintptr_t)u->mt_M68kLow > ((target_addr + 16) & ~15) || (uintptr_t)u->mt_M68kHigh < (target_addr & ~15))
-                    continue;
-
-                if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-                {
-                    // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                    // verify block checksum and eventually discard it
-                    uintptr_t e = (uintptr_t)u->mt_ARMEntryPoint;
-                    e &= 0x00ffffffffffffffULL;
-                    e |= 0xaa00000000000000ULL;
-                    u->mt_ARMEntryPoint = (void*)e;
-                }
-                else
-                {
-                    // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                }
-            }
+            M68K_InvalidateRange(target_addr & ~15, (target_addr + 16) & ~15);
             break;
         case 0x10:  /* Page */
             // kprintf("[LINEF] Invalidating page\n");
-            ForeachNodeSafe(&LRU, n, next)
-            {
-                u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-
-                // If highest address of unit is lower than the begin flushed area, or lowest address of unit higher than the flushed area end
-                // then skip the unit
-                if ((uintptr_t)u->mt_M68kLow > ((target_addr + 4096) & ~4095) || (uintptr_t)u->mt_M68kHigh < (target_addr & ~4095))
-                    continue;
-
-                // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
-
-                if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-                {
-                    // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                    // verify block checksum and eventually discard it
-                    uintptr_t e = (uintptr_t)u->mt_ARMEntryPoint;
-                    e &= 0x00ffffffffffffffULL;
-                    e |= 0xaa00000000000000ULL;
-                    u->mt_ARMEntryPoint = (void*)e;
-                }
-                else
-                {
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                }
-            }
+            M68K_InvalidateRange(target_addr & ~4095, (target_addr + 4096) & ~4095);
             break;
         case 0x18:  /* All */
             // kprintf("[LINEF] Invalidating all\n");            
             if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
             {
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+                /* Stale units verify their checksum on next entry */
+                __m68k_state->JIT_FLUSH_GEN++;
+#if EMU68_LAZY_RETUNE
+                jit_soft_flush_gen = __m68k_state->JIT_FLUSH_GEN;
+#endif
+                JITStats_Release(JS_RELEASE_SOFT_FLUSH, __m68k_state->JIT_UNIT_COUNT);
+#else
+                struct M68KTranslationUnit *u;
+                struct Node *n, *next;
+                extern struct List LRU;
+
                 if (__m68k_state->JIT_UNIT_COUNT < __m68k_state->JIT_SOFTFLUSH_THRESH)
                 {
                     ForeachNode(&LRU, n)
                     {
-                        uintptr_t uptr = ((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        uptr += __builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint);
+                        u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+                        if (M68K_IsROMUnit(u))
+                            continue;
 
                         // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
                         // verify block checksum and eventually discard it
-                        *(uint8_t *)uptr = 0xaa;
+                        M68K_PoisonUnit(u);
+                        JITStats_Release(JS_RELEASE_SOFT_FLUSH, 1);
                     }
                 }
                 else
                 {
-                    while (
+                    ForeachNodeSafe(&LRU, n, next)
+                    {
 #if EMU68_WEAK_CFLUSH_SLOW
-                            __m68k_state->JIT_UNIT_COUNT >= __m68k_state->JIT_SOFTFLUSH_THRESH &&
+                        if (__m68k_state->JIT_UNIT_COUNT < __m68k_state->JIT_SOFTFLUSH_THRESH)
+                            break;
 #endif
-                            (n = REMHEAD(&LRU)))
-                    {
                         u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+                        if (M68K_IsROMUnit(u))
+                            continue;
              
-                        REMOVE(&u->mt_HashNode);
-                        tlsf_free(jit_tlsf, u);
-                        
-                        __m68k_state->JIT_UNIT_COUNT--;
+                        M68K_FreeUnit(u);
+                        JITStats_Release(JS_RELEASE_SOFT_FLUSH, 1);
                     }
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+                    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
 #if EMU68_WEAK_CFLUSH_SLOW
                     ForeachNode(&LRU, n)
                     {
-                        uintptr_t uptr = ((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        uptr += __builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint);
+                        u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+                        if (M68K_IsROMUnit(u))
+                            continue;
 
                         // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
                         // verify block checksum and eventually discard it
-                        *(uint8_t *)uptr = 0xaa;
+                        M68K_PoisonUnit(u);
+                        JITStats_Release(JS_RELEASE_SOFT_FLUSH, 1);
                     }
 #endif
                 }
+#endif
             }
             else
             {
+#if EMU68_KEEP_ROM_UNITS
+                /* ROM units stay, chains between them and the released units must be reverted */
+                M68K_ReleaseRAMUnits(JS_RELEASE_CINV_ALL);
+#else
+                struct M68KTranslationUnit *u;
+                struct Node *n;
+                extern struct List LRU;
+
+                M68K_LockTranslator();
                 while ((n = REMHEAD(&LRU))) {
                     u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
                     // kprintf("[LINEF] Removing unit %p\n", u);                
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
+                    M68K_ReleaseUnitCode(u);
                 }
+                M68K_UnlockTranslator();
+                M68K_ResetUnitTable();
+                M68K_ResetJumpCache();
+                JITStats_Release(JS_RELEASE_CINV_ALL, __m68k_state->JIT_UNIT_COUNT);
                 __m68k_state->JIT_UNIT_COUNT = 0;
-                __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+                __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+#endif
             }
             break;
     }
@@ -1960,14 +2752,226 @@ void __attribute__((used)) __trampoline_icache_invalidate(void)
     asm volatile(".globl trampoline_icache_invalidate\ntrampoline_icache_invalidate: bl invalidate_instruction_cache\n\tbr x0");
 }
 
+/*
+    Branch part of FBcc, taken if success_condition holds on host flags. m68k_ptr points past
+    the opcode word. Ends the instruction with the branch exit marker for the translator
+*/
+static uint32_t *EMIT_FBccBranch(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint8_t success_condition)
+{
+    int8_t local_pc_off = 2;
+
+    ptr = EMIT_GetOffsetPC(ptr, &local_pc_off);
+    ptr = EMIT_ResetOffsetPC(ptr);
+
+    uint8_t reg = RA_AllocARMRegister(&ptr);
+    uint32_t *tmpptr;
+
+    intptr_t branch_target = (intptr_t)(*m68k_ptr);
+    intptr_t branch_offset = 0;
+
+    /* use 16-bit offset */
+    if ((opcode & 0x0040) == 0x0000)
+    {
+        branch_offset = (int16_t)cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
+    }
+    /* use 32-bit offset */
+    else
+    {
+        uint16_t lo16, hi16;
+        hi16 = cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
+        lo16 = cache_fetch_16((uintptr_t)&(*(*m68k_ptr)++));
+        branch_offset = lo16 | (hi16 << 16);
+    }
+
+    branch_offset += local_pc_off;
+
+    uint8_t pc_yes = RA_AllocARMRegister(&ptr);
+    uint8_t pc_no = RA_AllocARMRegister(&ptr);
+
+    if (branch_offset > 0 && branch_offset < 4096)
+        *ptr++ = add_immed(pc_yes, REG_PC, branch_offset);
+    else if (branch_offset > -4096 && branch_offset < 0)
+        *ptr++ = sub_immed(pc_yes, REG_PC, -branch_offset);
+    else if (branch_offset != 0) {
+        *ptr++ = movw_immed_u16(reg, branch_offset);
+        if ((branch_offset >> 16) & 0xffff)
+            *ptr++ = movt_immed_u16(reg, (branch_offset >> 16) & 0xffff);
+        *ptr++ = add_reg(pc_yes, REG_PC, reg, LSL, 0);
+    }
+    else { *ptr++ = mov_reg(pc_yes, REG_PC); }
+
+    branch_target += branch_offset - local_pc_off;
+
+    int16_t local_pc_off_16 = local_pc_off - 2;
+
+    /* Adjust PC accordingly */
+    if ((opcode & 0x0040) == 0x0000)
+    {
+        local_pc_off_16 += 4;
+    }
+    /* use 32-bit offset */
+    else
+    {
+        local_pc_off_16 += 6;
+    }
+
+    if (local_pc_off_16 > 0 && local_pc_off_16 < 255)
+        *ptr++ = add_immed(pc_no, REG_PC, local_pc_off_16);
+    else if (local_pc_off_16 > -256 && local_pc_off_16 < 0)
+        *ptr++ = sub_immed(pc_no, REG_PC, -local_pc_off_16);
+    else if (local_pc_off_16 != 0) {
+        *ptr++ = movw_immed_u16(reg, local_pc_off_16);
+        if ((local_pc_off_16 >> 16) & 0xffff)
+            *ptr++ = movt_immed_u16(reg, local_pc_off_16 >> 16);
+        *ptr++ = add_reg(pc_no, REG_PC, reg, LSL, 0);
+    }
+    *ptr++ = csel(REG_PC, pc_yes, pc_no, success_condition);
+    RA_FreeARMRegister(&ptr, pc_yes);
+    RA_FreeARMRegister(&ptr, pc_no);
+    tmpptr = ptr;
+#if EMU68_DEF_BRANCH_AUTO
+    if(
+        branch_target < (intptr_t)*m68k_ptr &&
+        ((intptr_t)*m68k_ptr - branch_target) < EMU68_DEF_BRANCH_AUTO_RANGE
+    )
+        *ptr++ = b_cc(success_condition, 1);
+    else
+        *ptr++ = b_cc(success_condition^1, 1);
+#else
+#if EMU68_DEF_BRANCH_TAKEN
+    *ptr++ = b_cc(success_condition, 1);
+#else
+    *ptr++ = b_cc(success_condition^1, 1);
+#endif
+#endif
+
+#if EMU68_DEF_BRANCH_AUTO
+    if(
+        branch_target < (intptr_t)*m68k_ptr &&
+        ((intptr_t)*m68k_ptr - branch_target) < EMU68_DEF_BRANCH_AUTO_RANGE
+    )
+        *m68k_ptr = (uint16_t *)branch_target;
+#else
+#if EMU68_DEF_BRANCH_TAKEN
+    *m68k_ptr = (uint16_t *)branch_target;
+#endif
+#endif
+    RA_FreeARMRegister(&ptr, reg);
+    *ptr++ = (uint32_t)(uintptr_t)tmpptr;
+    *ptr++ = 1;
+    *ptr++ = branch_target;
+    *ptr++ = INSN_TO_LE(0xfffffffe);
+
+    return ptr;
+}
+
+#if EMU68_FPU_FUSED_BRANCH
+/*
+    FBcc directly after FCMP or FTST may branch on the host flags of fcmp. After fcmp all
+    predicates but OGL and UEQ are single A64 conditions, the unordered case sets C and V.
+    Returns the condition or 0xff if the pair cannot be fused. fpsr_live is set if code on
+    either path of the branch reads the FPSR condition codes, they are computed then as well.
+*/
+static uint8_t FPU_FusedBranchCondition(uint16_t *next, int *fpsr_live)
+{
+    uint16_t opcode = cache_fetch_16((uintptr_t)&next[0]);
+    intptr_t offset;
+    uint8_t cond;
+
+#if EMU68_TRACE_CACHE
+    if (m68k_single_step)
+        return 0xff;
+#endif
+
+    if ((opcode & 0xff80) != 0xf280)
+        return 0xff;
+
+    switch (opcode & 0x0f)
+    {
+        case F_CC_EQ:   cond = A64_CC_EQ; break;
+        case F_CC_NE:   cond = A64_CC_NE; break;
+        case F_CC_OGT:  cond = A64_CC_GT; break;
+        case F_CC_OGE:  cond = A64_CC_GE; break;
+        case F_CC_OLT:  cond = A64_CC_MI; break;
+        case F_CC_OLE:  cond = A64_CC_LS; break;
+        case F_CC_UGT:  cond = A64_CC_HI; break;
+        case F_CC_UGE:  cond = A64_CC_PL; break;
+        case F_CC_ULT:  cond = A64_CC_LT; break;
+        case F_CC_ULE:  cond = A64_CC_LE; break;
+        case F_CC_OR:   cond = A64_CC_VC; break;
+        case F_CC_UN:   cond = A64_CC_VS; break;
+        default:        return 0xff;
+    }
+
+    if (opcode & 0x0040)
+        offset = (int32_t)((cache_fetch_16((uintptr_t)&next[1]) << 16) | cache_fetch_16((uintptr_t)&next[2]));
+    else
+        offset = (int16_t)cache_fetch_16((uintptr_t)&next[1]);
+
+    *fpsr_live = FPSR_Update_Needed(next + ((opcode & 0x0040) ? 3 : 2), 0) ||
+                 FPSR_Update_Needed((uint16_t *)((intptr_t)&next[1] + offset), 0);
+
+    return cond;
+}
+#endif
+
+/*
+    Condition codes of FCMP and FTST from host flags of the fcmp just emitted. m68k_ptr points
+    to the next instruction, an FBcc there is translated here as well if it can use the flags
+*/
+static uint32_t *FPU_CompareResult(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+{
+#if EMU68_FPU_FUSED_BRANCH
+    int fpsr_live = 0;
+    uint8_t cond = FPU_FusedBranchCondition(*m68k_ptr, &fpsr_live);
+
+    if (cond != 0xff)
+    {
+        uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+
+        /* Codes of older results are overwritten by the compare, and must not be computed over its flags */
+        RA_DiscardFPSRResult();
+
+        /* Only bic/orr of the flags into FPSR, host flags stay intact for the branch */
+        if (fpsr_live)
+        {
+            uint8_t fpsr = RA_ModifyFPSR(&ptr);
+            ptr = EMIT_GetFPUFlags(ptr, fpsr);
+        }
+
+        (*m68k_ptr)++;
+        *insn_consumed = 2;
+
+        return EMIT_FBccBranch(ptr, opcode, m68k_ptr, cond);
+    }
+#else
+    (void)insn_consumed;
+#endif
+
+    if (FPSR_Update_Needed(*m68k_ptr, 0))
+    {
+        /* Host flags of the compare are live, pending codes must not be computed over them */
+        RA_DiscardFPSRResult();
+
+        uint8_t fpsr = RA_ModifyFPSR(&ptr);
+        ptr = EMIT_GetFPUFlags(ptr, fpsr);
+    }
+
+    return ptr;
+}
+
 uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
     uint8_t ext_count = 1;
     (*m68k_ptr)++;
     *insn_consumed = 1;
 
+    /* FMOVEM to registers may overwrite the result the pending condition codes come from, FSAVE and FRESTORE take whole FPU state */
+    if (((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xc700) == 0xc000) || (opcode & 0xff80) == 0xf300)
+        RA_ResolveFPSR(&ptr);
+
     /* FMOVECR reg */
     if (opcode == 0xf200 && (opcode2 & 0xfc00) == 0x5c00)
     {
@@ -1999,12 +3003,25 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fmov_0(fp_dst);
         }
         else {
-            u.u64 = (uintptr_t)constants;
-            *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
-            *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
-            *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
-            *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
-            *ptr++ = fldd_pimm(fp_dst, 0, offset);
+            uint8_t cached;
+
+            u.d = constants[offset];
+            cached = RA_GetCachedFPUConst(&ptr, u.u64);
+
+            if (cached != 0xff) {
+                *ptr++ = fcpyd(fp_dst, cached);
+            }
+            else {
+                uint64_t value = u.u64;
+
+                u.u64 = (uintptr_t)constants;
+                *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
+                *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
+                *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
+                *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
+                *ptr++ = fldd_pimm(fp_dst, 0, offset);
+                RA_SetCachedFPUConst(&ptr, fp_dst, value);
+            }
         }
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
@@ -2064,12 +3081,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FADD */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa07f) == 0x0022 || (opcode2 & 0xa07b) == 0x0062))
@@ -2106,12 +3118,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FNOP as well as FBF.W to *any* target */
     else if (opcode == 0xf280)
@@ -2138,7 +3145,6 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         uint8_t predicate = opcode & 0x3f;
         uint8_t success_condition = 0;
         uint8_t tmp_cc = 0xff;
-        uint32_t *tmpptr;
 
         /* Test predicate with masked signalling bit, operations are the same */
         switch (predicate & 0x0f)
@@ -2243,107 +3249,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         }
         RA_FreeARMRegister(&ptr, tmp_cc);
 
-        int8_t local_pc_off = 2;
-
-        ptr = EMIT_GetOffsetPC(ptr, &local_pc_off);
-        ptr = EMIT_ResetOffsetPC(ptr);
-
-        uint8_t reg = RA_AllocARMRegister(&ptr);
-
-        intptr_t branch_target = (intptr_t)(*m68k_ptr);
-        intptr_t branch_offset = 0;
-
-        /* use 16-bit offset */
-        if ((opcode & 0x0040) == 0x0000)
-        {
-            branch_offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
-        }
-        /* use 32-bit offset */
-        else
-        {
-            uint16_t lo16, hi16;
-            hi16 = cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&(*(*m68k_ptr)++));
-            branch_offset = lo16 | (hi16 << 16);
-        }
-
-        branch_offset += local_pc_off;
-
-        uint8_t pc_yes = RA_AllocARMRegister(&ptr);
-        uint8_t pc_no = RA_AllocARMRegister(&ptr);
-
-        if (branch_offset > 0 && branch_offset < 4096)
-            *ptr++ = add_immed(pc_yes, REG_PC, branch_offset);
-        else if (branch_offset > -4096 && branch_offset < 0)
-            *ptr++ = sub_immed(pc_yes, REG_PC, -branch_offset);
-        else if (branch_offset != 0) {
-            *ptr++ = movw_immed_u16(reg, branch_offset);
-            if ((branch_offset >> 16) & 0xffff)
-                *ptr++ = movt_immed_u16(reg, (branch_offset >> 16) & 0xffff);
-            *ptr++ = add_reg(pc_yes, REG_PC, reg, LSL, 0);
-        }
-        else { *ptr++ = mov_reg(pc_yes, REG_PC); }
-
-        branch_target += branch_offset - local_pc_off;
-
-        int16_t local_pc_off_16 = local_pc_off - 2;
-
-        /* Adjust PC accordingly */
-        if ((opcode & 0x0040) == 0x0000)
-        {
-            local_pc_off_16 += 4;
-        }
-        /* use 32-bit offset */
-        else
-        {
-            local_pc_off_16 += 6;
-        }
-
-        if (local_pc_off_16 > 0 && local_pc_off_16 < 255)
-            *ptr++ = add_immed(pc_no, REG_PC, local_pc_off_16);
-        else if (local_pc_off_16 > -256 && local_pc_off_16 < 0)
-            *ptr++ = sub_immed(pc_no, REG_PC, -local_pc_off_16);
-        else if (local_pc_off_16 != 0) {
-            *ptr++ = movw_immed_u16(reg, local_pc_off_16);
-            if ((local_pc_off_16 >> 16) & 0xffff)
-                *ptr++ = movt_immed_u16(reg, local_pc_off_16 >> 16);
-            *ptr++ = add_reg(pc_no, REG_PC, reg, LSL, 0);
-        }
-        *ptr++ = csel(REG_PC, pc_yes, pc_no, success_condition);
-        RA_FreeARMRegister(&ptr, pc_yes);
-        RA_FreeARMRegister(&ptr, pc_no);
-        tmpptr = ptr;
-#if EMU68_DEF_BRANCH_AUTO
-        if(
-            branch_target < (intptr_t)*m68k_ptr &&
-            ((intptr_t)*m68k_ptr - branch_target) < EMU68_DEF_BRANCH_AUTO_RANGE
-        )
-            *ptr++ = b_cc(success_condition, 1);
-        else
-            *ptr++ = b_cc(success_condition^1, 1);
-#else
-#if EMU68_DEF_BRANCH_TAKEN
-        *ptr++ = b_cc(success_condition, 1);
-#else
-        *ptr++ = b_cc(success_condition^1, 1);
-#endif
-#endif
-
-#if EMU68_DEF_BRANCH_AUTO
-        if(
-            branch_target < (intptr_t)*m68k_ptr &&
-            ((intptr_t)*m68k_ptr - branch_target) < EMU68_DEF_BRANCH_AUTO_RANGE
-        )
-            *m68k_ptr = (uint16_t *)branch_target;
-#else
-#if EMU68_DEF_BRANCH_TAKEN
-        *m68k_ptr = (uint16_t *)branch_target;
-#endif
-#endif
-        RA_FreeARMRegister(&ptr, reg);
-        *ptr++ = (uint32_t)(uintptr_t)tmpptr;
-        *ptr++ = 1;
-        *ptr++ = branch_target;
+        ptr = EMIT_FBccBranch(ptr, opcode, m68k_ptr, success_condition);
         *ptr++ = INSN_TO_LE(0xfffffffe);
     }
     /* FCMP */
@@ -2368,11 +3274,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
-        if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+        ptr = FPU_CompareResult(ptr, m68k_ptr, insn_consumed);
     }
     /* FDIV */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa07f) == 0x0020 || (opcode2 & 0xa07b) == 0x0060))
@@ -2398,12 +3300,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FSGLDIV */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa07f) == 0x0024))
@@ -2431,12 +3328,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FSINCOS */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa078) == 0x0030))
@@ -2465,7 +3357,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+#if EMU68_FPU_FAST_MATH
+        uint32_t *skip;
+        ptr = FPU_FastKernelCall(ptr, FastSinCos, &skip);
+#endif
+
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -2474,23 +3371,21 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = blr(0);
 
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+#if EMU68_FPU_FAST_MATH
+        ptr = FPU_FastKernelDone(ptr, skip);
+#endif
+
         *ptr++ = fcpyd(fp_dst_cos, 1);
         *ptr++ = fcpyd(fp_dst_sin, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
-
         RA_FreeFPURegister(&ptr, fp_src);
 
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst_sin);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst_sin);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -2516,12 +3411,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FGETEXP */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x001e)
@@ -2534,29 +3424,56 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         uint8_t fp_src = 0xff;
         uint8_t fp_dst = (opcode2 >> 7) & 7;
         uint8_t tmp = RA_AllocARMRegister(&ptr);
+        uint8_t exp = RA_AllocARMRegister(&ptr);
+        uint32_t *small, *special, *convert, *done, *done2, *zero;
 
         ptr = FPU_FetchData(ptr, m68k_ptr, &fp_src, opcode, opcode2, &ext_count, 0);
         fp_dst = RA_MapFPURegisterForWrite(&ptr, fp_dst);
 
         *ptr++ = mov_simd_to_reg(tmp, fp_src, TS_D, 0);
-        *ptr++ = ror64(tmp, tmp, 52);
-        *ptr++ = and_immed(tmp, tmp, 11, 0);
-        *ptr++ = sub_immed(tmp, tmp, 0x3ff);
-        *ptr++ = scvtf_32toD(fp_dst, tmp);
+        *ptr++ = ubfx64(exp, tmp, 52, 11);
+        small = ptr;
+        *ptr++ = 0;
+        *ptr++ = cmp_immed(exp, 0x7ff);
+        special = ptr;
+        *ptr++ = 0;
+        *ptr++ = sub_immed(exp, exp, 0x3ff);
+        convert = ptr;
+        *ptr++ = scvtf_32toD(fp_dst, exp);
+        done = ptr;
+        *ptr++ = 0;
+
+        /* Denormals have the exponent of their leading one, the exponent of zero is zero */
+        *small = cbz(exp, ptr - small);
+        *ptr++ = lsl64(tmp, tmp, 12);
+        zero = ptr;
+        *ptr++ = 0;
+        *ptr++ = clz64(tmp, tmp);
+        *ptr++ = add_immed(tmp, tmp, 0x3ff);
+        *ptr++ = neg_reg(exp, tmp, LSL, 0);
+        *ptr = b(convert - ptr);
+        ptr++;
+        *zero = cbz_64(tmp, ptr - zero);
+        *ptr++ = fcpyd(fp_dst, fp_src);
+        done2 = ptr;
+        *ptr++ = 0;
+
+        /* Infinity gives NaN, NaN stays */
+        *special = b_cc(A64_CC_EQ, ptr - special);
+        *ptr++ = fsubd(fp_dst, fp_src, fp_src);
+
+        *done = b(ptr - done);
+        *done2 = b(ptr - done2);
 
         RA_FreeFPURegister(&ptr, fp_src);
         RA_FreeARMRegister(&ptr, tmp);
+        RA_FreeARMRegister(&ptr, exp);
 
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FGETMAN */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x001f)
@@ -2569,28 +3486,60 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         uint8_t fp_src = 0xff;
         uint8_t fp_dst = (opcode2 >> 7) & 7;
         uint8_t tmp = RA_AllocARMRegister(&ptr);
+        uint8_t man = RA_AllocARMRegister(&ptr);
+        uint8_t shift = RA_AllocARMRegister(&ptr);
+        uint32_t *small, *special, *normal, *done, *done2, *zero;
 
         ptr = FPU_FetchData(ptr, m68k_ptr, &fp_src, opcode, opcode2, &ext_count, 0);
         fp_dst = RA_MapFPURegisterForWrite(&ptr, fp_dst);
 
         *ptr++ = mov_simd_to_reg(tmp, fp_src, TS_D, 0);
+        *ptr++ = ubfx64(man, tmp, 52, 11);
+        small = ptr;
+        *ptr++ = 0;
+        *ptr++ = cmp_immed(man, 0x7ff);
+        special = ptr;
+        *ptr++ = 0;
+        normal = ptr;
         *ptr++ = bic64_immed(tmp, tmp, 11, 12, 1);
         *ptr++ = orr64_immed(tmp, tmp, 10, 12, 1);
         *ptr++ = mov_reg_to_simd(fp_dst, TS_D, 0, tmp);
+        done = ptr;
+        *ptr++ = 0;
+
+        /* Denormals are normalized first, zero stays */
+        *small = cbz(man, ptr - small);
+        *ptr++ = lsl64(man, tmp, 12);
+        zero = ptr;
+        *ptr++ = 0;
+        *ptr++ = clz64(shift, man);
+        *ptr++ = add_immed(shift, shift, 1);
+        *ptr++ = lslv64(man, man, shift);
+        *ptr++ = bfxil64(tmp, man, 12, 52);
+        *ptr = b(normal - ptr);
+        ptr++;
+        *zero = cbz_64(man, ptr - zero);
+        *ptr++ = fcpyd(fp_dst, fp_src);
+        done2 = ptr;
+        *ptr++ = 0;
+
+        /* Infinity gives NaN, NaN stays */
+        *special = b_cc(A64_CC_EQ, ptr - special);
+        *ptr++ = fsubd(fp_dst, fp_src, fp_src);
+
+        *done = b(ptr - done);
+        *done2 = b(ptr - done2);
 
         RA_FreeFPURegister(&ptr, fp_src);
         RA_FreeARMRegister(&ptr, tmp);
+        RA_FreeARMRegister(&ptr, man);
+        RA_FreeARMRegister(&ptr, shift);
 
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FINTRZ */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x0003)
@@ -2614,12 +3563,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FSCALE */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x0026)
@@ -2632,49 +3576,104 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         uint8_t int_src = 0xff;
         uint8_t fp_src = 0xff;
         uint8_t fp_dst = (opcode2 >> 7) & 7;
+        uint8_t n = RA_AllocARMRegister(&ptr);
+        uint8_t tmp = RA_AllocARMRegister(&ptr);
+        uint8_t fp_tmp = RA_AllocFPURegister(&ptr);
+        uint32_t *nan = NULL;
+        uint32_t *wide, *done;
 
         switch ((opcode2 >> 10) & 7)
         {
             case 0:
-                fp_src = RA_AllocFPURegister(&ptr);
                 ptr = EMIT_LoadFromEffectiveAddress(ptr, 4, &int_src, opcode & 0x3f, *m68k_ptr, &ext_count, 0, NULL);
                 break;
             case 4:
-                fp_src = RA_AllocFPURegister(&ptr);
                 ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 2, &int_src, opcode & 0x3f, *m68k_ptr, &ext_count, 0, NULL);
                 break;
             case 6:
-                fp_src = RA_AllocFPURegister(&ptr);
                 ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 1, &int_src, opcode & 0x3f, *m68k_ptr, &ext_count, 0, NULL);
                 break;
             default:
-                int_src = RA_AllocARMRegister(&ptr);
                 ptr = FPU_FetchData(ptr, m68k_ptr, &fp_src, opcode, opcode2, &ext_count, 0);
-                *ptr++ = fcvtzs_Dto32(int_src, fp_src);
                 break;
         }
-      
+
+        /* The source may be a data register, the scale is worked out in a copy */
+        if (int_src != 0xff)
+            *ptr++ = mov_reg(n, int_src);
+        else
+            *ptr++ = fcvtzs_Dto32(n, fp_src);
+
         fp_dst = RA_MapFPURegisterForWrite(&ptr, fp_dst);
 
-        *ptr++ = add_immed(int_src, int_src, 0x3ff);
-        *ptr++ = lsl64(int_src, int_src, 52);
-        *ptr++ = bic64_immed(int_src, int_src, 1, 1, 1);
-        *ptr++ = mov_reg_to_simd(fp_src, TS_D, 0, int_src);
-        *ptr++ = fmuld(fp_dst, fp_dst, fp_src);
+        if (int_src == 0xff)
+        {
+            *ptr++ = fcmpd(fp_src, fp_src);
+            nan = ptr;
+            *ptr++ = 0;
+        }
+
+        /* Scale with a normalized power of two if it exists, that is for -1022 <= n <= 1023 */
+        *ptr++ = add_immed(tmp, n, 1022);
+        *ptr++ = cmp_immed(tmp, 2045);
+        wide = ptr;
+        *ptr++ = 0;
+        *ptr++ = add_immed(tmp, tmp, 1);
+        *ptr++ = lsl64(tmp, tmp, 52);
+        *ptr++ = mov_reg_to_simd(fp_tmp, TS_D, 0, tmp);
+        *ptr++ = fmuld(fp_dst, fp_dst, fp_tmp);
+        done = ptr;
+        *ptr++ = 0;
+
+        /*
+            Otherwise n is clamped to +-3000, which is over and underflow for every double, and
+            split into multiplications by 2^p, 2^p and 2^(n-2p) with p = n/3
+        */
+        *wide = b_cc(A64_CC_HI, ptr - wide);
+        *ptr++ = mov_immed_u16(tmp, 3000, 0);
+        *ptr++ = cmp_reg(n, tmp, LSL, 0);
+        *ptr++ = csel(n, tmp, n, A64_CC_GT);
+        *ptr++ = movn_immed_u16(tmp, 2999, 0);
+        *ptr++ = cmp_reg(n, tmp, LSL, 0);
+        *ptr++ = csel(n, tmp, n, A64_CC_LT);
+        *ptr++ = mov_immed_u16(tmp, 3, 0);
+        *ptr++ = sdiv(tmp, n, tmp);
+        *ptr++ = sub_reg(n, n, tmp, LSL, 1);
+        *ptr++ = add_immed(tmp, tmp, 0x3ff);
+        *ptr++ = lsl64(tmp, tmp, 52);
+        *ptr++ = mov_reg_to_simd(fp_tmp, TS_D, 0, tmp);
+        *ptr++ = fmuld(fp_dst, fp_dst, fp_tmp);
+        *ptr++ = fmuld(fp_dst, fp_dst, fp_tmp);
+        *ptr++ = add_immed(n, n, 0x3ff);
+        *ptr++ = lsl64(n, n, 52);
+        *ptr++ = mov_reg_to_simd(fp_tmp, TS_D, 0, n);
+        *ptr++ = fmuld(fp_dst, fp_dst, fp_tmp);
+
+        if (nan)
+        {
+            uint32_t *skip = ptr;
+            *ptr++ = 0;
+
+            /* NaN scale gives NaN */
+            *nan = b_cc(A64_CC_VS, ptr - nan);
+            *ptr++ = faddd(fp_dst, fp_dst, fp_src);
+            *skip = b(ptr - skip);
+        }
+
+        *done = b(ptr - done);
 
-        RA_FreeARMRegister(&ptr, int_src);
+        if (int_src != 0xff)
+            RA_FreeARMRegister(&ptr, int_src);
+        RA_FreeARMRegister(&ptr, n);
+        RA_FreeARMRegister(&ptr, tmp);
         RA_FreeFPURegister(&ptr, fp_src);
+        RA_FreeFPURegister(&ptr, fp_tmp);
 
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FLOGN */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x0014)
@@ -2701,7 +3700,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+#if EMU68_FPU_FAST_MATH
+        uint32_t *skip;
+        ptr = FPU_FastKernelCall(ptr, FastLog, &skip);
+#endif
+
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -2710,9 +3714,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = blr(0);
 
-        *ptr++ = fcpyd(fp_dst, 0);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+#if EMU68_FPU_FAST_MATH
+        ptr = FPU_FastKernelDone(ptr, skip);
+#endif
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        *ptr++ = fcpyd(fp_dst, 0);
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -2720,12 +3727,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -2744,45 +3746,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         ptr = FPU_FetchData(ptr, m68k_ptr, &fp_src, opcode, opcode2, &ext_count, 0);
         fp_dst = RA_MapFPURegisterForWrite(&ptr, fp_dst);
 
-        *ptr++ = fcpyd(0, fp_dst);
-
-        union {
-            uint64_t u64;
-            uint16_t u16[4];
-        } u;
-
-        u.u64 = (uintptr_t)remquo;
-
-        if (fp_src != 1) {
-            *ptr++ = fcpyd(1, fp_src);
-        }
-
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
-
-        *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
-        *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
-        *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
-        *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
-
-        *ptr++ = blr(0);
-
-        // Clear V0
-        *ptr++ = fmov_0(0);
-        // The result of remquo is not in FPU regiser, but rather integer. Put it into destination now
-        *ptr++ = mov_reg_to_simd(fp_dst, TS_D, 0, 0);
-        // Put quotient byte to the v0 first, before restoring register frame
-        *ptr++ = mov_reg_to_simd(0, TS_B, 2, 1);
-
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
-
-        uint8_t fpsr = RA_ModifyFPSR(&ptr);
-        *ptr++ = bic_immed(fpsr, fpsr, 8, 16);
-
-        // Once frame is resotred, get quotient byte and put it into FPSR
-        uint8_t tmp_quot = RA_AllocARMRegister(&ptr);
-        *ptr++ = mov_simd_to_reg(tmp_quot, 0, TS_S, 0);
-        *ptr++ = orr_reg(fpsr, fpsr, tmp_quot, LSL, 0);
-        RA_FreeARMRegister(&ptr, tmp_quot);
+        ptr = FPU_Remainder(ptr, fp_dst, fp_src, 1);
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -2791,6 +3755,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
         {
+            uint8_t fpsr = RA_ModifyFPSR(&ptr);
             *ptr++ = fcmpzd(fp_dst);
             ptr = EMIT_GetFPUFlags(ptr, fpsr);
         }
@@ -2805,46 +3770,23 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             shown = 1;
         }
 
-        uint8_t fp_src = 0xff;
+        uint8_t fp_src = 1;
         uint8_t fp_dst = (opcode2 >> 7) & 7;
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
 
         ptr = FPU_FetchData(ptr, m68k_ptr, &fp_src, opcode, opcode2, &ext_count, 0);
         fp_dst = RA_MapFPURegisterForWrite(&ptr, fp_dst);
 
-        /* Need to check if this method is working... */
-        /* Compute FPn / Source */
-        *ptr++ = fdivd(0, fp_dst, fp_src);
-        /* Round to zero the result -> N */
-        *ptr++ = frint64z(0, 0);
-        /* And store for later */
-        *ptr++ = fcvtzs_Dto64(tmp, 0);
-        /* Get Source * N */
-        *ptr++ = fmuld(1, 0, fp_src);
-        /* Calculate reminder */
-        *ptr++ = fsubd(fp_dst, fp_dst, 1);
-        /* Test sign of result */
-        *ptr++ = fcmpzd(0);
-        *ptr++ = bic_immed(1, 0, 25, 25);
-        *ptr++ = orr_immed(0, 0, 25, 25);
-        *ptr++ = csel(0, 1, 0, A64_CC_PL);
-
-        uint8_t fpsr = RA_ModifyFPSR(&ptr);
-        *ptr++ = bfi(fpsr, 0, 16, 8);
+        ptr = FPU_Remainder(ptr, fp_dst, fp_src, 0);
 
         RA_FreeFPURegister(&ptr, fp_src);
-        RA_FreeARMRegister(&ptr, tmp);
 
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
+            RA_SetFPSRResult(&ptr, fp_dst);
 
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+        *ptr++ = INSN_TO_LE(0xfffffff0);
     }
     /* FLOGNP1 */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x0006)
@@ -2871,7 +3813,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -2882,7 +3824,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -2890,12 +3832,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -2924,7 +3861,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -2935,7 +3872,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -2943,12 +3880,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -2977,7 +3909,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -2988,7 +3920,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -2996,12 +3928,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3030,7 +3957,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+#if EMU68_FPU_FAST_MATH
+        uint32_t *skip;
+        ptr = FPU_FastKernelCall(ptr, FastExp, &skip);
+#endif
+
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3039,9 +3971,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = blr(0);
 
-        *ptr++ = fcpyd(fp_dst, 0);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+#if EMU68_FPU_FAST_MATH
+        ptr = FPU_FastKernelDone(ptr, skip);
+#endif
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        *ptr++ = fcpyd(fp_dst, 0);
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3049,12 +3984,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3083,7 +4013,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3094,7 +4024,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3102,12 +4032,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3136,7 +4061,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3147,7 +4072,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3155,12 +4080,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3189,7 +4109,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3200,7 +4120,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3208,12 +4128,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3242,7 +4157,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3253,7 +4168,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3261,12 +4176,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3295,7 +4205,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3306,7 +4216,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3314,12 +4224,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3348,7 +4253,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3359,7 +4264,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3367,12 +4272,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3401,7 +4301,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3412,7 +4312,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3420,12 +4320,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3454,7 +4349,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3465,7 +4360,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3473,12 +4368,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3507,7 +4397,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3518,7 +4408,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3526,12 +4416,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3560,7 +4445,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
         
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3571,7 +4456,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3579,12 +4464,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3613,7 +4493,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -3624,7 +4504,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = fcpyd(fp_dst, 0);
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -3632,12 +4512,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -3686,12 +4561,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FMOVE to MEM */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xe07f) == 0x6000 || (opcode2 & 0xfc00) == 0x6c00 || (opcode2 & 0xfc0f) == 0x7c00))
@@ -3761,6 +4631,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         {
             int regnum = 0;
             int offset = 0;
+            int wb = 0;
 
             if ((opcode & 0x38) == 0x20 || (opcode & 0x38) == 0x18) {
                 ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &dst, opcode & 0x3f, *m68k_ptr, &ext_count, 0, NULL);
@@ -3773,24 +4644,22 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             if (opcode2 & 0x0800) regnum++;
             if (opcode2 & 0x1000) regnum++;
 
-            // In predecrement mode reserve whole space first
-            if ((opcode & 0x38) == 0x20)
-            {
-                *ptr++ = sub_immed(dst, dst, 4 * regnum);
-            }
+            // In predecrement and postincrement modes the first store writes the base back
+            if ((opcode & 0x38) == 0x20 || (opcode & 0x38) == 0x18)
+                wb = 4 * regnum;
 
             if (opcode2 & 0x1000)
             {
                 reg = RA_GetFPCR(&ptr);
                 
-                *ptr++ = str_offset(dst, reg, offset);
+                ptr = FPU_ControlAccess(ptr, 0, dst, reg, offset, (opcode >> 3) & 7, &wb);
                 offset += 4;
             }
 
             if (opcode2 & 0x0800)
             {
                 reg = RA_GetFPSR(&ptr);
-                *ptr++ = str_offset(dst, reg, offset);
+                ptr = FPU_ControlAccess(ptr, 0, dst, reg, offset, (opcode >> 3) & 7, &wb);
                 offset += 4;
             }
 
@@ -3804,17 +4673,11 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
                 else {
                     *ptr++ = mov_simd_to_reg(reg, 29, TS_S, 1);
                 }
-                *ptr++ = str_offset(dst, reg, offset);
+                ptr = FPU_ControlAccess(ptr, 0, dst, reg, offset, (opcode >> 3) & 7, &wb);
                 RA_FreeARMRegister(&ptr, reg);
                 reg = 0xff;
             }
 
-            // In postincrement mode adjust the value now
-            if ((opcode & 0x38) == 0x18)
-            {
-                *ptr++ = add_immed(dst, dst, 4 * regnum);
-            }
-
             RA_FreeARMRegister(&ptr, dst);
         }
 
@@ -3842,21 +4705,18 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
                 case 0x1000:    /* FPCR */
                     tmp = RA_AllocARMRegister(&ptr);
                     reg = RA_ModifyFPCR(&ptr);
-                    *ptr++ = mov_reg(reg, src);
                     {
                         uint8_t round = RA_AllocARMRegister(&ptr);
 
-                        *ptr++ = get_fpcr(tmp);
-                        *ptr++ = ubfx(round, reg, 4, 2);
-                        *ptr++ = neg_reg(round, round, LSL, 0);
-                        *ptr++ = add_immed(round, round, 4);
-                        *ptr++ = bfi(tmp, round, 22, 2);
-                        *ptr++ = set_fpcr(tmp);
+                        *ptr++ = eor_reg(round, reg, src, LSL, 0);
+                        *ptr++ = mov_reg(reg, src);
+                        ptr = FPU_UpdateRounding(ptr, reg, round, tmp);
 
                         RA_FreeARMRegister(&ptr, round);
                     }
                     break;
                 case 0x0800:    /* FPSR */
+                    RA_DiscardFPSRResult();
                     reg = RA_ModifyFPSR(&ptr);
                     *ptr++ = mov_reg(reg, src);
                     break;
@@ -3880,6 +4740,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             tmp = RA_AllocARMRegister(&ptr);
             int regnum = 0;
             int offset = 0;
+            int wb = 0;
 
             if ((opcode & 0x38) == 0x20 || (opcode & 0x38) == 0x18) {
                 ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &src, opcode & 0x3f, *m68k_ptr, &ext_count, 0, NULL);
@@ -3898,26 +4759,19 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
                 ext_count += 2*regnum;
             }
 
-            // In predecrement mode reserve whole space first
-            if ((opcode & 0x38) == 0x20)
-            {
-                *ptr++ = sub_immed(src, src, 4 * regnum);
-            }
+            // In predecrement and postincrement modes the first load writes the base back
+            if ((opcode & 0x38) == 0x20 || (opcode & 0x38) == 0x18)
+                wb = 4 * regnum;
 
             if (opcode2 & 0x1000)
             {
                 uint8_t round = RA_AllocARMRegister(&ptr);
                 reg = RA_ModifyFPCR(&ptr);
                 
-                *ptr++ = ldr_offset(src, tmp, offset);
+                ptr = FPU_ControlAccess(ptr, 1, src, tmp, offset, (opcode >> 3) & 7, &wb);
+                *ptr++ = eor_reg(round, reg, tmp, LSL, 0);
                 *ptr++ = mov_reg(reg, tmp);
-
-                *ptr++ = get_fpcr(tmp);
-                *ptr++ = ubfx(round, reg, 4, 2);
-                *ptr++ = neg_reg(round, round, LSL, 0);
-                *ptr++ = add_immed(round, round, 4);
-                *ptr++ = bfi(tmp, round, 22, 2);
-                *ptr++ = set_fpcr(tmp);
+                ptr = FPU_UpdateRounding(ptr, reg, round, tmp);
 
                 RA_FreeARMRegister(&ptr, round);
 
@@ -3926,8 +4780,9 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
             if (opcode2 & 0x0800)
             {
+                RA_DiscardFPSRResult();
                 reg = RA_ModifyFPSR(&ptr);
-                *ptr++ = ldr_offset(src, tmp, offset);
+                ptr = FPU_ControlAccess(ptr, 1, src, tmp, offset, (opcode >> 3) & 7, &wb);
                 *ptr++ = mov_reg(reg, tmp);
                 offset += 4;
             }
@@ -3935,15 +4790,9 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             if (opcode2 & 0x0400)
             {
                 val_FPIAR = 0xffffffff;
-                *ptr++ = ldr_offset(src, tmp, offset);
+                ptr = FPU_ControlAccess(ptr, 1, src, tmp, offset, (opcode >> 3) & 7, &wb);
                 *ptr++ = mov_reg_to_simd(29, TS_S, 1, tmp);
             }
-
-            // In postincrement mode adjust the value now
-            if ((opcode & 0x38) == 0x18)
-            {
-                *ptr++ = add_immed(src, src, 4 * regnum);
-            }
         }
 
         RA_FreeARMRegister(&ptr, src);
@@ -3981,49 +4830,31 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
                         size++;
                 *ptr++ = sub_immed(base_reg, base_reg, 12*size);
 
-                ptr = get_Save96(ptr);
-                *ptr++ = str64_offset_preindex(31, 30, -16);
-
                 for (int i=0; i < 8; i++) {
                     if ((opcode2 & (1 << i)) != 0) {
                         uint8_t fp_reg = RA_MapFPURegister(&ptr, i);
-                        //*ptr++ = sub_immed(base_reg, base_reg, 12);
 
-                        *ptr++ = add_immed(1, base_reg, 12*cnt);
-                        *ptr++ = mov_simd_to_reg(0, fp_reg, TS_D, 0);
-                        *ptr++ = blr(reg_Save96);
-                        //ptr = EMIT_Store96bitFP(ptr, fp_reg, base_reg, 12*cnt++);
-                        //*ptr++ = fstd(fp_reg, base_reg, 12*cnt++);
+                        ptr = EMIT_Store96bitFP(ptr, fp_reg, base_reg, 12*cnt);
 
                         cnt++;
                         RA_FreeFPURegister(&ptr, fp_reg);
                     }
                 }
-                *ptr++ = ldr64_offset_postindex(31, 30, 16);
                 RA_SetDirtyM68kRegister(&ptr, 8 + (opcode & 7));
             } else if (mode == 3) {
                 kprintf("[JIT] Unsupported FMOVEM operation (REG to MEM postindex)\n");
             } else {
-                ptr = get_Save96(ptr);
-                *ptr++ = str64_offset_preindex(31, 30, -16);
-
                 int cnt = 0;
                 for (int i=0; i < 8; i++) {
                     if ((opcode2 & (0x80 >> i)) != 0) {
                         uint8_t fp_reg = RA_MapFPURegister(&ptr, i);
 
-                        *ptr++ = add_immed(1, base_reg, 12*cnt);
-                        *ptr++ = mov_simd_to_reg(0, fp_reg, TS_D, 0);
-                        *ptr++ = blr(reg_Save96);
+                        ptr = EMIT_Store96bitFP(ptr, fp_reg, base_reg, 12*cnt);
 
-                        //ptr = EMIT_Store96bitFP(ptr, fp_reg, base_reg, 12*cnt);
-                        //*ptr++ = fstd(fp_reg, base_reg, cnt*12);
                         cnt++;
                         RA_FreeFPURegister(&ptr, fp_reg);
                     }
                 }
-
-                *ptr++ = ldr64_offset_postindex(31, 30, 16);
             }
         } else { /* memory to FPn */
             uint8_t mode = (opcode & 0x0038) >> 3;
@@ -4035,52 +4866,33 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
             /* Post index? Note - dynamic mode not supported yet! using double mode instead of extended! */
             if (mode == 3) {
-                ptr = get_Load96(ptr);
-                *ptr++ = str64_offset_preindex(31, 30, -16);
-
                 int cnt = 0;
                 for (int i=0; i < 8; i++) {
                     if ((opcode2 & (0x80 >> i)) != 0) {
                         uint8_t fp_reg = RA_MapFPURegisterForWrite(&ptr, i);
 
-                        *ptr++ = add_immed(1, base_reg, 12*cnt);
-                        *ptr++ = blr(reg_Load96);
-                        *ptr++ = mov_reg_to_simd(fp_reg, TS_D, 0, 0);
+                        ptr = EMIT_Load96bitFP(ptr, fp_reg, base_reg, 12*cnt);
 
-                        //ptr = EMIT_Load96bitFP(ptr, fp_reg, base_reg, 12*cnt++);
-                        //*ptr++ = fldd(fp_reg, base_reg, 12*cnt++);
-                        //*ptr++ = add_immed(base_reg, base_reg, 12);
                         RA_FreeFPURegister(&ptr, fp_reg);
                         cnt++;
                     }
                 }
 
-                *ptr++ = ldr64_offset_postindex(31, 30, 16);
-
                 *ptr++ = add_immed(base_reg, base_reg, 12*cnt);
                 RA_SetDirtyM68kRegister(&ptr, 8 + (opcode & 7));
             } else if (mode == 4) {
                 kprintf("[JIT] Unsupported FMOVEM operation (REG to MEM preindex)\n");
             } else {
-                ptr = get_Load96(ptr);
-                *ptr++ = str64_offset_preindex(31, 30, -16);
-
                 int cnt = 0;
                 for (int i=0; i < 8; i++) {
                     if ((opcode2 & (0x80 >> i)) != 0) {
                         uint8_t fp_reg = RA_MapFPURegisterForWrite(&ptr, i);
 
-                        *ptr++ = add_immed(1, base_reg, 12*cnt);
-                        *ptr++ = blr(reg_Load96);
-                        *ptr++ = mov_reg_to_simd(fp_reg, TS_D, 0, 0);
-                        //ptr = EMIT_Load96bitFP(ptr, fp_reg, base_reg, 12*cnt);
-                        //*ptr++ = fldd(fp_reg, base_reg, cnt*12);
+                        ptr = EMIT_Load96bitFP(ptr, fp_reg, base_reg, 12*cnt);
                         cnt++;
                         RA_FreeFPURegister(&ptr, fp_reg);
                     }
                 }
-
-                *ptr++ = ldr64_offset_postindex(31, 30, 16);
             }
         }
 
@@ -4111,11 +4923,38 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (void)precision;
 
         ptr = FPU_FetchData(ptr, m68k_ptr, &fp_src, opcode, opcode2, &ext_count, 0);
+
+        uint8_t sub = 0;
+#if EMU68_FPU_CONTRACT
+        uint8_t fp_acc = FPU_ContractTarget(*m68k_ptr + ext_count, fp_dst, &sub);
+#else
+        uint8_t fp_acc = 0xff;
+#endif
+
         fp_dst = RA_MapFPURegister(&ptr, fp_dst);
 
-        *ptr++ = fmuld(fp_dst, fp_dst, fp_src);
+        if (fp_acc != 0xff)
+        {
+            /* Following FADD/FSUB consumed here, the product itself is never stored */
+            fp_acc = RA_MapFPURegister(&ptr, fp_acc);
 
-        RA_SetDirtyFPURegister(&ptr, fp_dst);
+            if (sub)
+                *ptr++ = fmsubd(fp_acc, fp_dst, fp_src, fp_acc);
+            else
+                *ptr++ = fmaddd(fp_acc, fp_dst, fp_src, fp_acc);
+
+            RA_SetDirtyFPURegister(&ptr, fp_acc);
+
+            fp_dst = fp_acc;
+            ext_count += 2;
+            *insn_consumed = 2;
+        }
+        else
+        {
+            *ptr++ = fmuld(fp_dst, fp_dst, fp_src);
+
+            RA_SetDirtyFPURegister(&ptr, fp_dst);
+        }
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -4123,12 +4962,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FSGLMUL */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa07f) == 0x0027))
@@ -4156,12 +4990,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FNEG */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa07f) == 0x001a || (opcode2 & 0xa07b) == 0x005a))
@@ -4195,12 +5024,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FTST */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x003a)
@@ -4221,11 +5045,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         ptr = EMIT_AdvancePC(ptr, 2 * (ext_count + 1));
         (*m68k_ptr) += ext_count;
 
-        if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+        ptr = FPU_CompareResult(ptr, m68k_ptr, insn_consumed);
     }
     /* FScc */
     else if ((opcode & 0xffc0) == 0xf240 && (opcode2 & 0xffc0) == 0)
@@ -4416,12 +5236,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FSUB */
     else if ((opcode & 0xffc0) == 0xf200 && ((opcode2 & 0xa07f) == 0x0028 || (opcode2 & 0xa07b) == 0x0068))
@@ -4457,12 +5272,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
     }
     /* FSIN */
     else if ((opcode & 0xffc0) == 0xf200 && (opcode2 & 0xa07f) == 0x000e)
@@ -4489,7 +5299,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+#if EMU68_FPU_FAST_MATH
+        uint32_t *skip;
+        ptr = FPU_FastKernelCall(ptr, FastSinCos, &skip);
+#endif
+
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -4498,9 +5313,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = blr(0);
 
-        *ptr++ = fcpyd(fp_dst, 0);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+#if EMU68_FPU_FAST_MATH
+        ptr = FPU_FastKernelDone(ptr, skip);
+#endif
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        *ptr++ = fcpyd(fp_dst, 0);
         
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -4508,12 +5326,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -4542,7 +5355,12 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             *ptr++ = fcpyd(0, fp_src);
         }
 
-        ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+#if EMU68_FPU_FAST_MATH
+        uint32_t *skip;
+        ptr = FPU_FastKernelCall(ptr, FastSinCos, &skip);
+#endif
+
+        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
 
         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
@@ -4551,9 +5369,19 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 
         *ptr++ = blr(0);
 
-        *ptr++ = fcpyd(fp_dst, 0);
+#if EMU68_FPU_FAST_MATH
+        *ptr++ = fcpyd(1, 0);
+#endif
 
-        ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT);
+        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+#if EMU68_FPU_FAST_MATH
+        ptr = FPU_FastKernelDone(ptr, skip);
+
+        /* Kernel returns cosine in d1 */
+        *ptr++ = fcpyd(fp_dst, 1);
+#else
+        *ptr++ = fcpyd(fp_dst, 0);
+#endif
 
         RA_FreeFPURegister(&ptr, fp_src);
 
@@ -4561,12 +5389,7 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         (*m68k_ptr) += ext_count;
 
         if (FPSR_Update_Needed(*m68k_ptr, 0))
-        {
-            uint8_t fpsr = RA_ModifyFPSR(&ptr);
-
-            *ptr++ = fcmpzd(fp_dst);
-            ptr = EMIT_GetFPUFlags(ptr, fpsr);
-        }
+            RA_SetFPSRResult(&ptr, fp_dst);
 
         *ptr++ = INSN_TO_LE(0xfffffff0);
     }
@@ -4670,27 +5493,46 @@ int DisableFPU = 0;
 
 uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
 
     /* Check destination coprocessor - if it is FPU go to separate function */
     if (DisableFPU == 0 && (opcode & 0x0e00) == 0x0200)
     {
         return EMIT_FPU(ptr, m68k_ptr, insn_consumed);
     }
-    /* PFLUSHA or PTEST - ignore */
+    /* PFLUSH or PTEST - ignore unless the MMU is emulated */
     else if ((opcode & 0xffe0) == 0xf500 || (opcode & 0xffd8) == 0xf548)
     {
+#if EMU68_M68K_MMU
+        extern struct M68KState *__m68k_state;
+
+        if (__m68k_state->JIT_CONTROL2 & JC2F_M68K_MMU)
+        {
+            uint8_t an = RA_MapM68kRegister(&ptr, 8 + (opcode & 7));
+
+            if ((opcode & 0xffe0) == 0xf500)
+                ptr = EMIT_MMUCall(ptr, M68K_MMUFlush, an, (opcode >> 3) & 3);
+            else
+                ptr = EMIT_MMUCall(ptr, M68K_MMUTest, an, (opcode & 0x20) == 0);
+        }
+        else
+#endif
         *ptr++ = nop();
         (*m68k_ptr)+=1;
         *insn_consumed = 1;
         ptr = EMIT_AdvancePC(ptr, 2);
+#if EMU68_M68K_MMU
+        /* Code past PFLUSH may be mapped differently now, it is translated again */
+        if ((opcode & 0xffe0) == 0xf500 && (__m68k_state->JIT_CONTROL2 & JC2F_M68K_MMU))
+            *ptr++ = INSN_TO_LE(0xffffffff);
+#endif
     }
     /* MOVE16 (Ax)+, (Ay)+ */
     else if ((opcode & 0xfff8) == 0xf620) // && (opcode2 & 0x8fff) == 0x8000) <- don't test! Real m68k ignores that bit!
     {
-        uint8_t buf1 = RA_AllocARMRegister(&ptr);
-        uint8_t buf2 = RA_AllocARMRegister(&ptr);
+        /* The line goes through one 128 bit vector register, no GPR pair is needed */
+        uint8_t buf = RA_AllocFPURegister(&ptr);
         uint8_t src = RA_MapM68kRegister(&ptr, 8 + (opcode & 7));
         uint8_t dst = RA_MapM68kRegister(&ptr, 8 + ((opcode2 >> 12) & 7));
 
@@ -4699,9 +5541,9 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 
         *ptr++ = bic_immed(aligned_src, src, 4, 0);
         *ptr++ = bic_immed(aligned_dst, dst, 4, 0);
-        *ptr++ = ldp64(aligned_src, buf1, buf2, 0);
+        *ptr++ = fldq(buf, aligned_src, 0);
         *ptr++ = add_immed(src, src, 16);
-        *ptr++ = stp64(aligned_dst, buf1, buf2, 0);
+        *ptr++ = fstq(buf, aligned_dst, 0);
 
         // Update dst only if it is not the same as src!
         if (dst != src) {
@@ -4714,8 +5556,7 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
         RA_SetDirtyM68kRegister(&ptr, 8 + (opcode & 7));
         RA_SetDirtyM68kRegister(&ptr, 8 + ((opcode2 >> 12) & 7));
 
-        RA_FreeARMRegister(&ptr, buf1);
-        RA_FreeARMRegister(&ptr, buf2);
+        RA_FreeFPURegister(&ptr, buf);
 
         (*m68k_ptr)+=2;
         *insn_consumed = 1;
@@ -4726,10 +5567,9 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
     {
         uint8_t aligned_reg = RA_AllocARMRegister(&ptr);
         uint8_t aligned_mem = RA_AllocARMRegister(&ptr);
-        uint8_t buf1 = RA_AllocARMRegister(&ptr);
-        uint8_t buf2 = RA_AllocARMRegister(&ptr);
+        uint8_t buf = RA_AllocFPURegister(&ptr);
         uint8_t reg = RA_MapM68kRegister(&ptr, 8 + (opcode & 7));
-        uint32_t mem = (cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]) << 16) | cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[2]);
+        uint32_t mem = (cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]) << 16) | cache_fetch_16((uintptr_t)&(*m68k_ptr)[2]);
 
         /* Align memory pointer */
         mem &= 0xfffffff0;
@@ -4740,12 +5580,12 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
         *ptr++ = bic_immed(aligned_reg, reg, 4, 0);
 
         if (opcode & 8) {
-            *ptr++ = ldp64(aligned_mem, buf1, buf2, 0);
-            *ptr++ = stp64(aligned_reg, buf1, buf2, 0);
+            *ptr++ = fldq(buf, aligned_mem, 0);
+            *ptr++ = fstq(buf, aligned_reg, 0);
         }
         else {
-            *ptr++ = ldp64(aligned_reg, buf1, buf2, 0);
-            *ptr++ = stp64(aligned_mem, buf1, buf2, 0);
+            *ptr++ = fldq(buf, aligned_reg, 0);
+            *ptr++ = fstq(buf, aligned_mem, 0);
         }
 
         if (!(opcode & 0x10))
@@ -4756,8 +5596,7 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 
         RA_FreeARMRegister(&ptr, aligned_reg);
         RA_FreeARMRegister(&ptr, aligned_mem);
-        RA_FreeARMRegister(&ptr, buf1);
-        RA_FreeARMRegister(&ptr, buf2);
+        RA_FreeFPURegister(&ptr, buf);
 
         (*m68k_ptr)+=3;
         *insn_consumed = 1;
@@ -4825,13 +5664,13 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 
                         u.u64 = (uintptr_t)invalidate_entire_dcache;
 
-                        *ptr++ = stp64_preindex(31, 0, 30, -16);
+                        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_LEAN));
                         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
                         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
                         *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
                         *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
                         *ptr++ = blr(0);
-                        *ptr++ = ldp64_postindex(31, 0, 30, 16);
+                        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_LEAN));
                     }
                     break;
             }
@@ -4945,13 +5784,13 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 
                         u.u64 = (uintptr_t)clear_entire_dcache;
 
-                        *ptr++ = stp64_preindex(31, 0, 30, -16);
+                        ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_LEAN));
                         *ptr++ = mov64_immed_u16(0, u.u16[3], 0);
                         *ptr++ = movk64_immed_u16(0, u.u16[2], 1);
                         *ptr++ = movk64_immed_u16(0, u.u16[1], 2);
                         *ptr++ = movk64_immed_u16(0, u.u16[0], 3);
                         *ptr++ = blr(0);
-                        *ptr++ = ldp64_postindex(31, 0, 30, 16);
+                        ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_LEAN));
                     }
                     break;
             }
@@ -0,0 +1,401 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "mmu.h"
+#include "M68k.h"
+#include "RegisterAllocator.h"
+
+#if EMU68_M68K_MMU
+
+/*
+    68040 MMU. While TC.E is set the lower address space runs on its own host L1 table, which
+    starts empty. Data aborts there walk the m68k tables and put the page into the host tables
+    with the attributes the physical page has in the boot time map, so translated code accesses
+    memory at native speed. Pages without host memory behind stay unmapped and the bus emulation
+    gets the physical address. PFLUSH removes pages from the host tables.
+
+    The m68k tables are read through the -4GB shadow of the kernel table, which always shows
+    the physical space. Supervisor and user mode share the host tables, S bits of descriptors
+    are checked on table search only. Invalid and write protected pages are reported and the
+    access is dropped, there is no access error exception.
+
+    Translated code is kept across table changes, but every unit verifies its checksum through
+    the new mapping on next entry. Code pages are write protected by their physical address, so
+    only units translated with translation off are protected.
+*/
+
+#define TC_E        0x8000
+#define TC_P        0x4000      /* 8K pages */
+
+#define TT_E        0x8000
+#define TT_SIGNORE  0x4000
+#define TT_SUPER    0x2000
+#define TT_W        0x0004
+
+#define MMUSR_R     0x001
+#define MMUSR_T     0x002
+#define MMUSR_W     0x004
+#define MMUSR_M     0x010
+
+#define DESC_W      0x004
+#define DESC_U      0x008
+#define DESC_M      0x010
+#define DESC_S      0x080
+
+#define MMU_REPORT_LIMIT    64
+
+extern struct M68KState *__m68k_state;
+
+uint8_t m68k_mmu_enabled;
+
+static void *mmu_table;
+static uint16_t mmu_tc;
+static uint32_t mmu_regs[6];
+static uint32_t mmu_reports;
+
+static inline uint32_t getSR()
+{
+    uint32_t sr;
+    asm volatile("mrs %0, TPIDR_EL0":"=r"(sr));
+    return sr;
+}
+
+static inline uint32_t ReadPhys(uint32_t addr)
+{
+    return *(volatile uint32_t *)(0xffffffff00000000ULL + addr);
+}
+
+static inline void WritePhys(uint32_t addr, uint32_t value)
+{
+    *(volatile uint32_t *)(0xffffffff00000000ULL + addr) = value;
+}
+
+/* Transparent translation, data and instruction registers both apply to every access */
+static int MatchTT(uint32_t addr, int super, uint32_t *mmusr)
+{
+    uint32_t tt[4] = {
+        __m68k_state->DTT0, __m68k_state->DTT1, __m68k_state->ITT0, __m68k_state->ITT1
+    };
+
+    for (int i=0; i < 4; i++)
+    {
+        if ((tt[i] & TT_E) == 0)
+            continue;
+
+        if ((tt[i] & TT_SIGNORE) == 0 && !(tt[i] & TT_SUPER) != !super)
+            continue;
+
+        /* Mask field marks bits of the address base which are ignored */
+        uint32_t mask = ~(tt[i] << 8) & 0xff000000;
+
+        if (((addr ^ tt[i]) & mask) == 0)
+        {
+            *mmusr = (addr & 0xfffff000) | MMUSR_T | MMUSR_R | ((tt[i] & TT_W) ? MMUSR_W : 0);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+    Table search of the 68040. U bits are set on the way, M in the page descriptor on writes to
+    pages which are not write protected. Returns 0 if the address has no valid translation,
+    *mmusr is what PTEST would leave in MMUSR
+*/
+static int Translate(uint32_t addr, int write, uint32_t *phys, uint32_t *mmusr)
+{
+    int super = (getSR() & SR_S) != 0;
+    uint16_t tc = __m68k_state->TCR;
+    uint32_t desc, desc_addr, wp;
+
+    *mmusr = 0;
+    *phys = addr;
+
+    if (MatchTT(addr, super, mmusr))
+        return 1;
+
+    if ((tc & TC_E) == 0)
+    {
+        *mmusr = (addr & 0xfffff000) | MMUSR_R;
+        return 1;
+    }
+
+    /* Root level, 128 entries of 32MB */
+    desc_addr = (super ? __m68k_state->SRP : __m68k_state->URP) + ((addr >> 25) << 2);
+    desc = ReadPhys(desc_addr);
+    if ((desc & 2) == 0)
+        return 0;
+    if ((desc & DESC_U) == 0)
+        WritePhys(desc_addr, desc | DESC_U);
+    wp = desc & DESC_W;
+
+    /* Pointer level, 128 entries of 256KB */
+    desc_addr = (desc & 0xfffffe00) + (((addr >> 18) & 0x7f) << 2);
+    desc = ReadPhys(desc_addr);
+    if ((desc & 2) == 0)
+        return 0;
+    if ((desc & DESC_U) == 0)
+        WritePhys(desc_addr, desc | DESC_U);
+    wp |= desc & DESC_W;
+
+    /* Page level, 32 entries of 8K or 64 entries of 4K */
+    if (tc & TC_P)
+        desc_addr = (desc & 0xffffff80) + (((addr >> 13) & 0x1f) << 2);
+    else
+        desc_addr = (desc & 0xffffff00) + (((addr >> 12) & 0x3f) << 2);
+    desc = ReadPhys(desc_addr);
+
+    /* Indirect descriptor */
+    if ((desc & 3) == 2)
+    {
+        desc_addr = desc & 0xfffffffc;
+        desc = ReadPhys(desc_addr);
+        if ((desc & 3) == 2)
+            return 0;
+    }
+
+    if ((desc & 3) == 0)
+        return 0;
+
+    if ((desc & DESC_S) && !super)
+        return 0;
+
+    wp |= desc & DESC_W;
+
+    uint32_t updated = desc | DESC_U | ((write && !wp) ? DESC_M : 0);
+    if (updated != desc)
+        WritePhys(desc_addr, updated);
+
+    if (tc & TC_P)
+        *phys = (updated & 0xffffe000) | (addr & 0x1fff);
+    else
+        *phys = (updated & 0xfffff000) | (addr & 0xfff);
+
+    *mmusr = (*phys & 0xfffff000) | (updated & 0x7f0) | (wp ? MMUSR_W : 0) | MMUSR_R;
+
+    return 1;
+}
+
+static void Report(uint32_t addr, int write, uint32_t mmusr)
+{
+    if (mmu_reports == MMU_REPORT_LIMIT)
+        return;
+
+    kprintf("[MMU] %s %s %08x dropped, %s\n", (getSR() & SR_S) ? "Supervisor" : "User",
+        write ? "write to" : "read from", addr, (mmusr & MMUSR_R) ? "write protected" : "invalid page");
+
+    if (++mmu_reports == MMU_REPORT_LIMIT)
+        kprintf("[MMU] Further faults are not reported\n");
+}
+
+/* Start over with empty host tables */
+static void FlushAll()
+{
+    void *old = mmu_table;
+
+    mmu_table = mmu_user_table_new();
+    mmu_user_table_select(mmu_table);
+
+    if (old)
+        mmu_user_table_free(old);
+}
+
+/*
+    Called after MOVEC to TC, URP, SRP or transparent translation registers. Switches translation
+    on or off, host tables are cleared when anything has changed
+*/
+void M68K_MMUUpdate(uint32_t unused, uint32_t unused2)
+{
+    struct M68KState *ctx = __m68k_state;
+    uint32_t regs[6] = { ctx->URP, ctx->SRP, ctx->ITT0, ctx->ITT1, ctx->DTT0, ctx->DTT1 };
+    int changed = ctx->TCR != mmu_tc;
+
+    (void)unused;
+    (void)unused2;
+
+    for (int i=0; i < 6; i++)
+    {
+        if (regs[i] != mmu_regs[i])
+            changed = 1;
+        mmu_regs[i] = regs[i];
+    }
+
+    mmu_tc = ctx->TCR;
+
+    if (!changed)
+        return;
+
+    if ((mmu_tc & TC_E) == 0)
+    {
+        if (mmu_table)
+        {
+            m68k_mmu_enabled = 0;
+            mmu_user_table_select(NULL);
+            mmu_user_table_free(mmu_table);
+            mmu_table = NULL;
+
+            kprintf("[MMU] Translation disabled\n");
+        }
+        M68K_RecheckUnits();
+        return;
+    }
+
+    if (mmu_table == NULL)
+    {
+        kprintf("[MMU] Translation enabled, %dK pages, URP=%08x SRP=%08x\n", (mmu_tc & TC_P) ? 8 : 4, ctx->URP, ctx->SRP);
+
+        if (ctx->URP != ctx->SRP)
+            kprintf("[MMU] URP and SRP differ, user and supervisor pages share the host tables\n");
+    }
+
+    FlushAll();
+    m68k_mmu_enabled = 1;
+    M68K_RecheckUnits();
+}
+
+/* PFLUSH, opmode as in bits 4-3 of the opcode. Global bits are not kept, N variants flush all */
+void M68K_MMUFlush(uint32_t address, uint32_t opmode)
+{
+    if (!m68k_mmu_enabled)
+        return;
+
+    uint32_t size = (mmu_tc & TC_P) ? 8192 : 4096;
+
+    if (opmode & 2)
+    {
+        FlushAll();
+        M68K_RecheckUnits();
+    }
+    else
+    {
+        address &= ~(size - 1);
+        mmu_unmap(address, size);
+        M68K_RecheckRange(address, (uintptr_t)address + size);
+    }
+}
+
+/* PTEST, the result goes to MMUSR */
+void M68K_MMUTest(uint32_t address, uint32_t write)
+{
+    uint32_t phys, mmusr;
+
+    Translate(address, write, &phys, &mmusr);
+
+    __m68k_state->MMUSR = mmusr;
+}
+
+/* Reset of the m68k, back to the physical space */
+void M68K_MMUReset()
+{
+    __m68k_state->TCR = 0;
+    M68K_MMUUpdate(0, 0);
+}
+
+/*
+    Data abort in the lower address space. The page is put into host tables if it is valid and
+    has host memory behind. Writable pages are mapped read-only until the first write, so that
+    the M bit is set. Returns 1 if the access can be restarted
+*/
+int M68K_MMUFault(uint64_t far, int write)
+{
+    uint32_t phys, mmusr;
+    uint32_t addr = far;
+
+    /* Space and its +4GB shadow only */
+    if (!m68k_mmu_enabled || (far >> 33))
+        return 0;
+
+    if (!Translate(addr, write, &phys, &mmusr) || (write && (mmusr & MMUSR_W)))
+        return 0;
+
+    uint64_t e = mmu_user_entry(phys & 0xfffff000);
+
+    /* Bus, or read-only memory of the physical space. Fault handler takes it from here */
+    if (e == 0 || (write && (e & MMU_READ_ONLY)))
+        return 0;
+
+    uint32_t attr_low = e & 0xffc;
+
+    if ((mmusr & MMUSR_W) || !(mmusr & (MMUSR_M | MMUSR_T)))
+        attr_low |= MMU_READ_ONLY;
+
+    mmu_map(e & 0x0000fffffffff000ULL, addr & 0xfffff000, 4096, attr_low, e >> 48);
+
+    return 1;
+}
+
+/*
+    Physical address for the bus emulation. Returns 0 if the page is invalid or write protected,
+    the access is reported and does not reach the bus then
+*/
+int M68K_MMUBusAddress(uint64_t *far, int write)
+{
+    uint32_t phys, mmusr;
+
+    if (!m68k_mmu_enabled || (*far >> 33))
+        return 1;
+
+    if (!Translate(*far, write, &phys, &mmusr) || (write && (mmusr & MMUSR_W)))
+    {
+        Report(*far, write, mmusr);
+        return 0;
+    }
+
+    *far = phys;
+
+    return 1;
+}
+
+/* Physical address behind far for the code write check, far itself if there is no valid page */
+uint64_t M68K_MMUPhysical(uint64_t far)
+{
+    uint32_t phys, mmusr;
+
+    if (!m68k_mmu_enabled || (far >> 33))
+        return far;
+
+    if (!Translate(far, 0, &phys, &mmusr))
+        return far;
+
+    return phys;
+}
+
+/* Call func(reg, arg) from translated code, reg 0xff passes 0 */
+uint32_t *EMIT_MMUCall(uint32_t *ptr, void (*func)(uint32_t, uint32_t), uint8_t reg, uint32_t arg)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    u.u64 = (uintptr_t)func;
+
+    ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+
+    if (reg != 0xff)
+        *ptr++ = mov_reg(0, reg);
+    else
+        *ptr++ = mov_immed_u16(0, 0, 0);
+    *ptr++ = mov_immed_u16(1, arg, 0);
+    *ptr++ = mov64_immed_u16(2, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(2, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(2, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(2, u.u16[0], 3);
+    *ptr++ = blr(2);
+
+    ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+
+    return ptr;
+}
+
+#endif
@@ -15,7 +15,7 @@
 uint32_t *EMIT_moveq(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr);
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     int8_t value = opcode & 0xff;
     uint8_t reg = (opcode >> 9) & 7;
     uint8_t tmp_reg = RA_MapM68kRegisterForWrite(&ptr, reg);
@@ -72,7 +72,7 @@ uint32_t GetSR_Line7(uint16_t opcode)
 uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr);
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     int move_length = M68K_GetINSNLength(*m68k_ptr);
     uint8_t ext_count = 0;
     uint8_t tmp_reg = 0xff;
@@ -85,6 +85,9 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
     *insn_consumed = 1;
     int done = 0;
     int fused_opcodes = 0;
+#if EMU68_LIVE_FLAGS_BRANCH
+    int host_flags = 0;
+#endif
 
     // Move from/to An in byte size is illegal
     if ((opcode & 0xf000) == 0x1000)
@@ -139,10 +142,14 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
         - move.l -(An), Reg
         - move.l (An)+, Reg
     */
-    if ((opcode & 0xf000) == 0x2000)
+    if ((opcode & 0xf000) == 0x2000
+#if EMU68_TRACE_CACHE
+        && !m68k_single_step
+#endif
+    )
     {
         // Fetch 2nd opcode just now
-        uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]);
+        uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
 
         // Is move.l Reg, -(An) ?: Dest mode 100, source mode 000 or 001
         if ((opcode & 0x01f0) == 0x0100)
@@ -321,6 +328,187 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
                 }
             }
         }
+
+        // Is move.l (An)+, (Am)+ or move.l -(An), -(Am) ?: Source and dest mode both 011 or both 100
+        else if (((opcode & 0x01f8) == 0x00d8 || (opcode & 0x01f8) == 0x0120) && opcode2 == opcode &&
+                 (opcode & 7) != ((opcode >> 9) & 7))
+        {
+            uint8_t src_reg = RA_MapM68kRegisterForWrite(&ptr, (opcode & 7) + 8);
+            uint8_t dst_reg = RA_MapM68kRegisterForWrite(&ptr, ((opcode >> 9) & 7) + 8);
+            uint8_t val_1 = RA_AllocARMRegister(&ptr);
+            uint8_t val_2 = RA_AllocARMRegister(&ptr);
+            int predec = (opcode & 0x0038) == 0x0020;
+
+#if EMU68_LOOP_PREFETCH
+            if (predec)
+                loop_stride_dec |= ((1 << (opcode & 7)) | (1 << ((opcode >> 9) & 7))) & 0x7f;
+            else
+                loop_stride_inc |= ((1 << (opcode & 7)) | (1 << ((opcode >> 9) & 7))) & 0x7f;
+#endif
+
+            /*
+                Both loads are done first. If the first store goes to the address of the second load,
+                which is the case for Am = An + 4 (An - 4 for predecrement), the second value is the first one.
+                If it overlaps the second long word only partially, Am - An from 1 to 7 (-7 to -1), the pair
+                is moved one long word after the other. The distance is biased so that both cases give
+                0 to 6 there, with 3 for the exact overlap
+            */
+            *ptr++ = sub_reg(val_2, dst_reg, src_reg, LSL, 0);
+            if (predec)
+                *ptr++ = add_immed(val_2, val_2, 7);
+            else
+                *ptr++ = sub_immed(val_2, val_2, 1);
+            *ptr++ = cmp_immed(val_2, 7);
+            *ptr++ = b_cc(A64_CC_CS, 3);
+            *ptr++ = cmp_immed(val_2, 3);
+            *ptr++ = b_cc(A64_CC_NE, 6);
+            *ptr++ = cmp_immed(val_2, 3);
+            if (predec)
+            {
+                *ptr++ = ldp_preindex(src_reg, val_2, val_1, -8);
+                *ptr++ = csel(val_2, val_1, val_2, A64_CC_EQ);
+                *ptr++ = stp_preindex(dst_reg, val_2, val_1, -8);
+                *ptr++ = b(5);
+                *ptr++ = ldr_offset_preindex(src_reg, val_1, -4);
+                *ptr++ = str_offset_preindex(dst_reg, val_1, -4);
+                *ptr++ = ldr_offset_preindex(src_reg, val_2, -4);
+                *ptr++ = str_offset_preindex(dst_reg, val_2, -4);
+            }
+            else
+            {
+                *ptr++ = ldp_postindex(src_reg, val_1, val_2, 8);
+                *ptr++ = csel(val_2, val_1, val_2, A64_CC_EQ);
+                *ptr++ = stp_postindex(dst_reg, val_1, val_2, 8);
+                *ptr++ = b(5);
+                *ptr++ = ldr_offset_postindex(src_reg, val_1, 4);
+                *ptr++ = str_offset_postindex(dst_reg, val_1, 4);
+                *ptr++ = ldr_offset_postindex(src_reg, val_2, 4);
+                *ptr++ = str_offset_postindex(dst_reg, val_2, 4);
+            }
+
+            (*m68k_ptr)++;
+            update_mask = M68K_GetSRMask(*m68k_ptr);
+            (*m68k_ptr)++;
+
+            if (update_mask)
+            {
+                *ptr++ = cmn_reg(31, val_2, LSL, 0);
+            }
+
+            RA_FreeARMRegister(&ptr, val_1);
+            tmp_reg = val_2;
+
+            done = 1;
+            ptr = EMIT_AdvancePC(ptr, 4);
+            *insn_consumed = 2;
+            size = 4;
+        }
+
+        // Is move.l Reg, d16(An) followed by move.l Reg, d16±4(An) ?: Dest mode 101, source mode 000 or 001
+        else if ((opcode & 0x01f0) == 0x0140)
+        {
+            int16_t off_1 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
+            int16_t off_2 = 0;
+
+            opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[2]);
+            if ((opcode2 & 0xf000) == 0x2000 && (opcode2 & 0x0ff0) == (opcode & 0x0ff0))
+                off_2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[3]);
+
+            int16_t off = off_1 < off_2 ? off_1 : off_2;
+
+            if ((opcode2 & 0xf000) == 0x2000 && (opcode2 & 0x0ff0) == (opcode & 0x0ff0) &&
+                (off_2 - off_1 == 4 || off_1 - off_2 == 4) && (off & 3) == 0 && off >= -256 && off <= 252)
+            {
+                uint8_t addr_reg = RA_MapM68kRegister(&ptr, ((opcode >> 9) & 7) + 8);
+                uint8_t src_reg_1 = RA_MapM68kRegister(&ptr, opcode & 0xf);
+                uint8_t src_reg_2 = RA_MapM68kRegister(&ptr, opcode2 & 0xf);
+
+                /* Two subsequent register moves to adjacent long words */
+                (*m68k_ptr) += 2;
+                update_mask = M68K_GetSRMask(*m68k_ptr);
+                (*m68k_ptr) += 2;
+
+                if (update_mask)
+                {
+                    *ptr++ = cmn_reg(31, src_reg_2, LSL, 0);
+                }
+
+                if (off_1 < off_2)
+                    *ptr++ = stp(addr_reg, src_reg_1, src_reg_2, off);
+                else
+                    *ptr++ = stp(addr_reg, src_reg_2, src_reg_1, off);
+
+                RA_FreeARMRegister(&ptr, src_reg_1);
+                RA_FreeARMRegister(&ptr, addr_reg);
+                tmp_reg = src_reg_2;
+
+                done = 1;
+                ptr = EMIT_AdvancePC(ptr, 8);
+                *insn_consumed = 2;
+                size = 4;
+            }
+        }
+
+        // Is move.l d16(An), Reg followed by move.l d16±4(An), Reg ?: Dest mode 001 or 000, source mode 101
+        else if ((opcode & 0x01b8) == 0x0028)
+        {
+            int16_t off_1 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[1]);
+            int16_t off_2 = 0;
+
+            opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[2]);
+            if ((opcode2 & 0xf000) == 0x2000 && (opcode2 & 0x01bf) == (opcode & 0x01bf))
+                off_2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[3]);
+
+            int16_t off = off_1 < off_2 ? off_1 : off_2;
+
+            if (
+                (opcode2 & 0xf000) == 0x2000 &&             // move.l
+                (opcode2 & 0x01bf) == (opcode & 0x01bf) &&  // same src reg, same mode?
+                (opcode2 & 0x0e40) != (opcode & 0x0e40) &&  // Two different dest registers!
+                (off_2 - off_1 == 4 || off_1 - off_2 == 4) && (off & 3) == 0 && off >= -256 && off <= 252
+            )
+            {
+                uint8_t addr_reg = RA_MapM68kRegister(&ptr, (opcode & 7) + 8);
+                uint8_t dst_reg_1 = RA_MapM68kRegisterForWrite(&ptr, ((opcode >> 9) & 0x7) + ((opcode >> 3) & 8));
+                uint8_t dst_reg_2 = RA_MapM68kRegisterForWrite(&ptr, ((opcode2 >> 9) & 0x7) + ((opcode2 >> 3) & 8));
+                uint8_t is_movea2 = (opcode2 & 0x01c0) == 0x0040;
+
+                /* The first load must not change the base register used by the second one */
+                if (!(dst_reg_1 == addr_reg || dst_reg_2 == addr_reg) && dst_reg_1 != dst_reg_2)
+                {
+                    /* Two subsequent register moves from adjacent long words */
+                    (*m68k_ptr) += 4;
+
+                    if (off_1 < off_2)
+                        *ptr++ = ldp(addr_reg, dst_reg_1, dst_reg_2, off);
+                    else
+                        *ptr++ = ldp(addr_reg, dst_reg_2, dst_reg_1, off);
+
+                    if (!is_movea2) {
+                        update_mask = M68K_GetSRMask(*m68k_ptr - 2);
+                        if (update_mask) {
+                            *ptr++ = cmn_reg(31, dst_reg_2, LSL, 0);
+                            tmp_reg = dst_reg_2;
+                        }
+                    }
+                    else if (!is_movea) {
+                        if (update_mask) {
+                            *ptr++ = cmn_reg(31, dst_reg_1, LSL, 0);
+                            tmp_reg = dst_reg_1;
+                        }
+                    }
+
+                    is_movea = is_movea && is_movea2;
+
+                    RA_FreeARMRegister(&ptr, addr_reg);
+
+                    done = 1;
+                    ptr = EMIT_AdvancePC(ptr, 8);
+                    *insn_consumed = 2;
+                    size = 4;
+                }
+            }
+        }
     }
 
     if (!done)
@@ -341,9 +529,13 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             size = 2;
 
         /* Only if target is data register */
-        if ((tmp & 0x38) == 0)
+        if ((tmp & 0x38) == 0
+#if EMU68_TRACE_CACHE
+            && !m68k_single_step
+#endif
+        )
         {
-            uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[move_length - 1]);
+            uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[move_length - 1]);
             
             /* Check if subsequent instruction is extb.l on the same target reg */
             if (size == 1 && (opcode2 & 0xfff8) == 0x49c0 && (opcode2 & 7) == (tmp & 7))
@@ -362,7 +554,7 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             /* Check if subsequent instructions are ext.w + ext.l on the same target and size is byte */
             else if (size == 1 && (opcode2 & 0xfff8) == 0x4880 && (opcode2 & 7) == (tmp & 7))
             {
-                uint16_t opcode3 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[move_length]);
+                uint16_t opcode3 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[move_length]);
                 if ((opcode3 & 0xfff8) == 0x48c0 && (opcode3 & 7) == (tmp & 7))
                 {
                     sign_ext = 1;
@@ -424,10 +616,10 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             is_load_immediate = 1;
             switch (size) {
                 case 4:
-                    immediate_value = cache_read_32(ICACHE, (uintptr_t)&(*(uint32_t*)(*m68k_ptr)));
+                    immediate_value = cache_fetch_32((uintptr_t)&(*(uint32_t*)(*m68k_ptr)));
                     break;
                 case 2:
-                    immediate_value = cache_read_16(ICACHE, (uintptr_t)&(**m68k_ptr));
+                    immediate_value = cache_fetch_16((uintptr_t)&(**m68k_ptr));
                     break;
                 case 1:
                     immediate_value = ((uint8_t*)*m68k_ptr)[1];
@@ -470,6 +662,11 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             }
         }
 
+#if EMU68_LIVE_FLAGS_BRANCH
+        /* Flags of the move into register come from the cmn or adds above, nothing is stored after them */
+        host_flags = update_mask && !is_load_immediate && loaded_in_dest && !fused_opcodes && !is_movea;
+#endif
+
         if (!loaded_in_dest)
             ptr = EMIT_StoreToEffectiveAddress(ptr, size, &tmp_reg, tmp, *m68k_ptr, &ext_count, 0);
 
@@ -521,6 +718,13 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
     }
 
     RA_FreeARMRegister(&ptr, tmp_reg);
+
+#if EMU68_LIVE_FLAGS_BRANCH
+    /* CCR is up to date, host flags still hold the moved value */
+    if (host_flags && M68K_CanFuseBcc(*m68k_ptr, 0, FUSED_ADDS))
+        return EMIT_FusedBcc(ptr, m68k_ptr, insn_consumed, FUSED_ADDS, 0xff);
+#endif
+
     return ptr;
 }
 
@@ -16,6 +16,58 @@
 uint32_t *EMIT_MULU(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr) __attribute__((alias("EMIT_MUL_DIV")));
 uint32_t *EMIT_MULS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr) __attribute__((alias("EMIT_MUL_DIV")));
 
+#if EMU68_CONST_MULDIV
+/* Multiplier can be applied with at most one shift or shifted add */
+static int CanMulConst(uint32_t value)
+{
+    return value == 0 || (value & (value - 1)) == 0 || ((value - 1) & (value - 2)) == 0;
+}
+
+static uint32_t *EMIT_MulConst(uint32_t *ptr, uint8_t reg, uint32_t value)
+{
+    if (value == 0)
+        *ptr++ = mov_immed_u16(reg, 0, 0);
+    else if ((value & (value - 1)) == 0)
+    {
+        if (value != 1)
+            *ptr++ = lsl(reg, reg, __builtin_ctz(value));
+    }
+    else
+        *ptr++ = add_reg(reg, reg, reg, LSL, __builtin_ctz(value - 1));
+
+    return ptr;
+}
+
+/*
+    Unsigned quotient of 32-bit value in src, zero extended to 64 bits, and constant divisor of
+    at least 2. With m = 2^64 / divisor rounded up the quotient is its high half of src * m, the
+    error of m times src is below 2^-32 and never reaches the next integer.
+*/
+static uint32_t *EMIT_DivConst(uint32_t *ptr, uint8_t quot, uint8_t src, uint32_t divisor)
+{
+    if ((divisor & (divisor - 1)) == 0)
+    {
+        *ptr++ = lsr(quot, src, __builtin_ctz(divisor));
+        return ptr;
+    }
+
+    uint64_t magic = 0xffffffffffffffffULL / divisor + 1;
+    uint8_t m = RA_AllocARMRegister(&ptr);
+
+    *ptr++ = mov64_immed_u16(m, magic & 0xffff, 0);
+    for (int i=1; i < 4; i++)
+    {
+        if ((magic >> (16 * i)) & 0xffff)
+            *ptr++ = movk64_immed_u16(m, (magic >> (16 * i)) & 0xffff, i);
+    }
+    *ptr++ = umulh(quot, src, m);
+
+    RA_FreeARMRegister(&ptr, m);
+
+    return ptr;
+}
+#endif
+
 uint32_t *EMIT_MULS_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
@@ -27,14 +79,27 @@ uint32_t *EMIT_MULS_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     reg = RA_MapM68kRegister(&ptr, (opcode >> 9) & 7);
     RA_SetDirtyM68kRegister(&ptr, (opcode >> 9) & 7);
 
-    // Fetch 16-bit multiplicant
-    ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 2, &src, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
+#if EMU68_CONST_MULDIV
+    int16_t imm = (int16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
+
+    if ((opcode & 0x3f) == 0x3c && imm >= 0 && CanMulConst(imm))
+    {
+        *ptr++ = sxth(reg, reg);
+        ptr = EMIT_MulConst(ptr, reg, imm);
+        ext_words = 1;
+    }
+    else
+#endif
+    {
+        // Fetch 16-bit multiplicant
+        ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 2, &src, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
 
-    // Sign-extend 16-bit multiplicants
-    *ptr++ = sxth(reg, reg);
-    *ptr++ = mul(reg, reg, src);
+        // Sign-extend 16-bit multiplicants
+        *ptr++ = sxth(reg, reg);
+        *ptr++ = mul(reg, reg, src);
 
-    RA_FreeARMRegister(&ptr, src);
+        RA_FreeARMRegister(&ptr, src);
+    }
 
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
@@ -68,25 +133,38 @@ uint32_t *EMIT_MULU_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     reg = RA_MapM68kRegister(&ptr, (opcode >> 9) & 7);
     RA_SetDirtyM68kRegister(&ptr, (opcode >> 9) & 7);
 
-    // Fetch 16-bit multiplicant
-    ptr = EMIT_LoadFromEffectiveAddress(ptr, 2, &src, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
+#if EMU68_CONST_MULDIV
+    uint16_t imm = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
-    /* extension of source needed only in case of Dn source */
-    if ((opcode & 0x38) == 0) {
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
-
-        *ptr++ = uxth(tmp, src);
-        *ptr++ = uxth(reg, reg);
-        *ptr++ = mul(reg, reg, tmp);
-
-        RA_FreeARMRegister(&ptr, tmp);
-    }
-    else {
+    if ((opcode & 0x3f) == 0x3c && CanMulConst(imm))
+    {
         *ptr++ = uxth(reg, reg);
-        *ptr++ = mul(reg, reg, src);
+        ptr = EMIT_MulConst(ptr, reg, imm);
+        ext_words = 1;
     }
+    else
+#endif
+    {
+        // Fetch 16-bit multiplicant
+        ptr = EMIT_LoadFromEffectiveAddress(ptr, 2, &src, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
 
-    RA_FreeARMRegister(&ptr, src);
+        /* extension of source needed only in case of Dn source */
+        if ((opcode & 0x38) == 0) {
+            uint8_t tmp = RA_AllocARMRegister(&ptr);
+
+            *ptr++ = uxth(tmp, src);
+            *ptr++ = uxth(reg, reg);
+            *ptr++ = mul(reg, reg, tmp);
+
+            RA_FreeARMRegister(&ptr, tmp);
+        }
+        else {
+            *ptr++ = uxth(reg, reg);
+            *ptr++ = mul(reg, reg, src);
+        }
+
+        RA_FreeARMRegister(&ptr, src);
+    }
 
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
@@ -116,7 +194,7 @@ uint32_t *EMIT_MULS_L(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint8_t reg_dh = 0xff;
     uint8_t src = 0xff;
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
     // Fetch 32-bit register: source and destination
     reg_dl = RA_MapM68kRegister(&ptr, (opcode2 >> 12) & 7);
@@ -201,51 +279,83 @@ uint32_t *EMIT_DIVS_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint8_t reg_rem = RA_AllocARMRegister(&ptr);
     uint8_t ext_words = 0;
 
-    ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 2, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
-    ptr = EMIT_FlushPC(ptr);
-    RA_GetCC(&ptr);
-
-    *ptr++ = ands_immed(31, reg_q, 16, 0);
-    uint32_t *tmp_ptr = ptr;
-    *ptr++ = b_cc(A64_CC_NE, 2);
+#if EMU68_CONST_MULDIV
+    int16_t divisor = (int16_t)cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
-    if (1)
+    /* Immediate divisor is never zero and the quotient is found without sdiv */
+    if ((opcode & 0x3f) == 0x3c && divisor != 0 && divisor != 1 && divisor != -1)
     {
-        /*
-            This is a point of no return. Issue division by zero exception here
-        */
-        *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
+        reg_q = RA_AllocARMRegister(&ptr);
+        if (divisor < 0)
+            *ptr++ = movn_immed_u16(reg_q, ~divisor & 0xffff, 0);
+        else
+            *ptr++ = mov_immed_u16(reg_q, divisor, 0);
+        ext_words = 1;
+
+        /* Divide absolute values, quotient is negative if signs of dividend and divisor differ */
+        *ptr++ = cmp_immed(reg_a, 0);
+        *ptr++ = cneg(reg_rem, reg_a, A64_CC_MI);
+        ptr = EMIT_DivConst(ptr, reg_quot, reg_rem, divisor < 0 ? -divisor : divisor);
+        *ptr++ = cneg(reg_quot, reg_quot, divisor < 0 ? A64_CC_PL : A64_CC_MI);
+        *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_q);
+    }
+    else
+#endif
+    {
+        ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 2, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
+        ptr = EMIT_FlushPC(ptr);
+        RA_GetCC(&ptr);
+
+        *ptr++ = ands_immed(31, reg_q, 16, 0);
+        uint32_t *tmp_ptr = ptr;
+        *ptr++ = b_cc(A64_CC_NE, 2);
+
+        if (1)
+        {
+            /*
+                This is a point of no return. Issue division by zero exception here
+            */
+            *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
 
-        ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
+            ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
 
-        RA_StoreDirtyFPURegs(&ptr);
-        RA_StoreDirtyM68kRegs(&ptr);
+            RA_StoreDirtyFPURegs(&ptr);
+            RA_StoreDirtyM68kRegs(&ptr);
 
-        RA_StoreCC(&ptr);
-        RA_StoreFPCR(&ptr);
-        RA_StoreFPSR(&ptr);
+            RA_StoreCC(&ptr);
+            RA_StoreFPCR(&ptr);
+            RA_StoreFPSR(&ptr);
 
 #if EMU68_INSN_COUNTER        
-        extern uint32_t insn_count;
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
-        *ptr++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
-        if (insn_count & 0xffff0000) {
-            *ptr++ = movk_immed_u16(tmp, insn_count >> 16, 1);
+            extern uint32_t insn_count;
+            if (insn_count_precise) {
+                uint8_t tmp = RA_AllocARMRegister(&ptr);
+                *ptr++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
+                if (insn_count & 0xffff0000) {
+                    *ptr++ = movk_immed_u16(tmp, insn_count >> 16, 1);
+                }
+                *ptr++ = fmov_from_reg(0, tmp);
+                *ptr++ = vadd_2d(30, 30, 0);
+
+                RA_FreeARMRegister(&ptr, tmp);
+            }
+#endif
+
+            /* Return here */
+#if EMU68_BLOCK_CHAINING
+            *ptr++ = mov64_immed_u16(0, 0, 0);
+#endif
+            *ptr++ = bx_lr();
         }
-        *ptr++ = fmov_from_reg(0, tmp);
-        *ptr++ = vadd_2d(30, 30, 0);
-        
-        RA_FreeARMRegister(&ptr, tmp);
+        /* Update branch to the continuation */
+        *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
+#if EMU68_COLD_STUBS
+        ptr = EMIT_ColdStub(tmp_ptr + 1, ptr);
 #endif
 
-        /* Return here */
-        *ptr++ = bx_lr();
+        *ptr++ = sdiv(reg_quot, reg_a, reg_q);
+        *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_q);
     }
-    /* Update branch to the continuation */
-    *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
-
-    *ptr++ = sdiv(reg_quot, reg_a, reg_q);
-    *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_q);
 
     uint8_t tmp = RA_AllocARMRegister(&ptr);
 
@@ -310,58 +420,84 @@ uint32_t *EMIT_DIVU_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint8_t reg_rem = RA_AllocARMRegister(&ptr);
     uint8_t ext_words = 0;
 
-    /* Promise read only here. If dealing with Dn in EA, it will be extended below */
-    ptr = EMIT_LoadFromEffectiveAddress(ptr, 2, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
-    ptr = EMIT_FlushPC(ptr);
-    RA_GetCC(&ptr);
+#if EMU68_CONST_MULDIV
+    uint16_t divisor = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
 
-    *ptr++ = ands_immed(31, reg_q, 16, 0);
-    uint32_t *tmp_ptr = ptr;
-    *ptr++ = b_cc(A64_CC_NE, 2);
+    /* Immediate divisor is never zero and the quotient is found without udiv */
+    if ((opcode & 0x3f) == 0x3c && divisor > 1)
+    {
+        reg_q = RA_AllocARMRegister(&ptr);
+        *ptr++ = mov_immed_u16(reg_q, divisor, 0);
+        ext_words = 1;
 
-    if (1)
+        *ptr++ = mov_reg(reg_rem, reg_a);
+        ptr = EMIT_DivConst(ptr, reg_quot, reg_rem, divisor);
+        *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_q);
+    }
+    else
+#endif
     {
-        /*
-            This is a point of no return. Issue division by zero exception here
-        */
-        *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
+        /* Promise read only here. If dealing with Dn in EA, it will be extended below */
+        ptr = EMIT_LoadFromEffectiveAddress(ptr, 2, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
+        ptr = EMIT_FlushPC(ptr);
+        RA_GetCC(&ptr);
+
+        *ptr++ = ands_immed(31, reg_q, 16, 0);
+        uint32_t *tmp_ptr = ptr;
+        *ptr++ = b_cc(A64_CC_NE, 2);
+
+        if (1)
+        {
+            /*
+                This is a point of no return. Issue division by zero exception here
+            */
+            *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
 
-        ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
+            ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
 
-        RA_StoreDirtyFPURegs(&ptr);
-        RA_StoreDirtyM68kRegs(&ptr);
+            RA_StoreDirtyFPURegs(&ptr);
+            RA_StoreDirtyM68kRegs(&ptr);
 
-        RA_StoreCC(&ptr);
-        RA_StoreFPCR(&ptr);
-        RA_StoreFPSR(&ptr);
+            RA_StoreCC(&ptr);
+            RA_StoreFPCR(&ptr);
+            RA_StoreFPSR(&ptr);
         
 #if EMU68_INSN_COUNTER        
-        extern uint32_t insn_count;
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
-        *ptr++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
-        if (insn_count & 0xffff0000) {
-            *ptr++ = movk_immed_u16(tmp, insn_count >> 16, 1);
+            extern uint32_t insn_count;
+            if (insn_count_precise) {
+                uint8_t tmp = RA_AllocARMRegister(&ptr);
+                *ptr++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
+                if (insn_count & 0xffff0000) {
+                    *ptr++ = movk_immed_u16(tmp, insn_count >> 16, 1);
+                }
+                *ptr++ = fmov_from_reg(0, tmp);
+                *ptr++ = vadd_2d(30, 30, 0);
+
+                RA_FreeARMRegister(&ptr, tmp);
+            }
+#endif
+            /* Return here */
+#if EMU68_BLOCK_CHAINING
+            *ptr++ = mov64_immed_u16(0, 0, 0);
+#endif
+            *ptr++ = bx_lr();
         }
-        *ptr++ = fmov_from_reg(0, tmp);
-        *ptr++ = vadd_2d(30, 30, 0);
-        
-        RA_FreeARMRegister(&ptr, tmp);
+        /* Update branch to the continuation */
+        *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
+#if EMU68_COLD_STUBS
+        ptr = EMIT_ColdStub(tmp_ptr + 1, ptr);
 #endif
-        /* Return here */
-        *ptr++ = bx_lr();
-    }
-    /* Update branch to the continuation */
-    *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
-
-    /* If Dn was souce operant, extend it to 32bit, otherwise it is already in correct form */
-    if ((opcode & 0x38) == 0) {
-        *ptr++ = uxth(reg_rem, reg_q);
-        *ptr++ = udiv(reg_quot, reg_a, reg_rem);
-        *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_rem);
-    }
-    else {
-        *ptr++ = udiv(reg_quot, reg_a, reg_q);
-        *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_q);
+
+        /* If Dn was souce operant, extend it to 32bit, otherwise it is already in correct form */
+        if ((opcode & 0x38) == 0) {
+            *ptr++ = uxth(reg_rem, reg_q);
+            *ptr++ = udiv(reg_quot, reg_a, reg_rem);
+            *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_rem);
+        }
+        else {
+            *ptr++ = udiv(reg_quot, reg_a, reg_q);
+            *ptr++ = msub(reg_rem, reg_a, reg_quot, reg_q);
+        }
     }
         
     uint8_t tmp = RA_AllocARMRegister(&ptr);
@@ -423,7 +559,7 @@ uint32_t *EMIT_DIVU_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 uint32_t *EMIT_DIVUS_L(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
     uint8_t update_mask = M68K_GetSRMask(*m68k_ptr - 1);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode2 = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     uint8_t sig = (opcode2 & (1 << 11)) != 0;
     uint8_t div64 = (opcode2 & (1 << 10)) != 0;
     uint8_t reg_q = 0xff;
@@ -431,122 +567,170 @@ uint32_t *EMIT_DIVUS_L(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint8_t reg_dr = RA_MapM68kRegister(&ptr, opcode2 & 7);
     uint8_t ext_words = 1;
 
-    // Load divisor
-    ptr = EMIT_LoadFromEffectiveAddress(ptr, 4, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
-    ptr = EMIT_FlushPC(ptr);
-    RA_GetCC(&ptr);
-
-    // Check if division by 0
-    uint32_t *tmp_ptr = ptr;
-    *ptr++ = cbnz(reg_q, 2);
+#if EMU68_CONST_MULDIV
+    uint32_t divisor = cache_fetch_32((uintptr_t)&(*m68k_ptr)[1]);
 
-    if (1)
+    /* Immediate divisor is never zero and the 32-bit quotient is found without udiv/sdiv */
+    if (!div64 && (opcode & 0x3f) == 0x3c && divisor != 0 && divisor != 1 && (!sig || divisor != 0xffffffff))
     {
-        /*
-            This is a point of no return. Issue division by zero exception here
-        */
-        *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
-
-        ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
-
-        RA_StoreDirtyFPURegs(&ptr);
-        RA_StoreDirtyM68kRegs(&ptr);
-
-        RA_StoreCC(&ptr);
-        RA_StoreFPCR(&ptr);
-        RA_StoreFPSR(&ptr);
-        
-#if EMU68_INSN_COUNTER        
-        extern uint32_t insn_count;
+        uint8_t quot = RA_AllocARMRegister(&ptr);
         uint8_t tmp = RA_AllocARMRegister(&ptr);
-        *ptr++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
-        if (insn_count & 0xffff0000) {
-            *ptr++ = movk_immed_u16(tmp, insn_count >> 16, 1);
-        }
-        *ptr++ = fmov_from_reg(0, tmp);
-        *ptr++ = vadd_2d(30, 30, 0);
-        
-        RA_FreeARMRegister(&ptr, tmp);
-#endif
-        /* Return here */
-        *ptr++ = bx_lr();
-    }
-    /* Update branch to the continuation */
-    *tmp_ptr = cbnz(reg_q, ptr - tmp_ptr);
 
-    if (div64)
-    {
-        uint8_t tmp = RA_AllocARMRegister(&ptr);
-        uint8_t result = RA_AllocARMRegister(&ptr);
-        uint8_t tmp2 = RA_AllocARMRegister(&ptr);
-
-        // Use temporary result - in case of overflow destination regs remain unchanged
-        *ptr++ = mov_reg(tmp2, reg_dq);
-        *ptr++ = bfi64(tmp2, reg_dr, 32, 32);
+        reg_q = RA_AllocARMRegister(&ptr);
+        *ptr++ = movw_immed_u16(reg_q, divisor & 0xffff);
+        if (divisor >> 16)
+            *ptr++ = movt_immed_u16(reg_q, divisor >> 16);
+        ext_words = 3;
 
         if (sig)
         {
-            uint8_t q_ext = RA_AllocARMRegister(&ptr);
-            *ptr++ = sxtw64(q_ext, reg_q);
-            *ptr++ = sdiv64(result, tmp2, q_ext);
-            if (reg_dr != reg_dq)
-                *ptr++ = msub64(tmp, tmp2, result, q_ext);
-            RA_FreeARMRegister(&ptr, q_ext);
+            /* Divide absolute values, quotient is negative if signs of dividend and divisor differ */
+            *ptr++ = cmp_immed(reg_dq, 0);
+            *ptr++ = cneg(tmp, reg_dq, A64_CC_MI);
+            ptr = EMIT_DivConst(ptr, quot, tmp, (int32_t)divisor < 0 ? -divisor : divisor);
+            *ptr++ = cneg(quot, quot, (int32_t)divisor < 0 ? A64_CC_PL : A64_CC_MI);
         }
         else
         {
-            *ptr++ = udiv64(result, tmp2, reg_q);
-            if (reg_dr != reg_dq)
-                *ptr++ = msub64(tmp, tmp2, result, reg_q);
-        }
-
-        if (sig) {
-            *ptr++ = sxtw64(tmp2, result);
-        }
-        else {
-            *ptr++ = mov_reg(tmp2, result);
-        }
-        *ptr++ = cmp64_reg(tmp2, result, LSL, 0);
-
-        tmp_ptr = ptr;
-        *ptr++ = b_cc(A64_CC_NE, 0);
-
-        *ptr++ = mov_reg(reg_dq, result);
-        if (reg_dr != reg_dq) {
-            *ptr++ = mov_reg(reg_dr, tmp);
+            *ptr++ = mov_reg(tmp, reg_dq);
+            ptr = EMIT_DivConst(ptr, quot, tmp, divisor);
         }
 
-        *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
+        if (reg_dr != reg_dq)
+            *ptr++ = msub(reg_dr, reg_dq, quot, reg_q);
+        *ptr++ = mov_reg(reg_dq, quot);
 
         RA_FreeARMRegister(&ptr, tmp);
-        RA_FreeARMRegister(&ptr, tmp2);
-        RA_FreeARMRegister(&ptr, result);
+        RA_FreeARMRegister(&ptr, quot);
     }
     else
+#endif
     {
-        if (reg_dr == reg_dq)
+        // Load divisor
+        ptr = EMIT_LoadFromEffectiveAddress(ptr, 4, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
+        ptr = EMIT_FlushPC(ptr);
+        RA_GetCC(&ptr);
+
+        // Check if division by 0
+        uint32_t *tmp_ptr = ptr;
+        *ptr++ = cbnz(reg_q, 2);
+
+        if (1)
         {
-            if (sig)
-                *ptr++ = sdiv(reg_dq, reg_dq, reg_q);
-            else
-                *ptr++ = udiv(reg_dq, reg_dq, reg_q);
+            /*
+                This is a point of no return. Issue division by zero exception here
+            */
+            *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
+
+            ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
+
+            RA_StoreDirtyFPURegs(&ptr);
+            RA_StoreDirtyM68kRegs(&ptr);
+
+            RA_StoreCC(&ptr);
+            RA_StoreFPCR(&ptr);
+            RA_StoreFPSR(&ptr);
+        
+#if EMU68_INSN_COUNTER        
+            extern uint32_t insn_count;
+            if (insn_count_precise) {
+                uint8_t tmp = RA_AllocARMRegister(&ptr);
+                *ptr++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
+                if (insn_count & 0xffff0000) {
+                    *ptr++ = movk_immed_u16(tmp, insn_count >> 16, 1);
+                }
+                *ptr++ = fmov_from_reg(0, tmp);
+                *ptr++ = vadd_2d(30, 30, 0);
+
+                RA_FreeARMRegister(&ptr, tmp);
+            }
+#endif
+            /* Return here */
+#if EMU68_BLOCK_CHAINING
+            *ptr++ = mov64_immed_u16(0, 0, 0);
+#endif
+            *ptr++ = bx_lr();
         }
-        else
+        /* Update branch to the continuation */
+        *tmp_ptr = cbnz(reg_q, ptr - tmp_ptr);
+#if EMU68_COLD_STUBS
+        ptr = EMIT_ColdStub(tmp_ptr + 1, ptr);
+#endif
+
+        if (div64)
         {
             uint8_t tmp = RA_AllocARMRegister(&ptr);
+            uint8_t result = RA_AllocARMRegister(&ptr);
+            uint8_t tmp2 = RA_AllocARMRegister(&ptr);
+
+            // Use temporary result - in case of overflow destination regs remain unchanged
+            *ptr++ = mov_reg(tmp2, reg_dq);
+            *ptr++ = bfi64(tmp2, reg_dr, 32, 32);
 
             if (sig)
-                *ptr++ = sdiv(tmp, reg_dq, reg_q);
+            {
+                uint8_t q_ext = RA_AllocARMRegister(&ptr);
+                *ptr++ = sxtw64(q_ext, reg_q);
+                *ptr++ = sdiv64(result, tmp2, q_ext);
+                if (reg_dr != reg_dq)
+                    *ptr++ = msub64(tmp, tmp2, result, q_ext);
+                RA_FreeARMRegister(&ptr, q_ext);
+            }
             else
-                *ptr++ = udiv(tmp, reg_dq, reg_q);
+            {
+                *ptr++ = udiv64(result, tmp2, reg_q);
+                if (reg_dr != reg_dq)
+                    *ptr++ = msub64(tmp, tmp2, result, reg_q);
+            }
+
+            if (sig) {
+                *ptr++ = sxtw64(tmp2, result);
+            }
+            else {
+                *ptr++ = mov_reg(tmp2, result);
+            }
+            *ptr++ = cmp64_reg(tmp2, result, LSL, 0);
 
-            *ptr++ = msub(reg_dr, reg_dq, tmp, reg_q);
-            *ptr++ = mov_reg(reg_dq, tmp);
+            tmp_ptr = ptr;
+            *ptr++ = b_cc(A64_CC_NE, 0);
+
+            *ptr++ = mov_reg(reg_dq, result);
+            if (reg_dr != reg_dq) {
+                *ptr++ = mov_reg(reg_dr, tmp);
+            }
+
+            *tmp_ptr = b_cc(A64_CC_NE, ptr - tmp_ptr);
 
             RA_FreeARMRegister(&ptr, tmp);
+            RA_FreeARMRegister(&ptr, tmp2);
+            RA_FreeARMRegister(&ptr, result);
         }
-    }
+        else
+        {
+            if (reg_dr == reg_dq)
+            {
+                if (sig)
+                    *ptr++ = sdiv(reg_dq, reg_dq, reg_q);
+                else
+                    *ptr++ = udiv(reg_dq, reg_dq, reg_q);
+            }
+            else
+            {
+                uint8_t tmp = RA_AllocARMRegister(&ptr);
+
+                if (sig)
+                    *ptr++ = sdiv(tmp, reg_dq, reg_q);
+                else
+                    *ptr++ = udiv(tmp, reg_dq, reg_q);
+
+                *ptr++ = msub(reg_dr, reg_dq, tmp, reg_q);
+                *ptr++ = mov_reg(reg_dq, tmp);
 
+                RA_FreeARMRegister(&ptr, tmp);
+            }
+        }
+
+    }
     (*m68k_ptr) += ext_words;
 
     /* Set Dq dirty */
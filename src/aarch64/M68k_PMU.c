@@ -0,0 +1,82 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "M68k.h"
+
+#if EMU68_PMU_PROFILE
+
+/*
+    PMU profile. Event counters 0 to 3 are programmed with the events below, the cycle counter
+    runs anyway. The main loop reads all of them around every call of translated code and adds
+    the deltas to the slot of the m68k address the code was entered at (see ExecutionLoop.c).
+    Units are identified by address on purpose, the slots outlive evicted units.
+*/
+
+static const uint16_t pmu_events[PMU_COUNTERS - 1] = {
+    0x01,   /* L1I_CACHE_REFILL */
+    0x03,   /* L1D_CACHE_REFILL */
+    0x10,   /* BR_MIS_PRED */
+    0x05,   /* L1D_TLB_REFILL */
+};
+
+static const char * const pmu_names[PMU_COUNTERS] = {
+    "cycles", "L1I refill", "L1D refill", "br mispred", "DTLB refill"
+};
+
+int pmu_profile;
+struct PMUProfile pmu_state;
+
+void PMU_Init()
+{
+    uint64_t tmp;
+
+    asm volatile("mrs %0, PMCR_EL0":"=r"(tmp));
+
+    if (((tmp >> 11) & 31) < PMU_COUNTERS - 1)
+    {
+        kprintf("[BOOT] PMU profile needs %d event counters, CPU has %d only\n", PMU_COUNTERS - 1, (tmp >> 11) & 31);
+        pmu_profile = 0;
+        return;
+    }
+
+    asm volatile("msr PMEVTYPER0_EL0, %0"::"r"((uint64_t)pmu_events[0]));
+    asm volatile("msr PMEVTYPER1_EL0, %0"::"r"((uint64_t)pmu_events[1]));
+    asm volatile("msr PMEVTYPER2_EL0, %0"::"r"((uint64_t)pmu_events[2]));
+    asm volatile("msr PMEVTYPER3_EL0, %0"::"r"((uint64_t)pmu_events[3]));
+
+    /* Enable and reset event counters */
+    tmp |= 3;
+    asm volatile("msr PMCR_EL0, %0; isb"::"r"(tmp));
+    asm volatile("msr PMCNTENSET_EL0, %0; isb"::"r"(0x8000000fULL));
+
+    kprintf("[BOOT] PMU profile enabled, %d slots\n", EMU68_PMU_SLOTS);
+}
+
+void PMU_Dump()
+{
+    if (!pmu_profile)
+        return;
+
+    kprintf("[PMU] Units with most cycles (%d dropped):\n", pmu_state.pp_Dropped);
+    kprintf("[PMU]   address    entries %12s %12s %12s %12s %12s\n",
+        pmu_names[0], pmu_names[1], pmu_names[2], pmu_names[3], pmu_names[4]);
+
+    for (int i=0; i < EMU68_PMU_TOP && pmu_state.pp_Top[i]; i++)
+    {
+        struct PMUSlot *s = pmu_state.pp_Top[i];
+
+        kprintf("[PMU]   %08x %10d %12lld %12lld %12lld %12lld %12lld\n", s->pu_Address, s->pu_Entries,
+            s->pu_Count[0], s->pu_Count[1], s->pu_Count[2], s->pu_Count[3], s->pu_Count[4]);
+    }
+}
+
+#endif
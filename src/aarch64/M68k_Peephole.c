@@ -0,0 +1,358 @@
+/*
+    Copyright © 2020 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+
+#if EMU68_PEEPHOLE
+
+/*
+    Peephole pass over AArch64 code emitted for a single m68k instruction. The code of one
+    EmitINSN call is entered at its start only, as long as it holds no branches, literal
+    loads, adr/adrp and no exit markers. Such code may be compacted freely, anything else
+    is left untouched.
+
+    The pass tracks values known to be in registers: constants loaded with movz/movn and
+    fields of M68KState loaded or stored through the context register. Repeated loads are
+    removed or turned into register moves, adjacent accesses to the context are paired into
+    ldp/stp and 64-bit moves of a register to itself are dropped.
+*/
+
+#define FACT_MEM        1
+#define FACT_CONST      2
+#define MAX_FACTS       16
+
+struct Fact {
+    uint8_t     f_Kind;
+    uint8_t     f_Reg;
+    uint8_t     f_Size;
+    uint16_t    f_Offset;
+    uint32_t    f_Insn;
+};
+
+static struct Fact facts[MAX_FACTS];
+static int fact_count;
+
+static void KillReg(uint8_t reg)
+{
+    for (int i=0; i < fact_count; i++)
+    {
+        if (facts[i].f_Reg == reg)
+            facts[i--] = facts[--fact_count];
+    }
+}
+
+static void KillMem(uint32_t offset, uint32_t size)
+{
+    for (int i=0; i < fact_count; i++)
+    {
+        if (facts[i].f_Kind == FACT_MEM &&
+            facts[i].f_Offset < offset + size && offset < facts[i].f_Offset + (1U << facts[i].f_Size))
+        {
+            facts[i--] = facts[--fact_count];
+        }
+    }
+}
+
+static void KillAllMem()
+{
+    KillMem(0, 0x10000);
+}
+
+static void AddFact(uint8_t kind, uint8_t reg, uint8_t size, uint16_t offset, uint32_t insn)
+{
+    if (reg == 31)
+        return;
+
+    if (fact_count == MAX_FACTS)
+        facts[0] = facts[--fact_count];
+
+    facts[fact_count].f_Kind = kind;
+    facts[fact_count].f_Reg = reg;
+    facts[fact_count].f_Size = size;
+    facts[fact_count].f_Offset = offset;
+    facts[fact_count].f_Insn = insn;
+    fact_count++;
+}
+
+static struct Fact *FindMem(uint16_t offset, uint8_t size)
+{
+    for (int i=0; i < fact_count; i++)
+    {
+        if (facts[i].f_Kind == FACT_MEM && facts[i].f_Offset == offset && facts[i].f_Size == size)
+            return &facts[i];
+    }
+
+    return NULL;
+}
+
+static struct Fact *FindConst(uint32_t insn)
+{
+    for (int i=0; i < fact_count; i++)
+    {
+        if (facts[i].f_Kind == FACT_CONST && facts[i].f_Insn == insn)
+            return &facts[i];
+    }
+
+    return NULL;
+}
+
+static inline int IsLdStUImm(uint32_t insn)
+{
+    return (insn & 0x3f000000) == 0x39000000;
+}
+
+/*
+    Optimize code in range start..end. ctx is the register holding M68KState at start of
+    the range or 0xff. Returns new end of the code.
+*/
+uint32_t *M68K_Peephole(uint32_t *start, uint32_t *end, uint8_t ctx)
+{
+    uint32_t *out = start;
+    uint32_t *pair = NULL;
+    int escaped = 0;
+
+    /* Leave the code alone if it could be entered in the middle or carries data */
+    for (uint32_t *p = start; p < end; p++)
+    {
+        uint32_t insn = INSN_TO_LE(*p);
+
+        if ((insn & 0xfffffff0) == 0xfffffff0)
+            return end;
+        if ((insn & 0x1c000000) == 0x14000000 && (insn & 0xffc00000) != 0xd5000000)
+            return end;
+        if ((insn & 0x1f000000) == 0x10000000 || (insn & 0x3b000000) == 0x18000000)
+            return end;
+        if ((insn & 0x18000000) == 0)
+            return end;
+    }
+
+    fact_count = 0;
+
+    for (uint32_t *p = start; p < end; p++)
+    {
+        uint32_t insn = INSN_TO_LE(*p);
+        uint8_t rd = insn & 31;
+        uint8_t rn = (insn >> 5) & 31;
+
+        /* mrs xN, TPIDRRO_EL0 */
+        if ((insn & 0xffffffe0) == 0xd53bd060)
+        {
+            if (ctx == rd)
+                continue;
+
+            KillReg(rd);
+            ctx = rd;
+            pair = NULL;
+            *out++ = *p;
+            continue;
+        }
+
+        /* Other system instructions */
+        if ((insn & 0xffc00000) == 0xd5000000)
+        {
+            /* mrs writes Rt, the rest may change the state of context in any way */
+            if ((insn & 0xfff00000) == 0xd5300000)
+            {
+                KillReg(rd);
+                if (rd == ctx)
+                    ctx = 0xff;
+            }
+            else
+            {
+                fact_count = 0;
+            }
+
+            pair = NULL;
+            *out++ = *p;
+            continue;
+        }
+
+        /* Loads and stores */
+        if ((insn & 0x0a000000) == 0x08000000)
+        {
+            if (IsLdStUImm(insn) && rn == ctx)
+            {
+                uint8_t size = insn >> 30;
+                uint8_t opc = (insn >> 22) & 3;
+                uint16_t offset = ((insn >> 10) & 0xfff) << size;
+
+                if (opc == 1)
+                {
+                    struct Fact *f = FindMem(offset, size);
+
+                    if (f && f->f_Reg == rd)
+                        continue;
+
+                    if (f && rd != 31)
+                    {
+                        uint8_t src = f->f_Reg;
+
+                        KillReg(rd);
+                        if (rd == ctx)
+                            ctx = 0xff;
+                        AddFact(FACT_MEM, rd, size, offset, 0);
+
+                        pair = NULL;
+                        *out++ = (size == 3) ? mov64_reg(rd, src) : mov_reg(rd, src);
+                        continue;
+                    }
+
+                    /* ldr A, [ctx, #o] followed by ldr B, [ctx, #o +- size] */
+                    if (pair && size >= 2)
+                    {
+                        uint32_t prev = INSN_TO_LE(*pair);
+                        uint8_t prev_rt = prev & 31;
+                        uint16_t prev_offset = ((prev >> 10) & 0xfff) << size;
+
+                        if ((prev & 0xffc00000) == (insn & 0xffc00000) && prev_rt != rd && prev_rt != 31 && rd != 31)
+                        {
+                            uint16_t low = (prev_offset < offset) ? prev_offset : offset;
+
+                            if ((prev_offset + (1U << size) == offset || offset + (1U << size) == prev_offset) && (low >> size) < 64)
+                            {
+                                uint8_t r1 = (prev_offset < offset) ? prev_rt : rd;
+                                uint8_t r2 = (prev_offset < offset) ? rd : prev_rt;
+
+                                *pair = (size == 3) ? ldp64(ctx, r1, r2, low) : ldp(ctx, r1, r2, low);
+
+                                KillReg(rd);
+                                if (rd == ctx)
+                                    ctx = 0xff;
+                                AddFact(FACT_MEM, rd, size, offset, 0);
+                                pair = NULL;
+                                continue;
+                            }
+                        }
+                    }
+
+                    KillReg(rd);
+                    AddFact(FACT_MEM, rd, size, offset, 0);
+
+                    pair = (rd == ctx) ? NULL : out;
+                    if (rd == ctx)
+                        ctx = 0xff;
+                    *out++ = *p;
+                    continue;
+                }
+                else if (opc == 0)
+                {
+                    if (rd == ctx)
+                        escaped = 1;
+
+                    KillMem(offset, 1U << size);
+
+                    /* str A, [ctx, #o] followed by str B, [ctx, #o +- size] */
+                    if (pair && size >= 2)
+                    {
+                        uint32_t prev = INSN_TO_LE(*pair);
+                        uint16_t prev_offset = ((prev >> 10) & 0xfff) << size;
+
+                        if ((prev & 0xffc00000) == (insn & 0xffc00000))
+                        {
+                            uint16_t low = (prev_offset < offset) ? prev_offset : offset;
+
+                            if ((prev_offset + (1U << size) == offset || offset + (1U << size) == prev_offset) && (low >> size) < 64)
+                            {
+                                uint8_t r1 = (prev_offset < offset) ? (prev & 31) : rd;
+                                uint8_t r2 = (prev_offset < offset) ? rd : (prev & 31);
+
+                                *pair = (size == 3) ? stp64(ctx, r1, r2, low) : stp(ctx, r1, r2, low);
+
+                                if (size >= 2)
+                                    AddFact(FACT_MEM, rd, size, offset, 0);
+                                pair = NULL;
+                                continue;
+                            }
+                        }
+                    }
+
+                    if (size >= 2)
+                        AddFact(FACT_MEM, rd, size, offset, 0);
+
+                    pair = out;
+                    *out++ = *p;
+                    continue;
+                }
+            }
+
+            /* Any other access. Only the unsigned offset form is known not to write back */
+            if (IsLdStUImm(insn) && ((insn >> 22) & 3) == 0)
+            {
+                if (rd == ctx)
+                    escaped = 1;
+                if (escaped)
+                    KillAllMem();
+            }
+            else if (IsLdStUImm(insn) && (insn & 0x04000000) == 0)
+            {
+                KillReg(rd);
+                if (rd == ctx)
+                    ctx = 0xff;
+            }
+            else
+            {
+                uint8_t rt2 = (insn >> 10) & 31;
+                uint8_t rs = (insn >> 16) & 31;
+
+                /* Pairs, writeback, register offsets, exclusives and atomics. Assume all fields are written */
+                if (rd == ctx || rt2 == ctx || rs == ctx)
+                    escaped = 1;
+                if (rn == ctx || escaped)
+                    KillAllMem();
+
+                KillReg(rd);
+                KillReg(rt2);
+                KillReg(rs);
+                KillReg(rn);
+                if (rd == ctx || rt2 == ctx || rs == ctx || rn == ctx)
+                    ctx = 0xff;
+            }
+
+            pair = NULL;
+            *out++ = *p;
+            continue;
+        }
+
+        /* Data processing and SIMD. Context register passed to any of them escapes */
+        if (ctx != 0xff && (rn == ctx || ((insn >> 16) & 31) == ctx || ((insn >> 10) & 31) == ctx))
+            escaped = 1;
+
+        /* mov xN, xN */
+        if ((insn & 0xffe0ffe0) == 0xaa0003e0 && ((insn >> 16) & 31) == rd)
+            continue;
+
+        /* movz and movn have no inputs. Same instruction gives same value */
+        if ((insn & 0x1f800000) == 0x12800000 && (((insn >> 29) & 3) == 0 || ((insn >> 29) & 3) == 2))
+        {
+            if (FindConst(insn))
+                continue;
+
+            KillReg(rd);
+            if (rd == ctx)
+                ctx = 0xff;
+            AddFact(FACT_CONST, rd, 0, 0, insn);
+
+            pair = NULL;
+            *out++ = *p;
+            continue;
+        }
+
+        KillReg(rd);
+        if (rd == ctx)
+            ctx = 0xff;
+
+        pair = NULL;
+        *out++ = *p;
+    }
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "M68k.h"
+
+#ifdef PISTORM
+#include "ps_protocol.h"
+#endif
+
+#if EMU68_PROFILER
+
+/*
+    Sampling profiler running on CPU1. At EMU68_PROFILER_HZ the emulation core is asked by
+    SGI for the ARM address it executes at. The handler only stores ELR and REG_PC, the ARM
+    address is resolved here to the translation unit and, through the PC map, to m68k PC of
+    the instruction. Without GIC the m68k PC of the unit last entered through main loop is
+    sampled instead, chained units are not visible in that case.
+
+    Samples are counted per m68k PC and per unit in two open addressed tables. Setting
+    JC2F_PROFILE_DUMP prints the top entries and starts over. Addresses are absolute, they
+    can be resolved against symbols of a Hunk file if its load address is known.
+*/
+
+extern struct M68KState *__m68k_state;
+
+struct ProfileSlot {
+    uint32_t    pf_Address;
+    uint32_t    pf_Count;
+};
+
+volatile struct ProfileSample prof_sample;
+volatile uint32_t prof_mirror_pc;
+
+#if EMU68_INSN_COUNTER_SAMPLED
+volatile uint64_t insn_count_sampled;
+static uint32_t last_retired;
+static uint32_t have_retired;
+static uint32_t sampled_count_warned;
+#endif
+
+static struct ProfileSlot pc_hist[EMU68_PROFILER_SLOTS];
+static struct ProfileSlot unit_hist[EMU68_PROFILER_SLOTS];
+static uint32_t total_samples;
+static uint32_t outside_samples;
+static uint32_t lost_samples;
+static uint32_t dropped_samples;
+
+static inline uint64_t prof_cntpct()
+{
+    uint64_t value;
+    asm volatile("isb; mrs %0, CNTPCT_EL0":"=r"(value));
+    return value;
+}
+
+static void Count(struct ProfileSlot *hist, uint32_t address)
+{
+    uint32_t slot = (address >> 1) * 0x9e3779b1;
+
+    for (int i=0; i < EMU68_PROFILER_SLOTS; i++)
+    {
+        struct ProfileSlot *s = &hist[(slot + i) & (EMU68_PROFILER_SLOTS - 1)];
+
+        if (s->pf_Count == 0)
+            s->pf_Address = address;
+
+        if (s->pf_Address == address)
+        {
+            s->pf_Count++;
+            return;
+        }
+    }
+
+    dropped_samples++;
+}
+
+#if EMU68_INSN_COUNTER_SAMPLED
+/*
+    Called on the emulation core before the first translation. PMU event counter 4 counts ARM
+    instructions retired, the SGI handler stores it with every sample
+*/
+void M68K_InsnSampleInit()
+{
+    uint64_t tmp;
+
+    asm volatile("mrs %0, PMCR_EL0":"=r"(tmp));
+
+    if (((tmp >> 11) & 31) < 5)
+    {
+        kprintf("[PROF] Sampled instruction count needs 5 PMU event counters, counting precisely\n");
+        insn_count_precise = 1;
+        return;
+    }
+
+    asm volatile("msr PMEVTYPER4_EL0, %0"::"r"(0x08ULL));   /* INST_RETIRED */
+    tmp |= 1;
+    asm volatile("msr PMCR_EL0, %0; isb"::"r"(tmp));
+    asm volatile("msr PMCNTENSET_EL0, %0; isb"::"r"(1ULL << 4));
+
+    kprintf("[PROF] m68k instruction count sampled at %d Hz\n", EMU68_PROFILER_HZ);
+}
+
+/* Instructions retired since previous sample are attributed to the unit sampled now */
+static void AccountSample()
+{
+    uint32_t retired = prof_sample.ps_Retired;
+    uint32_t delta = retired - last_retired;
+
+    last_retired = retired;
+
+    /* First sample only sets the base */
+    if (have_retired)
+        insn_count_sampled += ((uint64_t)delta * M68K_CodeDensity(prof_sample.ps_ARM)) >> 16;
+
+    have_retired = 1;
+}
+#endif
+
+static void TakeSample(uint32_t freq, int profile)
+{
+    uint64_t seq = prof_sample.ps_Seq;
+    uint32_t unit = 0;
+    uint32_t pc = 0;
+    int requested = 0;
+
+#ifdef PISTORM
+    requested = ps_ipl_sgi_sample();
+#endif
+
+    if (requested)
+    {
+        /* The emulation core may have interrupts masked for a while, do not wait longer than 100us */
+        uint64_t timeout = prof_cntpct() + freq / 10000;
+
+        while (prof_sample.ps_Seq == seq)
+        {
+            if (prof_cntpct() > timeout)
+            {
+                lost_samples++;
+                return;
+            }
+        }
+
+#if EMU68_INSN_COUNTER_SAMPLED
+        if (!insn_count_precise)
+            AccountSample();
+#endif
+
+        if (!profile)
+            return;
+
+        unit = M68K_ResolveCodeAddress(prof_sample.ps_ARM, &pc);
+
+        /* Dispatcher or C code, e.g. bus emulation. REG_PC is the last m68k PC known */
+        if (unit == 0)
+        {
+            outside_samples++;
+            pc = prof_sample.ps_PC;
+        }
+    }
+    else
+    {
+#if EMU68_INSN_COUNTER_SAMPLED
+        /* Without samples of the ARM address there is nothing to estimate from */
+        if (!insn_count_precise && !sampled_count_warned)
+        {
+            kprintf("[PROF] No SGI samples, m68k instruction count is not updated\n");
+            sampled_count_warned = 1;
+        }
+#endif
+        if (!profile)
+            return;
+
+        unit = pc = prof_mirror_pc;
+    }
+
+    total_samples++;
+    Count(pc_hist, pc);
+    if (unit)
+        Count(unit_hist, unit);
+}
+
+static void DumpTop(const char *title, struct ProfileSlot *hist)
+{
+    kprintf("[PROF] Top %s:\n", title);
+
+    for (int n=0; n < EMU68_PROFILER_TOP; n++)
+    {
+        struct ProfileSlot *best = NULL;
+
+        for (int i=0; i < EMU68_PROFILER_SLOTS; i++)
+        {
+            if (hist[i].pf_Count != 0 && (best == NULL || hist[i].pf_Count > best->pf_Count))
+                best = &hist[i];
+        }
+
+        if (best == NULL)
+            break;
+
+        uint32_t permille = (1000ULL * best->pf_Count) / total_samples;
+        kprintf("[PROF]   %08x %8d %3d.%d%%\n", best->pf_Address, best->pf_Count, permille / 10, permille % 10);
+
+        /* Taken out of the table, it is cleared after dump anyway */
+        best->pf_Count = 0;
+    }
+}
+
+static void Dump()
+{
+    kprintf("[PROF] %d samples, %d outside of translated code, %d lost, %d dropped\n",
+        total_samples, outside_samples, lost_samples, dropped_samples);
+
+    if (total_samples)
+    {
+        DumpTop("m68k PCs", pc_hist);
+        DumpTop("translation units", unit_hist);
+    }
+
+    for (int i=0; i < EMU68_PROFILER_SLOTS; i++)
+    {
+        pc_hist[i].pf_Count = 0;
+        unit_hist[i].pf_Count = 0;
+    }
+
+    total_samples = outside_samples = lost_samples = dropped_samples = 0;
+}
+
+void M68K_ProfilerTask()
+{
+    uint64_t freq;
+    uint64_t next;
+    uint32_t prev_ctrl = 0;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+    freq &= 0xffffffff;
+
+    kprintf("[PROF] Profiler on CPU1, %d samples per second\n", EMU68_PROFILER_HZ);
+
+    while (__atomic_load_n(&__m68k_state, __ATOMIC_ACQUIRE) == NULL)
+        asm volatile("yield");
+
+    next = prof_cntpct();
+
+    while(1)
+    {
+        uint32_t ctrl = __atomic_load_n(&__m68k_state->JIT_CONTROL2, __ATOMIC_RELAXED);
+
+        /* Dump is requested by setting the bit, the task does not write to JIT_CONTROL2 */
+        if ((ctrl & ~prev_ctrl) & JC2F_PROFILE_DUMP)
+            Dump();
+
+        if (ctrl & JC2F_PROFILE)
+            TakeSample(freq, 1);
+#if EMU68_INSN_COUNTER_SAMPLED
+        else if (!insn_count_precise)
+            TakeSample(freq, 0);
+#endif
+
+        prev_ctrl = ctrl;
+
+        next += freq / EMU68_PROFILER_HZ;
+        while (prof_cntpct() < next)
+            asm volatile("yield");
+    }
+}
+
+#endif
@@ -28,7 +28,7 @@ uint8_t SR_GetEALength(uint16_t *insn_stream, uint8_t ea, uint8_t imm_size)
         else if (mode == 6 || (mode == 7 && reg == 3))
         {
             /* Reg- or PC-relative addressing mode */
-            uint16_t brief = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+            uint16_t brief = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[0]);
 
             /* Brief word is here */
             word_count++;
@@ -97,7 +97,7 @@ uint8_t SR_GetEALength(uint16_t *insn_stream, uint8_t ea, uint8_t imm_size)
 /* Check if opcode is of branch kind or may result in a */
 int M68K_IsBranch(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[0]);
 
     if (
         opcode == 0x007c            ||
@@ -126,9 +126,36 @@ int M68K_IsBranch(uint16_t *insn_stream)
         return 0;
 }
 
+/*
+    Check if the subroutine runs straight into RTS within budget instructions. Any other
+    change of flow, LINE A traps and F-line instructions make it a non-leaf
+*/
+int M68K_IsLeafRoutine(uint16_t *insn_stream, int budget)
+{
+    for (int i=0; i < budget; i++)
+    {
+        uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[0]);
+        int length;
+
+        if (opcode == 0x4e75)
+            return 1;
+
+        if ((opcode & 0xf000) == 0xa000 || (opcode & 0xf000) == 0xf000 || M68K_IsBranch(insn_stream))
+            return 0;
+
+        length = M68K_GetINSNLength(insn_stream);
+        if (length <= 0)
+            return 0;
+
+        insn_stream += length;
+    }
+
+    return 0;
+}
+
 int M68K_GetMoveLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[0]);
     int size = 0;
     int length = 1;
     uint8_t ea = opcode & 0x3f;
@@ -152,8 +179,8 @@ int M68K_GetMoveLength(uint16_t *insn_stream)
 
 int M68K_GetLineFLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);;
+    uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode2 = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[1]);;
     int length = 1;
     int need_ea = 0;
     int opsize = 0;
@@ -769,9 +796,9 @@ int M68K_GetLineFLength(uint16_t *insn_stream)
 }
 
 /* Get number of 16-bit words this instruction occupies */
-int M68K_GetINSNLength(uint16_t *insn_stream)
+static int DecodeINSNLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)&insn_stream[0]);
     int length = 0;
 
     switch(opcode & 0xf000)
@@ -857,212 +884,300 @@ static SR_Check SRCheck[16] = {
 };
 
 extern struct M68KState *__m68k_state;
+extern uint32_t jit_control2;
 
-/* Get the mask of status flags changed by the instruction specified by the opcode */
-uint8_t M68K_GetSRMask(uint16_t *insn_stream)
+/*
+    Decode table. Every instruction the translator, the emitters or the liveness analysis look
+    at is decoded once per translation into sr_insns, with its length, SR needs and sets and the
+    branch target if known. Entries are found through a small open addressed hash.
+
+    Condition code liveness works on the same entries. The first query for an instruction
+    discovers the region reachable from it, following BRA, BSR, absolute JMP and JSR and both
+    paths of Bcc, and solves live-out flags of the region by backwards fixpoint. Each later
+    query is a lookup. Unknown control flow and instructions beyond the exploration budget
+    make all flags live.
+*/
+#define SR_SUCC_NONE    0xffff
+#define SR_SUCC_EXIT    0xfffe
+#define SR_HASH_EMPTY   0xffff
+
+#define SR_STATE_DECODED    0
+#define SR_STATE_PENDING    1
+#define SR_STATE_SOLVED     2
+
+static struct M68KDecodedInsn sr_insns[EMU68_CCR_LIVE_NODES];
+static uint16_t sr_hash[EMU68_CCR_LIVE_NODES * 2];
+static uint16_t sr_stack[EMU68_CCR_LIVE_NODES];
+static uint16_t sr_region[EMU68_CCR_LIVE_NODES];
+static uint32_t sr_count;
+static int sr_hash_ready;
+
+/* Forget all entries, called at start of every translation. Only used hash slots are cleared */
+void M68K_ResetCCRLiveness()
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
-    int scan_depth = 0;
-    const int max_scan_depth = (__m68k_state->JIT_CONTROL2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
-    uint8_t mask = 0;
-    uint8_t needed = 0;
-    uint8_t tmp_sets = 0;
-    uint8_t tmp_needs = 0;
+    if (!sr_hash_ready)
+    {
+        for (int i=0; i < EMU68_CCR_LIVE_NODES * 2; i++)
+            sr_hash[i] = SR_HASH_EMPTY;
+        sr_hash_ready = 1;
+    }
 
-    D(kprintf("[JIT] GetSRMask, opcode %04x @ %08x, ", opcode, insn_stream));
+    for (uint32_t i=0; i < sr_count; i++)
+        sr_hash[sr_insns[i].di_Slot] = SR_HASH_EMPTY;
 
-    uint32_t flags = SRCheck[opcode >> 12](opcode);
-    mask = flags & 0x1f;
-    tmp_sets = flags & 0x1f;
-    tmp_needs = (flags >> 16) & 0x1f;
-
-    D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
-
-    /*
-        Check as long as there are still some flags to be set by the opcode and the depth
-        of scan is not exceeded
-    */
-    while(mask != 0 && scan_depth < max_scan_depth)
-    {      
-        /* Increase scan depth level */
-        scan_depth++;
-
-        /* If instruction is a branch break the scan */
-        if (M68K_IsBranch(insn_stream))
-        {
-            /* Check if BRA/BSR and follow if possible */
-            if ((opcode & 0xfe00) == 0x6000)
-            {
-                int32_t branch_offset = (int8_t)(opcode & 0xff);
-
-                if ((opcode & 0xff) == 0) {
-                    branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                } else if ((opcode & 0xff) == 0xff) {
-                    uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
-                    branch_offset = lo16 | (hi16 << 16);
-                }
+    sr_count = 0;
+}
 
-                insn_stream = insn_stream + 1 + (branch_offset >> 1);
+/* Find entry of given address. If there is none, slot where it belongs is returned in *slot */
+static uint16_t SR_Find(uint16_t *pc, uint16_t *slot)
+{
+    uint32_t h = ((uintptr_t)pc >> 1) & (EMU68_CCR_LIVE_NODES * 2 - 1);
 
-                D(kprintf("[JIT]   %02d: PC-relative jump by %d bytes to %08x\n", scan_depth, branch_offset, insn_stream));
-            }
-            /* Check if JMP/JSR and follow if possible */
-            else if ((opcode & 0xffbe) == 0x4eb8)
-            {
-                if (opcode & 1) {
-                    uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
-                    insn_stream = (uint16_t*)(uintptr_t)(lo16 | (hi16 << 16));
-                } else {
-                    insn_stream = (uint16_t*)(uintptr_t)((uint32_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]));
-                }
+    while (sr_hash[h] != SR_HASH_EMPTY)
+    {
+        if (sr_insns[sr_hash[h]].di_PC == pc)
+            return sr_hash[h];
 
-                D(kprintf("[JIT]   %02d: Absolute jump to %08x\n", scan_depth, insn_stream));
-            }
-            else if ((opcode & 0xf000) == 0x6000)
-            {
-                int32_t branch_offset = (int8_t)(opcode & 0xff);
-                uint16_t *insn_stream_2 = insn_stream + 1;
-
-                // Mark the flags which conditional jump needs by itself
-                needed |= mask & (SRCheck[opcode >> 12](opcode) >> 16);
-
-                if ((opcode & 0xff) == 0) {
-                    branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    insn_stream_2++;
-                } else if ((opcode & 0xff) == 0xff) {
-                    uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
-                    branch_offset = lo16 | (hi16 << 16);
-                    insn_stream_2+=2;
-                }
+        h = (h + 1) & (EMU68_CCR_LIVE_NODES * 2 - 1);
+    }
 
-                insn_stream = insn_stream + 1 + (branch_offset >> 1);
+    *slot = h;
 
-                D(kprintf("[JIT]   %02d: Splitting into two paths %08x and %08x\n", scan_depth, insn_stream, insn_stream_2));
+    return SR_HASH_EMPTY;
+}
 
-                uint8_t mask1 = mask;
-                uint8_t mask2 = mask;
-                uint8_t needed1 = needed;
-                uint8_t needed2 = needed;
-                int scan_depth_tmp = scan_depth;
+static void SR_DecodeFlow(struct M68KDecodedInsn *d)
+{
+    uint16_t *pc = d->di_PC;
+    uint16_t opcode = d->di_Opcode;
 
-                while(mask1 && scan_depth < max_scan_depth)
-                {
-                    scan_depth++;
+    d->di_Target = NULL;
 
-                    /* If instruction is a branch break the scan */
-                    if (M68K_IsBranch(insn_stream))
-                        break;
+    if (!M68K_IsBranch(pc))
+    {
+        d->di_Flow = DI_FLOW_NEXT;
+    }
+    /* Bcc, BRA and BSR */
+    else if ((opcode & 0xf000) == 0x6000)
+    {
+        int32_t branch_offset = (int8_t)(opcode & 0xff);
+
+        if ((opcode & 0xff) == 0) {
+            branch_offset = (int16_t)cache_fetch_16((uint32_t)(uintptr_t)&pc[1]);
+        } else if ((opcode & 0xff) == 0xff) {
+            uint16_t lo16, hi16;
+            hi16 = cache_fetch_16((uint32_t)(uintptr_t)&pc[1]);
+            lo16 = cache_fetch_16((uint32_t)(uintptr_t)&pc[2]);
+            branch_offset = lo16 | (hi16 << 16);
+        }
 
-                    /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+        d->di_Target = pc + 1 + (branch_offset >> 1);
+        d->di_Flow = ((opcode & 0xfe00) == 0x6000) ? DI_FLOW_JUMP : DI_FLOW_COND;
+    }
+    /* JMP and JSR to absolute address */
+    else if ((opcode & 0xffbe) == 0x4eb8)
+    {
+        if (opcode & 1) {
+            uint16_t lo16, hi16;
+            hi16 = cache_fetch_16((uint32_t)(uintptr_t)&pc[1]);
+            lo16 = cache_fetch_16((uint32_t)(uintptr_t)&pc[2]);
+            d->di_Target = (uint16_t*)(uintptr_t)(lo16 | (hi16 << 16));
+        } else {
+            d->di_Target = (uint16_t*)(uintptr_t)((uint32_t)cache_fetch_16((uint32_t)(uintptr_t)&pc[1]));
+        }
 
-                    D(kprintf("[JIT]   %02d.1: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream));
+        d->di_Flow = DI_FLOW_JUMP;
+    }
+    else
+    {
+        d->di_Flow = DI_FLOW_UNKNOWN;
+    }
+}
 
-                    uint32_t flags = SRCheck[opcode >> 12](opcode);
-                    tmp_sets = flags & 0x1f;
-                    tmp_needs = (flags >> 16) & 0x1f;
+static uint16_t SR_Decode(uint16_t *pc)
+{
+    uint16_t slot;
+    uint16_t idx = SR_Find(pc, &slot);
 
-                    D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
+    if (idx != SR_HASH_EMPTY)
+        return idx;
 
-                    /* If instruction *needs* one of flags from current opcode, break the check and return mask */
-                    if (mask1 & tmp_needs) {
-                        needed1 |= (mask1 & tmp_needs);
-                    }
+    if (sr_count == EMU68_CCR_LIVE_NODES)
+        return SR_HASH_EMPTY;
 
-                    /* Clear flags which this instruction sets */
-                    mask1 = mask1 & ~tmp_sets;
+    struct M68KDecodedInsn *d = &sr_insns[sr_count];
+    uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)pc);
+    uint32_t flags = SRCheck[opcode >> 12](opcode);
 
-                    if ((mask1 & tmp_needs) == mask1) {
-                        break;
-                    }
+    d->di_PC = pc;
+    d->di_Opcode = opcode;
+    d->di_Length = DecodeINSNLength(pc);
+    d->di_SRSets = flags & SR_CCR;
+    d->di_SRNeeds = (flags >> 16) & SR_CCR;
+    d->di_LiveOut = 0;
+    d->di_State = SR_STATE_DECODED;
+    d->di_Slot = slot;
+    d->di_Succ[0] = SR_SUCC_NONE;
+    d->di_Succ[1] = SR_SUCC_NONE;
+    d->di_LocalState = -1;
+    SR_DecodeFlow(d);
+
+    sr_hash[slot] = sr_count;
+
+    return sr_count++;
+}
 
-                    /* Advance to subsequent instruction */
-                    insn_stream += M68K_GetINSNLength(insn_stream);
-                }
+/* Get decoded instruction at pc, NULL if the table is full */
+struct M68KDecodedInsn *M68K_DecodeInsn(uint16_t *pc)
+{
+    uint16_t idx = SR_Decode(pc);
 
-                scan_depth = scan_depth_tmp;
+    return (idx == SR_HASH_EMPTY) ? NULL : &sr_insns[idx];
+}
 
-                while(mask2 && scan_depth < max_scan_depth)
-                {
-                    scan_depth++;
+int M68K_GetINSNLength(uint16_t *insn_stream)
+{
+    struct M68KDecodedInsn *d = M68K_DecodeInsn(insn_stream);
 
-                    /* If instruction is a branch break the scan */
-                    if (M68K_IsBranch(insn_stream_2))
-                        break;
+    return d ? d->di_Length : DecodeINSNLength(insn_stream);
+}
 
-                    /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream_2);
+/* Decode the length from memory, without the table. May be used without translator lock */
+int M68K_DecodeINSNLength(uint16_t *insn_stream)
+{
+    return DecodeINSNLength(insn_stream);
+}
 
-                    D(kprintf("[JIT]   %02d.2: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream_2));
+static inline uint8_t SR_LiveIn(uint16_t idx)
+{
+    if (idx == SR_SUCC_EXIT)
+        return SR_CCR;
+    if (idx == SR_SUCC_NONE)
+        return 0;
 
-                    uint32_t flags = SRCheck[opcode >> 12](opcode);
-                    tmp_sets = flags & 0x1f;
-                    tmp_needs = (flags >> 16) & 0x1f;
+    return sr_insns[idx].di_SRNeeds | (sr_insns[idx].di_LiveOut & ~sr_insns[idx].di_SRSets);
+}
 
-                    D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
+/* Discover the region reachable from the instruction and solve liveness for it */
+static void SR_Solve(uint16_t root, uint32_t budget)
+{
+    uint32_t region = 0;
+    uint32_t sp = 0;
 
-                    /* If instruction *needs* one of flags from current opcode, break the check and return mask */
-                    if (mask2 & tmp_needs) {
-                        needed2 |= (mask2 & tmp_needs);
-                    }
+    sr_insns[root].di_State = SR_STATE_PENDING;
+    sr_region[region++] = root;
+    sr_stack[sp++] = root;
 
-                    /* Clear flags which this instruction sets */
-                    mask2 = mask2 & ~tmp_sets;
+    while (sp != 0)
+    {
+        struct M68KDecodedInsn *d = &sr_insns[sr_stack[--sp]];
+        uint16_t *succ[2];
+        int count = 0;
 
-                    if ((mask2 & tmp_needs) == mask2) {
-                        break;
-                    }
+        switch (d->di_Flow)
+        {
+            case DI_FLOW_NEXT:
+                succ[count++] = d->di_PC + d->di_Length;
+                break;
+            case DI_FLOW_JUMP:
+                succ[count++] = d->di_Target;
+                break;
+            case DI_FLOW_COND:
+                succ[count++] = d->di_Target;
+                succ[count++] = d->di_PC + d->di_Length;
+                break;
+            default:
+                d->di_Succ[0] = SR_SUCC_EXIT;
+                break;
+        }
 
-                    /* Advance to subsequent instruction */
-                    insn_stream_2 += M68K_GetINSNLength(insn_stream_2);
-                }
+        for (int i=0; i < count; i++)
+        {
+            uint16_t slot;
+            uint16_t idx = SR_Find(succ[i], &slot);
 
-                D(kprintf("[JIT]   joining masks %x and %x to %x\n", mask1 | needed1, mask2 | needed2, mask1 | needed1 | mask2 | needed2));
+            if (idx == SR_HASH_EMPTY && region < budget)
+                idx = SR_Decode(succ[i]);
 
-                return mask1 | needed1 | mask2 | needed2;
+            /* Instructions not solved and not explored are of unknown liveness */
+            if (idx == SR_HASH_EMPTY || (sr_insns[idx].di_State == SR_STATE_DECODED && region >= budget))
+            {
+                d->di_Succ[i] = SR_SUCC_EXIT;
+                continue;
             }
-            else 
+
+            d->di_Succ[i] = idx;
+
+            if (sr_insns[idx].di_State == SR_STATE_DECODED)
             {
-                D(kprintf("[JIT]   %02d: check breaks on branch\n", scan_depth));
-                break;
+                sr_insns[idx].di_State = SR_STATE_PENDING;
+                sr_region[region++] = idx;
+                sr_stack[sp++] = idx;
             }
         }
-        else          
-        {
-            /* Advance to subsequent instruction */
-            insn_stream += M68K_GetINSNLength(insn_stream);
-        }
-        
-        /* Get opcode */
-        opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
-        D(kprintf("[JIT]   %02d: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream));
+    }
 
-        uint32_t flags = SRCheck[opcode >> 12](opcode);
-        tmp_sets = flags & 0x1f;
-        tmp_needs = (flags >> 16) & 0x1f;
+    /* Entries of earlier regions are final, iterate over the new ones until nothing changes */
+    int changed;
+    do
+    {
+        changed = 0;
 
-        D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
+        for (uint32_t i = region; i-- > 0;)
+        {
+            struct M68KDecodedInsn *d = &sr_insns[sr_region[i]];
+            uint8_t live = SR_LiveIn(d->di_Succ[0]) | SR_LiveIn(d->di_Succ[1]);
 
-        /* If instruction *needs* one of flags from current opcode, break the check and return mask */
-        if (mask & tmp_needs) {
-            needed |= (mask & tmp_needs);
+            if (live != d->di_LiveOut)
+            {
+                d->di_LiveOut = live;
+                changed = 1;
+            }
         }
+    } while (changed);
 
-        /* Clear flags which this instruction sets */
-        mask = mask & ~tmp_sets;
+    for (uint32_t i=0; i < region; i++)
+        sr_insns[sr_region[i]].di_State = SR_STATE_SOLVED;
+}
 
-        if ((mask & tmp_needs) == mask) {
-            break;
-        }
+/* Get the mask of status flags changed by the instruction which are used later */
+uint8_t M68K_GetSRMask(uint16_t *insn_stream)
+{
+    const uint32_t scan_depth = (jit_control2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
+    struct M68KDecodedInsn *d = M68K_DecodeInsn(insn_stream);
+
+    D(kprintf("[JIT] GetSRMask @ %08x\n", insn_stream));
+
+    /* No room for the instruction or optimization disabled, all flags are used */
+    if (d == NULL)
+    {
+        uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)insn_stream);
+        return SRCheck[opcode >> 12](opcode) & SR_CCR;
     }
 
-    D(kprintf("[JIT] GetSRMask returns %x\n", mask | needed));
+    if (scan_depth == 0)
+        return d->di_SRSets;
+
+    if (d->di_State != SR_STATE_SOLVED)
+        SR_Solve(d - sr_insns, scan_depth * EMU68_CCR_LIVE_STEP);
+
+    D(kprintf("[JIT] GetSRMask returns %x\n", d->di_SRSets & d->di_LiveOut));
+
+    return d->di_SRSets & d->di_LiveOut;
+}
+
+/* Get the mask of status flags which are used after the instruction */
+uint8_t M68K_GetSRLiveOut(uint16_t *insn_stream)
+{
+    const uint32_t scan_depth = (jit_control2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
+    struct M68KDecodedInsn *d = M68K_DecodeInsn(insn_stream);
+
+    /* Nothing is known, all flags are used */
+    if (d == NULL || scan_depth == 0)
+        return SR_CCR;
+
+    if (d->di_State != SR_STATE_SOLVED)
+        SR_Solve(d - sr_insns, scan_depth * EMU68_CCR_LIVE_STEP);
 
-    return mask | needed;
+    return d->di_LiveOut;
 }
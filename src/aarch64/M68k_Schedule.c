@@ -0,0 +1,406 @@
+/*
+    Copyright © 2020 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+
+#if EMU68_SCHEDULE
+
+/*
+    List scheduling of AArch64 code emitted for a single m68k instruction, for in-order cores.
+    The rules for entering that code are the same as for the peephole pass: without branches,
+    literal loads, adr/adrp and exit markers it is entered at its start only and left at its end.
+
+    Runs of integer data processing instructions, loads and stores are reordered, everything else
+    (system, SIMD and FPU instructions, accesses with writeback, exclusives, prefetches) stays at
+    its place and ends the run. A load issued early hides its latency behind independent work
+    instead of stalling the next instruction which uses it.
+
+    Loads and stores keep their order, so do accesses to chipset and CIA registers. A load or store
+    may fault there or, with the m68k MMU, raise an access error which restarts the m68k instruction.
+    Writes of the registers holding m68k state do not cross an access therefore, the handler sees
+    them exactly as the code emitted in order would leave them.
+*/
+
+#define SCHED_MAX       64
+
+#define R(r)            (1ULL << (r))
+#define RZ(r)           ((r) == 31 ? 0 : R(r))          /* Register 31 is zero register */
+#define RS(r)           R(r)                            /* Register 31 is SP */
+#define NZCV            (1ULL << 32)
+
+/* x12 and the m68k registers in x13-x29 */
+#define VISIBLE         (0x3ffff000ULL)
+
+struct SchedNode {
+    uint32_t    sn_Insn;
+    uint8_t     sn_Latency;
+    uint8_t     sn_Memory;
+    uint16_t    sn_Height;
+    uint64_t    sn_Reads;
+    uint64_t    sn_Writes;
+    uint64_t    sn_Preds;
+    uint64_t    sn_RAW;         /* Predecessors whose result is read */
+};
+
+static struct SchedNode nodes[SCHED_MAX];
+static uint32_t order[SCHED_MAX];
+static uint32_t issue[SCHED_MAX];
+
+/* Register use and latency on an in-order core. Returns 0 if the instruction cannot be moved */
+static int Decode(uint32_t insn, struct SchedNode *n)
+{
+    uint8_t rd = insn & 31;
+    uint8_t rn = (insn >> 5) & 31;
+    uint8_t rm = (insn >> 16) & 31;
+    uint8_t ra = (insn >> 10) & 31;
+    uint8_t opc = (insn >> 29) & 3;
+    int s = (insn & 0x20000000) != 0;
+
+    n->sn_Insn = insn;
+    n->sn_Latency = 1;
+    n->sn_Memory = 0;
+    n->sn_Reads = 0;
+    n->sn_Writes = 0;
+
+    /* add/sub immediate */
+    if ((insn & 0x1f000000) == 0x11000000)
+    {
+        n->sn_Reads = RS(rn);
+        n->sn_Writes = s ? RZ(rd) | NZCV : RS(rd);
+    }
+    /* Logical immediate */
+    else if ((insn & 0x1f800000) == 0x12000000)
+    {
+        n->sn_Reads = RZ(rn);
+        n->sn_Writes = opc == 3 ? RZ(rd) | NZCV : RS(rd);
+    }
+    /* movn, movz, movk */
+    else if ((insn & 0x1f800000) == 0x12800000)
+    {
+        if (opc == 1)
+            return 0;
+        n->sn_Reads = opc == 3 ? RZ(rd) : 0;
+        n->sn_Writes = RZ(rd);
+    }
+    /* sbfm, bfm, ubfm */
+    else if ((insn & 0x1f800000) == 0x13000000)
+    {
+        if (opc == 3)
+            return 0;
+        n->sn_Reads = RZ(rn) | (opc == 1 ? RZ(rd) : 0);
+        n->sn_Writes = RZ(rd);
+    }
+    /* extr */
+    else if ((insn & 0x1f800000) == 0x13800000)
+    {
+        n->sn_Reads = RZ(rn) | RZ(rm);
+        n->sn_Writes = RZ(rd);
+    }
+    /* Logical shifted register */
+    else if ((insn & 0x1f000000) == 0x0a000000)
+    {
+        n->sn_Reads = RZ(rn) | RZ(rm);
+        n->sn_Writes = RZ(rd) | (opc == 3 ? NZCV : 0);
+        n->sn_Latency = (insn & 0x0000fc00) ? 2 : 1;
+    }
+    /* add/sub shifted register */
+    else if ((insn & 0x1f200000) == 0x0b000000)
+    {
+        n->sn_Reads = RZ(rn) | RZ(rm);
+        n->sn_Writes = RZ(rd) | (s ? NZCV : 0);
+        n->sn_Latency = (insn & 0x0000fc00) ? 2 : 1;
+    }
+    /* add/sub extended register */
+    else if ((insn & 0x1f200000) == 0x0b200000)
+    {
+        n->sn_Reads = RS(rn) | RZ(rm);
+        n->sn_Writes = s ? RZ(rd) | NZCV : RS(rd);
+        n->sn_Latency = 2;
+    }
+    /* adc, sbc */
+    else if ((insn & 0x1fe0fc00) == 0x1a000000)
+    {
+        n->sn_Reads = RZ(rn) | RZ(rm) | NZCV;
+        n->sn_Writes = RZ(rd) | (s ? NZCV : 0);
+    }
+    /* ccmp, ccmn */
+    else if ((insn & 0x3fe00400) == 0x3a400000)
+    {
+        n->sn_Reads = RZ(rn) | NZCV | ((insn & 0x800) ? 0 : RZ(rm));
+        n->sn_Writes = NZCV;
+    }
+    /* csel, csinc, csinv, csneg */
+    else if ((insn & 0x3fe00800) == 0x1a800000)
+    {
+        n->sn_Reads = RZ(rn) | RZ(rm) | NZCV;
+        n->sn_Writes = RZ(rd);
+    }
+    /* Data processing, two sources */
+    else if ((insn & 0x7fe00000) == 0x1ac00000)
+    {
+        uint8_t op = (insn >> 10) & 63;
+
+        if (op == 2 || op == 3)
+            n->sn_Latency = 12;
+        else if (op >= 8 && op <= 11)
+            n->sn_Latency = 1;
+        else if (op >= 16 && op <= 23)
+            n->sn_Latency = 2;
+        else
+            return 0;
+
+        n->sn_Reads = RZ(rn) | RZ(rm);
+        n->sn_Writes = RZ(rd);
+    }
+    /* rbit, rev16, rev, clz, cls */
+    else if ((insn & 0x7fff0000) == 0x5ac00000)
+    {
+        if (((insn >> 10) & 63) > 5)
+            return 0;
+        n->sn_Reads = RZ(rn);
+        n->sn_Writes = RZ(rd);
+    }
+    /* Data processing, three sources */
+    else if ((insn & 0x1f000000) == 0x1b000000)
+    {
+        n->sn_Reads = RZ(rn) | RZ(rm) | RZ(ra);
+        n->sn_Writes = RZ(rd);
+        n->sn_Latency = 4;
+    }
+    /* Integer loads and stores, unsigned offset, unscaled offset or register offset */
+    else if ((insn & 0x3f000000) == 0x39000000 || (insn & 0x3f200c00) == 0x38000000 || (insn & 0x3f200c00) == 0x38200800)
+    {
+        uint8_t size = insn >> 30;
+        uint8_t ldst = (insn >> 22) & 3;
+
+        /* prfm and unallocated signed loads */
+        if ((size == 3 && ldst >= 2) || (size == 2 && ldst == 3))
+            return 0;
+
+        n->sn_Reads = RS(rn);
+        if ((insn & 0x3f200c00) == 0x38200800)
+            n->sn_Reads |= RZ(rm);
+
+        if (ldst == 0)
+        {
+            n->sn_Reads |= RZ(rd);
+        }
+        else
+        {
+            n->sn_Writes = RZ(rd);
+            n->sn_Latency = 3;
+        }
+        n->sn_Memory = 1;
+    }
+    /* ldp, stp and ldpsw, signed offset */
+    else if ((insn & 0x3f800000) == 0x29000000)
+    {
+        uint8_t rt2 = (insn >> 10) & 31;
+        int load = (insn & 0x00400000) != 0;
+
+        if ((insn >> 30) == 3 || ((insn >> 30) == 1 && !load))
+            return 0;
+
+        n->sn_Reads = RS(rn);
+        if (load)
+        {
+            n->sn_Writes = RZ(rd) | RZ(rt2);
+            n->sn_Latency = 3;
+        }
+        else
+        {
+            n->sn_Reads |= RZ(rd) | RZ(rt2);
+        }
+        n->sn_Memory = 1;
+    }
+    else
+        return 0;
+
+    return 1;
+}
+
+/* Cycles until the last result of the run is ready, with the instructions issued one per cycle in given order */
+static uint32_t Cost(int count, const uint32_t *o)
+{
+    uint32_t cycle = 0;
+    uint32_t done = 0;
+
+    for (int k=0; k < count; k++)
+    {
+        struct SchedNode *n = &nodes[o[k]];
+        uint32_t t = cycle;
+
+        for (int i=0; i < count; i++)
+        {
+            if ((n->sn_RAW >> i) & 1)
+            {
+                uint32_t ready = issue[i] + nodes[i].sn_Latency;
+                if (ready > t)
+                    t = ready;
+            }
+        }
+
+        issue[o[k]] = t;
+        cycle = t + 1;
+        if (t + n->sn_Latency > done)
+            done = t + n->sn_Latency;
+    }
+
+    return done;
+}
+
+static void ScheduleRun(uint32_t *start, int count)
+{
+    uint32_t straight[SCHED_MAX];
+    uint64_t placed = 0;
+    uint32_t cycle = 0;
+
+    if (count < 3)
+        return;
+
+    /* Dependencies on every earlier instruction of the run */
+    for (int j=0; j < count; j++)
+    {
+        struct SchedNode *n = &nodes[j];
+
+        n->sn_Preds = 0;
+        n->sn_RAW = 0;
+
+        for (int i=0; i < j; i++)
+        {
+            struct SchedNode *p = &nodes[i];
+
+            if (p->sn_Writes & n->sn_Reads)
+                n->sn_RAW |= 1ULL << i;
+
+            if ((p->sn_Writes & (n->sn_Reads | n->sn_Writes)) || (p->sn_Reads & n->sn_Writes) ||
+                (p->sn_Memory && n->sn_Memory) ||
+                (p->sn_Memory && (n->sn_Writes & VISIBLE)) || (n->sn_Memory && (p->sn_Writes & VISIBLE)))
+            {
+                n->sn_Preds |= 1ULL << i;
+            }
+        }
+    }
+
+    /* Height is the longest chain of latencies from the instruction to the end of the run */
+    for (int i=count - 1; i >= 0; i--)
+    {
+        uint16_t h = nodes[i].sn_Latency;
+
+        for (int j=i + 1; j < count; j++)
+        {
+            if ((nodes[j].sn_Preds >> i) & 1)
+            {
+                uint16_t via = (((nodes[j].sn_RAW >> i) & 1) ? nodes[i].sn_Latency : 0) + nodes[j].sn_Height;
+                if (via > h)
+                    h = via;
+            }
+        }
+
+        nodes[i].sn_Height = h;
+        straight[i] = i;
+    }
+
+    /*
+        At every step the ready instruction which can issue first is taken, among those the one
+        with the longest chain behind it, then the earliest one
+    */
+    for (int k=0; k < count; k++)
+    {
+        int best = -1;
+        uint32_t best_t = 0;
+
+        for (int j=0; j < count; j++)
+        {
+            struct SchedNode *n = &nodes[j];
+            uint32_t t = cycle;
+
+            if ((placed >> j) & 1)
+                continue;
+            if ((n->sn_Preds & ~placed) != 0)
+                continue;
+
+            for (int i=0; i < j; i++)
+            {
+                if ((n->sn_RAW >> i) & 1)
+                {
+                    uint32_t ready = issue[i] + nodes[i].sn_Latency;
+                    if (ready > t)
+                        t = ready;
+                }
+            }
+
+            if (best < 0 || t < best_t || (t == best_t && n->sn_Height > nodes[best].sn_Height))
+            {
+                best = j;
+                best_t = t;
+            }
+        }
+
+        order[k] = best;
+        issue[best] = best_t;
+        placed |= 1ULL << best;
+        cycle = best_t + 1;
+    }
+
+    /* Code is changed only if the run gets shorter */
+    uint32_t scheduled = Cost(count, order);
+
+    if (scheduled >= Cost(count, straight))
+        return;
+
+    for (int k=0; k < count; k++)
+        start[k] = INSN_TO_LE(nodes[order[k]].sn_Insn);
+}
+
+/* Reorder code in range start..end in place */
+void M68K_Schedule(uint32_t *start, uint32_t *end)
+{
+    uint32_t *run = start;
+    int count = 0;
+
+    for (uint32_t *p = start; p < end; p++)
+    {
+        uint32_t insn = INSN_TO_LE(*p);
+
+        if ((insn & 0xfffffff0) == 0xfffffff0)
+            return;
+        if ((insn & 0x1c000000) == 0x14000000 && (insn & 0xffc00000) != 0xd5000000)
+            return;
+        if ((insn & 0x1f000000) == 0x10000000 || (insn & 0x3b000000) == 0x18000000)
+            return;
+        if ((insn & 0x18000000) == 0)
+            return;
+    }
+
+    for (uint32_t *p = start; p < end; p++)
+    {
+        if (count == SCHED_MAX)
+        {
+            ScheduleRun(run, count);
+            run = p;
+            count = 0;
+        }
+
+        if (!Decode(INSN_TO_LE(*p), &nodes[count]))
+        {
+            ScheduleRun(run, count);
+            run = p + 1;
+            count = 0;
+            continue;
+        }
+
+        count++;
+    }
+
+    ScheduleRun(run, count);
+}
+
+#endif
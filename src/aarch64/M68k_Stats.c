@@ -0,0 +1,321 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "mmu.h"
+#include "tlsf.h"
+#include "M68k.h"
+#include "jitstats.h"
+
+struct JITStats jit_stats __attribute__((aligned(64))) = {
+    .js_Size = sizeof(struct JITStats),
+    .js_Buckets = JS_BUCKETS,
+    .js_Causes = JS_CAUSE_COUNT,
+    .js_Regions = JS_REGION_COUNT,
+    .js_RatioLimit = { 8, 12, 16, 24, 32, 48, 64, 0xffffffff },
+    .js_OpMixModes = JS_OPMIX_MODES,
+};
+
+uint32_t jit_stats_select;
+int opmix;
+
+#if EMU68_JIT_STATS
+
+static const char * const cause_names[JS_CAUSE_COUNT] = {
+    [JS_RELEASE_LRU]        = "LRU",
+    [JS_RELEASE_CRC]        = "CRC mismatch",
+    [JS_RELEASE_CINV_LINE]  = "CINV line",
+    [JS_RELEASE_CINV_PAGE]  = "CINV page",
+    [JS_RELEASE_CINV_ALL]   = "CINV all",
+    [JS_RELEASE_SOFT_FLUSH] = "soft flush",
+    [JS_RELEASE_WRITTEN]    = "code written",
+    [JS_RELEASE_STALE]      = "stale",
+    [JS_RELEASE_REPLACED]   = "tier up",
+    [JS_RELEASE_RESET]      = "warm reset",
+};
+
+static const char * const region_names[JS_REGION_COUNT] = {
+    [JS_REGION_CHIP]        = "CHIP",
+    [JS_REGION_FAST]        = "Zorro II RAM",
+    [JS_REGION_CIA]         = "CIA",
+    [JS_REGION_SLOW]        = "slow RAM",
+    [JS_REGION_CUSTOM]      = "custom",
+    [JS_REGION_ZORRO_IO]    = "Zorro II I/O",
+    [JS_REGION_ROM]         = "ROM",
+    [JS_REGION_HIGH]        = "Zorro III",
+};
+
+static inline int Bucket(uint32_t value, uint32_t first)
+{
+    int b = 0;
+
+    while (b < JS_BUCKETS - 1 && value >= (first << b))
+        b++;
+
+    return b;
+}
+
+/* Account freshly translated unit. Translator lock is held */
+void JITStats_Unit(uint32_t m68k_insns, uint32_t arm_insns, uint64_t ticks)
+{
+    uint32_t ratio = m68k_insns ? (arm_insns * 4) / m68k_insns : 0;
+    int b = 0;
+
+    jit_stats.js_UnitSize[Bucket(arm_insns, 16)]++;
+    jit_stats.js_UnitLength[Bucket(m68k_insns, 2)]++;
+
+    while (b < JS_BUCKETS - 1 && ratio >= jit_stats.js_RatioLimit[b])
+        b++;
+    jit_stats.js_Ratio[b]++;
+
+    jit_stats.js_Translated++;
+    jit_stats.js_TranslateTicks += ticks;
+    if (ticks > jit_stats.js_TranslateMax)
+        jit_stats.js_TranslateMax = ticks;
+}
+
+static const char * const opmix_modes[JS_OPMIX_MODES] = {
+    "Dn", "An", "(An)", "(An)+", "-(An)", "(d16,An)", "(d8,An,Xn)",
+    "(xxx).W", "(xxx).L", "(d16,PC)", "(d8,PC,Xn)", "#imm"
+};
+
+#define OPMIX_TOP   24
+
+/* Most frequent entries of the opcode mix, the table is not changed */
+static void DumpOpMix()
+{
+    uint32_t top[OPMIX_TOP];
+    uint64_t total = 0;
+    int count = 0;
+
+    for (int i=0; i < JS_OPMIX_SIZE; i++)
+    {
+        uint32_t n = jit_stats.js_OpMix[i];
+        int j;
+
+        if (n == 0)
+            continue;
+
+        total += n;
+
+        /* Insertion into the sorted list of the most frequent ones */
+        for (j = count < OPMIX_TOP ? count++ : OPMIX_TOP; j > 0 && jit_stats.js_OpMix[top[j - 1]] < n; j--)
+        {
+            if (j < OPMIX_TOP)
+                top[j] = top[j - 1];
+        }
+        if (j < OPMIX_TOP)
+            top[j] = i;
+    }
+
+    if (total == 0)
+        return;
+
+    kprintf("[JIT]   opcode mix, %lld instructions:\n", total);
+    for (int i=0; i < count; i++)
+    {
+        uint32_t n = jit_stats.js_OpMix[top[i]];
+
+        kprintf("[JIT]     %04x/ffc0 %-10s %10d %3d.%d%%\n", (top[i] / JS_OPMIX_MODES) << 6, opmix_modes[top[i] % JS_OPMIX_MODES],
+            n, (uint32_t)(n * 100ULL / total), (uint32_t)((n * 1000ULL / total) % 10));
+    }
+}
+
+static uint32_t ticks_to_us(uint64_t ticks)
+{
+    return jit_stats.js_TimerFreq ? (ticks * 1000000) / jit_stats.js_TimerFreq : 0;
+}
+
+#if EMU68_BUS_PROFILE
+
+#define BUS_PROFILE_WAYS    4
+#define BUS_PROFILE_TOP     16
+
+/*
+    Bus time per access site, a site is the ARM instruction which faulted together with the region
+    it went to. The m68k PC is looked up in the PC map once, when a site takes a way of its set.
+    If all ways are taken, the one with least time is given away
+*/
+struct BusSite {
+    uint64_t    bs_ELR;
+    uint64_t    bs_Ticks;
+    uint32_t    bs_PC;
+    uint32_t    bs_Count;
+    uint32_t    bs_Region;
+};
+
+static struct BusSite bus_sites[EMU68_BUS_PROFILE_SETS][BUS_PROFILE_WAYS];
+int bus_profile;
+
+void JITStats_BusSite(uint64_t elr, uint32_t addr, uint64_t ticks)
+{
+    uint32_t region = JITStats_Region(addr);
+    struct BusSite *set = bus_sites[((elr >> 2) ^ region) & (EMU68_BUS_PROFILE_SETS - 1)];
+    struct BusSite *victim = &set[0];
+
+    for (int i=0; i < BUS_PROFILE_WAYS; i++)
+    {
+        if (set[i].bs_ELR == elr && set[i].bs_Region == region)
+        {
+            set[i].bs_Ticks += ticks;
+            set[i].bs_Count++;
+            return;
+        }
+
+        if (set[i].bs_Ticks < victim->bs_Ticks)
+            victim = &set[i];
+    }
+
+    victim->bs_ELR = elr;
+    victim->bs_Region = region;
+    victim->bs_PC = (uint32_t)(uintptr_t)M68K_GetFaultPC(elr);
+    victim->bs_Ticks = ticks;
+    victim->bs_Count = 1;
+}
+
+/*
+    Sites of the same m68k PC and region summed up, the instructions with most bus time are listed.
+    Sites outside of translated code show up with PC 0
+*/
+static void DumpBusProfile()
+{
+    static uint64_t ticks[EMU68_BUS_PROFILE_SETS * BUS_PROFILE_WAYS];
+    static uint32_t count[EMU68_BUS_PROFILE_SETS * BUS_PROFILE_WAYS];
+    struct BusSite *site = &bus_sites[0][0];
+    uint32_t top[BUS_PROFILE_TOP];
+    uint64_t total = 0;
+    int n = 0;
+
+    for (int i=0; i < EMU68_BUS_PROFILE_SETS * BUS_PROFILE_WAYS; i++)
+    {
+        ticks[i] = site[i].bs_Ticks;
+        count[i] = site[i].bs_Count;
+    }
+
+    for (int i=0; i < EMU68_BUS_PROFILE_SETS * BUS_PROFILE_WAYS; i++)
+    {
+        int j;
+
+        if (count[i] == 0)
+            continue;
+
+        total += ticks[i];
+
+        /* Later sites of the same instruction and region are folded into this one */
+        for (j=i + 1; j < EMU68_BUS_PROFILE_SETS * BUS_PROFILE_WAYS; j++)
+        {
+            if (count[j] && site[j].bs_PC == site[i].bs_PC && site[j].bs_Region == site[i].bs_Region)
+            {
+                total += ticks[j];
+                ticks[i] += ticks[j];
+                count[i] += count[j];
+                count[j] = 0;
+            }
+        }
+
+        for (j = n < BUS_PROFILE_TOP ? n++ : BUS_PROFILE_TOP; j > 0 && ticks[top[j - 1]] < ticks[i]; j--)
+        {
+            if (j < BUS_PROFILE_TOP)
+                top[j] = top[j - 1];
+        }
+        if (j < BUS_PROFILE_TOP)
+            top[j] = i;
+    }
+
+    if (total == 0)
+        return;
+
+    kprintf("[JIT]   bus time by m68k PC, %d us in total:\n", ticks_to_us(total));
+    for (int i=0; i < n; i++)
+    {
+        uint32_t k = top[i];
+
+        kprintf("[JIT]     %08x %-12s %10d accesses %10d us %3d.%d%%\n", site[k].bs_PC, region_names[site[k].bs_Region],
+            count[k], ticks_to_us(ticks[k]), (uint32_t)(ticks[k] * 100 / total), (uint32_t)((ticks[k] * 1000 / total) % 10));
+    }
+}
+
+#endif
+
+#endif
+
+/* Publish the live statistics: physical address (2 cells) and size */
+void JITStats_Init()
+{
+#if EMU68_JIT_STATS
+    uint64_t freq;
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+    jit_stats.js_TimerFreq = freq;
+
+    uint64_t phys = mmu_virt2phys((uintptr_t)&jit_stats);
+    uint32_t prop[] = { phys >> 32, phys & 0xffffffff, sizeof(jit_stats) };
+
+    dt_add_property(dt_find_node("/emu68"), "jit-stats", prop, sizeof(prop));
+#endif
+}
+
+void JITStats_Dump()
+{
+#if EMU68_JIT_STATS
+    kprintf("[JIT] Statistics:\n");
+    kprintf("[JIT]   units translated: %d in %d us (max %d us), verified: %d in %d us (max %d us)\n",
+        jit_stats.js_Translated, ticks_to_us(jit_stats.js_TranslateTicks), ticks_to_us(jit_stats.js_TranslateMax),
+        jit_stats.js_Verified, ticks_to_us(jit_stats.js_VerifyTicks), ticks_to_us(jit_stats.js_VerifyMax));
+#if defined(PISTORM) && PISTORM_STOP_WAKE
+    if (jit_stats.js_StopWakes)
+        kprintf("[JIT]   STOP wake-ups: %d, average %d ns, max %d ns\n", jit_stats.js_StopWakes,
+            ticks_to_us(jit_stats.js_StopWakeTicks * 1000 / jit_stats.js_StopWakes), ticks_to_us(jit_stats.js_StopWakeMax * 1000));
+#endif
+
+    kprintf("[JIT]   ARM size     ");
+    for (int i=0; i < JS_BUCKETS; i++)
+        kprintf(" %s%5d:%-6d", i == JS_BUCKETS - 1 ? ">=" : "<", 16 << (i == JS_BUCKETS - 1 ? i - 1 : i), jit_stats.js_UnitSize[i]);
+    kprintf("\n[JIT]   m68k length  ");
+    for (int i=0; i < JS_BUCKETS; i++)
+        kprintf(" %s%5d:%-6d", i == JS_BUCKETS - 1 ? ">=" : "<", 2 << (i == JS_BUCKETS - 1 ? i - 1 : i), jit_stats.js_UnitLength[i]);
+    kprintf("\n[JIT]   ARM/m68k     ");
+    for (int i=0; i < JS_BUCKETS; i++)
+    {
+        uint32_t limit = jit_stats.js_RatioLimit[i == JS_BUCKETS - 1 ? i - 1 : i];
+        kprintf(" %s%2d.%02d:%-6d", i == JS_BUCKETS - 1 ? ">=" : "<", limit / 4, (limit % 4) * 25, jit_stats.js_Ratio[i]);
+    }
+    kprintf("\n[JIT]   released:");
+    for (int i=0; i < JS_CAUSE_COUNT; i++)
+        kprintf(" %s %d%s", cause_names[i], jit_stats.js_Released[i], i == JS_CAUSE_COUNT - 1 ? "\n" : ",");
+    kprintf("[JIT]   dispatch: %d jump cache hits, %d misses, exits chained %d, unchained %d, out of range %d\n",
+        jit_stats.js_DispatchHit, jit_stats.js_DispatchMiss, jit_stats.js_Chained, jit_stats.js_Unchained, jit_stats.js_ChainFar);
+    for (int i=0; i < JS_REGION_COUNT; i++)
+    {
+        uint32_t count = jit_stats.js_BusReads[i] + jit_stats.js_BusWrites[i];
+
+        if (count)
+            kprintf("[JIT]   bus %s: %d reads, %d writes, average %d ns, max %d ns\n", region_names[i],
+                jit_stats.js_BusReads[i], jit_stats.js_BusWrites[i],
+                ticks_to_us(jit_stats.js_BusTicks[i] * 1000 / count), ticks_to_us(jit_stats.js_BusMax[i] * 1000));
+    }
+#if EMU68_BUS_PROFILE
+    if (bus_profile)
+        DumpBusProfile();
+#endif
+    DumpOpMix();
+#if EMU68_TLSF_FAST_BINS
+    void *pools[2] = { tlsf, jit_tlsf };
+    for (int i=0; i < 2; i++)
+    {
+        struct tlsf_bin_stats bs;
+        tlsf_get_bin_stats(pools[i], &bs);
+        kprintf("[JIT]   %s fast bins: %lld hits, %lld misses, %lld frees kept, %lld returned\n", i ? "JIT" : "SYS",
+            bs.tb_Hits, bs.tb_Misses, bs.tb_Cached, bs.tb_Returned);
+    }
+#endif
+#endif
+}
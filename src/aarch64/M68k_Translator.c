@@ -19,6 +19,10 @@
 #include "DuffCopy.h"
 #include "disasm.h"
 #include "cache.h"
+#include "mmu.h"
+#include "trace.h"
+#include "jitstats.h"
+#include "native.h"
 
 #if SET_FEATURES_AT_RUNTIME
 features_t Features;
@@ -33,8 +37,15 @@ options_t Options = {
 
 int disasm = 0;
 int debug = 0;
+int jit_report = 0;
 const int debug_cnt = 0;
 
+uint32_t debug_range_min = 0x00000000;
+uint32_t debug_range_max = 0xffffffff;
+
+/* Debug level of the unit in translation, the per instruction hints test only this one */
+static int insn_debug;
+
 static inline int globalDebug() {
     return debug;
 }
@@ -43,10 +54,50 @@ static inline int globalDisasm() {
     return disasm;
 }
 
-struct List ICache[EMU68_HASHSIZE];
+/*
+    Single test for all debug output. DBGCTRL writes debug and disasm from translated code, the
+    address range is compared only if one of them is set
+*/
+static inline int DebugActive(uint32_t pc) {
+    return unlikely(debug | disasm) && pc >= debug_range_min && pc <= debug_range_max;
+}
+
+struct M68KUnitLine UnitTable[EMU68_UNIT_TABLE_SIZE];
 struct List LRU;
+
+/*
+    Units hashed by the page of their lowest m68k address. A unit may reach up to
+    page_index_span pages above that one, range lookups start that far below.
+*/
+static struct List PageIndex[EMU68_PAGE_INDEX_SIZE];
+static uint32_t page_index_span;
+
+static inline uint32_t UnitTable_Home(uint16_t *m68k_address)
+{
+    return ((uintptr_t)m68k_address >> EMU68_HASHSHIFT) & EMU68_UNIT_TABLE_MASK;
+}
+
 static uint32_t *temporary_arm_code;
 static struct M68KLocalState *local_state;
+/* Number of m68k instructions the buffers above are sized for */
+static uint32_t translation_depth;
+
+/* One bit per line of UnitTable which was used since last reset. Only these lines are cleared */
+static uint64_t unit_line_dirty[(EMU68_UNIT_TABLE_SIZE + 63) / 64];
+static int unit_table_ready;
+
+/* Map entry takes at most 3 bytes of ARM offset delta and 5 bytes of m68k PC delta */
+#define PC_MAP_ENTRY_MAX    8
+
+#if EMU68_PC_MAP
+/*
+    Indices of local_state entries which start an m68k instruction. Entries of instructions
+    consumed together with the previous one are never written.
+*/
+static uint16_t pc_map_index[(JCCB_INSN_DEPTH_MASK + 1) * 2];
+static uint32_t pc_map_count;
+static uint8_t pc_map_buffer[(JCCB_INSN_DEPTH_MASK + 1) * 2 * PC_MAP_ENTRY_MAX];
+#endif
 
 int32_t _pc_rel = 0;
 
@@ -112,10 +163,23 @@ uint32_t *EMIT_ResetOffsetPC(uint32_t *ptr)
 
 uint32_t *EMIT_lineA(uint32_t *arm_ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]);
+    uint16_t opcode = cache_fetch_16((uintptr_t)&(*m68k_ptr)[0]);
     (*m68k_ptr)++;
     (*insn_consumed)++;
 
+#if EMU68_NATIVE_CALLS
+    extern uint32_t jit_control2;
+    native_func_t func = (jit_control2 & JC2F_NATIVE_CALLS) ? Native_Find(opcode) : NULL;
+
+    if (func)
+    {
+        arm_ptr = EMIT_NativeCall(arm_ptr, func);
+        arm_ptr = EMIT_AdvancePC(arm_ptr, 2);
+
+        return arm_ptr;
+    }
+#endif
+
     arm_ptr = EMIT_FlushPC(arm_ptr);
     if (debug)
         arm_ptr = EMIT_InjectDebugString(arm_ptr, "[JIT] LINE A exception (opcode %04x) at %08x not implemented\n", opcode, *m68k_ptr - 1);
@@ -146,20 +210,80 @@ static uint32_t * (*line_array[16])(uint32_t *arm_ptr, uint16_t **m68k_ptr, uint
 
 extern struct M68KState *__m68k_state;
 
-static inline uint32_t *EmitINSN(uint32_t *arm_ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+/* Copies of JIT_CONTROL and JIT_CONTROL2 valid for the translation in progress */
+uint32_t jit_control;
+uint32_t jit_control2;
+
+#if EMU68_LAZY_RETUNE
+struct JITOverride jit_overrides[EMU68_JIT_OVERRIDES];
+uint32_t jit_override_select;
+uint32_t jit_soft_flush_gen;
+
+/* JITCTRL for unit starting at m68k_pc, the first enabled override covering it wins */
+static inline uint32_t EffectiveControl(uint16_t *m68k_pc)
 {
-    uint32_t *ptr = arm_ptr;
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)*m68k_ptr);
-    uint8_t group = opcode >> 12;
+    uint32_t pc = (uint32_t)(uintptr_t)m68k_pc;
 
-    if (debug > 2)
+    for (int i=0; i < EMU68_JIT_OVERRIDES; i++)
+    {
+        if (jit_overrides[i].jo_Control != 0 && pc >= jit_overrides[i].jo_Low && pc <= jit_overrides[i].jo_High)
+            return jit_overrides[i].jo_Control;
+    }
+
+    return __m68k_state->JIT_CONTROL;
+}
+#else
+static inline uint32_t EffectiveControl(uint16_t *m68k_pc)
+{
+    (void)m68k_pc;
+    return __m68k_state->JIT_CONTROL;
+}
+#endif
+
+#if EMU68_LOOP_PREFETCH
+uint8_t loop_stride_inc;
+uint8_t loop_stride_dec;
+
+/*
+    Prefetch dist bytes ahead into L1 and twice as far into L2 for every stream of the loop.
+    Prefetches never fault and are dropped for device or unmapped memory, so the registers
+    may point anywhere
+*/
+static uint32_t *EMIT_LoopPrefetch(uint32_t *ptr, uint8_t tmp, uint32_t dist)
+{
+    for (int i=0; i < 7; i++)
+    {
+        uint8_t an = RA_MapM68kRegister(&ptr, 8 + i);
+
+        if (loop_stride_inc & (1 << i))
+        {
+            *ptr++ = prfm(an, PRFM_PLDL1STRM, dist);
+            *ptr++ = prfm(an, PRFM_PLDL2KEEP, 2 * dist);
+        }
+
+        if (loop_stride_dec & (1 << i))
+        {
+            *ptr++ = sub64_immed(tmp, an, 2 * dist);
+            *ptr++ = prfm(tmp, PRFM_PLDL2KEEP, 0);
+            *ptr++ = prfm(tmp, PRFM_PLDL1STRM, dist);
+        }
+    }
+
+    return ptr;
+}
+#endif
+
+/* Markers in front of every instruction of a unit translated with debug level above 1 */
+static uint32_t * __attribute__((noinline)) EMIT_DebugHints(uint32_t *ptr, uint16_t opcode, uint16_t *m68k_ptr)
+{
+    if (insn_debug > 2)
     {
         *ptr++ = hint(0);
         *ptr++ = movw_immed_u16(31, opcode);
-        *ptr++ = movk_immed_u16(31, ((uintptr_t)*(m68k_ptr)) >> 16, 1);
-        *ptr++ = movk_immed_u16(31, ((uintptr_t)*(m68k_ptr)), 0);
+        *ptr++ = movk_immed_u16(31, ((uintptr_t)m68k_ptr) >> 16, 1);
+        *ptr++ = movk_immed_u16(31, ((uintptr_t)m68k_ptr), 0);
     }
-    if (debug > 1)
+    if (insn_debug > 1)
         *ptr++ = hint(1);
     if (debug_cnt & 1)
     {
@@ -169,10 +293,56 @@ static inline uint32_t *EmitINSN(uint32_t *arm_ptr, uint16_t **m68k_ptr, uint16_
         RA_FreeARMRegister(&ptr, reg);
     }
 
-    if ((__m68k_state->JIT_CONTROL2 & JC2F_CHIP_SLOWDOWN) && (uintptr_t)*m68k_ptr < 0x200000)
+    return ptr;
+}
+
+#if EMU68_JIT_STATS
+/* Instrumentation of the unit in translation for the opcode mix, copied from opmix */
+static int insn_opmix;
+
+/* Count the instruction in the opcode mix of the statistics, host flags are kept */
+static uint32_t * __attribute__((noinline)) EMIT_CountOpcode(uint32_t *ptr, uint16_t opcode)
+{
+    union {
+        uint16_t u16[4];
+        uint64_t u64;
+    } u;
+    uint8_t addr = RA_AllocARMRegister(&ptr);
+    uint8_t cnt = RA_AllocARMRegister(&ptr);
+
+    u.u64 = (uintptr_t)&jit_stats.js_OpMix[JITStats_OpMixIndex(opcode)];
+    *ptr++ = mov64_immed_u16(addr, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(addr, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(addr, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(addr, u.u16[0], 3);
+    *ptr++ = ldr_offset(addr, cnt, 0);
+    *ptr++ = add_immed(cnt, cnt, 1);
+    *ptr++ = str_offset(addr, cnt, 0);
+
+    RA_FreeARMRegister(&ptr, cnt);
+    RA_FreeARMRegister(&ptr, addr);
+
+    return ptr;
+}
+#endif
+
+static inline uint32_t *EmitINSN(uint32_t *arm_ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+{
+    uint32_t *ptr = arm_ptr;
+    uint16_t opcode = cache_fetch_16((uint32_t)(uintptr_t)*m68k_ptr);
+    uint8_t group = opcode >> 12;
+
+    if (unlikely(insn_debug))
+        ptr = EMIT_DebugHints(ptr, opcode, *m68k_ptr);
+#if EMU68_JIT_STATS
+    if (unlikely(insn_opmix))
+        ptr = EMIT_CountOpcode(ptr, opcode);
+#endif
+
+    if ((jit_control2 & JC2F_CHIP_SLOWDOWN) && (uintptr_t)*m68k_ptr < 0x200000)
     {
         static uint32_t counter;
-        const uint32_t repeat_every = 1 + ((__m68k_state->JIT_CONTROL2 >> JC2B_CHIP_SLOWDOWN_RATIO) & JC2_CHIP_SLOWDOWN_RATIO_MASK);
+        const uint32_t repeat_every = 1 + ((jit_control2 >> JC2B_CHIP_SLOWDOWN_RATIO) & JC2_CHIP_SLOWDOWN_RATIO_MASK);
         if (counter++ % repeat_every == 0)
         {
             int8_t off = 0;
@@ -186,10 +356,386 @@ static inline uint32_t *EmitINSN(uint32_t *arm_ptr, uint16_t **m68k_ptr, uint16_
     return ptr;
 }
 
+#if EMU68_IF_CONVERSION
+/* Emit one instruction at *m68k_ptr for translators of whole instruction sequences */
+uint32_t *M68K_EmitINSN(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
+{
+    return EmitINSN(ptr, m68k_ptr, insn_consumed);
+}
+#endif
+
+#if EMU68_LOOP_PACING
+/*
+    68000 cycles of one instruction in a delay loop, 0 if it accesses memory, branches or is not
+    known. Roughly four cycles per word fetched, plus the extra work of long, shift and multiply
+    or divide operations.
+*/
+static uint32_t DelayInsnCycles(uint16_t *insn)
+{
+    uint16_t opcode = cache_fetch_16((uintptr_t)insn);
+    uint8_t mode = (opcode >> 3) & 7;
+    uint8_t opmode = (opcode >> 6) & 7;
+    int reg_source = mode < 2 || (mode == 7 && (opcode & 7) == 4);
+    uint32_t cycles = 4 * M68K_GetINSNLength(insn);
+
+    if (opcode == 0x4e71)
+        return 4;
+
+    switch (opcode >> 12)
+    {
+        case 1: case 2: case 3:     /* MOVE and MOVEA between registers */
+            if (reg_source && opmode < 2)
+                return cycles;
+            break;
+
+        case 5:                     /* ADDQ and SUBQ to register */
+            if ((opcode & 0xc0) != 0xc0 && mode < 2)
+                return cycles + ((opcode & 0x80) ? 4 : 0);
+            break;
+
+        case 7:                     /* MOVEQ */
+            if ((opcode & 0x100) == 0)
+                return 4;
+            break;
+
+        case 8: case 9: case 11: case 12: case 13:
+            if (!reg_source)
+                break;
+            /* OR, SUB, CMP, AND, ADD with register as destination */
+            if (opmode < 3)
+                return cycles + (opmode == 2 ? 4 : 0);
+            /* SUBA, CMPA, ADDA */
+            if ((opcode >> 12) != 8 && (opcode >> 12) != 12 && (opmode & 3) == 3)
+                return cycles + 4;
+            /* DIVU, DIVS, MULU, MULS */
+            if ((opmode & 3) == 3)
+                return cycles + ((opcode >> 12) == 8 ? 136 : 66);
+            break;
+
+        case 14:                    /* Shifts and rotates of registers */
+            if ((opcode & 0xc0) != 0xc0)
+            {
+                uint32_t count = (opcode & 0x20) ? 8 : ((opcode >> 9) & 7);
+                if (count == 0)
+                    count = 8;
+                return cycles + 2 + 2 * count + ((opcode & 0x80) ? 2 : 0);
+            }
+            break;
+    }
+
+    return 0;
+}
+
+/*
+    Check if the code from target up to the DBcc or Bcc at branch is a delay loop: short, in CHIP
+    memory and working on registers only. Returns 68000 cycles of one pass or 0 for any other code.
+    Loops polling CIA or custom registers are not paced, they wait for the hardware already.
+*/
+uint32_t M68K_DelayLoopCycles(uint16_t *target, uint16_t *branch)
+{
+    uint32_t cycles = 10;
+    uint16_t *p = target;
+    int count = 0;
+
+    if ((jit_control2 & JC2F_LOOP_PACING) == 0 || (uintptr_t)branch >= 0x200000)
+        return 0;
+
+    if (target > branch || branch - target > 2 * EMU68_LOOP_PACING_INSNS)
+        return 0;
+
+    while (p < branch)
+    {
+        uint32_t c = DelayInsnCycles(p);
+
+        if (c == 0 || ++count > EMU68_LOOP_PACING_INSNS)
+            return 0;
+
+        cycles += c;
+        p += M68K_GetINSNLength(p);
+    }
+
+    return p == branch ? cycles : 0;
+}
+
+/*
+    Wait until one pass of the loop would be over on a 68000, measured with CNTPCT from the
+    moment the branch is reached. Host flags are left untouched, they may hold the condition.
+*/
+uint32_t *EMIT_LoopPacing(uint32_t *ptr, uint32_t cycles)
+{
+    uint64_t freq;
+    uint32_t ticks;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+    ticks = (freq * cycles + EMU68_LOOP_PACING_CLOCK / 2) / EMU68_LOOP_PACING_CLOCK;
+
+    if (ticks == 0)
+        return ptr;
+    if (ticks > 4095)
+        ticks = 4095;
+
+    uint8_t deadline = RA_AllocARMRegister(&ptr);
+    uint8_t now = RA_AllocARMRegister(&ptr);
+
+    *ptr++ = mrs(deadline, 3, 3, 14, 0, 1);
+    *ptr++ = add_immed(deadline, deadline, ticks);
+    *ptr++ = mrs(now, 3, 3, 14, 0, 1);
+    *ptr++ = sub_reg(now, now, deadline, LSL, 0);
+    *ptr++ = tbnz(now, 31, -2);
+
+    RA_FreeARMRegister(&ptr, now);
+    RA_FreeARMRegister(&ptr, deadline);
+
+    return ptr;
+}
+#endif
+
+#if EMU68_IDLE_WAIT
+/*
+    Effective address read by a polling loop. Modes changing the address register are refused,
+    indexed ones are reported since the index may be a register the loop writes.
+*/
+static int IdleLoopEA(uint8_t ea, int *indexed)
+{
+    uint8_t mode = ea >> 3;
+    uint8_t reg = ea & 7;
+
+    if (mode == 3 || mode == 4)
+        return 0;
+
+    if (mode == 6 || (mode == 7 && reg == 3))
+        *indexed = 1;
+
+    return mode < 7 || reg <= 4;
+}
+
+/*
+    Check if the inner loop starting at head and translated from the given number of instructions
+    is a polling loop: a straight run of tests, compares and loads into data registers closed by a
+    branch back to head, with conditional exits behind the branch only. Nothing is written to
+    memory and registers are only loaded, so a pass repeats the previous one until the memory read
+    changes or an interrupt comes.
+*/
+int M68K_IsIdleLoop(uint16_t *head, uint32_t insns)
+{
+    uint16_t *p = head;
+    uint16_t *exit = NULL;
+    uint32_t count = 0;
+    int indexed = 0;
+    int writes = 0;
+
+    if ((jit_control2 & JC2F_IDLE_WAIT) == 0)
+        return 0;
+
+    while (count < EMU68_IDLE_WAIT_INSNS)
+    {
+        struct M68KDecodedInsn *d = M68K_DecodeInsn(p);
+        uint16_t opcode;
+        uint8_t ea;
+        int ok = 0;
+
+        /* Decode table is full, the body cannot be checked */
+        if (d == NULL)
+            return 0;
+
+        opcode = d->di_Opcode;
+        ea = opcode & 0x3f;
+
+        count++;
+
+        if ((opcode & 0xf000) == 0x6000 && (opcode & 0xff00) != 0x6100)
+        {
+            if (d->di_Target == head)
+            {
+                if (exit != NULL && exit <= p)
+                    return 0;
+                return count == insns && !(indexed && writes);
+            }
+            if (d->di_Flow != DI_FLOW_COND || d->di_Target <= p)
+                return 0;
+            if (exit == NULL || d->di_Target < exit)
+                exit = d->di_Target;
+            ok = 1;
+        }
+        else if (opcode == 0x4e71)
+            ok = 1;
+        /* TST and CMPI */
+        else if (((opcode & 0xff00) == 0x4a00 || (opcode & 0xff00) == 0x0c00) && (opcode & 0xc0) != 0xc0)
+            ok = IdleLoopEA(ea, &indexed);
+        /* BTST static and dynamic, mode 1 is MOVEP */
+        else if (((opcode & 0xffc0) == 0x0800 || (opcode & 0xf1c0) == 0x0100) && (ea >> 3) != 1)
+            ok = IdleLoopEA(ea, &indexed);
+        /* CMP and CMPA, CMPM and EOR share the line */
+        else if ((opcode & 0xf000) == 0xb000 && (((opcode >> 6) & 7) < 4 || ((opcode >> 6) & 7) == 7))
+            ok = IdleLoopEA(ea, &indexed);
+        /* MOVE to data register */
+        else if ((opcode & 0xc000) == 0 && (opcode & 0x3000) != 0 && (opcode & 0x1c0) == 0)
+            ok = writes = IdleLoopEA(ea, &indexed);
+        /* MOVEQ, AND and ANDI with immediate to data register */
+        else if ((opcode & 0xf100) == 0x7000 || ((opcode & 0xf13f) == 0xc03c && (opcode & 0xc0) != 0xc0)
+                 || ((opcode & 0xff38) == 0x0200 && (opcode & 0xc0) != 0xc0))
+            ok = writes = 1;
+
+        if (!ok)
+            return 0;
+
+        p += d->di_Length;
+    }
+
+    return 0;
+}
+
+/*
+    Back off in a polling loop. Passes coming in quick succession for longer than the spin time
+    wait for an event then, one from the housekeeper on IPL change, see m68k_stop_level, or from
+    the timer event stream enabled for idle_wait. INT is checked in between, the backedge leaves
+    the loop if it is set. Host flags are not preserved.
+*/
+uint32_t *EMIT_IdleWait(uint32_t *ptr)
+{
+    uint64_t freq;
+    uint32_t gap, spin;
+    uint32_t *new_spin, *spinning, *done;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+    gap = (freq * EMU68_IDLE_WAIT_GAP_US) / 1000000;
+    spin = (freq * EMU68_IDLE_WAIT_SPIN_US) / 1000000;
+
+    if (gap > 4095)
+        gap = 4095;
+
+    uint8_t ctx = RA_GetCTX(&ptr);
+    uint8_t now = RA_AllocARMRegister(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t limit = RA_AllocARMRegister(&ptr);
+
+    *ptr++ = mrs(now, 3, 3, 14, 0, 1);
+    *ptr++ = ldr64_offset(ctx, tmp, __builtin_offsetof(struct M68KState, IDLE_LAST));
+    *ptr++ = str64_offset(ctx, now, __builtin_offsetof(struct M68KState, IDLE_LAST));
+    *ptr++ = sub64_reg(tmp, now, tmp, LSL, 0);
+    *ptr++ = cmp64_immed(tmp, gap);
+    spinning = ptr++;
+
+    /* Too long since the last pass, the loop is entered again and spins from now on */
+    *ptr++ = str64_offset(ctx, now, __builtin_offsetof(struct M68KState, IDLE_START));
+    new_spin = ptr++;
+
+    *spinning = b_cc(A64_CC_LS, ptr - spinning);
+    *ptr++ = ldr64_offset(ctx, tmp, __builtin_offsetof(struct M68KState, IDLE_START));
+    *ptr++ = sub64_reg(tmp, now, tmp, LSL, 0);
+    *ptr++ = mov_immed_u16(limit, spin & 0xffff, 0);
+    if (spin >> 16)
+        *ptr++ = movk_immed_u16(limit, spin >> 16, 1);
+    *ptr++ = cmp64_reg(tmp, limit, LSL, 0);
+    done = ptr++;
+
+#if defined(PISTORM) && PISTORM_STOP_WAKE
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    /* Published like STOP with all interrupts unmasked, any IPL sends the event */
+    u.u64 = (uintptr_t)&m68k_stop_level;
+    *ptr++ = mov64_immed_u16(limit, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(limit, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(limit, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(limit, u.u16[0], 3);
+    *ptr++ = mov_immed_u16(tmp, 0, 0);
+    *ptr++ = strb_offset(limit, tmp, 0);
+    *ptr++ = dmb_ish();
+#endif
+
+#if EMU68_ASYNC_INT
+    /* Flag is non-zero as long as INT was not signalled */
+    if (int_signal_gicc != NULL)
+    {
+        *ptr++ = mov_simd_to_reg(tmp, 29, TS_S, 3);
+        *ptr++ = cbz(tmp, 2);
+    }
+    else
+#endif
+    {
+        *ptr++ = ldr_offset(ctx, tmp, __builtin_offsetof(struct M68KState, INT));
+        *ptr++ = cbnz(tmp, 2);
+    }
+    *ptr++ = wfe();
+
+#if defined(PISTORM) && PISTORM_STOP_WAKE
+    *ptr++ = mov_immed_u16(tmp, 0xff, 0);
+    *ptr++ = strb_offset(limit, tmp, 0);
+#endif
+
+    /* Time in wfe is no gap, next pass waits again unless the loop is left */
+    *ptr++ = mrs(now, 3, 3, 14, 0, 1);
+    *ptr++ = str64_offset(ctx, now, __builtin_offsetof(struct M68KState, IDLE_LAST));
+
+    *new_spin = b(ptr - new_spin);
+    *done = b_cc(A64_CC_CC, ptr - done);
+
+    RA_FreeARMRegister(&ptr, limit);
+    RA_FreeARMRegister(&ptr, tmp);
+    RA_FreeARMRegister(&ptr, now);
+
+    return ptr;
+}
+#endif
+
 void __clear_cache(void *begin, void *end)
 {
-    arm_flush_cache((uintptr_t)begin, (uintptr_t)end - (uintptr_t)begin);
-    arm_icache_invalidate((uintptr_t)begin, (uintptr_t)end - (uintptr_t)begin);
+    arm_sync_code((uintptr_t)begin, (uintptr_t)begin, (uintptr_t)end - (uintptr_t)begin);
+}
+
+#if EMU68_BATCH_CODE_SYNC
+/* Range of new code waiting for cache maintenance while code_sync_batch is set, see SyncNewCode */
+static int code_sync_batch;
+static uintptr_t code_sync_lo;
+static uintptr_t code_sync_hi;
+
+/* End of the batch, translator lock must be held since beginning it */
+static void SyncBatchEnd()
+{
+    if (code_sync_hi != 0)
+        arm_sync_code(code_sync_lo, code_sync_lo | 0x0000001000000000ULL, code_sync_hi - code_sync_lo);
+
+    code_sync_batch = 0;
+    code_sync_lo = code_sync_hi = 0;
+}
+#endif
+
+/*
+    Make new code of a unit visible to instruction fetch. Within a batch the range is only merged
+    with the pending one, unless it is too far from it
+*/
+static void SyncNewCode(void *code, uint32_t length)
+{
+    uintptr_t lo = (uintptr_t)code & ~0x0000001000000000ULL;
+
+#if EMU68_BATCH_CODE_SYNC
+    if (code_sync_batch)
+    {
+        uintptr_t hi = lo + length;
+
+        if (code_sync_hi != 0 && (lo > code_sync_hi + EMU68_CODE_SYNC_GAP || hi + EMU68_CODE_SYNC_GAP < code_sync_lo))
+            arm_sync_code(code_sync_lo, code_sync_lo | 0x0000001000000000ULL, code_sync_hi - code_sync_lo);
+        else if (code_sync_hi != 0)
+        {
+            if (code_sync_lo < lo)
+                lo = code_sync_lo;
+            if (code_sync_hi > hi)
+                hi = code_sync_hi;
+        }
+
+        code_sync_lo = lo;
+        code_sync_hi = hi;
+
+        return;
+    }
+#endif
+
+    arm_sync_code(lo, lo | 0x0000001000000000ULL, length);
 }
 
 #define RTSTACK_SIZE    32
@@ -229,14 +775,34 @@ uint16_t *M68K_PopReturnAddress(uint8_t *success)
     return ptr;
 }
 
+#if EMU68_LEAF_INLINE
+/* Return stack depth at the entry of a subroutine inlined from ROM, 0 outside of it */
+static uint16_t rom_leaf_depth;
+#endif
+
 void M68K_ResetReturnStack()
 {
     ReturnStackDepth = 0;
+#if EMU68_LEAF_INLINE
+    rom_leaf_depth = 0;
+#endif
+}
+
+/* Translation continues in a ROM subroutine whose return address was pushed last */
+void M68K_EnterROMLeaf()
+{
+#if EMU68_LEAF_INLINE
+    if (rom_leaf_depth == 0)
+        rom_leaf_depth = ReturnStackDepth;
+#endif
 }
 
 uint16_t *m68k_high;
 uint16_t *m68k_low;
 uint32_t insn_count;
+#if EMU68_INSN_COUNTER
+uint8_t insn_count_precise = 1;
+#endif
 uint32_t prologue_size = 0;
 uint32_t epilogue_size = 0;
 uint32_t conditionals_count = 0;
@@ -244,390 +810,4172 @@ uint32_t conditionals_count = 0;
 void M68K_PrintContext(void *);
 
 
+uint32_t val_FPIAR;
+
+#if EMU68_BLOCK_CHAINING
+struct ChainExit {
+    uint32_t    ce_ARMOffset;
+    uint32_t    ce_Way;
+    uint16_t *  ce_M68kTarget;
+};
 
-uint32_t debug_range_min = 0x00000000;
-uint32_t debug_range_max = 0xffffffff;
+#define CHAIN_WAY_STATIC    0xffffffff
 
-// Bad hack: two registers holding addresses of Load96bit and Save96bit
-uint8_t reg_Load96;
-uint8_t reg_Save96;
-uint32_t val_FPIAR;
+static struct ChainExit chain_exits[JCCB_INSN_DEPTH_MASK + 2];
+static uint32_t chain_count;
 
-uint32_t * EMIT_LocalExit(uint32_t *ptr, uint32_t insn_fixup)
+/*
+    Branch by offset if an interrupt may be pending, clobbers w1. Always three instructions,
+    the layout of chainable exits is fixed. If changes of INT are signalled by IRQ only the
+    flag in v29 is tested, otherwise INT is loaded from the context.
+*/
+static uint32_t *EMIT_TestINT(uint32_t *ptr, int offset)
 {
-    RA_StoreDirtyFPURegs(&ptr);
-    RA_StoreDirtyM68kRegs(&ptr);
-    ptr = EMIT_FlushPC(ptr);
-
-    RA_StoreCC(&ptr);
-    RA_StoreFPCR(&ptr);
-    RA_StoreFPSR(&ptr);
+#if EMU68_ASYNC_INT
+    if (int_signal_gicc != NULL)
+    {
+        *ptr++ = mov_simd_to_reg(1, 29, TS_S, 3);
+        *ptr++ = nop();
+        *ptr++ = cbz(1, offset);
 
-#if EMU68_INSN_COUNTER
-    uint32_t insn_count_local = insn_count + insn_fixup;
-    uint8_t tmp = RA_AllocARMRegister(&ptr);
-    *ptr++ = mov_immed_u16(tmp, insn_count_local & 0xffff, 0);
-    if (insn_count & 0xffff0000) {
-        *ptr++ = movk_immed_u16(tmp, insn_count_local >> 16, 1);
-    }
-    *ptr++ = fmov_from_reg(0, tmp);
-    *ptr++ = vadd_2d(30, 30, 0);
-    
-    if (val_FPIAR != 0xffffffff) {
-        *ptr++ = mov_immed_u16(tmp, val_FPIAR & 0xffff, 0);
-        *ptr++ = movk_immed_u16(tmp, val_FPIAR >> 16, 1);
-        *ptr++ = mov_reg_to_simd(29, TS_S, 1, tmp);
+        return ptr;
     }
-
-    RA_FreeARMRegister(&ptr, tmp);
-#else
-    (void)insn_fixup;
 #endif
 
-    *ptr++ = bx_lr();
+    *ptr++ = mrs(1, 3, 3, 13, 0, 3);
+    *ptr++ = ldr_offset(1, 1, __builtin_offsetof(struct M68KState, INT));
+    *ptr++ = cbnz(1, offset);
 
     return ptr;
 }
 
-uint16_t * m68k_entry_point;
+/*
+    Emit return to the main loop which can be later patched into a direct branch
+    to the translation unit at m68k_target. The address of corresponding
+    M68KChainLink is returned in x0, the pointer itself is stored in a literal
+    directly after the exit and is filled once the unit is created.
 
-static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
+    Unless interrupts are pending and the JIT cache is enabled the patched branch
+    is taken directly, otherwise the exit returns to the main loop as usual.
+*/
+static uint32_t *EMIT_ChainSite(uint32_t *ptr, uint16_t *m68k_target)
+{
+    if (chain_count >= sizeof(chain_exits) / sizeof(chain_exits[0]))
+    {
+        *ptr++ = mov64_immed_u16(0, 0, 0);
+        *ptr++ = bx_lr();
+
+        return ptr;
+    }
+
+    /* Keep the literal 8-byte aligned */
+    if ((uintptr_t)ptr & 7)
+        *ptr++ = nop();
+
+    chain_exits[chain_count].ce_ARMOffset = ptr - temporary_arm_code;
+    chain_exits[chain_count].ce_Way = CHAIN_WAY_STATIC;
+    chain_exits[chain_count].ce_M68kTarget = m68k_target;
+    chain_count++;
+
+    *ptr++ = ldr64_pcrel(0, CHAIN_LINK_LITERAL);
+    ptr = EMIT_TestINT(ptr, 4);
+    *ptr++ = mov_simd_to_reg(1, 31, TS_S, 0);
+    *ptr++ = tbz(1, CACRB_IE, 2);
+    *ptr++ = bx_lr();   /* Patched into b <target> by M68K_ChainUnits */
+    *ptr++ = bx_lr();
+    *ptr++ = 0;
+    *ptr++ = 0;
+
+    return ptr;
+}
+
+/*
+    Emit exit with dynamic target, e.g. JMP (An) or JSR -LVO(A6). It is an inline
+    cache of INDIRECT_WAYS entries. Each way compares PC with the guard literal
+    and takes the patched branch on match. Guards are set by M68K_ChainUnits when
+    the main loop resolves a target for this exit, until then they hold
+    INDIRECT_GUARD_EMPTY.
+
+    On a miss the pointer to the first link is returned in x0. With interrupt
+    pending or JIT cache disabled x0 is cleared, the target would not be the one
+    of the exit.
+*/
+static uint32_t *EMIT_IndirectSite(uint32_t *ptr)
+{
+    uint32_t *site;
+
+    if (chain_count + INDIRECT_WAYS > sizeof(chain_exits) / sizeof(chain_exits[0]))
+    {
+        *ptr++ = mov64_immed_u16(0, 0, 0);
+        *ptr++ = bx_lr();
+
+        return ptr;
+    }
+
+    /* Keep the literal 8-byte aligned */
+    if ((uintptr_t)ptr & 7)
+        *ptr++ = nop();
+
+    site = ptr;
+
+    for (int way=0; way < INDIRECT_WAYS; way++)
+    {
+        chain_exits[chain_count].ce_ARMOffset = site - temporary_arm_code;
+        chain_exits[chain_count].ce_Way = way;
+        chain_exits[chain_count].ce_M68kTarget = NULL;
+        chain_count++;
+    }
+
+    *ptr++ = ldr64_pcrel(0, INDIRECT_LINK_LITERAL);
+    ptr = EMIT_TestINT(ptr, 12);
+    *ptr++ = mov_simd_to_reg(1, 31, TS_S, 0);
+    *ptr++ = tbz(1, CACRB_IE, 10);
+    for (int way=0; way < INDIRECT_WAYS; way++)
+    {
+        *ptr = ldr_pcrel(1, &site[INDIRECT_GUARD_OFFSET + way] - ptr);
+        ptr++;
+        *ptr++ = cmp_reg(1, REG_PC, LSL, 0);
+        *ptr++ = b_cc(A64_CC_NE, 2);
+        *ptr++ = bx_lr();   /* Patched into b <target> by M68K_ChainUnits */
+    }
+    *ptr++ = bx_lr();
+    *ptr++ = mov64_immed_u16(0, 0, 0);
+    *ptr++ = bx_lr();
+    for (int way=0; way < INDIRECT_WAYS; way++)
+        *ptr++ = INDIRECT_GUARD_EMPTY;
+    *ptr++ = 0;
+    *ptr++ = 0;
+    *ptr++ = 0;
+
+    return ptr;
+}
+#endif
+
+#if EMU68_COLD_STUBS
+/*
+    Rarely taken paths, e.g. exceptions of CHK or division by zero, are moved behind the exit of
+    the unit. The conditional branch skipping such path is inverted and gets the moved copy as
+    target, so that the hot code falls through. Paths are copied as they are, they may not be
+    entered by any other branch and may not refer to code or literals outside of themselves
+*/
+struct ColdStub {
+    uint32_t *  cs_Branch;
+    uint32_t    cs_Offset;
+    uint32_t *  cs_Target;      /* Target of the branch back, if the path returns */
+    uint32_t    cs_Return;
+};
+
+static uint32_t cold_code[EMU68_COLD_CODE_SIZE];
+static uint32_t cold_length;
+static struct ColdStub cold_stubs[EMU68_COLD_STUBS_MAX];
+static uint32_t cold_count;
+
+/*
+    Copy the code from start to end into the cold section, branch will be pointed at the copy.
+    Position modulo 8 bytes is kept, literals of the path stay aligned. Returns 0 if it is full
+*/
+static int ColdCopy(uint32_t *branch, uint32_t *start, uint32_t *end)
+{
+    uint32_t length = end - start;
+    uint32_t pad = (((uintptr_t)start >> 2) ^ cold_length) & 1;
+
+    if (cold_count == EMU68_COLD_STUBS_MAX || cold_length + pad + length > EMU68_COLD_CODE_SIZE)
+        return 0;
+
+    if (pad)
+        cold_code[cold_length++] = nop();
+
+    cold_stubs[cold_count].cs_Branch = branch;
+    cold_stubs[cold_count].cs_Offset = cold_length;
+    cold_stubs[cold_count].cs_Target = NULL;
+    cold_count++;
+
+    for (uint32_t i=0; i < length; i++)
+        cold_code[cold_length++] = start[i];
+
+    return 1;
+}
+
+/*
+    Move the code from start to end into the cold section. The instruction before start has to
+    be B.cond, CBZ or CBNZ skipping it. Returns start if the code was moved, end otherwise
+*/
+uint32_t *EMIT_ColdStub(uint32_t *start, uint32_t *end)
+{
+    uint32_t *branch = start - 1;
+    uint32_t insn = INSN_TO_LE(*branch);
+
+    if ((insn & 0xff000010) == 0x54000000)
+        insn ^= 1;
+    else if ((insn & 0x7e000000) == 0x34000000)
+        insn ^= 1 << 24;
+    else
+        return end;
+
+    if (!ColdCopy(branch, start, end))
+        return end;
+
+    *branch = INSN_TO_LE(insn & ~(0x7ffff << 5));
+
+    return start;
+}
+
+/*
+    As EMIT_ColdStub, but the path returns. Its last instruction is a B placeholder, *rejoin is
+    updated to its copy and has to be set with EMIT_Rejoin
+*/
+uint32_t *EMIT_ColdPath(uint32_t *start, uint32_t *end, uint32_t **rejoin)
+{
+    if (EMIT_ColdStub(start, end) != start)
+        return end;
+
+    *rejoin = &cold_code[cold_stubs[cold_count - 1].cs_Offset + (*rejoin - start)];
+
+    return start;
+}
+
+/*
+    Move the exit from start to end into the cold section, the code falling into it jumps there
+    instead. The exit may be entered by fall through only. Returns end of the code left in place
+*/
+static uint32_t *EMIT_ColdExit(uint32_t *start, uint32_t *end)
+{
+    if (end - start <= 1 || !ColdCopy(start, start, end))
+        return end;
+
+    *start = b(0);
+
+    return start + 1;
+}
+
+/* Append the cold section to the unit and let the branches point there */
+static uint32_t *EMIT_ColdSection(uint32_t *ptr)
+{
+    if (cold_count == 0)
+        return ptr;
+
+    if ((uintptr_t)ptr & 4)
+        *ptr++ = nop();
+
+    for (uint32_t i=0; i < cold_count; i++)
+    {
+        uint32_t *branch = cold_stubs[i].cs_Branch;
+        uint32_t insn = INSN_TO_LE(*branch);
+        int32_t offset = &ptr[cold_stubs[i].cs_Offset] - branch;
+
+        if ((insn & 0xfc000000) == 0x14000000)
+            *branch = b(offset);
+        else
+            *branch = INSN_TO_LE(insn | ((offset & 0x7ffff) << 5));
+    }
+
+    for (uint32_t i=0; i < cold_length; i++)
+        ptr[i] = cold_code[i];
+
+    for (uint32_t i=0; i < cold_count; i++)
+    {
+        if (cold_stubs[i].cs_Target)
+        {
+            uint32_t *branch = &ptr[cold_stubs[i].cs_Return];
+            *branch = b(cold_stubs[i].cs_Target - branch);
+        }
+    }
+
+    ptr += cold_length;
+
+    cold_length = 0;
+    cold_count = 0;
+
+    return ptr;
+}
+#endif
+
+/* Point the B placeholder at target, the placeholder may have been moved by EMIT_ColdPath */
+void EMIT_Rejoin(uint32_t *branch, uint32_t *target)
+{
+#if EMU68_COLD_STUBS
+    if (branch >= cold_code && branch < &cold_code[cold_length])
+    {
+        uint32_t offset = branch - cold_code;
+        uint32_t i = cold_count;
+
+        while (cold_stubs[--i].cs_Offset > offset);
+
+        cold_stubs[i].cs_Target = target;
+        cold_stubs[i].cs_Return = offset;
+
+        return;
+    }
+#endif
+
+    *branch = b(target - branch);
+}
+
+static uint32_t * EMIT_ExitCommon(uint32_t *ptr, uint32_t insn_fixup)
+{
+    RA_StoreDirtyFPURegs(&ptr);
+    RA_StoreDirtyM68kRegs(&ptr);
+    ptr = EMIT_FlushPC(ptr);
+
+    RA_StoreCC(&ptr);
+    RA_StoreFPCR(&ptr);
+    RA_StoreFPSR(&ptr);
+
+#if EMU68_INSN_COUNTER
+    uint32_t insn_count_local = insn_count + insn_fixup;
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    if (insn_count_precise) {
+        *ptr++ = mov_immed_u16(tmp, insn_count_local & 0xffff, 0);
+        if (insn_count & 0xffff0000) {
+            *ptr++ = movk_immed_u16(tmp, insn_count_local >> 16, 1);
+        }
+        *ptr++ = fmov_from_reg(0, tmp);
+        *ptr++ = vadd_2d(30, 30, 0);
+    }
+    
+    if (val_FPIAR != 0xffffffff) {
+        *ptr++ = mov_immed_u16(tmp, val_FPIAR & 0xffff, 0);
+        *ptr++ = movk_immed_u16(tmp, val_FPIAR >> 16, 1);
+        *ptr++ = mov_reg_to_simd(29, TS_S, 1, tmp);
+    }
+
+    RA_FreeARMRegister(&ptr, tmp);
+#else
+    (void)insn_fixup;
+#endif
+
+    return ptr;
+}
+
+uint32_t * EMIT_LocalExit(uint32_t *ptr, uint32_t insn_fixup)
+{
+    ptr = EMIT_ExitCommon(ptr, insn_fixup);
+
+#if EMU68_BLOCK_CHAINING
+    /* Dynamic exit, nothing to chain */
+    *ptr++ = mov64_immed_u16(0, 0, 0);
+#endif
+    *ptr++ = bx_lr();
+
+    return ptr;
+}
+
+/*
+    Local exit with statically known m68k target. If block chaining is enabled
+    the exit will jump directly to the target unit once it is translated.
+*/
+uint32_t * EMIT_ChainedExit(uint32_t *ptr, uint32_t insn_fixup, uint16_t *m68k_target)
+{
+    ptr = EMIT_ExitCommon(ptr, insn_fixup);
+
+#if EMU68_BLOCK_CHAINING
+    ptr = EMIT_ChainSite(ptr, m68k_target);
+#else
+    (void)m68k_target;
+    *ptr++ = bx_lr();
+#endif
+
+    return ptr;
+}
+
+#if EMU68_SHADOW_STACK
+/*
+    Push return address of BSR/JSR together with entry point of the unit at that
+    address onto the shadow stack. The entry point is taken from the jump cache slot
+    of the return address, which is known at translation time. If the slot holds
+    other address, NULL is pushed and the matching RTS takes the usual exit.
+*/
+uint32_t *EMIT_PushReturnPrediction(uint32_t *ptr, uint16_t *ret_addr)
+{
+    uint32_t ret = (uint32_t)(uintptr_t)ret_addr;
+    uint32_t jc = __builtin_offsetof(struct M68KState, JIT_JCACHE) +
+                    ((ret >> 1) & EMU68_JCACHE_MASK) * sizeof(struct M68KJumpCacheEntry);
+    uint8_t ctx = RA_GetCTX(&ptr);
+    uint8_t addr = RA_AllocARMRegister(&ptr);
+    uint8_t entry = RA_AllocARMRegister(&ptr);
+    uint8_t pc = RA_AllocARMRegister(&ptr);
+
+    *ptr++ = ldr_offset(ctx, addr, jc);
+    *ptr++ = ldr64_offset(ctx, entry, jc + 8);
+    *ptr++ = mov_immed_u16(pc, ret & 0xffff, 0);
+    *ptr++ = movk_immed_u16(pc, ret >> 16, 1);
+    *ptr++ = cmp_reg(addr, pc, LSL, 0);
+    *ptr++ = b_cc(A64_CC_EQ, 2);
+    *ptr++ = mov64_immed_u16(entry, 0, 0);
+    *ptr++ = ldr_offset(ctx, addr, __builtin_offsetof(struct M68KState, JIT_SSTACK_TOP));
+    *ptr++ = add_immed(addr, addr, 1);
+    *ptr++ = and_immed(addr, addr, EMU68_SHADOW_STACK_BITS, 0);
+    *ptr++ = str_offset(ctx, addr, __builtin_offsetof(struct M68KState, JIT_SSTACK_TOP));
+    *ptr++ = add64_reg(addr, ctx, addr, LSL, 4);
+    *ptr++ = str_offset(addr, pc, __builtin_offsetof(struct M68KState, JIT_SSTACK));
+    *ptr++ = str64_offset(addr, entry, __builtin_offsetof(struct M68KState, JIT_SSTACK) + 8);
+
+    RA_FreeARMRegister(&ptr, pc);
+    RA_FreeARMRegister(&ptr, entry);
+    RA_FreeARMRegister(&ptr, addr);
+
+    return ptr;
+}
+
+/*
+    Pop the shadow stack at the unit exit following RTS/RTR/RTD. If the popped return
+    address matches PC and its entry point is known, branch there directly. Like the
+    chained exits, this is done only if no interrupt is pending and the JIT cache is
+    enabled. All other cases fall through to the regular exit emitted by the caller.
+*/
+static uint32_t *EMIT_PopReturnPrediction(uint32_t *ptr)
+{
+    *ptr++ = mrs(1, 3, 3, 13, 0, 3);
+    *ptr++ = ldr_offset(1, 2, __builtin_offsetof(struct M68KState, JIT_SSTACK_TOP));
+    *ptr++ = add64_reg(3, 1, 2, LSL, 4);
+    *ptr++ = sub_immed(2, 2, 1);
+    *ptr++ = and_immed(2, 2, EMU68_SHADOW_STACK_BITS, 0);
+    *ptr++ = str_offset(1, 2, __builtin_offsetof(struct M68KState, JIT_SSTACK_TOP));
+    *ptr++ = ldr_offset(3, 2, __builtin_offsetof(struct M68KState, JIT_SSTACK));
+    *ptr++ = ldr64_offset(3, 3, __builtin_offsetof(struct M68KState, JIT_SSTACK) + 8);
+    *ptr++ = cmp_reg(2, REG_PC, LSL, 0);
+    *ptr++ = b_cc(A64_CC_NE, 7);
+    *ptr++ = cbz_64(3, 6);
+#if EMU68_ASYNC_INT
+    if (int_signal_gicc != NULL)
+    {
+        *ptr++ = mov_simd_to_reg(2, 29, TS_S, 3);
+        *ptr++ = cbz(2, 4);
+    }
+    else
+#endif
+    {
+        *ptr++ = ldr_offset(1, 2, __builtin_offsetof(struct M68KState, INT));
+        *ptr++ = cbnz(2, 4);
+    }
+    *ptr++ = mov_simd_to_reg(2, 31, TS_S, 0);
+    *ptr++ = tbz(2, CACRB_IE, 2);
+    *ptr++ = br(3);
+
+    return ptr;
+}
+
+/*
+    Exit following RTE. The main loop pushes the interrupted PC when it takes an interrupt, the
+    stack is popped only if its top matches the PC restored from the frame. Frames of other
+    exceptions have no entry and leave the stack as it was. Matching entry is left through
+    its entry point under the same conditions as in EMIT_PopReturnPrediction.
+*/
+static uint32_t *EMIT_PopExceptionReturn(uint32_t *ptr)
+{
+    uint32_t *miss;
+    uint32_t *empty;
+
+    *ptr++ = mrs(1, 3, 3, 13, 0, 3);
+    *ptr++ = ldr_offset(1, 2, __builtin_offsetof(struct M68KState, JIT_SSTACK_TOP));
+    *ptr++ = add64_reg(3, 1, 2, LSL, 4);
+    *ptr++ = ldr_offset(3, 3, __builtin_offsetof(struct M68KState, JIT_SSTACK));
+    *ptr++ = cmp_reg(3, REG_PC, LSL, 0);
+    miss = ptr;
+    *ptr++ = b_cc(A64_CC_NE, 0);
+    *ptr++ = add64_reg(3, 1, 2, LSL, 4);
+    *ptr++ = ldr64_offset(3, 3, __builtin_offsetof(struct M68KState, JIT_SSTACK) + 8);
+    *ptr++ = sub_immed(2, 2, 1);
+    *ptr++ = and_immed(2, 2, EMU68_SHADOW_STACK_BITS, 0);
+    *ptr++ = str_offset(1, 2, __builtin_offsetof(struct M68KState, JIT_SSTACK_TOP));
+    empty = ptr;
+    *ptr++ = cbz_64(3, 0);
+#if EMU68_ASYNC_INT
+    if (int_signal_gicc != NULL)
+    {
+        *ptr++ = mov_simd_to_reg(2, 29, TS_S, 3);
+        *ptr++ = cbz(2, 4 + 2 * EMU68_TRACE_CACHE);
+    }
+    else
+#endif
+    {
+        *ptr++ = ldr_offset(1, 2, __builtin_offsetof(struct M68KState, INT));
+        *ptr++ = cbnz(2, 4 + 2 * EMU68_TRACE_CACHE);
+    }
+    *ptr++ = mov_simd_to_reg(2, 31, TS_S, 0);
+    *ptr++ = tbz(2, CACRB_IE, 2 + 2 * EMU68_TRACE_CACHE);
+#if EMU68_TRACE_CACHE
+    /* Return into traced code, the main loop runs it one instruction at a time */
+    *ptr++ = mrs(2, 3, 3, 13, 0, 2);
+    *ptr++ = tbnz(2, SRB_T1, 2);
+#endif
+    *ptr++ = br(3);
+
+    *miss = b_cc(A64_CC_NE, ptr - miss);
+    *empty = cbz_64(3, ptr - empty);
+
+    return ptr;
+}
+#endif
+
+uint16_t * m68k_entry_point;
+#if EMU68_DBCC_INT_INTERVAL > 1
+/* m68k register counting passes of the loop closed by the last instruction, 0xff if none */
+uint8_t m68k_loop_counter;
+#endif
+uint16_t * m68k_exit_target;
+int m68k_exit_return;
+int m68k_exit_exception;
+int m68k_exit_indirect;
+#if EMU68_TRACE_CACHE
+int m68k_single_step;
+#endif
+
+#if EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+/*
+    Entry counter of tier 0 unit. Once it expires, the unit returns to the main loop
+    with its own address and TIER_UP_FLAG in x0, before any m68k code is executed.
+*/
+static uint32_t *EMIT_TierCounter(uint32_t *ptr)
+{
+    *ptr = adr(0, -(int32_t)(4 * (ptr - temporary_arm_code) + __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode)));
+    ptr++;
+    *ptr++ = bic64_immed(0, 0, 1, 28, 1);   /* Exec alias -> RW alias */
+    *ptr++ = ldr_offset(0, 1, __builtin_offsetof(struct M68KTranslationUnit, mt_TierCount));
+    *ptr++ = subs_immed(1, 1, 1);
+    *ptr++ = str_offset(0, 1, __builtin_offsetof(struct M68KTranslationUnit, mt_TierCount));
+    *ptr++ = b_cc(A64_CC_NE, 3);
+    *ptr++ = add64_immed(0, 0, TIER_UP_FLAG);
+    *ptr++ = bx_lr();
+
+    return ptr;
+}
+#endif
+
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+/* Translation limits learned for code at given m68k address. Depth of 0 means no hint */
+struct DepthHint {
+    uint32_t    dh_M68kAddress;
+    uint16_t    dh_Depth;
+    uint8_t     dh_Loops;
+    uint8_t     dh_Invalidations;
+};
+
+static struct DepthHint depth_hints[EMU68_ADAPT_SIZE];
+
+static struct DepthHint *DepthHint_Get(uint16_t *m68k_address)
+{
+    struct DepthHint *h = &depth_hints[((uintptr_t)m68k_address >> 1) & EMU68_ADAPT_MASK];
+
+    /* Entry belongs to other code, take it over */
+    if (h->dh_M68kAddress != (uint32_t)(uintptr_t)m68k_address)
+    {
+        h->dh_M68kAddress = (uint32_t)(uintptr_t)m68k_address;
+        h->dh_Depth = 0;
+        h->dh_Loops = 0;
+        h->dh_Invalidations = 0;
+    }
+
+    return h;
+}
+
+static void GetGlobalLimits(uint32_t *depth, uint32_t *loops)
+{
+    *depth = (__m68k_state->JIT_CONTROL >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK;
+    if (*depth == 0)
+        *depth = JCCB_INSN_DEPTH_MASK + 1;
+    *loops = (__m68k_state->JIT_CONTROL >> JCCB_LOOP_COUNT) & JCCB_LOOP_COUNT_MASK;
+    if (*loops == 0)
+        *loops = JCCB_LOOP_COUNT_MASK + 1;
+}
+
+/* Code of the unit has changed. Code rewritten over and over is translated again, keep it short */
+static void DepthHint_Invalidated(struct M68KTranslationUnit *unit)
+{
+#if !EMU68_SMC_SPLIT
+    if ((__m68k_state->JIT_CONTROL2 & JC2F_ADAPTIVE_DEPTH) == 0)
+        return;
+#endif
+
+    struct DepthHint *h = DepthHint_Get(unit->mt_M68kAddress);
+
+    if (h->dh_Invalidations < 255)
+        h->dh_Invalidations++;
+
+    if (h->dh_Invalidations >= EMU68_ADAPT_INVALIDATIONS)
+    {
+        uint32_t depth = unit->mt_Info->mi_M68kInsnCnt / 2;
+
+        if (depth < EMU68_ADAPT_MIN_DEPTH)
+            depth = EMU68_ADAPT_MIN_DEPTH;
+
+        h->dh_Depth = depth;
+        h->dh_Loops = 1;
+    }
+}
+
+/*
+    Tier 0 unit is promoted. If it left through side exits on at least every second entry,
+    the code past them is rarely executed and tier 1 gets half of the depth. Units with
+    hardly any side exits are stable and get twice the depth and loop count.
+*/
+static void DepthHint_Promoted(struct M68KTranslationUnit *unit)
+{
+    uint32_t side_exits = unit->mt_SideExits;
+    uint32_t depth, loops;
+
+    unit->mt_SideExits = 0;
+
+    if ((__m68k_state->JIT_CONTROL2 & JC2F_ADAPTIVE_DEPTH) == 0)
+        return;
+
+    struct DepthHint *h = DepthHint_Get(unit->mt_M68kAddress);
+
+    if (h->dh_Invalidations >= EMU68_ADAPT_INVALIDATIONS)
+        return;
+
+    GetGlobalLimits(&depth, &loops);
+
+    if (side_exits * 2 >= EMU68_TIER_THRESHOLD)
+    {
+        depth /= 2;
+        loops = (loops + 1) / 2;
+        if (depth < EMU68_ADAPT_MIN_DEPTH)
+            depth = EMU68_ADAPT_MIN_DEPTH;
+    }
+    else if (side_exits * 16 < EMU68_TIER_THRESHOLD && h->dh_Invalidations == 0)
+    {
+        depth *= 2;
+        loops *= 2;
+        if (depth > JCCB_INSN_DEPTH_MASK + 1)
+            depth = JCCB_INSN_DEPTH_MASK + 1;
+        if (loops > JCCB_LOOP_COUNT_MASK + 1)
+            loops = JCCB_LOOP_COUNT_MASK + 1;
+    }
+    else
+    {
+        depth = 0;
+    }
+
+    h->dh_Depth = depth;
+    h->dh_Loops = loops;
+}
+
+/* Count side exit taken by tier 0 unit. Must follow EMIT_ExitCommon, x0 and x1 are free then */
+static uint32_t *EMIT_SideExitCounter(uint32_t *ptr)
+{
+    *ptr = adr(0, -(int32_t)(4 * (ptr - temporary_arm_code) + __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode)));
+    ptr++;
+    *ptr++ = bic64_immed(0, 0, 1, 28, 1);   /* Exec alias -> RW alias */
+    *ptr++ = ldr_offset(0, 1, __builtin_offsetof(struct M68KTranslationUnit, mt_SideExits));
+    *ptr++ = add_immed(1, 1, 1);
+    *ptr++ = str_offset(0, 1, __builtin_offsetof(struct M68KTranslationUnit, mt_SideExits));
+
+    return ptr;
+}
+#endif
+
+#if EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+/* Direction of Bcc at given m68k address to be kept inline. Filled when tier 0 units are promoted */
+struct BranchHint {
+    uint32_t    bh_M68kAddress;
+    uint32_t    bh_Hint;
+};
+
+static struct BranchHint branch_hints[EMU68_BRANCH_HINT_SIZE];
+
+/* Set while tier 0 unit is translated. Profiled branches get slots in order of translation */
+static int branch_profile;
+static uint32_t branch_profile_count;
+static uint32_t branch_profile_pc[EMU68_BRANCH_PROFILE_SLOTS];
+static int branch_profile_overflow;
+
+/*
+    Count the out-of-line direction of Bcc in tier 0 unit. Emitted right in front of its chained
+    exit while x0 and x1 are not in use.
+*/
+uint32_t *EMIT_BranchProfile(uint32_t *ptr, uint16_t *bcc, int taken_inline)
+{
+    if (!branch_profile)
+        return ptr;
+
+    if (branch_profile_count == EMU68_BRANCH_PROFILE_SLOTS)
+    {
+        branch_profile_overflow = 1;
+        return ptr;
+    }
+
+    uint32_t offset = __builtin_offsetof(struct M68KTranslationUnit, mt_BranchExits) + 4 * branch_profile_count;
+
+    branch_profile_pc[branch_profile_count++] = (uint32_t)(uintptr_t)bcc | (taken_inline ? 1 : 0);
+
+    *ptr = adr(0, -(int32_t)(4 * (ptr - temporary_arm_code) + __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode)));
+    ptr++;
+    *ptr++ = bic64_immed(0, 0, 1, 28, 1);   /* Exec alias -> RW alias */
+    *ptr++ = ldr_offset(0, 1, offset);
+    *ptr++ = add_immed(1, 1, 1);
+    *ptr++ = str_offset(0, 1, offset);
+
+    return ptr;
+}
+
+int M68K_GetBranchHint(uint16_t *bcc)
+{
+    struct BranchHint *h = &branch_hints[((uintptr_t)bcc >> 1) & EMU68_BRANCH_HINT_MASK];
+
+    if (h->bh_M68kAddress != (uint32_t)(uintptr_t)bcc)
+        return BRANCH_HINT_NONE;
+
+    return h->bh_Hint;
+}
+
+/*
+    Tier 0 unit is promoted. A branch which left the unit on at least every second entry goes
+    the other way than it was laid out, one which left it hardly ever confirms the layout.
+*/
+static void BranchHint_Promoted(struct M68KTranslationUnit *unit)
+{
+    for (int i=0; i < EMU68_BRANCH_PROFILE_SLOTS && unit->mt_BranchPC[i] != 0; i++)
+    {
+        uint32_t pc = unit->mt_BranchPC[i] & ~1;
+        int taken_inline = unit->mt_BranchPC[i] & 1;
+        uint32_t exits = unit->mt_BranchExits[i];
+        struct BranchHint *h = &branch_hints[(pc >> 1) & EMU68_BRANCH_HINT_MASK];
+
+        unit->mt_BranchExits[i] = 0;
+
+        if (exits * 2 >= EMU68_TIER_THRESHOLD)
+            taken_inline = !taken_inline;
+        else if (exits * 16 >= EMU68_TIER_THRESHOLD)
+            continue;
+
+        h->bh_M68kAddress = pc;
+        h->bh_Hint = taken_inline ? BRANCH_HINT_TAKEN : BRANCH_HINT_NOT_TAKEN;
+    }
+}
+
+#if EMU68_SUPERBLOCKS
+/* Jump target to be translated together with the unit at given m68k address */
+struct SuperblockHint {
+    uint32_t    sh_M68kAddress;
+    uint32_t    sh_Target;
+};
+
+static struct SuperblockHint superblock_hints[EMU68_BRANCH_HINT_SIZE];
+
+/* Target of jump ending the unit, merged into current translation. Final static target of the unit */
+static uint16_t *superblock_target;
+static uint32_t unit_exit_target;
+
+static uint16_t *Superblock_Get(uint16_t *m68k_address)
+{
+    struct SuperblockHint *h = &superblock_hints[((uintptr_t)m68k_address >> 1) & EMU68_BRANCH_HINT_MASK];
+
+    if (h->sh_M68kAddress != (uint32_t)(uintptr_t)m68k_address || h->sh_Target == 0)
+        return NULL;
+
+    return (uint16_t *)(uintptr_t)h->sh_Target;
+}
+
+/*
+    Tier 0 unit is promoted. If the final jump was reached on almost every entry, its target
+    becomes part of the tier 1 translation. Must be called before the exit counters are reset
+*/
+static void Superblock_Promoted(struct M68KTranslationUnit *unit)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+    uint32_t target = unit->mt_ExitTarget;
+    uint32_t exits = unit->mt_SideExits;
+    struct SuperblockHint *h = &superblock_hints[(pc >> 1) & EMU68_BRANCH_HINT_MASK];
+
+    /* Conditional side exits are counted with adaptive depth only */
+    if ((__m68k_state->JIT_CONTROL2 & JC2F_ADAPTIVE_DEPTH) == 0 && unit->mt_Info->mi_Conditionals != 0)
+        target = 0;
+
+    for (int i=0; i < EMU68_BRANCH_PROFILE_SLOTS && unit->mt_BranchPC[i] != 0; i++)
+        exits += unit->mt_BranchExits[i];
+
+    if (exits * 16 >= EMU68_TIER_THRESHOLD)
+        target = 0;
+
+    if (target > pc ? target - pc > EMU68_SUPERBLOCK_RANGE : pc - target > EMU68_SUPERBLOCK_RANGE)
+        target = 0;
+
+    /* Same as BRA inlining, code below 16MB is never merged */
+    if (pc < 0x01000000 || target < 0x01000000)
+        target = 0;
+
+    if (target == 0 && h->sh_M68kAddress != pc)
+        return;
+
+    h->sh_M68kAddress = pc;
+    h->sh_Target = target;
+}
+#endif
+#else
+uint32_t *EMIT_BranchProfile(uint32_t *ptr, uint16_t *bcc, int taken_inline)
+{
+    (void)bcc;
+    (void)taken_inline;
+
+    return ptr;
+}
+
+int M68K_GetBranchHint(uint16_t *bcc)
+{
+    (void)bcc;
+
+    return BRANCH_HINT_NONE;
+}
+#endif
+
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+/*
+    Compare generation of the unit with the global one. If a soft flush happened since the
+    unit was verified last time, return to the main loop with unit address and GENERATION_FLAG
+    in x0, before any m68k code is executed.
+*/
+static uint32_t *EMIT_GenerationCheck(uint32_t *ptr)
+{
+    int32_t unit_start = -(int32_t)(4 * (ptr - temporary_arm_code) + __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+
+    *ptr++ = ldr_pcrel(0, (unit_start + (int32_t)__builtin_offsetof(struct M68KTranslationUnit, mt_Generation)) / 4);
+    *ptr++ = mrs(1, 3, 3, 13, 0, 3);        /* TPIDRRO_EL0 - M68KState */
+    *ptr++ = ldr_offset(1, 1, __builtin_offsetof(struct M68KState, JIT_FLUSH_GEN));
+    *ptr++ = cmp_reg(0, 1, LSL, 0);
+    *ptr++ = b_cc(A64_CC_EQ, 5);
+    *ptr = adr(0, unit_start - 4 * 5);
+    ptr++;
+    *ptr++ = bic64_immed(0, 0, 1, 28, 1);   /* Exec alias -> RW alias */
+    *ptr++ = add64_immed(0, 0, GENERATION_FLAG);
+    *ptr++ = bx_lr();
+
+    return ptr;
+}
+
+#define GENERATION_CHECK_SIZE   9
+#endif
+
+#if EMU68_LOOP_HOIST
+/* Values worth loading before the body of the inner loop found by last translation pass */
+static uint8_t loop_hoist;
+#endif
+
+#if EMU68_LOCAL_LOOPS
+/* Instruction of the unit other than its first one reached backwards in last translation pass */
+static uint16_t *loop_join;
+#endif
+
+/*
+    Translate m68k code starting at m68kcodeptr into temporary_arm_code. If hoist is non-zero, values
+    given by RA_VAL_* mask are loaded once at the start of the unit and, if the unit is an inner
+    loop, kept in registers across the backedge. If join is not NULL, all state is written back
+    in front of the instruction at join and the unit closes a loop there once a branch comes back
+    to it. Returns size of ARM code in bytes.
+*/
+static inline uintptr_t M68K_TranslatePass(uint16_t *m68kcodeptr, uint32_t tier, uint8_t hoist, uint16_t *join)
+{
+    m68k_entry_point = m68kcodeptr;
+    uint16_t *orig_m68kcodeptr = m68kcodeptr;
+    jit_control = EffectiveControl(m68kcodeptr);
+    jit_control2 = __m68k_state->JIT_CONTROL2;
+    int var_EMU68_MAX_LOOP_COUNT = (jit_control >> JCCB_LOOP_COUNT) & JCCB_LOOP_COUNT_MASK;
+    if (var_EMU68_MAX_LOOP_COUNT == 0)
+        var_EMU68_MAX_LOOP_COUNT = JCCB_LOOP_COUNT_MASK + 1;
+    uint32_t var_EMU68_M68K_INSN_DEPTH = (jit_control >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK;
+    if (var_EMU68_M68K_INSN_DEPTH == 0)
+        var_EMU68_M68K_INSN_DEPTH = JCCB_INSN_DEPTH_MASK + 1;
+    /* Words past the last translated instruction covered by the checksum */
+    uint32_t range_pad = 16;
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    int count_side_exits = 0;
+
+    if (tier != TIER_NO_UNIT)
+    {
+        struct DepthHint *h = &depth_hints[((uintptr_t)m68kcodeptr >> 1) & EMU68_ADAPT_MASK];
+        int hint = h->dh_M68kAddress == (uint32_t)(uintptr_t)m68kcodeptr && h->dh_Depth != 0;
+        int smc = hint && h->dh_Invalidations >= EMU68_ADAPT_INVALIDATIONS;
+
+        if ((jit_control2 & JC2F_ADAPTIVE_DEPTH) ? hint : (EMU68_SMC_SPLIT && smc))
+        {
+            var_EMU68_M68K_INSN_DEPTH = h->dh_Depth;
+            var_EMU68_MAX_LOOP_COUNT = h->dh_Loops;
+        }
+#if EMU68_SMC_SPLIT
+        /* Code is modified around here, unit depends on its own instructions only */
+        if (smc)
+        {
+            range_pad = 0;
+            jit_control2 &= ~(JC2_CCR_SCAN_MASK << JC2B_CCR_SCAN_DEPTH);
+        }
+#endif
+        count_side_exits = (tier == 0) && (jit_control2 & JC2F_ADAPTIVE_DEPTH);
+    }
+#endif
+#if EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    branch_profile = (tier == 0);
+    branch_profile_count = 0;
+    branch_profile_overflow = 0;
+#if EMU68_SUPERBLOCKS
+    superblock_target = (tier == 1) ? Superblock_Get(m68kcodeptr) : NULL;
+    unit_exit_target = 0;
+#endif
+#endif
+    /* Depth was raised but the buffers could not follow */
+    if (var_EMU68_M68K_INSN_DEPTH > translation_depth)
+        var_EMU68_M68K_INSN_DEPTH = translation_depth;
+
+#if EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    /*
+        Tier 0 is a quick translation: short units, no branch inlining and shallow CCR scan.
+        The emitters read their limits from the translation time copies of JIT_CONTROL
+        and JIT_CONTROL2. Code run without unit is translated the same way
+    */
+    if (tier == 0 || tier == TIER_NO_UNIT)
+    {
+        uint32_t ccr_depth = (jit_control2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
+
+        if (var_EMU68_M68K_INSN_DEPTH > EMU68_TIER0_INSN_DEPTH)
+            var_EMU68_M68K_INSN_DEPTH = EMU68_TIER0_INSN_DEPTH;
+        if (ccr_depth > EMU68_TIER0_CCR_DEPTH)
+            ccr_depth = EMU68_TIER0_CCR_DEPTH;
+
+        jit_control &= ~(JCCB_INLINE_RANGE_MASK << JCCB_INLINE_RANGE);
+        jit_control2 &= ~(JC2_CCR_SCAN_MASK << JC2B_CCR_SCAN_DEPTH);
+        jit_control2 |= ccr_depth << JC2B_CCR_SCAN_DEPTH;
+    }
+#else
+    (void)tier;
+#endif
+
+#if EMU68_TRACE_CACHE
+    /*
+        Trace exception follows every instruction and its handler may look at the stacked SR.
+        All flags are computed and nothing past the instruction is inlined
+    */
+    if (m68k_single_step)
+    {
+        var_EMU68_M68K_INSN_DEPTH = 1;
+        jit_control &= ~(JCCB_INLINE_RANGE_MASK << JCCB_INLINE_RANGE);
+        jit_control2 &= ~(JC2_CCR_SCAN_MASK << JC2B_CCR_SCAN_DEPTH);
+    }
+#endif
+
+    uint16_t *last_rev_jump = (uint16_t *)0xffffffff;
+
+    /* Code might have changed since last translation */
+    M68K_ResetCCRLiveness();
+
+    val_FPIAR = 0xffffffff;
+
+    int debug = 0;
+    int disasm = 0;
+
+    if (DebugActive((uint32_t)(uintptr_t)m68kcodeptr)) {
+        debug = globalDebug();
+        disasm = globalDisasm();
+    }
+
+    insn_debug = debug > 1 ? debug : (debug_cnt & 1);
+#if EMU68_JIT_STATS
+    insn_opmix = opmix;
+#endif
+
+    if (RA_GetTempAllocMask()) {
+        kprintf("[ICache] Temporary register alloc mask on translate start is non-zero %x\n", RA_GetTempAllocMask());
+
+        while(1);
+    }
+
+    if (disasm) {
+        disasm_open();
+    }
+
+    M68K_ResetReturnStack();
+
+    m68k_exit_target = (uint16_t *)0xffffffff;
+    m68k_exit_return = FALSE;
+    m68k_exit_exception = FALSE;
+    m68k_exit_indirect = FALSE;
+#if EMU68_BLOCK_CHAINING
+    chain_count = 0;
+#endif
+#if EMU68_COLD_STUBS
+    cold_length = 0;
+    cold_count = 0;
+#endif
+#if EMU68_LOOP_PREFETCH
+    loop_stride_inc = 0;
+    loop_stride_dec = 0;
+#endif
+
+    if (debug) {
+        uint32_t hash_calc = UnitTable_Home(m68kcodeptr);
+        kprintf("[ICache] Creating new translation unit with hash %04x (m68k code @ %p)\n", hash_calc, (void*)m68kcodeptr);
+        if (debug > 1)
+            M68K_PrintContext(__m68k_state);
+    }
+
+    int lr_is_saved = 0;
+    
+    prologue_size = 0;
+    epilogue_size = 0;
+    conditionals_count = 0;
+
+    insn_count = 0;
+#if EMU68_PC_MAP
+    pc_map_count = 0;
+#endif
+    uint32_t *arm_code = temporary_arm_code;
+    uint32_t *end = arm_code;
+
+    (void)prologue_size;
+    (void)lr_is_saved;
+
+    RA_ClearChangedMask();
+    RA_ResetConstCache();
+
+    uint32_t *tmpptr = end;
+
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+    if (tier != TIER_NO_UNIT)
+        end = EMIT_GenerationCheck(end);
+#endif
+#if EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    if (tier == 0)
+        end = EMIT_TierCounter(end);
+#endif
+
+    if (debug_cnt & 2)
+    {
+        uint8_t reg = RA_AllocARMRegister(&end);
+        *end++ = mov_immed_u16(reg, 4, 0);
+        *end++ = msr(reg, 3, 3, 9, 12, 4);
+        RA_FreeARMRegister(&end, reg);
+    }
+
+    prologue_size = end - tmpptr;
+
+#if EMU68_LOOP_HOIST
+    /* Loop pre-header. Values are marked modified, every exit from the body writes them back */
+    loop_hoist = 0;
+    if (hoist & RA_VAL_CTX)
+        RA_GetCTX(&end);
+    if (hoist & RA_VAL_CC)
+        RA_ModifyCC(&end);
+    if (hoist & RA_VAL_FPCR)
+        RA_ModifyFPCR(&end);
+    if (hoist & RA_VAL_FPSR)
+        RA_ModifyFPSR(&end);
+    RA_ClearLoadedMask();
+#else
+    (void)hoist;
+#endif
+
+    /*
+        Loop heads start a fetch block on cores which fetch in aligned blocks. Code of the unit
+        starts on a cache line, the temporary buffer may not, so the offset within it counts
+    */
+    if (Features.ARM_LOOP_ALIGN)
+    {
+        while (((end - temporary_arm_code) * 4 & (Features.ARM_LOOP_ALIGN - 1)) != 0)
+            *end++ = nop();
+    }
+
+    /* Backedge of inner loop skips the prologue */
+    uint32_t *loop_body = end;
+
+#if EMU68_LOCAL_LOOPS
+    /* Instructions before the join are counted once, when the loop is left */
+    uint32_t *join_body = NULL;
+    uint32_t join_insns = 0;
+    uint16_t join_depth = 0;
+    uint16_t *join_stack[RTSTACK_SIZE];
+
+    loop_join = NULL;
+#else
+    uint32_t join_insns = 0;
+    (void)join;
+#endif
+
+    int break_loop = FALSE;
+    int inner_loop = FALSE;
+    int soft_break = FALSE;
+    int max_rev_jumps = 0;
+
+    m68k_low = m68kcodeptr;
+    m68k_high = m68kcodeptr + range_pad;
+
+    while (break_loop == FALSE && soft_break == FALSE && insn_count < var_EMU68_M68K_INSN_DEPTH)
+    {
+        uint16_t insn_consumed;
+        uint16_t *in_code = m68kcodeptr;
+#if EMU68_LEAF_INLINE
+        int in_rom_leaf = (rom_leaf_depth != 0);
+#else
+        const int in_rom_leaf = 0;
+#endif
+        uint32_t *out_code = end;
+
+        if (insn_count && ((uintptr_t)m68kcodeptr < (uintptr_t)local_state[insn_count-1].mls_M68kPtr))
+        {
+            int found = -1;
+            struct M68KDecodedInsn *d = M68K_DecodeInsn(m68kcodeptr);
+//kprintf("going backwards... %p -> %p\n", local_state[insn_count-1].mls_M68kPtr, m68kcodeptr);
+            /* Decode table remembers where the instruction was emitted last time */
+            if (d && d->di_LocalState >= 0 && local_state[d->di_LocalState].mls_M68kPtr == m68kcodeptr)
+                found = d->di_LocalState;
+            else
+            {
+                for (int i=insn_count - 1; i >= 0; --i)
+                {
+                    if (local_state[i].mls_M68kPtr == m68kcodeptr)
+                    {
+//                            kprintf("PC match at i=%d, %d instructions\n", i, insn_count - i - 1);
+                        found = i;
+                        break;
+                    }
+                }
+            }
+
+            if (found > 0)
+            {
+                if ((insn_count - found - 1) > (var_EMU68_M68K_INSN_DEPTH - insn_count))
+                {
+//                        kprintf("not enough place for completion of the loop\n");
+                    break;
+                }
+            }
+        }
+
+#if EMU68_LOCAL_LOOPS
+        /* The backedge comes with everything written back, the first entry has to match it */
+        if (join != NULL && join_body == NULL && m68kcodeptr == join && insn_count != 0)
+        {
+            RA_ResolveFPSR(&end);
+            RA_FlushFPURegs(&end);
+            RA_FlushM68kRegs(&end);
+            end = EMIT_FlushPC(end);
+            RA_FlushCC(&end);
+            RA_FlushFPCR(&end);
+            RA_FlushFPSR(&end);
+            RA_ResetConstCache();
+#if EMU68_LOOP_PREFETCH
+            loop_stride_inc = 0;
+            loop_stride_dec = 0;
+#endif
+            if (Features.ARM_LOOP_ALIGN)
+            {
+                while (((end - temporary_arm_code) * 4 & (Features.ARM_LOOP_ALIGN - 1)) != 0)
+                    *end++ = nop();
+            }
+
+            join_body = end;
+            join_insns = insn_count;
+            join_depth = ReturnStackDepth;
+            for (int i=0; i < join_depth; i++)
+                join_stack[i] = ReturnStack[i];
+        }
+#endif
+
+        local_state[insn_count].mls_ARMOffset = end - arm_code;
+        local_state[insn_count].mls_M68kPtr = m68kcodeptr;
+        local_state[insn_count].mls_PCRel = _pc_rel;
+        {
+            struct M68KDecodedInsn *d = M68K_DecodeInsn(m68kcodeptr);
+            if (d)
+                d->di_LocalState = insn_count;
+        }
+#if EMU68_PC_MAP
+        pc_map_index[pc_map_count++] = insn_count;
+#endif
+
+#if EMU68_DBCC_INT_INTERVAL > 1
+        m68k_loop_counter = 0xff;
+#endif
+
+        {
+            uint32_t *insn_start = end;
+            uint32_t *idiom_end = NULL;
+#if EMU68_PEEPHOLE
+            uint8_t ctx = RA_TryCTX(&end);
+#endif
+            RA_BeginConstWindow(insn_start);
+#if EMU68_BLOCK_IDIOMS
+#if EMU68_TRACE_CACHE
+            if (!m68k_single_step)
+#endif
+            idiom_end = EMIT_BlockIdiom(end, &m68kcodeptr, &insn_consumed);
+#endif
+            if (idiom_end)
+                end = idiom_end;
+            else
+                end = EmitINSN(end, &m68kcodeptr, &insn_consumed);
+            RA_CommitConstWindow(insn_start, end);
+#if EMU68_PEEPHOLE
+            end = M68K_Peephole(insn_start, end, ctx);
+#endif
+#if EMU68_SCHEDULE
+            if (Features.ARM_SCHEDULE)
+                M68K_Schedule(insn_start, end);
+#endif
+#if EMU68_BUS_SITES
+            end = M68K_PatchBusSites(insn_start, end, local_state[insn_count].mls_M68kPtr);
+#endif
+#if !EMU68_PEEPHOLE && !EMU68_BUS_SITES && !EMU68_SCHEDULE
+            (void)insn_start;
+#endif
+        }
+
+#if EMU68_LEAF_INLINE
+        /* Words of ROM subroutines cannot change, they stay out of the checksummed range */
+        if (rom_leaf_depth != 0 && ReturnStackDepth < rom_leaf_depth)
+            rom_leaf_depth = 0;
+
+        if (rom_leaf_depth == 0)
+#endif
+        {
+            if (m68kcodeptr < m68k_low)
+                m68k_low = m68kcodeptr;
+            if (m68kcodeptr + range_pad > m68k_high)
+                m68k_high = m68kcodeptr + range_pad;
+        }
+        /* Without the margin a taken branch has to cover its own words and those of instructions fused with it */
+        if (range_pad == 0 && !in_rom_leaf)
+        {
+            uint16_t *insn_end = in_code;
+
+            for (int i=0; i < insn_consumed; i++)
+            {
+                int len = M68K_GetINSNLength(insn_end);
+                if (len <= 0)
+                    break;
+                insn_end += len;
+            }
+
+            if (insn_end > m68k_high)
+                m68k_high = insn_end;
+        }
+
+        insn_count+=insn_consumed;
+        if (end[-1] == INSN_TO_LE(0xfffffff0))
+        {
+            lr_is_saved = 1;
+            end--;
+        }
+        if (end[-1] == INSN_TO_LE(0xffffffff))
+        {
+            end--;
+            break_loop = TRUE;
+        }
+#if EMU68_SUPERBLOCKS && EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+        /* Hot successor of the unit. PC is already set to the target, continue translation there */
+        if (break_loop && superblock_target != NULL && m68k_exit_target == superblock_target)
+        {
+            if (debug)
+                kprintf("[ICache]   Merging jump target %p into the unit\n", (void*)superblock_target);
+
+            m68kcodeptr = superblock_target;
+            m68k_exit_target = (uint16_t *)0xffffffff;
+            superblock_target = NULL;
+            break_loop = FALSE;
+
+            if (m68kcodeptr < m68k_low)
+                m68k_low = m68kcodeptr;
+            if (m68kcodeptr + range_pad > m68k_high)
+                m68k_high = m68kcodeptr + range_pad;
+        }
+#endif
+        if (end[-1] == INSN_TO_LE(0xfffffff1))
+        {
+            end--;
+            soft_break = TRUE;
+        }
+        if (end[-1] == INSN_TO_LE(0xfffffffe))
+        {
+            uint32_t *tmpptr;
+            uint32_t *branch_mod[10];
+            uint32_t branch_cnt;
+            uint32_t cold;
+            int local_branch_done = 0;
+            int exit_inline = 0;
+            end--;
+            /* Set if the exit is entered only through the single branch in front of it */
+            cold = *--end;
+            branch_cnt = *--end;
+
+            for (unsigned i=0; i < branch_cnt; i++)
+            {
+                uintptr_t ptr = *(uint32_t *)--end;
+                ptr |= (uintptr_t)end & 0xffffffff00000000;
+                branch_mod[i] = (uint32_t *)ptr;
+            }
+
+            tmpptr = end;
+
+            conditionals_count++;
+
+            if (!local_branch_done)
+            {
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+                if (count_side_exits)
+                {
+                    /* Counter is addressed relative to the unit, the exit stays in place */
+                    exit_inline = 1;
+                    end = EMIT_ExitCommon(end, 0);
+                    end = EMIT_SideExitCounter(end);
+                    *end++ = mov64_immed_u16(0, 0, 0);
+                    *end++ = bx_lr();
+                }
+                else
+#endif
+                end = EMIT_LocalExit(end, 0);
+            }
+            int distance = end - tmpptr;
+            epilogue_size += distance;
+
+#if EMU68_COLD_STUBS
+            if (cold == EXIT_COLD && branch_cnt == 1 && !exit_inline)
+            {
+                uint32_t *moved = EMIT_ColdStub(branch_mod[0] + 1, end);
+
+                if (moved != end)
+                {
+                    end = moved;
+                    branch_cnt = 0;
+                }
+            }
+
+            /* Otherwise the exit itself goes, the skip branches get shorter */
+            if (branch_cnt != 0 && !exit_inline)
+            {
+                end = EMIT_ColdExit(tmpptr, end);
+                distance = end - tmpptr;
+            }
+#else
+            (void)cold;
+            (void)exit_inline;
+#endif
+
+            for (unsigned i=0; i < branch_cnt; i++) {
+                //kprintf("[ICache] Branch modification at %p : distance increase by %d\n", (void*) branch_mod[i], distance);
+                *(branch_mod[i]) = INSN_TO_LE((INSN_TO_LE(*(branch_mod[i])) + (distance << 5)));
+            }
+        }
+
+        if (disasm)
+            disasm_print(in_code, insn_consumed, out_code, 4*(end - out_code), temporary_arm_code);
+
+        if (in_code > m68kcodeptr)
+        {
+            if (debug)
+                kprintf("[ICache]   Going backwards to location %08x\n", m68kcodeptr);
+#if EMU68_LOCAL_LOOPS
+            /* Earlier instruction but not the first one, next pass may close the loop there */
+            if (join == NULL && loop_join == NULL && m68kcodeptr != orig_m68kcodeptr)
+            {
+                for (int i=insn_count - insn_consumed; i > 0; --i)
+                {
+                    if (local_state[i].mls_M68kPtr == m68kcodeptr)
+                    {
+                        loop_join = m68kcodeptr;
+                        break;
+                    }
+                }
+            }
+#endif
+            if (last_rev_jump == m68kcodeptr) {
+                if (--max_rev_jumps == 0) {
+                    if (debug)
+                        kprintf("[ICache] Going backwards to the same location oft enough. Loop candidate. Breaking here\n");
+                    break;
+                }
+            }
+            else {
+                last_rev_jump = m68kcodeptr;
+                max_rev_jumps = var_EMU68_MAX_LOOP_COUNT - 1;
+            }
+        }
+
+        if (!break_loop && (orig_m68kcodeptr == m68kcodeptr)
+#if EMU68_TRACE_CACHE
+            && !m68k_single_step
+#endif
+        )
+        {
+            if (debug)
+                kprintf("[ICache]   Creating loop within translation unit\n");
+            
+            inner_loop = TRUE;
+            break;
+        }
+
+#if EMU68_LOCAL_LOOPS
+        /* Back at the join in the same context of inlined calls, which the code after it assumes */
+        int same_calls = (ReturnStackDepth == join_depth);
+
+        for (int i=0; same_calls && i < join_depth; i++)
+            same_calls = (ReturnStack[i] == join_stack[i]);
+
+        if (!break_loop && join_body != NULL && m68kcodeptr == join && same_calls
+#if EMU68_TRACE_CACHE
+            && !m68k_single_step
+#endif
+        )
+        {
+            if (debug)
+                kprintf("[ICache]   Creating loop at %p within translation unit\n", (void*)join);
+
+            loop_body = join_body;
+            inner_loop = TRUE;
+            break;
+        }
+#endif
+    }
+    uint32_t *out_code = end;
+    tmpptr = end;
+
+    /*
+        Hoisted values still in the registers loaded by the pre-header stay there when the loop
+        continues. They are written back only if the loop is left
+    */
+    int keep_hoisted = 0;
+#if EMU68_LOOP_HOIST
+    if (inner_loop && hoist)
+    {
+        if ((RA_GetLoadedMask() & hoist) == 0 && (RA_GetHeldMask() & hoist) == hoist)
+            keep_hoisted = 1;
+    }
+    else if (inner_loop)
+    {
+        /* Context is needed by the backedge itself */
+        uint8_t mask = RA_GetLoadedMask() | RA_VAL_CTX;
+        int spare = 8 - RA_GetAllocPeak();
+
+        /* Values live from the start of the body occupy a register each for its whole length */
+        for (uint8_t v = RA_VAL_CTX; v <= RA_VAL_FPSR; v <<= 1)
+        {
+            if ((mask & v) && spare > 0)
+            {
+                loop_hoist |= v;
+                spare--;
+            }
+        }
+    }
+#endif
+
+    /* Condition codes still pending are computed here, also if FPSR stays in its register */
+    RA_ResolveFPSR(&end);
+    RA_FlushFPURegs(&end);
+    RA_FlushM68kRegs(&end);
+    end = EMIT_FlushPC(end);
+    if (!keep_hoisted)
+    {
+        RA_FlushCC(&end);
+        RA_FlushFPCR(&end);
+        RA_FlushFPSR(&end);
+    }
+
+    uint8_t tmp = RA_AllocARMRegister(&end);
+    uint8_t tmp2 = RA_AllocARMRegister(&end);
+    if (inner_loop)
+    {
+#if EMU68_LOOP_PREFETCH
+        uint32_t prefetch_dist = 64 * ((jit_control2 >> JC2B_PREFETCH_DIST) & JC2_PREFETCH_DIST_MASK);
+
+        if (prefetch_dist)
+            end = EMIT_LoopPrefetch(end, tmp, prefetch_dist);
+#endif
+#if EMU68_DBCC_INT_INTERVAL > 1
+        /* Loop counted by DBcc, skip the interrupt check unless low bits of the counter are zero */
+        if (m68k_loop_counter != 0xff)
+        {
+            uint8_t counter = RA_MapM68kRegister(&end, m68k_loop_counter);
+            *end++ = tst_immed(counter, __builtin_ctz(EMU68_DBCC_INT_INTERVAL), 0);
+            uint32_t *tmpptr = end;
+            *end++ = b_cc(A64_CC_NE, loop_body - tmpptr);
+        }
+#endif
+#if EMU68_IDLE_WAIT
+        /* Polling loop closed at the head of the unit, the checks below see INT after the wait */
+        if (m68kcodeptr == orig_m68kcodeptr && M68K_IsIdleLoop(orig_m68kcodeptr, insn_count))
+            end = EMIT_IdleWait(end);
+#endif
+#ifdef PISTORM
+        //*end++ = mov_immed_u16(tmp2, 0xf220, 1);
+        //*end++ = ldr_offset(tmp2, tmp2, 0x34);;
+#endif
+#if EMU68_ASYNC_INT
+        /* Flag is non-zero as long as INT was not signalled */
+        if (int_signal_gicc != NULL)
+        {
+            *end++ = mov_simd_to_reg(tmp2, 29, TS_S, 3);
+        }
+        else
+#endif
+        {
+            uint8_t ctx = RA_GetCTX(&end);
+            *end++ = ldr_offset(ctx, tmp2, __builtin_offsetof(struct M68KState, INT));
+        }
+    }
+#if EMU68_INSN_COUNTER
+    {
+        uint8_t tmp = RA_AllocARMRegister(&end);
+        uint32_t counted = insn_count - join_insns;
+        if (insn_count_precise) {
+            *end++ = mov_immed_u16(tmp, counted & 0xffff, 0);
+            if (counted & 0xffff0000) {
+                *end++ = movk_immed_u16(tmp, counted >> 16, 1);
+            }
+            *end++ = fmov_from_reg(0, tmp);
+            *end++ = vadd_2d(30, 30, 0);
+        }
+        
+        if (val_FPIAR != 0xffffffff) {
+            *end++ = mov_immed_u16(tmp, val_FPIAR & 0xffff, 0);
+            *end++ = movk_immed_u16(tmp, val_FPIAR >> 16, 1);
+            *end++ = mov_reg_to_simd(29, TS_S, 1, tmp);
+        }
+
+        RA_FreeARMRegister(&end, tmp);
+    }
+#else
+    (void)join_insns;
+#endif
+    if (inner_loop)
+    {
+        uint32_t *tmpptr = end;
+#if EMU68_ASYNC_INT
+        if (int_signal_gicc != NULL)
+            *end++ = cbnz(tmp2, loop_body - tmpptr);
+        else
+#endif
+#ifdef PISTORM
+        *end++ = cbz(tmp2, loop_body - tmpptr);
+        //*end++ = tbnz(tmp2, 25, arm_code - tmpptr);
+#else
+        *end++ = cbz(tmp2, loop_body - tmpptr);
+#endif
+    }
+
+#if EMU68_INSN_COUNTER && EMU68_LOCAL_LOOPS
+    /* Loop closed at the join is left, instructions in front of it ran once */
+    if (inner_loop && join_insns && insn_count_precise)
+    {
+        uint8_t tmp = RA_AllocARMRegister(&end);
+        *end++ = mov_immed_u16(tmp, join_insns & 0xffff, 0);
+        if (join_insns & 0xffff0000)
+            *end++ = movk_immed_u16(tmp, join_insns >> 16, 1);
+        *end++ = fmov_from_reg(0, tmp);
+        *end++ = vadd_2d(30, 30, 0);
+        RA_FreeARMRegister(&end, tmp);
+    }
+#endif
+
+    /* Loop left for interrupt, write back values kept across the backedge */
+    if (keep_hoisted)
+    {
+        RA_FlushCC(&end);
+        RA_FlushFPCR(&end);
+        RA_FlushFPSR(&end);
+    }
+#if EMU68_BLOCK_CHAINING
+    /*
+        If the unit was not broken by instruction with dynamic target, the exit is
+        chainable. That is the case for units ending at depth limit or loop breaks,
+        where PC points to the next m68k instruction, and for non-inlined BRA/BSR.
+    */
+    if (!break_loop)
+        m68k_exit_target = m68kcodeptr;
+
+#if EMU68_SUPERBLOCKS && EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    /* Unit ended by static jump and all its exits are counted, the jump target may be merged later */
+    if (break_loop && !inner_loop && !branch_profile_overflow && m68k_exit_target != (uint16_t *)0xffffffff)
+        unit_exit_target = (uint32_t)(uintptr_t)m68k_exit_target;
+#endif
+
+#if EMU68_TRACE_CACHE && EMU68_SHADOW_STACK
+    /* Predicted returns would leave the trace unit without the main loop */
+    if (m68k_single_step)
+    {
+        m68k_exit_return = FALSE;
+        m68k_exit_exception = FALSE;
+    }
+#endif
+
+    if (!inner_loop && m68k_exit_target != (uint16_t *)0xffffffff)
+    {
+        end = EMIT_ChainSite(end, m68k_exit_target);
+    }
+    else if (!inner_loop && m68k_exit_indirect)
+    {
+        end = EMIT_IndirectSite(end);
+    }
+    else
+    {
+#if EMU68_SHADOW_STACK
+        if (!inner_loop && m68k_exit_return)
+            end = EMIT_PopReturnPrediction(end);
+        else if (!inner_loop && m68k_exit_exception)
+            end = EMIT_PopExceptionReturn(end);
+#endif
+        *end++ = mov64_immed_u16(0, 0, 0);
+        *end++ = bx_lr();
+    }
+#else
+#if EMU68_SHADOW_STACK
+    if (!inner_loop && m68k_exit_return)
+        end = EMIT_PopReturnPrediction(end);
+    else if (!inner_loop && m68k_exit_exception)
+        end = EMIT_PopExceptionReturn(end);
+#endif
+    *end++ = bx_lr();
+#endif
+    
+    uint32_t *_tmpptr = end;
+    RA_FreeARMRegister(&end, tmp2);
+    RA_FreeARMRegister(&end, tmp);
+    RA_FlushCTX(&end);
+    RA_FlushConstBase(&end);
+    end = _tmpptr;
+    
+    epilogue_size += end - tmpptr;
+
+#if EMU68_COLD_STUBS
+    end = EMIT_ColdSection(end);
+#endif
+
+    if (disasm) {
+        disasm_print((uint16_t *)0, 0, out_code, 4*(end - out_code), temporary_arm_code);
+        disasm_close();
+    }
+
+    // Put a marker at the end of translation unit
+    *end++ = 0xffffffff;
+
+    if (debug)
+    {
+        kprintf("[ICache]   Translated %d M68k instructions to %d ARM instructions\n", insn_count, (int)(end - arm_code));
+        kprintf("[ICache]   Prologue size: %d, Epilogue size: %d, Conditionals: %d\n",
+            prologue_size, epilogue_size, conditionals_count);
+        kprintf("[ICache]   Mean epilogue size pro exit point: %d\n", epilogue_size / (1 + conditionals_count));
+        uint32_t mean = 100 * (end - arm_code - (prologue_size + epilogue_size));
+        mean = mean / insn_count;
+        uint32_t mean_n = mean / 100;
+        uint32_t mean_f = mean % 100;
+        kprintf("[ICache]   Mean ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+    }
+
+    return (uintptr_t)end - (uintptr_t)arm_code;
+}
+
+static void FetchSetup(uint32_t address);
+
+static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr, uint32_t tier)
+{
+    FetchSetup((uintptr_t)m68kcodeptr);
+
+    uintptr_t length = M68K_TranslatePass(m68kcodeptr, tier, 0, NULL);
+
+#if EMU68_LOOP_HOIST
+    /* Inner loop reloading state on every pass, translate once more with the state loaded up front */
+    if (loop_hoist)
+        length = M68K_TranslatePass(m68kcodeptr, tier, loop_hoist, NULL);
+#if EMU68_LOCAL_LOOPS
+    else
+#endif
+#endif
+#if EMU68_LOCAL_LOOPS
+    /* Branch back into the unit was unrolled, translate once more with a loop head there */
+    if (loop_join)
+        length = M68K_TranslatePass(m68kcodeptr, tier, 0, loop_join);
+#endif
+
+    return length;
+}
+
+/*
+    Buffers for translation are sized for the instruction depth set in JIT_CONTROL and grow
+    when it is raised. They are never allocated before the first translation, the worker has
+    its own code buffer of maximal size. Main thread only, translator lock must be held.
+*/
+static void GrowTranslationBuffers()
+{
+    uint32_t depth = (__m68k_state->JIT_CONTROL >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK;
+
+    if (depth == 0)
+        depth = JCCB_INSN_DEPTH_MASK + 1;
+
+#if EMU68_LAZY_RETUNE
+    /* Overrides may go deeper than the global setting */
+    for (int i=0; i < EMU68_JIT_OVERRIDES; i++)
+    {
+        uint32_t d = (jit_overrides[i].jo_Control >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK;
+
+        if (jit_overrides[i].jo_Control != 0 && (d == 0 || d > depth))
+            depth = d ? d : JCCB_INSN_DEPTH_MASK + 1;
+    }
+#endif
+
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    /* Stable units may be translated with twice the depth */
+    if (__m68k_state->JIT_CONTROL2 & JC2F_ADAPTIVE_DEPTH)
+        depth *= 2;
+#endif
+
+    if (depth > JCCB_INSN_DEPTH_MASK + 1)
+        depth = JCCB_INSN_DEPTH_MASK + 1;
+
+    if (depth <= translation_depth)
+        return;
+
+    /* Grow in steps of 32 instructions, tuning the depth up does not reallocate every time */
+    depth = (depth + 31) & ~31;
+    if (depth > JCCB_INSN_DEPTH_MASK + 1)
+        depth = JCCB_INSN_DEPTH_MASK + 1;
+
+    /* Old contents are not needed. Freeing first lets the JIT reserve of the arena hold the new buffer */
+    if (temporary_arm_code)
+        tlsf_free(jit_tlsf, temporary_arm_code);
+    if (local_state)
+        tlsf_free(tlsf, local_state);
+
+    temporary_arm_code = tlsf_malloc(jit_tlsf, depth * 16 * 64);
+    local_state = tlsf_malloc(tlsf, sizeof(struct M68KLocalState) * depth * 2);
+
+    if (temporary_arm_code == NULL || local_state == NULL)
+    {
+        kprintf("[ICache] No memory for translation buffers of depth %d\n", depth);
+        while(1) { asm volatile("wfe"); }
+    }
+
+    translation_depth = depth;
+    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+    kprintf("[ICache] Translation buffers for %d instructions, code at %p\n", depth, temporary_arm_code);
+}
+
+/*
+    Translate portion of m68k code into ARM. No new unit is created, instead
+    a raw pointer to ARM code is returned and instruction cache on host side is
+    invalidated
+*/
+void *M68K_TranslateNoCache(uint16_t *m68kcodeptr)
+{
+    /* Code is executed once, entry counter and generation would have no unit to live in */
+    M68K_LockTranslator();
+    GrowTranslationBuffers();
+    uintptr_t line_length = M68K_Translate(m68kcodeptr, TIER_NO_UNIT);
+    void *entry_point = (void*)temporary_arm_code;
+    M68K_UnlockTranslator();
+
+    entry_point = (void *)((uintptr_t)entry_point | 0x0000001000000000ULL);
+
+    SyncNewCode(entry_point, line_length);
+
+    return entry_point;
+} 
+
+#if EMU68_FIRST_RUN
+/* Entry counts of code run from the scratch buffer */
+struct FirstRun {
+    uint32_t    fr_M68kAddress;
+    uint32_t    fr_Count;
+};
+
+static struct FirstRun first_runs[EMU68_FIRST_RUN_SIZE];
+
+/* Stands in for the unit of code run from the scratch buffer, only the entry point is valid */
+struct M68KTranslationUnit first_run_unit;
+
+/*
+    Code entered fewer than EMU68_FIRST_RUN_COUNT times is translated into the scratch buffer.
+    Exits of such code are never chained, their link literals stay NULL. The entry point is
+    valid until the next translation. Returns NULL if the code should get a unit
+*/
+static struct M68KTranslationUnit *FirstRun(uint16_t *m68kcodeptr)
+{
+    struct FirstRun *f = &first_runs[((uintptr_t)m68kcodeptr >> 1) & EMU68_FIRST_RUN_MASK];
+
+    /* Entry belongs to other code, take it over */
+    if (f->fr_M68kAddress != (uint32_t)(uintptr_t)m68kcodeptr)
+    {
+        f->fr_M68kAddress = (uint32_t)(uintptr_t)m68kcodeptr;
+        f->fr_Count = 0;
+    }
+
+    if (f->fr_Count >= EMU68_FIRST_RUN_COUNT)
+        return NULL;
+
+    f->fr_Count++;
+    first_run_unit.mt_ARMEntryPoint = M68K_TranslateNoCache(m68kcodeptr);
+
+    return &first_run_unit;
+}
+#endif
+
+#if EMU68_TRACE_CACHE
+/* Single instruction unit of traced code together with the words it was translated from */
+struct TraceUnit {
+    uint32_t    tu_M68kAddress;
+    uint16_t    tu_Length;
+    uint16_t    tu_Words[11];
+    void *      tu_Code;
+};
+
+static struct TraceUnit trace_units[EMU68_TRACE_CACHE_SIZE];
+
+/*
+    Entry point of the single instruction translation at m68kcodeptr, used while T1 is set.
+    Exits are never chained and never predicted, each one returns to the main loop. Entry is
+    reused as long as the instruction words are the same, otherwise translated again. If the
+    code cache has no room for it, the code is left in the scratch buffer and is valid until
+    the next translation
+*/
+void *M68K_GetTraceUnit(uint16_t *m68kcodeptr)
+{
+    struct TraceUnit *t = &trace_units[((uintptr_t)m68kcodeptr >> 1) & EMU68_TRACE_CACHE_MASK];
+    /* Decode table belongs to the translation in progress, e.g. in the worker */
+    uint32_t length = M68K_DecodeINSNLength(m68kcodeptr);
+    void *entry_point;
+
+    if (length > 11)
+        length = 11;
+
+    if (t->tu_Code != NULL && t->tu_M68kAddress == (uint32_t)(uintptr_t)m68kcodeptr && t->tu_Length == length)
+    {
+        uint32_t i = 0;
+
+        while (i < length && t->tu_Words[i] == m68kcodeptr[i])
+            i++;
+
+        if (i == length)
+            return t->tu_Code;
+    }
+
+    M68K_LockTranslator();
+    GrowTranslationBuffers();
+
+    if (t->tu_Code != NULL)
+    {
+        tlsf_free(jit_tlsf, (void *)((uintptr_t)t->tu_Code & ~0x0000001000000000ULL));
+        t->tu_Code = NULL;
+    }
+
+    m68k_single_step = 1;
+    uintptr_t line_length = M68K_Translate(m68kcodeptr, TIER_NO_UNIT);
+    m68k_single_step = 0;
+
+    entry_point = tlsf_malloc_aligned(jit_tlsf, line_length, 64);
+    if (entry_point != NULL)
+    {
+        DuffCopy(entry_point, temporary_arm_code, line_length / 4);
+
+        t->tu_M68kAddress = (uint32_t)(uintptr_t)m68kcodeptr;
+        t->tu_Length = length;
+        memcpy(t->tu_Words, m68kcodeptr, 2 * length);
+        t->tu_Code = (void *)((uintptr_t)entry_point | 0x0000001000000000ULL);
+    }
+    else
+        entry_point = temporary_arm_code;
+
+    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+    M68K_UnlockTranslator();
+
+    entry_point = (void *)((uintptr_t)entry_point | 0x0000001000000000ULL);
+
+    SyncNewCode(entry_point, line_length);
+
+    return entry_point;
+}
+#endif
+
+#if EMU68_UNIT_CRC_PAGES
+/* Checksums of the unit parts on each 4K page. Every page counts as dirty until protected */
+static void CalcPageCRCs(struct M68KTranslationUnit *unit)
+{
+    uintptr_t low = (uintptr_t)unit->mt_M68kLow;
+    uintptr_t high = (uintptr_t)unit->mt_M68kHigh;
+    uint32_t count = ((high - 1) >> 12) - (low >> 12) + 1;
+
+    unit->mt_PageCount = count <= EMU68_UNIT_CRC_PAGES ? count : 0;
+    unit->mt_DirtyPages = 0xffff;
+
+    for (uint32_t i=0; i < unit->mt_PageCount; i++)
+    {
+        uintptr_t s = i ? (low & ~4095UL) + 4096 * i : low;
+        uintptr_t e = (low & ~4095UL) + 4096 * (i + 1);
+
+        unit->mt_PageCRC[i] = CalcCRC32((void *)s, (void *)(e < high ? e : high));
+    }
+}
+
+/* Returns 1 if parts of the unit on the pages given by mask have not changed */
+static int CheckPageCRCs(struct M68KTranslationUnit *unit, uint32_t mask)
+{
+    uintptr_t low = (uintptr_t)unit->mt_M68kLow;
+    uintptr_t high = (uintptr_t)unit->mt_M68kHigh;
+
+    for (uint32_t i=0; i < unit->mt_PageCount; i++)
+    {
+        if ((mask & (1U << i)) == 0)
+            continue;
+
+        uintptr_t s = i ? (low & ~4095UL) + 4096 * i : low;
+        uintptr_t e = (low & ~4095UL) + 4096 * (i + 1);
+
+        if (CalcCRC32((void *)s, (void *)(e < high ? e : high)) != unit->mt_PageCRC[i])
+            return 0;
+    }
+
+    return 1;
+}
+#endif
+
+/*
+    Verify if the translated code has changed since the unit was created. In order
+    to do this MD5 sum of the block is compared with the previousy calculated one.
+
+    If th sums are not same, the block is removed form LRU cache and hashtable and memory
+    is released.
+
+    The function returns poitner to verified unit or NULL if the unit changed
+*/
+struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
+{
+    if (unit)
+    {
+#if EMU68_BUS_SITES
+        /* Retranslation requested by the fault handler, m68k code is the same */
+        if (unit->mt_Stale)
+        {
+            JITStats_Release(JS_RELEASE_STALE, 1);
+            M68K_FreeUnit(unit);
+
+            __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+            return NULL;
+        }
+#endif
+        /* Nothing was written to write protected code since translation, ROM cannot change at all */
+        if (!unit->mt_Protected && !unit->mt_Immutable)
+        {
+            uint64_t t0 = JITStats_Time();
+            int same;
+
+#if EMU68_UNIT_CRC_PAGES
+            if (unit->mt_PageCount)
+                same = CheckPageCRCs(unit, unit->mt_DirtyPages);
+            else
+#endif
+            same = CalcCRC32(unit->mt_M68kLow, unit->mt_M68kHigh) == unit->mt_CRC32;
+
+            JITStats_Verify(JITStats_Time() - t0);
+
+            if (!same)
+            {
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+                DepthHint_Invalidated(unit);
+#endif
+                JITStats_Release(JS_RELEASE_CRC, 1);
+                M68K_FreeUnit(unit);
+
+                __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+                return NULL;
+            }
+        }
+
+        /* Verified unit is valid in current flush generation */
+        unit->mt_Generation = __m68k_state->JIT_FLUSH_GEN;
+    }
+
+    return unit;
+}
+
+/*
+    Called by the main loop for units entered for the first time after soft flush of whole cache
+    or a change of JIT settings
+*/
+void M68K_RevalidateUnit(struct M68KTranslationUnit *unit)
+{
+#if EMU68_LAZY_RETUNE
+    if (!M68K_IsROMUnit(unit) &&
+        (unit->mt_Control != EffectiveControl(unit->mt_M68kAddress) || unit->mt_Control2 != __m68k_state->JIT_CONTROL2))
+    {
+#if EMU68_TIERED_JIT
+        /* Tier 0 is translated with short budgets anyway, promotion applies the new settings */
+        if (unit->mt_Tier == 0)
+        {
+            unit->mt_Control = EffectiveControl(unit->mt_M68kAddress);
+            unit->mt_Control2 = __m68k_state->JIT_CONTROL2;
+        }
+        else
+#endif
+        {
+            /* Translated again at tier 0 now and with the new settings once hot */
+            JITStats_Release(JS_RELEASE_STALE, 1);
+            M68K_FreeUnit(unit);
+
+            __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+            return;
+        }
+    }
+
+    /* No soft flush since the unit was verified, only the settings have changed */
+    if ((int32_t)(unit->mt_Generation - jit_soft_flush_gen) >= 0)
+    {
+        unit->mt_Generation = __m68k_state->JIT_FLUSH_GEN;
+        return;
+    }
+#endif
+
+    if (M68K_IsROMUnit(unit))
+        unit->mt_Generation = __m68k_state->JIT_FLUSH_GEN;
+    else
+        M68K_VerifyUnit(unit);
+}
+
+static inline struct M68KJumpCacheEntry *JumpCache_Entry(uint16_t *m68k_address)
+{
+    return &__m68k_state->JIT_JCACHE[((uintptr_t)m68k_address >> 1) & EMU68_JCACHE_MASK];
+}
+
+/* Shadow stack holds copies of entry points, keep them in sync with the unit */
+static inline void ShadowStack_Update(uint16_t *m68k_address, void *entry)
+{
+#if EMU68_SHADOW_STACK
+    for (int i=0; i < EMU68_SHADOW_STACK_SIZE; i++)
+    {
+        if (__m68k_state->JIT_SSTACK[i].ss_M68kAddress == (uint32_t)(uintptr_t)m68k_address)
+            __m68k_state->JIT_SSTACK[i].ss_Entry = entry;
+    }
+#else
+    (void)m68k_address;
+    (void)entry;
+#endif
+}
+
+/*
+    Put the unit into first free slot starting at its home line. All lines passed
+    on the way get their overflow counter increased. The table never gets full,
+    number of units is kept below its capacity by M68K_GetTranslationUnit.
+*/
+static void UnitTable_Insert(struct M68KTranslationUnit *unit)
+{
+    uint32_t line = UnitTable_Home(unit->mt_M68kAddress);
+
+    while(1)
+    {
+        struct M68KUnitLine *l = &UnitTable[line];
+
+        unit_line_dirty[line / 64] |= 1ULL << (line % 64);
+
+        for (int i=0; i < UNIT_LINE_SLOTS; i++)
+        {
+            if (l->ul_M68kAddress[i] == UNIT_SLOT_EMPTY)
+            {
+                l->ul_Entry[i] = unit->mt_ARMEntryPoint;
+                l->ul_M68kAddress[i] = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+                unit->mt_TableSlot = line * UNIT_LINE_SLOTS + i;
+
+                return;
+            }
+        }
+
+        l->ul_Overflow++;
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    }
+}
+
+static void UnitTable_Remove(struct M68KTranslationUnit *unit)
+{
+    uint32_t slot_line = unit->mt_TableSlot / UNIT_LINE_SLOTS;
+    uint32_t line = UnitTable_Home(unit->mt_M68kAddress);
+    struct M68KJumpCacheEntry *jc = JumpCache_Entry(unit->mt_M68kAddress);
+
+    /* Unit must not be reachable through the jump cache either */
+    if (jc->jc_M68kAddress == (uint32_t)(uintptr_t)unit->mt_M68kAddress)
+        jc->jc_M68kAddress = UNIT_SLOT_EMPTY;
+    ShadowStack_Update(unit->mt_M68kAddress, NULL);
+
+    while (line != slot_line)
+    {
+        UnitTable[line].ul_Overflow--;
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    }
+
+    UnitTable[slot_line].ul_M68kAddress[unit->mt_TableSlot % UNIT_LINE_SLOTS] = UNIT_SLOT_EMPTY;
+}
+
+/* Clear the unit table. Used when all units are released at once */
+void M68K_ResetUnitTable()
+{
+    struct M68KUnitLine empty;
+
+    for (int j=0; j < UNIT_LINE_SLOTS; j++)
+    {
+        empty.ul_M68kAddress[j] = UNIT_SLOT_EMPTY;
+        empty.ul_Entry[j] = NULL;
+    }
+    empty.ul_Overflow = 0;
+
+    /* Whole table is filled once, later resets clear only lines which were used in between */
+    if (!unit_table_ready)
+    {
+        for (int i=0; i < EMU68_UNIT_TABLE_SIZE; i++)
+            UnitTable[i] = empty;
+
+        unit_table_ready = 1;
+    }
+    else
+    {
+        for (int w=0; w < (EMU68_UNIT_TABLE_SIZE + 63) / 64; w++)
+        {
+            uint64_t dirty = unit_line_dirty[w];
+
+            while (dirty)
+            {
+                UnitTable[w * 64 + __builtin_ctzll(dirty)] = empty;
+                dirty &= dirty - 1;
+            }
+        }
+    }
+
+    for (int w=0; w < (EMU68_UNIT_TABLE_SIZE + 63) / 64; w++)
+        unit_line_dirty[w] = 0;
+
+    for (int i=0; i < EMU68_PAGE_INDEX_SIZE; i++)
+    {
+        NEWLIST(&PageIndex[i]);
+    }
+    page_index_span = 0;
+}
+
+static void PageIndex_Insert(struct M68KTranslationUnit *unit)
+{
+    uint32_t first = (uintptr_t)unit->mt_M68kLow >> 12;
+    uint32_t last = ((uintptr_t)unit->mt_M68kHigh - 1) >> 12;
+
+    if (last - first > page_index_span)
+        page_index_span = last - first;
+
+    ADDHEAD(&PageIndex[first & EMU68_PAGE_INDEX_MASK], &unit->mt_PageNode);
+}
+
+/* Invalidate all entries of the jump cache and the shadow stack filled from it */
+void M68K_ResetJumpCache()
+{
+    for (int i=0; i < EMU68_JCACHE_SIZE; i++)
+    {
+        __m68k_state->JIT_JCACHE[i].jc_M68kAddress = UNIT_SLOT_EMPTY;
+        __m68k_state->JIT_JCACHE[i].jc_Entry = NULL;
+    }
+#if EMU68_SHADOW_STACK
+    for (int i=0; i < EMU68_SHADOW_STACK_SIZE; i++)
+    {
+        __m68k_state->JIT_SSTACK[i].ss_M68kAddress = UNIT_SLOT_EMPTY;
+        __m68k_state->JIT_SSTACK[i].ss_Entry = NULL;
+    }
+    __m68k_state->JIT_SSTACK_TOP = 0;
+#endif
+}
+
+/* Update entry point of the unit, in the unit itself, the lookup table and the jump cache */
+void M68K_SetEntryPoint(struct M68KTranslationUnit *unit, void *entry)
+{
+    struct M68KJumpCacheEntry *jc = JumpCache_Entry(unit->mt_M68kAddress);
+
+    unit->mt_ARMEntryPoint = entry;
+    UnitTable[unit->mt_TableSlot / UNIT_LINE_SLOTS].ul_Entry[unit->mt_TableSlot % UNIT_LINE_SLOTS] = entry;
+
+    if (jc->jc_M68kAddress == (uint32_t)(uintptr_t)unit->mt_M68kAddress)
+        jc->jc_Entry = entry;
+    ShadowStack_Update(unit->mt_M68kAddress, entry);
+}
+
+/*
+    Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
+    verify block checksum and eventually discard it. Units chained to this one have to
+    go through the main loop again.
+*/
+void M68K_PoisonUnit(struct M68KTranslationUnit *unit)
+{
+    uintptr_t e = (uintptr_t)unit->mt_ARMEntryPoint;
+    e &= 0x00ffffffffffffffULL;
+    e |= 0xaa00000000000000ULL;
+
+    M68K_SetEntryPoint(unit, (void *)e);
+    M68K_UnchainUnit(unit);
+}
+
+/*
+    Revert all direct branches from other translation units into this one. The
+    exits become plain returns to the main loop again.
+*/
+static void UnchainLink(struct M68KChainLink *link)
+{
+    uint32_t *site = link->ml_Site;
+
+    *site = bx_lr();
+    link->ml_Target = NULL;
+    JITStats_Count(&jit_stats.js_Unchained);
+
+    arm_flush_cache((uintptr_t)site, 4);
+    arm_icache_invalidate((uintptr_t)site | 0x0000001000000000ULL, 4);
+
+    if (link->ml_Guard != NULL)
+    {
+        *link->ml_Guard = INDIRECT_GUARD_EMPTY;
+        link->ml_M68kTarget = NULL;
+        arm_flush_cache((uintptr_t)link->ml_Guard, 4);
+    }
+}
+
+void M68K_UnchainUnit(struct M68KTranslationUnit *unit)
+{
+    struct M68KChainLink *link;
+
+    while ((link = (struct M68KChainLink *)REMHEAD(&unit->mt_ChainIn)))
+    {
+        UnchainLink(link);
+    }
+}
+
+/*
+    Patch the exit described by link so that it branches directly into target unit.
+    Units which wait for verification after soft flush are not linked, their entry
+    point has to fault first.
+*/
+void M68K_ChainUnits(struct M68KChainLink *link, struct M68KTranslationUnit *target)
+{
+    uintptr_t entry = (uintptr_t)&target->mt_ARMCode[0] | 0x0000001000000000ULL;
+    uintptr_t site;
+
+    if ((uintptr_t)target->mt_ARMEntryPoint != entry)
+        return;
+
+    /*
+        Indirect exit reports its first way. Take a free one, if there is none
+        the last way gets the new target.
+    */
+    if (link->ml_Guard != NULL)
+    {
+        int way;
+
+        for (way=0; way < INDIRECT_WAYS; way++)
+        {
+            if (link[way].ml_Target == target)
+                return;
+            if (link[way].ml_Target == NULL)
+                break;
+        }
+
+        if (way == INDIRECT_WAYS)
+        {
+            way = INDIRECT_WAYS - 1;
+            REMOVE(&link[way].ml_Node);
+            UnchainLink(&link[way]);
+        }
+
+        link = &link[way];
+        link->ml_M68kTarget = target->mt_M68kAddress;
+        *link->ml_Guard = (uint32_t)(uintptr_t)target->mt_M68kAddress;
+        arm_flush_cache((uintptr_t)link->ml_Guard, 4);
+    }
+
+    if (link->ml_Target != NULL)
+        return;
+
+    site = (uintptr_t)link->ml_Site | 0x0000001000000000ULL;
+
+    /* B reaches +-128MB only, with a larger JIT pool distant units stay unchained */
+    if ((intptr_t)(entry - site) >= (128 << 20) || (intptr_t)(entry - site) < -(128 << 20))
+    {
+        JITStats_Count(&jit_stats.js_ChainFar);
+        return;
+    }
+
+    *link->ml_Site = b((entry - site) >> 2);
+    link->ml_Target = target;
+    JITStats_Count(&jit_stats.js_Chained);
+    ADDHEAD(&target->mt_ChainIn, &link->ml_Node);
+
+    arm_flush_cache((uintptr_t)link->ml_Site, 4);
+    arm_icache_invalidate(site, 4);
+}
+
+#if EMU68_JIT_WORKER
+/*
+    Translator state (temporary code buffer, register allocator, chain exits) and the
+    jit_tlsf allocator are shared by the emulation core and the translation worker.
+    Only one core may translate or allocate at a time.
+*/
+static volatile uint8_t translator_lock;
+
+/* Set by the worker once it waits for requests */
+static volatile int jit_worker_active;
+
+/* Bumped whenever m68k code may have changed, units built before are not trusted */
+static volatile uint32_t translation_epoch;
+
+struct TranslationRequest {
+    uint16_t *  tr_M68kAddress;
+    uint32_t    tr_Tier;
+    uint32_t    tr_CRC32;       /* Expected checksum of the code, 0 if any code will do */
+};
+
+struct TranslationResult {
+    struct M68KTranslationUnit *    tr_Unit;
+    uint32_t                        tr_Epoch;
+};
+
+/*
+    Single producer, single consumer rings. Requests are produced by the emulation core
+    and consumed by the worker, results travel the other way
+*/
+static struct TranslationRequest request_ring[EMU68_JIT_QUEUE_SIZE];
+static volatile uint32_t request_head;
+static volatile uint32_t request_tail;
+static struct TranslationResult result_ring[EMU68_JIT_QUEUE_SIZE];
+static volatile uint32_t result_head;
+static volatile uint32_t result_tail;
+
+/* Temporary code buffer of the worker, code translated by M68K_TranslateNoCache may still be running when the worker starts */
+static uint32_t *worker_arm_code;
+#endif
+
+void M68K_LockTranslator()
+{
+#if EMU68_JIT_WORKER
+    while(__atomic_test_and_set(&translator_lock, __ATOMIC_ACQUIRE)) { asm volatile("yield"); }
+#endif
+}
+
+void M68K_UnlockTranslator()
+{
+#if EMU68_JIT_WORKER
+    __atomic_clear(&translator_lock, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Invalid m68k PC in TPIDR_EL1, main loop looks the code up again instead of reusing the last unit */
+static inline void ForgetLastUnit()
+{
+#if !EMU68_HOST_BUILD
+    asm volatile("msr tpidr_el1, %0"::"r"(0xffffffff));
+#endif
+}
+
+static void FreeUnit(struct M68KTranslationUnit *unit);
+
+#if EMU68_VICTIM_CACHE
+/*
+    Victim cache. Translated code reaches the unit header through adr and calls everything else
+    through absolute addresses, so the unit can be moved as a whole. Only the entry point, the
+    chain links and the link literals in the code depend on where the unit is. A saved unit
+    is found by m68k address through a direct mapped index. Records are appended to the ring
+    and overwrite the oldest ones, an index entry is valid while its record was not reached by
+    the write position.
+*/
+struct VictimRecord {
+    uint32_t        vr_M68kAddress;
+    uint32_t        vr_Length;          /* Length of the unit, it follows the record */
+    struct M68KTranslationUnit * vr_Unit;  /* Address the unit was saved from */
+    struct M68KUnitInfo vr_Info;
+} __attribute__((aligned(64)));
+
+struct VictimSlot {
+    uint32_t        vs_M68kAddress;
+    uint64_t        vs_Position;
+};
+
+uint32_t victim_cache_size = EMU68_VICTIM_CACHE_SIZE;
+static uint8_t *victim_base;
+static uint64_t victim_head;
+static uint32_t victim_saved;
+static int victim_restoring;
+static struct VictimSlot victim_slots[EMU68_VICTIM_SLOTS];
+
+static inline struct VictimSlot *Victim_Slot(uint16_t *m68k_address)
+{
+    return &victim_slots[((uintptr_t)m68k_address >> 1) & (EMU68_VICTIM_SLOTS - 1)];
+}
+
+/* Bytes taken by the unit in the code cache: header, code, chain links and the PC map */
+static uint32_t Victim_UnitLength(struct M68KTranslationUnit *unit)
+{
+    uintptr_t end = (uintptr_t)&unit->mt_ChainLinks[unit->mt_ChainCount];
+
+    if (unit->mt_Info->mi_PCMapSize != 0)
+        end = (uintptr_t)unit->mt_Info->mi_PCMap + unit->mt_Info->mi_PCMapSize;
+
+    return ((end - (uintptr_t)unit) + 63) & ~63;
+}
+
+static void Victim_Init()
+{
+    victim_cache_size &= ~63;
+
+    for (uint32_t i=0; i < EMU68_VICTIM_SLOTS; i++)
+        victim_slots[i].vs_M68kAddress = UNIT_SLOT_EMPTY;
+
+    while (victim_cache_size >= 65536 && (victim_base = tlsf_malloc_aligned(tlsf, victim_cache_size, 64)) == NULL)
+        victim_cache_size >>= 1;
+
+    if (victim_base == NULL)
+        victim_cache_size = 0;
+    else
+        kprintf("[ICache] Victim cache at %p, %d KiB\n", victim_base, victim_cache_size / 1024);
+}
+
+/*
+    Copy the unit about to be evicted to the victim cache. Units which would not be entered
+    again as they are, i.e. stale or poisoned ones, are not saved. Translator lock must be held
+*/
+static void Victim_Save(struct M68KTranslationUnit *unit)
+{
+    uintptr_t entry = (uintptr_t)&unit->mt_ARMCode[0] | 0x0000001000000000ULL;
+
+    if (victim_base == NULL || victim_restoring || (uintptr_t)unit->mt_ARMEntryPoint != entry)
+        return;
+#if EMU68_BUS_SITES
+    if (unit->mt_Stale)
+        return;
+#endif
+
+    uint32_t length = Victim_UnitLength(unit);
+    uint32_t total = sizeof(struct VictimRecord) + length;
+    uint32_t offset = victim_head % victim_cache_size;
+
+    /* A single unit may not push out a large part of the ring */
+    if (total > victim_cache_size / 8)
+        return;
+
+    if (offset + total > victim_cache_size)
+    {
+        victim_head += victim_cache_size - offset;
+        offset = 0;
+    }
+
+    struct VictimRecord *rec = (struct VictimRecord *)(victim_base + offset);
+    struct VictimSlot *slot = Victim_Slot(unit->mt_M68kAddress);
+
+    rec->vr_M68kAddress = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+    rec->vr_Length = length;
+    rec->vr_Unit = unit;
+    rec->vr_Info = *unit->mt_Info;
+    memcpy(rec + 1, unit, length);
+
+    slot->vs_M68kAddress = rec->vr_M68kAddress;
+    slot->vs_Position = victim_head;
+
+    victim_head += total;
+    victim_saved++;
+}
+
+/* Saved record of the unit at m68k address, NULL if there is none or it was overwritten */
+static struct VictimRecord *Victim_Find(uint16_t *m68k_address)
+{
+    struct VictimSlot *slot = Victim_Slot(m68k_address);
+    struct VictimRecord *rec;
+
+    if (victim_base == NULL || slot->vs_M68kAddress != (uint32_t)(uintptr_t)m68k_address)
+        return NULL;
+
+    if (victim_head - slot->vs_Position > victim_cache_size)
+    {
+        slot->vs_M68kAddress = UNIT_SLOT_EMPTY;
+        return NULL;
+    }
+
+    rec = (struct VictimRecord *)(victim_base + slot->vs_Position % victim_cache_size);
+
+    return rec->vr_M68kAddress == slot->vs_M68kAddress ? rec : NULL;
+}
+#endif
+
+#if EMU68_CODE_ARENA
+struct CodeSegment {
+    struct List     cs_Units;
+    uint8_t *       cs_Base;
+    uint32_t        cs_Used;
+    uint64_t        cs_Uses;
+};
+
+/* Range of arena segments with own allocation point and clock hand */
+struct CodePool {
+    uint32_t        cp_First;
+    uint32_t        cp_Count;
+    uint32_t        cp_Current;
+    uint32_t        cp_Hand;
+};
+
+static struct CodeSegment *arena_segments;
+static uint32_t arena_count;
+static uintptr_t arena_free;
+
+/* Segments of the pinned pool are never evicted, they hold ROM and hot units */
+static struct CodePool pinned_pool;
+static struct CodePool evict_pool;
+
+static inline struct CodeSegment *Arena_SegmentOf(void *addr)
+{
+    return &arena_segments[((uintptr_t)addr - (uintptr_t)arena_segments[0].cs_Base) / EMU68_ARENA_SEGMENT_SIZE];
+}
+
+/* Return segment to the pool once the last unit in it is gone */
+static void Arena_ResetSegment(struct CodeSegment *seg)
+{
+    arena_free += seg->cs_Used;
+    seg->cs_Used = 0;
+    seg->cs_Uses = 0;
+}
+
+/*
+    Check if the units of the segment were used since the last visit of the clock hand.
+    Segments with units built by the worker and not installed yet count as used.
+*/
+static int Arena_SegmentReferenced(struct CodeSegment *seg)
+{
+    struct Node *n;
+    uint64_t uses = 0;
+
+    ForeachNode(&seg->cs_Units, n)
+    {
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_SegmentNode));
+
+        if (u->mt_LRUNode.ln_Succ == NULL)
+            return 1;
+
+        uses += u->mt_UseCount;
+    }
+
+    if (uses != seg->cs_Uses)
+    {
+        seg->cs_Uses = uses;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Release all units of the segment. Translator lock must be held */
+static void Arena_EvictSegment(struct CodeSegment *seg, int debug)
+{
+    struct Node *n, *next;
+
+    if (debug > 0)
+        kprintf("[ICache] Run out of cache. Evicting code segment @ %p\n", seg->cs_Base);
+
+    ForeachNodeSafe(&seg->cs_Units, n, next)
+    {
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_SegmentNode));
+
+#if EMU68_VICTIM_CACHE
+        Victim_Save(u);
+#endif
+        FreeUnit(u);
+        JITStats_Release(JS_RELEASE_LRU, 1);
+    }
+
+    /* Segment may have been left with no units before, make sure it is empty now */
+    if (seg->cs_Used != 0)
+        Arena_ResetSegment(seg);
+
+    ForgetLastUnit();
+    M68K_ResetJumpCache();
+}
+
+/* Take size bytes at the top of the segment the unit starts in */
+static void Arena_Commit(struct M68KTranslationUnit *unit, uint32_t size)
+{
+    struct CodeSegment *seg = Arena_SegmentOf(unit);
+
+    seg->cs_Used += size;
+    arena_free -= size;
+
+    ADDTAIL(&seg->cs_Units, &unit->mt_SegmentNode);
+}
+
+#if EMU68_DIRECT_TRANSLATE
+/* Space for the largest unit: code buffer of the translator, links of all possible exits and PC map */
+#define DIRECT_RESERVE_SIZE     (((__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) + \
+                                (JCCB_INSN_DEPTH_MASK + 1) * 16 * 64 + 8 + \
+                                (JCCB_INSN_DEPTH_MASK + 2) * sizeof(struct M68KChainLink) + \
+                                (JCCB_INSN_DEPTH_MASK + 1) * 2 * PC_MAP_ENTRY_MAX) + 63) & ~63)
+
+/*
+    Return the place of the next unit in the current segment of the pool if the largest
+    possible unit fits there. Nothing is allocated until Arena_Commit is called. Translator
+    lock must be held.
+*/
+static struct M68KTranslationUnit *Arena_Reserve(struct CodePool *pool)
+{
+    if (pool->cp_Count == 0)
+        return NULL;
+
+    struct CodeSegment *seg = &arena_segments[pool->cp_First + pool->cp_Current];
+
+    if (seg->cs_Used + DIRECT_RESERVE_SIZE > EMU68_ARENA_SEGMENT_SIZE)
+        return NULL;
+
+    return (struct M68KTranslationUnit *)(seg->cs_Base + seg->cs_Used);
+}
+#endif
+
+/*
+    Allocate code memory for a unit in the pool. Empty segments are used first, if there
+    are none and can_evict is set, the clock hand evicts the least recently used segment.
+    Translator lock must be held.
+*/
+static struct M68KTranslationUnit *Arena_Alloc(struct CodePool *pool, uint32_t size, int can_evict, int debug)
+{
+    struct CodeSegment *seg;
+    struct M68KTranslationUnit *unit;
+
+    if (size > EMU68_ARENA_SEGMENT_SIZE || pool->cp_Count == 0)
+        return NULL;
+
+    seg = &arena_segments[pool->cp_First + pool->cp_Current];
+
+    if (seg->cs_Used + size > EMU68_ARENA_SEGMENT_SIZE)
+    {
+        uint32_t i;
+
+        seg = NULL;
+
+        for (i=1; i < pool->cp_Count; i++)
+        {
+            uint32_t s = (pool->cp_Current + i) % pool->cp_Count;
+
+            if (arena_segments[pool->cp_First + s].cs_Used == 0)
+            {
+                pool->cp_Current = s;
+                seg = &arena_segments[pool->cp_First + s];
+                break;
+            }
+        }
+
+        if (seg == NULL && !can_evict)
+            return NULL;
+
+        /* Two rounds of the hand give every segment its second chance */
+        for (i=0; seg == NULL && i < 2 * pool->cp_Count; i++)
+        {
+            pool->cp_Hand = (pool->cp_Hand + 1) % pool->cp_Count;
+
+            struct CodeSegment *victim = &arena_segments[pool->cp_First + pool->cp_Hand];
+
+            if (pool->cp_Hand == pool->cp_Current || Arena_SegmentReferenced(victim))
+                continue;
+
+            Arena_EvictSegment(victim, debug);
+
+            pool->cp_Current = pool->cp_Hand;
+            seg = victim;
+        }
+
+        if (seg == NULL)
+            return NULL;
+    }
+
+    unit = (struct M68KTranslationUnit *)(seg->cs_Base + seg->cs_Used);
+    Arena_Commit(unit, size);
+
+    return unit;
+}
+
+static void Arena_Release(struct M68KTranslationUnit *unit)
+{
+    struct CodeSegment *seg = Arena_SegmentOf(unit);
+
+    REMOVE(&unit->mt_SegmentNode);
+
+    if (IsListEmpty(&seg->cs_Units))
+        Arena_ResetSegment(seg);
+}
+
+static int Arena_IsPinned(struct M68KTranslationUnit *unit)
+{
+    uint32_t s = Arena_SegmentOf(unit) - arena_segments;
+
+    return s >= pinned_pool.cp_First && s < pinned_pool.cp_First + pinned_pool.cp_Count;
+}
+
+static void Arena_Init()
+{
+    uintptr_t reserve = 2 * (JCCB_INSN_DEPTH_MASK + 1) * 16 * 64;
+    uintptr_t avail = tlsf_get_free_size(jit_tlsf);
+    uint8_t *base = NULL;
+
+    /* Leave room for the worker code buffer and code translated outside the cache */
+    arena_count = avail > reserve ? (avail - reserve) / EMU68_ARENA_SEGMENT_SIZE : 0;
+
+    while (arena_count > 0 && (base = tlsf_malloc_aligned(jit_tlsf, arena_count * EMU68_ARENA_SEGMENT_SIZE, 4096)) == NULL)
+        arena_count--;
+
+    if (arena_count == 0)
+    {
+        kprintf("[ICache] No memory for code arena!\n");
+        while(1) { asm volatile("wfe"); }
+    }
+
+    arena_segments = tlsf_malloc(tlsf, sizeof(struct CodeSegment) * arena_count);
+
+    for (uint32_t i=0; i < arena_count; i++)
+    {
+        NEWLIST(&arena_segments[i].cs_Units);
+        arena_segments[i].cs_Base = base + i * EMU68_ARENA_SEGMENT_SIZE;
+        arena_segments[i].cs_Used = 0;
+        arena_segments[i].cs_Uses = 0;
+    }
+
+    pinned_pool.cp_First = 0;
+    pinned_pool.cp_Count = 0;
+#if EMU68_PIN_UNITS
+    /* Clock eviction needs at least two segments */
+    if (arena_count >= 3)
+    {
+        pinned_pool.cp_Count = arena_count >> EMU68_PINNED_SHIFT;
+        if (pinned_pool.cp_Count == 0)
+            pinned_pool.cp_Count = 1;
+    }
+#endif
+    pinned_pool.cp_Current = 0;
+    pinned_pool.cp_Hand = 0;
+
+    evict_pool.cp_First = pinned_pool.cp_Count;
+    evict_pool.cp_Count = arena_count - pinned_pool.cp_Count;
+    evict_pool.cp_Current = 0;
+    evict_pool.cp_Hand = 0;
+
+    arena_free = arena_count * EMU68_ARENA_SEGMENT_SIZE;
+
+    kprintf("[ICache] Code arena at %p, %d segments of %d KiB, %d pinned\n", base, arena_count,
+        EMU68_ARENA_SEGMENT_SIZE / 1024, pinned_pool.cp_Count);
+}
+#endif
+
+/*
+    Pool of unit info records, allocated once from the system memory. There is one record
+    for every slot of the lookup table. Records are taken and returned with translator lock
+    held, the worker never calls the system allocator.
+*/
+static struct M68KUnitInfo *unit_info_pool;
+static struct M68KUnitInfo *unit_info_free;
+
+static void UnitInfo_Init()
+{
+    uint32_t count = EMU68_UNIT_TABLE_SIZE * UNIT_LINE_SLOTS;
+
+    unit_info_pool = tlsf_malloc(tlsf, sizeof(struct M68KUnitInfo) * count);
+    unit_info_free = NULL;
+
+    for (uint32_t i=0; i < count; i++)
+    {
+        unit_info_pool[i].mi_NextFree = unit_info_free;
+        unit_info_free = &unit_info_pool[i];
+    }
+
+    kprintf("[ICache] Unit info pool at %p, %d records\n", unit_info_pool, count);
+}
+
+static struct M68KUnitInfo *UnitInfo_Alloc()
+{
+    struct M68KUnitInfo *info = unit_info_free;
+
+    if (info != NULL)
+    {
+        unit_info_free = info->mi_NextFree;
+        info->mi_LocalState = NULL;
+    }
+
+    return info;
+}
+
+/* Release memory of the unit only. A unit which was never installed has no other resources */
+void M68K_ReleaseUnitCode(struct M68KTranslationUnit *unit)
+{
+    unit->mt_Info->mi_NextFree = unit_info_free;
+    unit_info_free = unit->mt_Info;
+
+#if EMU68_CODE_ARENA
+    Arena_Release(unit);
+#else
+    tlsf_free(jit_tlsf, unit);
+#endif
+}
+
+uintptr_t M68K_GetCacheFree()
+{
+#if EMU68_CODE_ARENA
+    return arena_free;
+#else
+    return tlsf_get_free_size(jit_tlsf);
+#endif
+}
+
+uintptr_t M68K_GetCachePinned()
+{
+#if EMU68_CODE_ARENA
+    return pinned_pool.cp_Count * EMU68_ARENA_SEGMENT_SIZE;
+#else
+    return 0;
+#endif
+}
+
+uintptr_t M68K_GetCacheTotal()
+{
+#if EMU68_CODE_ARENA
+    return arena_count * EMU68_ARENA_SEGMENT_SIZE;
+#else
+    return tlsf_get_total_size(jit_tlsf);
+#endif
+}
+
+/*
+    Remove translation unit from LRU cache and hashtable, break all chains leading
+    to and from the unit and release its memory. JIT_CACHE_FREE is not updated,
+    callers removing many units do it once at the end. Translator lock must be held.
+*/
+static void FreeUnit(struct M68KTranslationUnit *unit)
+{
+    M68K_UnchainUnit(unit);
+
+    for (uint32_t i=0; i < unit->mt_ChainCount; i++)
+    {
+        if (unit->mt_ChainLinks[i].ml_Target != NULL)
+            REMOVE(&unit->mt_ChainLinks[i].ml_Node);
+    }
+
+    UnitTable_Remove(unit);
+    REMOVE(&unit->mt_LRUNode);
+    REMOVE(&unit->mt_PageNode);
+    M68K_ReleaseUnitCode(unit);
+
+    Trace(TRACE_UNIT_RELEASED, (uint32_t)(uintptr_t)unit->mt_M68kAddress, (uint32_t)unit->mt_UseCount, 0, 0);
+
+    __m68k_state->JIT_UNIT_COUNT--;
+}
+
+void M68K_FreeUnit(struct M68KTranslationUnit *unit)
+{
+    M68K_LockTranslator();
+    FreeUnit(unit);
+    M68K_UnlockTranslator();
+}
+
+/*
+    Release units which were not entered since the last visit of the clock hand, pinned units
+    stay. The hand starts at the oldest unit in the list. Units entered in the meantime, as
+    counted by the main loop in mt_UseCount, get a second chance at the head of the list.
+    Lookups never reorder the list. Translator lock must be held
+*/
+static void EvictUnits(int debug)
+{
+    struct Node *n;
+    int count = 0;
+    uint32_t visits = 2 * __m68k_state->JIT_UNIT_COUNT + 8;
+
+    while (count < 8 && visits-- != 0 && (n = GetTail(&LRU)) != NULL) {
+        struct M68KTranslationUnit *ptr = (struct M68KTranslationUnit *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        int keep = ptr->mt_UseCount != ptr->mt_ClockUses;
+
+#if EMU68_CODE_ARENA
+        keep |= Arena_IsPinned(ptr);
+#endif
+        if (keep)
+        {
+            ptr->mt_ClockUses = ptr->mt_UseCount;
+            REMOVE(n);
+            ADDHEAD(&LRU, n);
+            continue;
+        }
+
+        if (debug > 0)
+        {    
+            kprintf("[ICache] Run out of cache. Removing least recently used cache line node @ %p\n", ptr);
+        }
+#if EMU68_VICTIM_CACHE
+        Victim_Save(ptr);
+#endif
+        FreeUnit(ptr);
+        count++;
+    }
+    JITStats_Release(JS_RELEASE_LRU, count);
+    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+    ForgetLastUnit();
+    M68K_ResetJumpCache();
+}
+
+#if EMU68_JIT_WORKER
+/* Find the unit translated from given m68k address in the lookup table */
+static struct M68KTranslationUnit *UnitTable_Find(uint16_t *m68k_address)
+{
+    uint32_t line = UnitTable_Home(m68k_address);
+    struct M68KUnitLine *l;
+
+    do
+    {
+        l = &UnitTable[line];
+
+        for (int i=0; i < UNIT_LINE_SLOTS; i++)
+        {
+            if (l->ul_M68kAddress[i] == (uint32_t)(uintptr_t)m68k_address)
+                return M68K_UnitFromEntry(l->ul_Entry[i]);
+        }
+
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    } while (l->ul_Overflow != 0);
+
+    return NULL;
+}
+#endif
+
+#if EMU68_PC_MAP
+static uint8_t *PutVarint(uint8_t *p, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = 0x80 | (value & 0x7f);
+        value >>= 7;
+    }
+    *p++ = value;
+
+    return p;
+}
+
+static const uint8_t *GetVarint(const uint8_t *p, uint32_t *value)
+{
+    uint32_t v = 0;
+    int shift = 0;
+
+    do {
+        v |= (uint32_t)(*p & 0x7f) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+
+    *value = v;
+
+    return p;
+}
+
+/*
+    Check if the code of the last translation has loads or stores which may fault. The
+    prologue and literal loads are skipped, accesses relative to SP never fault.
+*/
+static int HasFaultingAccess(const uint32_t *code, uint32_t length)
+{
+    if (pc_map_count == 0)
+        return 0;
+
+    for (uint32_t i = local_state[pc_map_index[0]].mls_ARMOffset; i < length; i++)
+    {
+        uint32_t insn = LE32(code[i]);
+
+        if ((insn & 0x0a000000) != 0x08000000)
+            continue;
+        if ((insn & 0x3b000000) == 0x18000000)
+            continue;
+        if (((insn >> 5) & 31) == 31)
+            continue;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+    Encode ARM offset to m68k PC map of the last translation into pc_map_buffer. Every
+    entry holds ARM offset delta in instructions and zig-zag encoded m68k PC delta in
+    words, both as varints. The first entry is relative to offset 0 and the unit address.
+*/
+static uint32_t EncodePCMap(uint16_t *m68k_address)
+{
+    uint8_t *p = pc_map_buffer;
+    uint32_t last_offset = 0;
+    uint16_t *last_pc = m68k_address;
+
+    for (uint32_t i=0; i < pc_map_count; i++)
+    {
+        struct M68KLocalState *ls = &local_state[pc_map_index[i]];
+        int32_t delta = (uint16_t *)ls->mls_M68kPtr - last_pc;
+
+        p = PutVarint(p, ls->mls_ARMOffset - last_offset);
+        p = PutVarint(p, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+
+        last_offset = ls->mls_ARMOffset;
+        last_pc = ls->mls_M68kPtr;
+    }
+
+    return p - pc_map_buffer;
+}
+
+/* Find the unit whose code contains given address, in RW alias */
+static struct M68KTranslationUnit *FindUnitByCode(uintptr_t addr)
+{
+    struct Node *n;
+
+#if EMU68_CODE_ARENA
+    uintptr_t base = (uintptr_t)arena_segments[0].cs_Base;
+
+    if (addr < base || addr >= base + arena_count * EMU68_ARENA_SEGMENT_SIZE)
+        return NULL;
+
+    ForeachNode(&arena_segments[(addr - base) / EMU68_ARENA_SEGMENT_SIZE].cs_Units, n)
+    {
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_SegmentNode));
+#else
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+#endif
+        if (addr >= (uintptr_t)&u->mt_ARMCode[0] && addr < (uintptr_t)&u->mt_ARMCode[u->mt_Info->mi_ARMInsnCnt + 1])
+            return u;
+    }
+
+    return NULL;
+}
+#endif
+
+/*
+    Return m68k PC of the instruction whose translation contains given ARM address, or
+    NULL if the address is not within a unit with PC map. All m68k registers have fixed
+    ARM registers, with the PC from the map the fault handler has precise m68k state.
+*/
+uint16_t *M68K_GetFaultPC(uint64_t arm_pc)
+{
+#if EMU68_PC_MAP
+    uintptr_t addr = arm_pc & ~0x0000001000000000ULL;
+    struct M68KTranslationUnit *unit = FindUnitByCode(addr);
+
+    if (unit == NULL || unit->mt_Info->mi_PCMapSize == 0)
+        return NULL;
+
+    const uint8_t *p = unit->mt_Info->mi_PCMap;
+    const uint8_t *map_end = p + unit->mt_Info->mi_PCMapSize;
+    uint32_t fault_offset = (addr - (uintptr_t)&unit->mt_ARMCode[0]) / 4;
+    uint32_t offset = 0;
+    uint16_t *pc = unit->mt_M68kAddress;
+    uint16_t *found = NULL;
+
+    while (p < map_end)
+    {
+        uint32_t d_offset, d_pc;
+
+        p = GetVarint(p, &d_offset);
+        p = GetVarint(p, &d_pc);
+
+        offset += d_offset;
+        if (offset > fault_offset)
+            break;
+
+        pc += (int32_t)(d_pc >> 1) ^ -(int32_t)(d_pc & 1);
+        found = pc;
+    }
+
+    return found;
+#else
+    (void)arm_pc;
+    return NULL;
+#endif
+}
+
+/*
+    Map ARM address of translated code to the m68k address of its unit, or 0 if the address
+    is not in any unit. The m68k PC of the instruction is stored in *m68k_pc when known. Used
+    by the profiler on another CPU, units cannot go away while the translator lock is held.
+*/
+uint32_t M68K_ResolveCodeAddress(uint64_t arm_pc, uint32_t *m68k_pc)
+{
+#if EMU68_PC_MAP
+    uint32_t unit_pc = 0;
+
+    M68K_LockTranslator();
+
+    struct M68KTranslationUnit *unit = FindUnitByCode(arm_pc & ~0x0000001000000000ULL);
+
+    if (unit != NULL)
+    {
+        uint16_t *pc = M68K_GetFaultPC(arm_pc);
+
+        unit_pc = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+        *m68k_pc = pc ? (uint32_t)(uintptr_t)pc : unit_pc;
+    }
+
+    M68K_UnlockTranslator();
+
+    return unit_pc;
+#else
+    (void)arm_pc;
+    (void)m68k_pc;
+    return 0;
+#endif
+}
+
+/*
+    m68k instructions per ARM instruction of the unit containing given code address, 16.16 fixed
+    point. Prologue and epilogue are not counted. Returns 0 outside of translated code
+*/
+uint32_t M68K_CodeDensity(uint64_t arm_pc)
+{
+#if EMU68_PC_MAP
+    uint32_t density = 0;
+
+    M68K_LockTranslator();
+
+    struct M68KTranslationUnit *unit = FindUnitByCode(arm_pc & ~0x0000001000000000ULL);
+
+    if (unit != NULL)
+    {
+        struct M68KUnitInfo *info = unit->mt_Info;
+        uint32_t body = info->mi_ARMInsnCnt - info->mi_PrologueSize - info->mi_EpilogueSize;
+
+        if ((int32_t)body < 1)
+            body = 1;
+
+        density = (info->mi_M68kInsnCnt << 16) / body;
+    }
+
+    M68K_UnlockTranslator();
+
+    return density;
+#else
+    (void)arm_pc;
+    return 0;
+#endif
+}
+
+#if EMU68_BUS_SITES
+/*
+    Called by the fault handler for a load or store which hits emulated memory often. The
+    access is remembered and its unit poisoned, on next entry the unit is translated again
+    with a direct bus call in place of the access.
+*/
+void M68K_MarkBusSite(uint64_t arm_pc)
+{
+#if EMU68_PC_MAP
+    uintptr_t addr = arm_pc & ~0x0000001000000000ULL;
+    struct M68KTranslationUnit *unit = FindUnitByCode(addr);
+    uint16_t *m68k_pc = M68K_GetFaultPC(arm_pc);
+
+    if (unit == NULL || m68k_pc == NULL)
+        return;
+
+    if (M68K_AddBusSite(m68k_pc, LE32(*(uint32_t *)addr)))
+    {
+        unit->mt_Stale = 1;
+        M68K_PoisonUnit(unit);
+    }
+#else
+    (void)arm_pc;
+#endif
+}
+#endif
+
+static int IsROMRange(uintptr_t low, uintptr_t high);
+
+/*
+    Translate m68k code and build a complete unit out of it. The unit is not yet in the
+    LRU list nor in the lookup table. If can_evict is not set, the function returns NULL
+    when the cache is full. Translator lock must be held.
+*/
+/*
+    One line per translated unit, enabled with jit_report on the command line. Parsed by
+    scripts/run-qemu-virt-corpus.sh, flag stores are writes of the CC register back to SR.
+*/
+static void ReportUnit(struct M68KTranslationUnit *unit)
+{
+    struct M68KUnitInfo *info = unit->mt_Info;
+    uint32_t flag_store = INSN_TO_LE(msr(0, 3, 3, 13, 0, 2));
+    uint32_t flag_stores = 0;
+
+    for (uint32_t i=0; i < info->mi_ARMInsnCnt; i++)
+    {
+        if ((INSN_TO_LE(unit->mt_ARMCode[i]) & ~31U) == flag_store)
+            flag_stores++;
+    }
+
+    kprintf("[JIT] Unit: pc=%08x tier=%d m68k=%d arm=%d prologue=%d epilogue=%d exits=%d flagstores=%d\n",
+        (uint32_t)(uintptr_t)unit->mt_M68kAddress, unit->mt_Tier, info->mi_M68kInsnCnt, info->mi_ARMInsnCnt,
+        info->mi_PrologueSize, info->mi_EpilogueSize, info->mi_Conditionals + 1, flag_stores);
+}
+
+/*
+    Allocate unit_length bytes of code memory, in the pinned pool first if pin is set. If
+    can_evict is not set, the function returns NULL when the cache is full. Translator lock
+    must be held.
+*/
+static struct M68KTranslationUnit *AllocUnit(uint32_t unit_length, int pin, int can_evict, int debug)
+{
+    struct M68KTranslationUnit *unit = NULL;
+
+    while (unit == NULL) {
+#if EMU68_CODE_ARENA
+        if (pin)
+            unit = Arena_Alloc(&pinned_pool, unit_length, 0, debug);
+        if (unit == NULL)
+            unit = Arena_Alloc(&evict_pool, unit_length, can_evict, debug);
+#else
+        (void)pin;
+        unit = tlsf_malloc_aligned(jit_tlsf, unit_length, 64);
+#endif
+
+        __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+        if (unit == NULL)
+        {
+            if (!can_evict)
+                return NULL;
+
+            if (debug > 0) {
+                kprintf("[ICache] Requested block was %d bytes long\n", unit_length);
+            }
+
+            EvictUnits(debug);
+        }
+    }
+
+    return unit;
+}
+
+static struct M68KTranslationUnit *BuildUnit(uint16_t *m68kcodeptr, uint32_t tier, int can_evict, int debug)
+{
+    struct M68KTranslationUnit *unit = NULL;
+    struct M68KUnitInfo *info;
+    uint64_t t0 = JITStats_Time();
+
+    /* The worker shares local state with the main thread and may not allocate it */
+    if (can_evict)
+        GrowTranslationBuffers();
+    else if (translation_depth == 0)
+        return NULL;
+
+    /* Keep the lookup table load at 7/8 of its capacity at most */
+    if (can_evict && __m68k_state->JIT_UNIT_COUNT >= (EMU68_UNIT_TABLE_SIZE * UNIT_LINE_SLOTS * 7) / 8)
+    {
+        EvictUnits(0);
+    }
+
+    /* The pool is larger than the lookup table may hold, it runs dry with many pending worker units only */
+    while ((info = UnitInfo_Alloc()) == NULL)
+    {
+        if (!can_evict)
+            return NULL;
+
+        EvictUnits(debug);
+    }
+
+    /* ROM code and units promoted to tier 1 go to the pinned pool while there is space in it */
+    int pin = (tier == 1 || IsROMRange((uintptr_t)m68kcodeptr, (uintptr_t)m68kcodeptr));
+
+#if EMU68_CODE_ARENA && EMU68_DIRECT_TRANSLATE
+    /* Nothing may be released between the reservation and the commit */
+    struct M68KTranslationUnit *direct = pin ? Arena_Reserve(&pinned_pool) : NULL;
+    uint32_t *saved_arm_code = temporary_arm_code;
+
+    if (direct == NULL)
+        direct = Arena_Reserve(&evict_pool);
+
+    if (direct != NULL)
+        temporary_arm_code = &direct->mt_ARMCode[0];
+#endif
+
+    uintptr_t line_length = M68K_Translate(m68kcodeptr, tier);
+    uintptr_t arm_insn_count = line_length/4 - 1;
+
+#if EMU68_CODE_ARENA && EMU68_DIRECT_TRANSLATE
+    temporary_arm_code = saved_arm_code;
+#endif
+
+    uintptr_t links_offset = (__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) + line_length + 7) & ~7;
+    uintptr_t unit_length = links_offset;
+#if EMU68_BLOCK_CHAINING
+    unit_length += chain_count * sizeof(struct M68KChainLink);
+#endif
+#if EMU68_PC_MAP
+    /* The map follows the links, units without faulting accesses have none */
+    uintptr_t pc_map_offset = unit_length;
+    uint32_t pc_map_size = 0;
+
+    if (HasFaultingAccess(temporary_arm_code, line_length / 4))
+        pc_map_size = EncodePCMap(m68kcodeptr);
+
+    unit_length += pc_map_size;
+#endif
+    unit_length = (unit_length + 63) & ~63;
+
+#if EMU68_CODE_ARENA && EMU68_DIRECT_TRANSLATE
+    if (direct != NULL)
+    {
+        unit = direct;
+        Arena_Commit(unit, unit_length);
+        __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+    }
+#endif
+
+    if (unit == NULL)
+        unit = AllocUnit(unit_length, pin, can_evict, debug);
+
+    if (unit == NULL)
+    {
+        info->mi_NextFree = unit_info_free;
+        unit_info_free = info;
+        return NULL;
+    }
+
+    /* Not in LRU list until installed */
+    unit->mt_LRUNode.ln_Succ = NULL;
+    unit->mt_ARMEntryPoint = &unit->mt_ARMCode[0];
+    unit->mt_ARMEntryPoint = (void *)((uintptr_t)unit->mt_ARMEntryPoint | 0x0000001000000000ULL);
+    unit->mt_Info = info;
+    info->mi_M68kInsnCnt = insn_count;
+    info->mi_ARMInsnCnt = arm_insn_count;
+    unit->mt_UseCount = 0;
+    unit->mt_ClockUses = 0;
+    unit->mt_FetchCount = 0;
+    unit->mt_M68kAddress = m68kcodeptr;
+    unit->mt_M68kLow = m68k_low;
+    unit->mt_M68kHigh = m68k_high;
+    unit->mt_CRC32 = CalcCRC32(m68k_low, m68k_high);
+#if EMU68_UNIT_CRC_PAGES
+    CalcPageCRCs(unit);
+#endif
+    info->mi_PrologueSize = prologue_size;
+    info->mi_EpilogueSize = epilogue_size;
+    info->mi_Conditionals = conditionals_count;
+#if EMU68_PC_MAP
+    info->mi_PCMapSize = pc_map_size;
+    info->mi_PCMap = (uint8_t *)unit + pc_map_offset;
+    memcpy(info->mi_PCMap, pc_map_buffer, pc_map_size);
+#else
+    info->mi_PCMapSize = 0;
+    info->mi_PCMap = NULL;
+#endif
+    unit->mt_Tier = tier;
+    unit->mt_TierCount = EMU68_TIER_THRESHOLD;
+    unit->mt_SideExits = 0;
+#if EMU68_BRANCH_PROFILE
+    for (int i=0; i < EMU68_BRANCH_PROFILE_SLOTS; i++)
+    {
+#if EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+        unit->mt_BranchPC[i] = (i < (int)branch_profile_count) ? branch_profile_pc[i] : 0;
+#else
+        unit->mt_BranchPC[i] = 0;
+#endif
+        unit->mt_BranchExits[i] = 0;
+    }
+#endif
+#if EMU68_SUPERBLOCKS
+#if EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    unit->mt_ExitTarget = (tier == 0) ? unit_exit_target : 0;
+#else
+    unit->mt_ExitTarget = 0;
+#endif
+#endif
+    unit->mt_Protected = 0;
+    unit->mt_Immutable = IsROMRange((uintptr_t)m68k_low, (uintptr_t)m68k_high);
+#if EMU68_BUS_SITES
+    unit->mt_Stale = 0;
+#endif
+    unit->mt_Generation = __m68k_state->JIT_FLUSH_GEN;
+#if EMU68_LAZY_RETUNE
+    unit->mt_Control = EffectiveControl(m68kcodeptr);
+    unit->mt_Control2 = jit_control2;
+#endif
+#if EMU68_CODE_ARENA && EMU68_DIRECT_TRANSLATE
+    if (unit != direct)
+#endif
+    DuffCopy(&unit->mt_ARMCode[0], temporary_arm_code, line_length/4);
+
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+    /* Soft flush cannot make ROM code stale, jump over the generation check at the unit start */
+    if (unit->mt_Immutable && (INSN_TO_LE(unit->mt_ARMCode[0]) & 0xff000000) == 0x18000000)
+        unit->mt_ARMCode[0] = b(GENERATION_CHECK_SIZE);
+#endif
+
+    NEWLIST(&unit->mt_ChainIn);
+    unit->mt_ChainLinks = (struct M68KChainLink *)((uintptr_t)unit + links_offset);
+    unit->mt_ChainCount = 0;
+#if EMU68_BLOCK_CHAINING
+    unit->mt_ChainCount = chain_count;
+    for (uint32_t i=0; i < chain_count; i++)
+    {
+        struct M68KChainLink *link = &unit->mt_ChainLinks[i];
+        uint32_t *exit = &unit->mt_ARMCode[chain_exits[i].ce_ARMOffset];
+
+        link->ml_Unit = unit;
+        link->ml_Target = NULL;
+        link->ml_M68kTarget = chain_exits[i].ce_M68kTarget;
+
+        if (chain_exits[i].ce_Way == CHAIN_WAY_STATIC)
+        {
+            link->ml_Site = exit + CHAIN_SITE_OFFSET;
+            link->ml_Guard = NULL;
+
+            /* Fill the literal loaded into x0 by the exit */
+            *(uint64_t *)(exit + CHAIN_LINK_LITERAL) = (uintptr_t)link;
+        }
+        else
+        {
+            uint32_t way = chain_exits[i].ce_Way;
+
+            link->ml_Site = exit + INDIRECT_SITE_OFFSET + way * INDIRECT_SITE_STRIDE;
+            link->ml_Guard = exit + INDIRECT_GUARD_OFFSET + way;
+
+            /* The exit reports its first way, the main loop picks the free one */
+            if (way == 0)
+                *(uint64_t *)(exit + INDIRECT_LINK_LITERAL) = (uintptr_t)link;
+        }
+    }
+#endif
+
+    SyncNewCode(unit->mt_ARMEntryPoint, line_length);
+
+    JITStats_Unit(insn_count, arm_insn_count, JITStats_Time() - t0);
+
+    if (jit_report)
+        ReportUnit(unit);
+
+    return unit;
+}
+
+#if EMU68_VICTIM_CACHE
+/*
+    Copy the unit starting at m68kcodeptr back from the victim cache if its m68k code has not
+    changed since it was saved. Units of a lower tier than requested are not taken, neither are
+    units translated with other settings. The links of the copy are all reset, the unit is not
+    yet in the LRU list nor in the lookup table. Translator lock must be held.
+*/
+static struct M68KTranslationUnit *Victim_Restore(uint16_t *m68kcodeptr, uint32_t tier, int debug)
+{
+    struct VictimRecord *rec = Victim_Find(m68kcodeptr);
+    struct M68KTranslationUnit *saved;
+    struct M68KTranslationUnit *unit;
+    struct M68KUnitInfo *info;
+
+    if (rec == NULL)
+        return NULL;
+
+    saved = (struct M68KTranslationUnit *)(rec + 1);
+
+    if (saved->mt_Tier < tier)
+        return NULL;
+
+#if EMU68_LAZY_RETUNE
+    if (!saved->mt_Immutable && saved->mt_Tier != 0 &&
+        (saved->mt_Control != EffectiveControl(m68kcodeptr) || saved->mt_Control2 != jit_control2))
+        return NULL;
+#endif
+
+    if (CalcCRC32(saved->mt_M68kLow, saved->mt_M68kHigh) != saved->mt_CRC32)
+    {
+        Victim_Slot(m68kcodeptr)->vs_M68kAddress = UNIT_SLOT_EMPTY;
+        return NULL;
+    }
+
+    /* Units evicted now are not saved, they could overwrite the record */
+    victim_restoring = 1;
+
+    if (__m68k_state->JIT_UNIT_COUNT >= (EMU68_UNIT_TABLE_SIZE * UNIT_LINE_SLOTS * 7) / 8)
+        EvictUnits(0);
+
+    while ((info = UnitInfo_Alloc()) == NULL)
+        EvictUnits(debug);
+
+    unit = AllocUnit(rec->vr_Length, saved->mt_Tier == 1 || saved->mt_Immutable, 1, debug);
+
+    victim_restoring = 0;
+
+    intptr_t delta = (intptr_t)unit - (intptr_t)rec->vr_Unit;
+
+    memcpy(unit, saved, rec->vr_Length);
+
+    *info = rec->vr_Info;
+    info->mi_LocalState = NULL;
+    if (info->mi_PCMap != NULL)
+        info->mi_PCMap += delta;
+
+    unit->mt_LRUNode.ln_Succ = NULL;
+    unit->mt_ARMEntryPoint = (void *)((uintptr_t)&unit->mt_ARMCode[0] | 0x0000001000000000ULL);
+    unit->mt_Info = info;
+    unit->mt_UseCount = 0;
+    unit->mt_ClockUses = 0;
+    unit->mt_FetchCount = 0;
+    unit->mt_Protected = 0;
+    unit->mt_Generation = __m68k_state->JIT_FLUSH_GEN;
+#if EMU68_UNIT_CRC_PAGES
+    unit->mt_DirtyPages = 0xffff;
+#endif
+#if EMU68_LAZY_RETUNE
+    unit->mt_Control = EffectiveControl(m68kcodeptr);
+    unit->mt_Control2 = jit_control2;
+#endif
+
+    NEWLIST(&unit->mt_ChainIn);
+    unit->mt_ChainLinks = (struct M68KChainLink *)((uintptr_t)unit->mt_ChainLinks + delta);
+
+    for (uint32_t i=0; i < unit->mt_ChainCount; i++)
+    {
+        struct M68KChainLink *link = &unit->mt_ChainLinks[i];
+
+        link->ml_Unit = unit;
+        link->ml_Target = NULL;
+        link->ml_Site = (uint32_t *)((uintptr_t)link->ml_Site + delta);
+        *link->ml_Site = bx_lr();
+
+        if (link->ml_Guard == NULL)
+        {
+            *(uint64_t *)(link->ml_Site - CHAIN_SITE_OFFSET + CHAIN_LINK_LITERAL) = (uintptr_t)link;
+        }
+        else
+        {
+            link->ml_Guard = (uint32_t *)((uintptr_t)link->ml_Guard + delta);
+            *link->ml_Guard = INDIRECT_GUARD_EMPTY;
+            link->ml_M68kTarget = NULL;
+
+            /* Way 0 has its site and guard at this distance, only it is in the link literal */
+            if (link->ml_Site - link->ml_Guard == INDIRECT_SITE_OFFSET - INDIRECT_GUARD_OFFSET)
+                *(uint64_t *)(link->ml_Guard - INDIRECT_GUARD_OFFSET + INDIRECT_LINK_LITERAL) = (uintptr_t)link;
+        }
+    }
+
+    SyncNewCode(unit->mt_ARMEntryPoint, (info->mi_ARMInsnCnt + 1) * 4);
+
+    if (debug > 0)
+        kprintf("[ICache] Unit %08x restored from victim cache to %p\n", (uint32_t)(uintptr_t)m68kcodeptr, unit);
+
+    return unit;
+}
+#endif
+
+#define INVALIDATE_POISON       0
+#define INVALIDATE_RELEASE      1
+#define INVALIDATE_WRITTEN      2
+
+/*
+    Apply the action to all units overlapping m68k range from start up to, but not including,
+    end. Only page index buckets which may hold such units are visited. Units translated
+    from ROM are kept.
+*/
+static void InvalidateUnits(uintptr_t start, uintptr_t end, int action, int cause)
+{
+    uint32_t first = start >> 12;
+    uint32_t count;
+    uint32_t hit = 0;
+
+    first = first > page_index_span ? first - page_index_span : 0;
+    count = ((end - 1) >> 12) - first + 1;
+
+    if (count > EMU68_PAGE_INDEX_SIZE)
+        count = EMU68_PAGE_INDEX_SIZE;
+
+    if (action == INVALIDATE_RELEASE)
+        M68K_LockTranslator();
+
+    for (uint32_t i=0; i < count; i++)
+    {
+        struct List *bucket = &PageIndex[(first + i) & EMU68_PAGE_INDEX_MASK];
+        struct Node *n, *next;
+
+        ForeachNodeSafe(bucket, n, next)
+        {
+            struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_PageNode));
+
+            if ((uintptr_t)u->mt_M68kLow >= end || (uintptr_t)u->mt_M68kHigh <= start)
+                continue;
+
+            if (M68K_IsROMUnit(u))
+                continue;
+
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+            if (action != INVALIDATE_POISON)
+                DepthHint_Invalidated(u);
+#endif
+            hit++;
+
+            switch (action)
+            {
+                case INVALIDATE_RELEASE:
+                    FreeUnit(u);
+                    break;
+
+                case INVALIDATE_WRITTEN:
+                    /* Entry will verify the checksum again */
+                    u->mt_Protected = 0;
+#if EMU68_UNIT_CRC_PAGES
+                    /* Other pages of the unit are still protected, only this part needs the check */
+                    if (u->mt_PageCount)
+                        u->mt_DirtyPages |= 1U << ((start >> 12) - ((uintptr_t)u->mt_M68kLow >> 12));
+#endif
+                    /* Fallthrough */
+
+                default:
+                    M68K_PoisonUnit(u);
+                    break;
+            }
+        }
+    }
+
+    JITStats_Release(cause, hit);
+
+    if (action == INVALIDATE_RELEASE)
+    {
+        __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+        M68K_UnlockTranslator();
+    }
+}
+
+/*
+    Invalidate units overlapping the m68k range, used by CINV/CPUSH with line and page
+    scope. Weak cache flush poisons the units, fault handler will verify their checksums
+*/
+void M68K_InvalidateRange(uintptr_t start, uintptr_t end)
+{
+    /* Line scope covers 16 bytes, page scope 4K */
+    int cause = (end - start > 16) ? JS_RELEASE_CINV_PAGE : JS_RELEASE_CINV_LINE;
+
+    InvalidateUnits(start, end, (__m68k_state->JIT_CONTROL & JCCF_SOFT) ? INVALIDATE_POISON : INVALIDATE_RELEASE, cause);
+}
+
+#if EMU68_M68K_MMU
+/*
+    Poison units overlapping the m68k range, they verify their checksum on next entry. Nothing
+    is released, so this may be called from translated code. Used by PFLUSH, the page may have
+    other code behind it now although nothing was written there
+*/
+void M68K_RecheckRange(uintptr_t start, uintptr_t end)
+{
+    InvalidateUnits(start, end, INVALIDATE_POISON, JS_RELEASE_SOFT_FLUSH);
+    M68K_DiscardPendingUnits();
+}
+
+/*
+    Make all units verify their checksum on next entry, like the weak CINVA. Used when the m68k
+    MMU is switched or its tables have changed. Units translated from ROM are kept, ROM is
+    expected at its physical address
+*/
+void M68K_RecheckUnits()
+{
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+    __m68k_state->JIT_FLUSH_GEN++;
+#if EMU68_LAZY_RETUNE
+    jit_soft_flush_gen = __m68k_state->JIT_FLUSH_GEN;
+#endif
+    JITStats_Release(JS_RELEASE_SOFT_FLUSH, __m68k_state->JIT_UNIT_COUNT);
+#else
+    InvalidateUnits(0, 0x100000000ULL, INVALIDATE_POISON, JS_RELEASE_SOFT_FLUSH);
+#endif
+    M68K_DiscardPendingUnits();
+}
+#endif
+
+/*
+    Release all units except for the ones translated from ROM, used by CINVA/CPUSHA and by
+    warm reset. Chains between ROM units and the released ones are reverted by FreeUnit.
+*/
+void M68K_ReleaseRAMUnits(int cause)
+{
+    struct Node *n, *next;
+
+    ForeachNodeSafe(&LRU, n, next)
+    {
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        if (!M68K_IsROMUnit(u))
+        {
+            M68K_FreeUnit(u);
+            JITStats_Release(cause, 1);
+        }
+    }
+
+    M68K_ResetJumpCache();
+    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+}
+
+#if EMU68_SMC_PROTECT
+/* One bit per 4K page of the m68k address space, set if the page was made read-only by the JIT */
+static uint32_t protected_pages[(1 << 20) / 32];
+
+/*
+    Write protect all pages the unit was translated from. Only directly mapped RAM above
+    16MB is protected, ROM is read-only already. Returns 1 if all pages are protected.
+*/
+static int ProtectUnitPages(struct M68KTranslationUnit *unit)
 {
-    m68k_entry_point = m68kcodeptr;
-    uint16_t *orig_m68kcodeptr = m68kcodeptr;
-    uintptr_t hash = (uintptr_t)m68kcodeptr;
-    int var_EMU68_MAX_LOOP_COUNT = (__m68k_state->JIT_CONTROL >> JCCB_LOOP_COUNT) & JCCB_LOOP_COUNT_MASK;
-    if (var_EMU68_MAX_LOOP_COUNT == 0)
-        var_EMU68_MAX_LOOP_COUNT = JCCB_LOOP_COUNT_MASK + 1;
-    uint32_t var_EMU68_M68K_INSN_DEPTH = (__m68k_state->JIT_CONTROL >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK;
-    if (var_EMU68_M68K_INSN_DEPTH == 0)
-        var_EMU68_M68K_INSN_DEPTH = JCCB_INSN_DEPTH_MASK + 1;
+    uintptr_t page = (uintptr_t)unit->mt_M68kLow & ~4095UL;
+    uintptr_t last = ((uintptr_t)unit->mt_M68kHigh - 1) & ~4095UL;
 
-    uint16_t *last_rev_jump = (uint16_t *)0xffffffff;
+    if ((__m68k_state->JIT_CONTROL2 & JC2F_SMC_PROTECT) == 0)
+        return 0;
 
-    reg_Load96 = 0xff;
-    reg_Save96 = 0xff;
-    val_FPIAR = 0xffffffff;
+    if (page < 0x01000000 || last > 0xffffffffUL || M68K_IsROMUnit(unit))
+        return 0;
 
-    int debug = 0;
-    int disasm = 0;
+#if EMU68_M68K_MMU
+    /* Protection is done on physical pages, the unit has virtual addresses */
+    if (m68k_mmu_enabled)
+        return 0;
+#endif
 
-    if ((uint32_t)(uintptr_t)m68kcodeptr >= debug_range_min && (uint32_t)(uintptr_t)m68kcodeptr <= debug_range_max) {
-        debug = globalDebug();
-        disasm = globalDisasm();
-    }
+    /* One TLB flush for all pages of the unit */
+    mmu_batch_begin();
 
-    if (RA_GetTempAllocMask()) {
-        kprintf("[ICache] Temporary register alloc mask on translate start is non-zero %x\n", RA_GetTempAllocMask());
+    for (; page <= last; page += 4096)
+    {
+        uint32_t idx = page >> 12;
 
-        while(1);
-    }
+        if (protected_pages[idx >> 5] & (1U << (idx & 31)))
+            continue;
 
-    if (disasm) {
-        disasm_open();
+        if (!mmu_protect_page(page, 1))
+            break;
+
+        protected_pages[idx >> 5] |= 1U << (idx & 31);
     }
 
-    M68K_ResetReturnStack();
+    mmu_batch_commit();
 
-    if (debug) {
-        uint32_t hash_calc = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-        kprintf("[ICache] Creating new translation unit with hash %04x (m68k code @ %p)\n", hash_calc, (void*)m68kcodeptr);
-        if (debug > 1)
-            M68K_PrintContext(__m68k_state);
+    return page > last;
+}
+
+/*
+    Called from the page fault handler on write access. If the page was protected by the JIT,
+    all units translated from it are poisoned and write access is restored. The faulting store
+    is restarted then. Returns 0 if the fault was not caused by the protection.
+*/
+int M68K_HandleCodeWrite(uintptr_t fault_addr)
+{
+    /*
+        Host code writing m68k memory through the -4GB shadow of the kernel table, which shares
+        the page tables with the physical space. It may run on any core, see M68K_HostWrite
+    */
+    if ((fault_addr >> 32) == 0xffffffffUL)
+    {
+        uintptr_t page = fault_addr & 0xfffff000UL;
+        uint32_t idx = page >> 12;
+
+        if ((protected_pages[idx >> 5] & (1U << (idx & 31))) == 0)
+            return 0;
+
+        M68K_HostWrite(page, page + 4096, 1);
+
+        return 1;
     }
 
-    int lr_is_saved = 0;
-    
-    prologue_size = 0;
-    epilogue_size = 0;
-    conditionals_count = 0;
+    /* Shadow of the 4GB area created by the MMU code */
+    if (fault_addr >> 33)
+        return 0;
 
-    insn_count = 0;
-    uint32_t *arm_code = temporary_arm_code;
-    uint32_t *end = arm_code;
+#if EMU68_M68K_MMU
+    /* Code pages are protected by physical address, the fault gives the virtual one */
+    if (unlikely(m68k_mmu_enabled))
+        fault_addr = M68K_MMUPhysical(fault_addr);
+#endif
 
-    (void)prologue_size;
-    (void)lr_is_saved;
+    uintptr_t page = fault_addr & 0xfffff000UL;
+    uint32_t idx = page >> 12;
 
-    RA_ClearChangedMask();
+    if ((protected_pages[idx >> 5] & (1U << (idx & 31))) == 0)
+        return 0;
 
-    uint32_t *tmpptr = end;
+    InvalidateUnits(page, page + 4096, INVALIDATE_WRITTEN, JS_RELEASE_WRITTEN);
 
-    if (debug_cnt & 2)
+    M68K_DiscardPendingUnits();
+
+    protected_pages[idx >> 5] &= ~(1U << (idx & 31));
+    mmu_protect_page(page, 0);
+
+    /* Unit in x12 may be poisoned now */
+    ForgetLastUnit();
+
+    return 1;
+}
+
+/*
+    Host code is going to write m68k memory from start up to end, e.g. a native call, the RTG or
+    mixer service or the RAM disk. Units translated from protected pages of the range are poisoned
+    and the pages are made writable, so the write neither faults nor leaves units which skip the
+    checksum behind. Takes the translator lock. Remote is set on other cores than the m68k one,
+    the unit in x12 of the m68k core cannot be dropped from there, a soft flush is used instead
+*/
+void M68K_HostWrite(uintptr_t start, uintptr_t end, int remote)
+{
+    uintptr_t page = start & ~4095UL;
+    uint32_t hit = 0;
+
+    if (end > 0x100000000ULL)
+        end = 0x100000000ULL;
+
+    /* Most writes hit no protected page. Pages protected after this test fault on the write */
+    for (; page < end; page += 4096)
     {
-        uint8_t reg = RA_AllocARMRegister(&end);
-        *end++ = mov_immed_u16(reg, 4, 0);
-        *end++ = msr(reg, 3, 3, 9, 12, 4);
-        RA_FreeARMRegister(&end, reg);
-    }
+        uint32_t idx = page >> 12;
 
-    prologue_size = end - tmpptr;
+        if (protected_pages[idx >> 5] & (1U << (idx & 31)))
+            break;
+    }
 
-    int break_loop = FALSE;
-    int inner_loop = FALSE;
-    int soft_break = FALSE;
-    int max_rev_jumps = 0;
+    if (page >= end)
+        return;
 
-    m68k_low = m68kcodeptr;
-    m68k_high = m68kcodeptr + 16;
+    M68K_LockTranslator();
 
-    while (break_loop == FALSE && soft_break == FALSE && insn_count < var_EMU68_M68K_INSN_DEPTH)
+    for (; page < end; page += 4096)
     {
-        uint16_t insn_consumed;
-        uint16_t *in_code = m68kcodeptr;
-        uint32_t *out_code = end;
+        uint32_t idx = page >> 12;
 
-        if (insn_count && ((uintptr_t)m68kcodeptr < (uintptr_t)local_state[insn_count-1].mls_M68kPtr))
-        {
-            int found = -1;
-//kprintf("going backwards... %p -> %p\n", local_state[insn_count-1].mls_M68kPtr, m68kcodeptr);
-            for (int i=insn_count - 1; i >= 0; --i)
-            {
-                if (local_state[i].mls_M68kPtr == m68kcodeptr)
-                {
-//                        kprintf("PC match at i=%d, %d instructions\n", i, insn_count - i - 1);
-                    found = i;
-                    break;
-                }
-            }
+        if ((protected_pages[idx >> 5] & (1U << (idx & 31))) == 0)
+            continue;
 
-            if (found > 0)
-            {
-                if ((insn_count - found - 1) > (var_EMU68_M68K_INSN_DEPTH - insn_count))
-                {
-//                        kprintf("not enough place for completion of the loop\n");
-                    break;
-                }
-            }
-        }
+        if (hit++ == 0)
+            mmu_batch_begin();
 
-        local_state[insn_count].mls_ARMOffset = end - arm_code;
-        local_state[insn_count].mls_M68kPtr = m68kcodeptr;
-        local_state[insn_count].mls_PCRel = _pc_rel;
+        InvalidateUnits(page, page + 4096, INVALIDATE_WRITTEN, JS_RELEASE_WRITTEN);
 
-        end = EmitINSN(end, &m68kcodeptr, &insn_consumed);
+        protected_pages[idx >> 5] &= ~(1U << (idx & 31));
+        mmu_protect_page(page, 0);
+    }
 
-        if (m68kcodeptr < m68k_low)
-            m68k_low = m68kcodeptr;
-        if (m68kcodeptr + 16 > m68k_high)
-            m68k_high = m68kcodeptr + 16;
+    if (hit)
+    {
+        mmu_batch_commit();
+        M68K_DiscardPendingUnits();
 
-        insn_count+=insn_consumed;
-        if (end[-1] == INSN_TO_LE(0xfffffff0))
-        {
-            lr_is_saved = 1;
-            end--;
-        }
-        if (end[-1] == INSN_TO_LE(0xffffffff))
-        {
-            end--;
-            break_loop = TRUE;
-        }
-        if (end[-1] == INSN_TO_LE(0xfffffff1))
+        if (!remote)
+            ForgetLastUnit();
+#if EMU68_FLUSH_GENERATION && EMU68_BLOCK_CHAINING
+        else
         {
-            end--;
-            soft_break = TRUE;
+            __m68k_state->JIT_FLUSH_GEN++;
+#if EMU68_LAZY_RETUNE
+            jit_soft_flush_gen = __m68k_state->JIT_FLUSH_GEN;
+#endif
         }
-        if (end[-1] == INSN_TO_LE(0xfffffffe))
-        {
-            uint32_t *tmpptr;
-            uint32_t *branch_mod[10];
-            uint32_t branch_cnt;
-            int local_branch_done = 0;
-            end--;
-            end--;  /* Remove branch target (unused!) */
-            branch_cnt = *--end;
+#endif
+    }
 
-            for (unsigned i=0; i < branch_cnt; i++)
-            {
-                uintptr_t ptr = *(uint32_t *)--end;
-                ptr |= (uintptr_t)end & 0xffffffff00000000;
-                branch_mod[i] = (uint32_t *)ptr;
-            }
+    M68K_UnlockTranslator();
+}
+#else
+int M68K_HandleCodeWrite(uintptr_t fault_addr)
+{
+    (void)fault_addr;
+    return 0;
+}
 
-            tmpptr = end;
+void M68K_HostWrite(uintptr_t start, uintptr_t end, int remote)
+{
+    (void)start;
+    (void)end;
+    (void)remote;
+}
+#endif
 
-            conditionals_count++;
+/* Make the unit visible to the main loop */
+static void InstallUnit(struct M68KTranslationUnit *unit)
+{
+#if EMU68_SMC_PROTECT
+    unit->mt_Protected = ProtectUnitPages(unit);
+#if EMU68_UNIT_CRC_PAGES
+    if (unit->mt_Protected)
+        unit->mt_DirtyPages = 0;
+#endif
+#endif
+    ADDHEAD(&LRU, &unit->mt_LRUNode);
+    UnitTable_Insert(unit);
+    PageIndex_Insert(unit);
 
-            if (!local_branch_done)
-            {
-                end = EMIT_LocalExit(end, 0);
-            }
-            int distance = end - tmpptr;
+    Trace(TRACE_UNIT_TRANSLATED, (uint32_t)(uintptr_t)unit->mt_M68kAddress, unit->mt_Info->mi_M68kInsnCnt,
+        unit->mt_Info->mi_ARMInsnCnt, 0);
 
-            for (unsigned i=0; i < branch_cnt; i++) {
-                //kprintf("[ICache] Branch modification at %p : distance increase by %d\n", (void*) branch_mod[i], distance);
-                *(branch_mod[i]) = INSN_TO_LE((INSN_TO_LE(*(branch_mod[i])) + (distance << 5)));
-            }
-            epilogue_size += distance;
-        }
+    __m68k_state->JIT_UNIT_COUNT++;
+}
 
-        if (disasm)
-            disasm_print(in_code, insn_consumed, out_code, 4*(end - out_code), temporary_arm_code);
+#if EMU68_JIT_WORKER
+/*
+    Queue translation request for the worker. Requests are dropped if the queue is full, returns 1 if
+    the request was queued. With non-zero crc the unit is built only if the code has that checksum
+*/
+static int RequestTranslation(uint16_t *m68k_address, uint32_t tier, uint32_t crc)
+{
+    uint32_t head = request_head;
 
-        if (in_code > m68kcodeptr)
+    /* The worker reads code through the fast path of cache_read_16, keep it away from the cached region */
+    if ((uintptr_t)m68k_address < 0x01000000)
+        return 0;
+
+#if EMU68_M68K_MMU
+    /* Tables of the translated space are selected on the emulation core only */
+    if (m68k_mmu_enabled)
+        return 0;
+#endif
+
+    if (head - __atomic_load_n(&request_tail, __ATOMIC_ACQUIRE) >= EMU68_JIT_QUEUE_SIZE)
+        return 0;
+
+    request_ring[head & EMU68_JIT_QUEUE_MASK].tr_M68kAddress = m68k_address;
+    request_ring[head & EMU68_JIT_QUEUE_MASK].tr_Tier = tier;
+    request_ring[head & EMU68_JIT_QUEUE_MASK].tr_CRC32 = crc;
+
+    __atomic_store_n(&request_head, head + 1, __ATOMIC_RELEASE);
+    asm volatile("sev");
+
+    return 1;
+}
+
+/*
+    Put units built by the worker into the cache. Units built before the last cache
+    invalidation and units of code translated meanwhile by the emulation core are
+    released. A tier 1 unit replaces tier 0 translation of the same code.
+*/
+static void CollectTranslations()
+{
+    uint32_t tail = result_tail;
+
+    while (tail != __atomic_load_n(&result_head, __ATOMIC_ACQUIRE))
+    {
+        struct M68KTranslationUnit *unit = result_ring[tail & EMU68_JIT_QUEUE_MASK].tr_Unit;
+        uint32_t epoch = result_ring[tail & EMU68_JIT_QUEUE_MASK].tr_Epoch;
+        struct M68KTranslationUnit *old;
+
+        __atomic_store_n(&result_tail, ++tail, __ATOMIC_RELEASE);
+
+        old = UnitTable_Find(unit->mt_M68kAddress);
+
+        M68K_LockTranslator();
+
+        if (epoch != translation_epoch || (old != NULL && old->mt_Tier >= unit->mt_Tier))
         {
-            if (debug)
-                kprintf("[ICache]   Going backwards to location %08x\n", m68kcodeptr);
-            if (last_rev_jump == m68kcodeptr) {
-                if (--max_rev_jumps == 0) {
-                    if (debug)
-                        kprintf("[ICache] Going backwards to the same location oft enough. Loop candidate. Breaking here\n");
-                    break;
-                }
-            }
-            else {
-                last_rev_jump = m68kcodeptr;
-                max_rev_jumps = var_EMU68_MAX_LOOP_COUNT - 1;
-            }
+            M68K_ReleaseUnitCode(unit);
+            __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+            M68K_UnlockTranslator();
+            continue;
         }
 
-        if (!break_loop && (orig_m68kcodeptr == m68kcodeptr))
+        if (old != NULL)
         {
-            if (debug)
-                kprintf("[ICache]   Creating loop within translation unit\n");
-            
-            inner_loop = TRUE;
-            break;
+            JITStats_Release(JS_RELEASE_REPLACED, 1);
+            FreeUnit(old);
+            __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+            /* The old unit may be the one in x12 */
+            ForgetLastUnit();
+        }
+
+        if (__m68k_state->JIT_UNIT_COUNT >= (EMU68_UNIT_TABLE_SIZE * UNIT_LINE_SLOTS * 7) / 8)
+            EvictUnits(0);
+
+        M68K_UnlockTranslator();
+
+        /* Code was written from the other core */
+        asm volatile("isb");
+
+        InstallUnit(unit);
+
+        /* The m68k code might have changed before its pages got protected */
+        if (unit->mt_Protected && CalcCRC32(unit->mt_M68kLow, unit->mt_M68kHigh) != unit->mt_CRC32)
+        {
+            JITStats_Release(JS_RELEASE_CRC, 1);
+            M68K_FreeUnit(unit);
+            __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
         }
     }
-    uint32_t *out_code = end;
-    tmpptr = end;
-    RA_FlushFPURegs(&end);
-    RA_FlushM68kRegs(&end);
-    end = EMIT_FlushPC(end);
-    RA_FlushCC(&end);
-    RA_FlushFPCR(&end);
-    RA_FlushFPSR(&end);
+}
 
-    uint8_t tmp = RA_AllocARMRegister(&end);
-    uint8_t tmp2 = RA_AllocARMRegister(&end);
-    if (inner_loop)
+/* Units being translated now may contain outdated code, they will not be installed */
+void M68K_DiscardPendingUnits()
+{
+    __atomic_add_fetch(&translation_epoch, 1, __ATOMIC_RELEASE);
+}
+
+/*
+    Translation worker. Never returns. Requests below 16MB are ignored since code there
+    is read through the m68k cache model which belongs to the emulation core.
+*/
+void M68K_TranslationWorker()
+{
+    /* Secondary cores are started early, wait until the emulation core has set up the caches */
+    while (__atomic_load_n(&__m68k_state, __ATOMIC_ACQUIRE) == NULL)
+        asm volatile("yield");
+
+    M68K_LockTranslator();
+    worker_arm_code = tlsf_malloc(jit_tlsf, (JCCB_INSN_DEPTH_MASK + 1) * 16 * 64);
+    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+    M68K_UnlockTranslator();
+
+    if (worker_arm_code == NULL)
     {
-        uint8_t ctx = RA_GetCTX(&end);
-#ifdef PISTORM
-        //*end++ = mov_immed_u16(tmp2, 0xf220, 1);
-        //*end++ = ldr_offset(tmp2, tmp2, 0x34);;
-#endif
-        *end++ = ldr_offset(ctx, tmp2, __builtin_offsetof(struct M68KState, INT));
+        kprintf("[JIT] No memory for worker code buffer\n");
+        while(1) { asm volatile("wfe"); }
     }
-#if EMU68_INSN_COUNTER
+
+    kprintf("[JIT] Translation worker ready, code buffer at %p\n", worker_arm_code);
+
+    __atomic_store_n(&jit_worker_active, 1, __ATOMIC_RELEASE);
+
+    while(1)
     {
-        uint8_t tmp = RA_AllocARMRegister(&end);
-        *end++ = mov_immed_u16(tmp, insn_count & 0xffff, 0);
-        if (insn_count & 0xffff0000) {
-            *end++ = movk_immed_u16(tmp, insn_count >> 16, 1);
-        }
-        *end++ = fmov_from_reg(0, tmp);
-        *end++ = vadd_2d(30, 30, 0);
-        
-        if (val_FPIAR != 0xffffffff) {
-            *end++ = mov_immed_u16(tmp, val_FPIAR & 0xffff, 0);
-            *end++ = movk_immed_u16(tmp, val_FPIAR >> 16, 1);
-            *end++ = mov_reg_to_simd(29, TS_S, 1, tmp);
+        uint32_t tail = request_tail;
+
+        while (tail == __atomic_load_n(&request_head, __ATOMIC_ACQUIRE))
+            asm volatile("wfe");
+
+        uint16_t *m68k_address = request_ring[tail & EMU68_JIT_QUEUE_MASK].tr_M68kAddress;
+        uint32_t tier = request_ring[tail & EMU68_JIT_QUEUE_MASK].tr_Tier;
+        uint32_t crc = request_ring[tail & EMU68_JIT_QUEUE_MASK].tr_CRC32;
+
+        __atomic_store_n(&request_tail, tail + 1, __ATOMIC_RELEASE);
+
+        if ((uintptr_t)m68k_address < 0x01000000)
+            continue;
+
+        /* Results are consumed on cache misses only, do not build anything if nobody is collecting */
+        uint32_t head = result_head;
+        if (head - __atomic_load_n(&result_tail, __ATOMIC_ACQUIRE) >= EMU68_JIT_QUEUE_SIZE)
+            continue;
+
+        uint32_t epoch = __atomic_load_n(&translation_epoch, __ATOMIC_ACQUIRE);
+
+        M68K_LockTranslator();
+        uint32_t *saved_arm_code = temporary_arm_code;
+        temporary_arm_code = worker_arm_code;
+        struct M68KTranslationUnit *unit = BuildUnit(m68k_address, tier, 0, 0);
+        temporary_arm_code = saved_arm_code;
+
+        /* Code of the profiled entry is not there (yet) */
+        if (unit != NULL && crc != 0 && unit->mt_CRC32 != crc)
+        {
+            M68K_ReleaseUnitCode(unit);
+            unit = NULL;
         }
+        M68K_UnlockTranslator();
 
-        RA_FreeARMRegister(&end, tmp);
+        if (unit == NULL)
+            continue;
+
+        result_ring[head & EMU68_JIT_QUEUE_MASK].tr_Unit = unit;
+        result_ring[head & EMU68_JIT_QUEUE_MASK].tr_Epoch = epoch;
+
+        __atomic_store_n(&result_head, head + 1, __ATOMIC_RELEASE);
     }
-#endif
-    if (inner_loop)
-    {
-        uint32_t *tmpptr = end;
-#ifdef PISTORM
-        *end++ = cbz(tmp2, arm_code - tmpptr);
-        //*end++ = tbnz(tmp2, 25, arm_code - tmpptr);
+}
 #else
-        *end++ = cbz(tmp2, arm_code - tmpptr);
+void M68K_DiscardPendingUnits()
+{
+}
 #endif
-    }
-    *end++ = bx_lr();
-    
-    uint32_t *_tmpptr = end;
-    RA_FreeARMRegister(&end, tmp2);
-    RA_FreeARMRegister(&end, tmp);
-    RA_FlushCTX(&end);
-    end = _tmpptr;
-    
-    epilogue_size += end - tmpptr;
 
-    if (disasm) {
-        disasm_print((uint16_t *)0, 0, out_code, 4*(end - out_code), temporary_arm_code);
-        disasm_close();
-    }
+#if EMU68_ENTRY_PROFILE && EMU68_JIT_WORKER
+/* Hot entry recorded at warm reset */
+struct ProfileEntry {
+    uint32_t    pe_M68kAddress;
+    uint32_t    pe_CRC32;
+    uint8_t     pe_Tier;
+    uint8_t     pe_Requested;
+};
 
-    // Put a marker at the end of translation unit
-    *end++ = 0xffffffff;
+static struct ProfileEntry profile[EMU68_PROFILE_SIZE];
+static uint32_t profile_count;
 
-    if (reg_Load96)
-        RA_FreeARMRegister(NULL, reg_Load96);
-    
-    if (reg_Save96)
-        RA_FreeARMRegister(NULL, reg_Save96);
+/*
+    Remember hot units of RAM before they are released by warm reset. Applications loaded
+    again after the reset usually land at the same addresses, checksums tell if they did
+*/
+void M68K_RecordProfile()
+{
+    struct Node *n;
 
-    if (debug)
+    profile_count = 0;
+
+    ForeachNode(&LRU, n)
     {
-        kprintf("[ICache]   Translated %d M68k instructions to %d ARM instructions\n", insn_count, (int)(end - arm_code));
-        kprintf("[ICache]   Prologue size: %d, Epilogue size: %d, Conditionals: %d\n",
-            prologue_size, epilogue_size, conditionals_count);
-        kprintf("[ICache]   Mean epilogue size pro exit point: %d\n", epilogue_size / (1 + conditionals_count));
-        uint32_t mean = 100 * (end - arm_code - (prologue_size + epilogue_size));
-        mean = mean / insn_count;
-        uint32_t mean_n = mean / 100;
-        uint32_t mean_f = mean % 100;
-        kprintf("[ICache]   Mean ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        if (profile_count == EMU68_PROFILE_SIZE)
+            break;
+
+        if ((uintptr_t)u->mt_M68kAddress < 0x01000000 || M68K_IsROMUnit(u))
+            continue;
+
+        if (u->mt_Tier == 0 && u->mt_UseCount < EMU68_PROFILE_USES)
+            continue;
+
+        profile[profile_count].pe_M68kAddress = (uint32_t)(uintptr_t)u->mt_M68kAddress;
+        profile[profile_count].pe_CRC32 = u->mt_CRC32;
+        profile[profile_count].pe_Tier = u->mt_Tier;
+        profile[profile_count].pe_Requested = 0;
+        profile_count++;
     }
 
-    return (uintptr_t)end - (uintptr_t)arm_code;
+    kprintf("[JIT] Entry profile of %d units recorded\n", profile_count);
 }
 
-/*
-    Translate portion of m68k code into ARM. No new unit is created, instead
-    a raw pointer to ARM code is returned and instruction cache on host side is
-    invalidated
-*/
-void *M68K_TranslateNoCache(uint16_t *m68kcodeptr)
+/* Code near recorded entries runs, let the worker translate them ahead */
+static void RequestProfiled(uint16_t *m68kcodeptr)
 {
-    uintptr_t line_length = M68K_Translate(m68kcodeptr);
-    void *entry_point = (void*)temporary_arm_code;
-
-    entry_point = (void *)((uintptr_t)entry_point | 0x0000001000000000ULL);
+    uint32_t pc = (uint32_t)(uintptr_t)m68kcodeptr;
 
-    arm_flush_cache((uintptr_t)entry_point, line_length);
-    arm_icache_invalidate((intptr_t)entry_point, line_length);
+    for (uint32_t i=0; i < profile_count; i++)
+    {
+        struct ProfileEntry *e = &profile[i];
 
-    return entry_point;
-} 
+        if (e->pe_Requested || e->pe_M68kAddress - pc + EMU68_PROFILE_RANGE >= 2 * EMU68_PROFILE_RANGE)
+            continue;
 
-/*
-    Verify if the translated code has changed since the unit was created. In order
-    to do this MD5 sum of the block is compared with the previousy calculated one.
+        if (!RequestTranslation((uint16_t *)(uintptr_t)e->pe_M68kAddress, e->pe_Tier, e->pe_CRC32))
+            break;
 
-    If th sums are not same, the block is removed form LRU cache and hashtable and memory
-    is released.
+        e->pe_Requested = 1;
+    }
+}
+#else
+void M68K_RecordProfile()
+{
+}
+#endif
 
-    The function returns poitner to verified unit or NULL if the unit changed
+#if EMU68_TRANSLATE_AHEAD && EMU68_BLOCK_CHAINING
+/*
+    Translate targets of static exits of the unit built right now, they are most likely the next
+    misses. Targets are taken from chain_exits before it is overwritten by the translations below.
+    Nothing is evicted for them, translator lock must be held.
 */
-struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
+static void TranslateAhead(struct M68KTranslationUnit *unit)
 {
-    if (unit)
+    uint16_t *targets[EMU68_AHEAD_BUDGET];
+    uint32_t count = 0;
+
+    for (uint32_t i=0; i < chain_count && count < EMU68_AHEAD_BUDGET; i++)
     {
-        uint32_t crc = CalcCRC32(unit->mt_M68kLow, unit->mt_M68kHigh);
+        uint16_t *t = chain_exits[i].ce_M68kTarget;
+        uint32_t dup = 0;
 
-        if (crc != unit->mt_CRC32)
-        {
-            REMOVE(&unit->mt_LRUNode);
-            REMOVE(&unit->mt_HashNode);
-            tlsf_free(jit_tlsf, unit);
+        if (chain_exits[i].ce_Way != CHAIN_WAY_STATIC)
+            continue;
 
-            __m68k_state->JIT_UNIT_COUNT--;
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+        if ((uintptr_t)t + EMU68_AHEAD_RANGE < (uintptr_t)unit->mt_M68kLow ||
+            (uintptr_t)t >= (uintptr_t)unit->mt_M68kHigh + EMU68_AHEAD_RANGE)
+            continue;
 
-            unit = NULL;
-        }
+#if EMU68_JIT_WORKER
+        /* Requested from the worker already */
+        if (jit_worker_active && (uintptr_t)t >= 0x01000000)
+            continue;
+#endif
+
+        for (uint32_t j=0; j < count; j++)
+            dup |= targets[j] == t;
+
+        if (!dup && UnitTable_Find(t) == NULL)
+            targets[count++] = t;
     }
 
-    return unit;
+    for (uint32_t i=0; i < count; i++)
+    {
+        struct M68KTranslationUnit *u = BuildUnit(targets[i], 0, 0, 0);
+
+        if (u == NULL)
+            break;
+
+        InstallUnit(u);
+    }
 }
+#endif
 
 /*
     Get M68K code unit from the instruction cache. Return NULL if code was not found and needs to be
@@ -635,96 +4983,95 @@ struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
 
     If the code was found, update its position in the LRU cache.
 */
-struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
+static struct M68KTranslationUnit *GetTranslationUnit(uint16_t *m68kcodeptr, uint32_t tier)
 {
     struct M68KTranslationUnit *unit = NULL; //, *n;
     uintptr_t hash = (uintptr_t)m68kcodeptr;
-    uint16_t *orig_m68kcodeptr = m68kcodeptr;
     
     int debug = 0;
 
-    if ((uint32_t)(uintptr_t)m68kcodeptr >= debug_range_min && (uint32_t)(uintptr_t)m68kcodeptr <= debug_range_max) {
+    if (DebugActive((uint32_t)(uintptr_t)m68kcodeptr)) {
         debug = globalDebug();
     }
 
-    /* Get 16-bit has from the pointer to m68k code */
-    hash = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
+    /* Get home line of the unit in lookup table */
+    hash = UnitTable_Home(m68kcodeptr);
 
     if (debug > 2)
         kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Hash: 0x%04x\n", (void*)m68kcodeptr, (int)hash);
 
-    if (unit == NULL)
+#if EMU68_JIT_WORKER
+    /* The worker might have translated the code already */
+    if (jit_worker_active)
     {
-        uintptr_t line_length = M68K_Translate(m68kcodeptr);
-        uintptr_t arm_insn_count = line_length/4 - 1;
+        CollectTranslations();
 
-        uintptr_t unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+        unit = UnitTable_Find(m68kcodeptr);
+    }
+#endif
+#if EMU68_ENTRY_PROFILE && EMU68_JIT_WORKER
+    if (unit == NULL && jit_worker_active)
+        RequestProfiled(m68kcodeptr);
+#endif
 
-        do {
-            unit = tlsf_malloc_aligned(jit_tlsf, unit_length, 64);
+#if EMU68_FIRST_RUN
+    if (unit == NULL && tier == 0 && !debug)
+        unit = FirstRun(m68kcodeptr);
+#endif
 
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+#if EMU68_VICTIM_CACHE
+    /* Evicted before, a copy of the old translation is enough if the m68k code is the same */
+    if (unit == NULL && victim_cache_size != 0)
+    {
+        M68K_LockTranslator();
 
-            if (unit == NULL)
-            {
-                if (debug > 0) {
-                    kprintf("[ICache] Requested block was %d bytes long\n", unit_length);
-                }
+        unit = Victim_Restore(m68kcodeptr, tier, debug);
 
-                for (int i=0; i < 8; i++) {
-                    struct Node *n = REMTAIL(&LRU);
+        if (unit != NULL)
+        {
+            InstallUnit(unit);
 
-                    if (n == NULL)
-                        break;
+            __m68k_state->JIT_CACHE_MISS++;
+            __m68k_state->JIT_VICTIM_HIT++;
+        }
+
+        M68K_UnlockTranslator();
+    }
+#endif
+
+    if (unit == NULL)
+    {
+        M68K_LockTranslator();
+
+#if EMU68_BATCH_CODE_SYNC
+        code_sync_batch = 1;
+#endif
+        unit = BuildUnit(m68kcodeptr, tier, 1, debug);
+        InstallUnit(unit);
 
-                    void *ptr = (char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode);
-                    REMOVE((struct Node *)ptr);
-                    if (debug > 0)
-                    {    
-                        kprintf("[ICache] Run out of cache. Removing least recently used cache line node @ %p\n", ptr);
-                    }
-                    tlsf_free(jit_tlsf, ptr);
-                    __m68k_state->JIT_UNIT_COUNT--;
-                }
-                __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                
-                asm volatile("msr tpidr_el1, %0"::"r"(0xffffffff));
-            }
-        } while(unit == NULL);
-
-        unit->mt_ARMEntryPoint = &unit->mt_ARMCode[0];
-        unit->mt_ARMEntryPoint = (void *)((uintptr_t)unit->mt_ARMEntryPoint | 0x0000001000000000ULL);
-        unit->mt_M68kInsnCnt = insn_count;
-        unit->mt_ARMInsnCnt = arm_insn_count;
-        unit->mt_UseCount = 0;
-        unit->mt_FetchCount = 0;
-        unit->mt_M68kAddress = orig_m68kcodeptr;
-        unit->mt_M68kLow = m68k_low;
-        unit->mt_M68kHigh = m68k_high;
-        unit->mt_CRC32 = CalcCRC32(m68k_low, m68k_high);
-        unit->mt_PrologueSize = prologue_size;
-        unit->mt_EpilogueSize = epilogue_size;
-        unit->mt_Conditionals = conditionals_count;
-        DuffCopy(&unit->mt_ARMCode[0], temporary_arm_code, line_length/4);
-
-        ADDHEAD(&LRU, &unit->mt_LRUNode);
-        ADDHEAD(&ICache[hash], &unit->mt_HashNode);
-
-        __m68k_state->JIT_UNIT_COUNT++;
         __m68k_state->JIT_CACHE_MISS++;
 
+#if EMU68_JIT_WORKER && EMU68_BLOCK_CHAINING
+        /* Static exits will most likely be taken soon, let the worker translate their targets */
+        if (jit_worker_active)
+        {
+            for (uint32_t i=0; i < chain_count; i++)
+            {
+                if (chain_exits[i].ce_Way == CHAIN_WAY_STATIC && UnitTable_Find(chain_exits[i].ce_M68kTarget) == NULL)
+                    RequestTranslation(chain_exits[i].ce_M68kTarget, 0, 0);
+            }
+        }
+#endif
+
         if (debug) {
             kprintf("[ICache]   Block checksum: %08x\n", unit->mt_CRC32);
             kprintf("[ICache]   ARM code at %p\n", unit->mt_ARMEntryPoint);
         }
 
-        arm_flush_cache((uintptr_t)&unit->mt_ARMCode, line_length);
-        arm_icache_invalidate((intptr_t)unit->mt_ARMEntryPoint, line_length);
-
         if (debug)
         {
             kprintf("-- ARM Code dump --\n");
-            for (uint32_t i=0; i < unit->mt_ARMInsnCnt; i++)
+            for (uint32_t i=0; i < unit->mt_Info->mi_ARMInsnCnt; i++)
             {
                 if ((i % 5) == 0)
                     kprintf("   ");
@@ -733,7 +5080,7 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
                 if ((i % 5) == 4)
                     kprintf("\n");
             }
-            if (unit->mt_ARMInsnCnt % 5 != 0)
+            if (unit->mt_Info->mi_ARMInsnCnt % 5 != 0)
                 kprintf("\n");
             if (debug > 3)
             {
@@ -751,6 +5098,16 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
                 }
             }
         }
+
+#if EMU68_TRANSLATE_AHEAD && EMU68_BLOCK_CHAINING
+        if (__m68k_state->JIT_CONTROL2 & JC2F_TRANSLATE_AHEAD)
+            TranslateAhead(unit);
+#endif
+
+#if EMU68_BATCH_CODE_SYNC
+        SyncBatchEnd();
+#endif
+        M68K_UnlockTranslator();
     }
 
     //asm volatile ("prfm plil1keep, [%0]"::"r"(unit->mt_ARMEntryPoint));
@@ -758,6 +5115,139 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
     return unit;
 }
 
+struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
+{
+    return GetTranslationUnit(m68kcodeptr, 0);
+}
+
+/*
+    Replace hot tier 0 unit with its tier 1 translation. Chains leading to the old unit
+    are broken and will be restored to the new one by the main loop. With the worker
+    running, the tier 0 unit stays in place until the worker delivers its replacement.
+*/
+struct M68KTranslationUnit *M68K_PromoteUnit(struct M68KTranslationUnit *unit)
+{
+    uint16_t *m68k_pc = unit->mt_M68kAddress;
+
+    if (DebugActive((uint32_t)(uintptr_t)m68k_pc) && globalDebug())
+        kprintf("[ICache] Promoting unit %p (m68k code @ %p) to tier 1\n", unit, m68k_pc);
+
+#if EMU68_SUPERBLOCKS && EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    Superblock_Promoted(unit);
+#endif
+#if EMU68_ADAPTIVE_DEPTH && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    DepthHint_Promoted(unit);
+#endif
+#if EMU68_BRANCH_PROFILE && EMU68_TIERED_JIT && EMU68_BLOCK_CHAINING
+    BranchHint_Promoted(unit);
+#endif
+
+#if EMU68_JIT_WORKER
+    if (jit_worker_active && (uintptr_t)m68k_pc >= 0x01000000)
+    {
+        /* Count again, if the request is lost the unit asks for promotion once more */
+        unit->mt_TierCount = EMU68_TIER_THRESHOLD;
+        RequestTranslation(m68k_pc, 1, 0);
+        CollectTranslations();
+
+        return UnitTable_Find(m68k_pc);
+    }
+#endif
+
+    JITStats_Release(JS_RELEASE_REPLACED, 1);
+    M68K_FreeUnit(unit);
+    __m68k_state->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+    return GetTranslationUnit(m68k_pc, 1);
+}
+
+#if EMU68_KEEP_ROM_UNITS
+struct ROMRange {
+    uintptr_t   rr_Low;
+    uintptr_t   rr_High;
+};
+
+static struct ROMRange rom_ranges[EMU68_MAX_ROM_RANGES];
+static int rom_range_count;
+#endif
+
+/* Register m68k address range backed by read-only copy of the ROM */
+void M68K_AddROMRange(uint32_t base, uint32_t size)
+{
+#if EMU68_KEEP_ROM_UNITS
+    if (rom_range_count == EMU68_MAX_ROM_RANGES)
+        return;
+
+    kprintf("[ICache] ROM range %08x-%08x, translations kept across cache flushes\n", base, base + size - 1);
+
+    rom_ranges[rom_range_count].rr_Low = base;
+    rom_ranges[rom_range_count].rr_High = base + size;
+    rom_range_count++;
+#else
+    (void)base;
+    (void)size;
+#endif
+}
+
+/*
+    Check if the unit was translated from ROM only. The upper bound of the unit includes the
+    words the translator reads past the last instruction, a unit too close to the end of ROM
+    is not kept, as its range reaches into the memory behind
+*/
+static int IsROMRange(uintptr_t low, uintptr_t high)
+{
+#if EMU68_KEEP_ROM_UNITS
+    for (int i=0; i < rom_range_count; i++)
+    {
+        if (low >= rom_ranges[i].rr_Low && high <= rom_ranges[i].rr_High)
+            return 1;
+    }
+#else
+    (void)low;
+    (void)high;
+#endif
+    return 0;
+}
+
+/*
+    Resolve the region the opcodes of a unit are fetched from. With the instruction cache bypassed
+    all of it is read from memory, otherwise fast RAM and the ROM range holding the unit start.
+    Words past its end, e.g. a branch followed into chip RAM, still go through the cache.
+*/
+static void FetchSetup(uint32_t address)
+{
+    if (cache_bypassed(ICACHE))
+    {
+        cache_fetch_setup(0, 0xffffffff);
+        return;
+    }
+
+#if EMU68_KEEP_ROM_UNITS
+    for (int i=0; i < rom_range_count; i++)
+    {
+        if (address >= rom_ranges[i].rr_Low && address < rom_ranges[i].rr_High)
+        {
+            cache_fetch_setup(rom_ranges[i].rr_Low, rom_ranges[i].rr_High - rom_ranges[i].rr_Low);
+            return;
+        }
+    }
+#endif
+
+    cache_fetch_setup(0x01000000, 0xff000000);
+}
+
+/* Check if the code lies in a read-only copy of the ROM */
+int M68K_IsROMCode(uint16_t *address)
+{
+    return IsROMRange((uintptr_t)address, (uintptr_t)address);
+}
+
+/* Units are tagged when built, the ROM ranges are known before the emulation starts */
+int M68K_IsROMUnit(struct M68KTranslationUnit *unit)
+{
+    return unit->mt_Immutable;
+}
+
 void M68K_InitializeCache()
 {
     kprintf("[ICache] Initializing caches\n");
@@ -767,14 +5257,16 @@ void M68K_InitializeCache()
 
     kprintf("[ICache] Setting up ICache\n");
 
-    temporary_arm_code = tlsf_malloc(jit_tlsf, (JCCB_INSN_DEPTH_MASK + 1) * 16 * 64);
-    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-    kprintf("[ICache] Temporary code at %p\n", temporary_arm_code);
-    local_state = tlsf_malloc(tlsf, sizeof(struct M68KLocalState)*(JCCB_INSN_DEPTH_MASK + 1)*2);
-    kprintf("[ICache] ICache array at %p\n", ICache);
+#if EMU68_CODE_ARENA
+    Arena_Init();
+#endif
+    UnitInfo_Init();
+#if EMU68_VICTIM_CACHE
+    Victim_Init();
+#endif
+    kprintf("[ICache] Unit table at %p\n", UnitTable);
 
-    for (int i=0; i < 65536; i++)
-        NEWLIST(&ICache[i]);
+    M68K_ResetUnitTable();
 }
 
 void M68K_DumpStats()
@@ -797,14 +5289,22 @@ void M68K_DumpStats()
             kprintf("[ICache]   Unit %p, mt_UseCount=%lld, mt_FetchCount=%lld, M68K address %08x (range %08x-%08x)\n[ICache]      M68K insn count=%d, ARM insn count=%d\n", 
                 (void*)unit, unit->mt_UseCount, unit->mt_FetchCount,
                 (void*)unit->mt_M68kAddress, (void*)unit->mt_M68kLow, (void*)unit->mt_M68kHigh, 
-                unit->mt_M68kInsnCnt, unit->mt_ARMInsnCnt);
+                unit->mt_Info->mi_M68kInsnCnt, unit->mt_Info->mi_ARMInsnCnt);
 
-        size = size + (uintptr_t)(&unit->mt_ARMCode[unit->mt_ARMInsnCnt]) - (uintptr_t)unit;
-        m68k_count += unit->mt_M68kInsnCnt;
-        total_arm_count += unit->mt_ARMInsnCnt;
-        arm_count += unit->mt_ARMInsnCnt - (unit->mt_PrologueSize + unit->mt_EpilogueSize);
+        size = size + (uintptr_t)(&unit->mt_ARMCode[unit->mt_Info->mi_ARMInsnCnt]) - (uintptr_t)unit;
+        m68k_count += unit->mt_Info->mi_M68kInsnCnt;
+        total_arm_count += unit->mt_Info->mi_ARMInsnCnt;
+        arm_count += unit->mt_Info->mi_ARMInsnCnt - (unit->mt_Info->mi_PrologueSize + unit->mt_Info->mi_EpilogueSize);
     }
     kprintf("[ICache] In total %d units (%d bytes) in cache\n", cnt, size);
+#if EMU68_VICTIM_CACHE
+    kprintf("[ICache] Victim cache: %d units saved, %d restored\n", victim_saved, __m68k_state->JIT_VICTIM_HIT);
+#endif
+
+#if EMU68_PMU_PROFILE
+    PMU_Dump();
+#endif
+    JITStats_Dump();
 
     uint32_t mean = 100 * (arm_count);
     mean = mean / m68k_count;
@@ -817,8 +5317,159 @@ void M68K_DumpStats()
     mean_n = mean / 100;
     mean_f = mean % 100;
     kprintf("[ICache] Mean total ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+
+    if (debug)
+        Trace_Dump();
+}
+
+#if EMU68_JIT_EXPORT
+/*
+    Snapshot of the JIT cache for tools/jitexport, written to the console as lines of hex
+    digits. The stream is a header followed by one record per unit, numbers are big endian
+    and ARM code is kept in instruction byte order. The END line gives length and CRC32 of
+    the stream, console lines of other cores may come in between and are skipped by the tool.
+
+    Header:  "E68J", version, number of units, lowest use count
+    Unit:    size of the rest of record, m68k entry, low and high address, tier, m68k and ARM
+             instruction count, prologue and epilogue size, number of exits, use and fetch
+             count (64 bit), ARM address (64 bit), size of PC map, ARM code, PC map padded
+             to 4 bytes
+*/
+#define JIT_EXPORT_VERSION  1
+#define JIT_EXPORT_LINE     32
+
+uint32_t jit_export_count;
+
+static struct {
+    uint32_t    je_CRC;
+    uint32_t    je_Size;
+    uint32_t    je_Fill;
+    uint8_t     je_Line[JIT_EXPORT_LINE];
+} jit_export;
+
+static void ExportFlush()
+{
+    static const char hex[] = "0123456789abcdef";
+    char text[2 * JIT_EXPORT_LINE + 1];
+
+    if (jit_export.je_Fill == 0)
+        return;
+
+    for (uint32_t i=0; i < jit_export.je_Fill; i++)
+    {
+        text[2*i] = hex[jit_export.je_Line[i] >> 4];
+        text[2*i + 1] = hex[jit_export.je_Line[i] & 15];
+    }
+    text[2 * jit_export.je_Fill] = 0;
+
+    kprintf("[JITX] %s\n", text);
+    jit_export.je_Fill = 0;
+}
+
+static void ExportByte(uint8_t b)
+{
+    uint32_t crc = jit_export.je_CRC;
+
+    asm volatile("crc32b %w0, %w0, %w2":"=r"(crc):"0"(crc),"r"(b));
+
+    jit_export.je_CRC = crc;
+    jit_export.je_Size++;
+    jit_export.je_Line[jit_export.je_Fill++] = b;
+
+    if (jit_export.je_Fill == JIT_EXPORT_LINE)
+        ExportFlush();
 }
 
+static void Export32(uint32_t v)
+{
+    ExportByte(v >> 24);
+    ExportByte(v >> 16);
+    ExportByte(v >> 8);
+    ExportByte(v);
+}
+
+static void Export64(uint64_t v)
+{
+    Export32(v >> 32);
+    Export32(v);
+}
+
+/*
+    Write the snapshot of all units used at least min_uses times. Called from translated
+    code by MOVEC to JITEXPORT, the translator lock keeps the worker away meanwhile
+*/
+void M68K_ExportUnits(uint32_t min_uses)
+{
+    struct Node *n;
+    uint32_t count = 0;
+
+    M68K_LockTranslator();
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *unit = (void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        if (unit->mt_UseCount >= min_uses)
+            count++;
+    }
+
+    kprintf("[JITX] BEGIN %d units\n", count);
+
+    jit_export.je_CRC = 0xffffffff;
+    jit_export.je_Size = 0;
+    jit_export.je_Fill = 0;
+
+    ExportByte('E'); ExportByte('6'); ExportByte('8'); ExportByte('J');
+    Export32(JIT_EXPORT_VERSION);
+    Export32(count);
+    Export32(min_uses);
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *unit = (void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        struct M68KUnitInfo *info = unit->mt_Info;
+        uint32_t map_size = info->mi_PCMapSize;
+
+        if (unit->mt_UseCount < min_uses)
+            continue;
+
+        Export32(64 + 4 * info->mi_ARMInsnCnt + ((map_size + 3) & ~3));
+        Export32((uint32_t)(uintptr_t)unit->mt_M68kAddress);
+        Export32((uint32_t)(uintptr_t)unit->mt_M68kLow);
+        Export32((uint32_t)(uintptr_t)unit->mt_M68kHigh);
+        Export32(unit->mt_Tier);
+        Export32(info->mi_M68kInsnCnt);
+        Export32(info->mi_ARMInsnCnt);
+        Export32(info->mi_PrologueSize);
+        Export32(info->mi_EpilogueSize);
+        Export32(info->mi_Conditionals + 1);
+        Export64(unit->mt_UseCount);
+        Export64(unit->mt_FetchCount);
+        Export64((uintptr_t)unit->mt_ARMEntryPoint);
+        Export32(map_size);
+
+        for (uint32_t i=0; i < info->mi_ARMInsnCnt; i++)
+        {
+            uint32_t insn = INSN_TO_LE(unit->mt_ARMCode[i]);
+
+            ExportByte(insn);
+            ExportByte(insn >> 8);
+            ExportByte(insn >> 16);
+            ExportByte(insn >> 24);
+        }
+
+        for (uint32_t i=0; i < ((map_size + 3) & ~3); i++)
+            ExportByte(i < map_size ? info->mi_PCMap[i] : 0);
+    }
+
+    M68K_UnlockTranslator();
+
+    ExportFlush();
+    kprintf("[JITX] END %d bytes crc %08x\n", jit_export.je_Size, jit_export.je_CRC);
+
+    jit_export_count = count;
+}
+#endif
+
 uint32_t *EMIT_InjectPrintContext(uint32_t *ptr)
 {
     extern void M68K_PrintContext(void*);
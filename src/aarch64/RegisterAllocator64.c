@@ -14,6 +14,8 @@
 
 static uint16_t register_pool = 0;
 static uint16_t changed_mask = 0;
+static uint8_t loaded_mask = 0;
+static uint8_t alloc_peak = 0;
 static uint8_t fpu_allocstate;
 
 void RA_ResetFPUAllocator()
@@ -165,6 +167,7 @@ static uint8_t reg_FPCR = 0xff;
 static uint8_t mod_FPCR = 0;
 static uint8_t reg_FPSR = 0xff;
 static uint8_t mod_FPSR = 0;
+static uint8_t lazy_FPSR = 0xff;
 
 uint8_t RA_TryCTX(uint32_t **ptr)
 {
@@ -179,6 +182,7 @@ uint8_t RA_GetCTX(uint32_t **ptr)
         reg_CTX = RA_AllocARMRegister(ptr);
         **ptr = mrs(reg_CTX, 3, 3, 13, 0, 3);
         (*ptr)++;
+        loaded_mask |= RA_VAL_CTX;
     }
 
     return reg_CTX;
@@ -194,6 +198,79 @@ void RA_FlushCTX(uint32_t **ptr)
     reg_CTX = 0xff;
 }
 
+static uint8_t reg_Base = 0xff;
+static uint32_t base_Candidate = 0xffffffff;
+#if EMU68_CONST_BASE
+static uint32_t base_Address;
+#endif
+
+/*
+    Get register holding the 4K page of an absolute address, the offset within the page is
+    returned in *offset. The register is bound on second use of the same page and is never
+    rebound nor released before RA_FlushConstBase at the end of translation, because every
+    code emitted after the binding, including loop heads reached backwards, relies on it.
+    Returns 0xff if the address has to be built from scratch.
+*/
+uint8_t RA_GetConstBase(uint32_t **ptr, uint32_t address, int32_t *offset)
+{
+#if EMU68_CONST_BASE
+    uint32_t page = address & ~0xfff;
+
+    if (reg_Base == 0xff)
+    {
+        if (page != base_Candidate)
+        {
+            base_Candidate = page;
+            return 0xff;
+        }
+
+        if (__builtin_popcount(~(register_pool | 15) & 0xfff) < EMU68_CONST_BASE_MIN_FREE)
+            return 0xff;
+
+        reg_Base = RA_AllocARMRegister(ptr);
+        base_Address = page;
+
+        if (page == 0)
+            **ptr = mov_reg(reg_Base, 31);
+        else if (page & 0xffff)
+        {
+            **ptr = movw_immed_u16(reg_Base, page & 0xffff);
+            if (page >> 16)
+            {
+                (*ptr)++;
+                **ptr = movt_immed_u16(reg_Base, page >> 16);
+            }
+        }
+        else
+            **ptr = mov_immed_u16(reg_Base, page >> 16, 1);
+        (*ptr)++;
+    }
+
+    if (page == base_Address)
+    {
+        *offset = address - page;
+        return reg_Base;
+    }
+#else
+    (void)ptr;
+    (void)address;
+    (void)offset;
+#endif
+
+    return 0xff;
+}
+
+void RA_FlushConstBase(uint32_t **ptr)
+{
+    if (reg_Base != 0xff)
+    {
+        RA_FreeARMRegister(ptr, reg_Base);
+    }
+
+    reg_Base = 0xff;
+    base_Candidate = 0xffffffff;
+}
+
 uint8_t RA_GetFPCR(uint32_t **ptr)
 {
     if (reg_FPCR == 0xff)
@@ -203,6 +280,7 @@ uint8_t RA_GetFPCR(uint32_t **ptr)
         **ptr = mov_simd_to_reg(reg_FPCR, 29, TS_H, 4);
         (*ptr)++;
         mod_FPCR = 0;
+        loaded_mask |= RA_VAL_FPCR;
     }
 
     return reg_FPCR;
@@ -239,8 +317,21 @@ void RA_FlushFPCR(uint32_t **ptr)
     mod_FPCR = 0;
 }
 
+/* Set condition codes in fpsr from the value of FPU register fp */
+static void EmitFPSRResult(uint32_t **ptr, uint8_t fpsr, uint8_t fp)
+{
+    **ptr = fcmpzd(fp);
+    (*ptr)++;
+    *ptr = EMIT_GetFPUFlags(*ptr, fpsr);
+}
+
 uint8_t RA_GetFPSR(uint32_t **ptr)
 {
+    /* Taken first, allocation of the register may flush FPSR */
+    uint8_t fp = lazy_FPSR;
+
+    lazy_FPSR = 0xff;
+
     if (reg_FPSR == 0xff)
     {
         reg_FPSR = RA_AllocARMRegister(ptr);
@@ -248,11 +339,50 @@ uint8_t RA_GetFPSR(uint32_t **ptr)
         **ptr = mov_simd_to_reg(reg_FPSR, 29, TS_S, 0);
         (*ptr)++;
         mod_FPSR = 0;
+        loaded_mask |= RA_VAL_FPSR;
+    }
+
+    if (fp != 0xff)
+    {
+        mod_FPSR = 1;
+        EmitFPSRResult(ptr, reg_FPSR, fp);
     }
 
     return reg_FPSR;
 }
 
+/*
+    Condition codes of FPSR follow from the result left in FPU register fp. If it is one of
+    FP0-FP7, which no code changes behind the back of the translator, the codes are computed
+    only once FPSR is actually read, stored at an exit or flushed.
+*/
+void RA_SetFPSRResult(uint32_t **ptr, uint8_t fp)
+{
+#if EMU68_LAZY_FPSR
+    if (fp >= 8 && fp < 16)
+    {
+        lazy_FPSR = fp;
+        return;
+    }
+#endif
+
+    lazy_FPSR = 0xff;
+    EmitFPSRResult(ptr, RA_ModifyFPSR(ptr), fp);
+}
+
+/* Compute pending condition codes now, before the FPU register holding the result changes */
+void RA_ResolveFPSR(uint32_t **ptr)
+{
+    if (lazy_FPSR != 0xff)
+        RA_GetFPSR(ptr);
+}
+
+/* FPSR is about to be overwritten as a whole, pending condition codes are not needed */
+void RA_DiscardFPSRResult()
+{
+    lazy_FPSR = 0xff;
+}
+
 uint8_t RA_ModifyFPSR(uint32_t **ptr)
 {
     uint8_t fpsr = RA_GetFPSR(ptr);
@@ -262,7 +392,29 @@ uint8_t RA_ModifyFPSR(uint32_t **ptr)
 
 void RA_StoreFPSR(uint32_t **ptr)
 {
-    if (reg_FPSR != 0xff && mod_FPSR)
+    /*
+        Exit path. Resolve pending condition codes for it, but keep them pending for the code
+        which follows. Computing them once more later gives the same result
+    */
+    if (lazy_FPSR != 0xff)
+    {
+        uint8_t fpsr = reg_FPSR;
+
+        if (fpsr == 0xff)
+        {
+            fpsr = RA_AllocARMRegister(ptr);
+            **ptr = mov_simd_to_reg(fpsr, 29, TS_S, 0);
+            (*ptr)++;
+        }
+
+        EmitFPSRResult(ptr, fpsr, lazy_FPSR);
+        **ptr = mov_reg_to_simd(29, TS_S, 0, fpsr);
+        (*ptr)++;
+
+        if (reg_FPSR == 0xff)
+            RA_FreeARMRegister(ptr, fpsr);
+    }
+    else if (reg_FPSR != 0xff && mod_FPSR)
     {
         **ptr = mov_reg_to_simd(29, TS_S, 0, reg_FPSR);
         (*ptr)++;
@@ -271,6 +423,8 @@ void RA_StoreFPSR(uint32_t **ptr)
 
 void RA_FlushFPSR(uint32_t **ptr)
 {
+    RA_ResolveFPSR(ptr);
+
     if (reg_FPSR != 0xff)
     {
         if (mod_FPSR)
@@ -297,6 +451,7 @@ uint8_t RA_GetCC(uint32_t **ptr)
         *p++ = mrs(reg_CC, 3, 3, 13, 0, 2);
         *ptr = p;
         mod_CC = 0;
+        loaded_mask |= RA_VAL_CC;
     }
 
     return reg_CC;
@@ -350,14 +505,285 @@ int RA_IsCCModified()
     return (mod_CC != 0);
 }
 
+/* Values which are currently kept in registers */
+uint8_t RA_GetHeldMask()
+{
+    uint8_t mask = 0;
+
+    if (reg_CTX != 0xff)
+        mask |= RA_VAL_CTX;
+    if (reg_CC != 0xff)
+        mask |= RA_VAL_CC;
+    if (reg_FPCR != 0xff)
+        mask |= RA_VAL_FPCR;
+    if (reg_FPSR != 0xff)
+        mask |= RA_VAL_FPSR;
+
+    return mask;
+}
+
+/* Values loaded and most temporary registers in use at once since RA_ClearLoadedMask */
+uint8_t RA_GetLoadedMask()
+{
+    return loaded_mask;
+}
+
+uint8_t RA_GetAllocPeak()
+{
+    return alloc_peak;
+}
+
+void RA_ClearLoadedMask()
+{
+    loaded_mask = 0;
+    alloc_peak = __builtin_popcount(register_pool);
+}
+
+#if EMU68_CONST_CACHE
+/*
+    Constants left in temporary registers after they were freed. An entry is made pending when
+    the constant is loaded or reused by an instruction and becomes valid at the end of it, if
+    the code of the instruction neither changed the register nor could leave the straight line
+    (branches, calls, exits). Temporaries are allocated from registers without a constant first.
+*/
+static uint16_t const_valid;
+static uint16_t const_pending;
+static uint32_t const_value[12];
+static uint32_t *const_def[12];
+static uint32_t *const_window;
+
+#if EMU68_FPU_CONST_CACHE
+/*
+    FPU constants are kept in v16-v23, which are not used by any other JIT code. Helper calls
+    clobber them but are barriers anyway, so an entry is valid until the straight line is left.
+*/
+#define FPU_CONST_FIRST         16
+#define FPU_CONST_COUNT         8
+
+static uint8_t fpu_const_valid;
+static uint8_t fpu_const_pending;
+static uint8_t fpu_const_next;
+static uint64_t fpu_const_value[FPU_CONST_COUNT];
+#endif
+
+/* Code which may transfer control or is not an instruction at all */
+static inline int IsBarrier(uint32_t insn)
+{
+    if ((insn & 0xfffffff0) == 0xfffffff0)
+        return 1;
+    if ((insn & 0x1c000000) == 0x14000000 && (insn & 0xffc00000) != 0xd5000000)
+        return 1;
+    if ((insn & 0x18000000) == 0)
+        return 1;
+
+    return 0;
+}
+
+/* Conservative test if the instruction may write the register */
+static inline int MayWrite(uint32_t insn, uint8_t reg)
+{
+    if ((insn & 31) == reg)
+        return 1;
+
+    /* Loads and stores, pairs, writeback of the base and status registers of atomics */
+    if ((insn & 0x0a000000) == 0x08000000)
+    {
+        if (((insn >> 5) & 31) == reg || ((insn >> 10) & 31) == reg || ((insn >> 16) & 31) == reg)
+            return 1;
+    }
+
+    return 0;
+}
+
+void RA_ResetConstCache()
+{
+    const_valid = 0;
+    const_pending = 0;
+    const_window = NULL;
+#if EMU68_FPU_CONST_CACHE
+    fpu_const_valid = 0;
+    fpu_const_pending = 0;
+    fpu_const_next = 0;
+#endif
+}
+
+/* Start of code emitted for next m68k instruction */
+void RA_BeginConstWindow(uint32_t *start)
+{
+    const_window = start;
+}
+
+/* End of code emitted for m68k instruction, validate constants loaded or used by it */
+void RA_CommitConstWindow(uint32_t *start, uint32_t *end)
+{
+    for (uint32_t *p = start; p < end; p++)
+    {
+        if (IsBarrier(INSN_TO_LE(*p)))
+        {
+            const_valid = 0;
+            const_pending = 0;
+#if EMU68_FPU_CONST_CACHE
+            fpu_const_valid = 0;
+            fpu_const_pending = 0;
+#endif
+            return;
+        }
+    }
+
+#if EMU68_FPU_CONST_CACHE
+    fpu_const_valid |= fpu_const_pending;
+    fpu_const_pending = 0;
+#endif
+
+    while (const_pending)
+    {
+        uint8_t reg = __builtin_ctz(const_pending);
+        int ok = 1;
+
+        const_pending &= ~(1 << reg);
+
+        for (uint32_t *p = const_def[reg]; p < end; p++)
+        {
+            if (MayWrite(INSN_TO_LE(*p), reg))
+            {
+                ok = 0;
+                break;
+            }
+        }
+
+        /* Register still allocated by someone is not a cache entry */
+        if (ok && (register_pool & (1 << reg)) == 0)
+            const_valid |= 1 << reg;
+    }
+}
+
+/* Get register which already holds the constant, 0xff if there is none */
+uint8_t RA_GetCachedConst(uint32_t **ptr, uint32_t value)
+{
+    uint16_t mask = const_valid & ~register_pool;
+
+    while (mask)
+    {
+        uint8_t reg = __builtin_ctz(mask);
+        mask &= ~(1 << reg);
+
+        if (const_value[reg] != value)
+            continue;
+
+        /* Code emitted so far for this instruction must not leave the straight line */
+        for (uint32_t *p = const_window; p && p < *ptr; p++)
+        {
+            if (IsBarrier(INSN_TO_LE(*p)))
+            {
+                const_valid = 0;
+                return 0xff;
+            }
+        }
+
+        register_pool |= 1 << reg;
+        changed_mask |= 1 << reg;
+        if (__builtin_popcount(register_pool) > alloc_peak)
+            alloc_peak = __builtin_popcount(register_pool);
+
+        const_valid &= ~(1 << reg);
+        const_pending |= 1 << reg;
+        const_def[reg] = *ptr;
+
+        return reg;
+    }
+
+    return 0xff;
+}
+
+/* Constant was just loaded into allocated register */
+void RA_SetCachedConst(uint32_t **ptr, uint8_t reg, uint32_t value)
+{
+    if (reg < 4 || reg > 11)
+        return;
+
+    const_value[reg] = value;
+    const_def[reg] = *ptr;
+    const_valid &= ~(1 << reg);
+    const_pending |= 1 << reg;
+}
+
+#if EMU68_FPU_CONST_CACHE
+/* Get FPU register holding the double with given bit pattern, 0xff if there is none */
+uint8_t RA_GetCachedFPUConst(uint32_t **ptr, uint64_t value)
+{
+    uint8_t mask = fpu_const_valid | fpu_const_pending;
+
+    while (mask)
+    {
+        uint8_t slot = __builtin_ctz(mask);
+        mask &= ~(1 << slot);
+
+        if (fpu_const_value[slot] != value)
+            continue;
+
+        for (uint32_t *p = const_window; p && p < *ptr; p++)
+        {
+            if (IsBarrier(INSN_TO_LE(*p)))
+            {
+                fpu_const_valid = 0;
+                fpu_const_pending = 0;
+                return 0xff;
+            }
+        }
+
+        return FPU_CONST_FIRST + slot;
+    }
+
+    return 0xff;
+}
+
+/* Double was just loaded into FPU register, keep a copy of it */
+void RA_SetCachedFPUConst(uint32_t **ptr, uint8_t reg, uint64_t value)
+{
+    uint8_t free = ~(fpu_const_valid | fpu_const_pending);
+    uint8_t slot = free ? __builtin_ctz(free) : fpu_const_next++ % FPU_CONST_COUNT;
+
+    *(*ptr)++ = fcpyd(FPU_CONST_FIRST + slot, reg);
+
+    fpu_const_value[slot] = value;
+    fpu_const_valid &= ~(1 << slot);
+    fpu_const_pending |= 1 << slot;
+}
+#else
+uint8_t RA_GetCachedFPUConst(uint32_t **ptr, uint64_t value) { (void)ptr; (void)value; return 0xff; }
+void RA_SetCachedFPUConst(uint32_t **ptr, uint8_t reg, uint64_t value) { (void)ptr; (void)reg; (void)value; }
+#endif
+#else
+void RA_ResetConstCache() {}
+void RA_BeginConstWindow(uint32_t *start) { (void)start; }
+void RA_CommitConstWindow(uint32_t *start, uint32_t *end) { (void)start; (void)end; }
+uint8_t RA_GetCachedConst(uint32_t **ptr, uint32_t value) { (void)ptr; (void)value; return 0xff; }
+void RA_SetCachedConst(uint32_t **ptr, uint8_t reg, uint32_t value) { (void)ptr; (void)reg; (void)value; }
+uint8_t RA_GetCachedFPUConst(uint32_t **ptr, uint64_t value) { (void)ptr; (void)value; return 0xff; }
+void RA_SetCachedFPUConst(uint32_t **ptr, uint8_t reg, uint64_t value) { (void)ptr; (void)reg; (void)value; }
+#endif
+
 /* Allocate register x0-x11 for JIT */
 static uint8_t __int_arm_alloc_reg()
 {
     int reg = __builtin_ctz(~(register_pool | 15));
 
+#if EMU68_CONST_CACHE
+    /* Prefer registers not holding a constant */
+    uint16_t cached = (const_valid | const_pending) & 0xfff;
+
+    if ((~(register_pool | 15 | cached) & 0xfff) != 0)
+        reg = __builtin_ctz(~(register_pool | 15 | cached));
+
+    const_valid &= ~(1 << reg);
+    const_pending &= ~(1 << reg);
+#endif
+
     if (reg < 12) {
         register_pool |= 1 << reg;
         changed_mask |= 1 << reg;
+        if (__builtin_popcount(register_pool) > alloc_peak)
+            alloc_peak = __builtin_popcount(register_pool);
         return reg;
     }
 
@@ -415,40 +841,44 @@ uint16_t RA_GetTempAllocMask()
     return register_pool;
 }
 
+/*
+    Registers to save around a call of a helper which may change the registers in clobber. Only
+    those holding something now are saved: allocated temporaries, m68k registers and PC kept in
+    caller saved registers, and LR
+*/
+uint32_t RA_GetCallSaveMask(uint32_t clobber)
+{
+    return (register_pool | REG_PROTECT) & clobber;
+}
+
+/*
+    Frame of the registers in mask. The first pair or register allocates it with writeback, the
+    last one loaded from it frees it again
+*/
 uint32_t *EMIT_SaveRegFrame(uint32_t *ptr, uint32_t mask)
 {
-    uint8_t cnt = __builtin_popcount(mask);
+    uint8_t regs[32];
+    uint8_t cnt = 0;
+
+    for (uint8_t r=0; r < 32; r++)
+        if (mask & (1U << r))
+            regs[cnt++] = r;
 
     if (cnt != 0)
     {
-        // Reserve place on stack
-        if (cnt & 1)
-            *ptr++ = sub64_immed(31, 31, 8*(cnt + 1));
-        else
-            *ptr++ = sub64_immed(31, 31, 8*cnt);
-        uint32_t m = 1;
-        uint8_t r = 0;
-        uint8_t off = 0;
-
-        while(cnt > 1) {
-            uint8_t r1;
-            uint8_t r2;
+        int16_t size = 8 * (cnt + (cnt & 1));
 
-            while(0 == (mask & m)) { m <<= 1; r++; }
-            r1 = r++;
-            m <<= 1;
-            while(0 == (mask & m)) { m <<= 1; r++; }
-            r2 = r++;
-            m <<= 1;
-
-            *ptr++ = stp64(31, r1, r2, 16 * off++);
-
-            cnt -= 2;
-        }
+        if (cnt == 1)
+            *ptr++ = str64_offset_preindex(31, regs[0], -size);
+        else
+            *ptr++ = stp64_preindex(31, regs[0], regs[1], -size);
 
-        if (cnt) {
-            while(0 == (mask & m)) { m <<= 1; r++; }
-            *ptr++ = str64_offset(31, r, 16 * off);
+        for (uint8_t i=2; i < cnt; i+=2)
+        {
+            if (i + 1 < cnt)
+                *ptr++ = stp64(31, regs[i], regs[i + 1], 8 * i);
+            else
+                *ptr++ = str64_offset(31, regs[i], 8 * i);
         }
     }
 
@@ -457,42 +887,30 @@ uint32_t *EMIT_SaveRegFrame(uint32_t *ptr, uint32_t mask)
 
 uint32_t *EMIT_RestoreRegFrame(uint32_t *ptr, uint32_t mask)
 {
-    uint8_t cnt = __builtin_popcount(mask);
-    uint8_t cnt_orig = cnt;
+    uint8_t regs[32];
+    uint8_t cnt = 0;
+
+    for (uint8_t r=0; r < 32; r++)
+        if (mask & (1U << r))
+            regs[cnt++] = r;
 
     if (cnt != 0)
     {
-        uint32_t m = 1;
-        uint8_t r = 0;
-        uint8_t off = 0;
-
-        while(cnt > 1) {
-            uint8_t r1;
-            uint8_t r2;
-
-            while(0 == (mask & m)) { m <<= 1; r++; }
-            r1 = r++;
-            m <<= 1;
-            while(0 == (mask & m)) { m <<= 1; r++; }
-            r2 = r++;
-            m <<= 1;
-
-            *ptr++ = ldp64(31, r1, r2, 16 * off++);
+        int16_t size = 8 * (cnt + (cnt & 1));
 
-            cnt -= 2;
-        }
-
-        if (cnt) {
-            while(0 == (mask & m)) { m <<= 1; r++; }
-            *ptr++ = ldr64_offset(31, r, 16 * off);
+        for (uint8_t i=2; i < cnt; i+=2)
+        {
+            if (i + 1 < cnt)
+                *ptr++ = ldp64(31, regs[i], regs[i + 1], 8 * i);
+            else
+                *ptr++ = ldr64_offset(31, regs[i], 8 * i);
         }
 
-        // Reclaim place on stack
-        if (cnt_orig & 1)
-            *ptr++ = add64_immed(31, 31, 8*(cnt_orig + 1));
+        if (cnt == 1)
+            *ptr++ = ldr64_offset_postindex(31, regs[0], size);
         else
-            *ptr++ = add64_immed(31, 31, 8*cnt_orig);
+            *ptr++ = ldp64_postindex(31, regs[0], regs[1], size);
     }
-    
+
     return ptr;
 }
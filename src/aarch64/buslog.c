@@ -0,0 +1,768 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "mmu.h"
+#include "M68k.h"
+#include "buslog.h"
+
+#if EMU68_BUS_LOG
+
+#if !EMU68_INSN_COUNTER
+#error "Bus log needs EMU68_INSN_COUNTER for IPL timestamps"
+#endif
+
+enum BusLogMode buslog_mode;
+uint8_t buslog_ipl;
+uint64_t buslog_next_ipl = ~0ULL;
+
+extern struct M68KState *__m68k_state;
+
+static struct BusLogHeader *hdr;
+static uint8_t *log_pos;
+static uint8_t *log_end;
+static uintptr_t log_phys;
+static uintptr_t log_size;
+static uint32_t record_mb;
+static const char *record_args;
+
+/* Previous read, repeated reads are stored as a count */
+static struct {
+    uint32_t    lr_Address;
+    int         lr_Size;
+    uint64_t    lr_Value;
+    uint64_t    lr_Value2;
+    uint64_t    lr_Repeat;
+    int         lr_Valid;
+} last;
+
+static uint64_t last_count;
+
+/* Instruction counter of the m68k, kept in v30 by the translated code */
+static inline uint64_t InsnCount()
+{
+    uint64_t cnt;
+    asm volatile("mov %0, v30.d[0]":"=r"(cnt));
+    return cnt;
+}
+
+static inline uint8_t *PutULEB(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+
+    return p;
+}
+
+static inline const uint8_t *GetULEB(const uint8_t *p, uint64_t *v)
+{
+    uint64_t r = 0;
+    int shift = 0;
+
+    do {
+        r |= (uint64_t)(*p & 0x7f) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+
+    *v = r;
+
+    return p;
+}
+
+static inline uint32_t ZigZag(uint32_t address, uint32_t prev)
+{
+    int32_t d = (int32_t)(address - prev);
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static inline uint32_t UnZigZag(uint32_t zz, uint32_t prev)
+{
+    return prev + ((zz >> 1) ^ -(zz & 1));
+}
+
+/* Largest record without ROM contents: tag and three 10 byte numbers */
+#define MAX_RECORD  32
+
+static void LogFull()
+{
+    kprintf("[BUSLOG] Log full after %lld reads and %lld IPL changes, recording stopped\n",
+        hdr->bl_Reads, hdr->bl_IPLChanges);
+    buslog_mode = BUSLOG_OFF;
+}
+
+static inline int Room(uintptr_t extra)
+{
+    if ((uintptr_t)(log_end - log_pos) < MAX_RECORD + extra)
+    {
+        LogFull();
+        return 0;
+    }
+
+    return 1;
+}
+
+static inline void Commit(uint8_t *p)
+{
+    log_pos = p;
+    hdr->bl_Length = (uintptr_t)log_pos - (uintptr_t)(hdr + 1);
+}
+
+static void FlushRepeat()
+{
+    if (last.lr_Repeat && Room(0))
+    {
+        uint8_t *p = log_pos;
+        *p++ = BLR_REPEAT;
+        p = PutULEB(p, last.lr_Repeat);
+        Commit(p);
+    }
+
+    last.lr_Repeat = 0;
+}
+
+void BusLog_Configure(const char *bootargs)
+{
+    const char *tok = find_token(bootargs, "bus_record=");
+
+    if (tok)
+    {
+        uint32_t mb = 0;
+
+        for (int i=0; i < 5; i++)
+        {
+            if (tok[11 + i] < '0' || tok[11 + i] > '9')
+                break;
+
+            mb = mb * 10 + tok[11 + i] - '0';
+        }
+
+        if (mb < 8)
+            mb = 8;
+
+        record_mb = mb;
+        record_args = bootargs;
+    }
+}
+
+/* Take the log buffer from below given top of RAM, returns the size taken */
+uintptr_t BusLog_Reserve(uintptr_t top)
+{
+    if (record_mb == 0)
+        return 0;
+
+    log_size = ((uintptr_t)record_mb << 20) & ~0x1fffffULL;
+    log_phys = top - log_size;
+
+    /* The m68k has to reach the log in order to save it */
+    if (top > 0xf2000000 || log_size >= top)
+    {
+        kprintf("[BUSLOG] No room for the bus log below %p\n", top);
+        record_mb = 0;
+        log_size = 0;
+        return 0;
+    }
+
+    kprintf("[BUSLOG] %d MiB for the bus log at %p\n", log_size >> 20, log_phys);
+
+    /* Recorded IPL changes are timestamped with the exact instruction count */
+    insn_count_precise = 1;
+
+    return log_size;
+}
+
+/* 0 - unmapped, 1 - read only, 2 - writable. Physical address in pa */
+static int Probe(uintptr_t va, uintptr_t *pa)
+{
+    uint64_t par;
+
+    asm volatile("at s1e1r, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(va));
+    if (par & 1)
+        return 0;
+
+    *pa = (par & 0x0000fffffffff000ULL) | (va & 0xfff);
+
+    asm volatile("at s1e1w, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(va));
+
+    return (par & 1) ? 1 : 2;
+}
+
+static void EmitMap(uint32_t base, uint32_t size, uint32_t period, int read_only)
+{
+    uint8_t *p;
+    void *mem;
+
+    FlushRepeat();
+
+    if (!Room(read_only ? period : 0))
+        return;
+
+    /* m68k address, possibly 0. Hide it from the compiler */
+    asm volatile("":"=r"(mem):"0"((uintptr_t)base));
+    p = log_pos;
+
+    if (read_only)
+    {
+        *p++ = BLR_ROM;
+        p = PutULEB(p, base);
+        p = PutULEB(p, size);
+        p = PutULEB(p, period);
+        memcpy(p, mem, period);
+        p += period;
+    }
+    else
+    {
+        *p++ = BLR_RAM;
+        p = PutULEB(p, base);
+        p = PutULEB(p, size);
+
+        /* Replay starts with cleared RAM, so does the recording */
+        bzero(mem, size);
+    }
+
+    Commit(p);
+
+    kprintf("[BUSLOG]   %s %08x-%08x", read_only ? "ROM" : "RAM", base, base + size - 1);
+    if (read_only && period != size)
+        kprintf(", %d KiB repeated", period >> 10);
+    kprintf("\n");
+}
+
+void BusLog_Map(uint32_t base, uint32_t size, int read_only)
+{
+    if (buslog_mode == BUSLOG_RECORD)
+        EmitMap(base, size, size, read_only);
+}
+
+/*
+    Store the layout of m68k address space. Below 16MB pages are checked one by one, the rest
+    in 2MB steps. Ranges mapping one physical block over and over (unused Z3 space) are stored
+    with the contents of the block only
+*/
+static void ScanAddressSpace()
+{
+    uint32_t run_base = 0, run_period = 0;
+    uintptr_t run_pa = 0;
+    int run_kind = 0, run_alias = 0;
+    uint64_t va = 0;
+
+    while (va <= 0xf2000000)
+    {
+        uint32_t step = va < 0x01000000 ? 4096 : 0x200000;
+        uintptr_t pa = 0;
+        int kind = 0;
+
+        if (va < 0xf2000000 && (va < log_phys || va >= log_phys + log_size))
+            kind = Probe(va, &pa);
+
+        if (run_kind && kind == run_kind && va != 0x01000000)
+        {
+            if (va - run_base == run_period && pa == run_pa && kind == 1)
+                run_alias = 1;
+
+            if (run_alias ? pa == run_pa + (va - run_base) % run_period
+                          : pa == run_pa + (va - run_base))
+            {
+                if (!run_alias)
+                    run_period += step;
+                va += step;
+                continue;
+            }
+        }
+
+        if (run_kind)
+            EmitMap(run_base, va - run_base, run_alias ? run_period : va - run_base, run_kind == 1);
+
+        run_kind = kind;
+        run_base = va;
+        run_pa = pa;
+        run_period = step;
+        run_alias = 0;
+        va += step;
+    }
+}
+
+static void StartRecording()
+{
+    hdr = (struct BusLogHeader *)(0xffffff9000000000 + log_phys);
+    log_pos = (uint8_t *)(hdr + 1);
+    log_end = (uint8_t *)hdr + log_size;
+
+    bzero(hdr, sizeof(*hdr));
+    hdr->bl_Magic = BUSLOG_MAGIC;
+    hdr->bl_Version = BUSLOG_VERSION;
+    hdr->bl_HeaderSize = sizeof(*hdr);
+
+    for (unsigned i=0; i < sizeof(hdr->bl_BootArgs) - 1 && record_args[i]; i++)
+        hdr->bl_BootArgs[i] = record_args[i];
+
+    kprintf("[BUSLOG] Recording m68k address space:\n");
+    ScanAddressSpace();
+
+    /* The m68k reads the log from the same address to save it */
+    mmu_map(log_phys, log_phys, log_size, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+
+    uint32_t prop[] = { log_phys >> 32, log_phys & 0xffffffff, log_size };
+    dt_add_property(dt_find_node("/emu68"), "bus-log", prop, sizeof(prop));
+
+    kprintf("[BUSLOG] Recording to %08x-%08x\n", log_phys, log_phys + log_size - 1);
+
+    last.lr_Valid = 0;
+    last_count = InsnCount();
+    buslog_ipl = 0;
+    buslog_mode = BUSLOG_RECORD;
+}
+
+void BusLog_Read(int size, uint32_t address, uint64_t value, uint64_t value2)
+{
+    hdr->bl_Reads++;
+
+    if (last.lr_Valid && address == last.lr_Address && size == last.lr_Size &&
+        value == last.lr_Value && value2 == last.lr_Value2)
+    {
+        last.lr_Repeat++;
+        return;
+    }
+
+    FlushRepeat();
+
+    if (!Room(0))
+        return;
+
+    uint8_t *p = log_pos;
+    *p++ = BLR_READ + __builtin_ctz(size);
+    p = PutULEB(p, ZigZag(address, last.lr_Address));
+    p = PutULEB(p, value);
+    if (size == 16)
+        p = PutULEB(p, value2);
+    Commit(p);
+
+    last.lr_Address = address;
+    last.lr_Size = size;
+    last.lr_Value = value;
+    last.lr_Value2 = value2;
+    last.lr_Valid = 1;
+}
+
+static int RecordIPL(int level)
+{
+    uint64_t cnt = InsnCount();
+
+    FlushRepeat();
+
+    if (!Room(0))
+        return level;
+
+    uint8_t *p = log_pos;
+    *p++ = BLR_IPL;
+    p = PutULEB(p, cnt - last_count);
+    *p++ = level;
+    Commit(p);
+
+    last_count = cnt;
+    buslog_ipl = level;
+    hdr->bl_IPLChanges++;
+    hdr->bl_InsnCount = cnt;
+
+    return level;
+}
+
+/* Replay */
+
+struct Cursor {
+    const uint8_t   *c_Pos;
+    uint32_t        c_Address;
+    uint64_t        c_Count;
+};
+
+static struct Cursor read_cursor;
+static struct Cursor ipl_cursor;
+static const uint8_t *replay_end;
+
+static struct {
+    const uint8_t   *m_Record;
+    uint32_t        m_Base;
+    uint32_t        m_Size;
+    uint32_t        m_Period;
+    uintptr_t       m_Phys;
+    int             m_ReadOnly;
+} maps[EMU68_BUS_LOG_MAPS];
+static int map_count;
+static int maps_applied;
+
+static uint64_t replay_reads;
+static uint64_t replay_ipl;
+static uint32_t replay_mismatches;
+static uint64_t replay_start;
+static uint32_t reset_isp, reset_pc;
+static int next_ipl_level = -1;
+static uint64_t next_ipl_count;
+
+/* Skip one record, returns NULL at end of the log */
+static const uint8_t *Skip(const uint8_t *p)
+{
+    uint64_t v;
+    uint8_t tag;
+
+    if (p >= replay_end)
+        return NULL;
+
+    tag = *p++;
+
+    switch (tag)
+    {
+        case BLR_READ + 0 ... BLR_READ + 4:
+            p = GetULEB(p, &v);
+            p = GetULEB(p, &v);
+            if (tag == BLR_READ + 4)
+                p = GetULEB(p, &v);
+            break;
+        case BLR_REPEAT:
+            p = GetULEB(p, &v);
+            break;
+        case BLR_IPL:
+            p = GetULEB(p, &v);
+            p++;
+            break;
+        case BLR_RAM:
+            p = GetULEB(p, &v);
+            p = GetULEB(p, &v);
+            break;
+        case BLR_ROM:
+            p = GetULEB(p, &v);
+            p = GetULEB(p, &v);
+            p = GetULEB(p, &v);
+            p += v;
+            break;
+        default:
+            kprintf("[BUSLOG] Unknown record %02x at offset %d\n", tag, (uintptr_t)(p - 1) - (uintptr_t)(hdr + 1));
+            return NULL;
+    }
+
+    return p;
+}
+
+int BusLog_IsLog(const void *image)
+{
+    const struct BusLogHeader *h = image;
+
+    return h->bl_Magic == BUSLOG_MAGIC;
+}
+
+static uintptr_t Carve(uintptr_t *top_of_ram, uintptr_t size)
+{
+    uintptr_t bottom = sys_memory[0].mb_Base + 0x01000000;
+    uintptr_t align = size >= 0x200000 ? 0x1fffff : 0xfff;
+
+    size = (size + 0xfff) & ~0xfffULL;
+
+    if (*top_of_ram < bottom + size + align)
+        return 0;
+
+    *top_of_ram = (*top_of_ram - size) & ~align;
+
+    return *top_of_ram;
+}
+
+int BusLog_LoadReplay(void *image, uintptr_t size, uintptr_t *top_of_ram)
+{
+    const uint8_t *p;
+
+    hdr = image;
+
+    if (hdr->bl_Version != BUSLOG_VERSION)
+    {
+        kprintf("[BUSLOG] Log version %d not supported\n", hdr->bl_Version);
+        return 0;
+    }
+
+    replay_end = (const uint8_t *)image + hdr->bl_HeaderSize + hdr->bl_Length;
+    if ((uintptr_t)replay_end > (uintptr_t)image + size)
+    {
+        kprintf("[BUSLOG] Log truncated, %lld bytes of records expected\n", hdr->bl_Length);
+        replay_end = (const uint8_t *)image + size;
+    }
+
+    hdr->bl_BootArgs[sizeof(hdr->bl_BootArgs) - 1] = 0;
+    kprintf("[BUSLOG] Replaying %lld reads and %lld IPL changes, %lld m68k instructions\n",
+        hdr->bl_Reads, hdr->bl_IPLChanges, hdr->bl_InsnCount);
+    kprintf("[BUSLOG] Recorded with: %s\n", hdr->bl_BootArgs);
+
+    p = (const uint8_t *)image + hdr->bl_HeaderSize;
+
+    /* Backing memory for all ranges of the recording, mapped once the replay gets to them */
+    for (const uint8_t *r = p; r != NULL; r = Skip(r))
+    {
+        uint64_t base, len, period;
+        const uint8_t *q;
+
+        if (r >= replay_end || (*r != BLR_RAM && *r != BLR_ROM))
+            continue;
+
+        q = GetULEB(r + 1, &base);
+        q = GetULEB(q, &len);
+        period = len;
+        if (*r == BLR_ROM)
+            q = GetULEB(q, &period);
+
+        if (map_count == EMU68_BUS_LOG_MAPS)
+        {
+            kprintf("[BUSLOG] More than %d memory ranges in the log\n", EMU68_BUS_LOG_MAPS);
+            return 0;
+        }
+
+        uintptr_t phys = Carve(top_of_ram, period);
+        if (phys == 0)
+        {
+            kprintf("[BUSLOG] No RAM left for range %08x-%08x, give the machine more memory\n",
+                (uint32_t)base, (uint32_t)(base + len - 1));
+            return 0;
+        }
+
+        if (*r == BLR_ROM)
+            memcpy((void *)(0xffffff9000000000 + phys), q, period);
+        else
+            bzero((void *)(0xffffff9000000000 + phys), period);
+
+        maps[map_count].m_Record = r;
+        maps[map_count].m_Base = base;
+        maps[map_count].m_Size = len;
+        maps[map_count].m_Period = period;
+        maps[map_count].m_Phys = phys;
+        maps[map_count].m_ReadOnly = *r == BLR_ROM;
+        map_count++;
+    }
+
+    /* Reset vectors as the overlay gave them: from a range at 0 if any, from the ROM otherwise */
+    for (int i=0; i < map_count; i++)
+    {
+        if (maps[i].m_ReadOnly && (maps[i].m_Base == 0 || maps[i].m_Base == 0xf80000))
+        {
+            const uint32_t *v = (const uint32_t *)(0xffffff9000000000 + maps[i].m_Phys);
+            reset_isp = BE32(v[0]);
+            reset_pc = BE32(v[1]);
+
+            if (maps[i].m_Base == 0)
+                break;
+        }
+    }
+
+    read_cursor.c_Pos = p;
+    ipl_cursor.c_Pos = p;
+    buslog_mode = BUSLOG_REPLAY;
+
+    return 1;
+}
+
+void BusLog_ResetVectors(uint32_t *isp, uint32_t *pc)
+{
+    *isp = reset_isp;
+    *pc = reset_pc;
+}
+
+static void ApplyMap(const uint8_t *r)
+{
+    for (int i=maps_applied; i < map_count; i++)
+    {
+        if (maps[i].m_Record != r)
+            continue;
+
+        uint32_t attr = MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_ATTR_CACHED;
+        if (maps[i].m_ReadOnly)
+            attr |= MMU_READ_ONLY;
+
+        arm_flush_cache(0xffffff9000000000 + maps[i].m_Phys, maps[i].m_Period);
+
+        for (uint32_t off = 0; off < maps[i].m_Size; off += maps[i].m_Period)
+        {
+            uint32_t len = maps[i].m_Size - off;
+            if (len > maps[i].m_Period)
+                len = maps[i].m_Period;
+
+            mmu_map(maps[i].m_Phys, maps[i].m_Base + off, len, attr, 0);
+        }
+
+        asm volatile("dsb ish; tlbi vmalle1is; dsb ish; isb");
+
+        maps_applied = i + 1;
+        return;
+    }
+}
+
+/*
+    Ranges are mapped once all reads recorded before them are done, i.e. before the next access
+    of the m68k. IPL records are left to their own cursor
+*/
+static void ApplyMaps()
+{
+    const uint8_t *p = read_cursor.c_Pos;
+
+    while (p != NULL && p < replay_end && (*p == BLR_IPL || *p == BLR_RAM || *p == BLR_ROM))
+    {
+        if (*p != BLR_IPL)
+            ApplyMap(p);
+        p = Skip(p);
+    }
+
+    read_cursor.c_Pos = p ? p : replay_end;
+}
+
+static void __attribute__((noreturn)) ReplayDone()
+{
+    uint64_t now, frq;
+
+    asm volatile("mrs %0, CNTPCT_EL0":"=r"(now));
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(frq));
+    frq &= 0xffffffff;
+
+    kprintf("[BUSLOG] Replay complete: reads=%lld ipl=%lld insn=%lld recorded_insn=%lld us=%lld mismatches=%d\n",
+        replay_reads, replay_ipl, InsnCount(), hdr->bl_InsnCount,
+        (now - replay_start) * 1000000 / frq, replay_mismatches);
+
+    while(1) asm volatile("wfe");
+}
+
+static void NextIPL()
+{
+    const uint8_t *p = ipl_cursor.c_Pos;
+
+    while (p != NULL && p < replay_end && *p != BLR_IPL)
+        p = Skip(p);
+
+    if (p == NULL || p >= replay_end)
+    {
+        next_ipl_level = -1;
+        ipl_cursor.c_Pos = replay_end;
+        buslog_next_ipl = ~0ULL;
+        return;
+    }
+
+    uint64_t delta;
+    p = GetULEB(p + 1, &delta);
+    next_ipl_count = ipl_cursor.c_Count + delta;
+    next_ipl_level = *p++;
+    ipl_cursor.c_Pos = p;
+    buslog_next_ipl = next_ipl_count;
+}
+
+void BusLog_Start()
+{
+    if (record_mb && log_phys)
+    {
+        StartRecording();
+    }
+    else if (buslog_mode == BUSLOG_REPLAY)
+    {
+        ApplyMaps();
+        NextIPL();
+
+        /* Non-zero INT makes every exit of translated code return to the main loop */
+        __m68k_state->INT.IPL = 1;
+
+        asm volatile("mrs %0, CNTPCT_EL0":"=r"(replay_start));
+        kprintf("[BUSLOG] Replay started\n");
+    }
+}
+
+int BusLog_ReplayRead(uint64_t *value, uint64_t *value2, int size, uint32_t address)
+{
+    ApplyMaps();
+
+    if (last.lr_Repeat == 0)
+    {
+        const uint8_t *p = read_cursor.c_Pos;
+
+        if (p >= replay_end)
+            ReplayDone();
+
+        uint8_t tag = *p++;
+        uint64_t v;
+
+        if (tag > BLR_READ + 4 && tag != BLR_REPEAT)
+        {
+            kprintf("[BUSLOG] Unknown record %02x at offset %d\n", tag, (uintptr_t)(p - 1) - (uintptr_t)(hdr + 1));
+            ReplayDone();
+        }
+
+        if (tag == BLR_REPEAT)
+        {
+            p = GetULEB(p, &last.lr_Repeat);
+        }
+        else
+        {
+            p = GetULEB(p, &v);
+            last.lr_Address = UnZigZag(v, last.lr_Address);
+            last.lr_Size = 1 << (tag - BLR_READ);
+            p = GetULEB(p, &last.lr_Value);
+            if (last.lr_Size == 16)
+                p = GetULEB(p, &last.lr_Value2);
+            last.lr_Repeat = 1;
+        }
+
+        read_cursor.c_Pos = p;
+    }
+
+    last.lr_Repeat--;
+    replay_reads++;
+
+    if (address != last.lr_Address || size != last.lr_Size)
+    {
+        if (replay_mismatches++ < 8)
+            kprintf("[BUSLOG] Mismatch at read %lld, insn %lld: %d bytes at %08x, log has %d bytes at %08x\n",
+                replay_reads, InsnCount(), size, address, last.lr_Size, last.lr_Address);
+    }
+
+    *value = last.lr_Value;
+    if (size == 16 && value2)
+        *value2 = last.lr_Value2;
+
+    return 1;
+}
+
+void BusLog_ReplayWrite(int size, uint32_t address)
+{
+    (void)size;
+    (void)address;
+
+    ApplyMaps();
+}
+
+int BusLog_IPL(int level)
+{
+    if (buslog_mode == BUSLOG_RECORD)
+    {
+        if (level != buslog_ipl)
+            RecordIPL(level);
+
+        return level;
+    }
+
+    uint64_t cnt = InsnCount();
+
+    while (next_ipl_level >= 0 && next_ipl_count <= cnt)
+    {
+        if (next_ipl_count != cnt && replay_mismatches++ < 8)
+            kprintf("[BUSLOG] IPL %d at insn %lld, recorded at %lld\n", next_ipl_level, cnt, next_ipl_count);
+
+        buslog_ipl = next_ipl_level;
+        ipl_cursor.c_Count = next_ipl_count;
+        replay_ipl++;
+        NextIPL();
+    }
+
+    return buslog_ipl;
+}
+
+#endif /* EMU68_BUS_LOG */
@@ -0,0 +1,197 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "mmu.h"
+#include "chipshadow.h"
+#if EMU68_BUS_LOG
+#include "buslog.h"
+#endif
+
+#if defined(PISTORM) && PISTORM_CHIP_SHADOW
+
+#include "ps_protocol.h"
+
+#define PAGE_SIZE   4096
+#define CHIP_PAGES  (0x200000 / PAGE_SIZE)
+
+static uint32_t shadow_start;
+static uint32_t shadow_size;
+static uintptr_t shadow_phys;
+static uint32_t shadow_dirty[CHIP_PAGES / 32];
+static uint32_t shadow_dirty_count;
+
+/* Decimal number of up to four digits */
+static uint32_t GetKB(const char **tok)
+{
+    uint32_t kb = 0;
+
+    for (int i=0; i < 4; i++)
+    {
+        if (**tok < '0' || **tok > '9')
+            break;
+
+        kb = kb * 10 + **tok - '0';
+        (*tok)++;
+    }
+
+    return kb;
+}
+
+void ChipShadow_Configure(const char *bootargs)
+{
+    const char *tok = find_token(bootargs, "chip_private=");
+
+    if (tok == NULL)
+        return;
+
+    tok += 13;
+
+    uint32_t start = GetKB(&tok) << 10;
+
+    if (*tok++ != '-')
+        return;
+
+    uint32_t end = GetKB(&tok) << 10;
+
+    start &= ~(PAGE_SIZE - 1);
+    end = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    if (end > 0x200000)
+        end = 0x200000;
+
+    /* Page zero holds the vectors, fast_page_zero takes care of it */
+    if (start < PAGE_SIZE)
+        start = PAGE_SIZE;
+
+    if (start >= end)
+        return;
+
+    shadow_start = start;
+    shadow_size = end - start;
+}
+
+/* Take the backing from below given top of RAM, returns the size taken */
+uintptr_t ChipShadow_Reserve(uintptr_t top)
+{
+    if (shadow_size == 0)
+        return 0;
+
+    shadow_phys = top - shadow_size;
+
+    kprintf("[CHIP] %d KiB of CHIP RAM at %06x are CPU-private, backed at %p\n", shadow_size >> 10, shadow_start, shadow_phys);
+
+    return shadow_size;
+}
+
+/*
+    Copy the range from CHIP RAM and map it read-only. The range never covers a whole 2MB block,
+    it is mapped with 4K pages which can be protected one by one later
+*/
+void ChipShadow_Map()
+{
+    /* No backing was reserved */
+    if (shadow_phys == 0)
+        shadow_size = 0;
+
+    if (shadow_size == 0)
+        return;
+
+    ps_read_block(shadow_start, (void *)(0xffffff9000000000 + shadow_phys), shadow_size);
+
+    mmu_map(shadow_phys, shadow_start, shadow_size, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+
+#if EMU68_BUS_LOG
+    BusLog_Map(shadow_start, shadow_size, 0);
+#endif
+}
+
+/* Range touches the CPU-private part of CHIP RAM, bus writes into it would not be seen by the m68k */
+int ChipShadow_Overlaps(uint32_t addr, uint32_t size)
+{
+    return shadow_size && addr < shadow_start + shadow_size && addr + size > shadow_start;
+}
+
+/* Permission fault on a clean page of the range. The page becomes dirty, the store is restarted */
+int ChipShadow_Write(uint64_t far)
+{
+    uint32_t addr = far;
+
+    /* Space and its +4GB shadow only */
+    if ((far >> 33) || addr < shadow_start || addr >= shadow_start + shadow_size)
+        return 0;
+
+    uint32_t page = addr / PAGE_SIZE;
+
+    if (shadow_dirty[page / 32] & (1 << (page % 32)))
+        return 0;
+
+    shadow_dirty[page / 32] |= 1 << (page % 32);
+    shadow_dirty_count++;
+
+    return mmu_protect_page(addr & ~(PAGE_SIZE - 1), 0);
+}
+
+/* Write dirty pages back to CHIP RAM and protect them again */
+static void Sync()
+{
+    uint32_t first = shadow_start / PAGE_SIZE;
+    uint32_t last = (shadow_start + shadow_size) / PAGE_SIZE;
+
+    mmu_batch_begin();
+
+    for (uint32_t page = first; page < last && shadow_dirty_count; page++)
+    {
+        if ((shadow_dirty[page / 32] & (1 << (page % 32))) == 0)
+            continue;
+
+        uint32_t addr = page * PAGE_SIZE;
+        const uint32_t *src = (const uint32_t *)(0xffffff9000000000 + shadow_phys + (addr - shadow_start));
+
+        mmu_protect_page(addr, 1);
+
+        for (int i=0; i < PAGE_SIZE / 4; i++)
+            ps_write_32(addr + 4*i, src[i]);
+
+        shadow_dirty[page / 32] &= ~(1 << (page % 32));
+        shadow_dirty_count--;
+    }
+
+    mmu_batch_commit();
+}
+
+/* Custom chip registers starting DMA which may read CHIP RAM */
+static const uint32_t dma_start_regs[] = {
+    0xdff024,   /* DSKLEN */
+    0xdff058,   /* BLTSIZE */
+    0xdff05e,   /* BLTSIZH */
+    0xdff088,   /* COPJMP1 */
+    0xdff08a,   /* COPJMP2 */
+    0xdff096,   /* DMACON */
+};
+
+/* Called before a write of size bytes to the custom chips reaches the bus */
+void ChipShadow_CustomWrite(uint32_t far, int size)
+{
+    if (shadow_dirty_count == 0)
+        return;
+
+    for (unsigned i=0; i < sizeof(dma_start_regs) / sizeof(dma_start_regs[0]); i++)
+    {
+        if (dma_start_regs[i] >= far && dma_start_regs[i] < far + size)
+        {
+            Sync();
+            return;
+        }
+    }
+}
+
+#endif
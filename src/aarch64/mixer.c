@@ -0,0 +1,333 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "M68k.h"
+#include "mixer.h"
+
+#if EMU68_MIX_SERVICE
+
+/*
+    The service reaches m68k memory through the -4GB shadow of the kernel table, see rtg.c.
+    Output is rendered in blocks of MIX_BLOCK frames. Every channel is resampled into a block of
+    16-bit samples first, NEON then adds it with both volumes to the 32-bit sums of the block
+    and finally narrows the sums with saturation into interleaved stereo words.
+*/
+
+#define MIX_BLOCK       256
+#define MIX_VOLUME_MAX  (4 * MIX_VOLUME_UNITY)  /* 64 channels at full scale still fit in 32 bits */
+
+static struct MixQueue *queue;
+static uint32_t vc4_lo;
+static uint32_t vc4_hi;
+
+static int16_t samples[MIX_BLOCK] __attribute__((aligned(64)));
+static int32_t sum_l[MIX_BLOCK] __attribute__((aligned(64)));
+static int32_t sum_r[MIX_BLOCK] __attribute__((aligned(64)));
+
+/* Area has to lie in VC4 memory or in a block of m68k RAM */
+static int area_ok(uint32_t addr, uint64_t size)
+{
+    uint64_t start = addr;
+    uint64_t end = start + size;
+
+    if (end > 0x100000000ULL)
+        return 0;
+
+    if (start >= vc4_lo && end <= vc4_hi)
+        return 1;
+
+    for (int i=0; sys_memory[i].mb_Size; i++)
+    {
+        if (start >= sys_memory[i].mb_Base && end <= sys_memory[i].mb_Base + sys_memory[i].mb_Size &&
+            end <= 0xf2000000)
+            return 1;
+    }
+
+    return 0;
+}
+
+static inline int32_t load_sample(const uint8_t *s, int fmt, uint32_t pos)
+{
+    if (fmt == MIXS_S8)
+        return (int8_t)s[pos] << 8;
+    else
+        return ((const int16_t *)s)[pos];
+}
+
+/*
+    Next frames of the channel, linearly interpolated. Returns the number of frames written,
+    fewer than asked for if the channel has ended
+*/
+static uint32_t resample(struct MixChannel *ch, uint32_t frames)
+{
+    const uint8_t *s = M68K_PTR(ch->ch_Sample);
+    uint32_t length = ch->ch_Length;
+    uint32_t loop = ch->ch_LoopStart;
+    uint32_t pos = ch->ch_Position;
+    uint32_t frac = ch->ch_Fraction;
+    uint32_t step_int = ch->ch_Step >> 16;
+    uint32_t step_frac = ch->ch_Step & 0xffff;
+    int fmt = ch->ch_Format;
+    uint32_t i;
+
+    for (i=0; i < frames; i++)
+    {
+        if (pos >= length)
+        {
+            if (loop >= length)
+            {
+                ch->ch_Flags &= ~MIXCF_ACTIVE;
+                break;
+            }
+
+            pos = loop + (pos - length) % (length - loop);
+        }
+
+        uint32_t next = pos + 1 < length ? pos + 1 : (loop < length ? loop : pos);
+        int32_t a = load_sample(s, fmt, pos);
+        int32_t b = load_sample(s, fmt, next);
+
+        /* 15 bits of the fraction, the product of a full scale difference fits in 32 bits */
+        samples[i] = a + (((b - a) * (int32_t)(frac >> 1)) >> 15);
+
+        frac += step_frac;
+        pos += step_int + (frac >> 16);
+        frac &= 0xffff;
+    }
+
+    ch->ch_Position = pos;
+    ch->ch_Fraction = frac;
+
+    return i;
+}
+
+/* Samples of the block times both volumes added to the sums, 8 frames per step */
+static void accumulate(uint32_t frames, int16_t vol_l, int16_t vol_r)
+{
+    uint32_t blocks = (frames + 7) >> 3;
+    const int16_t *s = samples;
+    int32_t *l = sum_l;
+    int32_t *r = sum_r;
+
+    asm volatile(
+        "       dup     v6.8h, %w4              \n"
+        "       dup     v7.8h, %w5              \n"
+        "1:     ld1     {v0.8h}, [%0], #16      \n"
+        "       ld1     {v1.4s, v2.4s}, [%1]    \n"
+        "       ld1     {v3.4s, v4.4s}, [%2]    \n"
+        "       smlal   v1.4s, v0.4h, v6.4h     \n"
+        "       smlal2  v2.4s, v0.8h, v6.8h     \n"
+        "       smlal   v3.4s, v0.4h, v7.4h     \n"
+        "       smlal2  v4.4s, v0.8h, v7.8h     \n"
+        "       st1     {v1.4s, v2.4s}, [%1], #32 \n"
+        "       st1     {v3.4s, v4.4s}, [%2], #32 \n"
+        "       subs    %3, %3, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(s), "+r"(l), "+r"(r), "+r"(blocks):"r"(vol_l), "r"(vol_r):"v0", "v1", "v2", "v3", "v4", "v6", "v7", "memory", "cc");
+}
+
+/* Sums scaled back by the unity volume and saturated to interleaved stereo words, 8 frames per step */
+static uint32_t narrow(int16_t *d, uint32_t frames)
+{
+    uint32_t blocks = frames >> 3;
+    const int32_t *l = sum_l;
+    const int32_t *r = sum_r;
+
+    if (blocks == 0)
+        return 0;
+
+    asm volatile(
+        "1:     ld1     {v0.4s, v1.4s}, [%1], #32 \n"
+        "       ld1     {v2.4s, v3.4s}, [%2], #32 \n"
+        "       sqshrn  v4.4h, v0.4s, #8        \n"
+        "       sqshrn2 v4.8h, v1.4s, #8        \n"
+        "       sqshrn  v5.4h, v2.4s, #8        \n"
+        "       sqshrn2 v5.8h, v3.4s, #8        \n"
+        "       st2     {v4.8h, v5.8h}, [%0], #32 \n"
+        "       subs    %3, %3, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(d), "+r"(l), "+r"(r), "+r"(blocks)::"v0", "v1", "v2", "v3", "v4", "v5", "memory", "cc");
+
+    return frames & ~7;
+}
+
+static inline int16_t saturate(int32_t v)
+{
+    v >>= 8;
+
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+
+    return v;
+}
+
+static inline int16_t clamp_volume(uint16_t v)
+{
+    return v > MIX_VOLUME_MAX ? MIX_VOLUME_MAX : v;
+}
+
+static int run_command(const struct MixCommand *c)
+{
+    struct MixChannel *ch;
+    uint32_t count = c->mc_Channels;
+    uint32_t frames = c->mc_Frames;
+
+    if (c->mc_Op == MIX_NOP || frames == 0)
+        return 1;
+
+    if (c->mc_Op != MIX_RUN || count > MIX_MAX_CHANNELS || frames > 0x10000000)
+        return 0;
+
+    if (!area_ok(c->mc_Channel, count * sizeof(struct MixChannel)) || !area_ok(c->mc_Dst, frames * 4))
+        return 0;
+
+    /* Channels get their positions back, m68k core may run code translated from both areas */
+    M68K_HostWrite(c->mc_Channel, (uintptr_t)c->mc_Channel + count * sizeof(struct MixChannel), 1);
+    M68K_HostWrite(c->mc_Dst, (uintptr_t)c->mc_Dst + (uint64_t)frames * 4, 1);
+
+    ch = (struct MixChannel *)M68K_PTR(c->mc_Channel);
+
+    for (uint32_t i=0; i < count; i++)
+    {
+        uint32_t bytes = ch[i].ch_Format == MIXS_S8 ? 1 : 2;
+
+        if (!(ch[i].ch_Flags & MIXCF_ACTIVE))
+            continue;
+
+        if (ch[i].ch_Format >= MIXS_COUNT || ch[i].ch_Length == 0 || !area_ok(ch[i].ch_Sample, (uint64_t)ch[i].ch_Length * bytes))
+            return 0;
+    }
+
+    int16_t *d = (int16_t *)M68K_PTR(c->mc_Dst);
+
+    for (uint32_t done = 0; done < frames; done += MIX_BLOCK, d += 2 * MIX_BLOCK)
+    {
+        uint32_t n = frames - done < MIX_BLOCK ? frames - done : MIX_BLOCK;
+        uint32_t i;
+
+        if (c->mc_Flags & MIXF_ADD)
+        {
+            for (i=0; i < n; i++)
+            {
+                sum_l[i] = d[2*i] << 8;
+                sum_r[i] = d[2*i + 1] << 8;
+            }
+        }
+        else
+        {
+            bzero(sum_l, sizeof(sum_l));
+            bzero(sum_r, sizeof(sum_r));
+        }
+
+        for (uint32_t j=0; j < count; j++)
+        {
+            if (!(ch[j].ch_Flags & MIXCF_ACTIVE))
+                continue;
+
+            uint32_t got = resample(&ch[j], n);
+
+            if (got == 0)
+                continue;
+
+            /* The kernel takes whole steps of 8, the frames after the end of a channel add nothing */
+            for (i=got; i < ((n + 7) & ~7); i++)
+                samples[i] = 0;
+
+            accumulate(n, clamp_volume(ch[j].ch_VolumeL), clamp_volume(ch[j].ch_VolumeR));
+        }
+
+        for (i = narrow(d, n); i < n; i++)
+        {
+            d[2*i] = saturate(sum_l[i]);
+            d[2*i + 1] = saturate(sum_r[i]);
+        }
+    }
+
+    return 1;
+}
+
+/*
+    Put the queue at the end of VC4 memory, which is mapped for the m68k already. Returns the number
+    of bytes taken from VC4 memory
+*/
+uintptr_t Mix_Setup(uintptr_t vc4_base, uintptr_t vc4_size)
+{
+    uintptr_t base = vc4_base + vc4_size - EMU68_MIX_QUEUE_SIZE;
+    uint32_t reg[] = { base, EMU68_MIX_QUEUE_SIZE };
+
+    if (vc4_size < 2 * EMU68_MIX_QUEUE_SIZE)
+        return 0;
+
+    queue = (struct MixQueue *)M68K_PTR(base);
+    vc4_lo = vc4_base;
+    vc4_hi = base;
+
+    bzero(queue, EMU68_MIX_QUEUE_SIZE);
+    queue->mq_Magic = MIX_QUEUE_MAGIC;
+    queue->mq_Version = MIX_QUEUE_VERSION;
+    queue->mq_Slots = (EMU68_MIX_QUEUE_SIZE - sizeof(struct MixQueue)) / sizeof(struct MixCommand);
+
+    dt_add_property(dt_find_node("/emu68"), "mix-queue", reg, sizeof(reg));
+
+    kprintf("[BOOT] Mixing service queue at %08x, %d slots\n", base, queue->mq_Slots);
+
+    return EMU68_MIX_QUEUE_SIZE;
+}
+
+/* Main loop of the service core, the timer event stream wakes it up to look for new commands */
+void Mix_ServiceTask()
+{
+    uint64_t freq, cntkctl;
+    uint32_t evnti = 0;
+    uint32_t tail;
+
+    if (queue == NULL)
+        return;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+    /* Event on rising edge of counter bit evnti, rate is freq / 2^(evnti + 1) */
+    while (evnti < 15 && (2ULL << (evnti + 1)) <= freq / EMU68_MIX_POLL_HZ)
+        evnti++;
+
+    asm volatile("mrs %0, CNTKCTL_EL1":"=r"(cntkctl));
+    cntkctl = (cntkctl & ~0xf0ULL) | (1 << 2) | (evnti << 4);
+    asm volatile("msr CNTKCTL_EL1, %0; isb"::"r"(cntkctl));
+
+    kprintf("[MIX] Service running, polling every %d us\n", (uint32_t)(((2ULL << evnti) * 1000000) / freq));
+
+    tail = queue->mq_Tail;
+
+    while (1)
+    {
+        struct MixCommand cmd;
+
+        while (tail == __atomic_load_n(&queue->mq_Head, __ATOMIC_ACQUIRE))
+            asm volatile("wfe");
+
+        /* Own copy, the m68k may reuse the slot as soon as the tail moves */
+        cmd = queue->mq_Cmd[tail % queue->mq_Slots];
+
+        if (!run_command(&cmd))
+            __atomic_store_n(&queue->mq_Errors, queue->mq_Errors + 1, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&queue->mq_Tail, ++tail, __ATOMIC_RELEASE);
+
+        if (cmd.mc_Flags & MIXF_SIGNAL)
+            M68K_RaiseARMInt();
+    }
+}
+
+#endif
@@ -8,6 +8,7 @@
 */
 
 #include <stdint.h>
+#include "config.h"
 #include "mmu.h"
 #include "support.h"
 #include "tlsf.h"
@@ -37,73 +38,99 @@ __attribute__((used, section(".mmu"))) struct mmu_page mmu_kernel_L1;
 __attribute__((used, section(".mmu"))) struct mmu_page mmu_kernel_L2;
 
 static struct mmu_page *mmu_free_pages;
+static uint32_t mmu_free_count;
 
-static void *get_4k_page()
+/*
+    Table pages released while a batch is open. Walks of other cores may still use them through
+    stale TLB entries, they go back to the pool once the batch has flushed the TLB
+*/
+static struct mmu_page *mmu_pending_pages;
+
+/*
+    TLB maintenance collected by the open batch. Up to MMU_BATCH_PAGES pages are dropped one
+    by one, together with their shadows, more pages or changes of block layout flush all
+*/
+#define MMU_BATCH_PAGES 16
+
+static int tlb_batch;
+static int tlb_all;
+static int tlb_count;
+static uintptr_t tlb_pages[MMU_BATCH_PAGES];
+
+/* L1 table selected in place of the physical m68k space, see mmu_user_table_select */
+static struct mmu_page *mmu_user_alt;
+static uint64_t mmu_user_ttbr0;
+
+/* Grab topmost 2MB of RAM and put its 512 4K pages into the pool. Returns 0 if there is no memory node */
+static int grow_pool()
 {
-    struct mmu_page *p = NULL;
+    of_node_t *e = dt_find_node("/memory");
 
-    /* Check if there is a free 4k page */
-    if (!mmu_free_pages)
+    if (e == NULL)
+        return 0;
+
+    of_property_t *p = dt_find_property(e, "reg");
+    uint32_t *range = p->op_value;
+    int size_cells = dt_get_property_value_u32(e, "#size-cells", 1, TRUE);
+    int address_cells = dt_get_property_value_u32(e, "#address-cells", 1, TRUE);
+    int block_size = 4 * (size_cells + address_cells);
+    int block_count = p->op_length / block_size;
+    int block_top = 0;
+
+    uintptr_t top_of_ram = 0;
+
+    for (int block = 0; block < block_count; block++)
     {
-        /* No more 4K pages to use? Grab topmost 2MB of RAM */
-        of_node_t *e = dt_find_node("/memory");
-        if (e)
+        if (sys_memory[block].mb_Base + sys_memory[block].mb_Size > top_of_ram)
         {
-            of_property_t *p = dt_find_property(e, "reg");
-            uint32_t *range = p->op_value;
-            int size_cells = dt_get_property_value_u32(e, "#size-cells", 1, TRUE);
-            int address_cells = dt_get_property_value_u32(e, "#address-cells", 1, TRUE);
-            int block_size = 4 * (size_cells + address_cells);
-            int block_count = p->op_length / block_size;
-            int block_top = 0;
+            block_top = block;
+            top_of_ram = sys_memory[block].mb_Base + sys_memory[block].mb_Size;
+        }
+    }
 
-            uintptr_t top_of_ram = 0;
+    /* Decrease the size of memory block by 2MB */
+    sys_memory[block_top].mb_Size -= (1 << 21);
+    uintptr_t mmu_ploc = sys_memory[block_top].mb_Base + sys_memory[block_top].mb_Size;
+    
+    /* Update reg property */
+    for (int block=0; block < block_count; block++)
+    {
+        uintptr_t size = sys_memory[block].mb_Size;
 
-            for (int block = 0; block < block_count; block++)
-            {
-                if (sys_memory[block].mb_Base + sys_memory[block].mb_Size > top_of_ram)
-                {
-                    block_top = block;
-                    top_of_ram = sys_memory[block].mb_Base + sys_memory[block].mb_Size;
-                }
-            }
+        for (int i=0; i < size_cells; i++)
+        {
+            range[address_cells + size_cells - 1 - i] = BE32(size);
+            size >>= 32;
+        }
 
-            /* Decrease the size of memory block by 2MB */
-            sys_memory[block_top].mb_Size -= (1 << 21);
-            uintptr_t mmu_ploc = sys_memory[block_top].mb_Base + sys_memory[block_top].mb_Size;
-            
-            /* Update reg property */
-            for (int block=0; block < block_count; block++)
-            {
-                uintptr_t size = sys_memory[block].mb_Size;
+        range += block_size / 4;
+    }
 
-                for (int i=0; i < size_cells; i++)
-                {
-                    range[address_cells + size_cells - 1 - i] = BE32(size);
-                    size >>= 32;
-                }
+    /*
+        Perform add of the range address with 0xffffff9000000000, that way it will
+        be 1:1 mapped to VA in an uncached region
+    */
+    struct mmu_page *chunk = (void *)(mmu_ploc + PHYS_VIRT_OFFSET);
 
-                range += block_size / 4;
-            }
+    /* Chain the new 512 4K pages in our page pool */
+    for (int i=0; i < 512; i++)
+    {
+        chunk[i].mp_next = mmu_free_pages;
+        mmu_free_pages = &chunk[i];
+    }
 
-            /*
-                Perform add of the range address with 0xffffff9000000000, that way it will
-                be 1:1 mapped to VA in an uncached region
-            */
-            mmu_ploc += PHYS_VIRT_OFFSET;
+    mmu_free_count += 512;
 
-            /* Chain the new 512 4K pages in our page pool */
-            mmu_free_pages = (void *)mmu_ploc;
-            mmu_free_pages->mp_next = NULL;
+    return 1;
+}
 
-            for (int i=0; i < 511; i++)
-            {
-                struct mmu_page *last = mmu_free_pages;
-                mmu_free_pages = mmu_free_pages + 1;
-                mmu_free_pages->mp_next = last;
-            }
-        }
-    }
+static void *get_4k_page()
+{
+    struct mmu_page *p = NULL;
+
+    /* No more 4K pages to use? Grow the pool */
+    if (!mmu_free_pages)
+        grow_pool();
 
     /* Now try to grab new 4K page */
     if (mmu_free_pages)
@@ -113,6 +140,7 @@ static void *get_4k_page()
 
         /* Update pointer to free pages */
         mmu_free_pages = p->mp_next;
+        mmu_free_count--;
     }
 
     return p;
@@ -122,9 +150,119 @@ static void free_4k_page(void *page)
 {
     struct mmu_page *p = page;
 
+    /* Inside of a batch the page may be still in use by a table walk, keep it aside */
+    if (tlb_batch)
+    {
+        p->mp_next = mmu_pending_pages;
+        mmu_pending_pages = p;
+        return;
+    }
+
     /* Put the 4K page back to the pool */
     p->mp_next = mmu_free_pages;
     mmu_free_pages = p;
+    mmu_free_count++;
+}
+
+/*
+    Fill the pool with at least count table pages. Called at boot, before the memory is given
+    to the m68k, so that page tables changed at run-time do not take RAM away from it later.
+    Returns the number of free pages
+*/
+uint32_t mmu_reserve_pages(uint32_t count)
+{
+    while (mmu_free_count < count && grow_pool());
+
+    return mmu_free_count;
+}
+
+/* Flush the TLB completely */
+static void tlb_flush_all()
+{
+    tlb_all = 1;
+}
+
+/* Drop the range from the TLB, together with the shadows of the 4GB space created by mirror_page */
+static void tlb_flush_range(uintptr_t virt, uintptr_t length)
+{
+    uintptr_t pages = length >> 12;
+
+    if (tlb_all)
+        return;
+
+    if (tlb_count + pages > MMU_BATCH_PAGES)
+    {
+        tlb_all = 1;
+        return;
+    }
+
+    for (uintptr_t i=0; i < pages; i++)
+        tlb_pages[tlb_count++] = virt + (i << 12);
+}
+
+/* Perform TLB maintenance collected so far and return the released table pages to the pool */
+static void tlb_sync()
+{
+    if (tlb_all)
+    {
+        asm volatile(
+"       dsb     ish                 \n"
+"       tlbi    VMALLE1IS           \n" /* Flush tlb */
+"       dsb     sy                  \n"
+"       isb                         \n");
+    }
+    else if (tlb_count)
+    {
+        asm volatile("dsb ishst");
+
+        for (int i=0; i < tlb_count; i++)
+        {
+            uintptr_t p = tlb_pages[i];
+
+            if (p & 0xffff000000000000)
+            {
+                asm volatile("tlbi vaae1is, %0"::"r"((p >> 12) & 0xfffffffffffULL));
+            }
+            else
+            {
+                asm volatile(
+"       tlbi    vaae1is, %0         \n"
+"       tlbi    vaae1is, %1         \n"
+"       tlbi    vaae1is, %2         \n"
+                ::"r"(p >> 12), "r"((p + 0x100000000ULL) >> 12), "r"(((0xffffffff00000000ULL + p) >> 12) & 0xfffffffffffULL));
+            }
+        }
+
+        asm volatile("dsb ish; isb");
+    }
+
+    tlb_all = 0;
+    tlb_count = 0;
+
+    while (mmu_pending_pages)
+    {
+        struct mmu_page *p = mmu_pending_pages;
+        mmu_pending_pages = p->mp_next;
+        p->mp_next = mmu_free_pages;
+        mmu_free_pages = p;
+        mmu_free_count++;
+    }
+}
+
+/*
+    Batched updates. Between mmu_batch_begin and mmu_batch_commit the map, unmap and protect
+    calls only collect the TLB maintenance they need, commit does it once for all of them.
+    Batches may nest, the outermost commit flushes
+*/
+void mmu_batch_begin()
+{
+    tlb_batch++;
+}
+
+void mmu_batch_commit()
+{
+    if (--tlb_batch == 0)
+        tlb_sync();
 }
 
 uintptr_t mmu_virt2phys(uintptr_t addr)
@@ -329,6 +467,10 @@ void mirror_page(uintptr_t virt)
             asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
             tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
             tbl->mp_entries[idx_l1 + 4] = tbl->mp_entries[idx_l1];
+
+            /* The -4GB shadow stays the physical m68k space while another user table is selected */
+            if (mmu_user_alt != NULL)
+                return;
             
             /* Now fetch kernel table and update the topmost region, too */
             asm volatile("mrs %0, TTBR1_EL1":"=r"(tbl_kernel));
@@ -338,6 +480,85 @@ void mirror_page(uintptr_t virt)
     }
 }
 
+/*
+    Entries of a contiguous group have to stay identical. If one of them is about to change,
+    the hint is dropped from the whole group of 16
+*/
+static void clear_contiguous(uint64_t *entries, int idx)
+{
+    if (entries[idx] & MMU_CONTIGUOUS)
+    {
+        for (int i = idx & ~15; i < (idx & ~15) + 16; i++)
+            entries[i] &= ~MMU_CONTIGUOUS;
+
+        /* Large TLB entries of the group may cover more than the changed block */
+        tlb_flush_all();
+    }
+}
+
+#if EMU68_MMU_LARGE_PAGES
+static void put_1g_page(uintptr_t phys, uintptr_t virt, uint32_t attr_low, uint32_t attr_high)
+{
+    struct mmu_page *tbl;
+    int idx_l1;
+
+    if (virt & 0xffff000000000000) {
+        asm volatile("mrs %0, TTBR1_EL1":"=r"(tbl));
+        tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+    } else {
+        asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+        tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+    }
+
+    DMAP(kprintf("put_1g_page(%p, %p, %03x, %03x)\n", phys, virt, attr_low, attr_high));
+
+    idx_l1 = (virt >> 30) & 0x1ff;
+
+    if ((tbl->mp_entries[idx_l1] & 3) == 3)
+    {
+        struct mmu_page *l2 = (struct mmu_page *)((tbl->mp_entries[idx_l1] & 0x7ffffff000ULL) + PHYS_VIRT_OFFSET);
+        DMAP(kprintf("L1 entry was pointing to L2 directory. Freeing it now \n"));
+
+        for (int i=0; i < 512; i++)
+        {
+            if ((l2->mp_entries[i] & 3) == 3)
+                free_4k_page((void *)((l2->mp_entries[i] & 0x7ffffff000ULL) + PHYS_VIRT_OFFSET));
+        }
+
+        free_4k_page(l2);
+        tlb_flush_all();
+    }
+
+    tbl->mp_entries[idx_l1] = phys & 0x0000ffffc0000000;
+    tbl->mp_entries[idx_l1] |= attr_low | MMU_PAGE;
+    tbl->mp_entries[idx_l1] |= ((uint64_t)attr_high) << 52;
+
+    /* Mirror the block if necessary */
+    mirror_page(virt);
+
+    DMAP(kprintf("L1[%d] = %016x\n", idx_l1, tbl->mp_entries[idx_l1]));
+}
+
+/* Marks 16 consecutive 2MB blocks starting at virt as one contiguous TLB entry */
+static void set_contiguous_2m(uintptr_t virt)
+{
+    struct mmu_page *tbl;
+    int idx_l1 = (virt >> 30) & 0x1ff;
+    int idx_l2 = (virt >> 21) & 0x1ff;
+
+    if (virt & 0xffff000000000000) {
+        asm volatile("mrs %0, TTBR1_EL1":"=r"(tbl));
+    } else {
+        asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+    }
+    tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+    tbl = (struct mmu_page *)((tbl->mp_entries[idx_l1] & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+
+    for (int i = idx_l2; i < idx_l2 + 16; i++)
+        tbl->mp_entries[i] |= MMU_CONTIGUOUS;
+}
+#endif
+
 void put_2m_page(uintptr_t phys, uintptr_t virt, uint32_t attr_low, uint32_t attr_high)
 {
     struct mmu_page *tbl;
@@ -383,6 +604,7 @@ void put_2m_page(uintptr_t phys, uintptr_t virt, uint32_t attr_low, uint32_t att
             p->mp_entries[i] = (tbl_2 & 0x7fc0000fff) + (i << 21);
 
         tbl->mp_entries[idx_l1] = 3 | ((uintptr_t)p - PHYS_VIRT_OFFSET);
+        tlb_flush_all();
 
         /* Mirror the l2 if necessary */
         mirror_page(virt);
@@ -399,8 +621,11 @@ void put_2m_page(uintptr_t phys, uintptr_t virt, uint32_t attr_low, uint32_t att
         struct mmu_page *l3 = (struct mmu_page *)((p->mp_entries[idx_l2] & 0x7ffffff000ULL) + PHYS_VIRT_OFFSET);
         DMAP(kprintf("L2 entry was pointing to L3 directory. Freeing it now \n"));
         free_4k_page(l3);
+        tlb_flush_all();
     }
 
+    clear_contiguous(p->mp_entries, idx_l2);
+
     p->mp_entries[idx_l2] = phys & 0x0000ffffffe00000;
     p->mp_entries[idx_l2] |= attr_low | MMU_PAGE;
     p->mp_entries[idx_l2] |= ((uint64_t)attr_high) << 52;
@@ -454,6 +679,7 @@ void put_4k_page(uintptr_t phys, uintptr_t virt, uint32_t attr_low, uint32_t att
             p->mp_entries[i] = (tbl_2 & 0x7fc0000fff) + (i << 21);
 
         tbl->mp_entries[idx_l1] = 3 | ((uintptr_t)p - PHYS_VIRT_OFFSET);
+        tlb_flush_all();
 
         /* Mirror the l2 if necessary */
         mirror_page(virt);
@@ -485,12 +711,15 @@ void put_4k_page(uintptr_t phys, uintptr_t virt, uint32_t attr_low, uint32_t att
     {
         DMAP(kprintf("L2 is a 2MB page. Changing to L3 directory\n"));
 
+        clear_contiguous(tbl->mp_entries, idx_l2);
+
         p = get_4k_page();
 
         for (int i=0; i < 512; i++)
             p->mp_entries[i] = 3 | ((tbl_3 & 0x7fffe00fff) + (i << 12));
 
         tbl->mp_entries[idx_l2] = 3 | ((uintptr_t)p - PHYS_VIRT_OFFSET);
+        tlb_flush_all();
     }
     else
     {
@@ -510,6 +739,9 @@ void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low
 {
     DMAP(kprintf("mmu_map(%p, %p, %x, %04x00000000%04x)\n", phys, virt, length, attr_high, attr_low));
 
+    mmu_batch_begin();
+    tlb_flush_range(virt, length);
+
     /* Align virt up to 2M boundary with 4K pages */
     while ((virt & 0x1fffff) && (length >= 4096))
     {
@@ -525,6 +757,29 @@ void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low
         /* Phys was aligned. Continue pushing 2M pages */
         while (length >= 2*1024*1024)
         {
+#if EMU68_MMU_LARGE_PAGES
+            /* Both addresses at 1GB boundary, use a single L1 block */
+            if (((phys | virt) & 0x3fffffff) == 0 && length >= 0x40000000)
+            {
+                put_1g_page(phys, virt, attr_low, attr_high);
+                phys += 0x40000000;
+                virt += 0x40000000;
+                length -= 0x40000000;
+                continue;
+            }
+
+            /* Both addresses at 32MB boundary, push 16 2MB blocks sharing one TLB entry */
+            if (((phys | virt) & 0x1ffffff) == 0 && length >= 0x2000000)
+            {
+                for (int i=0; i < 16; i++)
+                    put_2m_page(phys + (i << 21), virt + (i << 21), attr_low, attr_high);
+                set_contiguous_2m(virt);
+                phys += 0x2000000;
+                virt += 0x2000000;
+                length -= 0x2000000;
+                continue;
+            }
+#endif
             put_2m_page(phys, virt, attr_low, attr_high);
             phys += 2*1024*1024;
             virt += 2*1024*1024;
@@ -541,16 +796,315 @@ void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low
         length -= 4096;
     }
 
-        asm volatile(
-"       dsb     ish                 \n"
-"       tlbi    VMALLE1IS           \n" /* Flush tlb */
-"       dsb     sy                  \n"
-"       isb                         \n");
+    mmu_batch_commit();
 }
 
+static int protect_page(uintptr_t virt, int read_only)
+{
+    struct mmu_page *tbl;
+    int idx_l1 = (virt >> 30) & 0x1ff;
+    int idx_l2 = (virt >> 21) & 0x1ff;
+    int idx_l3 = (virt >> 12) & 0x1ff;
+
+    if (virt & 0xffff000000000000)
+        return 0;
+
+    asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+    tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+
+    uint64_t tbl_2 = tbl->mp_entries[idx_l1];
+
+    if ((tbl_2 & 3) == 0)
+    {
+        return 0;
+    }
+    else if ((tbl_2 & 3) == 1)
+    {
+        DMAP(kprintf("L1 is a 1GB page. Changing to L2 directory\n"));
+
+        struct mmu_page *l2 = get_4k_page();
+
+        if (l2 == NULL)
+            return 0;
+
+        /* Keep both lower and upper attributes of the block */
+        for (int i=0; i < 512; i++)
+            l2->mp_entries[i] = (tbl_2 & 0xfff0000000000ffcULL) | ((tbl_2 & 0x0000ffffc0000000ULL) + ((uint64_t)i << 21)) | MMU_PAGE;
+
+        arm_flush_cache((intptr_t)l2, sizeof(struct mmu_page));
+
+        tbl->mp_entries[idx_l1] = 3 | ((uintptr_t)l2 - PHYS_VIRT_OFFSET);
+        tbl_2 = tbl->mp_entries[idx_l1];
+
+        /* The 4GB shadows use the same directory */
+        mirror_page(virt);
+        tlb_flush_all();
+    }
+
+    tbl = (struct mmu_page *)((tbl_2 & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+
+    uint64_t tbl_3 = tbl->mp_entries[idx_l2];
+    struct mmu_page *p = NULL;
+
+    if ((tbl_3 & 3) == 0)
+    {
+        return 0;
+    }
+    else if ((tbl_3 & 3) == 1)
+    {
+        DMAP(kprintf("L2 is a 2MB page. Changing to L3 directory\n"));
+
+        p = get_4k_page();
+
+        if (p == NULL)
+            return 0;
+
+        /* Keep both lower and upper attributes of the block, the contiguous hint belongs to L2 group */
+        for (int i=0; i < 512; i++)
+            p->mp_entries[i] = 3 | ((tbl_3 & 0xffe0000000000ffcULL) | ((tbl_3 & 0x0000ffffffe00000ULL) + (i << 12)));
+
+        arm_flush_cache((intptr_t)p, sizeof(struct mmu_page));
+
+        clear_contiguous(tbl->mp_entries, idx_l2);
+
+        tbl->mp_entries[idx_l2] = 3 | ((uintptr_t)p - PHYS_VIRT_OFFSET);
+    }
+    else
+    {
+        p = (struct mmu_page *)((tbl_3 & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+    }
+
+    if ((p->mp_entries[idx_l3] & 3) != 3)
+        return 0;
+
+    if (read_only)
+        p->mp_entries[idx_l3] |= MMU_READ_ONLY;
+    else
+        p->mp_entries[idx_l3] &= ~(uint64_t)MMU_READ_ONLY;
+
+    /* Large TLB entries of a former contiguous or 1GB block are marked for a full flush already */
+    tlb_flush_range(virt, 4096);
+
+    return 1;
+}
+
+/*
+    Change write permission of a single 4K page in the lower address space. A 2MB block
+    covering the page is split into 4K pages first. Returns 1 if the page was mapped
+    and its permissions are set now, 0 otherwise.
+*/
+int mmu_protect_page(uintptr_t virt, int read_only)
+{
+    int ret;
+
+    mmu_batch_begin();
+    ret = protect_page(virt, read_only);
+    mmu_batch_commit();
+
+    return ret;
+}
+
+/*
+    Map the 2MB block at phys at every 2MB boundary of the range in lower address space, which
+    has no mapping at all yet. The same block may back many regions this way.
+*/
+void mmu_map_unused(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low, uint32_t attr_high)
+{
+    struct mmu_page *tbl;
+
+    if (virt & 0xffff000000000000)
+        return;
+
+    asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+    tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+
+    mmu_batch_begin();
+
+    while (length >= 2*1024*1024)
+    {
+        uint64_t tbl_2 = tbl->mp_entries[(virt >> 30) & 0x1ff];
+        int used = (tbl_2 & 3) == 1;
+
+        if ((tbl_2 & 3) == 3)
+        {
+            struct mmu_page *l2 = (struct mmu_page *)((tbl_2 & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+            used = (l2->mp_entries[(virt >> 21) & 0x1ff] & 1) != 0;
+        }
+
+        if (!used)
+            put_2m_page(phys, virt, attr_low, attr_high);
+
+        virt += 2*1024*1024;
+        length -= 2*1024*1024;
+    }
+
+    tlb_flush_all();
+    mmu_batch_commit();
+}
+
+/*
+    Remove the range from lower address space. 4K pages are cleared one by one, 1GB and 2MB blocks
+    only if the range covers them completely. Short ranges are dropped from TLBs page by page
+    unless the call is a part of a larger batch
+*/
 void mmu_unmap(uintptr_t virt, uintptr_t length)
 {
-    (void)virt;
-    (void)length;
+    struct mmu_page *tbl;
+
     DMAP(kprintf("mmu_unmap(%p, %x)\n", virt, length));
+
+    if (virt & 0xffff000000000000)
+        return;
+
+    asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+    tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+
+    mmu_batch_begin();
+    tlb_flush_range(virt, length);
+
+    while (length >= 4096)
+    {
+        uint64_t *l1 = &tbl->mp_entries[(virt >> 30) & 0x1ff];
+        uintptr_t step = 4096;
+
+        if ((*l1 & 3) != 3)
+        {
+            step = 0x40000000 - (virt & 0x3fffffff);
+
+            if ((*l1 & 3) == 1 && (virt & 0x3fffffff) == 0 && length >= 0x40000000)
+            {
+                *l1 = 0;
+                mirror_page(virt);
+            }
+        }
+        else
+        {
+            struct mmu_page *l2 = (struct mmu_page *)((*l1 & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+            int idx_l2 = (virt >> 21) & 0x1ff;
+
+            if ((l2->mp_entries[idx_l2] & 3) != 3)
+            {
+                step = 0x200000 - (virt & 0x1fffff);
+
+                if ((l2->mp_entries[idx_l2] & 3) == 1 && (virt & 0x1fffff) == 0 && length >= 0x200000)
+                {
+                    clear_contiguous(l2->mp_entries, idx_l2);
+                    l2->mp_entries[idx_l2] = 0;
+                }
+            }
+            else
+            {
+                struct mmu_page *l3 = (struct mmu_page *)((l2->mp_entries[idx_l2] & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+                l3->mp_entries[(virt >> 12) & 0x1ff] = 0;
+            }
+        }
+
+        if (step >= length)
+            break;
+
+        virt += step;
+        length -= step;
+    }
+
+    mmu_batch_commit();
+}
+
+/* Empty L1 table for the lower address space, to be used with mmu_user_table_select */
+void *mmu_user_table_new()
+{
+    struct mmu_page *p = get_4k_page();
+
+    if (p)
+    {
+        for (int i=0; i < 512; i++)
+            p->mp_entries[i] = 0;
+    }
+
+    return p;
+}
+
+/* Release L1 table of mmu_user_table_new with all directories below, it must not be selected */
+void mmu_user_table_free(void *l1)
+{
+    struct mmu_page *tbl = l1;
+
+    /* Entries 4..7 are shadows of 0..3 */
+    for (int i=0; i < 512; i++)
+    {
+        if ((i >= 4 && i < 8) || (tbl->mp_entries[i] & 3) != 3)
+            continue;
+
+        struct mmu_page *l2 = (struct mmu_page *)((tbl->mp_entries[i] & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+
+        for (int j=0; j < 512; j++)
+        {
+            if ((l2->mp_entries[j] & 3) == 3)
+                free_4k_page((void *)((l2->mp_entries[j] & 0x7ffffff000) + PHYS_VIRT_OFFSET));
+        }
+
+        free_4k_page(l2);
+    }
+
+    free_4k_page(tbl);
+}
+
+/*
+    Make l1 the table of the lower address space, NULL returns to the physical m68k space set up
+    at boot. The -4GB shadow in the kernel table keeps the physical space in both cases
+*/
+void mmu_user_table_select(void *l1)
+{
+    uint64_t ttbr0;
+
+    if (l1 == mmu_user_alt)
+        return;
+
+    if (mmu_user_alt == NULL)
+        asm volatile("mrs %0, TTBR0_EL1":"=r"(mmu_user_ttbr0));
+
+    ttbr0 = l1 ? (uintptr_t)l1 - PHYS_VIRT_OFFSET : mmu_user_ttbr0;
+    mmu_user_alt = l1;
+
+    asm volatile(
+"       dsb     ish                 \n"
+"       msr     TTBR0_EL1, %0       \n"
+"       isb                         \n"
+"       tlbi    VMALLE1IS           \n"
+"       dsb     sy                  \n"
+"       isb                         \n"
+    ::"r"(ttbr0));
+}
+
+/*
+    Descriptor of the 4K page at addr in the physical m68k space. Blocks are returned as a page
+    entry with the same attributes. Returns 0 if the address is not mapped
+*/
+uint64_t mmu_user_entry(uintptr_t addr)
+{
+    struct mmu_page *tbl;
+    uint64_t e;
+
+    if (mmu_user_alt)
+        tbl = (struct mmu_page *)(mmu_user_ttbr0 + PHYS_VIRT_OFFSET);
+    else
+    {
+        asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+        tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+    }
+
+    e = tbl->mp_entries[(addr >> 30) & 0x1ff];
+    if ((e & 3) == 1)
+        return (e & 0xffe0000000000ffcULL) | ((e & 0x0000ffffc0000000ULL) + (addr & 0x3ffff000)) | 3;
+    if ((e & 3) != 3)
+        return 0;
+
+    e = ((struct mmu_page *)((e & 0x7ffffff000) + PHYS_VIRT_OFFSET))->mp_entries[(addr >> 21) & 0x1ff];
+    if ((e & 3) == 1)
+        return (e & 0xffe0000000000ffcULL) | ((e & 0x0000ffffffe00000ULL) + (addr & 0x1ff000)) | 3;
+    if ((e & 3) != 3)
+        return 0;
+
+    e = ((struct mmu_page *)((e & 0x7ffffff000) + PHYS_VIRT_OFFSET))->mp_entries[(addr >> 12) & 0x1ff];
+
+    return (e & 3) == 3 ? e : 0;
 }
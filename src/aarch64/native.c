@@ -0,0 +1,515 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "libdeflate.h"
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "M68k.h"
+#include "RegisterAllocator.h"
+#include "native.h"
+#ifdef PISTORM
+#include "ps_protocol.h"
+#include "chipshadow.h"
+#endif
+
+#if EMU68_NATIVE_CALLS
+
+/*
+    Routines run on the m68k core, within the translated code which has called them. m68k memory
+    is reached through the -4GB shadow of the kernel table, which shows the physical space. The
+    translated code stores D0-D7 and A0-A7 in the context before the call and loads them back
+    afterwards, so the routines take their arguments from there.
+*/
+
+static native_func_t native_table[EMU68_NATIVE_COUNT];
+static const char *native_names[EMU68_NATIVE_COUNT];
+static struct libdeflate_decompressor *decompressor;
+static struct libdeflate_compressor *compressor;
+static int compressor_level;
+
+/* Bytes from addr to the end of the block of m68k RAM holding it, 0 if there is no RAM */
+static uint32_t ram_left(uint32_t addr)
+{
+    for (int i=0; sys_memory[i].mb_Size; i++)
+    {
+        uintptr_t end = sys_memory[i].mb_Base + sys_memory[i].mb_Size;
+
+        if (end > 0xf2000000)
+            end = 0xf2000000;
+
+        if (addr >= sys_memory[i].mb_Base && addr < end)
+            return end - addr;
+    }
+
+    return 0;
+}
+
+static inline int area_ok(uint32_t addr, uint32_t size)
+{
+    return size == 0 || ram_left(addr) >= size;
+}
+
+/* Area the routine writes to. Translated code from there is invalidated before the write */
+static inline int dest_ok(uint32_t addr, uint32_t size)
+{
+    if (!area_ok(addr, size))
+        return 0;
+
+    M68K_HostWrite(addr, (uintptr_t)addr + size, 0);
+
+    return 1;
+}
+
+static void native_copy(struct M68KState *ctx)
+{
+    uint32_t src = ctx->A[0].u32;
+    uint32_t dst = ctx->A[1].u32;
+    uint32_t size = ctx->D[0].u32;
+
+    if (!area_ok(src, size) || !dest_ok(dst, size))
+    {
+        ctx->D[0].s32 = -1;
+        return;
+    }
+
+    memmove(M68K_PTR(dst), M68K_PTR(src), size);
+    ctx->D[0].u32 = 0;
+}
+
+static void native_fill(struct M68KState *ctx)
+{
+    uint32_t dst = ctx->A[0].u32;
+    uint32_t size = ctx->D[0].u32;
+
+    if (!dest_ok(dst, size))
+    {
+        ctx->D[0].s32 = -1;
+        return;
+    }
+
+    memset(M68K_PTR(dst), ctx->D[1].u8[3], size);
+    ctx->D[0].u32 = 0;
+}
+
+/* Length of the string, -1 if it is not terminated within its block of RAM */
+static int32_t string_length(uint32_t addr)
+{
+    uint32_t left = ram_left(addr);
+    const uint8_t *s = M68K_PTR(addr);
+
+    for (uint32_t i=0; i < left; i++)
+    {
+        if (s[i] == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static void native_strlen(struct M68KState *ctx)
+{
+    ctx->D[0].s32 = string_length(ctx->A[0].u32);
+}
+
+static void native_strcmp(struct M68KState *ctx)
+{
+    uint32_t a = ctx->A[0].u32;
+    uint32_t b = ctx->A[1].u32;
+
+    if (string_length(a) < 0 || string_length(b) < 0)
+    {
+        ctx->D[0].s32 = -1;
+        return;
+    }
+
+    ctx->D[0].s32 = strcmp((const char *)M68K_PTR(a), (const char *)M68K_PTR(b));
+}
+
+static void native_inflate(struct M68KState *ctx)
+{
+    uint32_t src = ctx->A[0].u32;
+    uint32_t src_size = ctx->D[0].u32;
+    uint32_t dst = ctx->A[1].u32;
+    uint32_t dst_size = ctx->D[1].u32;
+    size_t out_size = 0;
+    enum libdeflate_result result;
+
+    ctx->D[0].s32 = -1;
+
+    if (decompressor == NULL || !area_ok(src, src_size) || !dest_ok(dst, dst_size))
+        return;
+
+    switch (ctx->D[2].u32)
+    {
+        case NATIVE_FMT_ZLIB:
+            result = libdeflate_zlib_decompress(decompressor, M68K_PTR(src), src_size, M68K_PTR(dst), dst_size, &out_size);
+            break;
+        case NATIVE_FMT_DEFLATE:
+            result = libdeflate_deflate_decompress(decompressor, M68K_PTR(src), src_size, M68K_PTR(dst), dst_size, &out_size);
+            break;
+        case NATIVE_FMT_GZIP:
+            result = libdeflate_gzip_decompress(decompressor, M68K_PTR(src), src_size, M68K_PTR(dst), dst_size, &out_size);
+            break;
+        default:
+            return;
+    }
+
+    if (result == LIBDEFLATE_SUCCESS)
+        ctx->D[0].u32 = out_size;
+}
+
+/*
+    The compressor of the last level used is kept, allocating one takes some time and more
+    memory than the decompressor
+*/
+static struct libdeflate_compressor *get_compressor(int level)
+{
+    if (level == 0)
+        level = EMU68_NATIVE_DEFLATE_LEVEL;
+
+    if (level < 1 || level > 12)
+        return NULL;
+
+    if (compressor != NULL && compressor_level == level)
+        return compressor;
+
+    if (compressor != NULL)
+        libdeflate_free_compressor(compressor);
+
+    compressor = libdeflate_alloc_compressor(level);
+    compressor_level = level;
+
+    return compressor;
+}
+
+static void native_deflate(struct M68KState *ctx)
+{
+    uint32_t src = ctx->A[0].u32;
+    uint32_t src_size = ctx->D[0].u32;
+    uint32_t dst = ctx->A[1].u32;
+    uint32_t dst_size = ctx->D[1].u32;
+    uint32_t format = ctx->D[2].u32;
+    struct libdeflate_compressor *c = get_compressor(ctx->D[3].u32);
+    size_t out_size = 0;
+
+    ctx->D[0].s32 = -1;
+
+    if (c == NULL || format > NATIVE_FMT_GZIP)
+        return;
+
+    if (dst_size == 0)
+    {
+        if (format == NATIVE_FMT_ZLIB)
+            out_size = libdeflate_zlib_compress_bound(c, src_size);
+        else if (format == NATIVE_FMT_DEFLATE)
+            out_size = libdeflate_deflate_compress_bound(c, src_size);
+        else
+            out_size = libdeflate_gzip_compress_bound(c, src_size);
+
+        ctx->D[0].u32 = out_size;
+        return;
+    }
+
+    if (!area_ok(src, src_size) || !dest_ok(dst, dst_size))
+        return;
+
+    if (format == NATIVE_FMT_ZLIB)
+        out_size = libdeflate_zlib_compress(c, M68K_PTR(src), src_size, M68K_PTR(dst), dst_size);
+    else if (format == NATIVE_FMT_DEFLATE)
+        out_size = libdeflate_deflate_compress(c, M68K_PTR(src), src_size, M68K_PTR(dst), dst_size);
+    else
+        out_size = libdeflate_gzip_compress(c, M68K_PTR(src), src_size, M68K_PTR(dst), dst_size);
+
+    /* Zero is returned if the destination is too small */
+    if (out_size != 0)
+        ctx->D[0].u32 = out_size;
+}
+
+static void native_crc32(struct M68KState *ctx)
+{
+    uint32_t buf = ctx->A[0].u32;
+    uint32_t size = ctx->D[0].u32;
+
+    if (!area_ok(buf, size))
+    {
+        ctx->D[0].s32 = -1;
+        return;
+    }
+
+    ctx->D[0].u32 = libdeflate_crc32(ctx->D[1].u32, M68K_PTR(buf), size);
+}
+
+static void native_adler32(struct M68KState *ctx)
+{
+    uint32_t buf = ctx->A[0].u32;
+    uint32_t size = ctx->D[0].u32;
+
+    if (!area_ok(buf, size))
+    {
+        ctx->D[0].s32 = -1;
+        return;
+    }
+
+    ctx->D[0].u32 = libdeflate_adler32(ctx->D[1].u32, M68K_PTR(buf), size);
+}
+
+/* Bit p of the pixels weighted by their position and summed per 8 pixels, 16 pixels per step */
+static void c2p_row(uint8_t *d, const uint8_t *s, uint32_t blocks)
+{
+    static const uint8_t weights[16] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                                         0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+    /* v0..v7 only, the rest holds state of the m68k. Result of a step is two bytes of plane 0 to 7 */
+    asm volatile(
+        "       ld1     {v1.16b}, [%3]          \n"
+        "1:     ld1     {v0.16b}, [%1], #16     \n"
+        "       shl     v2.16b, v0.16b, #7      \n"
+        "       shl     v3.16b, v0.16b, #6      \n"
+        "       sshr    v2.16b, v2.16b, #7      \n"
+        "       sshr    v3.16b, v3.16b, #7      \n"
+        "       and     v2.16b, v2.16b, v1.16b  \n"
+        "       and     v3.16b, v3.16b, v1.16b  \n"
+        "       addp    v2.16b, v2.16b, v3.16b  \n" /* Planes 0, 1 */
+        "       shl     v3.16b, v0.16b, #5      \n"
+        "       shl     v4.16b, v0.16b, #4      \n"
+        "       sshr    v3.16b, v3.16b, #7      \n"
+        "       sshr    v4.16b, v4.16b, #7      \n"
+        "       and     v3.16b, v3.16b, v1.16b  \n"
+        "       and     v4.16b, v4.16b, v1.16b  \n"
+        "       addp    v3.16b, v3.16b, v4.16b  \n" /* Planes 2, 3 */
+        "       addp    v2.16b, v2.16b, v3.16b  \n"
+        "       shl     v3.16b, v0.16b, #3      \n"
+        "       shl     v4.16b, v0.16b, #2      \n"
+        "       sshr    v3.16b, v3.16b, #7      \n"
+        "       sshr    v4.16b, v4.16b, #7      \n"
+        "       and     v3.16b, v3.16b, v1.16b  \n"
+        "       and     v4.16b, v4.16b, v1.16b  \n"
+        "       addp    v3.16b, v3.16b, v4.16b  \n" /* Planes 4, 5 */
+        "       shl     v4.16b, v0.16b, #1      \n"
+        "       sshr    v4.16b, v4.16b, #7      \n"
+        "       sshr    v5.16b, v0.16b, #7      \n"
+        "       and     v4.16b, v4.16b, v1.16b  \n"
+        "       and     v5.16b, v5.16b, v1.16b  \n"
+        "       addp    v4.16b, v4.16b, v5.16b  \n" /* Planes 6, 7 */
+        "       addp    v3.16b, v3.16b, v4.16b  \n"
+        "       addp    v2.16b, v2.16b, v3.16b  \n"
+        "       st1     {v2.16b}, [%0], #16     \n"
+        "       subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(d), "+r"(s), "+r"(blocks):"r"(weights):"v0", "v1", "v2", "v3", "v4", "v5", "memory", "cc");
+}
+
+#ifdef PISTORM
+/* Row of a plane to CHIP RAM, 16 bytes per bus transaction where possible */
+static void chip_write(uint32_t addr, const uint8_t *s, uint32_t size)
+{
+    uint32_t start = addr;
+    uint32_t left = size;
+
+    for (; left >= 16; left -= 16, addr += 16, s += 16)
+    {
+        uint128_t v;
+
+        v.hi = *(const uint64_t *)s;
+        v.lo = *(const uint64_t *)(s + 8);
+        ps_write_128(addr, v);
+    }
+
+    for (; left >= 4; left -= 4, addr += 4, s += 4)
+        ps_write_32(addr, *(const uint32_t *)s);
+
+    if (left)
+        ps_write_16(addr, *(const uint16_t *)s);
+
+    M68K_ChipWritten(start, size);
+}
+#endif
+
+static void native_c2p(struct M68KState *ctx)
+{
+    static uint8_t steps[C2P_MAX_WIDTH] __attribute__((aligned(64)));
+    static uint8_t planes[8][C2P_MAX_WIDTH / 8] __attribute__((aligned(64)));
+    uint32_t src = ctx->A[0].u32;
+    uint32_t dst = ctx->A[1].u32;
+    uint32_t width = ctx->D[0].u32;
+    uint32_t height = ctx->D[1].u32;
+    uint32_t depth = ctx->D[2].u32;
+    uint32_t plane_offset = ctx->D[3].u32;
+    uint32_t dst_pitch = ctx->D[4].u32;
+    uint32_t src_pitch = ctx->D[5].u32 ? ctx->D[5].u32 : width;
+    uint32_t row_bytes = width / 8;
+#ifdef PISTORM
+    int chip = 0;
+#endif
+
+    ctx->D[0].s32 = -1;
+
+    if ((width & 15) || width > C2P_MAX_WIDTH || depth < 1 || depth > 8 || ((dst | plane_offset | dst_pitch) & 1))
+        return;
+
+    if (width == 0 || height == 0)
+    {
+        ctx->D[0].u32 = 0;
+        return;
+    }
+
+    uint64_t src_size = (uint64_t)src_pitch * (height - 1) + width;
+    uint64_t dst_size = (uint64_t)plane_offset * (depth - 1) + (uint64_t)dst_pitch * (height - 1) + row_bytes;
+
+    if (src_size > 0xffffffff || dst_size > 0xffffffff || !area_ok(src, src_size))
+        return;
+
+    if (!dest_ok(dst, dst_size))
+    {
+#ifdef PISTORM
+        if (dst + dst_size > 0x200000 || ChipShadow_Overlaps(dst, dst_size))
+            return;
+
+        chip = 1;
+#else
+        return;
+#endif
+    }
+
+    for (uint32_t y=0; y < height; y++)
+    {
+        c2p_row(steps, M68K_PTR(src + y * src_pitch), width / 16);
+
+        /* Two bytes of each plane per step */
+        for (uint32_t i=0; i < width / 16; i++)
+        {
+            for (uint32_t p=0; p < depth; p++)
+            {
+                planes[p][2*i] = steps[16*i + 2*p];
+                planes[p][2*i + 1] = steps[16*i + 2*p + 1];
+            }
+        }
+
+        for (uint32_t p=0; p < depth; p++)
+        {
+            uint32_t addr = dst + p * plane_offset + y * dst_pitch;
+
+#ifdef PISTORM
+            if (chip)
+            {
+                chip_write(addr, planes[p], row_bytes);
+                continue;
+            }
+#endif
+            memcpy(M68K_PTR(addr), planes[p], row_bytes);
+        }
+    }
+
+    ctx->D[0].u32 = 0;
+}
+
+/* Area lies in one block of m68k RAM, for routines registered outside of this file */
+int Native_AreaOK(uint32_t addr, uint32_t size)
+{
+    return area_ok(addr, size);
+}
+
+/* Put the routine into the given slot. Returns 0 if the slot is out of range or taken */
+int Native_Register(uint16_t slot, native_func_t func, const char *name)
+{
+    if (slot >= EMU68_NATIVE_COUNT || native_table[slot] != NULL)
+        return 0;
+
+    native_table[slot] = func;
+    native_names[slot] = name;
+
+    return 1;
+}
+
+/* Routine for the LINE A opcode, NULL if there is none */
+native_func_t Native_Find(uint16_t opcode)
+{
+    uint16_t slot = opcode - EMU68_NATIVE_BASE;
+
+    if (slot >= EMU68_NATIVE_COUNT)
+        return NULL;
+
+    return native_table[slot];
+}
+
+/* Register the built-in routines and advertise the opcode range to the m68k */
+void Native_Setup()
+{
+    uint32_t reg[] = { EMU68_NATIVE_BASE, EMU68_NATIVE_COUNT };
+
+    decompressor = libdeflate_alloc_decompressor();
+
+    Native_Register(NATIVE_COPY, native_copy, "copy");
+    Native_Register(NATIVE_FILL, native_fill, "fill");
+    Native_Register(NATIVE_STRLEN, native_strlen, "strlen");
+    Native_Register(NATIVE_STRCMP, native_strcmp, "strcmp");
+    Native_Register(NATIVE_INFLATE, native_inflate, "inflate");
+    Native_Register(NATIVE_DEFLATE, native_deflate, "deflate");
+    Native_Register(NATIVE_CRC32, native_crc32, "crc32");
+    Native_Register(NATIVE_ADLER32, native_adler32, "adler32");
+    Native_Register(NATIVE_C2P, native_c2p, "c2p");
+
+    dt_add_property(dt_find_node("/emu68"), "native-calls", reg, sizeof(reg));
+
+    kprintf("[BOOT] Native calls at LINE A %04x-%04x:", EMU68_NATIVE_BASE, EMU68_NATIVE_BASE + EMU68_NATIVE_COUNT - 1);
+
+    for (int i=0; i < EMU68_NATIVE_COUNT; i++)
+    {
+        if (native_table[i])
+            kprintf(" %s", native_names[i]);
+    }
+
+    kprintf("\n");
+}
+
+/*
+    Call func(ctx) from translated code. All m68k registers go to the context and are loaded
+    back from there, so that the routine sees and may change them. A7 is stored only
+*/
+uint32_t *EMIT_NativeCall(uint32_t *ptr, native_func_t func)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+    uint8_t regs[16];
+    uint8_t ctx = RA_GetCTX(&ptr);
+
+    u.u64 = (uintptr_t)func;
+
+    for (int i=0; i < 16; i++)
+        regs[i] = RA_MapM68kRegister(&ptr, i);
+
+    for (int i=0; i < 16; i+=2)
+        *ptr++ = stp(ctx, regs[i], regs[i+1], __builtin_offsetof(struct M68KState, D[0]) + 4*i);
+
+    ptr = EMIT_SaveRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+
+    *ptr++ = mov64_reg(0, ctx);
+    *ptr++ = mov64_immed_u16(1, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(1, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(1, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(1, u.u16[0], 3);
+    *ptr++ = blr(1);
+
+    ptr = EMIT_RestoreRegFrame(ptr, RA_GetCallSaveMask(CALL_CLOBBER_AAPCS));
+
+    for (int i=0; i < 14; i+=2)
+        *ptr++ = ldp(ctx, regs[i], regs[i+1], __builtin_offsetof(struct M68KState, D[0]) + 4*i);
+    *ptr++ = ldr_offset(ctx, regs[14], __builtin_offsetof(struct M68KState, A[6]));
+
+    for (int i=0; i < 15; i++)
+        RA_SetDirtyM68kRegister(&ptr, i);
+
+    return ptr;
+}
+
+#endif
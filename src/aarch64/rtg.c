@@ -0,0 +1,508 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "mmu.h"
+#include "M68k.h"
+#include "rtg.h"
+
+#if EMU68_RTG_SERVICE
+
+/*
+    The service reaches m68k memory through the -4GB shadow of the kernel table, which shows the
+    physical m68k space with the same attributes the m68k uses, also while its MMU is enabled.
+    Rows are processed with NEON where the format pair has a kernel, the rest goes pixel by pixel.
+*/
+
+static struct RTGQueue *queue;
+static uint32_t vc4_lo;
+static uint32_t vc4_hi;
+
+static const uint8_t bytes_per_pixel[RTGF_COUNT] = { 1, 2, 2, 4, 4 };
+
+/* Registers 28..31 are reserved for the JIT, the kernels below use v0..v7 only */
+
+static void fill_row(uint8_t *d, uint32_t bytes, uint32_t pattern)
+{
+    uint32_t blocks = bytes >> 6;
+
+    if (blocks)
+    {
+        asm volatile(
+            "       dup     v0.4s, %w2              \n"
+            "       mov     v1.16b, v0.16b          \n"
+            "       mov     v2.16b, v0.16b          \n"
+            "       mov     v3.16b, v0.16b          \n"
+            "1:     st1     {v0.4s-v3.4s}, [%0], #64 \n"
+            "       subs    %1, %1, #1              \n"
+            "       b.ne    1b                      \n"
+            :"+r"(d), "+r"(blocks):"r"(pattern):"v0", "v1", "v2", "v3", "memory", "cc");
+
+        bytes &= 63;
+    }
+
+    for (; bytes >= 4; bytes -= 4, d += 4)
+        *(uint32_t *)d = pattern;
+
+    for (int i=0; bytes; bytes--, i++)
+        *d++ = pattern >> (24 - 8 * i);
+}
+
+static void invert_row(uint8_t *d, uint32_t bytes)
+{
+    uint32_t blocks = bytes >> 4;
+
+    if (blocks)
+    {
+        asm volatile(
+            "1:     ld1     {v0.16b}, [%0]          \n"
+            "       not     v0.16b, v0.16b          \n"
+            "       st1     {v0.16b}, [%0], #16     \n"
+            "       subs    %1, %1, #1              \n"
+            "       b.ne    1b                      \n"
+            :"+r"(d), "+r"(blocks)::"v0", "memory", "cc");
+
+        bytes &= 15;
+    }
+
+    while (bytes--)
+    {
+        *d = ~*d;
+        d++;
+    }
+}
+
+/* 5-6-5 to 8-8-8-8 words, 8 pixels per step. Byte loads show the 16-bit lanes in little endian order */
+static uint32_t rgb16_to_32(uint8_t *d, const uint8_t *s, uint32_t pixels, int src_pc, int dst_bgra)
+{
+    uint32_t blocks = pixels >> 3;
+
+    if (blocks == 0)
+        return 0;
+
+    asm volatile(
+        "       movi    v7.8b, #0xff            \n"
+        "1:     cbz     %w3, 2f                 \n"
+        "       ld1     {v0.16b}, [%1], #16     \n"
+        "       b       3f                      \n"
+        "2:     ld1     {v0.8h}, [%1], #16      \n"
+        "3:     ushr    v1.8h, v0.8h, #11       \n"
+        "       shl     v2.8h, v0.8h, #5        \n"
+        "       ushr    v2.8h, v2.8h, #10       \n"
+        "       shl     v3.8h, v0.8h, #11       \n"
+        "       ushr    v3.8h, v3.8h, #11       \n"
+        "       xtn     v1.8b, v1.8h            \n"
+        "       xtn     v2.8b, v2.8h            \n"
+        "       xtn     v3.8b, v3.8h            \n"
+        "       shl     v4.8b, v1.8b, #3        \n"
+        "       sri     v4.8b, v4.8b, #5        \n" /* R */
+        "       shl     v5.8b, v2.8b, #2        \n"
+        "       sri     v5.8b, v5.8b, #6        \n" /* G */
+        "       shl     v6.8b, v3.8b, #3        \n"
+        "       sri     v6.8b, v6.8b, #5        \n" /* B */
+        "       cbz     %w4, 4f                 \n"
+        "       mov     v0.8b, v6.8b            \n" /* B, G, R, A */
+        "       mov     v1.8b, v5.8b            \n"
+        "       mov     v2.8b, v4.8b            \n"
+        "       mov     v3.8b, v7.8b            \n"
+        "       st4     {v0.8b-v3.8b}, [%0], #32 \n"
+        "       b       5f                      \n"
+        "4:     mov     v0.8b, v7.8b            \n" /* A, R, G, B */
+        "       mov     v1.8b, v4.8b            \n"
+        "       mov     v2.8b, v5.8b            \n"
+        "       mov     v3.8b, v6.8b            \n"
+        "       st4     {v0.8b-v3.8b}, [%0], #32 \n"
+        "5:     subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(d), "+r"(s), "+r"(blocks):"r"(src_pc), "r"(dst_bgra):"v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "memory", "cc");
+
+    return pixels & ~7;
+}
+
+/* 8-8-8-8 words to 5-6-5, 8 pixels per step */
+static uint32_t rgb32_to_16(uint8_t *d, const uint8_t *s, uint32_t pixels, int src_bgra, int dst_pc)
+{
+    uint32_t blocks = pixels >> 3;
+
+    if (blocks == 0)
+        return 0;
+
+    asm volatile(
+        "1:     ld4     {v0.8b-v3.8b}, [%1], #32 \n"
+        "       cbz     %w3, 2f                 \n"
+        "       ushll   v4.8h, v2.8b, #8        \n" /* B, G, R, A */
+        "       ushll   v5.8h, v1.8b, #8        \n"
+        "       ushll   v6.8h, v0.8b, #8        \n"
+        "       b       3f                      \n"
+        "2:     ushll   v4.8h, v1.8b, #8        \n" /* A, R, G, B */
+        "       ushll   v5.8h, v2.8b, #8        \n"
+        "       ushll   v6.8h, v3.8b, #8        \n"
+        "3:     sri     v4.8h, v5.8h, #5        \n"
+        "       sri     v4.8h, v6.8h, #11       \n"
+        "       cbz     %w4, 4f                 \n"
+        "       st1     {v4.16b}, [%0], #16     \n"
+        "       b       5f                      \n"
+        "4:     st1     {v4.8h}, [%0], #16      \n"
+        "5:     subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(d), "+r"(s), "+r"(blocks):"r"(src_bgra), "r"(dst_pc):"v0", "v1", "v2", "v3", "v4", "v5", "v6", "memory", "cc");
+
+    return pixels & ~7;
+}
+
+/* Byte order swap of 16-bit (size 1) or 32-bit (size 2) pixels, 16 bytes per step */
+static uint32_t swap_row(uint8_t *d, const uint8_t *s, uint32_t bytes, int size)
+{
+    uint32_t blocks = bytes >> 4;
+
+    if (blocks == 0)
+        return 0;
+
+    asm volatile(
+        "1:     ld1     {v0.16b}, [%1], #16     \n"
+        "       cmp     %w3, #1                 \n"
+        "       b.ne    2f                      \n"
+        "       rev16   v0.16b, v0.16b          \n"
+        "       b       3f                      \n"
+        "2:     rev32   v0.16b, v0.16b          \n"
+        "3:     st1     {v0.16b}, [%0], #16     \n"
+        "       subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(d), "+r"(s), "+r"(blocks):"r"(size):"v0", "memory", "cc");
+
+    return bytes & ~15;
+}
+
+/* Pixel as 0xAARRGGBB */
+static inline uint32_t load_pixel(const uint8_t *p, int fmt, const uint32_t *clut)
+{
+    uint32_t c;
+
+    switch (fmt)
+    {
+        case RTGF_CLUT8:
+            return clut[*p];
+        case RTGF_RGB16:
+        case RTGF_RGB16PC:
+            c = fmt == RTGF_RGB16 ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+            return 0xff000000 | ((c & 0xf800) << 8) | ((c & 0xe000) << 3) | ((c & 0x07e0) << 5) |
+                ((c & 0x0600) >> 1) | ((c & 0x001f) << 3) | ((c & 0x001c) >> 2);
+        case RTGF_ARGB32:
+            return *(const uint32_t *)p;
+        default:
+            return __builtin_bswap32(*(const uint32_t *)p);
+    }
+}
+
+static inline void store_pixel(uint8_t *p, int fmt, uint32_t c)
+{
+    uint32_t w;
+
+    switch (fmt)
+    {
+        case RTGF_RGB16:
+        case RTGF_RGB16PC:
+            w = ((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f);
+            p[fmt == RTGF_RGB16 ? 0 : 1] = w >> 8;
+            p[fmt == RTGF_RGB16 ? 1 : 0] = w;
+            break;
+        case RTGF_ARGB32:
+            *(uint32_t *)p = c;
+            break;
+        case RTGF_BGRA32:
+            *(uint32_t *)p = __builtin_bswap32(c);
+            break;
+    }
+}
+
+static void convert_row(uint8_t *d, int dfmt, const uint8_t *s, int sfmt, uint32_t width, const uint32_t *clut)
+{
+    uint32_t done = 0;
+
+    if (sfmt == dfmt)
+    {
+        memmove(d, s, width * bytes_per_pixel[dfmt]);
+        return;
+    }
+
+    if ((sfmt == RTGF_RGB16 || sfmt == RTGF_RGB16PC) && (dfmt == RTGF_RGB16 || dfmt == RTGF_RGB16PC))
+        done = swap_row(d, s, width * 2, 1) / 2;
+    else if ((sfmt == RTGF_ARGB32 || sfmt == RTGF_BGRA32) && (dfmt == RTGF_ARGB32 || dfmt == RTGF_BGRA32))
+        done = swap_row(d, s, width * 4, 2) / 4;
+    else if ((sfmt == RTGF_RGB16 || sfmt == RTGF_RGB16PC) && dfmt >= RTGF_ARGB32)
+        done = rgb16_to_32(d, s, width, sfmt == RTGF_RGB16PC, dfmt == RTGF_BGRA32);
+    else if (sfmt >= RTGF_ARGB32 && (dfmt == RTGF_RGB16 || dfmt == RTGF_RGB16PC))
+        done = rgb32_to_16(d, s, width, sfmt == RTGF_BGRA32, dfmt == RTGF_RGB16PC);
+
+    d += done * bytes_per_pixel[dfmt];
+    s += done * bytes_per_pixel[sfmt];
+
+    for (; done < width; done++)
+    {
+        store_pixel(d, dfmt, load_pixel(s, sfmt, clut));
+        d += bytes_per_pixel[dfmt];
+        s += bytes_per_pixel[sfmt];
+    }
+}
+
+/* Nearest neighbour samples of a source row, step is 16.16 fixed point */
+static void scale_row(uint8_t *d, const uint8_t *s, uint32_t width, uint32_t step, int bpp)
+{
+    uint32_t x = 0;
+
+    switch (bpp)
+    {
+        case 1:
+            for (uint32_t i=0; i < width; i++, x += step)
+                d[i] = s[x >> 16];
+            break;
+        case 2:
+            for (uint32_t i=0; i < width; i++, x += step)
+                ((uint16_t *)d)[i] = ((const uint16_t *)s)[x >> 16];
+            break;
+        default:
+            for (uint32_t i=0; i < width; i++, x += step)
+                ((uint32_t *)d)[i] = ((const uint32_t *)s)[x >> 16];
+            break;
+    }
+}
+
+/* Area has to lie in VC4 memory or in a block of m68k RAM */
+static int area_ok(uint32_t addr, uint32_t pitch, uint32_t row_bytes, uint32_t height)
+{
+    uint64_t start = addr;
+    uint64_t end = start + (uint64_t)pitch * (height - 1) + row_bytes;
+
+    if (end > 0x100000000ULL)
+        return 0;
+
+    if (start >= vc4_lo && end <= vc4_hi)
+        return 1;
+
+    for (int i=0; sys_memory[i].mb_Size; i++)
+    {
+        if (start >= sys_memory[i].mb_Base && end <= sys_memory[i].mb_Base + sys_memory[i].mb_Size &&
+            end <= 0xf2000000)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Palette of CLUT8 source converted to another format, 0 if it is not accessible */
+static int load_clut(uint32_t *clut, const struct RTGCommand *c, int sfmt, int dfmt)
+{
+    if (sfmt == RTGF_CLUT8 && dfmt != RTGF_CLUT8)
+    {
+        if (!area_ok(c->rc_Color, 1024, 1024, 1))
+            return 0;
+
+        const uint32_t *pal = (const uint32_t *)M68K_PTR(c->rc_Color);
+        for (int i=0; i < 256; i++)
+            clut[i] = pal[i];
+    }
+
+    return 1;
+}
+
+static int run_command(const struct RTGCommand *c)
+{
+    int sfmt = c->rc_SrcFormat;
+    int dfmt = c->rc_DstFormat;
+    uint32_t width = c->rc_Width;
+    uint32_t height = c->rc_Height;
+    uint32_t clut[256];
+    static uint8_t line[RTG_SCALE_WIDTH * 4] __attribute__((aligned(64)));
+
+    if (c->rc_Op == RTG_NOP || width == 0 || height == 0)
+        return 1;
+
+    if (dfmt >= RTGF_COUNT)
+        return 0;
+
+    if (c->rc_Op != RTG_CONVERT && c->rc_Op != RTG_SCALE)
+        sfmt = dfmt;
+    else if (sfmt >= RTGF_COUNT || (dfmt == RTGF_CLUT8 && sfmt != RTGF_CLUT8))
+        return 0;
+
+    uint32_t drow = width * bytes_per_pixel[dfmt];
+    uint32_t srow = width * bytes_per_pixel[sfmt];
+
+    if (!area_ok(c->rc_Dst, c->rc_DstPitch, drow, height))
+        return 0;
+
+    /* m68k core may run code translated from the destination, it is invalidated first */
+    M68K_HostWrite(c->rc_Dst, (uintptr_t)c->rc_Dst + (uint64_t)c->rc_DstPitch * (height - 1) + drow, 1);
+
+    uint8_t *d = M68K_PTR(c->rc_Dst);
+
+    switch (c->rc_Op)
+    {
+        case RTG_FILL:
+        {
+            uint32_t pattern = c->rc_Color;
+
+            if (dfmt == RTGF_CLUT8)
+                pattern = (pattern & 0xff) * 0x01010101;
+            else if (bytes_per_pixel[dfmt] == 2)
+                pattern = (pattern & 0xffff) * 0x00010001;
+
+            for (uint32_t y=0; y < height; y++, d += c->rc_DstPitch)
+                fill_row(d, drow, pattern);
+
+            return 1;
+        }
+
+        case RTG_INVERT:
+            for (uint32_t y=0; y < height; y++, d += c->rc_DstPitch)
+                invert_row(d, drow);
+
+            return 1;
+
+        case RTG_COPY:
+        case RTG_CONVERT:
+        {
+            if (!area_ok(c->rc_Src, c->rc_SrcPitch, srow, height))
+                return 0;
+
+            const uint8_t *s = M68K_PTR(c->rc_Src);
+            int32_t dpitch = c->rc_DstPitch;
+            int32_t spitch = c->rc_SrcPitch;
+
+            if (!load_clut(clut, c, sfmt, dfmt))
+                return 0;
+
+            /* Moving down within one surface, go from the bottom row up */
+            if (c->rc_Dst > c->rc_Src && sfmt == dfmt && c->rc_Dst < c->rc_Src + spitch * (height - 1) + srow)
+            {
+                d += dpitch * (height - 1);
+                s += spitch * (height - 1);
+                dpitch = -dpitch;
+                spitch = -spitch;
+            }
+
+            for (uint32_t y=0; y < height; y++, d += dpitch, s += spitch)
+                convert_row(d, dfmt, s, sfmt, width, clut);
+
+            return 1;
+        }
+
+        case RTG_SCALE:
+        {
+            uint32_t sw = c->rc_SrcWidth;
+            uint32_t sh = c->rc_SrcHeight;
+            uint32_t last = ~0U;
+
+            if (sw == 0 || sh == 0 || width > RTG_SCALE_WIDTH)
+                return 0;
+
+            if (!area_ok(c->rc_Src, c->rc_SrcPitch, sw * bytes_per_pixel[sfmt], sh) || !load_clut(clut, c, sfmt, dfmt))
+                return 0;
+
+            /* 16.16 steps, sh << 16 fits in 32 bits so y * ystep does too */
+            uint32_t xstep = (sw << 16) / width;
+            uint32_t ystep = (sh << 16) / height;
+
+            for (uint32_t y=0; y < height; y++, d += c->rc_DstPitch)
+            {
+                uint32_t sy = (y * ystep) >> 16;
+                const uint8_t *s = M68K_PTR(c->rc_Src) + sy * c->rc_SrcPitch;
+
+                /* Rows repeated when scaling up are sampled once, conversion reads the line buffer */
+                if (sw != width)
+                {
+                    if (sy != last)
+                        scale_row(line, s, width, xstep, bytes_per_pixel[sfmt]);
+                    s = line;
+                    last = sy;
+                }
+
+                convert_row(d, dfmt, s, sfmt, width, clut);
+            }
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+    Put the queue at the end of VC4 memory, which is mapped for the m68k already. Returns the number
+    of bytes taken from VC4 memory
+*/
+uintptr_t RTG_Setup(uintptr_t vc4_base, uintptr_t vc4_size)
+{
+    uintptr_t base = vc4_base + vc4_size - EMU68_RTG_QUEUE_SIZE;
+    uint32_t reg[] = { base, EMU68_RTG_QUEUE_SIZE };
+
+    if (vc4_size < 2 * EMU68_RTG_QUEUE_SIZE)
+        return 0;
+
+    queue = (struct RTGQueue *)M68K_PTR(base);
+    vc4_lo = vc4_base;
+    vc4_hi = base;
+
+    bzero(queue, EMU68_RTG_QUEUE_SIZE);
+    queue->rq_Magic = RTG_QUEUE_MAGIC;
+    queue->rq_Version = RTG_QUEUE_VERSION;
+    queue->rq_Slots = (EMU68_RTG_QUEUE_SIZE - sizeof(struct RTGQueue)) / sizeof(struct RTGCommand);
+
+    dt_add_property(dt_find_node("/emu68"), "rtg-queue", reg, sizeof(reg));
+
+    kprintf("[BOOT] RTG service queue at %08x, %d slots\n", base, queue->rq_Slots);
+
+    return EMU68_RTG_QUEUE_SIZE;
+}
+
+/* Main loop of the service core, the timer event stream wakes it up to look for new commands */
+void RTG_ServiceTask()
+{
+    uint64_t freq, cntkctl;
+    uint32_t evnti = 0;
+    uint32_t tail;
+
+    if (queue == NULL)
+        return;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+    /* Event on rising edge of counter bit evnti, rate is freq / 2^(evnti + 1) */
+    while (evnti < 15 && (2ULL << (evnti + 1)) <= freq / EMU68_RTG_POLL_HZ)
+        evnti++;
+
+    asm volatile("mrs %0, CNTKCTL_EL1":"=r"(cntkctl));
+    cntkctl = (cntkctl & ~0xf0ULL) | (1 << 2) | (evnti << 4);
+    asm volatile("msr CNTKCTL_EL1, %0; isb"::"r"(cntkctl));
+
+    kprintf("[RTG] Service running, polling every %d us\n", (uint32_t)(((2ULL << evnti) * 1000000) / freq));
+
+    tail = queue->rq_Tail;
+
+    while (1)
+    {
+        struct RTGCommand cmd;
+
+        while (tail == __atomic_load_n(&queue->rq_Head, __ATOMIC_ACQUIRE))
+            asm volatile("wfe");
+
+        /* Own copy, the m68k may reuse the slot as soon as the tail moves */
+        cmd = queue->rq_Cmd[tail % queue->rq_Slots];
+
+        if (!run_command(&cmd))
+            __atomic_store_n(&queue->rq_Errors, queue->rq_Errors + 1, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&queue->rq_Tail, ++tail, __ATOMIC_RELEASE);
+    }
+}
+
+#endif
@@ -28,6 +28,13 @@
 #include "version.h"
 #include "cache.h"
 #include "sponsoring.h"
+#include "trace.h"
+#include "jitstats.h"
+#include "buslog.h"
+#include "rtg.h"
+#include "mixer.h"
+#include "native.h"
+#include "chipshadow.h"
 
 void _start();
 void _boot();
@@ -62,7 +69,7 @@ asm("   .section .startup           \n"
 
 "_start:                            \n"
 "       mrs     x9, MPIDR_EL1       \n" /* Non BSP cores should be sleeping, but put them to sleep if case they were not */
-"       ands    x9, x9, #3          \n"
+"       ands    x9, x9, #0xffff     \n"
 "       b.eq    2f                  \n"
 "1:     wfe                         \n"
 "       b 1b                        \n"
@@ -308,14 +315,70 @@ int dbf_slowdown;
 int emu68_icnt = EMU68_M68K_INSN_DEPTH;
 int emu68_ccrd = EMU68_CCR_SCAN_DEPTH;
 int emu68_irng = EMU68_BRANCH_INLINE_DISTANCE;
+static uint32_t jit_pages;
 
 #ifdef PISTORM
 static int blitwait;
+static int smc_protect;
+static int adaptive_jit;
+static int fpu_relaxed;
+#if EMU68_LOOP_PACING
+static int loop_pacing;
+#endif
+#if EMU68_IDLE_WAIT
+static int idle_wait;
+#endif
+#if EMU68_NATIVE_CALLS
+static int native_calls;
+#endif
+#if EMU68_TRANSLATE_AHEAD
+static int translate_ahead;
+#endif
+static int profile;
+#if EMU68_M68K_MMU
+static int m68k_mmu;
+#endif
+#if EMU68_RTG_SERVICE
+static int rtg_service;
+#endif
+#if EMU68_MIX_SERVICE
+static int mix_service;
+#endif
 #endif
 extern const char _verstring_object[];
 
+#if defined(PISTORM) && EMU68_Z3_PATTERN_BLOCK
+extern const uint64_t SYSUnmappedPattern[5];
+
+/*
+    Reads from unused Z3 space return a fixed pattern. Instead of taking a data abort for
+    every such read, back all unused 2MB blocks with one read-only block holding the same
+    pattern. Writes still fault and are ignored by the bus emulation.
+*/
+static void MapUnusedZ3()
+{
+    uint8_t *block = tlsf_malloc_aligned(tlsf, 2*1024*1024, 2*1024*1024);
+    const uint8_t *pattern = (const uint8_t *)SYSUnmappedPattern;
+
+    if (block == NULL)
+    {
+        kprintf("[BOOT] No memory for Z3 pattern block\n");
+        return;
+    }
+
+    for (int i=0; i < 2*1024*1024; i++)
+        block[i] = pattern[1 + (i & 15)];
+
+    arm_flush_cache((intptr_t)block, 2*1024*1024);
+
+    mmu_map_unused(mmu_virt2phys((intptr_t)block), 0x01000000, 0xf2000000 - 0x01000000,
+                   MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+}
+#endif
+
 #ifdef PISTORM
 #include "ps_protocol.h"
+#include "boards.h"
 #endif
 
 void _secondary_start();
@@ -396,18 +459,280 @@ asm(
 volatile uint64_t temp_stack;
 volatile uint8_t boot_lock;
 
+#if EMU68_BOOT_JOBS
+/*
+    Boot jobs. Stages of the boot which do not depend on the rest, like drawing the logo or
+    copying the ROM image, are queued by CPU0 and picked up by the secondary CPUs. These
+    stay in the queue until boot_jobs_end, then take their runtime roles. CPU0 runs jobs
+    too while it waits for them. A job must not allocate memory or write to the log, these
+    are not safe against CPU0 or may wait for the log CPU.
+
+    The write buffer CPU of classic PiStorm does not take jobs, CPU0 may need it already.
+*/
+struct BootJob {
+    void    (*bj_Func)(void *);
+    void *  bj_Arg;
+};
+
+static struct BootJob boot_jobs[EMU68_BOOT_JOB_SLOTS];
+static uint32_t boot_job_head;
+static uint32_t boot_job_tail;
+static uint32_t boot_job_done;
+static uint8_t boot_jobs_closed;
+
+/* Take one queued job and run it. Returns 0 if the queue was empty */
+static int boot_job_run()
+{
+    uint32_t tail = __atomic_load_n(&boot_job_tail, __ATOMIC_RELAXED);
+
+    while (tail < __atomic_load_n(&boot_job_head, __ATOMIC_ACQUIRE))
+    {
+        if (__atomic_compare_exchange_n(&boot_job_tail, &tail, tail + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            boot_jobs[tail].bj_Func(boot_jobs[tail].bj_Arg);
+            __atomic_add_fetch(&boot_job_done, 1, __ATOMIC_RELEASE);
+            asm volatile("sev");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void boot_jobs_helper()
+{
+    while (!__atomic_load_n(&boot_jobs_closed, __ATOMIC_ACQUIRE))
+    {
+        if (!boot_job_run())
+            asm volatile("wfe");
+    }
+}
+
+/* Queue job, it is run right away if the queue is full or closed already */
+void boot_job(void (*func)(void *), void *arg)
+{
+    uint32_t slot = boot_job_head;
+
+    if (boot_jobs_closed || slot == EMU68_BOOT_JOB_SLOTS)
+    {
+        func(arg);
+        return;
+    }
+
+    boot_jobs[slot].bj_Func = func;
+    boot_jobs[slot].bj_Arg = arg;
+    __atomic_store_n(&boot_job_head, slot + 1, __ATOMIC_RELEASE);
+    asm volatile("dsb ishst; sev");
+}
+
+/* Wait until all jobs queued so far are done */
+void boot_jobs_wait()
+{
+    while (__atomic_load_n(&boot_job_done, __ATOMIC_ACQUIRE) != boot_job_head)
+    {
+        if (!boot_job_run())
+            asm volatile("wfe");
+    }
+}
+
+/* Wait for the jobs and let secondary CPUs go to their runtime roles */
+static void boot_jobs_end()
+{
+    boot_jobs_wait();
+    __atomic_store_n(&boot_jobs_closed, 1, __ATOMIC_RELEASE);
+    asm volatile("dsb ishst; sev");
+}
+#else
+void boot_job(void (*func)(void *), void *arg)
+{
+    func(arg);
+}
+
+void boot_jobs_wait()
+{
+}
+
+static inline void boot_jobs_end()
+{
+}
+#endif
+
+#ifdef PISTORM
+struct CopyJob {
+    void *          cj_Dst;
+    const void *    cj_Src;
+    uint32_t        cj_Size;
+};
+
+static void copy_job(void *arg)
+{
+    struct CopyJob *j = arg;
+
+    DuffCopy(j->cj_Dst, j->cj_Src, j->cj_Size / 4);
+}
+
+static void boot_copy(struct CopyJob *j, void *dst, const void *src, uint32_t size)
+{
+    j->cj_Dst = dst;
+    j->cj_Src = src;
+    j->cj_Size = size;
+
+    boot_job(copy_job, j);
+}
+#endif
+
 void serial_writer();
 
+/* Name of the core from MIDR_EL1, for the log */
+static const char *cpu_name()
+{
+    uint64_t midr;
+
+    asm volatile("mrs %0, MIDR_EL1":"=r"(midr));
+
+    switch ((midr >> 4) & 0xfff)
+    {
+        case 0xd03: return "Cortex-A53";
+        case 0xd04: return "Cortex-A35";
+        case 0xd05: return "Cortex-A55";
+        case 0xd07: return "Cortex-A57";
+        case 0xd08: return "Cortex-A72";
+        case 0xd0b: return "Cortex-A76";
+        default:    return "unknown core";
+    }
+}
+
+#if EMU68_BIG_CORE
+/*
+    On big.LITTLE machines, e.g. RK3399 with two Cortex-A72 next to four Cortex-A53, the boot
+    core may be a little one. The m68k emulation is moved to the core with the largest
+    capacity-dmips-mhz in the device tree then. It is started through PSCI, the boot core
+    stays behind as the translation worker if one is requested, or sleeps
+*/
+static volatile uint8_t big_core_start;
+static void *big_core_addr;
+static void *big_core_fdt;
+
+static uint64_t psci_call(int hvc, uint64_t fn, uint64_t arg1, uint64_t arg2, uint64_t arg3)
+{
+    register uint64_t x0 asm("x0") = fn;
+    register uint64_t x1 asm("x1") = arg1;
+    register uint64_t x2 asm("x2") = arg2;
+    register uint64_t x3 asm("x3") = arg3;
+
+    if (hvc)
+        asm volatile("hvc #0":"+r"(x0):"r"(x1),"r"(x2),"r"(x3):"memory");
+    else
+        asm volatile("smc #0":"+r"(x0):"r"(x1),"r"(x2),"r"(x3):"memory");
+
+    return x0;
+}
+
+/* MPIDR of the fastest core if it is faster than the running one and PSCI can start it, -1 otherwise */
+static uint64_t find_big_core(int *hvc)
+{
+    of_node_t *cpus = dt_find_node("/cpus");
+    of_property_t *p = dt_find_property(dt_find_node("/psci"), "method");
+    uint64_t self, best = -1;
+    uint32_t self_capacity = 0, best_capacity = 0;
+
+    if (cpus == NULL || p == NULL)
+        return -1;
+
+    *hvc = !strcmp(p->op_value, "hvc");
+
+    asm volatile("mrs %0, MPIDR_EL1":"=r"(self));
+    self &= 0xffffff;
+
+    for (of_node_t *n = cpus->on_children; n; n = n->on_next)
+    {
+        of_property_t *reg = dt_find_property(n, "reg");
+        of_property_t *method = dt_find_property(n, "enable-method");
+        uint32_t capacity = dt_get_property_value_u32(n, "capacity-dmips-mhz", 0, 0);
+        uint64_t mpidr;
+
+        if (reg == NULL || reg->op_length < 4 || strncmp(n->on_name, "cpu@", 4))
+            continue;
+
+        /* Last cell of reg is enough, affinity levels above 2 are not used */
+        mpidr = BE32(((uint32_t *)reg->op_value)[reg->op_length / 4 - 1]) & 0xffffff;
+
+        if (mpidr == self)
+            self_capacity = capacity;
+        else if (capacity > best_capacity && method && !strcmp(method->op_value, "psci"))
+        {
+            best_capacity = capacity;
+            best = mpidr;
+        }
+    }
+
+    if (best_capacity <= self_capacity)
+        return -1;
+
+    return best;
+}
+#endif
+
+/* Run the m68k. On the boot core, or on a faster one if there is any */
+static void start_emulation(void *addr, void *fdt)
+{
+#if EMU68_BIG_CORE
+    int hvc = 0;
+    uint64_t mpidr = find_big_core(&hvc);
+
+    if (mpidr != (uint64_t)-1)
+    {
+        kprintf("[BOOT] Boot core is %s, starting m68k on core %06x\n", cpu_name(), mpidr);
+
+        while(__atomic_test_and_set(&boot_lock, __ATOMIC_ACQUIRE)) asm volatile("yield");
+
+        big_core_addr = addr;
+        big_core_fdt = fdt;
+        big_core_start = 1;
+        temp_stack = (uintptr_t)tlsf_malloc(tlsf, EMU68_BIG_CORE_STACK) + EMU68_BIG_CORE_STACK;
+        clear_entire_dcache();
+
+        /* CPU_ON, 64-bit calling convention */
+        int64_t ret = psci_call(hvc, 0xc4000003, mpidr, mmu_virt2phys((intptr_t)_secondary_start), 0);
+
+        if (ret == 0)
+        {
+            while(__atomic_test_and_set(&boot_lock, __ATOMIC_ACQUIRE)) asm volatile("yield");
+            __atomic_clear(&boot_lock, __ATOMIC_RELEASE);
+
+#if EMU68_JIT_WORKER
+            of_property_t *prop = dt_find_property(dt_find_node("/chosen"), "bootargs");
+
+            if (prop && find_token(prop->op_value, "jit_worker"))
+                M68K_TranslationWorker();
+#endif
+            while(1) { asm volatile("wfe"); }
+        }
+
+        kprintf("[BOOT] PSCI CPU_ON failed with %d, m68k stays on the boot core\n", ret);
+
+        big_core_start = 0;
+        __atomic_clear(&boot_lock, __ATOMIC_RELEASE);
+    }
+#endif
+
+    M68K_StartEmu(addr, fdt);
+}
+
 void secondary_boot(void)
 {
     uint64_t cpu_id;
     uint64_t tmp;
     of_node_t *e = NULL;
     int async_log = 0;
+    int jit_worker = 0;
+    int profiler = 0;
+    int disasm_cpu = 0;
 
     asm volatile("mrs %0, MPIDR_EL1":"=r"(cpu_id));
    
-    cpu_id &= 3;
+    /* Cores of the second cluster, e.g. Cortex-A72 of RK3399, follow the first four */
+    cpu_id = (cpu_id & 0xff) + 4 * ((cpu_id >> 8) & 0xff);
     
     /* Enable caches and cache maintenance instructions from EL0 */
     asm volatile("mrs %0, SCTLR_EL1":"=r"(tmp));
@@ -426,7 +751,17 @@ void secondary_boot(void)
     tmp = 0x80000000; // Enable cycle counter
     asm volatile("msr PMCNTENSET_EL0, %0; isb"::"r"(tmp));
 
-    kprintf("[BOOT] Started CPU%d\n", cpu_id);
+    kprintf("[BOOT] Started CPU%d (%s)\n", cpu_id, cpu_name());
+
+#if EMU68_BIG_CORE
+    if (big_core_start)
+    {
+        big_core_start = 0;
+        __atomic_clear(&boot_lock, __ATOMIC_RELEASE);
+
+        M68K_StartEmu(big_core_addr, big_core_fdt);
+    }
+#endif
     
     if (cpu_id == 1)
     {
@@ -438,12 +773,77 @@ void secondary_boot(void)
             {
                 if (strstr(prop->op_value, "async_log"))
                     async_log = 1;
+#if EMU68_PROFILER
+                if (find_token(prop->op_value, "profile"))
+                    profiler = 1;
+#endif
+#if EMU68_DISASM_DEFERRED
+                if (find_token(prop->op_value, "disassemble_deferred"))
+                    disasm_cpu = 1;
+#endif
+#if EMU68_JIT_WORKER
+                if (find_token(prop->op_value, "jit_worker"))
+                    jit_worker = 1;
+#endif
             }
         }
     }
 
     __atomic_clear(&boot_lock, __ATOMIC_RELEASE);
 
+#if EMU68_BOOT_JOBS
+#if defined(PISTORM) && PISTORM_WRITE_BUFFER
+    if (cpu_id != 3)
+#endif
+        boot_jobs_helper();
+#endif
+
+#if EMU68_DISASM_DEFERRED
+    /* Deferred disassembly takes CPU1 unless it writes the asynchronous log */
+    if (cpu_id == 1 && !async_log && disasm_cpu)
+    {
+        disasm_task();
+    }
+#else
+    (void)disasm_cpu;
+#endif
+
+#if EMU68_PROFILER
+    /* Profiler takes CPU1 unless it writes the asynchronous log */
+    if (cpu_id == 1 && !async_log && profiler)
+    {
+        M68K_ProfilerTask();
+    }
+#else
+    (void)profiler;
+#endif
+
+#if EMU68_JIT_WORKER
+    /* Asynchronous log has priority, otherwise the idle CPU1 may translate code in background */
+    if (cpu_id == 1 && !async_log && jit_worker)
+    {
+        M68K_TranslationWorker();
+    }
+#else
+    (void)jit_worker;
+#endif
+
+#if defined(PISTORM) && EMU68_RTG_SERVICE
+    /* RTG service takes CPU1 if it is not busy with any of the above, returns if there is no queue */
+    if (cpu_id == 1 && !async_log && rtg_service)
+    {
+        RTG_ServiceTask();
+    }
+#endif
+
+#if defined(PISTORM) && EMU68_MIX_SERVICE
+    /* Mixing service takes CPU1 if none of the above does, returns if there is no queue */
+    if (cpu_id == 1 && !async_log && mix_service)
+    {
+        Mix_ServiceTask();
+    }
+#endif
+
 #ifdef PISTORM
     if (cpu_id == 1)
     {
@@ -472,28 +872,20 @@ uintptr_t vid_base;
 /* Amiga checksum, taken from AROS source code */
 int amiga_checksum(uint8_t *mem, uintptr_t size, uintptr_t chkoff, int update)
 {
-    uint32_t oldcksum = 0, cksum = 0, prevck = 0;
-    uintptr_t i;
-
-    for (i = 0; i < size; i+=4) {
-        uint32_t val = (mem[i+0] << 24) +
-                       (mem[i+1] << 16) +
-                       (mem[i+2] <<  8) +
-                       (mem[i+3] <<  0);
-
-        /* Clear existing checksum */
-        if (update && (i == chkoff)) {
-                oldcksum = val;
-                val = 0;
-        }
+    uint32_t oldcksum = 0, cksum;
+    uint64_t sum = sum_be32(mem, size);
 
-        cksum += val;
-        if (cksum < prevck)
-            cksum++;
-        prevck = cksum;
+    /* Existing checksum does not count */
+    if (update) {
+        oldcksum = (mem[chkoff+0] << 24) | (mem[chkoff+1] << 16) | (mem[chkoff+2] << 8) | mem[chkoff+3];
+        sum -= oldcksum;
     }
 
-    cksum = ~cksum;
+    /* End-around carry */
+    while (sum >> 32)
+        sum = (sum & 0xffffffff) + (sum >> 32);
+
+    cksum = ~(uint32_t)sum;
 
     if (update && cksum != oldcksum) {
         kprintf("Updating checksum from 0x%08x to 0x%08x\n", oldcksum, cksum);
@@ -533,6 +925,7 @@ void boot(void *dtree)
     of_property_t *p = NULL;
     of_node_t *e = NULL;
     void *initramfs_loc = NULL;
+    void *initramfs_mem = NULL;
     uintptr_t initramfs_size = 0;    
     boot_lock = 0;
 
@@ -541,7 +934,13 @@ void boot(void *dtree)
     int recalc_checksum = 0;
     int buptest = 0;
     int bupiter = 5;
+    int busbench = 0;
     vid_memory = 16;
+#ifndef PISTORM32
+    int bus_calibrate = 0;
+    int chipset_delay_arg = -1;
+    int cia_delay_arg = -1;
+#endif
 #endif
 
     /* Enable caches and cache maintenance instructions from EL0 */
@@ -572,8 +971,50 @@ void boot(void *dtree)
 
             if (find_token(prop->op_value, "enable_cache"))
                 enable_cache = 1;
+            if (find_token(prop->op_value, "cache_coherent"))
+                cache_coherent = 1;
             if (find_token(prop->op_value, "limit_2g"))
                 limit_2g = 1;
+
+            const char *jit_tok = find_token(prop->op_value, "jit_size=");
+            if (jit_tok)
+            {
+                uint32_t size = 0;
+
+                for (int i=0; i < 4; i++)
+                {
+                    if (jit_tok[9 + i] < '0' || jit_tok[9 + i] > '9')
+                        break;
+
+                    size = size * 10 + jit_tok[9 + i] - '0';
+                }
+
+                jit_pages = size / 2;
+
+                if (jit_pages < EMU68_JIT_MIN_PAGES)
+                    jit_pages = EMU68_JIT_MIN_PAGES;
+                if (jit_pages > EMU68_JIT_MAX_PAGES)
+                    jit_pages = EMU68_JIT_MAX_PAGES;
+            }
+
+#if EMU68_VICTIM_CACHE
+            const char *victim_tok = find_token(prop->op_value, "victim_cache=");
+            if (victim_tok)
+            {
+                extern uint32_t victim_cache_size;
+                uint32_t size = 0;
+
+                for (int i=0; i < 6; i++)
+                {
+                    if (victim_tok[13 + i] < '0' || victim_tok[13 + i] > '9')
+                        break;
+
+                    size = size * 10 + victim_tok[13 + i] - '0';
+                }
+
+                victim_cache_size = size * 1024;
+            }
+#endif
 #ifdef PISTORM
 #ifdef PISTORM32LITE
             if (find_token(prop->op_value, "two_slot"))
@@ -589,6 +1030,13 @@ void boot(void *dtree)
 #endif
             fast_page0 = !!find_token(prop->op_value, "fast_page_zero");
 
+#if EMU68_BUS_LOG
+            BusLog_Configure(prop->op_value);
+#endif
+#if PISTORM_CHIP_SHADOW
+            ChipShadow_Configure(prop->op_value);
+#endif
+
             zorro_disable = !!find_token(prop->op_value, "z3_disable");
 
             if (find_token(prop->op_value, "chip_slowdown") || find_token(prop->op_value, "SC"))
@@ -654,6 +1102,40 @@ void boot(void *dtree)
 
             blitwait = !(!find_token(prop->op_value, "blitwait") && !find_token(prop->op_value, "BW"));
 
+            smc_protect = !!find_token(prop->op_value, "smc_protect");
+            adaptive_jit = !!find_token(prop->op_value, "adaptive_jit");
+            fpu_relaxed = !!find_token(prop->op_value, "fpu_relaxed");
+#if EMU68_LOOP_PACING
+            loop_pacing = !!find_token(prop->op_value, "loop_pacing");
+#endif
+#if EMU68_IDLE_WAIT
+            idle_wait = !!find_token(prop->op_value, "idle_wait");
+#endif
+#if EMU68_NATIVE_CALLS
+            native_calls = !!find_token(prop->op_value, "native_calls");
+#endif
+#if EMU68_TRANSLATE_AHEAD
+            translate_ahead = !!find_token(prop->op_value, "translate_ahead");
+#endif
+            profile = !!find_token(prop->op_value, "profile");
+#if EMU68_M68K_MMU
+            m68k_mmu = !!find_token(prop->op_value, "m68k_mmu");
+#endif
+#if EMU68_RTG_SERVICE
+            rtg_service = !!find_token(prop->op_value, "rtg_service");
+#endif
+#if EMU68_MIX_SERVICE
+            mix_service = !!find_token(prop->op_value, "mix_service");
+#endif
+#if EMU68_INSN_COUNTER_SAMPLED
+            /* Profiler on CPU1 estimates the instruction count, unless CPU1 does other work */
+            insn_count_precise = !profile || strstr(prop->op_value, "async_log") ||
+                find_token(prop->op_value, "disassemble_deferred") || find_token(prop->op_value, "insn_count=precise");
+#endif
+#if EMU68_PMU_PROFILE
+            pmu_profile = !!find_token(prop->op_value, "pmu_profile");
+#endif
+
             if ((tok = find_token(prop->op_value, "ICNT=")))
             {
                 uint32_t val = 0;
@@ -764,6 +1246,24 @@ void boot(void *dtree)
                 
                 bupiter = iter;
             }
+            if ((tok = find_token(prop->op_value, "busbench=")))
+            {
+                uint32_t cnt = 0;
+
+                for (int i=0; i < 6; i++)
+                {
+                    if (tok[9 + i] < '0' || tok[9 + i] > '9')
+                        break;
+
+                    cnt = cnt * 10 + tok[9 + i] - '0';
+                }
+
+                if (cnt > 100000) {
+                    cnt = 100000;
+                }
+
+                busbench = cnt;
+            }
             if ((tok = find_token(prop->op_value, "vc4.mem=")))
             {
                 uint32_t vmem = 0;
@@ -780,6 +1280,38 @@ void boot(void *dtree)
                     vid_memory = vmem & ~1;
                 }
             }
+#ifndef PISTORM32
+            bus_calibrate = !!find_token(prop->op_value, "bus_calibrate");
+
+            if ((tok = find_token(prop->op_value, "chipset_delay=")))
+            {
+                int d = 0;
+
+                for (int i=0; i < 3; i++)
+                {
+                    if (tok[14 + i] < '0' || tok[14 + i] > '9')
+                        break;
+
+                    d = d * 10 + tok[14 + i] - '0';
+                }
+
+                chipset_delay_arg = d;
+            }
+            if ((tok = find_token(prop->op_value, "cia_delay=")))
+            {
+                int d = 0;
+
+                for (int i=0; i < 3; i++)
+                {
+                    if (tok[10 + i] < '0' || tok[10 + i] > '9')
+                        break;
+
+                    d = d * 10 + tok[10 + i] - '0';
+                }
+
+                cia_delay_arg = d;
+            }
+#endif
             if ((tok = find_token(prop->op_value, "checksum_rom")))
             {
                 recalc_checksum = 1;
@@ -844,6 +1376,7 @@ void boot(void *dtree)
 
             initramfs_size = (uintptr_t)image_end - (uintptr_t)image_start;
             initramfs_loc = tlsf_malloc(tlsf, initramfs_size);
+            initramfs_mem = initramfs_loc;
 
             /* Align the length of image up to nearest 4 byte boundary */
             DuffCopy(initramfs_loc, (void*)(0xffffff9000000000 + (uintptr_t)image_start), (initramfs_size + 3)/ 4);
@@ -872,8 +1405,14 @@ void boot(void *dtree)
 
             if (result == LIBDEFLATE_SUCCESS || result == LIBDEFLATE_SHORT_OUTPUT)
             {
-                /* Shift the rest of initramfs back to original position. */
-                memcpy(initramfs_loc, (void*)((uintptr_t)initramfs_loc + in_size), initramfs_size - in_size);
+                /*
+                    Skip the firmware blob. The rest of initramfs is shifted back to original
+                    position only if it would be misaligned otherwise.
+                */
+                if (in_size & 3)
+                    memcpy(initramfs_loc, (void*)((uintptr_t)initramfs_loc + in_size), initramfs_size - in_size);
+                else
+                    initramfs_loc = (void*)((uintptr_t)initramfs_loc + in_size);
                 initramfs_size -= in_size;
                 firmware_file = out_buffer;
                 firmware_size = out_size;
@@ -936,6 +1475,63 @@ void boot(void *dtree)
 
     print_build_id();
 
+#if SET_FEATURES_AT_RUNTIME
+    uint64_t isar0, isar1, midr;
+    asm volatile("mrs %0, ID_AA64ISAR0_EL1":"=r"(isar0));
+    asm volatile("mrs %0, ID_AA64ISAR1_EL1":"=r"(isar1));
+    asm volatile("mrs %0, MIDR_EL1":"=r"(midr));
+
+    /* Atomic field of 2 or more, CAS and LD<op> instructions are there (ARMv8.1) */
+    if (((isar0 >> 20) & 15) >= 2)
+    {
+        Features.ARM_SUPPORTS_LSE = 1;
+        kprintf("[BOOT] CPU supports LSE atomics\n");
+    }
+
+    /* LDAPR, acquire loads of the weaker RCpc kind (ARMv8.3) */
+    if (((isar1 >> 20) & 15) >= 1)
+    {
+        Features.ARM_SUPPORTS_RCPC = 1;
+        kprintf("[BOOT] CPU supports RCpc loads\n");
+    }
+
+    /* SDOT and UDOT (ARMv8.2) */
+    if (((isar0 >> 44) & 15) >= 1)
+    {
+        Features.ARM_SUPPORTS_DOTPROD = 1;
+        kprintf("[BOOT] CPU supports dot product\n");
+    }
+
+    /*
+        Code generation profile. Out of order cores fetch in aligned blocks and gain from
+        aligned loop heads, a mispredicted short branch costs them more than a data dependency.
+        The in-order A53 is the other way round
+    */
+    switch ((midr >> 4) & 0xfff)
+    {
+        case 0xd03:
+            Features.ARM_CORE = ARM_CORE_A53;
+            Features.ARM_SCHEDULE = 1;
+            break;
+        case 0xd08:
+            Features.ARM_CORE = ARM_CORE_A72;
+            Features.ARM_LOOP_ALIGN = 16;
+            Features.ARM_BRANCHLESS_FLAGS = 1;
+            break;
+        case 0xd0b:
+            Features.ARM_CORE = ARM_CORE_A76;
+            Features.ARM_LOOP_ALIGN = 32;
+            Features.ARM_BRANCHLESS_FLAGS = 1;
+            break;
+    }
+
+    kprintf("[BOOT] Code generation profile for %s, loop heads aligned to %d bytes%s%s\n", cpu_name(),
+        Features.ARM_LOOP_ALIGN, Features.ARM_BRANCHLESS_FLAGS ? ", branchless flags" : "",
+        Features.ARM_SCHEDULE ? ", in-order scheduling" : "");
+#endif
+
+    arm_cache_init();
+
     kprintf("[BOOT] ARM stack top at %p\n", &_boot);
     kprintf("[BOOT] Bootstrap ends at %p\n", &__bootstrap_end);
 
@@ -976,10 +1572,63 @@ void boot(void *dtree)
                 vid_memory);
         }
 
-        intptr_t kernel_new_loc = top_of_ram - (KERNEL_RSRVD_PAGES << 21);
+        /* Unless given by the bootarg, JIT pool grows with the RAM */
+        if (jit_pages == 0)
+        {
+            jit_pages = (top_of_ram >> EMU68_JIT_RAM_SHIFT) >> 21;
+
+            if (jit_pages < EMU68_JIT_MIN_PAGES)
+                jit_pages = EMU68_JIT_MIN_PAGES;
+            if (jit_pages > EMU68_JIT_MAX_PAGES)
+                jit_pages = EMU68_JIT_MAX_PAGES;
+        }
+
+        uintptr_t reserved_size = (uintptr_t)(KERNEL_SYS_PAGES + jit_pages) << 21;
+#if EMU68_MMU_LARGE_PAGES
+        /*
+            Put the JIT pool at 32MB boundary so that it gets contiguous TLB entries. The pages
+            cut for the alignment go to the JIT pool too
+        */
+        reserved_size = top_of_ram - ((top_of_ram - reserved_size) & ~0x1ffffffULL);
+        jit_pages = (reserved_size >> 21) - KERNEL_SYS_PAGES;
+#endif
+        intptr_t kernel_new_loc = top_of_ram - reserved_size;
         intptr_t kernel_old_loc = mmu_virt2phys((intptr_t)_boot) & 0x7fffe00000;
 
-        sys_memory[block_top].mb_Size -= (KERNEL_RSRVD_PAGES << 21);
+        sys_memory[block_top].mb_Size -= reserved_size;
+
+        uintptr_t below_kernel = kernel_new_loc;
+#if EMU68_BUS_LOG
+        /* Bus log buffer goes right below the kernel and is not given to the m68k as memory */
+        below_kernel -= BusLog_Reserve(below_kernel);
+#endif
+#ifdef PISTORM
+        /* So does the RAM of Z3 expansion, the m68k sees it at the address autoconfig assigns */
+        below_kernel -= Z3RAM_Reserve(sys_memory[block_top].mb_Base, below_kernel);
+#if EMU68_NATIVE_CALLS
+        /* And the RAM disk, which only the native call of its driver reaches */
+        if (native_calls)
+            below_kernel -= RAMDisk_Reserve(sys_memory[block_top].mb_Base, below_kernel);
+#endif
+#if PISTORM_CHIP_SHADOW
+        /* And the backing of CPU-private CHIP RAM. Its pages are protected in the boot tables */
+#if EMU68_M68K_MMU
+        if (!m68k_mmu)
+#endif
+        below_kernel -= ChipShadow_Reserve(below_kernel);
+#endif
+#endif
+        sys_memory[block_top].mb_Size -= kernel_new_loc - below_kernel;
+
+#ifdef PISTORM
+        /* Page tables changed at run-time must not take RAM away from the m68k later */
+#if EMU68_M68K_MMU
+        if (smc_protect || m68k_mmu)
+#else
+        if (smc_protect)
+#endif
+            kprintf("[BOOT] %d pages reserved for page tables\n", mmu_reserve_pages(EMU68_MMU_POOL_PAGES));
+#endif
 
         range = p->op_value;
         top_of_ram = 0;
@@ -1033,20 +1682,47 @@ void boot(void *dtree)
             uint32_t reg[] = {
                 vid_base, vid_memory * 1024*1024
             };
-            dt_add_property(dt_find_node("/emu68"), "vc4-mem", reg, 8);
 
             mmu_map(vid_base, vid_base, vid_memory * 1024*1024, MMU_ACCESS | MMU_OSHARE | MMU_ALLOW_EL0 | MMU_ATTR_WRITETHROUGH, 0);
+
+#if defined(PISTORM) && EMU68_RTG_SERVICE
+            /* Queue of the RTG service is cut from the end, P96 does not see it */
+            if (rtg_service)
+                reg[1] -= RTG_Setup(vid_base, reg[1]);
+#endif
+#if defined(PISTORM) && EMU68_MIX_SERVICE
+            /* Both services would run on CPU1, the RTG service has priority */
+#if EMU68_RTG_SERVICE
+            if (rtg_service)
+                mix_service = 0;
+#endif
+            if (mix_service)
+                reg[1] -= Mix_Setup(vid_base, reg[1]);
+#endif
+            dt_add_property(dt_find_node("/emu68"), "vc4-mem", reg, 8);
         }
 
-        mmu_map(kernel_new_loc + (KERNEL_SYS_PAGES << 21), 0xffffffe000000000, KERNEL_JIT_PAGES << 21, MMU_ACCESS | MMU_ISHARE | MMU_ATTR_CACHED, 0);
-        mmu_map(kernel_new_loc + (KERNEL_SYS_PAGES << 21), 0xfffffff000000000, KERNEL_JIT_PAGES << 21, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+#if defined(PISTORM) && EMU68_Z3_PATTERN_BLOCK
+        MapUnusedZ3();
+#endif
+
+#if defined(PISTORM) && EMU68_NATIVE_CALLS
+        if (native_calls)
+            Native_Setup();
+#endif
+
+        mmu_map(kernel_new_loc + (KERNEL_SYS_PAGES << 21), 0xffffffe000000000, (uintptr_t)jit_pages << 21, MMU_ACCESS | MMU_ISHARE | MMU_ATTR_CACHED, 0);
+        mmu_map(kernel_new_loc + (KERNEL_SYS_PAGES << 21), 0xfffffff000000000, (uintptr_t)jit_pages << 21, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+
+        jit_tlsf = tlsf_init_with_memory((void*)0xffffffe000000000, (uintptr_t)jit_pages << 21);
 
-        jit_tlsf = tlsf_init_with_memory((void*)0xffffffe000000000, KERNEL_JIT_PAGES << 21);
+        Trace_Init();
+        JITStats_Init();
 
         kprintf("[BOOT] Local memory pools:\n");
         kprintf("[BOOT]    SYS: %p - %p (size: %5d KiB)\n", &__bootstrap_end, kernel_top_virt - 1, pool_size / 1024);
         kprintf("[BOOT]    JIT: %p - %p (size: %5d KiB)\n", 0xffffffe000000000,
-                    0xffffffe000000000 + (KERNEL_JIT_PAGES << 21) - 1, KERNEL_JIT_PAGES << 11);
+                    0xffffffe000000000 + ((uintptr_t)jit_pages << 21) - 1, jit_pages << 11);
 
         kprintf("[BOOT] Moving kernel from %p to %p\n", (void*)kernel_old_loc, (void*)kernel_new_loc);
         kprintf("[BOOT] Top of RAM (32bit): %08x\n", top_of_ram);
@@ -1204,6 +1880,20 @@ void boot(void *dtree)
             uint32_t magic = BE32(*(uint32_t*)image_start);
             void *ptr = NULL;
 
+#if EMU68_BUS_LOG
+            if (BusLog_IsLog(image_start))
+            {
+                kprintf("[BOOT] Bus log from %p-%p\n", image_start, image_end);
+
+                /* The log is read during the whole replay, initrd copy stays */
+                if (BusLog_LoadReplay(image_start, initramfs_size, &top_of_ram))
+                {
+                    initramfs_mem = NULL;
+                    ptr = (void *)0xf80000;
+                }
+            }
+            else
+#endif
             if (magic == 0x3f3)
             {
                 kprintf("[BOOT] Loading HUNK executable from %p-%p\n", image_start, image_end);
@@ -1291,10 +1981,13 @@ void boot(void *dtree)
                 }
             }
 
-            tlsf_free(tlsf, initramfs_loc);
+            if (initramfs_mem)
+                tlsf_free(tlsf, initramfs_mem);
+
+            boot_jobs_end();
 
             if (ptr)
-                M68K_StartEmu(ptr, fdt);
+                start_emulation(ptr, fdt);
         }
         else
         {
@@ -1310,36 +2003,20 @@ void boot(void *dtree)
         kprintf("[BOOT] %dk ROM copy requested\n", rom_copy);
 
         /* If ROM copy was requested, pull the 512K no matter what. On 256K kickstarts this will pull shadow copy too */
-        for (int i=0; i < 524288; i+=4)
-        {
-            *(uint32_t *)(0xffffff9000f80000 + i) = ps_read_32(0xf80000 + i);
-        }
+        ps_read_block(0xf80000, (void *)0xffffff9000f80000, 524288);
         mmu_map(0xf80000, 0xf80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
 
         /* For larger ROMs copy also 512K from 0xe00000 (1M) and 0xa80000, 0xb00000 (2M) */ 
         if (rom_copy == 1024)
         {
-            for (int i=0; i < 524288; i+=4)
-            {
-                *(uint32_t *)(0xffffff9000e00000 + i) = ps_read_32(0xe00000 + i);
-            }
+            ps_read_block(0xe00000, (void *)0xffffff9000e00000, 524288);
 
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
         }
         else if (rom_copy == 2048)
         {
-            for (int i=0; i < 524288; i+=4)
-            {
-                *(uint32_t *)(0xffffff9000e00000 + i) = ps_read_32(0xe00000 + i);
-            }
-            for (int i=0; i < 524288; i+=4)
-            {
-                *(uint32_t *)(0xffffff9000a80000 + i) = ps_read_32(0xa80000 + i);
-            }
-            for (int i=0; i < 524288; i+=4)
-            {
-                *(uint32_t *)(0xffffff9000b00000 + i) = ps_read_32(0xb00000 + i);
-            }
+            ps_read_block(0xe00000, (void *)0xffffff9000e00000, 524288);
+            ps_read_block(0xa80000, (void *)0xffffff9000a80000, 2*524288);
 
             mmu_map(0xa80000, 0xa80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xb00000, 0xb00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
@@ -1350,10 +2027,17 @@ void boot(void *dtree)
             /* For 512K or lower create shadow rom at 0xe00000 */
             mmu_map(0xf80000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
         }
+
+        /* ROM copies are read-only now, the JIT may keep their translations */
+        M68K_AddROMRange(0xf80000, 524288);
+        M68K_AddROMRange(0xe00000, 524288);
+        if (rom_copy == 2048)
+            M68K_AddROMRange(0xa80000, 2*524288);
     }
     else if (initramfs_loc != NULL && initramfs_size != 0)
     {
         extern uint32_t rom_mapped;
+        struct CopyJob rom_jobs[4];
 
         kprintf("[BOOT] Loading ROM from %p, size %d\n", initramfs_loc, initramfs_size);
         mmu_map(0xf80000, 0xf80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
@@ -1362,35 +2046,39 @@ void boot(void *dtree)
         {
             /* Make a shadow of 0xf80000 at 0xe00000 */
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
-            DuffCopy((void*)0xffffff9000f80000, initramfs_loc, 262144 / 4);
-            DuffCopy((void*)0xffffff9000fc0000, initramfs_loc, 262144 / 4);
-            DuffCopy((void*)0xffffff9000e00000, (void*)0xffffff9000f80000, 524288 / 4);
+            boot_copy(&rom_jobs[0], (void*)0xffffff9000f80000, initramfs_loc, 262144);
+            boot_copy(&rom_jobs[1], (void*)0xffffff9000fc0000, initramfs_loc, 262144);
+            boot_copy(&rom_jobs[2], (void*)0xffffff9000e00000, initramfs_loc, 262144);
+            boot_copy(&rom_jobs[3], (void*)0xffffff9000e40000, initramfs_loc, 262144);
         }
         else if (initramfs_size == 524288)
         {
             /* Make a shadow of 0xf80000 at 0xe00000 */
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
-            DuffCopy((void*)0xffffff9000e00000, initramfs_loc, 524288 / 4);
-            DuffCopy((void*)0xffffff9000f80000, initramfs_loc, 524288 / 4);
+            boot_copy(&rom_jobs[0], (void*)0xffffff9000e00000, initramfs_loc, 524288);
+            boot_copy(&rom_jobs[1], (void*)0xffffff9000f80000, initramfs_loc, 524288);
         }
         else if (initramfs_size == 1048576)
         {
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xf00000, 0xf00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
-            DuffCopy((void*)0xffffff9000e00000, initramfs_loc, 524288 / 4);
-            DuffCopy((void*)0xffffff9000f00000, initramfs_loc, 524288 / 4);
-            DuffCopy((void*)0xffffff9000f80000, (void*)((uintptr_t)initramfs_loc + 524288), 524288 / 4);
+            boot_copy(&rom_jobs[0], (void*)0xffffff9000e00000, initramfs_loc, 524288);
+            boot_copy(&rom_jobs[1], (void*)0xffffff9000f00000, initramfs_loc, 524288);
+            boot_copy(&rom_jobs[2], (void*)0xffffff9000f80000, (void*)((uintptr_t)initramfs_loc + 524288), 524288);
         }
         else if (initramfs_size == 2097152) {
             mmu_map(0xa80000, 0xa80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xb00000, 0xb00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
-            DuffCopy((void*)0xffffff9000e00000, initramfs_loc, 524288 / 4);
-            DuffCopy((void*)0xffffff9000a80000, (void*)((uintptr_t)initramfs_loc + 524288), 524288 / 4);
-            DuffCopy((void*)0xffffff9000b00000, (void*)((uintptr_t)initramfs_loc + 2*524288), 524288 / 4);
-            DuffCopy((void*)0xffffff9000f80000, (void*)((uintptr_t)initramfs_loc + 3*524288), 524288 / 4);
+            boot_copy(&rom_jobs[0], (void*)0xffffff9000e00000, initramfs_loc, 524288);
+            boot_copy(&rom_jobs[1], (void*)0xffffff9000a80000, (void*)((uintptr_t)initramfs_loc + 524288), 524288);
+            boot_copy(&rom_jobs[2], (void*)0xffffff9000b00000, (void*)((uintptr_t)initramfs_loc + 2*524288), 524288);
+            boot_copy(&rom_jobs[3], (void*)0xffffff9000f80000, (void*)((uintptr_t)initramfs_loc + 3*524288), 524288);
         }
 
+        /* Copies run on all free CPUs, wait for them before looking at the ROM */
+        boot_jobs_wait();
+
         /* Check if ROM is byte-swapped */
         {
             uint8_t *rom_start = (uint8_t *)0xffffff9000f80000;
@@ -1425,7 +2113,16 @@ void boot(void *dtree)
 
         rom_mapped = 1;
 
-        tlsf_free(tlsf, initramfs_loc);
+        /* ROM copies are read-only now, the JIT may keep their translations */
+        M68K_AddROMRange(0xf80000, 524288);
+        if (initramfs_size == 262144 || initramfs_size == 524288 || initramfs_size == 1048576 || initramfs_size == 2097152)
+            M68K_AddROMRange(0xe00000, 524288);
+        if (initramfs_size == 1048576)
+            M68K_AddROMRange(0xf00000, 524288);
+        else if (initramfs_size == 2097152)
+            M68K_AddROMRange(0xa80000, 2*524288);
+
+        tlsf_free(tlsf, initramfs_mem);
     }
 
 
@@ -1464,6 +2161,9 @@ void boot(void *dtree)
 
     }
 
+    /* Secondary CPUs are done with boot work, from now on they do their own */
+    boot_jobs_end();
+
     kprintf("[BOOT] Setting IRQ routing to core 0\n");
     wr32le(0xf300000c, 0);
     
@@ -1493,20 +2193,90 @@ void boot(void *dtree)
     {
         ps_buptest(buptest, bupiter);
     }
+
+#ifndef PISTORM32
+    {
+        extern uint32_t chipset_delay;
+        extern uint32_t cia_delay;
+
+        if (bus_calibrate)
+            ps_calibrate_delays(PISTORM_CALIBRATE_ITER);
+
+        /* Values given in bootargs win over calibration */
+        if (chipset_delay_arg >= 0)
+            chipset_delay = chipset_delay_arg;
+        if (cia_delay_arg >= 0)
+            cia_delay = cia_delay_arg;
+
+        kprintf("[BOOT] Bus delays: chipset %d, CIA %d ticks\n", chipset_delay, cia_delay);
+
+        uint32_t delays[] = {
+            chipset_delay, cia_delay
+        };
+        dt_add_property(dt_find_node("/emu68"), "bus-delays", delays, 8);
+    }
+#endif
+
+    /* Benchmark runs with the final bus delays */
+    if (busbench)
+        ps_busbench(busbench);
 #endif
 
     /* If fast_page_zero is enabled, map first 4K to ROM directly (Overlay active) */
     if (fast_page0) {
         mmu_map(0xf80000, 0x0, 4096, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
     }
+#if PISTORM_CHIP_SHADOW
+    ChipShadow_Map();
+#endif
     
-    M68K_StartEmu(0, NULL);
+    start_emulation(0, NULL);
 
 #endif
 
     while(1) asm volatile("wfe");
 }
 
+static inline void LoadFPUContext(struct M68KState *ctx)
+{
+    asm volatile("mov v29.s[0], %w0"::"r"(ctx->FPSR));
+    asm volatile("mov v29.s[1], %w0"::"r"(ctx->FPIAR));
+    asm volatile("mov v29.h[4], %w0"::"r"(ctx->FPCR));
+
+    asm volatile("ldr d%0, %1"::"i"(REG_FP0),"m"(ctx->FP[0]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP1),"m"(ctx->FP[1]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP2),"m"(ctx->FP[2]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP3),"m"(ctx->FP[3]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP4),"m"(ctx->FP[4]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP5),"m"(ctx->FP[5]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP6),"m"(ctx->FP[6]));
+    asm volatile("ldr d%0, %1"::"i"(REG_FP7),"m"(ctx->FP[7]));
+}
+
+static inline void SaveFPUContext(struct M68KState *ctx)
+{
+    asm volatile("mov w1, v29.s[0]; str w1, %0"::"m"(ctx->FPSR):"x1");
+    asm volatile("mov w1, v29.s[1]; str w1, %0"::"m"(ctx->FPIAR):"x1");
+    asm volatile("umov w1, v29.h[4]; strh w1, %0"::"m"(ctx->FPCR):"x1");
+
+    asm volatile("str d%0, %1"::"i"(REG_FP0),"m"(ctx->FP[0]));
+    asm volatile("str d%0, %1"::"i"(REG_FP1),"m"(ctx->FP[1]));
+    asm volatile("str d%0, %1"::"i"(REG_FP2),"m"(ctx->FP[2]));
+    asm volatile("str d%0, %1"::"i"(REG_FP3),"m"(ctx->FP[3]));
+    asm volatile("str d%0, %1"::"i"(REG_FP4),"m"(ctx->FP[4]));
+    asm volatile("str d%0, %1"::"i"(REG_FP5),"m"(ctx->FP[5]));
+    asm volatile("str d%0, %1"::"i"(REG_FP6),"m"(ctx->FP[6]));
+    asm volatile("str d%0, %1"::"i"(REG_FP7),"m"(ctx->FP[7]));
+}
+
+#if EMU68_LAZY_FPU
+/* Bring the FPU part of the context in memory up to date, the host registers stay valid */
+void M68K_SyncFPUContext(struct M68KState *ctx)
+{
+    if (ctx->FP_LIVE)
+        SaveFPUContext(ctx);
+}
+#endif
 
 void M68K_LoadContext(struct M68KState *ctx)
 {
@@ -1517,9 +2287,6 @@ void M68K_LoadContext(struct M68KState *ctx)
     asm volatile("mov v31.s[2], %w0"::"r"(ctx->ISP));
     asm volatile("mov v31.s[3], %w0"::"r"(ctx->MSP));
     asm volatile("mov v30.d[0], %0"::"r"(ctx->INSN_COUNT));
-    asm volatile("mov v29.s[0], %w0"::"r"(ctx->FPSR));
-    asm volatile("mov v29.s[1], %w0"::"r"(ctx->FPIAR));
-    asm volatile("mov v29.h[4], %w0"::"r"(ctx->FPCR));
 
     asm volatile("ldp w%0, w%1, %2"::"i"(REG_D0),"i"(REG_D1),"m"(ctx->D[0].u32));
     asm volatile("ldp w%0, w%1, %2"::"i"(REG_D2),"i"(REG_D3),"m"(ctx->D[2].u32));
@@ -1533,14 +2300,16 @@ void M68K_LoadContext(struct M68KState *ctx)
 
     asm volatile("ldr w%0, %1"::"i"(REG_PC),"m"(ctx->PC));
 
-    asm volatile("ldr d%0, %1"::"i"(REG_FP0),"m"(ctx->FP[0]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP1),"m"(ctx->FP[1]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP2),"m"(ctx->FP[2]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP3),"m"(ctx->FP[3]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP4),"m"(ctx->FP[4]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP5),"m"(ctx->FP[5]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP6),"m"(ctx->FP[6]));
-    asm volatile("ldr d%0, %1"::"i"(REG_FP7),"m"(ctx->FP[7]));
+#if EMU68_LAZY_FPU
+    /* Registers are up to date unless C code has changed the FPU part in memory */
+    if (!ctx->FP_LIVE)
+    {
+        LoadFPUContext(ctx);
+        ctx->FP_LIVE = 1;
+    }
+#else
+    LoadFPUContext(ctx);
+#endif
 
     asm volatile("ldrh w1, %0; rbit w2, w1; bfxil w1, w2, 30, 2; msr tpidr_EL0, x1"::"m"(ctx->SR):"x1","x2");
     if (ctx->SR & SR_S)
@@ -1559,10 +2328,6 @@ void M68K_SaveContext(struct M68KState *ctx)
     asm volatile("mov w1, v31.s[0]; str w1, %0"::"m"(ctx->CACR):"x1");
     asm volatile("mov x1, v30.d[0]; str x1, %0"::"m"(ctx->INSN_COUNT):"x1");
     
-    asm volatile("mov w1, v29.s[0]; str w1, %0"::"m"(ctx->FPSR):"x1");
-    asm volatile("mov w1, v29.s[1]; str w1, %0"::"m"(ctx->FPIAR):"x1");
-    asm volatile("umov w1, v29.h[4]; strh w1, %0"::"m"(ctx->FPCR):"x1");
-    
     asm volatile("stp w%0, w%1, %2"::"i"(REG_D0),"i"(REG_D1),"m"(ctx->D[0].u32));
     asm volatile("stp w%0, w%1, %2"::"i"(REG_D2),"i"(REG_D3),"m"(ctx->D[2].u32));
     asm volatile("stp w%0, w%1, %2"::"i"(REG_D4),"i"(REG_D5),"m"(ctx->D[4].u32));
@@ -1575,14 +2340,9 @@ void M68K_SaveContext(struct M68KState *ctx)
 
     asm volatile("str w%0, %1"::"i"(REG_PC),"m"(ctx->PC));
 
-    asm volatile("str d%0, %1"::"i"(REG_FP0),"m"(ctx->FP[0]));
-    asm volatile("str d%0, %1"::"i"(REG_FP1),"m"(ctx->FP[1]));
-    asm volatile("str d%0, %1"::"i"(REG_FP2),"m"(ctx->FP[2]));
-    asm volatile("str d%0, %1"::"i"(REG_FP3),"m"(ctx->FP[3]));
-    asm volatile("str d%0, %1"::"i"(REG_FP4),"m"(ctx->FP[4]));
-    asm volatile("str d%0, %1"::"i"(REG_FP5),"m"(ctx->FP[5]));
-    asm volatile("str d%0, %1"::"i"(REG_FP6),"m"(ctx->FP[6]));
-    asm volatile("str d%0, %1"::"i"(REG_FP7),"m"(ctx->FP[7]));
+#if !EMU68_LAZY_FPU
+    SaveFPUContext(ctx);
+#endif
 
     asm volatile("mrs x1, tpidr_EL0; rbit w2, w1; bfxil w1, w2, 30, 2; strh w1, %0"::"m"(ctx->SR):"x1","x2");
     if (ctx->SR & SR_S)
@@ -1602,6 +2362,9 @@ void M68K_SaveContext(struct M68KState *ctx)
 
 void M68K_PrintContext(struct M68KState *m68k)
 {
+#if EMU68_LAZY_FPU
+    M68K_SyncFPUContext(m68k);
+#endif
     kprintf("[JIT] M68K Context:\n[JIT] ");
 
     for (int i=0; i < 8; i++) {
@@ -1691,31 +2454,38 @@ void  __attribute__((used)) stub_FindUnit()
     asm volatile(
 "       .align  8                           \n"
 "FindUnit:                                  \n"
-"       adrp    x4, ICache                  \n"
-"       add     x4, x4, :lo12:ICache        \n"
-"       and     x0, x%[reg_pc], 0x1fffe0    \n" // Hash is (address >> 5) & 0xffff !!!!
-"       ldr     x0, [x4, x0]                \n"
-"       b       1f                          \n"
-"3:                                         \n" // 2 -> 5
-"       cmp     w5, w%[reg_pc]              \n"
-"       b.eq    2f                          \n"
-"       mov     x0, x4                      \n"
-"1:     ldr     x4, [x0]                    \n"
-"       ldr     x5, [x0, #32]               \n"
-"       cbnz    x4, 3b                      \n"
+"       adrp    x4, UnitTable               \n"
+"       add     x4, x4, :lo12:UnitTable     \n"
+"       ubfx    w5, w%[reg_pc], #%[shift], #%[bits] \n" // Home line of the PC
+"1:     add     x6, x4, x5, lsl #6          \n"
+"       mov     x7, #0                      \n"
+"2:     ldr     w0, [x6, x7, lsl #2]        \n"
+"       cmp     w0, w%[reg_pc]              \n"
+"       b.eq    3f                          \n"
+"       add     x7, x7, #1                  \n"
+"       cmp     x7, #%[slots]               \n"
+"       b.ne    2b                          \n"
+"       ldr     w0, [x6, #%[overflow]]      \n" // Not in this line. Continue if some units overflowed it
+"       add     w5, w5, #1                  \n"
+"       and     w5, w5, #%[mask]            \n"
+"       cbnz    w0, 1b                      \n"
 "       mov     x0, #0                      \n"
-"4:     ret                                 \n"
-"2:     ldp     x6, x4, [x0, #16]           \n"
-"       ldr     x5, [x4, #8]                \n"
-"       cbz     x5, 4b                      \n"
-"       stp     x4, x5, [x0, #16]           \n"
-"       add     x7, x0, #0x10               \n" // 4 -> 7
-"       str     x7, [x5]                    \n"
-"       stp     x6, x7, [x4]                \n"
-"       str     x4, [x6, #8]                \n"
+"       ret                                 \n"
+"3:     add     x6, x6, #%[entry]           \n"
+"       ldr     x0, [x6, x7, lsl #3]        \n" // Get entry point and convert it to the unit pointer
+"       orr     x0, x0, #0xff00000000000000 \n"
+"       bic     x0, x0, #0x0000001000000000 \n"
+"       sub     x0, x0, #%[code]            \n"
 "       ret                                 \n"
 
-::[reg_pc]"i"(REG_PC));
+::[reg_pc]"i"(REG_PC),
+  [shift]"i"(EMU68_HASHSHIFT),
+  [bits]"i"(EMU68_UNIT_TABLE_BITS),
+  [mask]"i"(EMU68_UNIT_TABLE_MASK),
+  [slots]"i"(UNIT_LINE_SLOTS),
+  [overflow]"i"(__builtin_offsetof(struct M68KUnitLine, ul_Overflow)),
+  [entry]"i"(__builtin_offsetof(struct M68KUnitLine, ul_Entry)),
+  [code]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode)));
 }
 
 #ifdef PISTORM
@@ -1771,32 +2541,45 @@ void  __attribute__((used)) stub_ExecutionLoop()
 "       blr     x12                         \n"
 "       b       1b                          \n"
 "       .align  6                           \n"
-"13:                                        \n"
-"       and     x0, x%[reg_pc], 0x1fffe0    \n" // Hash is (address >> 5) & 0xffff !!!!
-"       adrp    x4, ICache                  \n"
-"       add     x4, x4, :lo12:ICache        \n"
-"       ldr     x0, [x4, x0]                \n"
-"       b       51f                         \n"
-"53:                                        \n" // 2 -> 5
-"       cmp     w5, w%[reg_pc]              \n"
+"13:    ubfx    w1, w%[reg_pc], #1, #%[jc_bits] \n" // Jump cache slot of the PC
+"       add     x2, x0, #%[jcache]          \n"
+"       add     x2, x2, x1, lsl #4          \n"
+"       ldr     w1, [x2]                    \n"
+"       cmp     w1, w%[reg_pc]              \n"
+"       b.ne    54f                         \n"
+"       ldr     x12, [x2, #8]               \n"
+"       ldr     w1, [x0, #%[jc_hit]]        \n"
+"       add     w1, w1, #1                  \n"
+"       str     w1, [x0, #%[jc_hit]]        \n"
+"       b       55f                         \n"
+"54:    ldr     w1, [x0, #%[jc_miss]]       \n"
+"       add     w1, w1, #1                  \n"
+"       str     w1, [x0, #%[jc_miss]]       \n"
+"       adrp    x4, UnitTable               \n"
+"       add     x4, x4, :lo12:UnitTable     \n"
+"       ubfx    w5, w%[reg_pc], #%[shift], #%[bits] \n" // Home line of the PC
+"51:    add     x6, x4, x5, lsl #6          \n"
+"       mov     x7, #0                      \n"
+"53:    ldr     w0, [x6, x7, lsl #2]        \n"
+"       cmp     w0, w%[reg_pc]              \n"
 "       b.eq    52f                         \n"
-"       mov     x0, x4                      \n"
-"51:    ldr     x4, [x0]                    \n"
-"       ldr     x5, [x0, #32]               \n" // Fetch PC address now, we assume that the search was successful
-"       cbnz    x4, 53b                     \n"
+"       add     x7, x7, #1                  \n"
+"       cmp     x7, #%[slots]               \n"
+"       b.ne    53b                         \n"
+"       ldr     w0, [x6, #%[overflow]]      \n" // Not in this line. Continue if some units overflowed it
+"       add     w5, w5, #1                  \n"
+"       and     w5, w5, #%[mask]            \n"
+"       cbnz    w0, 51b                     \n"
 "       b 5f                                \n"
-"52:    ldp     x6, x4, [x0, #16]           \n"
-"       ldr     x5, [x4, #8]                \n"
-"       cbz     x5, 55f                     \n"
-"       stp     x4, x5, [x0, #16]           \n"
-"       add     x7, x0, #0x10               \n" // 4 -> 7
-"       str     x7, [x5]                    \n"
-"       stp     x6, x7, [x4]                \n"
-"       str     x4, [x6, #8]                \n"
-
+"52:    add     x6, x6, #%[entry]           \n"
+"       ldr     x12, [x6, x7, lsl #3]       \n"
+"       str     w%[reg_pc], [x2]            \n" // Refill the jump cache slot
+"       str     x12, [x2, #8]               \n"
 "55:                                        \n"
-"       ldr     x12, [x0, #%[offset]]       \n"
 #if EMU68_LOG_FETCHES
+"       orr     x0, x12, #0xff00000000000000\n"
+"       bic     x0, x0, #0x0000001000000000 \n"
+"       sub     x0, x0, #%[code]            \n"
 "       ldr     x1, [x0, #%[fcount]]        \n"
 "       add     x1, x1, #1                  \n"
 "       str     x1, [x0, #%[fcount]]        \n"
@@ -1879,6 +2662,10 @@ void  __attribute__((used)) stub_ExecutionLoop()
 
 "4:     mrs     x0, TPIDRRO_EL0             \n"
 "       bl      M68K_SaveContext            \n"
+#if EMU68_LAZY_FPU
+"       mrs     x0, TPIDRRO_EL0             \n"
+"       bl      M68K_SyncFPUContext         \n"
+#endif
 "       ldp     x27, x28, [sp, #1*16]       \n"
 "       ldp     x25, x26, [sp, #2*16]       \n"
 "       ldp     x23, x24, [sp, #3*16]       \n"
@@ -2038,6 +2825,17 @@ void  __attribute__((used)) stub_ExecutionLoop()
  [diff]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) - 
         __builtin_offsetof(struct M68KTranslationUnit, mt_UseCount)),
  [intreq]"i"(__builtin_offsetof(struct M68KState, INT)),
+ [shift]"i"(EMU68_HASHSHIFT),
+ [bits]"i"(EMU68_UNIT_TABLE_BITS),
+ [mask]"i"(EMU68_UNIT_TABLE_MASK),
+ [slots]"i"(UNIT_LINE_SLOTS),
+ [overflow]"i"(__builtin_offsetof(struct M68KUnitLine, ul_Overflow)),
+ [entry]"i"(__builtin_offsetof(struct M68KUnitLine, ul_Entry)),
+ [code]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode)),
+ [jcache]"i"(__builtin_offsetof(struct M68KState, JIT_JCACHE)),
+ [jc_hit]"i"(__builtin_offsetof(struct M68KState, JIT_JCACHE_HIT)),
+ [jc_miss]"i"(__builtin_offsetof(struct M68KState, JIT_JCACHE_MISS)),
+ [jc_bits]"i"(EMU68_JCACHE_BITS),
  [arm]"i"(__builtin_offsetof(struct M68KState, INT.ARM)),
  [err]"i"(__builtin_offsetof(struct M68KState, INT.ARM_err)),
  [ipl]"i"(__builtin_offsetof(struct M68KState, INT.IPL)),
@@ -2054,6 +2852,60 @@ void  __attribute__((used)) stub_ExecutionLoop()
 struct M68KState *__m68k_state;
 void MainLoop();
 
+#if defined(PISTORM) && PISTORM_WARM_RESET
+static uint32_t reset_cacr;
+
+/*
+    Restart the m68k after the reset line was pulled. Translated ROM code and the ROM itself
+    stay, units of RAM are released since RAM contents are about to change. Everything up to
+    the interrupt state is cleared and the CPU starts again from the reset vectors, which are
+    read from ROM through the overlay.
+*/
+void M68K_WarmReset(struct M68KState *ctx)
+{
+    uint32_t *vectors;
+
+    kprintf("[JIT] Warm reset at PC=%08x\n", BE32(ctx->PC));
+
+    M68K_RecordProfile();
+    M68K_ReleaseRAMUnits(JS_RELEASE_RESET);
+    M68K_ResetReturnStack();
+
+    /* Wait for the keyboard to release the line, then reset the peripherals the same way as at boot */
+    while (ps_reset_active())
+        asm volatile("yield");
+
+    ps_reset_self = 1;
+    ps_pulse_reset();
+    ps_reset_self = 0;
+
+    M68K_ResetOverlay();
+
+#if EMU68_M68K_MMU
+    /* Vectors are fetched from the physical space */
+    M68K_MMUReset();
+#endif
+
+    bzero(ctx, __builtin_offsetof(struct M68KState, INT));
+
+    for (int fp=0; fp < 8; fp++) {
+        ctx->FP[fp].u64 = 0x7fffffffffffffffULL;
+    }
+
+    asm volatile("mov %0, #0":"=r"(vectors));
+
+    ctx->ISP.u32 = BE32(vectors[0]);
+    ctx->PC = BE32(vectors[1]);
+    ctx->SR = BE16(SR_S | SR_IPL);
+    ctx->CACR = reset_cacr;
+    ctx->JIT_CACHE_FREE = M68K_GetCacheFree();
+
+    ctx->INT.ARM = 0;
+    ctx->INT.IPL = 0;
+    __atomic_store_n(&ctx->INT.RESET, 0, __ATOMIC_RELEASE);
+}
+#endif
+
 void M68K_StartEmu(void *addr, void *fdt)
 {
     void (*arm_code)();
@@ -2071,6 +2923,7 @@ void M68K_StartEmu(void *addr, void *fdt)
     //bzero((void *)4, 1020);
 
     __m68k_state = &__m68k;
+    M68K_ResetJumpCache();
 
     //*(uint32_t*)4 = 0;
 
@@ -2087,8 +2940,9 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.PC = BE32(*((uint32_t*)addr+1));
     __m68k.SR = BE16(SR_S | SR_IPL);
     __m68k.FPCR = 0;
-    __m68k.JIT_CACHE_TOTAL = tlsf_get_total_size(jit_tlsf);
-    __m68k.JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k.JIT_CACHE_TOTAL = M68K_GetCacheTotal();
+    __m68k.JIT_CACHE_FREE = M68K_GetCacheFree();
+    __m68k.JIT_CACHE_PINNED = M68K_GetCachePinned();
     __m68k.JIT_UNIT_COUNT = 0;
     __m68k.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
     __m68k.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
@@ -2100,6 +2954,58 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.JIT_CONTROL2 |= (emu68_ccrd  << JC2B_CCR_SCAN_DEPTH); 
     __m68k.JIT_CONTROL2 |= ((cs_dist - 1) << JC2B_CHIP_SLOWDOWN_RATIO);
     __m68k.JIT_CONTROL2 |= blitwait ? JC2F_BLITWAIT : 0;
+    __m68k.JIT_CONTROL2 |= smc_protect ? JC2F_SMC_PROTECT : 0;
+    __m68k.JIT_CONTROL2 |= adaptive_jit ? JC2F_ADAPTIVE_DEPTH : 0;
+    __m68k.JIT_CONTROL2 |= fpu_relaxed ? JC2F_FPU_RELAXED : 0;
+    __m68k.JIT_CONTROL2 |= profile ? JC2F_PROFILE : 0;
+#if EMU68_LOOP_PACING
+    __m68k.JIT_CONTROL2 |= loop_pacing ? JC2F_LOOP_PACING : 0;
+#endif
+#if EMU68_IDLE_WAIT
+    __m68k.JIT_CONTROL2 |= idle_wait ? JC2F_IDLE_WAIT : 0;
+#endif
+#if EMU68_NATIVE_CALLS
+    __m68k.JIT_CONTROL2 |= native_calls ? JC2F_NATIVE_CALLS : 0;
+#endif
+#if EMU68_TRANSLATE_AHEAD
+    __m68k.JIT_CONTROL2 |= translate_ahead ? JC2F_TRANSLATE_AHEAD : 0;
+#endif
+#if EMU68_M68K_MMU
+    __m68k.JIT_CONTROL2 |= m68k_mmu ? JC2F_M68K_MMU : 0;
+#endif
+#if EMU68_LOOP_PREFETCH
+    __m68k.JIT_CONTROL2 |= EMU68_LOOP_PREFETCH_DIST << JC2B_PREFETCH_DIST;
+#endif
+
+#if EMU68_PMU_PROFILE
+    /* Counters are per core, program them on the one running the m68k code */
+    if (pmu_profile)
+        PMU_Init();
+#endif
+
+#if EMU68_INSN_COUNTER_SAMPLED
+    if (!insn_count_precise)
+        M68K_InsnSampleInit();
+#endif
+
+#if EMU68_IDLE_WAIT
+    /* Polling loops sleep in wfe, the event stream of this core wakes them for the next pass */
+    if (idle_wait)
+    {
+        uint64_t freq, cntkctl;
+        uint32_t evnti = 0;
+
+        asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+        /* Event on rising edge of counter bit evnti, rate is freq / 2^(evnti + 1) */
+        while (evnti < 15 && (2ULL << (evnti + 1)) <= freq / EMU68_IDLE_WAIT_TICK_HZ)
+            evnti++;
+
+        asm volatile("mrs %0, CNTKCTL_EL1":"=r"(cntkctl));
+        cntkctl = (cntkctl & ~0xf0ULL) | (1 << 2) | (evnti << 4);
+        asm volatile("msr CNTKCTL_EL1, %0; isb"::"r"(cntkctl));
+    }
+#endif
 
 #else
     __m68k.D[0].u32 = BE32((uint32_t)pitch);
@@ -2113,14 +3019,33 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.ISP.u32 = BE32(BE32(__m68k.ISP.u32) - 4);
     __m68k.SR = BE16(SR_S | SR_IPL);
     __m68k.FPCR = 0;
-    __m68k.JIT_CACHE_TOTAL = tlsf_get_total_size(jit_tlsf);
-    __m68k.JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k.JIT_CACHE_TOTAL = M68K_GetCacheTotal();
+    __m68k.JIT_CACHE_FREE = M68K_GetCacheFree();
+    __m68k.JIT_CACHE_PINNED = M68K_GetCachePinned();
     __m68k.JIT_UNIT_COUNT = 0;
     __m68k.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
     __m68k.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
     __m68k.JIT_CONTROL |= (EMU68_M68K_INSN_DEPTH & JCCB_INSN_DEPTH_MASK) << JCCB_INSN_DEPTH;
     __m68k.JIT_CONTROL |= (EMU68_BRANCH_INLINE_DISTANCE & JCCB_INLINE_RANGE_MASK) << JCCB_INLINE_RANGE;
     __m68k.JIT_CONTROL |= (EMU68_MAX_LOOP_COUNT & JCCB_LOOP_COUNT_MASK) << JCCB_LOOP_COUNT;
+#if EMU68_BUS_LOG
+    /* Replay starts with the m68k reset, same as the recording did */
+    if (buslog_mode == BUSLOG_REPLAY)
+    {
+        uint32_t isp, pc;
+
+        BusLog_ResetVectors(&isp, &pc);
+
+        __m68k.D[0].u32 = 0;
+        __m68k.D[1].u32 = 0;
+        __m68k.D[2].u32 = 0;
+        __m68k.A[0].u32 = 0;
+        __m68k.A[6].u32 = 0;
+        __m68k.ISP.u32 = BE32(isp);
+        __m68k.PC = BE32(pc);
+    }
+    else
+#endif
     *(uint32_t*)(intptr_t)(BE32(__m68k.ISP.u32)) = 0;
 #endif
     of_node_t *node = dt_find_node("/chosen");
@@ -2151,6 +3076,23 @@ void M68K_StartEmu(void *addr, void *fdt)
             if (strstr(prop->op_value, "disassemble"))
                 disasm = 1;
 
+            extern int jit_report;
+            if (find_token(prop->op_value, "jit_report"))
+                jit_report = 1;
+
+#if EMU68_JIT_STATS && EMU68_BUS_PROFILE
+            if (find_token(prop->op_value, "bus_profile"))
+                bus_profile = 1;
+#endif
+
+#if EMU68_DISASM_DEFERRED
+            if (find_token(prop->op_value, "disassemble_deferred"))
+            {
+                disasm_deferred = 1;
+                disasm_publish();
+            }
+#endif
+
 #ifdef PISTORM
             extern uint32_t swap_df0_with_dfx;
             extern uint32_t move_slow_to_chip;
@@ -2164,10 +3106,22 @@ void M68K_StartEmu(void *addr, void *fdt)
 
             if (strstr(prop->op_value, "move_slow_to_chip"))
                 move_slow_to_chip = 1;
+
+#if PISTORM_WARM_RESET
+            if (find_token(prop->op_value, "warm_reset"))
+            {
+                kprintf("[JIT] Warm reset enabled\n");
+                ps_warm_reset = 1;
+            }
+#endif
 #endif
         }       
     }
 
+#if defined(PISTORM) && PISTORM_WARM_RESET
+    reset_cacr = __m68k.CACR;
+#endif
+
     kprintf("[JIT]\n");
     M68K_PrintContext(&__m68k);
 
@@ -2184,9 +3138,17 @@ asm volatile(
 
 #ifdef PISTORM
     extern volatile int housekeeper_enabled;
+#if EMU68_ASYNC_INT
+    if (ps_ipl_sgi_attach())
+        kprintf("[JIT] Housekeeper signals IPL changes by SGI, chained exits do not poll INT\n");
+#endif
     housekeeper_enabled = 1;
 #endif
 
+#if EMU68_BUS_LOG
+    BusLog_Start();
+#endif
+
     asm volatile("mrs %0, CNTPCT_EL0":"=r"(t1));
     asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
     asm volatile("mov %0, x%1":"=r"(m68k_pc):"i"(REG_PC));
@@ -2211,6 +3173,11 @@ asm volatile(
 
     kprintf("[JIT] Back from translated code.\n");
 
+    /* One line with the counters, parsed by scripts/run-qemu-virt-bench.sh */
+    kprintf("[JIT] Result: insn=%lld us=%lld cycles=%lld cmiss=%d jchit=%d jcmiss=%d units=%d vhit=%d\n",
+        __m68k.INSN_COUNT, 1000000 * (t2-t1) / frq, cnt2 - cnt1, __m68k.JIT_CACHE_MISS,
+        __m68k.JIT_JCACHE_HIT, __m68k.JIT_JCACHE_MISS, __m68k.JIT_UNIT_COUNT, __m68k.JIT_VICTIM_HIT);
+
     kprintf("[JIT]\n");
     M68K_PrintContext(&__m68k);
 
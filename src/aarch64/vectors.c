@@ -15,6 +15,10 @@
 #include "tlsf.h"
 #include "M68k.h"
 #include "cache.h"
+#include "trace.h"
+#include "buslog.h"
+#include "jitstats.h"
+#include "chipshadow.h"
 
 #define FULL_CONTEXT 1
 
@@ -87,12 +91,36 @@
 #define LOAD_CONTEXT    LOAD_SHORT_CONTEXT
 #endif
 
+/*
+    Short path of data aborts from the vectors. SYSBusFault works on the short frame, if it
+    declines the frame is rebuilt in full for SYSHandler
+*/
+#define BUS_FAULT_ENTRY(vec) \
+    "BusFault_" #vec ":                     \n" \
+        SAVE_SHORT_CONTEXT \
+    "       mov x0, sp                      \n" \
+    "       bl SYSBusFault                  \n" \
+    "       cbz w0, 1f                      \n" \
+        LOAD_SHORT_CONTEXT \
+    "       eret                            \n" \
+    "1:                                     \n" \
+        LOAD_SHORT_CONTEXT \
+        SAVE_FULL_CONTEXT \
+    "       mov x0, #0x" #vec "             \n" \
+    "       mov x1, sp                      \n" \
+    "       bl SYSHandler                   \n" \
+    "       b ExceptionExit                 \n"
+
 struct INT_shadow {
     uint16_t INTENA;
     uint16_t INTREQ;
     uint8_t  ARMPending;
 } INT_shadow;
 
+#if EMU68_ASYNC_INT
+volatile uint8_t *int_signal_gicc;
+#endif
+
 void  __attribute__((used)) __stub_vectors()
 { asm volatile(
 "       .section .vectors               \n"
@@ -130,6 +158,18 @@ void  __attribute__((used)) __stub_vectors()
 "                                       \n"
 "       .balign 0x80                    \n"
 "curr_el_spx_sync:                      \n" // The exception handler for a synchrous 
+#if EMU68_FAST_DATA_ABORT && EMU68_FAULT_DECODE_CACHE
+"       stp x0, x1, [sp, -16]!          \n" // Data abort (EC 0x24 or 0x25) on a translation
+"       mrs x0, ESR_EL1                 \n" // fault of any level takes the short path
+"       ubfx x1, x0, #27, #5            \n"
+"       cmp x1, #0x12                   \n"
+"       and x0, x0, #0x3c               \n"
+"       ccmp x0, #0x04, #0, eq          \n"
+"       ldp x0, x1, [sp], #16           \n"
+"       b.ne 1f                         \n"
+"       b BusFault_200                  \n" // Far branch, the short path is in .text
+"1:                                     \n"
+#endif
         SAVE_CONTEXT                        // exception from the current EL using the
 "       mov x0, #0x200                  \n" // current SP.
 "       mov x1, sp                      \n"
@@ -139,6 +179,13 @@ void  __attribute__((used)) __stub_vectors()
 "       .balign 0x80                    \n"
 "curr_el_spx_irq:                       \n" // The exception handler for an IRQ exception from 
 "       stp x0, x1, [sp, -16]!          \n" // the current EL using the current SP.
+#if EMU68_ASYNC_INT
+"       adrp x1, int_signal_gicc        \n" // GIC CPU interface set? Check for the INT signal
+"       ldr x1, [x1, :lo12:int_signal_gicc] \n"
+"       cbz x1, IRQ_Legacy              \n"
+"       b IRQ_Signal                    \n" // Far branch, the handler is in .text
+"IRQ_Legacy:                            \n"
+#endif
 "       mrs x0, SPSR_EL1                \n" // Get SPSR
 "       orr x0, x0, #0x080              \n" // Disable IRQ interrupt so that we are not disturbed on return
 "       msr SPSR_EL1, x0                \n"
@@ -153,6 +200,9 @@ void  __attribute__((used)) __stub_vectors()
 "       mrs x1, TPIDRRO_EL0             \n" // Load CPU context
 "       mov w0, #6                      \n" // Set level 6 IRQ
 "       strb w0, [x1, #%[pint]]         \n"
+#if EMU68_ASYNC_INT
+"       mov v29.s[3], wzr               \n" // INT changed, let chained code leave to main loop
+#endif
 "1:     ldp x0, x1, [sp], #16           \n" // Restore scratch registers
 "       eret                            \n"
 "                                       \n"
@@ -173,6 +223,9 @@ void  __attribute__((used)) __stub_vectors()
 "       mrs x1, TPIDRRO_EL0             \n" // Load CPU context
 "       mov w0, #6                      \n" // Set level 6 IRQ
 "       strb w0, [x1, #%[pint]]         \n"
+#if EMU68_ASYNC_INT
+"       mov v29.s[3], wzr               \n" // INT changed, let chained code leave to main loop
+#endif
 "1:     ldp x0, x1, [sp], #16           \n" // Restore scratch registers
 "       eret                            \n"
 "                                       \n"
@@ -185,11 +238,26 @@ void  __attribute__((used)) __stub_vectors()
 "       mrs x1, TPIDRRO_EL0             \n" // Load CPU context
 "       mov w0, #7                      \n" // Set level 7 IRQ
 "       strb w0, [x1, #%[perr]]         \n"
+#if EMU68_ASYNC_INT
+"       mov v29.s[3], wzr               \n" // INT changed, let chained code leave to main loop
+#endif
 "       ldp x0, x1, [sp], #16           \n" // Restore scratch registers
 "       eret                            \n"
 "                                       \n"
 "       .balign 0x80                    \n"
 "lower_el_aarch64_sync:                 \n" // The exception handler for a synchronous 
+#if EMU68_FAST_DATA_ABORT && EMU68_FAULT_DECODE_CACHE
+"       stp x0, x1, [sp, -16]!          \n" // Data abort (EC 0x24 or 0x25) on a translation
+"       mrs x0, ESR_EL1                 \n" // fault of any level takes the short path
+"       ubfx x1, x0, #27, #5            \n"
+"       cmp x1, #0x12                   \n"
+"       and x0, x0, #0x3c               \n"
+"       ccmp x0, #0x04, #0, eq          \n"
+"       ldp x0, x1, [sp], #16           \n"
+"       b.ne 1f                         \n"
+"       b BusFault_400                  \n" // Far branch, the short path is in .text
+"1:                                     \n"
+#endif
         SAVE_CONTEXT                        // exception from a lower EL (AArch64).
 "       mov x0, #0x400                  \n"
 "       mov x1, sp                      \n"
@@ -257,11 +325,77 @@ void  __attribute__((used)) __stub_vectors()
 "       eret                            \n"
 "                                       \n"
 "       .section .text                  \n"
+#if EMU68_ASYNC_INT
+"IRQ_Signal:                            \n" // x1 holds GIC CPU interface of this core
+"       ldr w0, [x1, #0x0c]             \n" // Read GICC_IAR, value is little endian
+"       str w0, [x1, #0x10]             \n" // SGI needs no handling beyond EOI, write GICC_EOIR
+"       rev w0, w0                      \n"
+"       and w0, w0, #0x3ff              \n"
+"       cmp w0, #%[sgi]                 \n" // INT signal from other core, INT is read by main loop
+"       b.eq 1f                         \n"
+"       cmp w0, #1023                   \n" // Spurious, nothing to do
+"       b.eq 1f                         \n"
+#if EMU68_PROFILER
+"       cmp w0, #%[psgi]                \n" // Profiler asks where the core runs now
+"       b.eq 2f                         \n"
+#endif
+"       b IRQ_Legacy                    \n" // Any other IRQ is mapped to level 6 as usual
+"1:     mov v29.s[3], wzr               \n" // Let chained code leave to main loop
+"       ldp x0, x1, [sp], #16           \n"
+"       eret                            \n"
+#if EMU68_PROFILER
+"2:     adrp x1, prof_sample            \n" // Store ELR and REG_PC, sequence number last
+"       add x1, x1, :lo12:prof_sample   \n"
+"       mrs x0, ELR_EL1                 \n"
+"       str x0, [x1]                    \n"
+"       str x18, [x1, #8]               \n"
+#if EMU68_INSN_COUNTER_SAMPLED
+"       mrs x0, PMEVCNTR4_EL0           \n" // ARM instructions retired, for sampled m68k count
+"       str x0, [x1, #24]               \n"
+#endif
+"       dmb ish                         \n"
+"       ldr x0, [x1, #16]               \n"
+"       add x0, x0, #1                  \n"
+"       str x0, [x1, #16]               \n"
+"       ldp x0, x1, [sp], #16           \n"
+"       eret                            \n"
+#endif
+#endif
+#if EMU68_FAST_DATA_ABORT && EMU68_FAULT_DECODE_CACHE
+        BUS_FAULT_ENTRY(200)
+        BUS_FAULT_ENTRY(400)
+#endif
+#if EMU68_BUS_SITES
+"       .globl SYSBusTrampoline         \n" // Called from patched bus sites with x0 and x30
+"SYSBusTrampoline:                      \n" // of translated code stored on the stack. The
+        SAVE_FULL_CONTEXT                   // load or store to emulate follows the blr.
+"       ldr x0, [sp, #256]              \n"
+"       str x0, [sp]                    \n"
+"       mrs x19, nzcv                   \n"
+"       mrs x20, daif                   \n"
+"       msr daifset, #3                 \n"
+"       mov x0, sp                      \n"
+"       ldr x1, [sp, #15*16]            \n"
+"       bl SYSBusAccess                 \n"
+"       msr daif, x20                   \n"
+"       msr nzcv, x19                   \n"
+"       ldr x0, [sp]                    \n"
+"       str x0, [sp, #256]              \n"
+        LOAD_FULL_CONTEXT
+"       add x30, x30, #4                \n"
+"       ret                             \n"
+#endif
 :
 :[pint]"i"(__builtin_offsetof(struct M68KState, INT.ARM)),
  [perr]"i"(__builtin_offsetof(struct M68KState, INT.ARM_err)),
  [intena]"i"(__builtin_offsetof(struct INT_shadow, INTENA)),
  [armpend]"i"(__builtin_offsetof(struct INT_shadow, ARMPending))
+#if EMU68_ASYNC_INT
+,[sgi]"i"(INT_SIGNAL_SGI)
+#if EMU68_PROFILER
+,[psgi]"i"(INT_PROFILE_SGI)
+#endif
+#endif
 
 );}
 
@@ -304,6 +438,42 @@ uint32_t z2_ram_autoconf = 1;
 uint64_t z2_ram_base = 0;
 
 uint32_t swap_df0_with_dfx = 0;
+
+#if PISTORM_VECTOR_SHADOW
+/*
+    Copy of the vector table at address 0 used by the main loop for interrupts with VBR 0. Entries
+    are filled on first use, bus writes to the table and OVL changes clear the valid bits
+*/
+uint32_t vector_shadow[256];
+uint32_t vector_shadow_valid[8];
+
+static inline void VectorShadowWrite(uint32_t far, int size)
+{
+    for (uint32_t i = far >> 2; i <= (far + size - 1) >> 2 && i < 256; i++)
+        vector_shadow_valid[i >> 5] &= ~(1U << (i & 31));
+}
+
+static inline void VectorShadowFlush()
+{
+    for (int i=0; i < 8; i++)
+        vector_shadow_valid[i] = 0;
+}
+#endif
+
+/* Amiga reset sets OVL again, ROM is visible at address 0 */
+void M68K_ResetOverlay()
+{
+    extern int fast_page0;
+
+    overlay = 1;
+
+#if PISTORM_VECTOR_SHADOW
+    VectorShadowFlush();
+#endif
+
+    if (fast_page0)
+        mmu_map(0xf80000, 0x0, 4096, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+}
 uint32_t spoof_df0_id = 0;
 
 uint32_t move_slow_to_chip = 0;
@@ -323,6 +493,102 @@ enum
 int block_c0;
 extern int zorro_disable;
 
+#if PISTORM_CHIP_PREFETCH
+/*
+    Read-ahead window for streams of CHIP RAM reads. Once PISTORM_CHIP_PREFETCH_RUN reads in a
+    row started exactly where the previous one ended, the 16 bytes holding the next read are
+    fetched with one wide bus transaction. Only reads continuing the stream are served from
+    the window, a location polled repeatedly always reaches the bus. Writes into the window
+    and all custom chip writes drop it, these may start DMA changing CHIP RAM.
+*/
+static struct {
+    uint32_t    pf_Base;
+    uint32_t    pf_Next;
+    uint32_t    pf_Run;
+    int         pf_Valid;
+    union {
+        uint64_t    pf_Data[2];
+        uint8_t     pf_Bytes[16];
+    };
+} chip_prefetch;
+
+static int ChipPrefetchRead(uint64_t *value, int size, uint32_t far)
+{
+    uint32_t offset = far & 15;
+    uint64_t v = 0;
+
+    if (far != chip_prefetch.pf_Next)
+    {
+        chip_prefetch.pf_Valid = 0;
+        chip_prefetch.pf_Run = 0;
+        chip_prefetch.pf_Next = far + size;
+        return 0;
+    }
+
+    chip_prefetch.pf_Run++;
+    chip_prefetch.pf_Next = far + size;
+
+    if (far + size > 0x200000 || offset + size > 16)
+        return 0;
+
+    if (!chip_prefetch.pf_Valid || chip_prefetch.pf_Base != (far & ~15))
+    {
+        if (chip_prefetch.pf_Run < PISTORM_CHIP_PREFETCH_RUN)
+            return 0;
+
+        uint128_t data = ps_read_128(far & ~15);
+
+        chip_prefetch.pf_Data[0] = data.hi;
+        chip_prefetch.pf_Data[1] = data.lo;
+        chip_prefetch.pf_Base = far & ~15;
+        chip_prefetch.pf_Valid = 1;
+    }
+
+    /* Bytes are in bus order, compose the big endian value */
+    for (int i=0; i < size; i++)
+        v = (v << 8) | chip_prefetch.pf_Bytes[offset + i];
+
+    *value = v;
+
+    return 1;
+}
+
+static inline void ChipPrefetchWrite(uint32_t far, int size)
+{
+    if (chip_prefetch.pf_Valid && far < chip_prefetch.pf_Base + 16 && far + size > chip_prefetch.pf_Base)
+        chip_prefetch.pf_Valid = 0;
+    if (far >= 0xdff000 && far < 0xe00000)
+        chip_prefetch.pf_Valid = 0;
+}
+#endif
+
+/* CHIP RAM written over the bus by native code, outside of the fault handler */
+void M68K_ChipWritten(uint32_t addr, uint32_t size)
+{
+#if PISTORM_VECTOR_SHADOW
+    if (addr < 0x400)
+        VectorShadowWrite(addr, size);
+#endif
+
+#if PISTORM_CHIP_PREFETCH
+    ChipPrefetchWrite(addr, size);
+#endif
+}
+
+/* Interrupt of a service core, the m68k sees it as EXTER at level 6 like any other ARM interrupt */
+void M68K_RaiseARMInt()
+{
+    extern struct M68KState *__m68k_state;
+
+    INT_shadow.ARMPending = 1;
+
+    if ((INT_shadow.INTENA & 0x6000) == 0x6000)
+    {
+        __m68k_state->INT.ARM = 0x01;
+        ps_ipl_sgi_kick();
+    }
+}
+
 int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
 {
     D(kprintf("[JIT:SYS] SYSWriteValToAddr(0x%x, %d, %p)\n", value, size, far));
@@ -335,6 +601,22 @@ int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
         far &= 0xffffffff;
     }
 
+#if EMU68_M68K_MMU
+    if (unlikely(m68k_mmu_enabled) && !M68K_MMUBusAddress(&far, 1))
+        return 1;
+#endif
+
+#if PISTORM_VECTOR_SHADOW
+    if (far < 0x400)
+        VectorShadowWrite(far, size);
+#endif
+
+#if PISTORM_CHIP_SHADOW
+    /* DMA may be started by this write, it reads CHIP RAM the m68k has written */
+    if (far >= 0xdff000 && far < 0xe00000)
+        ChipShadow_CustomWrite(far, size);
+#endif
+
     if (far == INTENA) {
         if (value & 0x8000) {
             INT_shadow.INTENA |= value & 0x7fff;
@@ -346,6 +628,9 @@ int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
             struct M68KState *ctx;
             asm volatile("mrs %0, TPIDRRO_EL0\n":"=r"(ctx));
             ctx->INT.ARM = 0x01;
+#if EMU68_ASYNC_INT
+            M68K_SignalINT();
+#endif
         }
     }
 
@@ -383,6 +668,10 @@ int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
             overlay = value & 1;
             extern int fast_page0;
 
+#if PISTORM_VECTOR_SHADOW
+            VectorShadowFlush();
+#endif
+
             /* If fast_page_zero is active either map to ROM or to physical ARM RAM at address 0 */
             if (fast_page0)
             {
@@ -455,6 +744,10 @@ int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
         return 1;
     }
 
+#if PISTORM_CHIP_PREFETCH
+    ChipPrefetchWrite(far, size);
+#endif
+
     switch(size)
     {
         case 1:
@@ -481,7 +774,16 @@ int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
     return 1;
 }
 
-int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far)
+/*
+    Reads from unmapped Z3 space return the byte at offset 1 + (address & 15) of this
+    table. The same pattern backs the read-only block mapped over unused Z3 space.
+*/
+const uint64_t SYSUnmappedPattern[5] = {
+    0xBAD00BAD00BAD00BULL, 0xAD00BAD00BAD00BAULL,
+    0x00BAD00BAD00BAD0ULL, 0x0BAD00BAD00BAD00ULL
+};
+
+static int ReadValFromBus(uint64_t *value, uint64_t *value2, int size, uint64_t far)
 {  
     D(kprintf("[JIT:SYS] SYSReadValFromAddr(%d, %p)\n", size, far));
 
@@ -495,12 +797,7 @@ int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far
 
     if (far >= 0x1000000) {
         // Unmapped Z3 address
-
-        static const uint64_t u64[5] = {
-            0xBAD00BAD00BAD00BULL, 0xAD00BAD00BAD00BAULL,
-            0x00BAD00BAD00BAD0ULL, 0x0BAD00BAD00BAD00ULL
-        };
-        uintptr_t p64 = (uintptr_t)&u64[2] - (15 - (far & 15));
+        uintptr_t p64 = (uintptr_t)&SYSUnmappedPattern[2] - (15 - (far & 15));
 
         switch (size)
         {
@@ -583,6 +880,11 @@ int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far
         }
     }
 
+#if PISTORM_CHIP_PREFETCH
+    if (size <= 4 && ChipPrefetchRead(value, size, far))
+        return 1;
+#endif
+
     switch(size)
     {
         case 1:
@@ -661,11 +963,49 @@ int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far
     return 1;
 }
 
+int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far)
+{
+#if EMU68_M68K_MMU
+    /* Invalid pages read as zero */
+    if (unlikely(m68k_mmu_enabled) && !M68K_MMUBusAddress(&far, 0))
+    {
+        *value = 0;
+        if (value2)
+            *value2 = 0;
+        return 1;
+    }
+#endif
+
+    int handled = ReadValFromBus(value, value2, size, far);
+
+#if EMU68_BUS_LOG
+    /* Log the value as the m68k gets it, after prefetch, overlay and all fixups */
+    if (unlikely(buslog_mode == BUSLOG_RECORD))
+        BusLog_Read(size, far, *value, size == 16 ? *value2 : 0);
+#endif
+
+    return handled;
+}
+
 #else
 
 int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
 {
     D(kprintf("[JIT:SYS] SYSWriteValToAddr(0x%x, %d, %p)\n", value, size, far));
+
+#if EMU68_M68K_MMU
+    if (unlikely(m68k_mmu_enabled) && !M68K_MMUBusAddress(&far, 1))
+        return 1;
+#endif
+
+#if EMU68_BUS_LOG
+    /* Replayed bus has no side effects, writes are dropped */
+    if (unlikely(buslog_mode == BUSLOG_REPLAY))
+    {
+        BusLog_ReplayWrite(size, far);
+        return 1;
+    }
+#endif
     
     switch(size)
     {
@@ -693,6 +1033,22 @@ int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
 int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far)
 {
     D(kprintf("[JIT:SYS] SYSReadValFromAddr(%d, %p)\n", size, far));
+
+#if EMU68_M68K_MMU
+    /* Invalid pages read as zero */
+    if (unlikely(m68k_mmu_enabled) && !M68K_MMUBusAddress(&far, 0))
+    {
+        *value = 0;
+        if (value2)
+            *value2 = 0;
+        return 1;
+    }
+#endif
+
+#if EMU68_BUS_LOG
+    if (unlikely(buslog_mode == BUSLOG_REPLAY))
+        return BusLog_ReplayRead(value, value2, size, far);
+#endif
     
     switch(size)
     {
@@ -733,12 +1089,8 @@ int SYSValidateUnit(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr,
     struct M68KTranslationUnit *unit;
     uint16_t *m68k_pc;
     uintptr_t corrected_far = far | (0xff00000000000000ULL);    // Fix the topmost bits
-    uintptr_t unit_far = corrected_far & ~0x0000001000000000;   // Clear the executable region bit
 
-    /* Adjust far of the M68KTranslationUnit */
-    unit_far = unit_far - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode);
-
-    unit = (void*)unit_far;
+    unit = M68K_UnitFromEntry((void *)far);
 
     m68k_pc = unit->mt_M68kAddress;
 
@@ -747,7 +1099,7 @@ int SYSValidateUnit(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr,
 
     if (unit)
     {
-        unit->mt_ARMEntryPoint = (void*)corrected_far;
+        M68K_SetEntryPoint(unit, (void*)corrected_far);
         elr = corrected_far;
         asm volatile("msr ELR_EL1, %0"::"r"(elr));
         return 1;
@@ -2156,6 +2508,311 @@ int SYSPageFaultReadHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64
     return handled;
 }
 
+#if EMU68_FAULT_DECODE_CACHE || EMU68_BUS_SITES
+/*
+    Decoded integer load or store. Faults repeat at the same few ARM addresses, decoding
+    of the opcode is cached by its address. The opcode is compared too, since code of freed
+    units is reused.
+*/
+struct AccessDecode {
+    uint64_t    ad_ELR;
+    uint32_t    ad_Opcode;
+    int16_t     ad_Offset;      /* Byte offset, or shift of the index for register offset */
+    uint8_t     ad_Size;        /* Access size in bytes */
+    uint8_t     ad_Flags;
+    uint8_t     ad_Rt;
+    uint8_t     ad_Rn;
+    uint8_t     ad_Rm;
+    uint8_t     ad_Extend;      /* Option field of register offset */
+};
+
+#define AD_LOAD     0x01
+#define AD_SEXT64   0x02        /* Loaded value is sign extended to 64 bits */
+#define AD_SEXT32   0x04        /* Loaded value is sign extended to 32 bits */
+#define AD_WB       0x08        /* Base is updated by the offset */
+#define AD_POST     0x10        /* Base is accessed without the offset */
+#define AD_REG      0x20        /* Register offset */
+
+static struct AccessDecode access_cache[EMU68_FAULT_DECODE_SLOTS];
+
+/* Decode integer load or store with immediate or register offset, returns 0 for anything else */
+static int DecodeAccess(uint32_t opcode, struct AccessDecode *d)
+{
+    uint8_t size = opcode >> 30;
+    uint8_t opc = (opcode >> 22) & 3;
+
+    /* PRFM and unallocated encodings. SP base is the stack of exception handler here */
+    if (size >= 2 && opc >= 2 && !(size == 2 && opc == 2))
+        return 0;
+    if (((opcode >> 5) & 31) == 31)
+        return 0;
+
+    d->ad_Size = 1 << size;
+    d->ad_Rt = opcode & 31;
+    d->ad_Rn = (opcode >> 5) & 31;
+    d->ad_Rm = 31;
+    d->ad_Extend = 3;
+    d->ad_Offset = 0;
+    d->ad_Flags = (opc == 0) ? 0 : (opc == 1) ? AD_LOAD : (opc == 2) ? (AD_LOAD | AD_SEXT64) : (AD_LOAD | AD_SEXT32);
+
+    /* Unsigned offset */
+    if ((opcode & 0x3f000000) == 0x39000000)
+    {
+        d->ad_Offset = ((opcode >> 10) & 0xfff) << size;
+    }
+    /* Unscaled, post- and pre-index */
+    else if ((opcode & 0x3f200000) == 0x38000000)
+    {
+        d->ad_Offset = ((int32_t)(opcode << 11)) >> 23;
+
+        switch ((opcode >> 10) & 3)
+        {
+            case 1:
+                d->ad_Flags |= AD_WB | AD_POST;
+                break;
+            case 2:
+                return 0;
+            case 3:
+                d->ad_Flags |= AD_WB;
+                break;
+        }
+    }
+    /* Register offset */
+    else if ((opcode & 0x3f200c00) == 0x38200800)
+    {
+        d->ad_Flags |= AD_REG;
+        d->ad_Rm = (opcode >> 16) & 31;
+        d->ad_Extend = (opcode >> 13) & 7;
+        d->ad_Offset = (opcode & 0x1000) ? size : 0;
+    }
+    else
+        return 0;
+
+    return 1;
+}
+
+static struct AccessDecode *GetAccessDecode(uint64_t elr)
+{
+    uint32_t opcode = LE32(*(uint32_t *)elr);
+    struct AccessDecode *d = &access_cache[(elr >> 2) & (EMU68_FAULT_DECODE_SLOTS - 1)];
+
+    if (d->ad_ELR == elr && d->ad_Opcode == opcode)
+        return d;
+
+    if (!DecodeAccess(opcode, d))
+    {
+        d->ad_ELR = 0;
+        return NULL;
+    }
+
+    d->ad_ELR = elr;
+    d->ad_Opcode = opcode;
+
+    return d;
+}
+
+static inline uint64_t AccessAddress(struct AccessDecode *d, uint64_t *ctx)
+{
+    uint64_t base = ctx[d->ad_Rn];
+
+    if (d->ad_Flags & AD_REG)
+    {
+        uint64_t index = (d->ad_Rm == 31) ? 0 : ctx[d->ad_Rm];
+
+        if (d->ad_Extend == 2)
+            index = (uint32_t)index;
+        else if (d->ad_Extend == 6)
+            index = (int64_t)(int32_t)index;
+
+        return base + (index << d->ad_Offset);
+    }
+
+    if (d->ad_Flags & AD_POST)
+        return base;
+
+    return base + d->ad_Offset;
+}
+
+/* Perform decoded access either on the bus or, if direct is set, on mapped memory */
+static int RunAccess(struct AccessDecode *d, uint64_t *ctx, uint64_t far, int direct)
+{
+    int handled = 1;
+
+    if (d->ad_Flags & AD_LOAD)
+    {
+        uint64_t value = 0;
+
+        if (!direct)
+            handled = SYSReadValFromAddr(&value, NULL, d->ad_Size, far);
+        else switch (d->ad_Size)
+        {
+            case 1: value = *(volatile uint8_t *)far; break;
+            case 2: value = *(volatile uint16_t *)far; break;
+            case 4: value = *(volatile uint32_t *)far; break;
+            case 8: value = *(volatile uint64_t *)far; break;
+        }
+
+        if (d->ad_Flags & (AD_SEXT64 | AD_SEXT32))
+        {
+            int shift = 64 - 8 * d->ad_Size;
+            value = (uint64_t)((int64_t)(value << shift) >> shift);
+            if (d->ad_Flags & AD_SEXT32)
+                value = (uint32_t)value;
+        }
+
+        if (handled && d->ad_Rt != 31)
+            ctx[d->ad_Rt] = value;
+    }
+    else
+    {
+        uint64_t value = (d->ad_Rt == 31) ? 0 : ctx[d->ad_Rt];
+
+        if (!direct)
+            handled = SYSWriteValToAddr(value, 0, d->ad_Size, far);
+        else switch (d->ad_Size)
+        {
+            case 1: *(volatile uint8_t *)far = value; break;
+            case 2: *(volatile uint16_t *)far = value; break;
+            case 4: *(volatile uint32_t *)far = value; break;
+            case 8: *(volatile uint64_t *)far = value; break;
+        }
+    }
+
+    if (d->ad_Flags & AD_WB)
+        ctx[d->ad_Rn] += d->ad_Offset;
+
+    return handled;
+}
+#endif
+
+#if EMU68_BUS_SITES
+/*
+    Entry from SYSBusTrampoline, elr points to the load or store of a patched bus site. The
+    address is probed with AT, accesses to mapped memory are done directly and the rest
+    goes to the bus.
+*/
+void SYSBusAccess(uint64_t *ctx, uint64_t elr)
+{
+    struct AccessDecode *d = GetAccessDecode(elr);
+    uint64_t far, par;
+
+    if (d == NULL)
+    {
+        kprintf("[JIT:SYS] Bus call with unsupported opcode %08x at %p\n", LE32(*(uint32_t *)elr), elr);
+        return;
+    }
+
+    far = AccessAddress(d, ctx);
+
+    if (d->ad_Flags & AD_LOAD)
+        asm volatile("at s1e1r, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(far));
+    else
+        asm volatile("at s1e1w, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(far));
+
+#if EMU68_M68K_MMU
+    /* Page of the translated space which is not in host tables yet, probe again once mapped */
+    if ((par & 1) && unlikely(m68k_mmu_enabled) && M68K_MMUFault(far, !(d->ad_Flags & AD_LOAD)))
+    {
+        if (d->ad_Flags & AD_LOAD)
+            asm volatile("at s1e1r, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(far));
+        else
+            asm volatile("at s1e1w, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(far));
+    }
+#endif
+#if defined(PISTORM) && PISTORM_CHIP_SHADOW
+    /* Clean page of CPU-private CHIP RAM, the store goes there and not to the bus */
+    if ((par & 1) && !(d->ad_Flags & AD_LOAD) && ChipShadow_Write(far))
+        asm volatile("at s1e1w, %1; isb; mrs %0, PAR_EL1":"=r"(par):"r"(far));
+#endif
+
+    if (!RunAccess(d, ctx, far, (par & 1) == 0))
+        kprintf("[JIT:SYS] Unhandled bus call: opcode %08x, address %p\n", d->ad_Opcode, far);
+}
+
+/* Count handled data aborts per ARM address, frequent ones become bus sites */
+static struct {
+    uint64_t    elr;
+    uint32_t    count;
+} bus_site_hits[EMU68_BUS_SITE_SLOTS];
+
+static void CountBusSite(uint64_t elr)
+{
+    uint32_t slot = (elr >> 2) & (EMU68_BUS_SITE_SLOTS - 1);
+
+    if (bus_site_hits[slot].elr != elr)
+    {
+        bus_site_hits[slot].elr = elr;
+        bus_site_hits[slot].count = 0;
+
+        Trace(TRACE_FAULT_SITE, elr, elr >> 32, 0, 0);
+    }
+
+    if (++bus_site_hits[slot].count == EMU68_BUS_SITE_THRESHOLD)
+    {
+        Trace(TRACE_FAULT_SITE, elr, elr >> 32, 1, 0);
+        M68K_MarkBusSite(elr);
+    }
+}
+#endif
+
+#if EMU68_FAST_DATA_ABORT && EMU68_FAULT_DECODE_CACHE
+/*
+    Translation fault entered through the short path, ctx holds x0 to x18 and x30 only. Returns 0
+    with nothing done if the access needs SYSHandler: m68k MMU active, opcode not an integer load
+    or store, or a register above x18 named by it.
+*/
+static inline int FastReg(uint8_t reg)
+{
+    return reg <= 18 || reg == 31;
+}
+
+int SYSBusFault(uint64_t *ctx)
+{
+    struct AccessDecode *d;
+    uint64_t elr, far, t0;
+    int write;
+
+#if EMU68_M68K_MMU
+    if (unlikely(m68k_mmu_enabled))
+        return 0;
+#endif
+
+    asm volatile("mrs %0, ELR_EL1":"=r"(elr));
+
+    d = GetAccessDecode(elr);
+
+    if (d == NULL || !FastReg(d->ad_Rt) || d->ad_Rn > 18 || ((d->ad_Flags & AD_REG) && !FastReg(d->ad_Rm)))
+        return 0;
+
+    t0 = JITStats_Time();
+    far = AccessAddress(d, ctx);
+    write = !(d->ad_Flags & AD_LOAD);
+
+    /* Writeback is undone, SYSHandler does the whole access again and reports it */
+    if (!RunAccess(d, ctx, far, 0))
+    {
+        if (d->ad_Flags & AD_WB)
+            ctx[d->ad_Rn] -= d->ad_Offset;
+        return 0;
+    }
+
+    asm volatile("msr ELR_EL1, %0"::"r"(elr + 4));
+
+#if EMU68_BUS_SITES
+    CountBusSite(elr);
+#endif
+
+    uint64_t ticks = JITStats_Time() - t0;
+    JITStats_Bus(far, write, ticks);
+#if EMU68_JIT_STATS && EMU68_BUS_PROFILE
+    if (unlikely(bus_profile))
+        JITStats_BusSite(elr, far, ticks);
+#endif
+
+    return 1;
+}
+#endif
+
 #undef D
 #define D(x)  x 
 
@@ -2171,7 +2828,50 @@ void SYSHandler(uint32_t vector, uint64_t *ctx)
     {
         int writeFault = (esr & (1 << 6)) != 0;
 
-        handled = writeFault ? SYSPageFaultWriteHandler(vector, ctx, elr, spsr, esr, far) : SYSPageFaultReadHandler(vector, ctx, elr, spsr, esr, far);
+        /* Permission fault on a page holding translated code, the store is restarted */
+        if (writeFault && (esr & 0x3c) == 0x0c && M68K_HandleCodeWrite(far))
+            handled = 1;
+#if defined(PISTORM) && PISTORM_CHIP_SHADOW
+        /* First write to a clean page of CPU-private CHIP RAM */
+        else if (writeFault && (esr & 0x3c) == 0x0c && ChipShadow_Write(far))
+            handled = 1;
+#endif
+#if EMU68_M68K_MMU
+        /* Translation or permission fault on a page the m68k tables have not given to host yet */
+        else if (unlikely(m68k_mmu_enabled) && ((esr & 0x3c) == 0x04 || (esr & 0x3c) == 0x0c) && M68K_MMUFault(far, writeFault))
+            handled = 1;
+#endif
+        else
+        {
+            uint64_t t0 = JITStats_Time();
+#if EMU68_FAULT_DECODE_CACHE
+            struct AccessDecode *d = GetAccessDecode(elr);
+
+            /* Integer loads and stores skip the full decoder */
+            if (d)
+            {
+                far = AccessAddress(d, ctx);
+                handled = RunAccess(d, ctx, far, 0);
+
+                if (!handled)
+                    kprintf("[JIT:SYS] Unhandled page fault: opcode %08x, %s %p\n", d->ad_Opcode, writeFault ? "write to" : "read from", far);
+
+                asm volatile("msr ELR_EL1, %0"::"r"(elr + 4));
+            }
+            else
+#endif
+            handled = writeFault ? SYSPageFaultWriteHandler(vector, ctx, elr, spsr, esr, far) : SYSPageFaultReadHandler(vector, ctx, elr, spsr, esr, far);
+#if EMU68_BUS_SITES
+            if (handled)
+                CountBusSite(elr);
+#endif
+            uint64_t ticks = JITStats_Time() - t0;
+            JITStats_Bus(far, writeFault, ticks);
+#if EMU68_JIT_STATS && EMU68_BUS_PROFILE
+            if (unlikely(bus_profile) && handled)
+                JITStats_BusSite(elr, far, ticks);
+#endif
+        }
     }
     else if ((vector & 0x1ff) == 0x00 && (esr & 0xf8000000) == 0x80000000)
     {
@@ -2312,9 +3012,18 @@ void SYSHandler(uint32_t vector, uint64_t *ctx)
 
     if (!handled)
     {
+        uint16_t *m68k_pc = M68K_GetFaultPC(elr);
+
         kprintf("[JIT:SYS] Exception with vector %04x. ELR=%p, SPSR=%08x, ESR=%p, FAR=%p\n", vector, elr, spsr, esr, far);
         kprintf("[JIT:SYS] Failed instruction: %08x\n", LE32(*(uint32_t*)elr));
 
+        /* PC register is updated lazily, take the address of failed m68k instruction from the map of the unit */
+        if (m68k_pc != NULL)
+        {
+            ctx[REG_PC] = (uintptr_t)m68k_pc;
+            kprintf("[JIT:SYS] Failed m68k instruction at %08x: %04x\n", m68k_pc, BE16(*m68k_pc));
+        }
+
         for (int i=0; i < 16; i++)
         {
             kprintf("[JIT:SYS]  X%02d=%p   X%02d=%p\n", 2*i, ctx[2*i], 2*i+1, ctx[2*i+1]);
@@ -24,9 +24,13 @@
 #endif
 #endif
 
-extern struct List ICache[EMU68_HASHSIZE];
+extern struct M68KUnitLine *UnitTable;
 extern struct M68KState *__m68k_state;
 
+/* PC and unit of the last dispatch. Cleared when the unit is released */
+uint32_t last_PC = 0xffffffff;
+struct M68KTranslationUnit *last_unit;
+
 /*
  * Call into a JIT-translated ARM code block.
  *
@@ -53,26 +57,89 @@ static void __attribute__((naked, noinline)) CallARMCode(
         "bx lr\n");
 }
 
+/* Walk the lookup table from the home line of PC, a hit costs a single cache line */
 static inline struct M68KTranslationUnit *FindUnit(uint16_t *PC)
 {
-    /* Perform search */
-    uint32_t hash = (uint32_t)(uintptr_t)PC;
-    struct List *bucket = &ICache[(hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK];
-    struct M68KTranslationUnit *node;
+    uint32_t pc = (uint32_t)(uintptr_t)PC;
+    uint32_t line = (pc >> EMU68_HASHSHIFT) & EMU68_UNIT_TABLE_MASK;
+    struct M68KUnitLine *l;
 
-    /* Go through the list of translated units */
-    ForeachNode(bucket, node)
+    do
     {
-        /* Check if unit is found */
-        if (node->mt_M68kAddress == PC)
+        l = &UnitTable[line];
+
+        for (int i=0; i < UNIT_LINE_SLOTS; i++)
         {
-            return node;
+            if (l->ul_M68kAddress[i] == pc)
+                return l->ul_Entry[i];
         }
-    }
+
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    } while (l->ul_Overflow != 0);
 
     return NULL;
 }
 
+/*
+    Direct-mapped jump cache in front of the lookup table, resolves frequent indirect targets
+    with a single compare. Slots hold units, released units are removed by M68K_FreeUnit
+*/
+static inline struct M68KTranslationUnit *FindUnitCached(struct M68KState *ctx, uint16_t *PC)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)PC;
+    struct M68KJumpCacheEntry *jc = &ctx->JIT_JCACHE[(pc >> 1) & EMU68_JCACHE_MASK];
+
+    if (likely(jc->jc_M68kAddress == pc))
+    {
+        ctx->JIT_JCACHE_HIT++;
+        return jc->jc_Entry;
+    }
+
+    ctx->JIT_JCACHE_MISS++;
+
+    struct M68KTranslationUnit *node = FindUnit(PC);
+
+    if (node != NULL)
+    {
+        jc->jc_M68kAddress = pc;
+        jc->jc_Entry = node;
+    }
+
+    return node;
+}
+
+/*
+    Run the unit. Exits do not tell which unit returned, the chain from the last dispatched unit
+    is followed to its first unpatched exit instead. If that exit leads to this unit it is
+    patched and next time branches here directly. A wrong guess is harmless, the exit has this
+    static target either way
+*/
+static inline void RunUnit(struct M68KState *ctx, struct M68KTranslationUnit *node)
+{
+#if EMU68_BLOCK_CHAINING
+    struct M68KTranslationUnit *last = last_unit;
+
+    for (int i=0; i < 16 && last != NULL && last->mt_ChainCount; i++)
+    {
+        struct M68KChainLink *link = &last->mt_ChainLinks[0];
+
+        if (link->ml_Target == NULL)
+        {
+            if (link->ml_M68kTarget == node->mt_M68kAddress)
+                M68K_ChainUnits(link, node);
+            break;
+        }
+
+        last = link->ml_Target;
+    }
+#endif
+
+    last_unit = node;
+    last_PC = (uint32_t)(uintptr_t)node->mt_M68kAddress;
+
+    CallARMCode(node->mt_ARMEntryPoint, ctx);
+}
+
 #ifdef PISTORM
 #ifndef PISTORM32
 
@@ -102,7 +169,6 @@ static inline int GetIPLLevel() { return 0; }
 void MainLoop()
 {
     struct M68KState *ctx = __m68k_state;
-    uint32_t last_PC = 0xffffffff;
 
     /* The JIT loop runs forever */
     while(1)
@@ -232,40 +298,23 @@ void MainLoop()
 
         if (likely(cacr & CACR_IE))
         {
-            /* The last PC is the same as currently set PC? */
-            if (last_PC == (uint32_t)(uintptr_t)PC)
-            {
-                /* PC hasn't changed, the unit is still valid from last iteration */
-                /* Fall through to translation lookup */
-            }
-
-            /* Find unit in the hashtable based on the PC value */
-            struct M68KTranslationUnit *node = FindUnit(PC);
-
-            /* Unit exists? */
-            if (node != NULL)
-            {
-                last_PC = (uint32_t)(uintptr_t)PC;
+            /* Find unit in the jump cache or the lookup table based on the PC value */
+            struct M68KTranslationUnit *node = FindUnitCached(ctx, PC);
 
-                /* Call the JIT-translated code */
-                CallARMCode(node->mt_ARMEntryPoint, ctx);
-                continue;
-            }
-
-            /* If we are that far there was no JIT unit found */
-            /* Get the code. This never fails */
-            node = M68K_GetTranslationUnit(PC);
-            last_PC = (uint32_t)(uintptr_t)PC;
+            /* If there was no JIT unit found get the code. This never fails */
+            if (unlikely(node == NULL))
+                node = M68K_GetTranslationUnit(PC);
 
             /* Call the JIT-translated code */
-            CallARMCode(node->mt_ARMEntryPoint, ctx);
+            RunUnit(ctx, node);
         }
         else
         {
             struct M68KTranslationUnit *node = NULL;
 
-            /* Uncached mode - reset last_PC */
+            /* Uncached mode - nothing is chained */
             last_PC = 0xffffffff;
+            last_unit = NULL;
 
             /* Find the unit */
             node = FindUnit(PC);
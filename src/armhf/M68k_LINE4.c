@@ -3117,6 +3117,76 @@ static uint32_t *EMIT_PEA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     return ptr;
 }
 
+#ifndef __aarch64__
+/*
+    Registers gathered into one LDM/STM at most. While a run is collected its members are the
+    most recently used ones, with pinned registers there has to be one more slot left for the
+    eviction or a member of the run could be spilled before it is stored
+*/
+#define MOVEM_RUN_MAX (EMU68_ARM_PINNED_REGS < 4 ? 4 : EMU68_ARM_PINNED_REGS < 7 ? 8 - EMU68_ARM_PINNED_REGS : 1)
+
+/*
+    Long MOVEM of registers in ascending order (D0 first) from or to [addr], addr is advanced
+    past the block. Consecutive registers mapped to ascending ARM registers go through one
+    LDM/STM with writeback, others are transferred with post-indexed LDR/STR. Register skip is
+    not loaded but its slot is stepped over.
+*/
+static uint32_t *EMIT_MOVEM_Run(uint32_t *ptr, uint8_t addr, uint8_t *run, int n, int load)
+{
+    if (n == 1)
+        *ptr++ = load ? ldr_offset_postindex(addr, run[0], 4) : str_offset_postindex(addr, run[0], 4);
+    else if (n > 1)
+    {
+        uint16_t list = 0;
+
+        for (int i=0; i < n; i++)
+            list |= 1 << run[i];
+
+        *ptr++ = load ? ldm_wb(addr, list) : stm_wb(addr, list);
+    }
+
+    return ptr;
+}
+
+static uint32_t *EMIT_MOVEM_Block(uint32_t *ptr, uint8_t addr, uint16_t regs, int load, uint8_t skip)
+{
+    uint8_t run[4];
+    int n = 0;
+
+    for (int i=0; i < 16; i++)
+    {
+        if ((regs & (1 << i)) == 0)
+            continue;
+
+        if (i == skip)
+        {
+            ptr = EMIT_MOVEM_Run(ptr, addr, run, n, load);
+            n = 0;
+            *ptr++ = add_immed(addr, addr, 4);
+            continue;
+        }
+
+        uint8_t reg = load ? RA_MapM68kRegisterForWrite(&ptr, i) : RA_MapM68kRegister(&ptr, i);
+
+        if (n && reg <= run[n - 1])
+        {
+            ptr = EMIT_MOVEM_Run(ptr, addr, run, n, load);
+            n = 0;
+        }
+
+        run[n++] = reg;
+
+        if (n == MOVEM_RUN_MAX)
+        {
+            ptr = EMIT_MOVEM_Run(ptr, addr, run, n, load);
+            n = 0;
+        }
+    }
+
+    return EMIT_MOVEM_Run(ptr, addr, run, n, load);
+}
+#endif
+
 static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)insn_consumed;
@@ -3142,6 +3212,31 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
 
         ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &base, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
 
+#ifndef __aarch64__
+        /* Three and more longs, store them in runs. Pre-decrement mask is reversed, A7 in bit 0 */
+        if (size && __builtin_popcount(mask) >= 3)
+        {
+            uint8_t addr = RA_AllocARMRegister(&ptr);
+            uint16_t regs = mask;
+
+            if ((opcode & 0x38) == 0x20)
+            {
+                regs = 0;
+                for (int i=0; i < 16; i++)
+                    if (mask & (0x8000 >> i))
+                        regs |= 1 << i;
+
+                *ptr++ = sub_immed(base, base, block_size);
+                RA_SetDirtyM68kRegister(&ptr, (opcode & 7) + 8);
+            }
+
+            *ptr++ = mov_reg(addr, base);
+            ptr = EMIT_MOVEM_Block(ptr, addr, regs, 0, 0xff);
+
+            RA_FreeARMRegister(&ptr, addr);
+        }
+        else
+#endif
         /* Pre-decrement mode? Decrease the base now */
         if ((opcode & 0x38) == 0x20)
         {
@@ -3313,6 +3408,31 @@ static uint32_t *EMIT_MOVEM(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
             *ptr++ = ldr_offset(base, rt1, offset);
         }
 #else
+        /* Three and more longs, load them in runs */
+        if (size && __builtin_popcount(mask) >= 3)
+        {
+            uint8_t addr = RA_AllocARMRegister(&ptr);
+            uint8_t postinc = (opcode & 0x38) == 0x18;
+
+            *ptr++ = mov_reg(addr, base);
+            ptr = EMIT_MOVEM_Block(ptr, addr, mask, 1, postinc ? (opcode & 7) + 8 : 0xff);
+
+            /* In post-increment mode addr is the new An now */
+            if (postinc)
+            {
+                uint8_t an = RA_MapM68kRegisterForWrite(&ptr, (opcode & 7) + 8);
+                *ptr++ = mov_reg(an, addr);
+            }
+
+            RA_FreeARMRegister(&ptr, addr);
+            RA_FreeARMRegister(&ptr, base);
+
+            ptr = EMIT_AdvancePC(ptr, 2*(ext_words + 1));
+            (*m68k_ptr) += ext_words;
+
+            return ptr;
+        }
+
         for (int i=0; i < 16; i++)
         {
             if (mask & (1 << i))
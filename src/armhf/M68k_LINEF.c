@@ -2161,16 +2161,12 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
                     e &= 0x00ffffffffffffffULL;
                     e |= 0xaa00000000000000ULL;
                     u->mt_ARMEntryPoint = (void*)e;
+                    M68K_UnchainUnit(u);
                 }
                 else
                 {
                     // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+                    M68K_FreeUnit(u);
                 }
             }
             break;
@@ -2195,15 +2191,11 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
                     e &= 0x00ffffffffffffffULL;
                     e |= 0xaa00000000000000ULL;
                     u->mt_ARMEntryPoint = (void*)e;
+                    M68K_UnchainUnit(u);
                 }
                 else
                 {
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+                    M68K_FreeUnit(u);
                 }
             }
             break;
@@ -2221,31 +2213,24 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
                         // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
                         // verify block checksum and eventually discard it
                         *(uint8_t *)uptr = 0xaa;
+                        M68K_UnchainUnit((struct M68KTranslationUnit *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode)));
                     }
                 }
                 else
                 {
-                    while ((n = REMHEAD(&LRU))) {
-                        u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        // kprintf("[LINEF] Removing unit %p\n", u);                
-                        REMOVE(&u->mt_HashNode);
-                        tlsf_free(jit_tlsf, u);
-                        
-                        __m68k_state->JIT_UNIT_COUNT--;
-                        __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+                    while (!IsListEmpty(&LRU)) {
+                        u = (struct M68KTranslationUnit *)((intptr_t)LRU.lh_Head - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+                        // kprintf("[LINEF] Removing unit %p\n", u);
+                        M68K_FreeUnit(u);
                     }
                 }
             }
             else
             {
-                while ((n = REMHEAD(&LRU))) {
-                    u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                    // kprintf("[LINEF] Removing unit %p\n", u);                
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+                while (!IsListEmpty(&LRU)) {
+                    u = (struct M68KTranslationUnit *)((intptr_t)LRU.lh_Head - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+                    // kprintf("[LINEF] Removing unit %p\n", u);
+                    M68K_FreeUnit(u);
                 }
             }
             break;
@@ -4077,6 +4062,30 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
     return ptr;
 }
 
+#ifndef __aarch64__
+/*
+    Copy of one 16 byte line for MOVE16 through the NEON unit, GPRs are not needed for the data.
+    Temporaries are allocated in order and are d1/d2 normally, otherwise a pair of VLDR/VSTR
+*/
+static uint32_t *EMIT_Line16(uint32_t *ptr, uint8_t src, uint8_t dst, uint8_t d1, uint8_t d2)
+{
+    if (d2 == d1 + 1)
+    {
+        *ptr++ = vld1_64x2(d1, src);
+        *ptr++ = vst1_64x2(d1, dst);
+    }
+    else
+    {
+        *ptr++ = fldd(d1, src, 0);
+        *ptr++ = fldd(d2, src, 2);
+        *ptr++ = fstd(d1, dst, 0);
+        *ptr++ = fstd(d2, dst, 2);
+    }
+
+    return ptr;
+}
+#endif
+
 uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     uint16_t opcode = BE16((*m68k_ptr)[0]);
@@ -4178,11 +4187,12 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
     {
         uint8_t aligned_src = RA_AllocARMRegister(&ptr);
         uint8_t aligned_dst = RA_AllocARMRegister(&ptr);
+#ifdef __aarch64__
         uint8_t buf1 = RA_AllocARMRegister(&ptr);
         uint8_t buf2 = RA_AllocARMRegister(&ptr);
-#ifndef __aarch64__
-        uint8_t buf3 = RA_AllocARMRegister(&ptr);
-        uint8_t buf4 = RA_AllocARMRegister(&ptr);
+#else
+        uint8_t buf1 = RA_AllocFPURegister(&ptr);
+        uint8_t buf2 = RA_AllocFPURegister(&ptr);
 #endif
         uint8_t src = RA_MapM68kRegister(&ptr, 8 + (opcode & 7));
         uint8_t dst = RA_MapM68kRegister(&ptr, 8 + ((opcode2 >> 12) & 7));
@@ -4195,8 +4205,7 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 #else
         *ptr++ = bic_immed(aligned_src, src, 0x0f);
         *ptr++ = bic_immed(aligned_dst, dst, 0x0f);
-        *ptr++ = ldm(aligned_src, (1 << buf1) | (1 << buf2) | (1 << buf3) | (1 << buf4));
-        *ptr++ = stm(aligned_dst, (1 << buf1) | (1 << buf2) | (1 << buf3) | (1 << buf4));
+        ptr = EMIT_Line16(ptr, aligned_src, aligned_dst, buf1, buf2);
 #endif
         *ptr++ = add_immed(src, src, 16);
         // Update dst only if it is not the same as src!
@@ -4209,11 +4218,12 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 
         RA_FreeARMRegister(&ptr, aligned_src);
         RA_FreeARMRegister(&ptr, aligned_dst);
+#ifdef __aarch64__
         RA_FreeARMRegister(&ptr, buf1);
         RA_FreeARMRegister(&ptr, buf2);
-#ifndef __aarch64__
-        RA_FreeARMRegister(&ptr, buf3);
-        RA_FreeARMRegister(&ptr, buf4);
+#else
+        RA_FreeFPURegister(&ptr, buf1);
+        RA_FreeFPURegister(&ptr, buf2);
 #endif
         (*m68k_ptr)+=2;
         *insn_consumed = 1;
@@ -4224,11 +4234,12 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
     {
         uint8_t aligned_reg = RA_AllocARMRegister(&ptr);
         uint8_t aligned_mem = RA_AllocARMRegister(&ptr);
+#ifdef __aarch64__
         uint8_t buf1 = RA_AllocARMRegister(&ptr);
         uint8_t buf2 = RA_AllocARMRegister(&ptr);
-#ifndef __aarch64__
-        uint8_t buf3 = RA_AllocARMRegister(&ptr);
-        uint8_t buf4 = RA_AllocARMRegister(&ptr);
+#else
+        uint8_t buf1 = RA_AllocFPURegister(&ptr);
+        uint8_t buf2 = RA_AllocFPURegister(&ptr);
 #endif
         uint8_t reg = RA_MapM68kRegister(&ptr, 8 + (opcode & 7));
         uint32_t mem = (BE16((*m68k_ptr)[1]) << 16) | BE16((*m68k_ptr)[2]);
@@ -4250,14 +4261,10 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
         }
 #else
         *ptr++ = bic_immed(aligned_reg, reg, 0x0f);
-        if (opcode & 8) {
-            *ptr++ = ldm(aligned_mem, (1 << buf1) | (1 << buf2) | (1 << buf3) | (1 << buf4));
-            *ptr++ = stm(aligned_reg, (1 << buf1) | (1 << buf2) | (1 << buf3) | (1 << buf4));
-        }
-        else {
-            *ptr++ = ldm(aligned_reg, (1 << buf1) | (1 << buf2) | (1 << buf3) | (1 << buf4));
-            *ptr++ = stm(aligned_mem, (1 << buf1) | (1 << buf2) | (1 << buf3) | (1 << buf4));
-        }
+        if (opcode & 8)
+            ptr = EMIT_Line16(ptr, aligned_mem, aligned_reg, buf1, buf2);
+        else
+            ptr = EMIT_Line16(ptr, aligned_reg, aligned_mem, buf1, buf2);
 #endif
         if (!(opcode & 0x10))
         {
@@ -4267,11 +4274,12 @@ uint32_t *EMIT_lineF(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed
 
         RA_FreeARMRegister(&ptr, aligned_reg);
         RA_FreeARMRegister(&ptr, aligned_mem);
+#ifdef __aarch64__
         RA_FreeARMRegister(&ptr, buf1);
         RA_FreeARMRegister(&ptr, buf2);
-#ifndef __aarch64__
-        RA_FreeARMRegister(&ptr, buf3);
-        RA_FreeARMRegister(&ptr, buf4);
+#else
+        RA_FreeFPURegister(&ptr, buf1);
+        RA_FreeFPURegister(&ptr, buf2);
 #endif
         (*m68k_ptr)+=3;
         *insn_consumed = 1;
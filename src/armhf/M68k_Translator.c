@@ -34,12 +34,25 @@ int disasm = 0;
 int debug = 0;
 const int debug_cnt = 0;
 
-struct List *ICache;
+/*
+    Open-addressed lookup table, same layout as on AArch64. Entries hold the units, not their
+    entry points, the main loop takes the entry point from the unit
+*/
+struct M68KUnitLine *UnitTable;
 struct List LRU;
 static uint32_t *temporary_arm_code;
 static uint32_t *translated_arm_code;
 static struct M68KLocalState *local_state;
 
+/* Unit run last by the main loop, candidate for chaining to the next one */
+extern struct M68KTranslationUnit *last_unit;
+
+#if EMU68_BLOCK_CHAINING
+/* Offset of the chainable exit in translated code or -1, and its m68k target */
+static int32_t chain_site;
+static uint16_t *chain_target;
+#endif
+
 int32_t _pc_rel = 0;
 
 uint32_t *EMIT_GetOffsetPC(uint32_t *ptr, int8_t *offset)
@@ -229,6 +242,280 @@ extern uint32_t pistorm_get_tracepc_start(void);
 extern uint32_t pistorm_get_tracepc_end(void);
 #endif
 
+static inline uint32_t UnitTable_Home(uint16_t *m68k_address)
+{
+    return ((uintptr_t)m68k_address >> EMU68_HASHSHIFT) & EMU68_UNIT_TABLE_MASK;
+}
+
+static inline struct M68KJumpCacheEntry *JumpCache_Entry(uint16_t *m68k_address)
+{
+    return &__m68k_state->JIT_JCACHE[((uintptr_t)m68k_address >> 1) & EMU68_JCACHE_MASK];
+}
+
+static struct M68KTranslationUnit *UnitTable_Find(uint16_t *m68k_address)
+{
+    uint32_t line = UnitTable_Home(m68k_address);
+    struct M68KUnitLine *l;
+
+    do
+    {
+        l = &UnitTable[line];
+
+        for (int i=0; i < UNIT_LINE_SLOTS; i++)
+        {
+            if (l->ul_M68kAddress[i] == (uint32_t)(uintptr_t)m68k_address)
+                return l->ul_Entry[i];
+        }
+
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    } while (l->ul_Overflow != 0);
+
+    return NULL;
+}
+
+/* First free slot starting at the home line, lines passed on the way count the overflow */
+static void UnitTable_Insert(struct M68KTranslationUnit *unit)
+{
+    uint32_t line = UnitTable_Home(unit->mt_M68kAddress);
+
+    while(1)
+    {
+        struct M68KUnitLine *l = &UnitTable[line];
+
+        for (int i=0; i < UNIT_LINE_SLOTS; i++)
+        {
+            if (l->ul_M68kAddress[i] == UNIT_SLOT_EMPTY)
+            {
+                l->ul_Entry[i] = unit;
+                l->ul_M68kAddress[i] = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+                unit->mt_TableSlot = line * UNIT_LINE_SLOTS + i;
+
+                return;
+            }
+        }
+
+        l->ul_Overflow++;
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    }
+}
+
+static void UnitTable_Remove(struct M68KTranslationUnit *unit)
+{
+    uint32_t slot_line = unit->mt_TableSlot / UNIT_LINE_SLOTS;
+    uint32_t line = UnitTable_Home(unit->mt_M68kAddress);
+    struct M68KJumpCacheEntry *jc = JumpCache_Entry(unit->mt_M68kAddress);
+
+    if (jc->jc_M68kAddress == (uint32_t)(uintptr_t)unit->mt_M68kAddress)
+    {
+        jc->jc_M68kAddress = UNIT_SLOT_EMPTY;
+        jc->jc_Entry = NULL;
+    }
+
+    while (line != slot_line)
+    {
+        UnitTable[line].ul_Overflow--;
+        line = (line + 1) & EMU68_UNIT_TABLE_MASK;
+    }
+
+    UnitTable[slot_line].ul_M68kAddress[unit->mt_TableSlot % UNIT_LINE_SLOTS] = UNIT_SLOT_EMPTY;
+}
+
+#if EMU68_BLOCK_CHAINING
+/*
+    Final exit with static m68k target, emitted after the registers are popped. Unless an
+    interrupt is pending or the JIT cache is disabled the instruction at CHAIN_SITE_OFFSET is
+    taken. M68K_ChainUnits patches it into b <target>, or into ldr pc of the literal behind it
+    if the target is out of reach of b
+*/
+static uint32_t *EMIT_ChainSite(uint32_t *ptr)
+{
+    *ptr++ = ldr_offset(REG_CTX, 0, __builtin_offsetof(struct M68KState, INT));
+    *ptr++ = cmp_immed(0, 0);
+    *ptr++ = bx_cc_lr(ARM_CC_NE);
+    *ptr++ = ldr_offset(REG_CTX, 0, __builtin_offsetof(struct M68KState, CACR));
+    *ptr++ = tst_immed(0, 0x902);       /* #CACR_IE */
+    *ptr++ = bx_cc_lr(ARM_CC_EQ);
+    *ptr++ = bx_lr();                   /* Patched by M68K_ChainUnits */
+    *ptr++ = 0;
+
+    return ptr;
+}
+
+static void UnchainLink(struct M68KChainLink *link)
+{
+    *link->ml_Site = bx_lr();
+    link->ml_Target = NULL;
+
+    arm_flush_cache((uintptr_t)link->ml_Site, 4);
+    arm_icache_invalidate((uintptr_t)link->ml_Site, 4);
+}
+
+/* Patch the exit of link into a direct branch to target. Units with poisoned entry are not linked */
+void M68K_ChainUnits(struct M68KChainLink *link, struct M68KTranslationUnit *target)
+{
+    uintptr_t entry = (uintptr_t)&target->mt_ARMCode[0];
+    uintptr_t site = (uintptr_t)link->ml_Site;
+    intptr_t distance = entry - (site + 8);
+
+    if (link->ml_Target != NULL || (uintptr_t)target->mt_ARMEntryPoint != entry)
+        return;
+
+    if (distance >= -(32 << 20) && distance < (32 << 20))
+    {
+        link->ml_Site[0] = b_cc(ARM_CC_AL, distance >> 2);
+    }
+    else
+    {
+        /* Veneer, ldr pc, [pc, #-4] */
+        link->ml_Site[1] = entry;
+        link->ml_Site[0] = ldr_offset(15, 15, -4);
+    }
+
+    link->ml_Target = target;
+    ADDHEAD(&target->mt_ChainIn, &link->ml_Node);
+
+    arm_flush_cache(site, 8);
+    arm_icache_invalidate(site, 8);
+}
+#endif
+
+/* Revert all direct branches from other units into this one */
+void M68K_UnchainUnit(struct M68KTranslationUnit *unit)
+{
+#if EMU68_BLOCK_CHAINING
+    struct M68KChainLink *link;
+
+    while ((link = (struct M68KChainLink *)REMHEAD(&unit->mt_ChainIn)))
+    {
+        UnchainLink(link);
+    }
+#else
+    (void)unit;
+#endif
+}
+
+/* Remove the unit from all lists and tables, revert chains from and to it and release it */
+void M68K_FreeUnit(struct M68KTranslationUnit *unit)
+{
+    REMOVE(&unit->mt_LRUNode);
+    UnitTable_Remove(unit);
+
+    M68K_UnchainUnit(unit);
+
+#if EMU68_BLOCK_CHAINING
+    for (uint32_t i=0; i < unit->mt_ChainCount; i++)
+    {
+        if (unit->mt_ChainLinks[i].ml_Target != NULL)
+            REMOVE(&unit->mt_ChainLinks[i].ml_Node);
+    }
+#endif
+
+    if (last_unit == unit)
+        last_unit = NULL;
+
+    tlsf_free(jit_tlsf, unit);
+
+    __m68k_state->JIT_UNIT_COUNT--;
+    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+}
+
+/*
+    Usage of D/A registers in the straight code of a unit, stops at the first unconditional
+    flow change. EA fields of the opcode and register fields of bits 9-11 are counted, extension
+    words are not. Returns mask of at most EMU68_ARM_PINNED_REGS registers referenced more than once
+*/
+static uint16_t M68K_ScanRegisterUsage(uint16_t *m68kcodeptr, uint32_t depth)
+{
+    uint16_t count[16] = { 0 };
+    uint16_t mask = 0;
+
+    for (uint32_t i=0; i < depth; i++)
+    {
+        uint16_t opcode = BE16(*m68kcodeptr);
+        uint8_t line = opcode >> 12;
+        uint8_t mode = (opcode >> 3) & 7;
+        uint8_t reg2 = (opcode >> 9) & 7;
+        int len = M68K_GetINSNLength(m68kcodeptr);
+
+        if (len <= 0)
+            break;
+
+        /* Source or single EA, An for modes 1 to 6. Bcc, MOVEQ and line A have none */
+        if (line == 14 && (opcode & 0x00c0) != 0x00c0)
+            count[opcode & 7]++;
+        else if (line == 5 && (opcode & 0x00f8) == 0x00c8)
+            count[opcode & 7]++;
+        else if (line != 6 && line != 7 && line != 10)
+        {
+            if (mode == 0)
+                count[opcode & 7]++;
+            else if (mode < 7)
+                count[8 + (opcode & 7)]++;
+        }
+
+        switch (line)
+        {
+            case 1: case 2: case 3:     /* MOVE destination */
+                mode = (opcode >> 6) & 7;
+                if (mode == 0)
+                    count[reg2]++;
+                else if (mode < 7)
+                    count[8 + reg2]++;
+                break;
+            case 0:                     /* Dynamic bit operations */
+                if (opcode & 0x0100)
+                    count[reg2]++;
+                break;
+            case 4:                     /* LEA, CHK */
+                if ((opcode & 0x01c0) == 0x01c0)
+                    count[8 + reg2]++;
+                else if (opcode & 0x0100)
+                    count[reg2]++;
+                break;
+            case 7:                     /* MOVEQ, OR, AND */
+            case 8: case 12:
+                count[reg2]++;
+                break;
+            case 9: case 11: case 13:   /* An for ADDA, SUBA, CMPA */
+                if ((opcode & 0x00c0) == 0x00c0)
+                    count[8 + reg2]++;
+                else
+                    count[reg2]++;
+                break;
+            case 14:                    /* Shift count in a register */
+                if ((opcode & 0x00e0) == 0x0020 || (opcode & 0x00e0) == 0x00a0)
+                    count[reg2]++;
+                break;
+        }
+
+        /* RTE, RTD, RTS, RTR, JMP, BRA */
+        if (opcode == 0x4e73 || opcode == 0x4e74 || opcode == 0x4e75 || opcode == 0x4e77)
+            break;
+        if ((opcode & 0xffc0) == 0x4ec0 || (opcode & 0xff00) == 0x6000)
+            break;
+
+        m68kcodeptr += len;
+    }
+
+    for (int n=0; n < EMU68_ARM_PINNED_REGS; n++)
+    {
+        int best = -1;
+
+        for (int r=0; r < 16; r++)
+        {
+            if (!(mask & (1 << r)) && count[r] > 1 && (best == -1 || count[r] > count[best]))
+                best = r;
+        }
+
+        if (best == -1)
+            break;
+
+        mask |= 1 << best;
+    }
+
+    return mask;
+}
+
 static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
 {
     uint16_t *orig_m68kcodeptr = m68kcodeptr;
@@ -291,6 +578,9 @@ extern uint32_t pistorm_force_tiny_translation_unit(uint32_t pc);
     conditionals_count = 0;
 
     insn_count = 0;
+#if EMU68_BLOCK_CHAINING
+    chain_site = -1;
+#endif
     uint32_t *arm_code = temporary_arm_code;
     uint32_t *end = arm_code;
 
@@ -320,6 +610,9 @@ extern uint32_t pistorm_force_tiny_translation_unit(uint32_t pc);
     }
 #endif
 
+    /* Most used registers of the unit stay in ARM registers from here to the end */
+    RA_PinM68kRegisters(&end, M68K_ScanRegisterUsage(m68kcodeptr, var_EMU68_M68K_INSN_DEPTH));
+
     prologue_size = end - tmpptr;
 
     int break_loop = FALSE;
@@ -583,7 +876,22 @@ extern uint32_t pistorm_force_tiny_translation_unit(uint32_t pc);
         }
     }
     if (!lr_is_saved)
+    {
+#if EMU68_BLOCK_CHAINING
+        /*
+            Unit not broken by a flow change ends with PC at the next m68k instruction, or at its
+            own start for a loop. This exit can branch directly into the unit of that PC
+        */
+        if (!break_loop && !soft_break)
+        {
+            chain_site = end - arm_code;
+            chain_target = m68kcodeptr;
+            end = EMIT_ChainSite(end);
+        }
+        else
+#endif
         *end++ = bx_lr();
+    }
 #else
     uint8_t ctx = RA_GetCTX(&end);
     uint8_t tmp = RA_AllocARMRegister(&end);
@@ -689,13 +997,7 @@ struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
 
         if (crc != unit->mt_CRC32)
         {
-            REMOVE(&unit->mt_LRUNode);
-            REMOVE(&unit->mt_HashNode);
-            tlsf_free(jit_tlsf, unit);
-
-            __m68k_state->JIT_UNIT_COUNT--;
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-
+            M68K_FreeUnit(unit);
             unit = NULL;
         }
     }
@@ -711,57 +1013,49 @@ struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
 */
 struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
 {
-    struct M68KTranslationUnit *unit = NULL, *n;
-    uintptr_t hash = (uintptr_t)m68kcodeptr;
+    struct M68KTranslationUnit *unit;
     uint16_t *orig_m68kcodeptr = m68kcodeptr;
     
     m68k_low = m68kcodeptr;
     m68k_high = m68kcodeptr;
 
-    /* Get 16-bit has from the pointer to m68k code */
-    hash = (hash ^ (hash >> 16)) & 0xffff;
-
     if (debug > 2)
-        kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Hash: 0x%04x\n", (void*)m68kcodeptr, (int)hash);
+        kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Home line: 0x%04x\n", (void*)m68kcodeptr, (int)UnitTable_Home(m68kcodeptr));
 
     /* Find entry with correct address */
-    ForeachNode(&ICache[hash], n)
+    unit = UnitTable_Find(m68kcodeptr);
+    if (unit != NULL)
     {
-        if (n->mt_M68kAddress == m68kcodeptr)
-        {
-            /* Unit found? Move it to the front of LRU list */
-            unit = n;
-
-            struct Node *this = &unit->mt_LRUNode;
+        /* Unit found? Move it to the front of LRU list */
+        struct Node *this = &unit->mt_LRUNode;
 
 #ifdef __aarch64__
-            /* Correct unit found. Preload ICache */
-            //asm volatile ("prfm plil1keep, [%0]"::"r"(unit->mt_ARMEntryPoint));
+        /* Correct unit found. Preload ICache */
+        //asm volatile ("prfm plil1keep, [%0]"::"r"(unit->mt_ARMEntryPoint));
 #endif
-            if (1)
-            {
-                // Update LRU for least *frequently* used strategy
-                if (this->ln_Pred->ln_Pred) {
-                    struct Node *pred = this->ln_Pred;
-                    struct Node *succ = this->ln_Succ;
-
-                    this->ln_Pred = pred->ln_Pred;
-                    this->ln_Succ = pred;
-                    this->ln_Pred->ln_Succ = this;
-                    pred->ln_Pred = this;
-                    pred->ln_Succ = succ;
-                    succ->ln_Pred = pred;
-                }
-            }
-            else
-            {
-                // Update LRU for least *recently* used strategy
-                REMOVE(&unit->mt_LRUNode);
-                ADDHEAD(&LRU, &unit->mt_LRUNode);
+        if (1)
+        {
+            // Update LRU for least *frequently* used strategy
+            if (this->ln_Pred->ln_Pred) {
+                struct Node *pred = this->ln_Pred;
+                struct Node *succ = this->ln_Succ;
+
+                this->ln_Pred = pred->ln_Pred;
+                this->ln_Succ = pred;
+                this->ln_Pred->ln_Succ = this;
+                pred->ln_Pred = this;
+                pred->ln_Succ = succ;
+                succ->ln_Pred = pred;
             }
-
-            return unit;
         }
+        else
+        {
+            // Update LRU for least *recently* used strategy
+            REMOVE(&unit->mt_LRUNode);
+            ADDHEAD(&LRU, &unit->mt_LRUNode);
+        }
+
+        return unit;
     }
 
     if (unit == NULL)
@@ -769,11 +1063,26 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
         uintptr_t line_length = M68K_Translate(m68kcodeptr);
         uintptr_t arm_insn_count = line_length/4 - 1;
 
+        /* Chain link of the unit follows its code */
+        uintptr_t links_offset = (sizeof(struct M68KTranslationUnit) + line_length + 7) & ~7;
 #ifdef __aarch64__
         uintptr_t unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
 #else
-        uintptr_t unit_length = (line_length + 31 + sizeof(struct M68KTranslationUnit)) & ~31;
+        uintptr_t unit_length = links_offset + 31;
+
+#if EMU68_BLOCK_CHAINING
+        if (chain_site >= 0)
+            unit_length += sizeof(struct M68KChainLink);
+#endif
+        unit_length &= ~31;
 #endif
+
+        /* Keep the lookup table sparse, probes stay short */
+        while (__m68k_state->JIT_UNIT_COUNT >= (EMU68_UNIT_TABLE_SIZE * UNIT_LINE_SLOTS * 7) / 8)
+        {
+            M68K_FreeUnit((struct M68KTranslationUnit *)((char *)LRU.lh_TailPred - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode)));
+        }
+
         do {
 #ifdef __aarch64__
             unit = tlsf_malloc_aligned(jit_tlsf, unit_length, 64);
@@ -787,14 +1096,10 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
                 #ifndef __aarch64__
                 extern uint32_t last_PC;
                 #endif
-                struct Node *n = REMTAIL(&LRU);
-                void *ptr = (char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode);
-                REMOVE((struct Node *)ptr);
+                void *ptr = (char *)LRU.lh_TailPred - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode);
                 kprintf("[ICache] Requested block was %d\n", unit_length);
                 kprintf("[ICache] Run out of cache. Removing least recently used cache line node @ %p\n", ptr);
-                tlsf_free(jit_tlsf, ptr);
-                __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                __m68k_state->JIT_UNIT_COUNT--;
+                M68K_FreeUnit(ptr);
                 #ifdef __aarch64__
                 asm volatile("msr tpidr_el1, %0"::"r"(0xffffffff));
                 #else
@@ -820,8 +1125,25 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
         unit->mt_Conditionals = conditionals_count;
         DuffCopy(&unit->mt_ARMCode[0], translated_arm_code, line_length/4);
 
+        NEWLIST(&unit->mt_ChainIn);
+        unit->mt_ChainLinks = (struct M68KChainLink *)((uintptr_t)unit + links_offset);
+        unit->mt_ChainCount = 0;
+#if EMU68_BLOCK_CHAINING
+        if (chain_site >= 0)
+        {
+            struct M68KChainLink *link = &unit->mt_ChainLinks[0];
+
+            link->ml_Unit = unit;
+            link->ml_Target = NULL;
+            link->ml_Site = &unit->mt_ARMCode[chain_site + CHAIN_SITE_OFFSET];
+            link->ml_M68kTarget = chain_target;
+            link->ml_Guard = NULL;
+            unit->mt_ChainCount = 1;
+        }
+#endif
+
         ADDHEAD(&LRU, &unit->mt_LRUNode);
-        ADDHEAD(&ICache[hash], &unit->mt_HashNode);
+        UnitTable_Insert(unit);
 
         __m68k_state->JIT_UNIT_COUNT++;
 
@@ -885,15 +1207,28 @@ void M68K_InitializeCache()
     kprintf("[ICache] Setting up LRU\n");
     NEWLIST(&LRU);
 
-    kprintf("[ICache] Setting up ICache\n");
-    ICache = tlsf_malloc(tlsf, sizeof(struct List) * 65536);
+    kprintf("[ICache] Setting up unit table\n");
+    UnitTable = tlsf_malloc_aligned(tlsf, sizeof(struct M68KUnitLine) * EMU68_UNIT_TABLE_SIZE, 64);
     temporary_arm_code = tlsf_malloc(jit_tlsf, EMU68_M68K_INSN_DEPTH * 16 * 64);
     __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
     kprintf("[ICache] Temporary code at %p\n", temporary_arm_code);
     local_state = tlsf_malloc(tlsf, sizeof(struct M68KLocalState)*EMU68_M68K_INSN_DEPTH*2);
-    kprintf("[ICache] ICache array at %p\n", ICache);
-    for (int i=0; i < 65536; i++)
-        NEWLIST(&ICache[i]);
+    kprintf("[ICache] Unit table at %p\n", UnitTable);
+    for (int i=0; i < EMU68_UNIT_TABLE_SIZE; i++)
+    {
+        for (int j=0; j < UNIT_LINE_SLOTS; j++)
+        {
+            UnitTable[i].ul_M68kAddress[j] = UNIT_SLOT_EMPTY;
+            UnitTable[i].ul_Entry[j] = NULL;
+        }
+        UnitTable[i].ul_Overflow = 0;
+    }
+
+    for (int i=0; i < EMU68_JCACHE_SIZE; i++)
+    {
+        __m68k_state->JIT_JCACHE[i].jc_M68kAddress = UNIT_SLOT_EMPTY;
+        __m68k_state->JIT_JCACHE[i].jc_Entry = NULL;
+    }
 }
 
 void M68K_DumpStats()
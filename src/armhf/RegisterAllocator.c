@@ -35,6 +35,7 @@ static struct {
 static int8_t LRU_Table[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
 static uint16_t register_pool = 0;
 static uint16_t changed_mask = 0;
+static uint16_t pinned_mask = 0;
 
 static uint8_t FPU_AllocState;
 static uint8_t FPU_Reg_State[8] = {0, 0, 0, 0, 0, 0, 0, 0};
@@ -242,19 +243,62 @@ void RA_FlushM68kRegs(uint32_t **arm_stream)
         LRU_Table[i] = -1;
 }
 
+/*
+    Least recently used slot holding a register which is not pinned. If all of them are pinned
+    the last one is given
+*/
+static int LRU_Victim()
+{
+    int last = -1;
+
+    for (int i=7; i >= 0; --i)
+    {
+        if (LRU_Table[i] == -1)
+            continue;
+
+        if (last == -1)
+            last = i;
+
+        if ((pinned_mask & (1 << LRU_Table[i])) == 0)
+            return i;
+    }
+
+    return last;
+}
+
 /* Insert new register into LRU table */
 void RA_InsertM68kRegister(uint32_t **arm_stream, uint8_t m68k_reg)
 {
     (void)arm_stream;
+    int slot = 7;
+
     if (LRU_Table[7] != -1)
-        RA_DiscardM68kRegister(arm_stream, LRU_Table[7]);
+    {
+        slot = LRU_Victim();
+        RA_DiscardM68kRegister(arm_stream, LRU_Table[slot]);
+    }
 
-    for (int i=7; i > 0; --i)
+    for (int i=slot; i > 0; --i)
         LRU_Table[i] = LRU_Table[i-1];
 
     LRU_Table[0] = m68k_reg;
 }
 
+/*
+    Load registers of the mask and keep them mapped for the rest of the unit. Eviction skips
+    them, unrolled loop passes do not spill and refill them
+*/
+void RA_PinM68kRegisters(uint32_t **arm_stream, uint16_t mask)
+{
+    pinned_mask = mask;
+
+    for (int i=0; i < 16; i++)
+    {
+        if (mask & (1 << i))
+            RA_MapM68kRegister(arm_stream, i);
+    }
+}
+
 /* Remove given register from LRU table */
 void RA_RemoveM68kRegister(uint32_t **arm_stream, uint8_t m68k_reg)
 {
@@ -460,14 +504,10 @@ uint8_t RA_AllocARMRegister(uint32_t **arm_stream)
     if (reg != 0xff)
         return reg;
 
-    for (int i=7; i >= 0; --i)
-    {
-        if (LRU_Table[i] != -1)
-        {
-            RA_RemoveM68kRegister(arm_stream, LRU_Table[i]);
-            break;
-        }
-    }
+    int slot = LRU_Victim();
+
+    if (slot != -1)
+        RA_RemoveM68kRegister(arm_stream, LRU_Table[slot]);
 
     reg = __int_arm_alloc_reg();
 
@@ -680,6 +720,7 @@ void RA_ResetAllocator()
 
     register_pool = 0;
     changed_mask = 0;
+    pinned_mask = 0;
     FPU_AllocState = 0;
     got_CC = 0;
     mod_CC = 0;
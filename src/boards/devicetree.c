@@ -11,14 +11,25 @@ __attribute__((aligned(4096)))
     This is a Z3 ROM board with device tree resource. It provides userspace to read the keys and properties from
     the tree in order to e.g. find the available peripherals. The board is provided with its own m68k ROM with the
     resource inside. No ARM-side code is used in this board.
+
+    The strings block is followed by a lookup index, so that the resource can open a key
+    without scanning the tree. It starts at next 4-byte boundary with magic 'DTIX' and count
+    of entries, followed by the entries sorted by hash:
+
+        uint32_t    path hash, FNV-1a of the full node path, see dt_hash()
+        uint32_t    offset of the FDT_BEGIN_NODE token of the node from start of the tree
 */
 
+#define DT_INDEX_MAGIC  0x44544958
+
 struct fdt_header *fdt_base;
 static char *strings;
 static uint32_t strings_len;
 static uint32_t *data;
 static uint32_t data_len;
 static uint32_t allocated_len;
+static uint32_t *index_data;
+static uint32_t index_len;
 
 void put_word(uint32_t word)
 {
@@ -88,11 +99,16 @@ int add_string(const char *str)
     return idx;
 }
 
-void dump_node(of_node_t *node)
+void dump_node(of_node_t *node, uint32_t hash)
 {
     of_property_t *prop;
     of_node_t *child;
 
+    index_data = tlsf_realloc(tlsf, index_data, (index_len + 1) * 2 * sizeof(uint32_t));
+    index_data[2 * index_len] = hash;
+    index_data[2 * index_len + 1] = data_len;
+    index_len++;
+
     put_word(FDT_BEGIN_NODE);
     put_words((uint32_t *)node->on_name, (strlen(node->on_name) + 4) >> 2);
 
@@ -114,7 +130,8 @@ void dump_node(of_node_t *node)
     child = node->on_children;
     while(child)
     {
-        dump_node(child);
+        /* Path of the root node is "/", all other get the separator in front of the name */
+        dump_node(child, dt_hash(node->on_parent ? dt_hash(hash, "/") : hash, child->on_name));
         child = child->on_next;
     }
 
@@ -131,10 +148,30 @@ void build_fdt()
     data_len = 0;
     strings_len = 0;
     strings = NULL;
+    index_len = 0;
+    index_data = NULL;
 
-    dump_node(dt_find_node("/"));
+    dump_node(dt_find_node("/"), dt_hash(DT_HASH_INIT, "/"));
     put_word(FDT_END);
 
+    /* Sort the index by hash, the resource does binary search on it */
+    for (unsigned i=1; i < index_len; i++)
+    {
+        uint32_t h = index_data[2 * i];
+        uint32_t o = index_data[2 * i + 1];
+        int j = i - 1;
+
+        while (j >= 0 && index_data[2 * j] > h)
+        {
+            index_data[2 * j + 2] = index_data[2 * j];
+            index_data[2 * j + 3] = index_data[2 * j + 1];
+            j--;
+        }
+
+        index_data[2 * j + 2] = h;
+        index_data[2 * j + 3] = o;
+    }
+
     fdt.totalsize -= fdt.size_dt_strings;
     fdt.totalsize -= fdt.size_dt_struct;  
 
@@ -142,6 +179,8 @@ void build_fdt()
     fdt.size_dt_struct = data_len * sizeof(uint32_t);
 
     fdt.totalsize += strings_len + data_len * sizeof(uint32_t);
+    fdt.totalsize = (fdt.totalsize + 3) & ~3;
+    fdt.totalsize += (2 + 2 * index_len) * sizeof(uint32_t);
 
     fdt_base = tlsf_malloc_aligned(tlsf, (fdt.totalsize + 4095) & ~4095, 4096);
     *fdt_base = fdt;
@@ -161,8 +200,18 @@ void build_fdt()
     fdt_base->off_dt_strings = fdt_base->off_dt_struct + data_len * sizeof(uint32_t);
     memcpy((void*)((uintptr_t)fdt_base + fdt_base->off_dt_strings), strings, strings_len);
 
+    uint32_t *index = (uint32_t *)(((uintptr_t)fdt_base + fdt_base->off_dt_strings + strings_len + 3) & ~3);
+    index[0] = DT_INDEX_MAGIC;
+    index[1] = index_len;
+    for (unsigned i=0; i < index_len; i++)
+    {
+        index[2 + 2 * i] = index_data[2 * i];
+        index[3 + 2 * i] = fdt_base->off_dt_struct + index_data[2 * i + 1] * sizeof(uint32_t);
+    }
+
     tlsf_free(tlsf, data);
     tlsf_free(tlsf, strings);
+    tlsf_free(tlsf, index_data);
 }
 
 static void map(struct ExpansionBoard *board)
@@ -0,0 +1,319 @@
+#include <boards.h>
+#include <mmu.h>
+#include <devicetree.h>
+#include <support.h>
+#include <config.h>
+#include <M68k.h>
+#include <native.h>
+#include <ramdisk.h>
+
+#if defined(__aarch64__) && EMU68_NATIVE_CALLS
+
+/*
+    This is a RAM disk in ARM memory, see ramdisk.h for the interface. Like the Z3 RAM board it has no ROM,
+    the synthesized autoconfig data says Zorro III I/O board of 64KB. Only the info page is mapped there, the
+    disk is reached by the ARM through the linear map of physical memory and never by the m68k.
+
+    The disk is cut from the top of system memory below the Z3 RAM block, so it may lie above 4GB and takes
+    nothing from the 32-bit address space. Contents survive warm resets.
+*/
+
+#define MANUFACTURER_ID 0x6d73
+#define DISK_SERIAL     0x1e0aeb69
+
+#define RAMDISK_MIN_MB  1
+#define RAMDISK_MAX_MB  8192
+
+#define PHYS_PTR(a)     ((uint8_t *)(0xffffff9000000000ULL + (uintptr_t)(a)))
+
+/* Commands and errors of exec/io.h, devices/trackdisk.h and devices/newstyle.h */
+#define CMD_READ            2
+#define CMD_WRITE           3
+#define CMD_UPDATE          4
+#define CMD_CLEAR           5
+#define TD_MOTOR            9
+#define TD_SEEK             10
+#define TD_FORMAT           11
+#define TD_REMOVE           12
+#define TD_CHANGENUM        13
+#define TD_CHANGESTATE      14
+#define TD_PROTSTATUS       15
+#define TD_GETDRIVETYPE     18
+#define TD_GETNUMTRACKS     19
+#define TD_GETGEOMETRY      22
+#define TD_READ64           24
+#define TD_WRITE64          25
+#define TD_SEEK64           26
+#define TD_FORMAT64         27
+#define NSCMD_TD_READ64     0xc000
+#define NSCMD_TD_WRITE64    0xc001
+#define NSCMD_TD_SEEK64     0xc002
+#define NSCMD_TD_FORMAT64   0xc003
+
+#define IOERR_NOCMD         -3
+#define IOERR_BADLENGTH     -4
+#define IOERR_BADADDRESS    -5
+#define TDERR_SEEKERROR     30
+
+#define DRIVE3_5            1
+#define MEMF_PUBLIC         0x0001
+#define MEMF_FAST           0x0004
+
+/* Fields of struct IOStdReq */
+#define IO_COMMAND          28
+#define IO_ERROR            31
+#define IO_ACTUAL           32
+#define IO_LENGTH           36
+#define IO_DATA             40
+#define IO_OFFSET           44
+#define IO_SIZE             48
+
+struct DriveGeometry {
+    uint32_t    dg_SectorSize;
+    uint32_t    dg_TotalSectors;
+    uint32_t    dg_Cylinders;
+    uint32_t    dg_CylSectors;
+    uint32_t    dg_Heads;
+    uint32_t    dg_TrackSectors;
+    uint32_t    dg_BufMemType;
+    uint8_t     dg_DeviceType;
+    uint8_t     dg_Flags;
+    uint16_t    dg_Reserved;
+};
+
+static union {
+    struct RAMDiskInfo  info;
+    uint8_t             page[4096];
+} info_page __attribute__((aligned(4096)));
+
+static uintptr_t disk_phys;
+static uint64_t disk_size;
+
+static void map(struct ExpansionBoard *board)
+{
+    kprintf("[BOARD] Mapping ZIII RAM disk board at address %08x, %d MiB at %p\n", board->map_base, (uint32_t)(disk_size >> 20), disk_phys);
+    mmu_map(mmu_virt2phys((uintptr_t)&info_page), board->map_base, sizeof(info_page), MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
+}
+
+/* Flags register says Zorro III, the size code of the type register 64KB */
+static uint16_t ramdisk_rom[64] = {
+    0x8000, 0x1000,                             // Z3 board, size code
+    (uint16_t)~(RAMDISK_PRODUCT << 8) & 0xf000, (uint16_t)~(RAMDISK_PRODUCT << 12) & 0xf000,
+    (uint16_t)~0x1fff, (uint16_t)~0x0fff,       // ERFF_ZORRO_III
+    (uint16_t)~0x0fff, (uint16_t)~0x0fff,       // Reserved - must be 0
+
+    (uint16_t)~(MANUFACTURER_ID) & 0xf000, (uint16_t)~(MANUFACTURER_ID << 4) & 0xf000,
+    (uint16_t)~(MANUFACTURER_ID << 8) & 0xf000, (uint16_t)~(MANUFACTURER_ID << 12) & 0xf000,
+
+    (uint16_t)~(DISK_SERIAL >> 16) & 0xf000, (uint16_t)~(DISK_SERIAL >> 12) & 0xf000,
+    (uint16_t)~(DISK_SERIAL >> 8) & 0xf000, (uint16_t)~(DISK_SERIAL >> 4) & 0xf000,
+    (uint16_t)~(DISK_SERIAL) & 0xf000, ~(uint16_t)((uint16_t)DISK_SERIAL << 4) & 0xf000,
+    (uint16_t)~((uint16_t)DISK_SERIAL << 8) & 0xf000, ~(uint16_t)((uint16_t)DISK_SERIAL << 12) & 0xf000,
+
+    [20 ... 63] = (uint16_t)~0x0fff,
+};
+
+static struct ExpansionBoard board = {
+    ramdisk_rom,
+    0x10000,
+    0,
+    1,
+    0,
+    map
+};
+
+/* Blocks between the disk and the buffer of the caller, memcpy moves them in 64-byte NEON steps */
+static int transfer(int write, uint64_t offset, uint32_t data, uint32_t length, uint32_t *actual)
+{
+    if ((offset | length) & (RAMDISK_BLOCK_SIZE - 1))
+        return IOERR_BADLENGTH;
+
+    if (offset > disk_size || length > disk_size - offset)
+        return TDERR_SEEKERROR;
+
+    if (!Native_AreaOK(data, length))
+        return IOERR_BADADDRESS;
+
+    /* Code loaded into pages translated before must not run from the old units */
+    if (!write)
+        M68K_HostWrite(data, (uintptr_t)data + length, 0);
+
+    if (write)
+        memcpy(PHYS_PTR(disk_phys + offset), M68K_PTR(data), length);
+    else
+        memcpy(M68K_PTR(data), PHYS_PTR(disk_phys + offset), length);
+
+    *actual = length;
+
+    return 0;
+}
+
+static int geometry(uint32_t data, uint32_t length, uint32_t *actual)
+{
+    struct DriveGeometry *dg = (struct DriveGeometry *)M68K_PTR(data);
+    uint32_t blocks = disk_size / RAMDISK_BLOCK_SIZE;
+
+    if (length < sizeof(struct DriveGeometry))
+        return IOERR_BADLENGTH;
+
+    if (!Native_AreaOK(data, sizeof(struct DriveGeometry)))
+        return IOERR_BADADDRESS;
+
+    M68K_HostWrite(data, (uintptr_t)data + sizeof(struct DriveGeometry), 0);
+
+    dg->dg_SectorSize = BE32(RAMDISK_BLOCK_SIZE);
+    dg->dg_TotalSectors = BE32(blocks);
+    dg->dg_Cylinders = BE32(blocks / RAMDISK_TRACK_BLOCKS);
+    dg->dg_CylSectors = BE32(RAMDISK_TRACK_BLOCKS);
+    dg->dg_Heads = BE32(1);
+    dg->dg_TrackSectors = BE32(RAMDISK_TRACK_BLOCKS);
+    dg->dg_BufMemType = BE32(MEMF_PUBLIC | MEMF_FAST);
+    dg->dg_DeviceType = 0;                      // DG_DIRECT_ACCESS
+    dg->dg_Flags = 0;
+    dg->dg_Reserved = 0;
+
+    *actual = sizeof(struct DriveGeometry);
+
+    return 0;
+}
+
+/* NATIVE_DISK_IO, A1 is the IOStdReq */
+static void disk_io(struct M68KState *ctx)
+{
+    uint32_t req = ctx->A[1].u32;
+    uint8_t *io = M68K_PTR(req);
+    uint16_t cmd;
+    uint32_t data, length, actual = 0;
+    uint64_t offset;
+    int error;
+
+    if (!Native_AreaOK(req, IO_SIZE))
+    {
+        ctx->D[0].s32 = IOERR_BADADDRESS;
+        return;
+    }
+
+    cmd = BE16(*(uint16_t *)(io + IO_COMMAND));
+    length = BE32(*(uint32_t *)(io + IO_LENGTH));
+    data = BE32(*(uint32_t *)(io + IO_DATA));
+    offset = BE32(*(uint32_t *)(io + IO_OFFSET));
+
+    switch (cmd)
+    {
+        case TD_READ64: case NSCMD_TD_READ64:
+        case TD_WRITE64: case NSCMD_TD_WRITE64:
+        case TD_FORMAT64: case NSCMD_TD_FORMAT64:
+            offset |= (uint64_t)BE32(*(uint32_t *)(io + IO_ACTUAL)) << 32;
+            break;
+    }
+
+    switch (cmd)
+    {
+        case CMD_READ: case TD_READ64: case NSCMD_TD_READ64:
+            error = transfer(0, offset, data, length, &actual);
+            break;
+
+        case CMD_WRITE: case TD_WRITE64: case NSCMD_TD_WRITE64:
+        case TD_FORMAT: case TD_FORMAT64: case NSCMD_TD_FORMAT64:
+            error = transfer(1, offset, data, length, &actual);
+            break;
+
+        case TD_GETGEOMETRY:
+            error = geometry(data, length, &actual);
+            break;
+
+        case TD_CHANGENUM:
+            actual = 1;
+            error = 0;
+            break;
+
+        case TD_GETDRIVETYPE:
+            actual = DRIVE3_5;
+            error = 0;
+            break;
+
+        case TD_GETNUMTRACKS:
+            actual = disk_size / (RAMDISK_BLOCK_SIZE * RAMDISK_TRACK_BLOCKS);
+            error = 0;
+            break;
+
+        /* Disk is always in and writable, nothing to flush, no motor and no heads */
+        case TD_CHANGESTATE: case TD_PROTSTATUS:
+        case CMD_UPDATE: case CMD_CLEAR: case TD_MOTOR: case TD_REMOVE:
+        case TD_SEEK: case TD_SEEK64: case NSCMD_TD_SEEK64:
+            error = 0;
+            break;
+
+        default:
+            error = IOERR_NOCMD;
+            break;
+    }
+
+    io[IO_ERROR] = error;
+    *(uint32_t *)(io + IO_ACTUAL) = BE32(actual);
+    ctx->D[0].s32 = error;
+}
+
+/*
+    Called by the boot code with the lowest and highest physical address of RAM left for the m68k, top is
+    right below the Z3 RAM block. Returns the number of bytes taken away from the top
+*/
+uintptr_t RAMDisk_Reserve(uintptr_t bottom, uintptr_t top)
+{
+    of_node_t *e = dt_find_node("/chosen");
+    const char *tok = NULL;
+    uint32_t mb = 0;
+
+    if (e)
+    {
+        of_property_t * prop = dt_find_property(e, "bootargs");
+        if (prop)
+            tok = find_token(prop->op_value, "ramdisk_size=");
+    }
+
+    if (tok == NULL)
+        return 0;
+
+    for (const char *c = tok + 13; *c >= '0' && *c <= '9'; c++)
+        mb = mb * 10 + *c - '0';
+
+    if (mb < RAMDISK_MIN_MB)
+        return 0;
+
+    if (mb > RAMDISK_MAX_MB)
+        mb = RAMDISK_MAX_MB;
+
+    uintptr_t size = (uintptr_t)mb << 20;
+    uintptr_t base = (top - size) & ~(uintptr_t)(2*1024*1024 - 1);
+
+    if (top < size || base < bottom || top - base >= (top - bottom) / 2)
+    {
+        kprintf("[BOOT] Not enough memory for %d MiB RAM disk\n", mb);
+        return 0;
+    }
+
+    if (!Native_Register(NATIVE_DISK_IO, disk_io, "disk_io"))
+        return 0;
+
+    disk_phys = base;
+    disk_size = size;
+
+    info_page.info.ri_Magic = BE32(RAMDISK_MAGIC);
+    info_page.info.ri_Version = BE16(RAMDISK_VERSION);
+    info_page.info.ri_Opcode = BE16(EMU68_NATIVE_BASE + NATIVE_DISK_IO);
+    info_page.info.ri_BlockSize = BE32(RAMDISK_BLOCK_SIZE);
+    info_page.info.ri_Blocks = BE32(size / RAMDISK_BLOCK_SIZE);
+
+    /* Boot blocks and the area searched for an RDB read as zeros, the disk shows up unformatted */
+    bzero(PHYS_PTR(base), 16 * RAMDISK_BLOCK_SIZE);
+
+    board.enabled = 1;
+
+    kprintf("[BOOT] RAM disk of %d MiB at %p\n", mb, base);
+
+    return top - base;
+}
+
+static void * __attribute__((used, section(".boards.z3"))) _board = &board;
+
+#endif
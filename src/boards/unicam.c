@@ -6,8 +6,9 @@ __attribute__((aligned(4096)))
 #include "./unicam.h"
 
 /*
-    This is a Z3 ROM board with SDHC driver. More details can be found in the Emu68-tools repository.
-    The board is provided with its own m68k ROM with the driver inside. No ARM-side code is used in this board.
+    This is a Z3 ROM board with unicam driver. More details can be found in the Emu68-tools repository.
+    The board is provided with its own m68k ROM with the driver inside. No ARM-side code is used in this
+    board, frames captured into VC4 memory are scaled to the screen with RTG_SCALE of the RTG service.
 */
 
 static void map(struct ExpansionBoard *board)
@@ -2,6 +2,10 @@
 #include <mmu.h>
 #include <devicetree.h>
 #include <support.h>
+#include <config.h>
+#if EMU68_BUS_LOG
+#include <buslog.h>
+#endif
 
 /*
     This is a Z2 RAM expansion installed in the 0x200000 ... 0x9fffff space. No ROM required, the board just maps
@@ -13,6 +17,9 @@ static void map(struct ExpansionBoard *board)
 {
     kprintf("[BOARD] Mapping ZII RAM board at address %08x\n", board->map_base);
     mmu_map(board->map_base, board->map_base, board->rom_size, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_ATTR_CACHED, 0);
+#if EMU68_BUS_LOG
+    BusLog_Map(board->map_base, board->rom_size, 0);
+#endif
 }
 
 #define PRODUCT_ID      0x10
@@ -0,0 +1,132 @@
+#include <boards.h>
+#include <mmu.h>
+#include <devicetree.h>
+#include <support.h>
+#include <config.h>
+#if EMU68_BUS_LOG
+#include <buslog.h>
+#endif
+
+/*
+    This is a Z3 RAM expansion. Like the Z2 RAM board it has no ROM, it maps a block of physical RAM at the
+    address given by autoconfig. The block is cut from the top of system memory right below the kernel, so it is
+    not given to the m68k a second time through the device tree. It can lie above 4GB, where the m68k has no RAM
+    otherwise. Backing and Z3 base are aligned, the whole board is mapped with 2MB blocks and contiguous
+    TLB entries.
+
+    The board is configured before all other Z3 boards, it gets the start of Z3 space aligned to its size. At most
+    512MB are used, the other half of Z3 space is left for the support boards.
+*/
+
+#define PRODUCT_ID      0x11
+#define MANUFACTURER_ID 0x6d73
+#define RAM_SERIAL      0x1e0aeb68
+
+#define Z3RAM_MIN_MB    16
+#define Z3RAM_MAX_MB    512
+
+#if EMU68_MMU_LARGE_PAGES
+#define Z3RAM_ALIGN     (32*1024*1024)
+#else
+#define Z3RAM_ALIGN     (2*1024*1024)
+#endif
+
+static uintptr_t ram_phys;
+
+static void map(struct ExpansionBoard *board)
+{
+    kprintf("[BOARD] Mapping ZIII RAM board at address %08x, %d MiB at %p\n", board->map_base, board->rom_size >> 20, ram_phys);
+    mmu_map(ram_phys, board->map_base, board->rom_size, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_ATTR_CACHED, 0);
+#if EMU68_BUS_LOG
+    BusLog_Map(board->map_base, board->rom_size, 0);
+#endif
+}
+
+/*
+    No real ROM is used, so synthesize your own here. Flags register says memory space, extended sizes and
+    Zorro III, size code in the type register is filled in on reservation
+*/
+static uint16_t z3_ram[64] = {
+    0xa000, 0x0000,                             // Z3 board, link it to memory list, size code
+    (uint16_t)~(PRODUCT_ID << 8) & 0xf000, (uint16_t)~(PRODUCT_ID << 12) & 0xf000,
+    (uint16_t)~0xbfff, (uint16_t)~0x0fff,       // ERFF_MEMSPACE | ERFF_EXTENDED | ERFF_ZORRO_III
+    (uint16_t)~0x0fff, (uint16_t)~0x0fff,       // Reserved - must be 0
+
+    (uint16_t)~(MANUFACTURER_ID) & 0xf000, (uint16_t)~(MANUFACTURER_ID << 4) & 0xf000,
+    (uint16_t)~(MANUFACTURER_ID << 8) & 0xf000, (uint16_t)~(MANUFACTURER_ID << 12) & 0xf000,
+
+    (uint16_t)~(RAM_SERIAL >> 16) & 0xf000, (uint16_t)~(RAM_SERIAL >> 12) & 0xf000,
+    (uint16_t)~(RAM_SERIAL >> 8) & 0xf000, (uint16_t)~(RAM_SERIAL >> 4) & 0xf000,
+    (uint16_t)~(RAM_SERIAL) & 0xf000, ~(uint16_t)((uint16_t)RAM_SERIAL << 4) & 0xf000,
+    (uint16_t)~((uint16_t)RAM_SERIAL << 8) & 0xf000, ~(uint16_t)((uint16_t)RAM_SERIAL << 12) & 0xf000,
+
+    [20 ... 63] = (uint16_t)~0x0fff,
+};
+
+static struct ExpansionBoard board = {
+    z3_ram,
+    0,
+    0,
+    1,
+    0,
+    map
+};
+
+/*
+    Called by the boot code with the lowest and highest physical address of RAM left for the m68k, top is
+    right below the kernel. Returns the number of bytes taken away from the top
+*/
+uintptr_t Z3RAM_Reserve(uintptr_t bottom, uintptr_t top)
+{
+    of_node_t *e = dt_find_node("/chosen");
+    const char *tok = NULL;
+    uint32_t mb = 0;
+
+    if (e)
+    {
+        of_property_t * prop = dt_find_property(e, "bootargs");
+        if (prop)
+            tok = find_token(prop->op_value, "z3_ram_size=");
+    }
+
+    if (tok == NULL)
+        return 0;
+
+    for (const char *c = tok + 12; *c >= '0' && *c <= '9'; c++)
+        mb = mb * 10 + *c - '0';
+
+    if (mb < Z3RAM_MIN_MB)
+    {
+        kprintf("[BOOT] Z3 RAM expansion disabled\n");
+        return 0;
+    }
+
+    if (mb > Z3RAM_MAX_MB)
+        mb = Z3RAM_MAX_MB;
+
+    /* Autoconfig sizes are powers of two, round down */
+    mb = 1 << (31 - __builtin_clz(mb));
+
+    uintptr_t size = (uintptr_t)mb << 20;
+    uintptr_t base = (top - size) & ~(uintptr_t)(Z3RAM_ALIGN - 1);
+
+    if (top < size || base < bottom || top - base >= (top - bottom) / 2)
+    {
+        kprintf("[BOOT] Not enough memory for %d MiB Z3 RAM expansion\n", mb);
+        return 0;
+    }
+
+    ram_phys = base;
+
+    /* Extended size codes: 0 is 16MB, each step doubles */
+    z3_ram[1] = (__builtin_ctz(mb) - 4) << 12;
+
+    board.rom_size = size;
+    board.enabled = 1;
+
+    kprintf("[BOOT] Z3 RAM expansion of %d MiB at %p\n", mb, base);
+
+    return top - base;
+}
+
+static void * __attribute__((used, section(".boards.z3ram"))) _board = &board;
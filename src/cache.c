@@ -17,12 +17,14 @@ union CacheLine
 
 #define D(x) /* x */
 
-#define F_VALID         0x80
 #define F_DIRTY0        0x01
 #define F_DIRTY1        0x02
 #define F_DIRTY2        0x04
 #define F_DIRTY3        0x08
 
+/* Tags are aligned to the size of one way, no valid line can ever have this one */
+#define TAG_INVALID     1
+
 #if CACHE_WAY_COUNT > 32
 #error CACHE_WAY_COUNT shall be less or equal 32
 #endif
@@ -30,206 +32,433 @@ union CacheLine
 #define GET_SET(x)  (((x) >> 4) & (CACHE_SET_COUNT - 1))
 #define GET_TAG(x)  ((x) & ~(CACHE_SET_COUNT * 16 - 1))
 
+/*
+    All state of one set is kept together. The lookup reads tags of all ways from a single
+    host cache line, the matching data line follows right after them.
+*/
+struct CacheSet
+{
+    uint32_t            cs_Tags[CACHE_WAY_COUNT];
+    uint32_t            cs_WaySelect;
+    uint8_t             cs_Flags[CACHE_WAY_COUNT];
+    union CacheLine     cs_Lines[CACHE_WAY_COUNT];
+};
+
 struct Cache
 {
-    union CacheLine     c_Lines[CACHE_SET_COUNT][CACHE_WAY_COUNT];
-    uint32_t            c_Tags[CACHE_SET_COUNT][CACHE_WAY_COUNT];
-    uint8_t             c_Flags[CACHE_SET_COUNT][CACHE_WAY_COUNT];
-    uint32_t            c_WaySelect[CACHE_SET_COUNT];
+    struct CacheSet     c_Sets[CACHE_SET_COUNT];
 };
 
 struct Cache *IC;
 struct Cache *DC;
 
-void cache_mark_hit(struct Cache *cache, int set, int way)
+/*
+    In coherent mode lines are allocated for writes only, reads which miss go to memory and
+    do not fill the cache. As long as no line is dirty the model is skipped completely
+*/
+uint8_t cache_coherent;
+uint32_t cache_dirty_lines[2];
+static uint32_t cache_valid_lines[2];
+
+static inline void cache_mark_hit(struct CacheSet *s, int way)
 {
     /* Mark the way as accessed */
-    cache->c_WaySelect[set] |= 1 << way;
+    s->cs_WaySelect |= 1 << way;
 
     /* If all ways are marked as accessed, clear them all and set the current one again */
-    if (cache->c_WaySelect[set] == (0xffffffff >> (32 - CACHE_WAY_COUNT)))
+    if (s->cs_WaySelect == (0xffffffff >> (32 - CACHE_WAY_COUNT)))
     {
-        cache->c_WaySelect[set] = 1 << way;
+        s->cs_WaySelect = 1 << way;
     }
 }
 
-int cache_get_way(struct Cache *cache, int set)
+static inline int cache_get_way(struct CacheSet *s)
 {
-    return __builtin_ffs(~cache->c_WaySelect[set]) - 1;
+    return __builtin_ffs(~s->cs_WaySelect) - 1;
 }
 
-void cache_setup()
+/* Find the way holding given tag. Invalid lines never match */
+static inline int cache_find_way(struct CacheSet *s, uint32_t tag)
 {
-    (kprintf("[CACHE] Cache setup. Cache sizeof=%lu\n", sizeof(struct Cache)));
-    (kprintf("[CACHE] Way count: %d, Set count: %d\n", CACHE_WAY_COUNT, CACHE_SET_COUNT));
+    for (int i=0; i < CACHE_WAY_COUNT; i++)
+    {
+        if (s->cs_Tags[i] == tag)
+            return i;
+    }
 
-    IC = (struct Cache *)tlsf_malloc(tlsf, sizeof(struct Cache));
-    DC = (struct Cache *)tlsf_malloc(tlsf, sizeof(struct Cache));
+    return -1;
+}
 
-    for(int i=0; i < CACHE_SET_COUNT; i++)
+/*
+    Single store instructions. Outside of RAM each of them is one fault and one bus transfer
+    of the full size, the compiler could split the plain C assignment
+*/
+static inline void cache_store_64(uint32_t *ptr, uint64_t data)
+{
+#ifdef __aarch64__
+    asm volatile("str %1, [%0]"::"r"(ptr), "r"(data):"memory");
+#else
+    *(uint64_t *)ptr = data;
+#endif
+}
+
+static inline void cache_store_128(uint32_t *ptr, union CacheLine *data)
+{
+#ifdef __aarch64__
+    asm volatile("stp %1, %2, [%0]"::"r"(ptr), "r"(data->cl_64[0]), "r"(data->cl_64[1]):"memory");
+#else
+    *(uint128_t *)ptr = data->cl_128;
+#endif
+}
+
+/*
+    Write dirty portions of the line back to memory, the line remains valid and clean. Dirty
+    quarters are merged into aligned 64 and 128 bit stores wherever they are contiguous
+*/
+static void cache_writeback_way(enum CacheType type, struct CacheSet *s, uint32_t set, int way)
+{
+    uint8_t dirty = s->cs_Flags[way];
+    union CacheLine *data = &s->cs_Lines[way];
+
+    if (dirty == 0)
+        return;
+
+    cache_dirty_lines[type]--;
+
+    uint32_t *line = (uint32_t *)(uintptr_t)(s->cs_Tags[way] + (set << 4));
+
+    D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
+        s->cs_Tags[way], (uint32_t)(uintptr_t)line));
+
+    if (dirty == (F_DIRTY0 | F_DIRTY1 | F_DIRTY2 | F_DIRTY3))
     {
-        IC->c_WaySelect[i] = 0;
-        DC->c_WaySelect[i] = 0;
-        for (int j=0; j < CACHE_WAY_COUNT; j++)
-        {
-            IC->c_Flags[i][j] = 0;
-            IC->c_Tags[i][j] = 0;
-        }
+        cache_store_128(line, data);
     }
+    else
+    {
+        if ((dirty & (F_DIRTY0 | F_DIRTY1)) == (F_DIRTY0 | F_DIRTY1))
+            cache_store_64(&line[0], data->cl_64[0]);
+        else if (dirty & F_DIRTY0)
+            line[0] = data->cl_32[0];
+        else if (dirty & F_DIRTY1)
+            line[1] = data->cl_32[1];
 
-    (kprintf("[CACHE] ICache @ %p, DCache @ %p\n", IC, DC));
+        if ((dirty & (F_DIRTY2 | F_DIRTY3)) == (F_DIRTY2 | F_DIRTY3))
+            cache_store_64(&line[2], data->cl_64[1]);
+        else if (dirty & F_DIRTY2)
+            line[2] = data->cl_32[2];
+        else if (dirty & F_DIRTY3)
+            line[3] = data->cl_32[3];
+    }
+
+    s->cs_Flags[way] = 0;
 }
 
-void cache_invalidate_all(enum CacheType type)
+static inline void cache_invalidate_way(enum CacheType type, struct CacheSet *s, int way)
+{
+    if (s->cs_Tags[way] != TAG_INVALID)
+        cache_valid_lines[type]--;
+    if (s->cs_Flags[way])
+        cache_dirty_lines[type]--;
+
+    s->cs_Tags[way] = TAG_INVALID;
+    s->cs_Flags[way] = 0;
+    s->cs_WaySelect &= ~(1 << way);
+}
+
+/* Evict the least recently used way and assign it to the line holding address */
+static int cache_alloc_way(enum CacheType type, struct CacheSet *s, uint32_t address, int load)
+{
+    int way = cache_get_way(s);
+
+    D(kprintf("[CACHE]   allocated way = %d\n", way));
+
+    if (s->cs_Tags[way] != TAG_INVALID)
+        cache_writeback_way(type, s, GET_SET(address), way);
+    else
+        cache_valid_lines[type]++;
+
+    /* Load the cache line */
+    if (load)
+    {
+        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
+        s->cs_Lines[way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
+    }
+
+    s->cs_Flags[way] = 0;
+    s->cs_Tags[way] = GET_TAG(address);
+
+    return way;
+}
+
+/*
+    Get the line holding address for a read, it is loaded if not present in the cache yet.
+    In coherent mode a miss returns NULL, the caller reads memory then
+*/
+static inline union CacheLine *cache_read_line(enum CacheType type, uint32_t address)
+{
+    struct CacheSet *s = &((type == ICACHE) ? IC : DC)->c_Sets[GET_SET(address)];
+    int way = cache_find_way(s, GET_TAG(address));
+
+    D(kprintf("[CACHE]   set = %u, tag = %08x, way = %d\n", GET_SET(address), GET_TAG(address), way));
+
+    if (way < 0)
+    {
+        if (cache_coherent)
+            return NULL;
+
+        way = cache_alloc_way(type, s, address, 1);
+    }
+
+    cache_mark_hit(s, way);
+
+    return &s->cs_Lines[way];
+}
+
+/* Bytes at address, from the cache line or from memory if coherent mode does not cache it */
+static inline void *cache_read_ptr(enum CacheType type, uint32_t address)
+{
+    union CacheLine *line = cache_read_line(type, address);
+
+    return line ? (void *)&line->cl_8[address & 15] : (void *)(uintptr_t)address;
+}
+
+/*
+    Get the line for a write of size bytes at address, which may not cross the line boundary.
+    Returns NULL if write-through cache misses, the caller writes memory directly then.
+    Write-back cache marks the written portion of the line dirty.
+*/
+static inline union CacheLine *cache_write_line(enum CacheType type, uint32_t address, int size, uint8_t write_back)
+{
+    struct CacheSet *s = &((type == ICACHE) ? IC : DC)->c_Sets[GET_SET(address)];
+    int way = cache_find_way(s, GET_TAG(address));
+    uint32_t offset = address & 15;
+
+    D(kprintf("[CACHE]   set = %u, tag = %08x, way = %d\n", GET_SET(address), GET_TAG(address), way));
+
+    if (way < 0)
+    {
+        /* Write-through cache does not load cache line, performs direct write instead */
+        if (write_back == 0)
+            return NULL;
+
+        /* No need to load the line if it gets overwritten completely */
+        way = cache_alloc_way(type, s, address, size != 16);
+    }
+
+    cache_mark_hit(s, way);
+
+    if (write_back && s->cs_Flags[way] == 0)
+        cache_dirty_lines[type]++;
+
+    if (write_back)
+        s->cs_Flags[way] |= (2 << ((offset + size - 1) >> 2)) - (1 << (offset >> 2));
+
+    return &s->cs_Lines[way];
+}
+
+static void cache_reset(enum CacheType type)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
 
-    D(kprintf("[CACHE] %cCache invalidate all\n", type == ICACHE ? 'I':'D'));
+    cache_valid_lines[type] = 0;
+    cache_dirty_lines[type] = 0;
 
     for (int i=0; i < CACHE_SET_COUNT; i++)
     {
-        cache->c_WaySelect[i] = 0;
+        struct CacheSet *s = &cache->c_Sets[i];
+
+        s->cs_WaySelect = 0;
         for (int j=0; j < CACHE_WAY_COUNT; j++)
         {
-            cache->c_Flags[i][j] = 0;
-        }        
+            s->cs_Tags[j] = TAG_INVALID;
+            s->cs_Flags[j] = 0;
+        }
     }
 }
 
+void cache_setup()
+{
+    (kprintf("[CACHE] Cache setup. Cache sizeof=%lu\n", sizeof(struct Cache)));
+    (kprintf("[CACHE] Way count: %d, Set count: %d\n", CACHE_WAY_COUNT, CACHE_SET_COUNT));
+
+    IC = (struct Cache *)tlsf_malloc(tlsf, sizeof(struct Cache));
+    DC = (struct Cache *)tlsf_malloc(tlsf, sizeof(struct Cache));
+
+    cache_reset(ICACHE);
+    cache_reset(DCACHE);
+
+    (kprintf("[CACHE] ICache @ %p, DCache @ %p\n", IC, DC));
+
+    if (cache_coherent)
+        kprintf("[CACHE] Coherent mode, lines are allocated on writes only\n");
+}
+
+void cache_invalidate_all(enum CacheType type)
+{
+    D(kprintf("[CACHE] %cCache invalidate all\n", type == ICACHE ? 'I':'D'));
+
+    /* Nothing cached, typical in coherent mode. CINVA costs nothing then */
+    if (cache_valid_lines[type] == 0)
+        return;
+
+    cache_reset(type);
+}
+
 void cache_flush_all(enum CacheType type)
 {
     if (type == ICACHE)
+    {
         cache_invalidate_all(type);
-
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
+        return;
+    }
 
     D(kprintf("[CACHE] %cCache flush all\n", type == ICACHE ? 'I':'D'));
 
-    for (int set=0; set < CACHE_SET_COUNT; set++)
+    if (cache_valid_lines[type] == 0)
+        return;
+
+    /*
+        Dirty lines are written back in ascending address order, consecutive lines of other
+        ways and sets follow each other on the bus. Way number goes below the line address
+    */
+    if (cache_dirty_lines[type] != 0)
     {
-        cache->c_WaySelect[set] = 0;
-        for (int way=0; way < CACHE_WAY_COUNT; way++)
+        static uint64_t order[CACHE_SET_COUNT * CACHE_WAY_COUNT];
+        uint32_t count = 0;
+
+        for (int set=0; set < CACHE_SET_COUNT; set++)
         {
-            if ((cache->c_Flags[set][way] & F_VALID) && (cache->c_Flags[set][way] & (F_DIRTY0 | F_DIRTY1 | F_DIRTY2 | F_DIRTY3)) != 0)
+            struct CacheSet *s = &DC->c_Sets[set];
+
+            for (int way=0; way < CACHE_WAY_COUNT; way++)
             {
-                uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-                D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-                    cache->c_Tags[set][way], line_address));
-                
-                /* Write cache back if the lines are dirty */
-                if (cache->c_Flags[set][way] & F_DIRTY0)
-                    *(uint32_t *)(uintptr_t)(line_address) = cache->c_Lines[set][way].cl_32[0];
-                if (cache->c_Flags[set][way] & F_DIRTY1)
-                    *(uint32_t *)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-                if (cache->c_Flags[set][way] & F_DIRTY2)
-                    *(uint32_t *)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-                if (cache->c_Flags[set][way] & F_DIRTY3)
-                    *(uint32_t *)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
+                if (s->cs_Flags[way] != 0)
+                    order[count++] = ((uint64_t)(s->cs_Tags[way] + (set << 4)) << 5) | way;
             }
-            cache->c_Flags[set][way] = 0;
-        }        
+        }
+
+        for (uint32_t gap = count / 2; gap > 0; gap /= 2)
+        {
+            for (uint32_t i = gap; i < count; i++)
+            {
+                uint64_t e = order[i];
+                uint32_t j = i;
+
+                for (; j >= gap && order[j - gap] > e; j -= gap)
+                    order[j] = order[j - gap];
+                order[j] = e;
+            }
+        }
+
+        for (uint32_t i=0; i < count; i++)
+        {
+            uint32_t set = GET_SET(order[i] >> 5);
+
+            cache_writeback_way(type, &DC->c_Sets[set], set, order[i] & 31);
+        }
     }
+
+    cache_reset(type);
 }
 
 void cache_invalidate_line(enum CacheType type, uint32_t address)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
+    struct CacheSet *s = &((type == ICACHE) ? IC : DC)->c_Sets[GET_SET(address)];
+    int way = cache_find_way(s, GET_TAG(address));
 
     D(kprintf("[CACHE] %cCache invalidate line (%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
+    if (way >= 0)
+        cache_invalidate_way(type, s, way);
+}
+
+/*
+    Invalidate or flush all lines within address..address+len-1. Only the sets the range
+    covers are visited, once each. A range shorter than one way holds at most one candidate
+    line per set, a larger one is compared against the line address of every way.
+*/
+static void cache_range_op(enum CacheType type, uint32_t address, uint32_t len, int flush)
+{
+    struct Cache *cache = (type == ICACHE) ? IC : DC;
+    const uint64_t start = address & 0xfffffff0;
+    const uint64_t end = ((uint64_t)address + len - 1) & ~15ULL;
+    const uint64_t lines = ((end - start) >> 4) + 1;
+    const uint32_t count = (lines < CACHE_SET_COUNT) ? lines : CACHE_SET_COUNT;
+    uint32_t set = GET_SET(address);
+
+    if (cache_valid_lines[type] == 0)
+        return;
 
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
+    for (uint32_t i=0; i < count; i++, set = (set + 1) & (CACHE_SET_COUNT - 1))
     {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
+        struct CacheSet *s = &cache->c_Sets[set];
+
+        for (int way=0; way < CACHE_WAY_COUNT; way++)
         {
-            cache->c_Flags[set][i] = 0;
-            cache->c_WaySelect[set] &= ~(1 << i);
+            uint64_t line = s->cs_Tags[way] + (set << 4);
+
+            if (s->cs_Tags[way] == TAG_INVALID || line < start || line > end)
+                continue;
+
+            if (flush)
+                cache_writeback_way(type, s, set, way);
+            cache_invalidate_way(type, s, way);
         }
     }
 }
 
 void cache_invalidate_range(enum CacheType type, uint32_t address, uint32_t len)
 {
-    const uint64_t start = address & 0xfffffff0;
-    const uint64_t end = (address + len - 1) & 0xfffffff0;
+    D(kprintf("[CACHE] %cCache invalidate range (%08lx, %lu)\n", type == ICACHE ? 'I':'D', address, len));
 
-    for (uint64_t addr = start; addr <= end; addr += 16)
-    {
-        cache_invalidate_line(type, addr);
-    }
+    if (len == 0)
+        return;
+
+    if (len >= EMU68_CACHE_RANGE_LIMIT)
+        cache_invalidate_all(type);
+    else
+        cache_range_op(type, address, len, 0);
 }
 
-void cache_flush_line(enum CacheType type, uint32_t address)
+void cache_flush_range(enum CacheType type, uint32_t address, uint32_t len)
 {
-    if (type == ICACHE)
-        cache_invalidate_line(type, address);
-
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-
-    D(kprintf("[CACHE] %cCache invalidate line (%08lx)\n", type == ICACHE ? 'I':'D', address));
+    D(kprintf("[CACHE] %cCache flush range (%08lx, %lu)\n", type == ICACHE ? 'I':'D', address, len));
 
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
+    if (len == 0)
+        return;
 
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            uint32_t line_address = cache->c_Tags[set][i] + (set << 4);
-
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][i] & F_DIRTY0)
-                *(uint32_t *)(uintptr_t)(line_address) = cache->c_Lines[set][i].cl_32[0];
-            if (cache->c_Flags[set][i] & F_DIRTY1)
-                *(uint32_t *)(uintptr_t)(line_address + 4) = cache->c_Lines[set][i].cl_32[1];
-            if (cache->c_Flags[set][i] & F_DIRTY2)
-                *(uint32_t *)(uintptr_t)(line_address + 8) = cache->c_Lines[set][i].cl_32[2];
-            if (cache->c_Flags[set][i] & F_DIRTY3)
-                *(uint32_t *)(uintptr_t)(line_address + 12) = cache->c_Lines[set][i].cl_32[3];
-
-            cache->c_Flags[set][i] = 0;
-            cache->c_WaySelect[set] &= ~(1 << i);
-        }
-    }
+    /* Instruction cache is invalidated only, its content is never written back */
+    if (len >= EMU68_CACHE_RANGE_LIMIT)
+        cache_flush_all(type);
+    else
+        cache_range_op(type, address, len, type != ICACHE);
 }
 
-uint128_t cache_read_128(enum CacheType type, uint32_t address)
+void cache_flush_line(enum CacheType type, uint32_t address)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
+    struct CacheSet *s = &((type == ICACHE) ? IC : DC)->c_Sets[GET_SET(address)];
+    int way = cache_find_way(s, GET_TAG(address));
 
-    if (address >= 0x01000000)
-        return *(uint128_t *)(uintptr_t)address;
+    D(kprintf("[CACHE] %cCache flush line (%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-#if 0
+    if (way < 0)
+        return;
 
-    if (type == DCACHE) return 0;
-    
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE && (cacr & CACR_IE) == 0)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
+    /* Instruction cache is invalidated only, its content is never written back */
+    if (type != ICACHE)
+        cache_writeback_way(type, s, GET_SET(address), way);
 
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
+    cache_invalidate_way(type, s, way);
+}
 
-#endif
+uint128_t cache_read_128(enum CacheType type, uint32_t address)
+{
+    if (address >= 0x01000000 || cache_bypassed(type))
+        return *(uint128_t *)(uintptr_t)address;
 
     D(kprintf("[CACHE] %cCache read_128(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) != 0)
     {
         uint128_t data;
@@ -238,54 +467,7 @@ uint128_t cache_read_128(enum CacheType type, uint32_t address)
         return data;
     }
 
-        /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint128_t data = cache->c_Lines[set][way].cl_128;
+    uint128_t data = *(uint128_t *)cache_read_ptr(type, address);
 
     D(kprintf("[CACHE]   => %016lx%016lx\n", data.hi, data.lo));
 
@@ -294,35 +476,11 @@ uint128_t cache_read_128(enum CacheType type, uint32_t address)
 
 uint64_t cache_read_64(enum CacheType type, uint32_t address)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-    if (address >= 0x01000000)
+    if (address >= 0x01000000 || cache_bypassed(type))
         return *(uint64_t *)(uintptr_t)address;
 
-#if 0
-    if (type == DCACHE) return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE && (cacr & CACR_IE) == 0)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
-
     D(kprintf("[CACHE] %cCache read_64(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 8)
     {
         uint64_t data = 0;
@@ -369,54 +527,7 @@ uint64_t cache_read_64(enum CacheType type, uint32_t address)
         return data;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set * CACHE_WAY_COUNT + way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint64_t data = *(uint64_t *)&cache->c_Lines[set][way].cl_8[address & 15];
+    uint64_t data = *(uint64_t *)cache_read_ptr(type, address);
 
     D(kprintf("[CACHE]   => %016lx\n", data));
 
@@ -425,35 +536,11 @@ uint64_t cache_read_64(enum CacheType type, uint32_t address)
 
 uint32_t cache_read_32(enum CacheType type, uint32_t address)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-    if (address >= 0x01000000)
+    if (address >= 0x01000000 || cache_bypassed(type))
         return *(uint32_t *)(uintptr_t)address;
 
-#if 0
-    if (type == DCACHE) return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE && (cacr & CACR_IE) == 0)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
-
     D(kprintf("[CACHE] %cCache read_32(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 12)
     {
         uint32_t data;
@@ -472,97 +559,37 @@ uint32_t cache_read_32(enum CacheType type, uint32_t address)
                 data |= cache_read_32(type, address + 1) >> 8;
                 break;
             default:
+                data = 0;
                 break;
         }
         
         return data;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    uint32_t data = *(uint32_t *)cache_read_ptr(type, address);
 
-    uint32_t data = *(uint32_t *)&cache->c_Lines[set][way].cl_8[address & 15];
     D(kprintf("[CACHE]   => %08x\n", data));
 
     return data;
 }
 
-uint16_t cache_read_16(enum CacheType type, uint32_t address)
+/* Everything above chip space is fast RAM or ROM and never goes through the cache model */
+uint32_t cache_fetch_base = 0x01000000;
+uint32_t cache_fetch_size = 0xff000000;
+
+void cache_fetch_setup(uint32_t base, uint32_t size)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
+    cache_fetch_base = base;
+    cache_fetch_size = size;
+}
 
-    if (address >= 0x01000000)
+uint16_t cache_read_16(enum CacheType type, uint32_t address)
+{
+    if (address >= 0x01000000 || cache_bypassed(type))
         return *(uint16_t *)(uintptr_t)address;
 
-#if 0
-
-    if (type == DCACHE) return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE && (cacr & CACR_IE) == 0)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
-
     D(kprintf("[CACHE] %cCache read_16(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 14)
     {
         uint16_t data = cache_read_8(type, address) << 8;
@@ -571,54 +598,8 @@ uint16_t cache_read_16(enum CacheType type, uint32_t address)
         return data;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        //kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0);
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
+    uint16_t data = *(uint16_t *)cache_read_ptr(type, address);
 
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint16_t data = *(uint16_t *)(void *)&cache->c_Lines[set][way].cl_8[address & 15];
     D(kprintf("[CACHE]   => %04x\n", data));
 
     return data;
@@ -626,84 +607,12 @@ uint16_t cache_read_16(enum CacheType type, uint32_t address)
 
 uint8_t cache_read_8(enum CacheType type, uint32_t address)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-    if (address >= 0x01000000)
+    if (address >= 0x01000000 || cache_bypassed(type))
         return *(uint8_t *)(uintptr_t)address;
 
-#if 0
-
-    if (type == DCACHE) return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE && (cacr & CACR_IE) == 0)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
-
     D(kprintf("[CACHE] %cCache read_8(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint8_t data = cache->c_Lines[set][way].cl_8[address & 15];
+    uint8_t data = *(uint8_t *)cache_read_ptr(type, address);
 
     D(kprintf("[CACHE]   => %02x\n", data));
 
@@ -712,573 +621,119 @@ uint8_t cache_read_8(enum CacheType type, uint32_t address)
 
 int cache_write_128(enum CacheType type, uint32_t address, uint128_t data, uint8_t write_back)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-#if 0
-    return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
+    union CacheLine *line;
 
     D(kprintf("[CACHE] %cCache write_128(%08lx, %016lx%016lx, %x)\n", type == ICACHE ? 'I':'D', address, data.hi, data.lo, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) != 0)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
-    if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* No need to load cache line here, it gets overwritten and marked dirty immediately */
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    line = cache_write_line(type, address, 16, write_back);
+    if (line == NULL)
+        return 0;
 
-    cache->c_Lines[set][way].cl_128 = data;
+    line->cl_128 = data;
 
-    if (write_back)
-    {
-        /* Write-back cache marks the portion of cache line as dirty */
-        cache->c_Flags[set][way] |= F_DIRTY0 | F_DIRTY1 | F_DIRTY2 | F_DIRTY3;
-    }
-    else
-    {
-        /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    if (!write_back)
         *(uint128_t *)(uintptr_t)address = data;
-    }
 
     return 1;
 }
 
 int cache_write_64(enum CacheType type, uint32_t address, uint64_t data, uint8_t write_back)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-#if 0
-    return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
+    union CacheLine *line;
 
     D(kprintf("[CACHE] %cCache write_64(%08lx, %016lx, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 8)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
-    if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    line = cache_write_line(type, address, 8, write_back);
+    if (line == NULL)
+        return 0;
 
-    (*(uint64_t *)(void*)&cache->c_Lines[set][way].cl_8[address & 15]) = data;
+    *(uint64_t *)(void *)&line->cl_8[address & 15] = data;
 
-    if (write_back)
-    {
-        /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0 | F_DIRTY1;
-                if ((((address + 7) >> 2) & 3) == 2)
-                    cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1 | F_DIRTY2;
-                if ((((address + 7) >> 2) & 3) == 3)
-                    cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2 | F_DIRTY3;
-                break;
-        }
-    }
-    else
-    {
-        /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    if (!write_back)
         *(uint64_t *)(uintptr_t)address = data;
-    }
 
     return 1;
 }
 
 int cache_write_32(enum CacheType type, uint32_t address, uint32_t data, uint8_t write_back)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-#if 0
-    return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
+    union CacheLine *line;
 
     D(kprintf("[CACHE] %cCache write_32(%08lx, %08x, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 12)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
-    if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    line = cache_write_line(type, address, 4, write_back);
+    if (line == NULL)
+        return 0;
 
-    (*(uint32_t *)(void*)&cache->c_Lines[set][way].cl_8[address & 15]) = data;
+    *(uint32_t *)(void *)&line->cl_8[address & 15] = data;
 
-    if (write_back)
-    {
-        /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0;
-                if ((((address + 3) >> 2) & 3) == 1)
-                    cache->c_Flags[set][way] |= F_DIRTY1;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1;
-                if ((((address + 3) >> 2) & 3) == 2)
-                    cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2;
-                if ((((address + 3) >> 2) & 3) == 3)
-                    cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-            case 3:
-                cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-        }
-    }
-    else
-    {
-        /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    if (!write_back)
         *(uint32_t *)(uintptr_t)address = data;
-    }
 
     return 1;
 }
 
-
 int cache_write_16(enum CacheType type, uint32_t address, uint16_t data, uint8_t write_back)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-#if 0
-    return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
+    union CacheLine *line;
 
     D(kprintf("[CACHE] %cCache write_16(%08lx, %04x, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 14)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
-    if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    line = cache_write_line(type, address, 2, write_back);
+    if (line == NULL)
+        return 0;
 
-    (*(uint16_t *)(void*)&cache->c_Lines[set][way].cl_8[address & 15]) = data;
+    *(uint16_t *)(void *)&line->cl_8[address & 15] = data;
 
-    if (write_back)
-    {
-        /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0;
-                if ((((address + 1) >> 2) & 3) == 1)
-                    cache->c_Flags[set][way] |= F_DIRTY1;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1;
-                if ((((address + 1) >> 2) & 3) == 2)
-                    cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2;
-                if ((((address + 1) >> 2) & 3) == 3)
-                    cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-            case 3:
-                cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-        }
-    }
-    else
-    {
-        /* Write-through cache performs direct write to memory, cache line remains not-dirty */
-        *(uint16_t*)(uintptr_t)address = data;
-    }
+    /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    if (!write_back)
+        *(uint16_t *)(uintptr_t)address = data;
 
     return 1;
 }
 
 int cache_write_8(enum CacheType type, uint32_t address, uint8_t data, uint8_t write_back)
 {
-    struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
-
-#if 0
-    return 0;
-
-    /* Exit if given cache is disabled in CACR */
-    uint32_t cacr;
-    asm volatile("mov %w0, v31.s[0]":"=r"(cacr));
-    if (type == ICACHE)
-        return 0;
-    else if (type == DCACHE && (cacr & CACR_DE) == 0)
-        return 0;
-
-    /* Only ROM is cacheable! */
-    if (!((address >= 0x00e00000 && address < 0x00e80000) || (address >= 0x00f00000 && address < 0x01000000)))
-        return 0;
-#endif
+    union CacheLine *line;
 
     D(kprintf("[CACHE] %cCache write_8(%08lx, %02x, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
-    if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    line = cache_write_line(type, address, 1, write_back);
+    if (line == NULL)
+        return 0;
 
-    cache->c_Lines[set][way].cl_8[address & 15] = data;
+    line->cl_8[address & 15] = data;
 
-    if (write_back)
-    {
-        /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 3:
-                cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-        }
-    }
-    else
-    {
-        /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    /* Write-through cache performs direct write to memory, cache line remains not-dirty */
+    if (!write_back)
         *(uint8_t *)(uintptr_t)address = data;
-    }
 
     return 1;
 }
-
@@ -21,6 +21,30 @@ of_node_t *root = NULL;
 static uint32_t *data;
 static char *strings;
 
+/*
+    Nodes found by dt_find_node are remembered by the hash of their path. The cache is
+    flushed whenever the tree changes, a new node may shadow the one found before.
+*/
+#define NODE_CACHE_SIZE 32
+
+struct NodeCache {
+    uint32_t    nc_Hash;
+    of_node_t * nc_Node;
+};
+
+static struct NodeCache node_cache[NODE_CACHE_SIZE];
+
+uint32_t dt_hash(uint32_t hash, const char *str)
+{
+    while (*str)
+    {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
 of_node_t * dt_make_node(const char *name)
 {
     of_node_t *e = NULL;
@@ -70,6 +94,7 @@ void dt_add_node(of_node_t *parent, of_node_t *node)
         node->on_parent = parent;
         node->on_next = parent->on_children;
         parent->on_children = node;
+        bzero(node_cache, sizeof(node_cache));
     }
 }
 
@@ -154,6 +179,7 @@ of_node_t * dt_parse(void *dt)
     uint32_t token = 0;
 
     hdr = dt;
+    bzero(node_cache, sizeof(node_cache));
 
     D(kprintf("[BOOT] Checking device tree at %08x\n", hdr));
     D(kprintf("[BOOT] magic=%08x\n", BE32(hdr->magic)));
@@ -258,12 +284,28 @@ of_node_t * dt_find_node(char *key)
 {
     int i;
     of_node_t *node, *ret = NULL;
+    struct NodeCache *c;
+    uint32_t hash;
 
     if (key[0] == '/' && key[1] == 0)
         return root;
 
     if (*key == '/')
     {
+        const char *last = key;
+
+        for (const char *s = key; *s; s++)
+            if (*s == '/')
+                last = s + 1;
+
+        hash = dt_hash(DT_HASH_INIT, key);
+        c = &node_cache[hash & (NODE_CACHE_SIZE - 1)];
+
+        /* Name of the node found is compared too, it rules out hash collisions */
+        node = c->nc_Node;
+        if (node && c->nc_Hash == hash && !_dt_strcmp(last, node->on_name))
+            return node;
+
         ret = root;
 
         while(*key)
@@ -279,17 +321,27 @@ of_node_t * dt_find_node(char *key)
 
             ptrbuf[i] = 0;
 
+            /* Trailing slash */
+            if (i == 0)
+                break;
+
             for (node = ret->on_children; node; node = node->on_next)
             {
                 if (!_dt_strcmp(ptrbuf, node->on_name))
-                {
-                    return node;
-                }
+                    break;
             }
+
+            if (node == NULL)
+                return NULL;
+
+            ret = node;
         }
+
+        c->nc_Hash = hash;
+        c->nc_Node = ret;
     }
 
-    return NULL;
+    return ret;
 }
 
 of_property_t *dt_find_property(void *key, char *propname)
@@ -2,6 +2,10 @@
 #include <tlsf.h>
 #include <support.h>
 #include <stdarg.h>
+#include <config.h>
+#include <devicetree.h>
+#include <mmu.h>
+#include "disasm.h"
 
 extern void *tlsf;
 
@@ -155,6 +159,11 @@ csh h_arm;
 void disasm_open()
 {
     cs_err err;
+#if EMU68_DISASM_DEFERRED
+    /* Translator records the code only, nothing to open */
+    if (disasm_deferred)
+        return;
+#endif
     err = cs_open(CS_ARCH_M68K, CS_MODE_BIG_ENDIAN | CS_MODE_M68K_040, &h_m68k);
 #ifdef __aarch64__
     err = cs_open(CS_ARCH_ARM64, CS_MODE_ARM, &h_arm);
@@ -166,11 +175,20 @@ void disasm_open()
 
 void disasm_close()
 {
+#if EMU68_DISASM_DEFERRED
+    if (disasm_deferred)
+        return;
+#endif
     cs_close(&h_m68k);
     cs_close(&h_arm);
 }
 
-void disasm_print(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr, size_t arm_size, uint32_t *arm_start)
+/*
+    Print m68k instructions and the ARM code they were translated to. Code is read from
+    m68k_code and arm_code, printed addresses are m68k_addr and arm_offset.
+*/
+static void print_pair(csh hm, csh ha, const uint16_t *m68k_code, uint32_t m68k_addr, uint16_t m68k_count, size_t m68k_size,
+    const uint32_t *arm_code, uint32_t arm_offset, size_t arm_size)
 {
     cs_insn *insn_m68k;
     cs_insn *insn_arm;
@@ -178,10 +196,10 @@ void disasm_print(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr,
     size_t count_arm = 0;
     char fixed_op_str[200];
 
-    if (m68k_addr)
-        count_m68k = cs_disasm(h_m68k, (const uint8_t *)m68k_addr, 20*m68k_count, (uintptr_t)m68k_addr, m68k_count, &insn_m68k);
-    if (arm_addr)
-        count_arm = cs_disasm(h_arm, (const uint8_t *)arm_addr, arm_size, (uintptr_t)arm_addr - (uintptr_t)arm_start, 0, &insn_arm);
+    if (m68k_code && m68k_count)
+        count_m68k = cs_disasm(hm, (const uint8_t *)m68k_code, m68k_size, m68k_addr, m68k_count, &insn_m68k);
+    if (arm_code && arm_size)
+        count_arm = cs_disasm(ha, (const uint8_t *)arm_code, arm_size, arm_offset, 0, &insn_arm);
 
     for (size_t i=0; i < count_m68k; i++)
     {
@@ -207,3 +225,160 @@ void disasm_print(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr,
     if (count_arm)
         cs_free(insn_arm, count_arm);
 }
+
+#if EMU68_DISASM_DEFERRED
+
+/*
+    Deferred disassembly, "disassemble_deferred" on the command line. The translator copies
+    the m68k code and the ARM code translated from it into a ring and goes on. A secondary
+    CPU running disasm_task, or an offline tool reading the ring through disasm-buffer
+    property of /emu68, does the disassembly. Records not fitting into the ring are dropped.
+
+    Every record is 16-byte aligned and starts with struct DisasmRecord, followed by m68k words and
+    ARM instructions. A record with dr_M68kAddr of 0xffffffff pads the ring up to its end.
+*/
+
+struct DisasmRecord {
+    uint32_t    dr_M68kAddr;
+    uint32_t    dr_ARMOffset;
+    uint16_t    dr_M68kInsns;
+    uint16_t    dr_M68kWords;
+    uint16_t    dr_ARMInsns;
+    uint16_t    dr_Blocks;      /* Length of the record in 16-byte blocks */
+};
+
+struct DisasmRing {
+    volatile uint32_t   dr_Head;
+    volatile uint32_t   dr_Tail;
+    uint32_t            dr_Dropped;
+    uint32_t            dr_Size;
+    uint8_t             dr_Data[EMU68_DISASM_RING];
+};
+
+#define DISASM_PAD          0xffffffff
+#define DISASM_M68K_WORDS   64
+
+int disasm_deferred;
+static struct DisasmRing disasm_ring __attribute__((aligned(64))) = { .dr_Size = EMU68_DISASM_RING };
+
+static void disasm_record(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr, size_t arm_size, uint32_t *arm_start)
+{
+    uint32_t m68k_words = m68k_addr ? 10 * m68k_count : 0;
+    uint32_t arm_insns = arm_addr ? arm_size / 4 : 0;
+    uint32_t head = disasm_ring.dr_Head;
+    uint32_t tail = __atomic_load_n(&disasm_ring.dr_Tail, __ATOMIC_ACQUIRE);
+    uint32_t length, pos, pad = 0;
+
+    /* Same window of m68k code as the direct disassembly uses, but bounded */
+    if (m68k_words > DISASM_M68K_WORDS)
+        m68k_words = DISASM_M68K_WORDS;
+
+    length = (sizeof(struct DisasmRecord) + 2 * m68k_words + 4 * arm_insns + 15) & ~15;
+    pos = head & (EMU68_DISASM_RING - 1);
+
+    /* Records do not wrap, the rest of the ring is padded */
+    if (pos + length > EMU68_DISASM_RING)
+        pad = EMU68_DISASM_RING - pos;
+
+    if (length > EMU68_DISASM_RING / 4 || (head + pad + length) - tail > EMU68_DISASM_RING)
+    {
+        disasm_ring.dr_Dropped++;
+        return;
+    }
+
+    if (pad)
+    {
+        struct DisasmRecord *r = (struct DisasmRecord *)&disasm_ring.dr_Data[pos];
+
+        r->dr_M68kAddr = DISASM_PAD;
+        r->dr_Blocks = pad / 16;
+        head += pad;
+        pos = 0;
+    }
+
+    struct DisasmRecord *r = (struct DisasmRecord *)&disasm_ring.dr_Data[pos];
+    uint16_t *m68k = (uint16_t *)(r + 1);
+    uint32_t *arm = (uint32_t *)(m68k + m68k_words);
+
+    r->dr_M68kAddr = (uint32_t)(uintptr_t)m68k_addr;
+    r->dr_ARMOffset = (uintptr_t)arm_addr - (uintptr_t)arm_start;
+    r->dr_M68kInsns = m68k_addr ? m68k_count : 0;
+    r->dr_M68kWords = m68k_words;
+    r->dr_ARMInsns = arm_insns;
+    r->dr_Blocks = length / 16;
+
+    for (uint32_t i=0; i < m68k_words; i++)
+        m68k[i] = m68k_addr[i];
+    for (uint32_t i=0; i < arm_insns; i++)
+        arm[i] = arm_addr[i];
+
+    __atomic_store_n(&disasm_ring.dr_Head, head + length, __ATOMIC_RELEASE);
+    asm volatile("sev");
+}
+
+/* Tell offline tools where the ring is: physical address (2 cells), size of the ring structure */
+void disasm_publish()
+{
+    uint64_t phys = mmu_virt2phys((uintptr_t)&disasm_ring);
+    uint32_t prop[] = { phys >> 32, phys & 0xffffffff, sizeof(disasm_ring) };
+
+    dt_add_property(dt_find_node("/emu68"), "disasm-buffer", prop, sizeof(prop));
+}
+
+/* Disassemble records recorded by the translator. Never returns */
+void disasm_task()
+{
+    csh hm, ha;
+    uint32_t dropped = 0;
+
+    cs_open(CS_ARCH_M68K, CS_MODE_BIG_ENDIAN | CS_MODE_M68K_040, &hm);
+#ifdef __aarch64__
+    cs_open(CS_ARCH_ARM64, CS_MODE_ARM, &ha);
+#else
+    cs_open(CS_ARCH_ARM, CS_MODE_ARM, &ha);
+#endif
+
+    kprintf("[JIT] Deferred disassembly running\n");
+
+    while(1)
+    {
+        uint32_t tail = disasm_ring.dr_Tail;
+
+        while (tail == __atomic_load_n(&disasm_ring.dr_Head, __ATOMIC_ACQUIRE))
+            asm volatile("wfe");
+
+        struct DisasmRecord *r = (struct DisasmRecord *)&disasm_ring.dr_Data[tail & (EMU68_DISASM_RING - 1)];
+
+        if (r->dr_M68kAddr != DISASM_PAD)
+        {
+            const uint16_t *m68k = (const uint16_t *)(r + 1);
+            const uint32_t *arm = (const uint32_t *)(m68k + r->dr_M68kWords);
+
+            if (disasm_ring.dr_Dropped != dropped)
+            {
+                kprintf("[JIT] Deferred disassembly dropped %d records\n", disasm_ring.dr_Dropped - dropped);
+                dropped = disasm_ring.dr_Dropped;
+            }
+
+            print_pair(hm, ha, m68k, r->dr_M68kAddr, r->dr_M68kInsns, 2 * r->dr_M68kWords, arm, r->dr_ARMOffset, 4 * r->dr_ARMInsns);
+        }
+
+        __atomic_store_n(&disasm_ring.dr_Tail, tail + 16 * r->dr_Blocks, __ATOMIC_RELEASE);
+    }
+}
+
+#endif
+
+void disasm_print(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr, size_t arm_size, uint32_t *arm_start)
+{
+#if EMU68_DISASM_DEFERRED
+    if (disasm_deferred)
+    {
+        disasm_record(m68k_addr, m68k_count, arm_addr, arm_size, arm_start);
+        return;
+    }
+#endif
+
+    print_pair(h_m68k, h_arm, m68k_addr, (uintptr_t)m68k_addr, m68k_count, 20*m68k_count,
+        arm_addr, (uintptr_t)arm_addr - (uintptr_t)arm_start, arm_size);
+}
@@ -1,11 +1,87 @@
 #include <support.h>
 
+/*
+    The same command line is searched for dozens of tokens during boot. Words of the first
+    string searched, which is the command line, are kept in a table so that every further
+    lookup compares beginnings of the words only instead of scanning the whole string again.
+    The table is built once by the boot CPU and never changes afterwards, secondary CPUs may
+    use it without locking. Other strings, or ones with more words than the table holds, are
+    scanned the old way.
+*/
+
+#define MAX_WORDS   128
+
+static const char * word_string;
+static int word_count = -1;
+static const char * word_start[MAX_WORDS];
+static uint32_t word_length[MAX_WORDS];
+
+static int build_words(const char * string)
+{
+    int count = 0;
+
+    while (*string)
+    {
+        while (*string == ' ' || *string == '\t') {
+            string++;
+        }
+
+        if (*string == 0)
+            break;
+
+        if (count == MAX_WORDS)
+            return -1;
+
+        word_start[count] = string;
+
+        while (*string != 0 && *string != ' ' && *string != '\t')
+            string++;
+
+        word_length[count] = string - word_start[count];
+        count++;
+    }
+
+    return count;
+}
+
+/* Same rules as the scan below: word matches up to '=' in the token or if it ends first */
+static inline int match_word(const char * word, int length, const char * token)
+{
+    for (int i=0; token[i] != 0; i++)
+    {
+        if (word[i] != token[i])
+            return 0;
+
+        if (token[i] == '=' || i + 1 == length)
+            return 1;
+    }
+
+    return 0;
+}
+
 const char * find_token(const char * string, const char * token)
 {
     const char * ret = NULL;
 
     if (string)
     {
+        if (word_string == NULL)
+        {
+            word_count = build_words(string);
+            word_string = string;
+        }
+
+        if (string == word_string && word_count >= 0)
+        {
+            for (int i=0; i < word_count; i++)
+            {
+                if (match_word(word_start[i], word_length[i], token))
+                    return word_start[i];
+            }
+
+            return NULL;
+        }
+
         do {
             while (*string == ' ' || *string == '\t') {
                 string++;
@@ -120,6 +120,53 @@ struct MD5 CalcMD5(void *_start, void *_end)
 #include "cache.h"
 #endif
 
+#if defined(__aarch64__)
+/*
+    Ranges of three blocks or more are summed in three interleaved crc32x chains, a single chain
+    is bound by the latency of the instruction. Sums of the blocks are merged with tables which
+    advance a sum over one or two blocks of zeros
+*/
+#define CRC_BLOCK   64
+
+static uint32_t crc_shift[2][4][256];
+static int crc_shift_ready;
+
+static inline uint32_t crc32x(uint32_t crc, uint64_t val)
+{
+    asm("crc32x %w0, %w0, %2":"=r"(crc):"0"(crc),"r"(val));
+    return crc;
+}
+
+/* All cores compute the same values, a race of two of them settles itself */
+static void crc_shift_init()
+{
+    for (int t=0; t < 2; t++)
+    {
+        for (int k=0; k < 4; k++)
+        {
+            for (int b=0; b < 256; b++)
+            {
+                uint32_t crc = b << (8 * k);
+
+                for (int i=0; i < (t + 1) * CRC_BLOCK / 8; i++)
+                    crc = crc32x(crc, 0);
+
+                crc_shift[t][k][b] = crc;
+            }
+        }
+    }
+
+    __atomic_store_n(&crc_shift_ready, 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t crc_advance(int blocks, uint32_t crc)
+{
+    const uint32_t (*t)[256] = crc_shift[blocks - 1];
+
+    return t[0][crc & 0xff] ^ t[1][(crc >> 8) & 0xff] ^ t[2][(crc >> 16) & 0xff] ^ t[3][crc >> 24];
+}
+#endif
+
 uint32_t CalcCRC32(void *_start, void *_end)
 {
     intptr_t s = (intptr_t)_start;
@@ -128,9 +175,33 @@ uint32_t CalcCRC32(void *_start, void *_end)
     uint32_t crc = 0xffffffff;
 
 #if defined(__aarch64__)
+    /* Low memory is read directly if the emulated caches hold nothing written by the m68k */
+    const intptr_t direct = cache_bypassed(ICACHE) ? 0 : 0x01000000;
+
+    if (s > direct && (e - s) >= 3 * CRC_BLOCK)
+    {
+        if (!__atomic_load_n(&crc_shift_ready, __ATOMIC_ACQUIRE))
+            crc_shift_init();
+
+        while ((e - s) >= 3 * CRC_BLOCK) {
+            const uint64_t *p = (const uint64_t *)s;
+            uint32_t crc1 = 0;
+            uint32_t crc2 = 0;
+
+            for (int i=0; i < CRC_BLOCK / 8; i++) {
+                crc = crc32x(crc, p[i]);
+                crc1 = crc32x(crc1, p[i + CRC_BLOCK / 8]);
+                crc2 = crc32x(crc2, p[i + 2 * CRC_BLOCK / 8]);
+            }
+
+            crc = crc_advance(2, crc) ^ crc_advance(1, crc1) ^ crc2;
+            s += 3 * CRC_BLOCK;
+        }
+    }
+
     while((e - s) >= 16) {
         uint64_t val1; uint64_t val2;
-        if (s > 0x01000000)
+        if (s > direct)
         {
             asm volatile("ldp %0, %1, [%2]":"=r"(val1), "=r"(val2):"r"(s));
         }
@@ -145,7 +216,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if ((e - s) >= 8) {
         uint64_t val;
-        if (s > 0x01000000)
+        if (s > direct)
             val = *(uint64_t *)s;
         else
             val = cache_read_64(ICACHE, s);
@@ -154,7 +225,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if ((e - s) >= 4) {
         uint32_t val;
-        if (s > 0x01000000)
+        if (s > direct)
             val = *(uint32_t *)s;
         else
             val = cache_read_32(ICACHE, s);
@@ -163,7 +234,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if ((e - s) >= 2) {
         uint16_t val;
-        if (s > 0x01000000)
+        if (s > direct)
             val = *(uint16_t *)s;
         else
             val = cache_read_16(ICACHE, s);
@@ -172,7 +243,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if (e != s) {
         uint16_t val;
-        if (s > 0x01000000)
+        if (s > direct)
             val = *(uint16_t *)s;
         else
             val = cache_read_8(ICACHE, s);
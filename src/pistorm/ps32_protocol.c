@@ -16,6 +16,7 @@
 #include "ps_protocol.h"
 #include "M68k.h"
 #include "cache.h"
+#include "trace.h"
 
 #ifndef __aarch64__
 extern void pistorm_update_overlay_state(uint32_t new_overlay);
@@ -439,7 +440,7 @@ static int slot_active[2] = {0, 0};
 #define REG_SLOT        5
 #define CONTROL_INC_EXEC_SLOT (1 << 5)
 
-static void do_write_access_2s(unsigned int address, unsigned int data, unsigned int size)
+static inline void do_write_access_2s(unsigned int address, unsigned int data, unsigned int size)
 {
     uint32_t rdval = 0;
 
@@ -659,7 +660,7 @@ static inline void do_write_access_128_2s(unsigned int address, uint128_t data)
     if (address >= 0x00bf0000 && address <= 0x00dfffff) ps_read_32(0x00f80000);
 }
 
-static int do_read_access_2s(unsigned int address, unsigned int size)
+static inline int do_read_access_2s(unsigned int address, unsigned int size)
 {
     uint32_t rdval = 0;
 
@@ -1198,39 +1199,64 @@ static inline uint128_t do_read_access_128(unsigned int address)
     return data;
 }
 
-int (*read_access)(unsigned int address, unsigned int size);
-uint64_t (*read_access_64)(unsigned int address);
-uint128_t (*read_access_128)(unsigned int address);
-void (*write_access)(unsigned int address, unsigned int data, unsigned int size);
-void (*write_access_64)(unsigned int address, uint64_t data);
-void (*write_access_128)(unsigned int address, uint128_t data);
+/*
+    Protocol is fixed at boot. Both variants are called directly, the test of use_2slot is always
+    predicted right, so every access layer function below gets the protocol code inlined
+*/
+static inline int read_access(unsigned int address, unsigned int size)
+{
+    if (use_2slot)
+        return do_read_access_2s(address, size);
+    else
+        return do_read_access(address, size);
+}
 
-void ps_setup_protocol()
+static inline uint64_t read_access_64(unsigned int address)
 {
     if (use_2slot)
-    {
-        kprintf("[PS32] Setting up two-slot protocol\n");
-        
-        read_access = do_read_access_2s;
-        read_access_64 = do_read_access_64_2s;
-        read_access_128 = do_read_access_128_2s;
+        return do_read_access_64_2s(address);
+    else
+        return do_read_access_64(address);
+}
 
-        write_access = do_write_access_2s;
-        write_access_64 = do_write_access_64_2s;
-        write_access_128 = do_write_access_128_2s;
-    }
+static inline uint128_t read_access_128(unsigned int address)
+{
+    if (use_2slot)
+        return do_read_access_128_2s(address);
     else
-    {
-        kprintf("[PS32] Setting up protocol\n");
+        return do_read_access_128(address);
+}
 
-        read_access = do_read_access;
-        read_access_64 = do_read_access_64;
-        read_access_128 = do_read_access_128;
+static inline void write_access(unsigned int address, unsigned int data, unsigned int size)
+{
+    if (use_2slot)
+        do_write_access_2s(address, data, size);
+    else
+        do_write_access(address, data, size);
+}
 
-        write_access = do_write_access;
-        write_access_64 = do_write_access_64;
-        write_access_128 = do_write_access_128;
-    }
+static inline void write_access_64(unsigned int address, uint64_t data)
+{
+    if (use_2slot)
+        do_write_access_64_2s(address, data);
+    else
+        do_write_access_64(address, data);
+}
+
+static inline void write_access_128(unsigned int address, uint128_t data)
+{
+    if (use_2slot)
+        do_write_access_128_2s(address, data);
+    else
+        do_write_access_128(address, data);
+}
+
+void ps_setup_protocol()
+{
+    if (use_2slot)
+        kprintf("[PS32] Setting up two-slot protocol\n");
+    else
+        kprintf("[PS32] Setting up protocol\n");
 
 //    __atomic_clear(&gpio_lock, __ATOMIC_RELEASE);
 
@@ -1243,54 +1269,177 @@ void ps_setup_protocol()
 }
 
 
-unsigned int caddress;
-union {
-    uint32_t u32;
-    uint16_t u16[2];
-    uint8_t  u8[4];
-} cdata;
-union {
-    uint32_t u32;
-    uint16_t u16[2];
-    uint8_t  u8[4];
-} cmask;
+/*
+    Write combining buffer for CHIP RAM. Byte, word and long stores falling into one 16-byte
+    line are collected and issued with as few transactions as possible, a complete line goes
+    out as a single 128-bit burst. The buffer is flushed when a store leaves the line, on any
+    store outside CHIP RAM, on reads overlapping the line and before an interrupt is taken.
+*/
+unsigned int caddress = 0xffffffff;
+uint16_t cmask;
+uint8_t cdata[16];
+
+static inline uint64_t cdata_get(int offset, int size)
+{
+    uint64_t v = 0;
+
+    /* Bytes are kept in bus order */
+    for (int i=0; i < size; i++)
+        v = (v << 8) | cdata[offset + i];
+
+    return v;
+}
 
 void flush_cdata()
 {
-    if (cmask.u32 == 0xffffffff)
+    if (cmask == 0xffff)
     {
-        write_access(caddress, cdata.u32, SIZE_LONG);
+        uint128_t data;
+
+        data.hi = cdata_get(0, 8);
+        data.lo = cdata_get(8, 8);
+
+        write_access_128(caddress, data);
     }
-    else
+    else if (cmask)
     {
-        if (cmask.u16[0] == 0xffff)
-        {
-            write_access(caddress, cdata.u16[0], SIZE_WORD);
-            cmask.u16[0] = 0;
-        }
-        if (cmask.u16[1] == 0xffff)
-        {
-            write_access(caddress + 2, cdata.u16[1], SIZE_WORD);
-            cmask.u16[1] = 0;
-        }
-
-        if (cmask.u32)
+        for (int i=0; i < 16;)
         {
-            for (int i=0; i < 4; i++)
+            if ((i & 7) == 0 && ((cmask >> i) & 0xff) == 0xff)
             {
-                if (cmask.u8[i]) {
-                    write_access(caddress + i, cdata.u8[i], SIZE_BYTE);
-                }
+                write_access_64(caddress + i, cdata_get(i, 8));
+                i += 8;
+            }
+            else if ((i & 3) == 0 && ((cmask >> i) & 0xf) == 0xf)
+            {
+                write_access(caddress + i, cdata_get(i, 4), SIZE_LONG);
+                i += 4;
+            }
+            else if ((i & 1) == 0 && ((cmask >> i) & 3) == 3)
+            {
+                write_access(caddress + i, cdata_get(i, 2), SIZE_WORD);
+                i += 2;
+            }
+            else
+            {
+                if (cmask & (1 << i))
+                    write_access(caddress + i, cdata[i], SIZE_BYTE);
+                i++;
             }
         }
     }
 
     caddress = 0xffffffff;
-    cmask.u32 = 0;
+    cmask = 0;
+}
+
+#if PISTORM_WRITE_COMBINE
+/* Collect the store in combining buffer. Returns 0 if it has to be written directly */
+static inline int combine_write(unsigned int address, unsigned int data, int size)
+{
+    uint32_t offset = address & 15;
+
+    if (address + size > 0x200000 || offset + size > 16)
+    {
+        if (cmask)
+            flush_cdata();
+        return 0;
+    }
+
+    if ((address & ~15) != caddress)
+    {
+        if (cmask)
+            flush_cdata();
+        caddress = address & ~15;
+    }
+
+    for (int i=0; i < size; i++)
+        cdata[offset + i] = data >> (8 * (size - 1 - i));
+
+    cmask |= ((1 << size) - 1) << offset;
+
+    if (cmask == 0xffff)
+        flush_cdata();
+
+    return 1;
 }
 
+static inline void combine_read(unsigned int address, int size)
+{
+    if (cmask && address < caddress + 16 && address + size > caddress)
+        flush_cdata();
+}
+#endif
+
 #define SLOW_IO(address) ((address) >= 0xDFF09A && (address) < 0xDFF09E)
 
+#if PISTORM_BLIT_PREDICT
+/* Earliest end of the last blit started by the CPU, in CNTPCT ticks */
+static uint64_t blit_end;
+static uint32_t blit_freq;
+static uint16_t blit_con0;
+static uint16_t blit_con1;
+static uint16_t blit_sizv;
+
+/* Blitter cycles per word with the channels enabled in BLTCON0, USEA to USED in bits 3 to 0 */
+static const uint8_t blit_cycles[16] = { 2, 2, 2, 3, 3, 3, 3, 4, 2, 2, 2, 3, 3, 3, 3, 4 };
+
+static inline void blit_predict_word(unsigned int addr, uint16_t value)
+{
+    uint64_t words;
+    uint32_t cycles;
+
+    switch (addr)
+    {
+        case 0xdff040:
+            blit_con0 = value;
+            return;
+        case 0xdff042:
+            blit_con1 = value;
+            return;
+        case 0xdff058:
+            words = ((value >> 6) ? (value >> 6) : 1024) * ((value & 0x3f) ? (value & 0x3f) : 64);
+            break;
+        case 0xdff05c:
+            blit_sizv = value & 0x7fff;
+            return;
+        case 0xdff05e:
+            words = (blit_sizv ? blit_sizv : 0x8000) * ((value & 0x7ff) ? (value & 0x7ff) : 0x800);
+            break;
+        default:
+            return;
+    }
+
+    /* Fastest case without any other DMA, line mode is never faster than two cycles a word */
+    cycles = (blit_con1 & 1) ? 2 : blit_cycles[(blit_con0 >> 8) & 15];
+
+    if (blit_freq == 0)
+        blit_freq = pistorm_read_cntfrq();
+
+    blit_end = pistorm_read_cntpct() + (words * cycles * blit_freq) / PISTORM_BLIT_CCK_HZ;
+}
+
+/* Follow writes to BLTCON0/1 and the start of blits, only word and long writes are seen */
+static inline void blit_predict(unsigned int addr, unsigned int size, unsigned int value)
+{
+    if (!__m68k_state || !(__m68k_state->JIT_CONTROL2 & JC2F_BLITWAIT))
+        return;
+
+    addr &= 0xffffff;
+
+    if (addr < 0xdff040 || addr >= 0xdff060)
+        return;
+
+    if (size == 2)
+        blit_predict_word(addr, value);
+    else if (size == 4)
+    {
+        blit_predict_word(addr, value >> 16);
+        blit_predict_word(addr + 2, value & 0xffff);
+    }
+}
+#endif
+
 static inline void check_blit_active(unsigned int addr, unsigned int size) {
     if (!(__m68k_state->JIT_CONTROL2 & JC2F_BLITWAIT))
         return;
@@ -1301,6 +1450,11 @@ static inline void check_blit_active(unsigned int addr, unsigned int size) {
         return;
 
     const uint16_t mask = 1<<14 | 1<<9 | 1<<6; // BBUSY | DMAEN | BLTEN
+#if PISTORM_BLIT_PREDICT
+    /* Blit is not over before its predicted end, polling earlier only steals cycles from it */
+    while ((int64_t)(blit_end - pistorm_read_cntpct()) > 0)
+        asm volatile("yield");
+#endif
     while ((read_access(0xdff002, SIZE_WORD) & mask) == mask) {
         // Dummy reads to not steal too many cycles from the blitter.
         // But don't use e.g. CIA reads as we expect the operation
@@ -1311,6 +1465,13 @@ static inline void check_blit_active(unsigned int addr, unsigned int size) {
 }
 
 void ps_write_8(unsigned int address, unsigned int data) {
+#if PISTORM_WRITE_COMBINE
+    if (combine_write(address, data, 1))
+    {
+        cache_invalidate_range(ICACHE, address, 1);
+        return;
+    }
+#endif
     write_access(address, data, SIZE_BYTE);
     if (SLOW_IO(address))
     {
@@ -1320,8 +1481,18 @@ void ps_write_8(unsigned int address, unsigned int data) {
 }
 
 void ps_write_16(unsigned int address, unsigned int data) {
+#if PISTORM_WRITE_COMBINE
+    if (combine_write(address, data, 2))
+    {
+        cache_invalidate_range(ICACHE, address, 2);
+        return;
+    }
+#endif
     check_blit_active(address, 2);
     write_access(address, data, SIZE_WORD);
+#if PISTORM_BLIT_PREDICT
+    blit_predict(address, 2, data);
+#endif
     if (SLOW_IO(address))
     {
         read_access(0x00f00000, SIZE_BYTE);
@@ -1330,8 +1501,18 @@ void ps_write_16(unsigned int address, unsigned int data) {
 }
 
 void ps_write_32(unsigned int address, unsigned int data) {
+#if PISTORM_WRITE_COMBINE
+    if (combine_write(address, data, 4))
+    {
+        cache_invalidate_range(ICACHE, address, 4);
+        return;
+    }
+#endif
     check_blit_active(address, 4);
     write_access(address, data, SIZE_LONG);
+#if PISTORM_BLIT_PREDICT
+    blit_predict(address, 4, data);
+#endif
     if (SLOW_IO(address))
     {
         read_access(0x00f00000, SIZE_BYTE);
@@ -1340,6 +1521,10 @@ void ps_write_32(unsigned int address, unsigned int data) {
 }
 
 void ps_write_64(unsigned int address, uint64_t data) {
+#if PISTORM_WRITE_COMBINE
+    if (cmask)
+        flush_cdata();
+#endif
     check_blit_active(address, 8);
     write_access_64(address, data);
     if (SLOW_IO(address))
@@ -1350,6 +1535,10 @@ void ps_write_64(unsigned int address, uint64_t data) {
 }
 
 void ps_write_128(unsigned int address, uint128_t data) {
+#if PISTORM_WRITE_COMBINE
+    if (cmask)
+        flush_cdata();
+#endif
     check_blit_active(address, 16);
     write_access_128(address, data);
     if (SLOW_IO(address))
@@ -1360,6 +1549,9 @@ void ps_write_128(unsigned int address, uint128_t data) {
 }
 
 unsigned int ps_read_8(unsigned int address) {
+#if PISTORM_WRITE_COMBINE
+    combine_read(address, 1);
+#endif
     unsigned int value = read_access(address, SIZE_BYTE);
 #ifndef __aarch64__
     value = pistorm_finalize_protocol_read(address, value, 1);
@@ -1368,6 +1560,9 @@ unsigned int ps_read_8(unsigned int address) {
 }
 
 unsigned int ps_read_16(unsigned int address) {
+#if PISTORM_WRITE_COMBINE
+    combine_read(address, 2);
+#endif
     unsigned int value = read_access(address, SIZE_WORD);
 #ifndef __aarch64__
     value = pistorm_finalize_protocol_read(address, value, 2);
@@ -1376,6 +1571,9 @@ unsigned int ps_read_16(unsigned int address) {
 }
 
 unsigned int ps_read_32(unsigned int address) {
+#if PISTORM_WRITE_COMBINE
+    combine_read(address, 4);
+#endif
     unsigned int value = read_access(address, SIZE_LONG);
 #ifndef __aarch64__
     value = pistorm_finalize_protocol_read(address, value, 4);
@@ -1384,13 +1582,34 @@ unsigned int ps_read_32(unsigned int address) {
 }
 
 uint64_t ps_read_64(unsigned int address) {
+#if PISTORM_WRITE_COMBINE
+    combine_read(address, 8);
+#endif
     return read_access_64(address);
 }
 
 uint128_t ps_read_128(unsigned int address) {
+#if PISTORM_WRITE_COMBINE
+    combine_read(address, 16);
+#endif
     return read_access_128(address);
 }
 
+/* Copy size bytes (multiple of 16) of memory without side effects, e.g. ROM, in 128-bit bus transfers */
+void ps_read_block(unsigned int address, void *dst, unsigned int size) {
+    uint64_t *d = dst;
+
+#if PISTORM_WRITE_COMBINE
+    combine_read(address, size);
+#endif
+
+    for (unsigned int i=0; i < size; i+=16) {
+        uint128_t v = read_access_128(address + i);
+        *d++ = v.hi;
+        *d++ = v.lo;
+    }
+}
+
 void ps_reset_state_machine() {
 }
 
@@ -1432,6 +1651,18 @@ void ps_pulse_reset()
 
 
 
+#if PISTORM_EFINIX_WIDTH == 8
+static const uint8_t efinix_cdi[8] = {
+    PIN_CDI0, PIN_CDI1, PIN_CDI2, PIN_CDI3, PIN_CDI4, PIN_CDI5, PIN_CDI6, PIN_CDI7
+};
+
+#define EFINIX_CDI_MASK ((1 << PIN_CDI0) | (1 << PIN_CDI1) | (1 << PIN_CDI2) | (1 << PIN_CDI3) | \
+                         (1 << PIN_CDI4) | (1 << PIN_CDI5) | (1 << PIN_CDI6) | (1 << PIN_CDI7))
+
+/* GPSET bits for every byte value, the CDI pins are spread over the GPIO bank */
+static uint32_t efinix_set[256];
+#endif
+
 void ps_efinix_setup()
 {
     //set programming pins to output
@@ -1449,8 +1680,24 @@ void ps_efinix_setup()
     x4 SPI => CBUS 3'b101
     x8 SPI => CBUS 3'b100
     */
+#if PISTORM_EFINIX_WIDTH == 8
+    //set cbus (x8 spi)
+    *(gpio + 10) = LE32((1 << PIN_CBUS0) | (1 << PIN_CBUS1));
+    *(gpio + 7) = LE32(1 << PIN_CBUS2);
+
+    for (int i=0; i < 256; i++)
+    {
+        efinix_set[i] = 0;
+        for (int b=0; b < 8; b++)
+        {
+            if (i & (1 << b))
+                efinix_set[i] |= 1 << efinix_cdi[b];
+        }
+    }
+#else
     //set cbus (x1 spi)
     *(gpio + 7) = LE32((1 << PIN_CBUS0) | (1 << PIN_CBUS1)| (1 << PIN_CBUS2));
+#endif
 
     //set other relevant pins for programming to correct level
     *(gpio + 7) = LE32((1 << PIN_TESTN) | (1 << PIN_CCK));
@@ -1483,9 +1730,41 @@ void ps_efinix_write(unsigned char data_out)
     *(gpio + 10) = LE32(1 << PIN_CCK);
 }
 
+#if PISTORM_EFINIX_WIDTH == 8
+/* One byte per clock on CDI0-7, same clock timing as the x1 writer */
+static inline void ps_efinix_write_x8(unsigned char data_out)
+{
+    uint32_t set = efinix_set[data_out];
+
+    *(gpio + 10) = LE32(1 << PIN_CCK);
+    *(gpio + 10) = LE32(1 << PIN_CCK);
+    *(gpio + 10) = LE32(1 << PIN_CCK);
+    *(gpio + 10) = LE32(EFINIX_CDI_MASK & ~set);
+    *(gpio + 7) = LE32(set);
+    *(gpio + 7) = LE32(1 << PIN_CCK);
+    *(gpio + 7) = LE32(1 << PIN_CCK);
+    *(gpio + 7) = LE32(1 << PIN_CCK);
+    *(gpio + 7) = LE32(1 << PIN_CCK);
+}
+#endif
+
 void ps_efinix_load(char* buffer, long length)
 {
     long i;
+#if PISTORM_EFINIX_WIDTH == 8
+    for (i = 0; i < length; ++i)
+    {
+        ps_efinix_write_x8(buffer[i]);
+    }
+
+    //8000 dummy clocks for startup of user logic, as in x1 mode
+    for (i = 0; i < 8000; ++i)
+    {
+        ps_efinix_write_x8(0x00);
+    }
+
+    *(gpio + 10) = LE32(1 << PIN_CCK);
+#else
     for (i = 0; i < length; ++i)
     {
         ps_efinix_write(buffer[i]);
@@ -1496,6 +1775,7 @@ void ps_efinix_load(char* buffer, long length)
     {
         ps_efinix_write(0x00);
     }
+#endif
 }
 
 #define BITBANG_DELAY PISTORM_BITBANG_DELAY
@@ -1705,6 +1985,38 @@ void fastSerial_init()
 #define PM_RSTC_FULLRST 0x00000020
 
 volatile int housekeeper_enabled = 0;
+volatile int ps_warm_reset = 0;
+volatile int ps_reset_self = 0;
+
+/* IPL lines and keyboard reset wake the housekeeper */
+#define HKEEP_PINS      (7 | (1 << PIN_KBRESET))
+
+int ps_reset_active()
+{
+    return (LE32(*gpread) & (1 << PIN_KBRESET)) == 0;
+}
+
+#if PISTORM_WARM_RESET
+/*
+    Reset line went low and warm reset is enabled. Unless the line is pulsed by Emu68 itself,
+    the emulation core is asked to restart the m68k. Housekeeper waits until the core is done
+    and the line is released again.
+*/
+static void ps_hkeep_warm_reset()
+{
+    if (!ps_reset_self && !__m68k_state->INT.RESET)
+    {
+        kprintf("[HKEEP] Reset line active, restarting m68k\n");
+
+        __m68k_state->INT.RESET = 1;
+        asm volatile("sev":::"memory");
+        ps_ipl_sgi_kick();
+    }
+
+    while (__m68k_state->INT.RESET || ps_reset_active())
+        usleep(1000);
+}
+#endif
 
 void ps_housekeeper() 
 {
@@ -1719,22 +2031,16 @@ void ps_housekeeper()
     last_arm_cnt = pistorm_read_pmccntr();
 
     kprintf("[HKEEP] Housekeeper activated\n");
-    kprintf("[HKEEP] Please note we are burning the cpu with busyloops now\n");
 
-    /* Configure timer-based event stream */
-    /* Enable timer regs from EL0, enable event stream on posedge, monitor 2th bit */
-    /* This gives a frequency of 2.4MHz for a 19.2MHz timer */
-    uint64_t tmp;
-    tmp = pistorm_read_cntfrq();
+    /* Configure timer-based event stream, used for polling if edge interrupt is not available */
+    pistorm_write_cntkctl(ps_hkeep_cntkctl(pistorm_read_cntfrq()));
 
-    if (tmp > 20000000)
-    {
-        pistorm_write_cntkctl(3 | (1 << 2) | (3 << 8) | (3 << 4));
-    }
+    int ipl_irq = ps_ipl_irq_setup(gpio, HKEEP_PINS, PISTORM_IPL_IRQ_POLL_HZ);
+
+    if (ipl_irq)
+        kprintf("[HKEEP] Waiting for IPL edges, fallback wakeup at %d Hz\n", PISTORM_IPL_IRQ_POLL_HZ);
     else
-    {
-        pistorm_write_cntkctl(3 | (1 << 2) | (3 << 8) | (2 << 4));
-    }
+        kprintf("[HKEEP] Polling IPL at %d Hz, please note we are burning the cpu with busyloops now\n", PISTORM_HKEEP_POLL_HZ);
 
     uint8_t pin_prev = LE32(*gpread);
     
@@ -1748,23 +2054,55 @@ void ps_housekeeper()
             //}
 
             uint32_t pin = LE32(*gpread);
+            int stable = (pin & 7) == (pin_prev & 7);
 
             // Reall 680x0 CPU filters IPL lines in order to avoid false interrupts if
             // there is a clock skew between three IPL bits. We need to do the same.
             // Update IPL if and only if two subsequent IPL reads are the same.
-            if ((pin & 7) == (pin_prev & 7))
+            if (stable)
             {
+                uint8_t ipl_prev = __m68k_state->INT.IPL;
+
                 __m68k_state->INT.IPL = ~pin & 7;
 
                 asm volatile("":::"memory");
 
+                if (__m68k_state->INT.IPL != ipl_prev)
+                    Trace(TRACE_IPL_CHANGE, ipl_prev, __m68k_state->INT.IPL, 0, 0);
+
                 if (__m68k_state->INT.IPL)
+                {
+#if PISTORM_STOP_WAKE
+                    /* Event only for a STOP which takes this level, wfe of this loop is not woken either */
+                    asm volatile("dmb ish":::"memory");
+
+                    if (__m68k_state->INT.IPL > m68k_stop_level)
+                    {
+                        if (m68k_stop_event == 0)
+                            m68k_stop_event = pistorm_read_cntpct();
+                        asm volatile("sev":::"memory");
+                    }
+#else
                     asm volatile("sev":::"memory");
+#endif
+
+                    /* New level, chained code on the emulation core has to notice it */
+                    if (__m68k_state->INT.IPL != ipl_prev)
+                        ps_ipl_sgi_kick();
+                }
             }
 
             pin_prev = pin;
 
             if ((pin & (1 << PIN_KBRESET)) == 0) {
+#if PISTORM_WARM_RESET
+                if (ps_warm_reset)
+                {
+                    ps_hkeep_warm_reset();
+                    pin_prev = LE32(*gpread);
+                    continue;
+                }
+#endif
                 kprintf("[HKEEP] Houskeeper will reset RasPi now...\n");
 
                 ps_set_control(CONTROL_REQ_BM);
@@ -1783,6 +2121,13 @@ void ps_housekeeper()
                 while(1);
             }
 
+            /* Settled IPL, sleep until next edge. Otherwise read again at next event to filter it */
+            if (ipl_irq && stable)
+            {
+                ps_ipl_irq_wait(gpio, HKEEP_PINS, pin & HKEEP_PINS);
+                continue;
+            }
+
             /*
               Wait for event. It can happen that the CPU is flooded with them for some reason, but
               nevertheless, thanks for the event stream set up above, they will appear at 1.2MHz in worst case
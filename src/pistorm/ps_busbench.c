@@ -0,0 +1,200 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "ps_protocol.h"
+
+/*
+    Bus benchmark, requested with busbench=<count> on the command line.
+
+    Every test performs <count> accesses of one size to one region of the Amiga bus, first
+    back to back for the throughput and then each one timed separately for the latency. The
+    latencies are sorted into a histogram with buckets doubling in width, starting with
+    anything below BENCH_BUCKET0_NS. Results are printed and stored in /emu68/busbench, one
+    property per test holding KB/s, min, avg and max latency in ns and the histogram.
+
+    CHIP RAM is accessed sequentially within a 32K window, registers always at the same
+    address. The CIA has byte wide registers only, wider accesses are not tested there.
+*/
+
+#define BENCH_BUCKETS       8
+#define BENCH_BUCKET0_NS    125U
+#define BENCH_CHIP_BASE     0x8000
+#define BENCH_CHIP_SPAN     0x8000
+
+struct BenchRegion {
+    const char *    br_Name;
+    uint32_t        br_ReadAddr;
+    uint32_t        br_WriteAddr;
+    uint32_t        br_Span;
+    uint8_t         br_Sizes;
+};
+
+static const struct BenchRegion regions[] = {
+    { "chip",   BENCH_CHIP_BASE, BENCH_CHIP_BASE, BENCH_CHIP_SPAN,  0x1f },
+    { "custom", 0xdff000,        0xdff180,        0,                0x1f },   /* Read-only registers / COLOR00..07 */
+    { "cia",    0xbfe301,        0xbfe301,        0,                0x01 },   /* CIAA DDRB */
+};
+
+static inline uint64_t bench_cntpct(void)
+{
+    uint64_t value;
+#ifdef __aarch64__
+    asm volatile("isb; mrs %0, CNTPCT_EL0" : "=r"(value));
+#else
+    uint32_t lo, hi;
+    asm volatile("isb; mrrc p15, 0, %0, %1, c14" : "=r"(lo), "=r"(hi));
+    value = ((uint64_t)hi << 32) | lo;
+#endif
+    return value;
+}
+
+static inline uint32_t bench_cntfrq(void)
+{
+#ifdef __aarch64__
+    uint64_t value;
+    asm volatile("mrs %0, CNTFRQ_EL0" : "=r"(value));
+    return (uint32_t)value;
+#else
+    uint32_t value;
+    asm volatile("mrc p15, 0, %0, c14, c0, 0" : "=r"(value));
+    return value;
+#endif
+}
+
+static inline void bench_access(int write, unsigned int size, uint32_t address, uint32_t value)
+{
+    switch (size)
+    {
+        case 0:
+            if (write) ps_write_8(address, value); else ps_read_8(address);
+            break;
+        case 1:
+            if (write) ps_write_16(address, value); else ps_read_16(address);
+            break;
+        case 2:
+            if (write) ps_write_32(address, value); else ps_read_32(address);
+            break;
+        case 3:
+            if (write) ps_write_64(address, value); else ps_read_64(address);
+            break;
+        case 4:
+            if (write) {
+                uint128_t v = { value, value };
+                ps_write_128(address, v);
+            }
+            else
+                ps_read_128(address);
+            break;
+    }
+}
+
+static uint32_t ticks_to_ns(uint64_t ticks, uint32_t freq)
+{
+    return (ticks * 1000000000ULL) / freq;
+}
+
+static void bench_run(of_node_t *node, const struct BenchRegion *r, int write, unsigned int size, unsigned int count, uint32_t freq)
+{
+    uint32_t result[4 + BENCH_BUCKETS] = { 0 };
+    uint32_t *hist = &result[4];
+    uint32_t bytes = 1 << size;
+    uint32_t mask = r->br_Span ? r->br_Span - 1 : 0;
+    uint32_t base = write ? r->br_WriteAddr : r->br_ReadAddr;
+    uint32_t value = 0;
+    uint64_t t0, t1, sum = 0, min = ~0ULL, max = 0;
+    char name[32];
+
+    /* Registers are written with the value they hold already */
+    if (write && size == 0 && r->br_Span == 0)
+        value = ps_read_8(base);
+
+    t0 = bench_cntpct();
+    for (unsigned int i=0; i < count; i++)
+        bench_access(write, size, base + ((i * bytes) & mask), value);
+    t1 = bench_cntpct();
+
+    if (t1 > t0)
+        result[0] = ((uint64_t)count * bytes * freq) / ((t1 - t0) * 1024);
+
+    for (unsigned int i=0; i < count; i++)
+    {
+        uint32_t address = base + ((i * bytes) & mask);
+        uint32_t ns;
+        int b = 0;
+
+        t0 = bench_cntpct();
+        bench_access(write, size, address, value);
+        t1 = bench_cntpct();
+
+        t1 -= t0;
+        sum += t1;
+        if (t1 < min) min = t1;
+        if (t1 > max) max = t1;
+
+        ns = ticks_to_ns(t1, freq);
+        while (b < BENCH_BUCKETS - 1 && ns >= (BENCH_BUCKET0_NS << b))
+            b++;
+        hist[b]++;
+    }
+
+    result[1] = ticks_to_ns(min, freq);
+    result[2] = ticks_to_ns(sum / count, freq);
+    result[3] = ticks_to_ns(max, freq);
+
+    kprintf("[BOOT]   %-6s %s %3d: %6d KB/s, latency %5d/%5d/%5d ns |", r->br_Name, write ? "write" : "read ",
+        8 << size, result[0], result[1], result[2], result[3]);
+    for (int b=0; b < BENCH_BUCKETS; b++)
+        kprintf(" %d", hist[b]);
+    kprintf("\n");
+
+    /* Property name like "chip-read32" */
+    int len = 0;
+    for (const char *s = r->br_Name; *s; s++)
+        name[len++] = *s;
+    for (const char *s = write ? "-write" : "-read"; *s; s++)
+        name[len++] = *s;
+    if (size > 3)
+        name[len++] = '0' + (8 << size) / 100;
+    if (size > 0)
+        name[len++] = '0' + ((8 << size) / 10) % 10;
+    name[len++] = '0' + (8 << size) % 10;
+    name[len] = 0;
+
+    dt_add_property(node, name, result, sizeof(result));
+}
+
+void ps_busbench(unsigned int count)
+{
+    uint32_t freq = bench_cntfrq();
+    of_node_t *node = dt_make_node("busbench");
+    uint32_t buckets[] = { BENCH_BUCKETS, BENCH_BUCKET0_NS };
+
+    kprintf("[BOOT] Bus benchmark, %d accesses per test\n", count);
+    kprintf("[BOOT]   min/avg/max latency, histogram of buckets from <%dns doubling\n", BENCH_BUCKET0_NS);
+
+    dt_add_property(node, "histogram-buckets", buckets, sizeof(buckets));
+
+    for (unsigned int i=0; i < sizeof(regions) / sizeof(regions[0]); i++)
+    {
+        for (unsigned int size = 0; size < 5; size++)
+        {
+            if (!(regions[i].br_Sizes & (1 << size)))
+                continue;
+
+            bench_run(node, &regions[i], 0, size, count, freq);
+            bench_run(node, &regions[i], 1, size, count, freq);
+        }
+    }
+
+    dt_add_node(dt_find_node("/emu68"), node);
+}
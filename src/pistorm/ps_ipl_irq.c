@@ -0,0 +1,380 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "M68k.h"
+#include "ps_protocol.h"
+
+/*
+    Event driven wakeup of the housekeeper CPU on boards with GIC-400 (Pi4, CM4).
+
+    GPIO edge detection is enabled on the IPL and reset pins, it asserts the level sensitive
+    interrupt of GPIO bank 0 which is routed to the housekeeper CPU only. IRQs remain masked
+    in PSTATE, a pending interrupt wakes the core from wfi without being taken, therefore no
+    acknowledge is ever needed. Clearing the latched edges drops the line again. The virtual
+    timer of the CPU wakes it additionally at a low rate, in case an edge gets lost.
+
+    Boards without GIC-400, or where the interrupt does not reach the CPU, keep polling.
+
+    The housekeeper tells the emulation core about new IPL with a software generated
+    interrupt. Its handler only clears the INT flag in v29, chained exits of translated code
+    test that flag instead of loading INT on every exit.
+*/
+
+#define GPIO_GPLEV0         13
+#define GPIO_GPEDS0         16
+#define GPIO_GPREN0         19
+#define GPIO_GPFEN0         22
+
+#define GICD_CTLR           0x000
+#define GICD_ISENABLER      0x100
+#define GICD_IPRIORITYR     0x400
+#define GICD_ITARGETSR      0x800
+#define GICD_SGIR           0xf00
+#define GICC_CTLR           0x000
+#define GICC_PMR            0x004
+#define GICC_IAR            0x00c
+#define GICC_EOIR           0x010
+
+#define GIC_PPI_VTIMER      27
+#define GIC_SPI_BASE        32
+#define GIC_PRIORITY        0xa0
+
+/* Event stream setup for CNTKCTL, events come at the first rate not below the requested one */
+uint32_t ps_hkeep_cntkctl(uint32_t freq)
+{
+    uint32_t ratio = freq / PISTORM_HKEEP_POLL_HZ;
+    uint32_t evnti = 0;
+
+    /* Event is generated on rising edge of counter bit evnti, rate is freq / 2^(evnti + 1) */
+    while (evnti < 15 && (2U << (evnti + 1)) <= ratio)
+        evnti++;
+
+    /* Enable timer regs from EL0, enable event stream on posedge */
+    return 3 | (1 << 2) | (3 << 8) | (evnti << 4);
+}
+
+#if defined(__aarch64__) && PISTORM_IPL_IRQ
+
+static volatile uint8_t *gicd;
+static volatile uint8_t *gicc;
+static uint32_t timer_interval;
+static uint32_t sgi_target;
+
+static int is_compatible(of_node_t *node, const char *compat)
+{
+    of_property_t *p = dt_find_property(node, "compatible");
+
+    if (p == NULL)
+        return 0;
+
+    /* List of zero terminated strings */
+    for (uint32_t pos = 0; pos < p->op_length; pos += strlen((char *)p->op_value + pos) + 1)
+    {
+        if (strcmp((char *)p->op_value + pos, compat) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static of_node_t *find_compatible(of_node_t *parent, const char *compat)
+{
+    for (of_node_t *n = parent->on_children; n; n = n->on_next)
+    {
+        if (is_compatible(n, compat))
+            return n;
+    }
+
+    return NULL;
+}
+
+/* Translate bus address through /soc ranges, these hold virtual addresses set up by platform_init */
+static uintptr_t soc_bus_to_virt(of_node_t *soc, uint32_t bus)
+{
+    of_property_t *p = dt_find_property(soc, "ranges");
+
+    if (p == NULL)
+        return 0;
+
+    uint32_t *ranges = p->op_value;
+    int32_t len = p->op_length;
+
+    int addr_cpu_len = dt_get_property_value_u32(soc->on_parent, "#address-cells", 1, FALSE);
+    int addr_bus_len = dt_get_property_value_u32(soc, "#address-cells", 1, TRUE);
+    int size_bus_len = dt_get_property_value_u32(soc, "#size-cells", 1, TRUE);
+
+    int pos_abus = addr_bus_len - 1;
+    int pos_acpu = pos_abus + addr_cpu_len;
+    int pos_sbus = pos_acpu + size_bus_len;
+
+    while (len > 0)
+    {
+        uint32_t addr_bus = BE32(ranges[pos_abus]);
+        uint32_t addr_cpu = BE32(ranges[pos_acpu]);
+        uint32_t addr_len = BE32(ranges[pos_sbus]);
+
+        if (bus >= addr_bus && bus - addr_bus < addr_len)
+            return addr_cpu + (bus - addr_bus);
+
+        len -= sizeof(int32_t) * (addr_bus_len + addr_cpu_len + size_bus_len);
+        ranges += addr_bus_len + addr_cpu_len + size_bus_len;
+    }
+
+    return 0;
+}
+
+static inline void gic_write32(volatile uint8_t *base, uint32_t offset, uint32_t value)
+{
+    *(volatile uint32_t *)(base + offset) = LE32(value);
+}
+
+static inline uint32_t gic_read32(volatile uint8_t *base, uint32_t offset)
+{
+    return LE32(*(volatile uint32_t *)(base + offset));
+}
+
+static inline void arm_timer(uint32_t interval)
+{
+    asm volatile("msr CNTV_TVAL_EL0, %0; msr CNTV_CTL_EL0, %1; isb"::"r"((uint64_t)interval), "r"(1ULL));
+}
+
+static int irq_pending()
+{
+    uint64_t isr;
+
+    asm volatile("mrs %0, ISR_EL1":"=r"(isr));
+
+    return (isr & 0x80) != 0;
+}
+
+/* Wait up to 20ms for an interrupt to become pending at this CPU */
+static int wait_irq_pending()
+{
+    uint64_t t0, t1, freq;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+    asm volatile("mrs %0, CNTVCT_EL0":"=r"(t0));
+
+    do
+    {
+        if (irq_pending())
+            return 1;
+
+        asm volatile("mrs %0, CNTVCT_EL0":"=r"(t1));
+    } while (t1 - t0 < freq / 50);
+
+    return 0;
+}
+
+/* Locate distributor and CPU interface of GIC-400 and the interrupt of GPIO bank 0 */
+static int gic_probe(uint32_t *gpio_irq)
+{
+    of_node_t *soc = dt_find_node("/soc");
+    of_node_t *gic, *gpio_node;
+    of_property_t *p;
+
+    if (soc == NULL)
+        return 0;
+
+    gic = find_compatible(soc, "arm,gic-400");
+    gpio_node = find_compatible(soc, "brcm,bcm2711-gpio");
+
+    if (gic == NULL || gpio_node == NULL)
+        return 0;
+
+    /* First interrupt of GPIO node covers bank 0, cells are <type number flags> */
+    p = dt_find_property(gpio_node, "interrupts");
+    if (p == NULL || p->op_length < 12 || BE32(((uint32_t *)p->op_value)[0]) != 0)
+        return 0;
+    *gpio_irq = GIC_SPI_BASE + BE32(((uint32_t *)p->op_value)[1]);
+
+    /* Distributor and CPU interface are the first two entries of reg */
+    p = dt_find_property(gic, "reg");
+    int cells = dt_get_property_value_u32(soc, "#address-cells", 1, FALSE) + dt_get_property_value_u32(soc, "#size-cells", 1, FALSE);
+    if (p == NULL || p->op_length < 2 * cells * sizeof(uint32_t))
+        return 0;
+
+    gicd = (volatile uint8_t *)soc_bus_to_virt(soc, BE32(((uint32_t *)p->op_value)[cells - 1 - 1]));
+    gicc = (volatile uint8_t *)soc_bus_to_virt(soc, BE32(((uint32_t *)p->op_value)[2 * cells - 1 - 1]));
+
+    return gicd != NULL && gicc != NULL;
+}
+
+/* Enable distributor and CPU interface of the calling CPU, the latter is banked */
+static void gic_enable_cpu()
+{
+    gic_write32(gicd, GICD_CTLR, gic_read32(gicd, GICD_CTLR) | 1);
+    gic_write32(gicc, GICC_PMR, 0xf0);
+    gic_write32(gicc, GICC_CTLR, gic_read32(gicc, GICC_CTLR) | 1);
+}
+
+/*
+    Set up edge interrupt for given GPIO pins, to be called on the housekeeper CPU. Returns 1
+    if the interrupt reaches the CPU and ps_ipl_irq_wait can be used.
+*/
+int ps_ipl_irq_setup(volatile uint32_t *gpio, uint32_t pins, uint32_t rate)
+{
+    uint32_t irq;
+    uint64_t mpidr, freq;
+
+    if (!gic_probe(&irq))
+        return 0;
+
+    asm volatile("mrs %0, MPIDR_EL1":"=r"(mpidr));
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+    /* GPIO interrupt goes to this CPU only, the timer PPI is banked per CPU anyway */
+    gicd[GICD_ITARGETSR + irq] = 1 << (mpidr & 7);
+    gicd[GICD_IPRIORITYR + irq] = GIC_PRIORITY;
+    gicd[GICD_IPRIORITYR + GIC_PPI_VTIMER] = GIC_PRIORITY;
+    gic_write32(gicd, GICD_ISENABLER + 4 * (irq / 32), 1 << (irq & 31));
+    gic_write32(gicd, GICD_ISENABLER, 1 << GIC_PPI_VTIMER);
+    gic_enable_cpu();
+
+    /* Check that the timer interrupt is signalled before the CPU relies on it in wfi */
+    arm_timer(freq / 1000);
+    if (!wait_irq_pending())
+    {
+        kprintf("[HKEEP] Timer interrupt does not reach CPU, IPL edge wakeup disabled\n");
+        asm volatile("msr CNTV_CTL_EL0, xzr; isb");
+        gic_write32(gicd, GICD_ISENABLER + 0x80 + 4 * (irq / 32), 1 << (irq & 31));
+        return 0;
+    }
+
+    timer_interval = freq / rate;
+
+    /* Edges on both directions, drop anything latched so far */
+    gpio[GPIO_GPREN0] |= LE32(pins);
+    gpio[GPIO_GPFEN0] |= LE32(pins);
+    gpio[GPIO_GPEDS0] = LE32(pins);
+
+    kprintf("[HKEEP] GIC at %p/%p, GPIO interrupt %d on CPU%d\n", gicd, gicc, irq, (int)(mpidr & 7));
+
+    return 1;
+}
+
+/*
+    Sleep until any of the pins changes or the fallback timer expires. The pins are expected
+    to be in state given by current, if they changed already the call returns immediately.
+*/
+void ps_ipl_irq_wait(volatile uint32_t *gpio, uint32_t pins, uint32_t current)
+{
+    gpio[GPIO_GPEDS0] = LE32(pins);
+    arm_timer(timer_interval);
+
+    /* Edge between the last read of caller and clearing of the status above would be lost */
+    if ((LE32(gpio[GPIO_GPLEV0]) & pins) != current)
+        return;
+
+    asm volatile("dsb sy; wfi");
+}
+
+#if EMU68_ASYNC_INT
+/*
+    Make the calling CPU, the one executing m68k code, receive INT signal from the housekeeper.
+    Has to be called with IRQs masked. Returns 1 on success, otherwise the JIT keeps polling INT.
+*/
+int ps_ipl_sgi_attach()
+{
+    uint32_t irq;
+    uint64_t mpidr;
+
+    if (gicd == NULL && !gic_probe(&irq))
+        return 0;
+
+    asm volatile("mrs %0, MPIDR_EL1":"=r"(mpidr));
+
+    gicd[GICD_IPRIORITYR + INT_SIGNAL_SGI] = GIC_PRIORITY;
+#if EMU68_PROFILER
+    gicd[GICD_IPRIORITYR + INT_PROFILE_SGI] = GIC_PRIORITY;
+#endif
+    gic_enable_cpu();
+
+    /* Signal itself, SGI has to become pending and is acknowledged right away */
+    gic_write32(gicd, GICD_SGIR, (1 << (16 + (mpidr & 7))) | INT_SIGNAL_SGI);
+    if (!wait_irq_pending())
+        return 0;
+
+    uint32_t iar = gic_read32(gicc, GICC_IAR);
+    gic_write32(gicc, GICC_EOIR, iar);
+
+    if ((iar & 0x3ff) != INT_SIGNAL_SGI)
+        return 0;
+
+    sgi_target = 1 << (mpidr & 7);
+    int_signal_gicc = gicc;
+
+    return 1;
+}
+
+/* INT of the m68k context was changed, make the emulation core notice */
+void ps_ipl_sgi_kick()
+{
+    if (sgi_target)
+    {
+        asm volatile("dsb sy");
+        gic_write32(gicd, GICD_SGIR, (sgi_target << 16) | INT_SIGNAL_SGI);
+    }
+}
+
+/* Ask the emulation core for a profiler sample. Returns 0 if SGIs are not available */
+int ps_ipl_sgi_sample()
+{
+#if EMU68_PROFILER
+    if (sgi_target)
+    {
+        gic_write32(gicd, GICD_SGIR, (sgi_target << 16) | INT_PROFILE_SGI);
+        return 1;
+    }
+#endif
+    return 0;
+}
+#endif
+
+#else
+
+int ps_ipl_irq_setup(volatile uint32_t *gpio, uint32_t pins, uint32_t rate)
+{
+    (void)gpio;
+    (void)pins;
+    (void)rate;
+
+    return 0;
+}
+
+void ps_ipl_irq_wait(volatile uint32_t *gpio, uint32_t pins, uint32_t current)
+{
+    (void)gpio;
+    (void)pins;
+    (void)current;
+
+    asm volatile("wfe");
+}
+
+#endif
+
+#if !(defined(__aarch64__) && PISTORM_IPL_IRQ && EMU68_ASYNC_INT)
+int ps_ipl_sgi_attach()
+{
+    return 0;
+}
+
+void ps_ipl_sgi_kick()
+{
+}
+
+int ps_ipl_sgi_sample()
+{
+    return 0;
+}
+#endif
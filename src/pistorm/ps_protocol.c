@@ -16,6 +16,7 @@
 #include "ps_protocol.h"
 #include "M68k.h"
 #include "cache.h"
+#include "trace.h"
 
 volatile unsigned int *gpio;
 volatile unsigned int *gpclk;
@@ -40,8 +41,9 @@ uint32_t CLEAR_BITS = 0;
 
 #define BITBANG_DELAY PISTORM_BITBANG_DELAY
 
-#define CHIPSET_DELAY PISTORM_CHIPSET_DELAY
-#define CIA_DELAY     PISTORM_CIA_DELAY
+/* Delays after bus accesses in timer ticks. Defaults from config, may be calibrated or set by bootargs */
+uint32_t chipset_delay = PISTORM_CHIPSET_DELAY;
+uint32_t cia_delay = PISTORM_CIA_DELAY;
 
 volatile uint8_t gpio_lock;
 
@@ -150,6 +152,74 @@ static inline void ticksleep_wfe(uint64_t ticks)
     } while(t1 < t0);
 }
 
+/* Let the bus settle after access to chipset or CIA, CIA accesses get both delays */
+static inline void bus_delay(unsigned int address)
+{
+    if (cia_delay && address >= 0xbf0000 && address <= 0xbfffff) {
+        ticksleep(cia_delay);
+    }
+    if (chipset_delay && address >= 0xa00000) {
+        ticksleep(chipset_delay);
+    }
+}
+
+/*
+    Writes of every phase are strobed with PIN_WR, reads with PIN_RD. The fast GPIO of Pi4 needs
+    the pins held for more register writes, the counts are set in ps_setup_protocol
+*/
+static uint8_t strobe_wr_set = 1;
+static uint8_t strobe_wr_clr = 1;
+static uint8_t strobe_rd = 1;
+
+static inline void ps_strobe_wr()
+{
+    for (int i=0; i < strobe_wr_set; i++)
+        *(gpio + 7) = LE32(1 << PIN_WR);
+    for (int i=0; i < strobe_wr_clr; i++)
+        *(gpio + 10) = LE32(1 << PIN_WR);
+}
+
+static inline void ps_strobe_rd()
+{
+    for (int i=0; i < strobe_rd; i++)
+        *(gpio + 7) = LE32(1 << PIN_RD);
+}
+
+#if PISTORM_POSTED_WRITES
+/* Set while a write to memory below chipset space may still run on the bus */
+static volatile uint8_t txn_posted;
+#endif
+
+/*
+    Registers of the CPLD cannot change during a bus cycle, every access waits for the previous
+    one first. A posted write has run alongside everything the Pi did since it was started
+*/
+static inline void ps_txn_wait()
+{
+#if PISTORM_POSTED_WRITES
+    if (txn_posted)
+    {
+        while (*(gpio + 13) & LE32((1 << PIN_TXN_IN_PROGRESS))) {}
+        txn_posted = 0;
+    }
+#endif
+}
+
+/* Writes below chipset space return once the cycle has started, others wait for completion */
+static inline void ps_write_done(unsigned int address)
+{
+#if PISTORM_POSTED_WRITES
+    if (address < 0xa00000)
+    {
+        txn_posted = 1;
+        return;
+    }
+#else
+    (void)address;
+#endif
+    while (*(gpio + 13) & LE32((1 << PIN_TXN_IN_PROGRESS))) {}
+}
+
 #define TXD_BIT (1 << 26)
 
 uint32_t bitbang_delay;
@@ -406,6 +476,10 @@ void ps_setup_protocol() {
     if (tmp > 20000000)
     {
         CLEAR_BITS = CLEAR_BITS_PI4;
+
+        strobe_wr_set = 3;
+        strobe_wr_clr = 2;
+        strobe_rd = 4;
         
         OUTPUT[0] = GPFSEL0_OUTPUT_PI4;
         OUTPUT[1] = GPFSEL1_OUTPUT_PI4;
@@ -441,9 +515,6 @@ static void ps_write_8_int(unsigned int address, unsigned int data);
 
 static void ps_write_16_int(unsigned int address, unsigned int data)
 {
-    uint64_t tmp;
-    tmp = pistorm_read_cntfrq();
-
 //    if (address > 0xffffff)
 //        return;
 
@@ -460,71 +531,34 @@ static void ps_write_16_int(unsigned int address, unsigned int data)
     }
     else
     {
+        ps_txn_wait();
+
         *(gpio + 0) = LE32(OUTPUT[0]);
         *(gpio + 1) = LE32(OUTPUT[1]);
         *(gpio + 2) = LE32(OUTPUT[2]);
 
         *(gpio + 7) = LE32(((data & 0xffff) << 8) | (REG_DATA << PIN_A0));
-        if (tmp > 20000000)
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
-        else
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
+        ps_strobe_wr();
         *(gpio + 10) = LE32(CLEAR_BITS);
 
         *(gpio + 7) = LE32(((address & 0xffff) << 8) | (REG_ADDR_LO << PIN_A0));
-        if (tmp > 20000000)
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
-        else
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
+        ps_strobe_wr();
         *(gpio + 10) = LE32(CLEAR_BITS);
 
         *(gpio + 7) = LE32(((0x0000 | ((address >> 16) & 0x00ff)) << 8) | (REG_ADDR_HI << PIN_A0));
-        if (tmp > 20000000)
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
-        else
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
+        ps_strobe_wr();
         *(gpio + 10) = LE32(CLEAR_BITS);
 
         *(gpio + 0) = LE32(INPUT[0]);
         *(gpio + 1) = LE32(INPUT[1]);
         *(gpio + 2) = LE32(INPUT[2]);
 
-        while (*(gpio + 13) & LE32((1 << PIN_TXN_IN_PROGRESS))) {}
+        ps_write_done(address);
     }
 }
 
 static void ps_write_8_int(unsigned int address, unsigned int data)
 {
-    uint64_t tmp;
-    tmp = pistorm_read_cntfrq();
-
 //    if (address > 0xffffff)
 //        return;
 
@@ -536,63 +570,29 @@ static void ps_write_8_int(unsigned int address, unsigned int data)
 
     data = (data & 0xff) | (data << 8);
 
+    ps_txn_wait();
+
     *(gpio + 0) = LE32(OUTPUT[0]);
     *(gpio + 1) = LE32(OUTPUT[1]);
     *(gpio + 2) = LE32(OUTPUT[2]);
 
     *(gpio + 7) = LE32(((data & 0xffff) << 8) | (REG_DATA << PIN_A0));
-    if (tmp > 20000000)
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
-    else
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
+    ps_strobe_wr();
     *(gpio + 10) = LE32(CLEAR_BITS);
 
     *(gpio + 7) = LE32(((address & 0xffff) << 8) | (REG_ADDR_LO << PIN_A0));
-    if (tmp > 20000000)
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
-    else
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
+    ps_strobe_wr();
     *(gpio + 10) = LE32(CLEAR_BITS);
 
     *(gpio + 7) = LE32(((0x0100 | ((address >> 16) & 0x00ff)) << 8) | (REG_ADDR_HI << PIN_A0));
-    if (tmp > 20000000)
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
-    else
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
+    ps_strobe_wr();
     *(gpio + 10) = LE32(CLEAR_BITS);
 
     *(gpio + 0) = LE32(INPUT[0]);
     *(gpio + 1) = LE32(INPUT[1]);
     *(gpio + 2) = LE32(INPUT[2]);
 
-    while (*(gpio + 13) & LE32((1 << PIN_TXN_IN_PROGRESS))) {}
+    ps_write_done(address);
 
 }
 
@@ -613,9 +613,6 @@ static void ps_write_32_int(unsigned int address, unsigned int value)
 
 static unsigned int ps_read_16_int_nowbwait(unsigned int address)
 {
-    uint64_t tmp;
-    tmp = pistorm_read_cntfrq();
-
     address &= 0xffffff;
 
 //    if (address > 0xffffff)
@@ -632,40 +629,18 @@ static unsigned int ps_read_16_int_nowbwait(unsigned int address)
     }
     else
     {
+        ps_txn_wait();
+
         *(gpio + 0) = LE32(OUTPUT[0]);
         *(gpio + 1) = LE32(OUTPUT[1]);
         *(gpio + 2) = LE32(OUTPUT[2]);
 
         *(gpio + 7) = LE32(((address & 0xffff) << 8) | (REG_ADDR_LO << PIN_A0));
-        if (tmp > 20000000)
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
-        else
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
+        ps_strobe_wr();
         *(gpio + 10) = LE32(CLEAR_BITS);
 
         *(gpio + 7) = LE32(((0x0200 | ((address >> 16) & 0x00ff)) << 8) | (REG_ADDR_HI << PIN_A0));
-        if (tmp > 20000000)
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
-        else
-        {
-            *(gpio + 7) = LE32(1 << PIN_WR);
-            *(gpio + 10) = LE32(1 << PIN_WR);
-        }
+        ps_strobe_wr();
         *(gpio + 10) = LE32(CLEAR_BITS);
 
         *(gpio + 0) = LE32(INPUT[0]);
@@ -673,13 +648,7 @@ static unsigned int ps_read_16_int_nowbwait(unsigned int address)
         *(gpio + 2) = LE32(INPUT[2]);
 
         *(gpio + 7) = LE32(REG_DATA << PIN_A0);
-        *(gpio + 7) = LE32(1 << PIN_RD);
-        if (tmp > 20000000)
-        {
-            *(gpio + 7) = LE32(1 << PIN_RD);
-            *(gpio + 7) = LE32(1 << PIN_RD);
-            *(gpio + 7) = LE32(1 << PIN_RD);
-        }
+        ps_strobe_rd();
 
         while (*(gpio + 13) & LE32(1 << PIN_TXN_IN_PROGRESS)) {}
         unsigned int value = LE32(*(gpio + 13));
@@ -689,9 +658,18 @@ static unsigned int ps_read_16_int_nowbwait(unsigned int address)
     }
 }
 
+#if PISTORM_WRITE_BUFFER && PISTORM_WB_FORWARD
+static int wb_forward(uint32_t address, uint8_t size, unsigned int *value);
+#endif
+
 unsigned int ps_read_16_int(unsigned int address)
 {
 #if PISTORM_WRITE_BUFFER
+#if PISTORM_WB_FORWARD
+    unsigned int fwd;
+    if (wb_forward(address, 2, &fwd))
+        return fwd;
+#endif
     wb_waitfree();
 #endif
     return ps_read_16_int_nowbwait(address);
@@ -699,10 +677,12 @@ unsigned int ps_read_16_int(unsigned int address)
 
 unsigned int ps_read_8_int(unsigned int address)
 {
-    uint64_t tmp;
-    tmp = pistorm_read_cntfrq();
-
 #if PISTORM_WRITE_BUFFER
+#if PISTORM_WB_FORWARD
+    unsigned int fwd;
+    if (wb_forward(address, 1, &fwd))
+        return fwd;
+#endif
     wb_waitfree();
 #endif
 
@@ -711,40 +691,18 @@ unsigned int ps_read_8_int(unsigned int address)
 //    if (address > 0xffffff)
 //        return 0xff;
 
+    ps_txn_wait();
+
     *(gpio + 0) = LE32(OUTPUT[0]);
     *(gpio + 1) = LE32(OUTPUT[1]);
     *(gpio + 2) = LE32(OUTPUT[2]);
 
     *(gpio + 7) = LE32(((address & 0xffff) << 8) | (REG_ADDR_LO << PIN_A0));
-    if (tmp > 20000000)
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
-    else
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
+    ps_strobe_wr();
     *(gpio + 10) = LE32(CLEAR_BITS);
 
     *(gpio + 7) = LE32(((0x0300 | ((address >> 16) & 0x00ff)) << 8) | (REG_ADDR_HI << PIN_A0));
-    if (tmp > 20000000)
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
-    else
-    {
-        *(gpio + 7) = LE32(1 << PIN_WR);
-        *(gpio + 10) = LE32(1 << PIN_WR);
-    }
+    ps_strobe_wr();
     *(gpio + 10) = LE32(CLEAR_BITS);
 
     *(gpio + 0) = LE32(INPUT[0]);
@@ -752,13 +710,7 @@ unsigned int ps_read_8_int(unsigned int address)
     *(gpio + 2) = LE32(INPUT[2]);
 
     *(gpio + 7) = LE32(REG_DATA << PIN_A0);
-    *(gpio + 7) = LE32(1 << PIN_RD);
-    if (tmp > 20000000)
-    {
-        *(gpio + 7) = LE32(1 << PIN_RD);
-        *(gpio + 7) = LE32(1 << PIN_RD);
-        *(gpio + 7) = LE32(1 << PIN_RD);
-    }
+    ps_strobe_rd();
 
     while (*(gpio + 13) & LE32(1 << PIN_TXN_IN_PROGRESS)) {}
     unsigned int value = LE32(*(gpio + 13));
@@ -776,6 +728,11 @@ unsigned int ps_read_8_int(unsigned int address)
 unsigned int ps_read_32_int(unsigned int address)
 {
 #if PISTORM_WRITE_BUFFER
+#if PISTORM_WB_FORWARD
+    unsigned int fwd;
+    if (wb_forward(address, 4, &fwd))
+        return fwd;
+#endif
     wb_waitfree();
 #endif
 
@@ -800,6 +757,8 @@ void ps_write_status_reg(unsigned int value)
     uint64_t tmp;
     tmp = pistorm_read_cntfrq();
 
+    ps_txn_wait();
+
     *(gpio + 0) = LE32(OUTPUT[0]);
     *(gpio + 1) = LE32(OUTPUT[1]);
     *(gpio + 2) = LE32(OUTPUT[2]);
@@ -831,6 +790,8 @@ unsigned int ps_read_status_reg()
     uint64_t tmp;
     tmp = pistorm_read_cntfrq();
 
+    ps_txn_wait();
+
     *(gpio + 7) = LE32(REG_STATUS << PIN_A0);
     *(gpio + 7) = LE32(1 << PIN_RD);
     *(gpio + 7) = LE32(1 << PIN_RD);
@@ -890,6 +851,11 @@ unsigned int ps_get_ipl_zero()
     return value & LE32(1 << PIN_IPL_ZERO);
 }
 
+int ps_reset_active()
+{
+    return (LE32(*(gpio + 13)) & (1 << PIN_RESET)) == 0;
+}
+
 #define INT2_ENABLED 1
 
 #define PM_RSTC         ((volatile unsigned int*)(0xf2000000 + 0x0010001c))
@@ -899,8 +865,35 @@ unsigned int ps_get_ipl_zero()
 #define PM_RSTC_FULLRST 0x00000020
 
 volatile int housekeeper_enabled = 0;
+volatile int ps_warm_reset = 0;
+volatile int ps_reset_self = 0;
+
+/* IPL and reset lines wake the housekeeper */
+#define HKEEP_PINS      ((1 << PIN_IPL_ZERO) | (1 << PIN_RESET))
 extern struct M68KState *__m68k_state;
 
+#if PISTORM_WARM_RESET
+/*
+    Reset line went low and warm reset is enabled. Unless the line is pulsed by Emu68 itself,
+    the emulation core is asked to restart the m68k. Housekeeper waits until the core is done
+    and the line is released again.
+*/
+static void ps_hkeep_warm_reset()
+{
+    if (!ps_reset_self && !__m68k_state->INT.RESET)
+    {
+        kprintf("[HKEEP] Reset line active, restarting m68k\n");
+
+        __m68k_state->INT.RESET = 1;
+        asm volatile("sev":::"memory");
+        ps_ipl_sgi_kick();
+    }
+
+    while (__m68k_state->INT.RESET || ps_reset_active())
+        usleep(1000);
+}
+#endif
+
 void ps_housekeeper() 
 {
     if (!gpio)
@@ -916,35 +909,59 @@ void ps_housekeeper()
     (void)last_arm_cnt;
 
     kprintf("[HKEEP] Housekeeper activated\n");
-    kprintf("[HKEEP] Please note we are burning the cpu with busyloops now\n");
 
-    /* Configure timer-based event stream */
-    /* Enable timer regs from EL0, enable event stream on posedge, monitor 2th bit */
-    /* This gives a frequency of 2.4MHz for a 19.2MHz timer */
-    uint64_t tmp;
-    tmp = pistorm_read_cntfrq();
+    /* Configure timer-based event stream, used for polling if edge interrupt is not available */
+    pistorm_write_cntkctl(ps_hkeep_cntkctl(pistorm_read_cntfrq()));
 
-    if (tmp > 20000000)
-    {
-        pistorm_write_cntkctl(3 | (1 << 2) | (3 << 8) | (3 << 4));
-    }
+    int ipl_irq = ps_ipl_irq_setup(gpio, HKEEP_PINS, PISTORM_IPL_IRQ_POLL_HZ);
+
+    if (ipl_irq)
+        kprintf("[HKEEP] Waiting for IPL edges, fallback wakeup at %d Hz\n", PISTORM_IPL_IRQ_POLL_HZ);
     else
-    {
-        pistorm_write_cntkctl(3 | (1 << 2) | (3 << 8) | (2 << 4));
-    }
+        kprintf("[HKEEP] Polling IPL at %d Hz, please note we are burning the cpu with busyloops now\n", PISTORM_HKEEP_POLL_HZ);
 
     for(;;) {
         if (housekeeper_enabled)
         {
             uint32_t pin = LE32(*(gpio + 13));
+            uint8_t ipl_prev = __m68k_state->INT.IPL;
+
             __m68k_state->INT.IPL = (pin & (1 << PIN_IPL_ZERO)) ? 0 : 1;
 
             asm volatile("":::"memory");
 
+            if (__m68k_state->INT.IPL != ipl_prev)
+                Trace(TRACE_IPL_CHANGE, ipl_prev, __m68k_state->INT.IPL, 0, 0);
+
             if (__m68k_state->INT.IPL)
+            {
+#if PISTORM_STOP_WAKE
+                /* Level is not known here, event for any STOP waiting, none for wfe of this loop */
+                asm volatile("dmb ish":::"memory");
+
+                if (m68k_stop_level != 0xff)
+                {
+                    if (m68k_stop_event == 0)
+                        m68k_stop_event = pistorm_read_cntpct();
+                    asm volatile("sev":::"memory");
+                }
+#else
                 asm volatile("sev":::"memory");
+#endif
+
+                /* IPL went active, chained code on the emulation core has to notice it */
+                if (ipl_prev == 0)
+                    ps_ipl_sgi_kick();
+            }
 
             if ((pin & (1 << PIN_RESET)) == 0) {
+#if PISTORM_WARM_RESET
+                if (ps_warm_reset)
+                {
+                    ps_hkeep_warm_reset();
+                    continue;
+                }
+#endif
                 kprintf("[HKEEP] Houskeeper will reset RasPi now...\n");
 
                 unsigned int r;
@@ -957,6 +974,13 @@ void ps_housekeeper()
                 while(1);
             }
 
+            /* Sleep until next edge on IPL or reset line */
+            if (ipl_irq)
+            {
+                ps_ipl_irq_wait(gpio, HKEEP_PINS, pin & HKEEP_PINS);
+                continue;
+            }
+
             /*
               Wait for event. It can happen that the CPU is flooded with them for some reason, but
               nevertheless, thanks for the event stream set up above, they will appear at 1.2MHz in worst case
@@ -970,80 +994,198 @@ void ps_housekeeper()
 
 #define WRITEBUFFER_SIZE  PISTORM_WRITE_BUFFER_SIZE
 
+#if (WRITEBUFFER_SIZE & (WRITEBUFFER_SIZE - 1)) != 0
+#error PISTORM_WRITE_BUFFER_SIZE shall be a power of two
+#endif
+
 struct WriteRequest {
     uint32_t  wr_addr;
     uint32_t  wr_value;
     uint8_t   wr_size;
 };
 
+/*
+    Single producer, single consumer ring. Only the CPU running m68k code advances the head,
+    only the write buffer task advances the tail. Both indices live in separate cache lines,
+    so that the two CPUs do not steal the line from each other on every entry.
+*/
+struct WriteRing {
+    volatile uint32_t   wr_head;
+    uint8_t             wr_pad0[60];
+    volatile uint32_t   wr_tail;
+    uint8_t             wr_pad1[60];
+};
+
 struct WriteRequest *wr_buffer;
-volatile uint32_t wr_head;
-volatile uint32_t wr_tail;
-volatile unsigned char bus_lock = 0;
+static struct WriteRing wr_ring __attribute__((aligned(64)));
+/* Taken by both the m68k CPU and the write buffer task, kept off the lines of the ring */
+volatile unsigned char bus_lock __attribute__((aligned(64))) = 0;
 
 void wb_push(uint32_t address, uint32_t value, uint8_t size)
 {
-    while(wr_tail + WRITEBUFFER_SIZE <= wr_head)
-        asm volatile("yield");
-    
-    wr_buffer[wr_head & (WRITEBUFFER_SIZE - 1)].wr_addr = address;
-    wr_buffer[wr_head & (WRITEBUFFER_SIZE - 1)].wr_value = value;
-    wr_buffer[wr_head & (WRITEBUFFER_SIZE - 1)].wr_size = size;
+    uint32_t head = wr_ring.wr_head;
 
-    asm volatile("dmb sy":::"memory");
-
-    __sync_add_and_fetch(&wr_head, 1);
-    
-    asm volatile("sev");
-}
+    if (head - __atomic_load_n(&wr_ring.wr_tail, __ATOMIC_ACQUIRE) >= WRITEBUFFER_SIZE)
+    {
+        Trace(TRACE_WB_FULL, address, value, size, 0);
 
-struct WriteRequest wb_pop()
-{
-    while (wr_tail == wr_head) {
-        asm volatile("wfe");
+        while(head - __atomic_load_n(&wr_ring.wr_tail, __ATOMIC_ACQUIRE) >= WRITEBUFFER_SIZE)
+            asm volatile("yield");
     }
-
-    struct WriteRequest data = wr_buffer[wr_tail & (WRITEBUFFER_SIZE - 1)];
-
-    __sync_add_and_fetch(&wr_tail, 1);
     
-    return data;
-}
-
-struct WriteRequest wb_peek()
-{
-    while (wr_tail == wr_head) {
-        asm volatile("wfe");
-    }
+    wr_buffer[head & (WRITEBUFFER_SIZE - 1)].wr_addr = address;
+    wr_buffer[head & (WRITEBUFFER_SIZE - 1)].wr_value = value;
+    wr_buffer[head & (WRITEBUFFER_SIZE - 1)].wr_size = size;
 
-    struct WriteRequest data = wr_buffer[wr_tail & (WRITEBUFFER_SIZE - 1)];
+    __atomic_store_n(&wr_ring.wr_head, head + 1, __ATOMIC_SEQ_CST);
 
-    return data;
+    /* The task sleeps in wfe only after it found the ring empty, wake it up in that case only */
+    if (__atomic_load_n(&wr_ring.wr_tail, __ATOMIC_SEQ_CST) == head)
+        asm volatile("sev");
 }
 
 void wb_wait()
 {
-    while (wr_tail == wr_head) {
+    while (__atomic_load_n(&wr_ring.wr_head, __ATOMIC_SEQ_CST) == wr_ring.wr_tail) {
         asm volatile("wfe");
     }
 }
 
 void wb_waitfree()
 {
-    while (wr_tail != wr_head)
+    while (__atomic_load_n(&wr_ring.wr_tail, __ATOMIC_ACQUIRE) != wr_ring.wr_head)
         asm volatile("yield");
 }
+
+#if PISTORM_WB_FORWARD
+/*
+    Answer a read of CHIP RAM from writes still queued in the buffer. Only the queue owner
+    calls it, so the entries between tail and head cannot be overwritten meanwhile. All bytes
+    have to be covered by the most recent PISTORM_WB_FORWARD_DEPTH entries, otherwise the
+    caller waits for the buffer to drain and reads the bus. Returns 1 if value was forwarded.
+*/
+static int wb_forward(uint32_t address, uint8_t size, unsigned int *value)
+{
+    uint32_t head = wr_ring.wr_head;
+    uint32_t tail = __atomic_load_n(&wr_ring.wr_tail, __ATOMIC_ACQUIRE);
+    uint32_t needed = (1 << size) - 1;
+    uint32_t result = 0;
+
+    /* Registers have side effects, only plain CHIP RAM can be forwarded */
+    if (head == tail || address + size > 0x200000)
+        return 0;
+
+    if (head - tail > PISTORM_WB_FORWARD_DEPTH)
+        tail = head - PISTORM_WB_FORWARD_DEPTH;
+
+    while (needed && head != tail)
+    {
+        struct WriteRequest *req = &wr_buffer[--head & (WRITEBUFFER_SIZE - 1)];
+
+        if (req->wr_addr >= address + size || req->wr_addr + req->wr_size <= address)
+            continue;
+
+        /* Newest write of every byte wins, bytes are stored big endian */
+        for (int i=0; i < size; i++)
+        {
+            uint32_t a = address + i;
+
+            if ((needed & (1 << i)) && a >= req->wr_addr && a < req->wr_addr + req->wr_size)
+            {
+                uint8_t b = req->wr_value >> (8 * (req->wr_addr + req->wr_size - 1 - a));
+
+                result |= (uint32_t)b << (8 * (size - 1 - i));
+                needed &= ~(1 << i);
+            }
+        }
+    }
+
+    if (needed)
+        return 0;
+
+    *value = result;
+
+    return 1;
+}
+#endif
 #endif
 
 void wb_init()
 {
 #if PISTORM_WRITE_BUFFER
     wr_buffer = tlsf_malloc(tlsf, sizeof(struct WriteRequest) * WRITEBUFFER_SIZE);
-    wr_head = wr_tail = 0;
+    wr_ring.wr_head = wr_ring.wr_tail = 0;
     bus_lock = 0;
 #endif
 }
 
+#if PISTORM_BLIT_PREDICT
+/* Earliest end of the last blit started by the CPU, in CNTPCT ticks */
+static uint64_t blit_end;
+static uint32_t blit_freq;
+static uint16_t blit_con0;
+static uint16_t blit_con1;
+static uint16_t blit_sizv;
+
+/* Blitter cycles per word with the channels enabled in BLTCON0, USEA to USED in bits 3 to 0 */
+static const uint8_t blit_cycles[16] = { 2, 2, 2, 3, 3, 3, 3, 4, 2, 2, 2, 3, 3, 3, 3, 4 };
+
+static inline void blit_predict_word(unsigned int addr, uint16_t value)
+{
+    uint64_t words;
+    uint32_t cycles;
+
+    switch (addr)
+    {
+        case 0xdff040:
+            blit_con0 = value;
+            return;
+        case 0xdff042:
+            blit_con1 = value;
+            return;
+        case 0xdff058:
+            words = ((value >> 6) ? (value >> 6) : 1024) * ((value & 0x3f) ? (value & 0x3f) : 64);
+            break;
+        case 0xdff05c:
+            blit_sizv = value & 0x7fff;
+            return;
+        case 0xdff05e:
+            words = (blit_sizv ? blit_sizv : 0x8000) * ((value & 0x7ff) ? (value & 0x7ff) : 0x800);
+            break;
+        default:
+            return;
+    }
+
+    /* Fastest case without any other DMA, line mode is never faster than two cycles a word */
+    cycles = (blit_con1 & 1) ? 2 : blit_cycles[(blit_con0 >> 8) & 15];
+
+    if (blit_freq == 0)
+        blit_freq = pistorm_read_cntfrq();
+
+    blit_end = pistorm_read_cntpct() + (words * cycles * blit_freq) / PISTORM_BLIT_CCK_HZ;
+}
+
+/* Follow writes to BLTCON0/1 and the start of blits, only word and long writes are seen */
+static inline void blit_predict(unsigned int addr, unsigned int size, unsigned int value)
+{
+    if (!__m68k_state || !(__m68k_state->JIT_CONTROL2 & JC2F_BLITWAIT))
+        return;
+
+    addr &= 0xffffff;
+
+    if (addr < 0xdff040 || addr >= 0xdff060)
+        return;
+
+    if (size == 2)
+        blit_predict_word(addr, value);
+    else if (size == 4)
+    {
+        blit_predict_word(addr, value >> 16);
+        blit_predict_word(addr + 2, value & 0xffff);
+    }
+}
+#endif
+
 static inline void check_blit_active(unsigned int addr, unsigned int size)
 {
     if (!__m68k_state || !(__m68k_state->JIT_CONTROL2 & JC2F_BLITWAIT))
@@ -1057,6 +1199,11 @@ static inline void check_blit_active(unsigned int addr, unsigned int size)
         return;
 
     const uint16_t mask = 1<<14 | 1<<9 | 1<<6; // BBUSY | DMAEN | BLTEN
+#if PISTORM_BLIT_PREDICT
+    /* Blit is not over before its predicted end, polling earlier only steals cycles from it */
+    while ((int64_t)(blit_end - pistorm_read_cntpct()) > 0)
+        asm volatile("yield");
+#endif
     while ((ps_read_16_int_nowbwait(0xdff002) & mask) == mask) {
         // Dummy reads to not steal too many cycles from the blitter.
         // But don't use e.g. CIA reads as we expect the operation
@@ -1066,42 +1213,79 @@ static inline void check_blit_active(unsigned int addr, unsigned int size)
     }
 }
 
+#if PISTORM_WRITE_BUFFER
+static inline uint32_t wb_mask(uint8_t size)
+{
+    return (size == 4) ? 0xffffffff : (1U << (8 * size)) - 1;
+}
+
+/* Perform one, possibly merged, write request on the bus */
+static void wb_write(struct WriteRequest *req)
+{
+    check_blit_active(req->wr_addr, req->wr_size);
+
+    switch (req->wr_size) {
+        case 1:
+            ps_write_8_int(req->wr_addr, req->wr_value);
+            break;
+        case 2:
+            ps_write_16_int(req->wr_addr, req->wr_value);
+            break;
+        case 4:
+            ps_write_32_int(req->wr_addr, req->wr_value);
+            break;
+    }
+#if PISTORM_BLIT_PREDICT
+    blit_predict(req->wr_addr, req->wr_size, req->wr_value);
+#endif
+    bus_delay(req->wr_addr);
+}
+#endif
+
 void wb_task()
 {
 #if PISTORM_WRITE_BUFFER
     kprintf("[WBACK] Write buffer activated\n");
 
     while(1) {
-        struct WriteRequest req = wb_peek();
+        wb_wait();
 
         while(__atomic_test_and_set(&bus_lock, __ATOMIC_ACQUIRE)) { asm volatile("yield"); }
 
-        check_blit_active(req.wr_addr, req.wr_size);
-
-        switch (req.wr_size) {
-            case 1:
-                ps_write_8_int(req.wr_addr, req.wr_value);
-                break;
-            case 2:
-                ps_write_16_int(req.wr_addr, req.wr_value);
-                break;
-            case 4:
-                ps_write_32_int(req.wr_addr, req.wr_value);
-                break;
-        }
-#if CIA_DELAY
-        if (req.wr_addr >= 0xbf0000 && req.wr_addr <= 0xbfffff) {
-            ticksleep(CIA_DELAY);
-        }
-#endif
-#if CHIPSET_DELAY
-        if (req.wr_addr >= 0xa00000) {
-            ticksleep(CHIPSET_DELAY);
+        /* Drain everything queued so far under one lock acquisition */
+        uint32_t head = __atomic_load_n(&wr_ring.wr_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = wr_ring.wr_tail;
+
+        while (tail != head)
+        {
+            struct WriteRequest req = wr_buffer[tail & (WRITEBUFFER_SIZE - 1)];
+
+            tail++;
+
+            /*
+                Adjacent writes to memory below chipset space, which together form an aligned
+                word or longword, are merged. Two byte writes become a single word bus cycle.
+                Chipset and CIA registers are always written exactly as requested.
+            */
+            while (tail != head && req.wr_addr < 0xa00000)
+            {
+                struct WriteRequest *next = &wr_buffer[tail & (WRITEBUFFER_SIZE - 1)];
+                uint8_t size = req.wr_size + next->wr_size;
+
+                if (next->wr_addr != req.wr_addr + req.wr_size || (size != 2 && size != 4) || (req.wr_addr & (size - 1)))
+                    break;
+
+                req.wr_value = ((req.wr_value & wb_mask(req.wr_size)) << (8 * next->wr_size)) | (next->wr_value & wb_mask(next->wr_size));
+                req.wr_size = size;
+                tail++;
+            }
+
+            wb_write(&req);
+
+            __atomic_store_n(&wr_ring.wr_tail, tail, __ATOMIC_SEQ_CST);
         }
-#endif
-        __atomic_clear(&bus_lock, __ATOMIC_RELEASE);
 
-        wb_pop();
+        __atomic_clear(&bus_lock, __ATOMIC_RELEASE);
     }
 #else
     while(1) asm volatile("wfi");
@@ -1121,16 +1305,7 @@ void ps_write_8(unsigned int address, unsigned int data)
     }
 #else
     ps_write_8_int(address, data);
-#if CIA_DELAY
-    if (address >= 0xbf0000 && address <= 0xbfffff) {
-        ticksleep(CIA_DELAY);
-    }
-#endif
-#if CHIPSET_DELAY
-    if (address >= 0xa00000) {
-        ticksleep(CHIPSET_DELAY);
-    }
-#endif
+    bus_delay(address);
 #endif
     cache_invalidate_range(ICACHE, address, 1);
 }
@@ -1149,16 +1324,10 @@ void ps_write_16(unsigned int address, unsigned int data)
 #else
     check_blit_active(address, 2);
     ps_write_16_int(address, data);
-#if CIA_DELAY
-    if (address >= 0xbf0000 && address <= 0xbfffff) {
-        ticksleep(CIA_DELAY);
-    }
-#endif
-#if CHIPSET_DELAY
-    if (address >= 0xa00000) {
-        ticksleep(CHIPSET_DELAY);
-    }
+#if PISTORM_BLIT_PREDICT
+    blit_predict(address, 2, data);
 #endif
+    bus_delay(address);
 #endif
     cache_invalidate_range(ICACHE, address, 2);
 }
@@ -1177,16 +1346,10 @@ void ps_write_32(unsigned int address, unsigned int data)
 #else
     check_blit_active(address, 4);
     ps_write_32_int(address, data);
-#if CIA_DELAY
-    if (address >= 0xbf0000 && address <= 0xbfffff) {
-        ticksleep(CIA_DELAY);
-    }
-#endif
-#if CHIPSET_DELAY
-    if (address >= 0xa00000) {
-        ticksleep(CHIPSET_DELAY);
-    }
+#if PISTORM_BLIT_PREDICT
+    blit_predict(address, 4, data);
 #endif
+    bus_delay(address);
 #endif
     cache_invalidate_range(ICACHE, address, 4);
 }
@@ -1211,16 +1374,7 @@ unsigned int ps_read_8(unsigned int address)
 {
     int val = ps_read_8_int(address);
 
-#if CIA_DELAY
-    if (address >= 0xbf0000 && address <= 0xbfffff) {
-        ticksleep(CIA_DELAY);
-    }
-#endif
-#if CHIPSET_DELAY
-    if (address >= 0xa00000) {
-        ticksleep(CHIPSET_DELAY);
-    }
-#endif
+    bus_delay(address);
 #ifndef __aarch64__
     val = pistorm_finalize_protocol_read(address, (uint32_t)val, 1);
 #endif
@@ -1230,16 +1384,7 @@ unsigned int ps_read_8(unsigned int address)
 unsigned int ps_read_16(unsigned int address)
 {
     int val = ps_read_16_int(address);
-#if CIA_DELAY
-    if (address >= 0xbf0000 && address <= 0xbfffff) {
-        ticksleep(CIA_DELAY);
-    }
-#endif
-#if CHIPSET_DELAY
-    if (address >= 0xa00000) {
-        ticksleep(CHIPSET_DELAY);
-    }
-#endif
+    bus_delay(address);
 #ifndef __aarch64__
     val = pistorm_finalize_protocol_read(address, (uint32_t)val, 2);
 #endif
@@ -1249,16 +1394,7 @@ unsigned int ps_read_16(unsigned int address)
 unsigned int ps_read_32(unsigned int address)
 {
     int val = ps_read_32_int(address);
-#if CIA_DELAY
-    if (address >= 0xbf0000 && address <= 0xbfffff) {
-        ticksleep(CIA_DELAY);
-    }
-#endif
-#if CHIPSET_DELAY
-    if (address >= 0xa00000) {
-        ticksleep(CHIPSET_DELAY);
-    }
-#endif
+    bus_delay(address);
 #ifndef __aarch64__
     val = pistorm_finalize_protocol_read(address, (uint32_t)val, 4);
 #endif
@@ -1293,6 +1429,23 @@ uint128_t ps_read_128(unsigned int address)
     return res;
 }
 
+/*
+    Copy size bytes (multiple of 2) of slow memory without side effects, e.g. ROM, from the
+    bus. The write buffer is drained once, the words are fetched back to back without bus
+    delays and forwarding lookups
+*/
+void ps_read_block(unsigned int address, void *dst, unsigned int size)
+{
+    uint16_t *d = dst;
+
+#if PISTORM_WRITE_BUFFER
+    wb_waitfree();
+#endif
+
+    for (unsigned int i=0; i < size; i+=2)
+        *d++ = ps_read_16_int_nowbwait(address + i);
+}
+
 void put_char(uint8_t c);
 void putByte(void *io_base, char chr);
 
@@ -1467,3 +1620,109 @@ void ps_buptest(unsigned int test_size, unsigned int maxiter)
 
     tlsf_free(tlsf, garbage);
 }
+
+/*
+    Bus timing calibration. For every region class the delay is lowered from the default
+    until accesses start to fail, the smallest delay which passes all rounds plus a margin
+    is used. Chipset is tested with writes to COLOR00 followed by reads of the Agnus ID in
+    VPOSR and by CHIP RAM access right after, CIA with write and read back of the parallel
+    port direction register.
+*/
+
+#define CAL_CHIP_WORD   0x1000
+#define CAL_COLOR00     0xdff180
+#define CAL_VPOSR       0xdff004
+#define CAL_CIAA_DDRB   0xbfe301
+
+static int cal_chipset_round(unsigned int iterations, uint32_t id)
+{
+    for (unsigned int i=0; i < iterations; i++)
+    {
+        uint16_t v = rnd();
+
+        ps_write_16(CAL_COLOR00, 0);
+        if ((BE16(ps_read_16(CAL_VPOSR)) & 0x7f00) != id)
+            return 0;
+
+        ps_write_16(CAL_CHIP_WORD, BE16(v));
+        if (BE16(ps_read_16(CAL_CHIP_WORD)) != v)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int cal_cia_round(unsigned int iterations, uint32_t unused)
+{
+    int ok = 1;
+
+    (void)unused;
+
+    for (unsigned int i=0; i < iterations && ok; i++)
+    {
+        uint8_t v = rnd();
+
+        ps_write_8(CAL_CIAA_DDRB, v);
+        if ((ps_read_8(CAL_CIAA_DDRB) & 0xff) != v)
+            ok = 0;
+    }
+
+    /* Parallel port back to inputs */
+    ps_write_8(CAL_CIAA_DDRB, 0);
+
+    return ok;
+}
+
+/* Find smallest delay up to 4 times the default passing two rounds of the test */
+static uint32_t cal_search(uint32_t *delay, uint32_t def, int (*round)(unsigned int, uint32_t), unsigned int iterations, uint32_t arg)
+{
+    uint32_t limit = def ? 4 * def : 4;
+
+    for (uint32_t d = 0; d <= limit; d++)
+    {
+        *delay = d;
+
+        if (round(iterations, arg) && round(iterations, arg))
+        {
+            /* Margin of 25% on top, but never slower than a default known to work */
+            uint32_t result = d + (d + 3) / 4;
+
+            if (d <= def && result > def)
+                result = def;
+
+            return result;
+        }
+
+        ps_reset_state_machine();
+    }
+
+    return 0xffffffff;
+}
+
+void ps_calibrate_delays(unsigned int iterations)
+{
+    uint32_t id, result;
+
+    kprintf("[PSTIME] Calibrating bus delays, %d accesses per round\n", iterations);
+
+    /* Reference Agnus ID read with the conservative default delays */
+    chipset_delay = PISTORM_CHIPSET_DELAY;
+    cia_delay = PISTORM_CIA_DELAY;
+    id = BE16(ps_read_16(CAL_VPOSR)) & 0x7f00;
+
+    if (!cal_chipset_round(iterations, id))
+    {
+        kprintf("[PSTIME] Bus not reliable with default delays, calibration skipped\n");
+        return;
+    }
+
+    result = cal_search(&chipset_delay, PISTORM_CHIPSET_DELAY, cal_chipset_round, iterations, id);
+    chipset_delay = (result == 0xffffffff) ? PISTORM_CHIPSET_DELAY : result;
+
+    /* CIA accesses get the chipset delay too, it has to be final already */
+    result = cal_search(&cia_delay, PISTORM_CIA_DELAY, cal_cia_round, iterations, 0);
+    cia_delay = (result == 0xffffffff) ? PISTORM_CIA_DELAY : result;
+
+    kprintf("[PSTIME] Chipset delay %d (default %d), CIA delay %d (default %d) ticks\n",
+        chipset_delay, PISTORM_CHIPSET_DELAY, cia_delay, PISTORM_CIA_DELAY);
+}
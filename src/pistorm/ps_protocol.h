@@ -89,6 +89,7 @@ unsigned int ps_read_16(unsigned int address);
 unsigned int ps_read_32(unsigned int address);
 uint64_t ps_read_64(unsigned int address);
 uint128_t ps_read_128(unsigned int address);
+void ps_read_block(unsigned int address, void *dst, unsigned int size);
 
 void ps_write_8(unsigned int address, unsigned int data);
 void ps_write_16(unsigned int address, unsigned int data);
@@ -97,6 +98,8 @@ void ps_write_64(unsigned int address, uint64_t data);
 void ps_write_128(unsigned int address, uint128_t data);
 
 void ps_buptest(unsigned int size_kb, unsigned int maxiter);
+void ps_busbench(unsigned int count);
+void ps_calibrate_delays(unsigned int iterations);
 
 unsigned int ps_read_status_reg();
 void ps_write_status_reg(unsigned int value);
@@ -110,6 +113,17 @@ void fastSerial_putByte(uint8_t byte);
 void fastSerial_init();
 void ps_housekeeper();
 unsigned int ps_get_ipl_zero();
+int ps_reset_active();
+
+extern volatile int ps_warm_reset;
+extern volatile int ps_reset_self;
+
+uint32_t ps_hkeep_cntkctl(uint32_t freq);
+int ps_ipl_irq_setup(volatile uint32_t *gpio, uint32_t pins, uint32_t rate);
+void ps_ipl_irq_wait(volatile uint32_t *gpio, uint32_t pins, uint32_t current);
+int ps_ipl_sgi_attach();
+void ps_ipl_sgi_kick();
+int ps_ipl_sgi_sample();
 
 void wb_task();
 void wb_init();
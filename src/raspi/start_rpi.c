@@ -2732,29 +2732,19 @@ static int pistorm_service_pending_interrupt(struct M68KState *ctx)
 /* Amiga checksum, taken from the AArch64 startup path. */
 static int amiga_checksum(uint8_t *mem, uintptr_t size, uintptr_t chkoff, int update)
 {
-    uint32_t oldcksum = 0, cksum = 0, prevck = 0;
-    uintptr_t i;
+    uint32_t oldcksum = 0, cksum;
+    uint64_t sum = sum_be32(mem, size);
 
-    for (i = 0; i < size; i += 4)
+    if (update)
     {
-        uint32_t val = (mem[i + 0] << 24) |
-                       (mem[i + 1] << 16) |
-                       (mem[i + 2] << 8) |
-                       (mem[i + 3] << 0);
-
-        if (update && (i == chkoff))
-        {
-            oldcksum = val;
-            val = 0;
-        }
-
-        cksum += val;
-        if (cksum < prevck)
-            cksum++;
-        prevck = cksum;
+        oldcksum = (mem[chkoff + 0] << 24) | (mem[chkoff + 1] << 16) | (mem[chkoff + 2] << 8) | mem[chkoff + 3];
+        sum -= oldcksum;
     }
 
-    cksum = ~cksum;
+    while (sum >> 32)
+        sum = (sum & 0xffffffff) + (sum >> 32);
+
+    cksum = ~(uint32_t)sum;
 
     if (update && cksum != oldcksum)
     {
@@ -3144,11 +3134,22 @@ void boot(uintptr_t dummy, uintptr_t arch, uintptr_t atags, uintptr_t dummy2)
         }
     }
 
-    if (get_max_clock_rate(3) != get_clock_rate(3)) {
-        kprintf("[BOOT] Changing ARM clock rate from %d MHz to %d MHz\n", get_clock_rate(3)/1000000, get_max_clock_rate(3)/1000000);
-        set_clock_rate(3, get_max_clock_rate(3));
+    uint32_t arm_clock = 3;
+
+    /* Current and maximal rate in one firmware round trip */
+    mbox_batch_begin();
+    int pos_arm = mbox_batch_add(VCTAG_GET_CLOCK_RATE, 2, &arm_clock, 1);
+    int pos_arm_max = mbox_batch_add(VCTAG_GET_MAX_CLOCK_RATE, 2, &arm_clock, 1);
+    mbox_batch_submit(1);
+
+    uint32_t arm_rate = mbox_batch_value(pos_arm + 1);
+    uint32_t arm_max = mbox_batch_value(pos_arm_max + 1);
+
+    if (arm_max != arm_rate) {
+        kprintf("[BOOT] Changing ARM clock rate from %d MHz to %d MHz\n", arm_rate/1000000, arm_max/1000000);
+        set_clock_rate(3, arm_max);
     } else {
-        kprintf("[BOOT] ARM Clock at %d MHz\n", get_clock_rate(3) / 1000000);
+        kprintf("[BOOT] ARM Clock at %d MHz\n", arm_rate / 1000000);
     }
 
     display_logo();
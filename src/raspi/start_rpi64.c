@@ -92,45 +92,17 @@ static void __putc(void *data, char c)
     put_char(c);
 }
 
-void display_logo()
+/* Clear the screen and draw the logo. Runs as boot job on a secondary CPU if one is free */
+static void draw_logo(void *arg)
 {
-    struct Size sz = get_display_size();
-    uint32_t start_x, start_y;
+    uint32_t start_x = (fb_width - EmuLogo.el_Width) / 2;
+    uint32_t start_y = (fb_height - EmuLogo.el_Height) / 2;
     uint16_t *buff;
     int32_t pix_cnt = (uint32_t)EmuLogo.el_Width * (uint32_t)EmuLogo.el_Height;
     uint8_t *rle = EmuLogo.el_Data;
     int x = 0;
-    of_node_t *e = NULL;
 
-    e = dt_find_node("/chosen");
-    if (e)
-    {
-        of_property_t * prop = dt_find_property(e, "bootargs");
-        if (prop)
-        {
-            const char *tok;
-            if ((tok = find_token(prop->op_value, "logo=")))
-            {
-                tok += 5;
-
-                if (strncmp(tok, "purple", 6) == 0)
-                    purple = 1;
-                else if (strncmp(tok, "black", 5) == 0)
-                    black = 1;
-            }
-        }
-    }
-
-    kprintf("[BOOT] Display size is %dx%d\n", sz.width, sz.height);
-    fb_width = sz.width;
-    fb_height = sz.height;
-    init_display(sz, (void**)&framebuffer, &pitch);
-    kprintf("[BOOT] Framebuffer @ %08x\n", framebuffer);
-
-    start_x = (sz.width - EmuLogo.el_Width) / 2;
-    start_y = (sz.height - EmuLogo.el_Height) / 2;
-
-    kprintf("[BOOT] Logo start coordinate: %dx%d, size: %dx%d\n", start_x, start_y, EmuLogo.el_Width, EmuLogo.el_Height);
+    (void)arg;
 
     /* Calculate text coordinate for version string */
     text_y = (fb_height - 16 - 5) / 16;
@@ -167,7 +139,7 @@ void display_logo()
             color = (gray >> 3) | ((gray >> 2) << 5) | ((gray >> 3) << 11);
         }
 
-        for (int i=0; i < sz.width * sz.height; i++)
+        for (uint32_t i=0; i < fb_width * fb_height; i++)
             framebuffer[i] = LE16(color);
     }
 
@@ -230,6 +202,45 @@ void display_logo()
     text_y = 0;
 }
 
+void display_logo()
+{
+    struct Size sz = get_display_size();
+    uint32_t start_x, start_y;
+    of_node_t *e = NULL;
+
+    e = dt_find_node("/chosen");
+    if (e)
+    {
+        of_property_t * prop = dt_find_property(e, "bootargs");
+        if (prop)
+        {
+            const char *tok;
+            if ((tok = find_token(prop->op_value, "logo=")))
+            {
+                tok += 5;
+
+                if (strncmp(tok, "purple", 6) == 0)
+                    purple = 1;
+                else if (strncmp(tok, "black", 5) == 0)
+                    black = 1;
+            }
+        }
+    }
+
+    kprintf("[BOOT] Display size is %dx%d\n", sz.width, sz.height);
+    fb_width = sz.width;
+    fb_height = sz.height;
+    init_display(sz, (void**)&framebuffer, &pitch);
+    kprintf("[BOOT] Framebuffer @ %08x\n", framebuffer);
+
+    start_x = (sz.width - EmuLogo.el_Width) / 2;
+    start_y = (sz.height - EmuLogo.el_Height) / 2;
+
+    kprintf("[BOOT] Logo start coordinate: %dx%d, size: %dx%d\n", start_x, start_y, EmuLogo.el_Width, EmuLogo.el_Height);
+
+    boot_job(draw_logo, NULL);
+}
+
 uintptr_t top_of_ram;
 
 #ifdef PISTORM
@@ -298,17 +309,32 @@ void platform_post_init()
 {
     void *base_vcmem;
     uint32_t size_vcmem;
+    uint32_t arm_clock = 3, core_clock = 4;
 
     kprintf("[BOOT] Platform post init\n");
 
-    if (get_max_clock_rate(3) != get_clock_rate(3)) {
-        kprintf("[BOOT] Changing ARM clock from %d MHz to %d MHz\n", get_clock_rate(3)/1000000, get_max_clock_rate(3)/1000000);
-        set_clock_rate(3, get_max_clock_rate(3));
+    /* All queries in one firmware round trip */
+    mbox_batch_begin();
+    int pos_arm = mbox_batch_add(VCTAG_GET_CLOCK_RATE, 2, &arm_clock, 1);
+    int pos_arm_max = mbox_batch_add(VCTAG_GET_MAX_CLOCK_RATE, 2, &arm_clock, 1);
+    int pos_core = mbox_batch_add(VCTAG_GET_CLOCK_RATE, 2, &core_clock, 1);
+    int pos_vcmem = mbox_batch_add(VCTAG_GET_VC_MEMORY, 2, NULL, 0);
+    mbox_batch_submit(1);
+
+    uint32_t arm_rate = mbox_batch_value(pos_arm + 1);
+    uint32_t arm_max = mbox_batch_value(pos_arm_max + 1);
+    uint32_t core_rate = mbox_batch_value(pos_core + 1);
+
+    base_vcmem = (void *)(intptr_t)mbox_batch_value(pos_vcmem);
+    size_vcmem = mbox_batch_value(pos_vcmem + 1);
+
+    if (arm_max != arm_rate) {
+        kprintf("[BOOT] Changing ARM clock from %d MHz to %d MHz\n", arm_rate/1000000, arm_max/1000000);
+        arm_rate = set_clock_rate(3, arm_max);
     }
-    kprintf("[BOOT] ARM Clock at %d MHz\n", get_clock_rate(3) / 1000000);  
-    kprintf("[BOOT] CORE Clock at %d MHz\n", get_clock_rate(4) / 1000000);
+    kprintf("[BOOT] ARM Clock at %d MHz\n", arm_rate / 1000000);  
+    kprintf("[BOOT] CORE Clock at %d MHz\n", core_rate / 1000000);
 
-    get_vc_memory(&base_vcmem, &size_vcmem);
     kprintf("[BOOT] VC4 memory: %p-%p\n", (intptr_t)base_vcmem, (intptr_t)base_vcmem + size_vcmem - 1);
 
     if (base_vcmem && size_vcmem)
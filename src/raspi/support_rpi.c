@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 
+#include "config.h"
 #include "devicetree.h"
 #include "support_rpi.h"
 #include "mmu.h"
@@ -87,18 +88,16 @@ void putByte(void *io_base, char chr)
 {
     (void)io_base;
 
-    if (uart_console)
-    {
-        putByte_uart(io_base, chr);
-        return;
-    }
-
     if (redirect)
     {
         if (chr == '\n')
             q_push('\r');
         q_push(chr);
     }
+    else if (uart_console)
+    {
+        putByte_uart(io_base, chr);
+    }
     else
     {
         if (fast_serial) {
@@ -114,11 +113,166 @@ void putByte(void *io_base, char chr)
     }
 }
 
+#if PISTORM_SERIAL_DMA
+
+/*
+    DMA feed of the PL011 for the asynchronous log. The DMA engine of BCM283x moves whole
+    32-bit words only, therefore the log CPU widens queued bytes into one of two word buffers
+    and a DMA lite channel writes them to DR, paced by the TX DREQ of the UART. One buffer is
+    filled while the other one is transmitted.
+*/
+
+#define DMA_BASE                0xf2007000
+#define DMA_CS                  0x00
+#define DMA_CONBLK_AD           0x04
+#define DMA_DEBUG               0x20
+#define DMA_ENABLE              0xff0
+
+#define DMA_CS_ACTIVE           (1 << 0)
+#define DMA_CS_END              (1 << 1)
+#define DMA_CS_RESET            (1U << 31)
+
+#define DMA_TI_WAIT_RESP        (1 << 3)
+#define DMA_TI_DEST_DREQ        (1 << 6)
+#define DMA_TI_SRC_INC          (1 << 8)
+#define DMA_TI_PERMAP(x)        ((x) << 16)
+
+#define DMA_DREQ_UART_TX        12
+#define PL011_DMACR_TXDMAE      (1 << 1)
+#define PL011_DR_BUS            0x7e201000
+
+struct DMAControlBlock {
+    uint32_t    cb_TI;
+    uint32_t    cb_Source;
+    uint32_t    cb_Dest;
+    uint32_t    cb_Length;
+    uint32_t    cb_Stride;
+    uint32_t    cb_Next;
+    uint32_t    cb_Pad[2];
+};
+
+static struct DMAControlBlock *dma_cb;
+static uint32_t *dma_buf;
+static uintptr_t dma_chan;
+
+/* VC bus address of the uncached alias, legacy DMA channels reach the lowest 1GB only */
+static uint32_t dma_bus_addr(void *ptr)
+{
+    return mmu_virt2phys((uintptr_t)ptr) | 0xc0000000;
+}
+
+static int dma_setup()
+{
+    of_node_t *soc = dt_find_node("/soc");
+    uint32_t mask = 0;
+    int ch;
+
+    if (soc == NULL)
+        return 0;
+
+    for (of_node_t *n = soc->on_children; n; n = n->on_next)
+    {
+        of_property_t *p = dt_find_property(n, "compatible");
+
+        if (p && strcmp(p->op_value, "brcm,bcm2835-dma") == 0)
+            mask = dt_get_property_value_u32(n, "brcm,dma-channel-mask", 0, FALSE);
+    }
+
+    /* Lite channels 7 to 10 have the same layout on all models, firmware leaves some of them free */
+    for (ch = 10; ch >= 7; ch--)
+        if (mask & (1 << ch))
+            break;
+
+    if (ch < 7)
+        return 0;
+
+    dma_cb = tlsf_malloc_aligned(tlsf, 2 * sizeof(struct DMAControlBlock), 32);
+    dma_buf = tlsf_malloc_aligned(tlsf, 2 * PISTORM_SERIAL_DMA_CHUNK * sizeof(uint32_t), 32);
+
+    if (dma_cb == NULL || dma_buf == NULL ||
+        mmu_virt2phys((uintptr_t)dma_cb) >= 0x40000000 ||
+        mmu_virt2phys((uintptr_t)&dma_buf[2 * PISTORM_SERIAL_DMA_CHUNK]) > 0x40000000)
+    {
+        if (dma_cb) tlsf_free(tlsf, dma_cb);
+        if (dma_buf) tlsf_free(tlsf, dma_buf);
+        return 0;
+    }
+
+    dma_chan = DMA_BASE + ch * 0x100;
+
+    wr32le(DMA_BASE + DMA_ENABLE, rd32le(DMA_BASE + DMA_ENABLE) | (1 << ch));
+    wr32le(dma_chan + DMA_CS, DMA_CS_RESET);
+    wr32le(dma_chan + DMA_DEBUG, 7);
+    wr32le(0xf2000000 + 0x201000 + PL011_DMACR, PL011_DMACR_TXDMAE);
+
+    kprintf("[BOOT] Serial log through DMA channel %d\n", ch);
+
+    return 1;
+}
+
+static void __attribute__((noreturn)) serial_writer_dma()
+{
+    int cur = 0;
+
+    while(1)
+    {
+        uint32_t *buf = &dma_buf[cur * PISTORM_SERIAL_DMA_CHUNK];
+        struct DMAControlBlock *cb = &dma_cb[cur];
+        uint64_t tail = q_tail;
+        uint32_t len = 0;
+
+        while (tail == q_head)
+            asm volatile("wfe");
+
+        while (len < PISTORM_SERIAL_DMA_CHUNK && tail + len != q_head)
+        {
+            buf[len] = LE32(q_buffer[(tail + len) & (Q_SIZE - 1)]);
+            len++;
+        }
+        __sync_add_and_fetch(&q_tail, len);
+
+        cb->cb_TI = LE32(DMA_TI_WAIT_RESP | DMA_TI_DEST_DREQ | DMA_TI_SRC_INC | DMA_TI_PERMAP(DMA_DREQ_UART_TX));
+        cb->cb_Source = LE32(dma_bus_addr(buf));
+        cb->cb_Dest = LE32(PL011_DR_BUS);
+        cb->cb_Length = LE32(len * 4);
+        cb->cb_Stride = 0;
+        cb->cb_Next = 0;
+
+        arm_flush_cache((uintptr_t)buf, len * 4);
+        arm_flush_cache((uintptr_t)cb, sizeof(struct DMAControlBlock));
+
+        /* The other buffer is still on its way, the channel takes a new block when idle only */
+        while (rd32le(dma_chan + DMA_CS) & DMA_CS_ACTIVE)
+            asm volatile("yield");
+
+        wr32le(dma_chan + DMA_CS, DMA_CS_END);
+        wr32le(dma_chan + DMA_CONBLK_AD, dma_bus_addr(cb));
+        wr32le(dma_chan + DMA_CS, DMA_CS_ACTIVE);
+
+        cur ^= 1;
+    }
+}
+
+#endif
+
 void serial_writer()
 {
     redirect = 1;
 
-    if (fast_serial) {
+    if (uart_console) {
+#if PISTORM_SERIAL_DMA
+        if (dma_setup())
+            serial_writer_dma();
+#endif
+        void *io_base = (void *)0xf2000000;
+
+        while(1) {
+            uint8_t c = q_pop();
+            waitSerOUT(io_base);
+            wr32le(PL011_0_BASE + PL011_DR, c);
+        }
+    }
+    else if (fast_serial) {
         while(1) {
             fastSerial_putByte(q_pop());
         }
@@ -199,11 +353,6 @@ void vkprintf(const char * restrict format, va_list args)
 #define MBOX_RX_EMPTY (1UL << 30)
 #define MBOX_CHANMASK 0xF
 
-/* VideoCore tags used. */
-
-#define VCTAG_GET_ARM_MEMORY     0x00010005
-#define VCTAG_GET_CLOCK_RATE     0x00030002
-
 #define VCCLOCK_PIXEL            9
 
 /*----------------------------------------------------------------------------*/
@@ -257,174 +406,194 @@ static void mbox_send(uint32_t channel, uint32_t data)
 //uint32_t FBReq[128] __attribute__((aligned(16)));
 uint32_t *FBReq = (uint32_t *)0xffffff9000001000;
 
-uint32_t get_clock_rate(uint32_t clock_id)
+/*
+    Property interface. Tags are appended to FBReq between mbox_batch_begin and mbox_batch_submit,
+    the firmware processes all of them in one round trip. A batch submitted without waiting
+    completes in the background, the next batch or mbox_batch_wait picks the response up.
+*/
+#define MBOX_REQ_WORDS  256
+
+static int mbox_words;
+static int mbox_pending;
+
+void mbox_batch_begin()
 {
-    FBReq[0] = LE32(4*8);       // Length
+    mbox_batch_wait();
+
     FBReq[1] = 0;               // Request
-    FBReq[2] = LE32(0x00030002);// GetClockRate
-    FBReq[3] = LE32(8);
-    FBReq[4] = 0;
-    FBReq[5] = LE32(clock_id);
-    FBReq[6] = 0;
-    FBReq[7] = 0;
-
-    arm_flush_cache((intptr_t)FBReq, 32);
-    mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
+    mbox_words = 2;
+}
+
+/*
+    Append tag with a value buffer of value_words words, the first nargs of them taken from args.
+    Returns the word index of the value buffer in the response, -1 if the request is full
+*/
+int mbox_batch_add(uint32_t tag, uint32_t value_words, const uint32_t *args, uint32_t nargs)
+{
+    int pos;
+
+    if (mbox_words + 3 + value_words + 1 > MBOX_REQ_WORDS)
+        return -1;
+
+    FBReq[mbox_words++] = LE32(tag);
+    FBReq[mbox_words++] = LE32(value_words * 4);
+    FBReq[mbox_words++] = 0;
+
+    pos = mbox_words;
 
-    return LE32(FBReq[6]);
+    for (uint32_t i=0; i < value_words; i++)
+        FBReq[mbox_words++] = i < nargs ? LE32(args[i]) : 0;
+
+    return pos;
 }
 
-uint32_t get_max_clock_rate(uint32_t clock_id)
+void mbox_batch_submit(int wait)
 {
-    FBReq[0] = LE32(4*8);       // Length
-    FBReq[1] = 0;               // Request
-    FBReq[2] = LE32(0x00030004);// GetMaxClockRate
-    FBReq[3] = LE32(8);
-    FBReq[4] = 0;
-    FBReq[5] = LE32(clock_id);
-    FBReq[6] = 0;
-    FBReq[7] = 0;
-
-    arm_flush_cache((intptr_t)FBReq, 32);
+    FBReq[mbox_words++] = 0;    // End tag
+    FBReq[0] = LE32(mbox_words * 4);
+
+    arm_flush_cache((intptr_t)FBReq, mbox_words * 4);
     mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
+    mbox_pending = 1;
 
-    return LE32(FBReq[6]);
+    if (wait)
+        mbox_batch_wait();
 }
 
-uint32_t get_min_clock_rate(uint32_t clock_id)
+/* Returns 1 if no batch is in flight anymore, never blocks */
+int mbox_batch_poll()
 {
-    FBReq[0] = LE32(4*8);       // Length
-    FBReq[1] = 0;               // Request
-    FBReq[2] = LE32(0x00030007);// GetClockRate
-    FBReq[3] = LE32(8);
-    FBReq[4] = 0;
-    FBReq[5] = LE32(clock_id);
-    FBReq[6] = 0;
-    FBReq[7] = 0;
-
-    arm_flush_cache((intptr_t)FBReq, 32);
-    mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
+    volatile uint32_t *mbox_read = (uint32_t*)(ARM_PERIIOBASE + 0xB880);
+    volatile uint32_t *mbox_status = (uint32_t*)(ARM_PERIIOBASE + 0xB898);
+
+    while (mbox_pending && !(LE32(*mbox_status) & MBOX_RX_EMPTY))
+    {
+        dmb();
+        uint32_t response = LE32(*mbox_read);
+        dmb();
+
+        if ((response & MBOX_CHANMASK) == 8)
+        {
+            arm_dcache_invalidate((intptr_t)FBReq, mbox_words * 4);
+            mbox_pending = 0;
+        }
+    }
+
+    return !mbox_pending;
+}
+
+void mbox_batch_wait()
+{
+    if (mbox_pending)
+    {
+        mbox_recv(8);
+        arm_dcache_invalidate((intptr_t)FBReq, mbox_words * 4);
+        mbox_pending = 0;
+    }
+}
+
+/* Word of the response at index pos, as returned by mbox_batch_add */
+uint32_t mbox_batch_value(int pos)
+{
+    return pos < 0 ? 0 : LE32(FBReq[pos]);
+}
+
+static uint32_t clock_request(uint32_t tag, uint32_t clock_id)
+{
+    int pos;
+
+    mbox_batch_begin();
+    pos = mbox_batch_add(tag, 2, &clock_id, 1);
+    mbox_batch_submit(1);
+
+    return mbox_batch_value(pos + 1);
+}
+
+uint32_t get_clock_rate(uint32_t clock_id)
+{
+    return clock_request(VCTAG_GET_CLOCK_RATE, clock_id);
+}
 
-    return LE32(FBReq[6]);
+uint32_t get_max_clock_rate(uint32_t clock_id)
+{
+    return clock_request(VCTAG_GET_MAX_CLOCK_RATE, clock_id);
+}
+
+uint32_t get_min_clock_rate(uint32_t clock_id)
+{
+    return clock_request(VCTAG_GET_MIN_CLOCK_RATE, clock_id);
 }
 
 uint32_t set_clock_rate(uint32_t clock_id, uint32_t speed)
 {
-    FBReq[0] = LE32(4*9);       // Length
-    FBReq[1] = 0;               // Request
-    FBReq[2] = LE32(0x00038002);// SetClockRate
-    FBReq[3] = LE32(12);
-    FBReq[4] = 0;
-    FBReq[5] = LE32(clock_id);
-    FBReq[6] = LE32(speed);
-    FBReq[7] = 0;
-    FBReq[8] = 0;
-
-    arm_flush_cache((intptr_t)FBReq, 36);
-    mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
+    uint32_t args[] = { clock_id, speed, 0 };
+    int pos;
+
+    mbox_batch_begin();
+    pos = mbox_batch_add(VCTAG_SET_CLOCK_RATE, 3, args, 3);
+    mbox_batch_submit(1);
 
-    return LE32(FBReq[6]);
+    return mbox_batch_value(pos + 1);
 }
 
 void get_vc_memory(void **base, uint32_t *size)
 {
-    FBReq[0] = LE32(4*8);
-    FBReq[1] = 0;
-    FBReq[2] = LE32(0x00010006);
-    FBReq[3] = LE32(8);
-    FBReq[4] = 0;
-    FBReq[5] = 0;
-    FBReq[6] = 0;
-    FBReq[7] = 0;
+    int pos;
 
-    arm_flush_cache((intptr_t)FBReq, 32);
-    mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
+    mbox_batch_begin();
+    pos = mbox_batch_add(VCTAG_GET_VC_MEMORY, 2, NULL, 0);
+    mbox_batch_submit(1);
 
     if (base) {
-        *base = (void *)(intptr_t)LE32(FBReq[5]);
+        *base = (void *)(intptr_t)mbox_batch_value(pos);
     }
 
     if (size) {
-        *size = LE32(FBReq[6]);
+        *size = mbox_batch_value(pos + 1);
     }
 }
 
 struct Size get_display_size()
 {
     struct Size sz;
+    int pos;
 
-    FBReq[0] = LE32(4*8);
-    FBReq[1] = 0;
-    FBReq[2] = LE32(0x00040003);
-    FBReq[3] = LE32(8);
-    FBReq[4] = 0;
-    FBReq[5] = 0;
-    FBReq[6] = 0;
-    FBReq[7] = 0;
+    mbox_batch_begin();
+    pos = mbox_batch_add(VCTAG_GET_DISPLAY_SIZE, 2, NULL, 0);
+    mbox_batch_submit(1);
 
-    arm_flush_cache((intptr_t)FBReq, 32);
-    mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
-
-    sz.width = LE32(FBReq[5]);
-    sz.height = LE32(FBReq[6]);
+    sz.width = mbox_batch_value(pos);
+    sz.height = mbox_batch_value(pos + 1);
 
     return sz;
 }
 
+/* Without framebuffer and pitch nobody waits for the answer, the request completes in background */
 void init_display(struct Size dimensions, void **framebuffer, uint32_t *pitch)
 {
-    int c = 1;
+    uint32_t size[] = { dimensions.width, dimensions.height };
+    uint32_t depth = 16;
+    uint32_t align = 64;
     int pos_buffer_base = 0;
     int pos_buffer_pitch = 0;
 
-    FBReq[c++] = 0;                 // Request
-    FBReq[c++] = LE32(0x48003);     // SET_RESOLUTION
-    FBReq[c++] = LE32(8);
-    FBReq[c++] = 0;
-    FBReq[c++] = LE32(dimensions.width);
-    FBReq[c++] = LE32(dimensions.height);
-
-    FBReq[c++] = LE32(0x48004);          // Virtual resolution: duplicate physical size...
-    FBReq[c++] = LE32(8);
-    FBReq[c++] = 0;
-    FBReq[c++] = LE32(dimensions.width);
-    FBReq[c++] = LE32(dimensions.height);
-
-    FBReq[c++] = LE32(0x48005);   // Set depth
-    FBReq[c++] = LE32(4);
-    FBReq[c++] = LE32(0);
-    FBReq[c++] = LE32(16);
-
-    FBReq[c++] = LE32(0x40001); // Allocate buffer
-    FBReq[c++] = LE32(8);
-    FBReq[c++] = LE32(0);
-    pos_buffer_base = c;
-    FBReq[c++] = LE32(64);
-    FBReq[c++] = LE32(0);
-
-    FBReq[c++] = LE32(0x40008); // Get pitch
-    FBReq[c++] = LE32(4);
-    FBReq[c++] = LE32(0);
-    pos_buffer_pitch = c;
-    FBReq[c++] = LE32(0);
-
-    FBReq[c++] = 0;
-
-    FBReq[0] = LE32(c << 2);
-
-    arm_flush_cache((intptr_t)FBReq, c * 4);
-    mbox_send(8, mmu_virt2phys((intptr_t)FBReq));
-    mbox_recv(8);
-    arm_dcache_invalidate((intptr_t)FBReq, c*4);
+    mbox_batch_begin();
+    mbox_batch_add(0x48003, 2, size, 2);    // SET_RESOLUTION
+    mbox_batch_add(0x48004, 2, size, 2);    // Virtual resolution: duplicate physical size...
+    mbox_batch_add(0x48005, 1, &depth, 1);  // Set depth
+    pos_buffer_base = mbox_batch_add(0x40001, 2, &align, 1);  // Allocate buffer
+    pos_buffer_pitch = mbox_batch_add(0x40008, 1, NULL, 0);   // Get pitch
+
+    if (framebuffer == NULL && pitch == NULL)
+    {
+        mbox_batch_submit(0);
+        return;
+    }
+
+    mbox_batch_submit(1);
 
-    uint32_t _base = LE32(FBReq[pos_buffer_base]);
-    uint32_t _pitch = LE32(FBReq[pos_buffer_pitch]);
+    uint32_t _base = mbox_batch_value(pos_buffer_base);
+    uint32_t _pitch = mbox_batch_value(pos_buffer_pitch);
 
     if ((_base & 0xc0000000) == 0x40000000)
     {
@@ -611,6 +611,67 @@ void arm_icache_invalidate(uintptr_t addr, uint32_t length)
 #endif
 }
 
+#ifdef __aarch64__
+/* CTR_EL0 of the boot core, read by arm_cache_init */
+static uint64_t arm_ctr;
+#endif
+
+void arm_cache_init()
+{
+#ifdef __aarch64__
+    asm volatile("mrs %0, CTR_EL0":"=r"(arm_ctr));
+
+    kprintf("[BOOT] Cache line sizes: D %d, I %d bytes%s%s\n", 4 << ((arm_ctr >> 16) & 15), 4 << (arm_ctr & 15),
+        (arm_ctr & (1ULL << 28)) ? ", no D clean for coherence (IDC)" : "",
+        (arm_ctr & (1ULL << 29)) ? ", no I invalidate for coherence (DIC)" : "");
+#endif
+}
+
+/*
+    Make code written through data visible to instruction fetch through its alias code. The data
+    cache is cleaned to PoU unless CTR_EL0.IDC tells it is not needed, the instruction cache is
+    invalidated unless CTR_EL0.DIC does. On a core with both just the barriers remain
+*/
+void arm_sync_code(uintptr_t data, uintptr_t code, uint32_t length)
+{
+#ifdef __aarch64__
+    uint64_t ctr = arm_ctr;
+    uintptr_t line_size;
+
+    if (ctr == 0)
+        asm volatile("mrs %0, CTR_EL0":"=r"(ctr));
+
+    if ((ctr & (1ULL << 28)) == 0)
+    {
+        uintptr_t top_addr = data + length;
+
+        line_size = 4 << ((ctr >> 16) & 15);
+
+        for (data &= ~(line_size - 1); data < top_addr; data += line_size)
+            __asm__ __volatile__("dc cvau, %0"::"r"(data));
+    }
+    __asm__ __volatile__("dsb ish");
+
+    if ((ctr & (1ULL << 29)) == 0)
+    {
+        uintptr_t top_addr = code + length;
+
+        line_size = 4 << (ctr & 15);
+
+        for (code &= ~(line_size - 1); code < top_addr; code += line_size)
+            __asm__ __volatile__("ic ivau, %0"::"r"(code));
+
+        __asm__ __volatile__("dsb ish");
+    }
+    __asm__ __volatile__("isb sy");
+#else
+    (void)code;
+
+    arm_flush_cache(data, length);
+    arm_icache_invalidate(data, length);
+#endif
+}
+
 void arm_dcache_invalidate(uintptr_t addr, uint32_t length)
 {
 #ifdef __aarch64__
@@ -731,20 +792,153 @@ int raise(int sig)
     return 0;
 }
 
+/*
+    Memory functions are used with MMU off too, when all memory is of Device type and only
+    aligned accesses are allowed. Bulk of the data is moved with NEON only if source and
+    destination have the same alignment within 16 bytes, with 32-bit words if they share
+    alignment within 4 bytes, and byte by byte otherwise. The loops are in assembly, so that
+    the compiler cannot turn them back into calls to these very functions.
+*/
+
+static inline void copy_fwd64(uint8_t **d, const uint8_t **s, size_t blocks)
+{
+#ifdef __aarch64__
+    asm volatile(
+        "1:     ldp     q0, q1, [%1], #32       \n"
+        "       ldp     q2, q3, [%1], #32       \n"
+        "       stp     q0, q1, [%0], #32       \n"
+        "       stp     q2, q3, [%0], #32       \n"
+        "       subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(blocks)::"v0", "v1", "v2", "v3", "cc", "memory");
+#else
+    asm volatile(
+        "1:     vld1.8  {d0-d3}, [%1:128]!      \n"
+        "       vld1.8  {d4-d7}, [%1:128]!      \n"
+        "       vst1.8  {d0-d3}, [%0:128]!      \n"
+        "       vst1.8  {d4-d7}, [%0:128]!      \n"
+        "       subs    %2, %2, #1              \n"
+        "       bne     1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(blocks)::"d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory");
+#endif
+}
+
+static inline void copy_bwd64(uint8_t **d, const uint8_t **s, size_t blocks)
+{
+#ifdef __aarch64__
+    asm volatile(
+        "1:     ldp     q0, q1, [%1, #-32]!     \n"
+        "       ldp     q2, q3, [%1, #-32]!     \n"
+        "       stp     q0, q1, [%0, #-32]!     \n"
+        "       stp     q2, q3, [%0, #-32]!     \n"
+        "       subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(blocks)::"v0", "v1", "v2", "v3", "cc", "memory");
+#else
+    asm volatile(
+        "1:     sub     %1, %1, #64             \n"
+        "       sub     %0, %0, #64             \n"
+        "       vld1.8  {d0-d3}, [%1:128]!      \n"
+        "       vld1.8  {d4-d7}, [%1:128]       \n"
+        "       sub     %1, %1, #32             \n"
+        "       vst1.8  {d0-d3}, [%0:128]!      \n"
+        "       vst1.8  {d4-d7}, [%0:128]       \n"
+        "       sub     %0, %0, #32             \n"
+        "       subs    %2, %2, #1              \n"
+        "       bne     1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(blocks)::"d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory");
+#endif
+}
+
+static inline void copy_fwd4(uint8_t **d, const uint8_t **s, size_t words)
+{
+    uint32_t tmp;
+#ifdef __aarch64__
+    asm volatile(
+        "1:     ldr     %w3, [%1], #4           \n"
+        "       str     %w3, [%0], #4           \n"
+        "       subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(words), "=&r"(tmp)::"cc", "memory");
+#else
+    asm volatile(
+        "1:     ldr     %3, [%1], #4            \n"
+        "       str     %3, [%0], #4            \n"
+        "       subs    %2, %2, #1              \n"
+        "       bne     1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(words), "=&r"(tmp)::"cc", "memory");
+#endif
+}
+
+static inline void copy_bwd4(uint8_t **d, const uint8_t **s, size_t words)
+{
+    uint32_t tmp;
+#ifdef __aarch64__
+    asm volatile(
+        "1:     ldr     %w3, [%1, #-4]!         \n"
+        "       str     %w3, [%0, #-4]!         \n"
+        "       subs    %2, %2, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(words), "=&r"(tmp)::"cc", "memory");
+#else
+    asm volatile(
+        "1:     ldr     %3, [%1, #-4]!          \n"
+        "       str     %3, [%0, #-4]!          \n"
+        "       subs    %2, %2, #1              \n"
+        "       bne     1b                      \n"
+        :"+r"(*d), "+r"(*s), "+r"(words), "=&r"(tmp)::"cc", "memory");
+#endif
+}
+
+static inline void fill64(uint8_t **d, uint8_t fill, size_t blocks)
+{
+#ifdef __aarch64__
+    asm volatile(
+        "       dup     v0.16b, %w2             \n"
+        "1:     stp     q0, q0, [%0], #32       \n"
+        "       stp     q0, q0, [%0], #32       \n"
+        "       subs    %1, %1, #1              \n"
+        "       b.ne    1b                      \n"
+        :"+r"(*d), "+r"(blocks):"r"(fill):"v0", "cc", "memory");
+#else
+    asm volatile(
+        "       vdup.8  q0, %2                  \n"
+        "       vmov    q1, q0                  \n"
+        "1:     vst1.8  {d0-d3}, [%0:128]!      \n"
+        "       vst1.8  {d0-d3}, [%0:128]!      \n"
+        "       subs    %1, %1, #1              \n"
+        "       bne     1b                      \n"
+        :"+r"(*d), "+r"(blocks):"r"(fill):"d0", "d1", "d2", "d3", "cc", "memory");
+#endif
+}
+
 void bzero(void *ptr, size_t sz)
 {
-    char *p = ptr;
-    if (p)
-        while(sz--)
-            *p++ = 0;
+    memset(ptr, 0, sz);
 }
 
 void *memset(void *ptr, int fill, size_t sz)
 {
     uint8_t *p = ptr;
-    if (p)
-        while(sz--)
+
+    if (!p)
+        return ptr;
+
+    if (sz >= 128)
+    {
+        while ((uintptr_t)p & 15)
+        {
             *p++ = fill;
+            sz--;
+        }
+
+        fill64(&p, fill, sz >> 6);
+        sz &= 63;
+    }
+
+    while(sz--)
+        *p++ = fill;
+
     return ptr;
 }
 
@@ -753,8 +947,31 @@ void *memcpy(void *dst, const void *src, size_t sz)
     uint8_t *d = dst;
     const uint8_t *s = src;
 
+    if (sz >= 128 && (((uintptr_t)d ^ (uintptr_t)s) & 15) == 0)
+    {
+        while ((uintptr_t)d & 15)
+        {
+            *d++ = *s++;
+            sz--;
+        }
+
+        copy_fwd64(&d, &s, sz >> 6);
+        sz &= 63;
+    }
+    else if (sz >= 16 && (((uintptr_t)d ^ (uintptr_t)s) & 3) == 0)
+    {
+        while ((uintptr_t)d & 3)
+        {
+            *d++ = *s++;
+            sz--;
+        }
+
+        copy_fwd4(&d, &s, sz >> 2);
+        sz &= 3;
+    }
+
     while(sz--)
-	*d++ = *s++;
+        *d++ = *s++;
 
     return dst;
 }
@@ -764,21 +981,100 @@ void *memmove(void *dst, const void *src, size_t sz)
     uint8_t *d = dst;
     const uint8_t *s = src;
 
-    if (d > s)
+    /* Forward copy reads every block before writing below it, only overlap from above is a problem */
+    if (d <= s || d >= s + sz)
+        return memcpy(dst, src, sz);
+
+    d += sz;
+    s += sz;
+
+    if (sz >= 128 && (((uintptr_t)d ^ (uintptr_t)s) & 15) == 0)
     {
-	d += sz;
-	s += sz;
+        while ((uintptr_t)d & 15)
+        {
+            *--d = *--s;
+            sz--;
+        }
 
-	while(sz--)
-	    *--d = *--s;
+        copy_bwd64(&d, &s, sz >> 6);
+        sz &= 63;
+    }
+    else if (sz >= 16 && (((uintptr_t)d ^ (uintptr_t)s) & 3) == 0)
+    {
+        while ((uintptr_t)d & 3)
+        {
+            *--d = *--s;
+            sz--;
+        }
+
+        copy_bwd4(&d, &s, sz >> 2);
+        sz &= 3;
     }
-    else
-	while(sz--)
-	    *d++ = *s++;
+
+    while(sz--)
+        *--d = *--s;
 
     return dst;
 }
 
+/*
+    Sum of big endian longwords as 64-bit value, size is multiple of 4 and mem longword
+    aligned. Folding the carries back into 32 bits gives the end-around carry sum used by
+    Amiga ROM checksums.
+*/
+uint64_t sum_be32(const void *mem, uintptr_t size)
+{
+    const uint32_t *p = mem;
+    uint64_t sum = 0;
+    uintptr_t blocks = size >> 5;
+
+    if (blocks)
+    {
+#ifdef __aarch64__
+        asm volatile(
+            "       movi    v2.2d, #0               \n"
+            "       movi    v3.2d, #0               \n"
+            "1:     ld1     {v0.4s, v1.4s}, [%1], #32 \n"
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            "       rev32   v0.16b, v0.16b          \n"
+            "       rev32   v1.16b, v1.16b          \n"
+#endif
+            "       uadalp  v2.2d, v0.4s            \n"
+            "       uadalp  v3.2d, v1.4s            \n"
+            "       subs    %2, %2, #1              \n"
+            "       b.ne    1b                      \n"
+            "       add     v2.2d, v2.2d, v3.2d     \n"
+            "       addp    d2, v2.2d               \n"
+            "       fmov    %0, d2                  \n"
+            :"=r"(sum), "+r"(p), "+r"(blocks)::"v0", "v1", "v2", "v3", "cc");
+#else
+        uint32_t lo, hi;
+        asm volatile(
+            "       vmov.i64 q2, #0                 \n"
+            "       vmov.i64 q3, #0                 \n"
+            "1:     vld1.32 {d0-d3}, [%2]!          \n"
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            "       vrev32.8 q0, q0                 \n"
+            "       vrev32.8 q1, q1                 \n"
+#endif
+            "       vpadal.u32 q2, q0               \n"
+            "       vpadal.u32 q3, q1               \n"
+            "       subs    %3, %3, #1              \n"
+            "       bne     1b                      \n"
+            "       vadd.i64 q2, q2, q3             \n"
+            "       vadd.i64 d4, d4, d5             \n"
+            "       vmov    %0, %1, d4              \n"
+            :"=r"(lo), "=r"(hi), "+r"(p), "+r"(blocks)::"d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc");
+        sum = ((uint64_t)hi << 32) | lo;
+#endif
+    }
+
+    for (uintptr_t i = 0; i < (size & 31) / 4; i++)
+        sum += BE32(p[i]);
+
+    return sum;
+}
+
 char * strstr(const char *s, const char *find)
 {
     char c, sc;
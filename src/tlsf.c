@@ -5,6 +5,7 @@
 
 #define _GNU_SOURCE
 
+#include "config.h"
 #include "support.h"
 #include "tlsf.h"
 #include "spinlock.h"
@@ -87,6 +88,24 @@ typedef struct tlsf_area_s {
     bhdr_t *                end;        // Pointer to "end-of-area" block header
 } tlsf_area_t;
 
+#if EMU68_TLSF_FAST_BINS
+/*
+ * Fast bins per core. Busy blocks of up to FAST_MAX bytes are kept in singly linked lists, one
+ * per size class, instead of going back to the TLSF matrix. Only the owning core touches its
+ * bins, so neither the lock nor the bitmap scans are needed for them. A block freed on another
+ * core than it was allocated on simply moves to the bins of that core.
+ */
+#define FAST_CORES      4
+#define FAST_CLASSES    4
+#define FAST_MAX        (FAST_CLASSES * SIZE_ALIGN)
+
+typedef struct {
+    bhdr_t *            bin[FAST_CLASSES];
+    uint32_t            count[FAST_CLASSES];
+    struct tlsf_bin_stats stats;
+} __attribute__((aligned(64))) fast_core_t;
+#endif
+
 typedef struct {
     spinlock_t          lock;
 
@@ -99,8 +118,27 @@ typedef struct {
     uint32_t            slbitmap[REAL_FLI];
 
     bhdr_t *            matrix[REAL_FLI][MAX_SLI];
+
+#if EMU68_TLSF_FAST_BINS
+    fast_core_t         fast[FAST_CORES];
+#endif
 } tlsf_t;
 
+#if EMU68_TLSF_FAST_BINS
+static inline __attribute__((always_inline)) fast_core_t * FAST_CORE(tlsf_t *tlsf)
+{
+    uintptr_t mpidr;
+
+#ifdef __aarch64__
+    asm volatile("mrs %0, MPIDR_EL1":"=r"(mpidr));
+#else
+    asm volatile("mrc p15, 0, %0, c0, c0, 5":"=r"(mpidr));
+#endif
+
+    return &tlsf->fast[mpidr & (FAST_CORES - 1)];
+}
+#endif
+
 static inline __attribute__((always_inline)) int LS(uintptr_t i)
 {
     if (sizeof(uintptr_t) == 4)
@@ -383,6 +421,29 @@ void * tlsf_malloc(void *t, uintptr_t size)
 
     if (unlikely(!size)) return NULL;
 
+#if EMU68_TLSF_FAST_BINS
+    if (size <= FAST_MAX)
+    {
+        fast_core_t *fc = FAST_CORE(tlsf);
+        int cls = size / SIZE_ALIGN - 1;
+
+        b = fc->bin[cls];
+
+        if (b)
+        {
+            fc->bin[cls] = b->free_node.next;
+            fc->count[cls]--;
+            fc->stats.tb_Hits++;
+
+            b->free_node.next = NULL;
+
+            return &b->mem[0];
+        }
+
+        fc->stats.tb_Misses++;
+    }
+#endif
+
     spinlock_acquire(&tlsf->lock);
 
     b = tlsf_intern_malloc(tlsf, size);
@@ -541,10 +602,31 @@ void tlsf_free(void *t, void *ptr)
     if (unlikely(!ptr))
         return;
 
-    spinlock_acquire(&tlsf->lock);
-
     fb = MEM_TO_BHDR(ptr);
 
+#if EMU68_TLSF_FAST_BINS
+    /* Small blocks stay busy and go to the bin of their size class while it has room */
+    if (GET_SIZE(fb) <= FAST_MAX)
+    {
+        fast_core_t *fc = FAST_CORE(tlsf);
+        int cls = GET_SIZE(fb) / SIZE_ALIGN - 1;
+
+        if (fc->count[cls] < EMU68_TLSF_BIN_DEPTH)
+        {
+            fb->free_node.next = fc->bin[cls];
+            fc->bin[cls] = fb;
+            fc->count[cls]++;
+            fc->stats.tb_Cached++;
+
+            return;
+        }
+
+        fc->stats.tb_Returned++;
+    }
+#endif
+
+    spinlock_acquire(&tlsf->lock);
+
     /* Mark block as free */
     SET_FREE_BLOCK(fb);
 
@@ -566,8 +648,36 @@ void tlsf_free(void *t, void *ptr)
 uintptr_t tlsf_get_free_size(void *t)
 {
     tlsf_t *tlsf = t;
+    uintptr_t size = tlsf->free_size;
 
-    return tlsf->free_size;
+#if EMU68_TLSF_FAST_BINS
+    /* Blocks waiting in the fast bins are free for the caller */
+    for (int i=0; i < FAST_CORES; i++)
+        for (int cls=0; cls < FAST_CLASSES; cls++)
+            size += tlsf->fast[i].count[cls] * (cls + 1) * SIZE_ALIGN;
+#endif
+
+    return size;
+}
+
+/* Fast bin statistics summed over all cores */
+void tlsf_get_bin_stats(void *t, struct tlsf_bin_stats *stats)
+{
+    tlsf_t *tlsf = t;
+
+    bzero(stats, sizeof(*stats));
+
+#if EMU68_TLSF_FAST_BINS
+    for (int i=0; i < FAST_CORES; i++)
+    {
+        stats->tb_Hits += tlsf->fast[i].stats.tb_Hits;
+        stats->tb_Misses += tlsf->fast[i].stats.tb_Misses;
+        stats->tb_Cached += tlsf->fast[i].stats.tb_Cached;
+        stats->tb_Returned += tlsf->fast[i].stats.tb_Returned;
+    }
+#else
+    (void)tlsf;
+#endif
 }
 
 uintptr_t tlsf_get_total_size(void *t)
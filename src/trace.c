@@ -0,0 +1,89 @@
+/*
+    Copyright © 2021 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "devicetree.h"
+#include "mmu.h"
+#include "trace.h"
+
+struct TraceRing trace_rings[TRACE_CPUS] __attribute__((aligned(64)));
+
+static const char * const event_names[TRACE_EVENT_COUNT] = {
+    [TRACE_NONE]            = "none",
+    [TRACE_UNIT_TRANSLATED] = "unit translated",
+    [TRACE_UNIT_RELEASED]   = "unit released",
+    [TRACE_FAULT_SITE]      = "fault at site",
+    [TRACE_IPL_CHANGE]      = "IPL change",
+    [TRACE_WB_FULL]         = "write buffer full",
+};
+
+/* Tell offline tools where the rings are: physical address (2 cells), size, ring stride, record size */
+void Trace_Init()
+{
+#if EMU68_TRACE
+    uint64_t phys = mmu_virt2phys((uintptr_t)trace_rings);
+    uint32_t prop[] = {
+        phys >> 32, phys & 0xffffffff, sizeof(trace_rings), sizeof(struct TraceRing), sizeof(struct TraceRecord)
+    };
+
+    dt_add_property(dt_find_node("/emu68"), "trace-buffer", prop, sizeof(prop));
+
+    kprintf("[BOOT] Event trace: %d records per CPU at %p\n", EMU68_TRACE_SIZE, trace_rings);
+#endif
+}
+
+/* Decode all rings, oldest record first. Records overwritten meanwhile are skipped */
+void Trace_Dump()
+{
+#if EMU68_TRACE
+    uint64_t freq;
+
+#ifdef __aarch64__
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+#else
+    uint32_t f;
+    asm volatile("mrc p15, 0, %0, c14, c0, 0":"=r"(f));
+    freq = f;
+#endif
+    freq &= 0xffffffff;
+
+    for (int cpu=0; cpu < TRACE_CPUS; cpu++)
+    {
+        struct TraceRing *ring = &trace_rings[cpu];
+        uint64_t head = __atomic_load_n(&ring->tr_Head, __ATOMIC_ACQUIRE);
+        uint64_t idx = head > EMU68_TRACE_SIZE ? head - EMU68_TRACE_SIZE : 0;
+
+        if (head == 0)
+            continue;
+
+        kprintf("[TRACE] CPU%d, %lld events\n", cpu, head);
+
+        for (; idx < head; idx++)
+        {
+            struct TraceRecord *r = &ring->tr_Records[idx & EMU68_TRACE_MASK];
+            struct TraceRecord copy;
+
+            if (__atomic_load_n(&r->tr_Seq, __ATOMIC_ACQUIRE) != (uint32_t)idx + 1)
+                continue;
+
+            copy = *r;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (__atomic_load_n(&r->tr_Seq, __ATOMIC_RELAXED) != (uint32_t)idx + 1)
+                continue;
+
+            kprintf("[TRACE]   %10lld us %-18s %08x %08x %08x %08x\n", (1000000 * copy.tr_Time) / freq,
+                copy.tr_Event < TRACE_EVENT_COUNT ? event_names[copy.tr_Event] : "?",
+                copy.tr_Args[0], copy.tr_Args[1], copy.tr_Args[2], copy.tr_Args[3]);
+        }
+    }
+#endif
+}
@@ -38,6 +38,10 @@ void platform_init()
     mmu_map(0x09000000, 0xf2201000, 0x00001000,
         MMU_ACCESS | MMU_NS | MMU_ALLOW_EL0 | MMU_ATTR_DEVICE, 0);
 
+    /* virtio-mmio transports, the console is looked up there by setup_serial */
+    mmu_map(0x0a000000, 0xf2210000, 0x00004000,
+        MMU_ACCESS | MMU_NS | MMU_ATTR_DEVICE, 0);
+
     mmu_map(0x40000000, 0x00000000, 0x10000000,
                         MMU_ACCESS | MMU_ISHARE | MMU_ATTR_CACHED, 0);
 }
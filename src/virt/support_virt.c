@@ -11,6 +11,7 @@
 #include <stdarg.h>
 
 #include "support.h"
+#include "mmu.h"
 
 static int serial_up = 0;
 
@@ -41,9 +42,179 @@ static inline void waitSerOUT(void *io_base)
     }
 }
 
+/*
+    Console on virtio-mmio. Under KVM every PL011 access is a trap, the virtio console takes
+    whole buffers instead and is notified once per kprintf. Only modern devices are used,
+    legacy ones keep their rings in guest endianness (QEMU needs
+    "-global virtio-mmio.force-legacy=false")
+*/
+#define VIRTIO_MMIO_BASE    0xf2210000  /* Mapped from 0x0a000000 by platform_init */
+#define VIRTIO_MMIO_SLOTS   32
+#define VIRTIO_MMIO_STRIDE  0x200
+
+#define VIO_MAGIC           0x000
+#define VIO_VERSION         0x004
+#define VIO_DEVICE_ID       0x008
+#define VIO_DEV_FEATURES    0x010
+#define VIO_DEV_FEATURES_SEL 0x014
+#define VIO_DRV_FEATURES    0x020
+#define VIO_DRV_FEATURES_SEL 0x024
+#define VIO_QUEUE_SEL       0x030
+#define VIO_QUEUE_NUM_MAX   0x034
+#define VIO_QUEUE_NUM       0x038
+#define VIO_QUEUE_READY     0x044
+#define VIO_QUEUE_NOTIFY    0x050
+#define VIO_STATUS          0x070
+#define VIO_QUEUE_DESC      0x080
+#define VIO_QUEUE_DRIVER    0x090
+#define VIO_QUEUE_DEVICE    0x0a0
+
+#define VIO_MAGIC_VALUE     0x74726976
+#define VIO_ID_CONSOLE      3
+
+#define VIO_S_ACKNOWLEDGE   1
+#define VIO_S_DRIVER        2
+#define VIO_S_DRIVER_OK     4
+#define VIO_S_FEATURES_OK   8
+
+#define VIO_F_VERSION_1     (1 << 0)    /* Bit 32, second feature word */
+
+#define VCON_TXQ            1           /* transmitq of port 0 */
+#define VCON_SLOTS          8
+#define VCON_BUF_SIZE       512
+
+struct vring_desc {
+    uint64_t    addr;
+    uint32_t    len;
+    uint16_t    flags;
+    uint16_t    next;
+};
+
+struct vring_used_elem {
+    uint32_t    id;
+    uint32_t    len;
+};
+
+/* All fields little endian */
+static struct {
+    struct vring_desc desc[VCON_SLOTS];
+    struct {
+        uint16_t    flags;
+        uint16_t    idx;
+        uint16_t    ring[VCON_SLOTS];
+        uint16_t    used_event;
+    } avail __attribute__((aligned(16)));
+    struct {
+        uint16_t    flags;
+        uint16_t    idx;
+        struct vring_used_elem ring[VCON_SLOTS];
+        uint16_t    avail_event;
+    } used __attribute__((aligned(16)));
+} vcon_ring __attribute__((aligned(4096)));
+
+static char vcon_buf[VCON_SLOTS][VCON_BUF_SIZE] __attribute__((aligned(64)));
+static uintptr_t vcon_base;
+static uint16_t vcon_next;      /* Free running index of the buffer being filled */
+static uint16_t vcon_fill;
+
+static void vcon_flush()
+{
+    uint16_t slot = vcon_next % VCON_SLOTS;
+
+    if (vcon_fill == 0)
+        return;
+
+    vcon_ring.desc[slot].len = LE32(vcon_fill);
+    vcon_ring.avail.ring[slot] = LE16(slot);
+    asm volatile("dmb ish":::"memory");
+    vcon_ring.avail.idx = LE16(++vcon_next);
+    asm volatile("dsb sy":::"memory");
+    wr32le(vcon_base + VIO_QUEUE_NOTIFY, VCON_TXQ);
+
+    vcon_fill = 0;
+}
+
+static void vcon_putByte(char chr)
+{
+    if (vcon_fill == 0)
+    {
+        /* The buffer is free once the device has consumed all but VCON_SLOTS - 1 of the queued ones */
+        while ((uint16_t)(vcon_next - LE16(*(volatile uint16_t *)&vcon_ring.used.idx)) >= VCON_SLOTS)
+            asm volatile("yield");
+    }
+
+    vcon_buf[vcon_next % VCON_SLOTS][vcon_fill++] = chr;
+
+    if (vcon_fill == VCON_BUF_SIZE)
+        vcon_flush();
+}
+
+static int vcon_init(uintptr_t base)
+{
+    uint32_t features;
+
+    wr32le(base + VIO_STATUS, 0);
+    wr32le(base + VIO_STATUS, VIO_S_ACKNOWLEDGE | VIO_S_DRIVER);
+
+    wr32le(base + VIO_DEV_FEATURES_SEL, 1);
+    features = rd32le(base + VIO_DEV_FEATURES);
+    if ((features & VIO_F_VERSION_1) == 0)
+        return 0;
+
+    wr32le(base + VIO_DRV_FEATURES_SEL, 1);
+    wr32le(base + VIO_DRV_FEATURES, VIO_F_VERSION_1);
+    wr32le(base + VIO_DRV_FEATURES_SEL, 0);
+    wr32le(base + VIO_DRV_FEATURES, 0);
+
+    wr32le(base + VIO_STATUS, VIO_S_ACKNOWLEDGE | VIO_S_DRIVER | VIO_S_FEATURES_OK);
+    if ((rd32le(base + VIO_STATUS) & VIO_S_FEATURES_OK) == 0)
+        return 0;
+
+    wr32le(base + VIO_QUEUE_SEL, VCON_TXQ);
+    if (rd32le(base + VIO_QUEUE_READY) != 0 || rd32le(base + VIO_QUEUE_NUM_MAX) < VCON_SLOTS)
+        return 0;
+
+    for (int i=0; i < VCON_SLOTS; i++)
+    {
+        vcon_ring.desc[i].addr = LE64(mmu_virt2phys((uintptr_t)vcon_buf[i]));
+        vcon_ring.desc[i].len = 0;
+        vcon_ring.desc[i].flags = 0;
+        vcon_ring.desc[i].next = 0;
+    }
+    vcon_ring.avail.flags = LE16(1);    /* No interrupts */
+    vcon_ring.avail.idx = 0;
+    vcon_ring.used.idx = 0;
+
+    uint64_t desc = mmu_virt2phys((uintptr_t)&vcon_ring.desc);
+    uint64_t avail = mmu_virt2phys((uintptr_t)&vcon_ring.avail);
+    uint64_t used = mmu_virt2phys((uintptr_t)&vcon_ring.used);
+
+    wr32le(base + VIO_QUEUE_NUM, VCON_SLOTS);
+    wr32le(base + VIO_QUEUE_DESC, desc);
+    wr32le(base + VIO_QUEUE_DESC + 4, desc >> 32);
+    wr32le(base + VIO_QUEUE_DRIVER, avail);
+    wr32le(base + VIO_QUEUE_DRIVER + 4, avail >> 32);
+    wr32le(base + VIO_QUEUE_DEVICE, used);
+    wr32le(base + VIO_QUEUE_DEVICE + 4, used >> 32);
+    asm volatile("dsb sy":::"memory");
+    wr32le(base + VIO_QUEUE_READY, 1);
+
+    wr32le(base + VIO_STATUS, VIO_S_ACKNOWLEDGE | VIO_S_DRIVER | VIO_S_FEATURES_OK | VIO_S_DRIVER_OK);
+
+    vcon_base = base;
+
+    return 1;
+}
+
 static inline void putByte(void *io_base, char chr)
 {
-    if (serial_up)
+    if (vcon_base)
+    {
+        if (chr == '\n')
+            vcon_putByte('\r');
+        vcon_putByte(chr);
+    }
+    else if (serial_up)
     {
         waitSerOUT(io_base);
 
@@ -63,16 +234,38 @@ void kprintf(const char * restrict format, ...)
     va_start(v, format);
     vkprintf_pc(putByte, (void*)0x09000000, format, v);
     va_end(v);
+
+    if (vcon_base)
+        vcon_flush();
 }
 
 void vkprintf(const char * restrict format, va_list args)
 {
     vkprintf_pc(putByte, (void*)0x09000000, format, args);
+
+    if (vcon_base)
+        vcon_flush();
 }
 
 void setup_serial()
 {
     serial_up = 1;
+
+    /* Output moves to the first modern virtio console, if there is one */
+    for (int i=0; i < VIRTIO_MMIO_SLOTS; i++)
+    {
+        uintptr_t base = VIRTIO_MMIO_BASE + i * VIRTIO_MMIO_STRIDE;
+
+        if (rd32le(base + VIO_MAGIC) != VIO_MAGIC_VALUE || rd32le(base + VIO_VERSION) != 2 ||
+            rd32le(base + VIO_DEVICE_ID) != VIO_ID_CONSOLE)
+            continue;
+
+        if (vcon_init(base))
+        {
+            kprintf("[BOOT] Console on virtio-mmio at %08x\n", base - VIRTIO_MMIO_BASE + 0x0a000000);
+            break;
+        }
+    }
 /*
 	of_node_t *aliases = dt_find_node("/aliases");
     if (aliases)
@@ -0,0 +1,464 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*
+    Translation-only harness. The translator core is linked into an AArch64 Linux program
+    and fed with a captured m68k code image, e.g. a Kickstart ROM dump. The image is mapped
+    at its m68k address and swept from the start: every unit begins where the previous one
+    ended. Translated code is never run, the numbers are the cost of M68K_GetTranslationUnit
+    alone and can be profiled with perf.
+
+        jitbench [-b base] [-n passes] [-i depth] [-e entry]... [-r] [-s] image
+
+    -b  m68k address of the image, 512K and 256K images default to Kickstart addresses
+    -n  number of passes, all units are released between passes
+    -i  m68k instructions per unit, as icnt= in bootargs
+    -e  translate from the given entry only instead of sweeping, may be repeated
+    -r  print every unit, as jit_report in bootargs
+    -s  dump translator statistics at the end
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/auxv.h>
+
+#include "support.h"
+#include "config.h"
+#include "EmuFeatures.h"
+#include "M68k.h"
+#include "cache.h"
+#include "devicetree.h"
+#include "disasm.h"
+#include "jitstats.h"
+#include "mmu.h"
+#include "tlsf.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#ifndef HWCAP_ATOMICS
+#define HWCAP_ATOMICS (1 << 8)
+#endif
+
+#define DATA_POOL_SIZE  (64*1024*1024)
+#define JIT_POOL_SIZE   (256*1024*1024)
+/* Below bit 36, the translator sets it in entry points to form the executable alias */
+#define JIT_POOL_HINT   0x200000000ULL
+#define IMAGE_PAD       65536
+#define MAX_ENTRIES     64
+
+extern int jit_report;
+
+/* Environment of the translator, normally set up by start.c and the board support code */
+struct M68KState *__m68k_state;
+void * tlsf;
+void * jit_tlsf;
+volatile uint8_t *int_signal_gicc;
+struct PMUProfile pmu_state;
+#if EMU68_INSN_COUNTER_SAMPLED
+volatile uint64_t insn_count_sampled;
+#endif
+
+static struct M68KState m68k_state;
+static struct MemoryBlock host_memory[] = {
+    { 0x00000000, 0x40000000 },
+    { 0, 0 }
+};
+struct MemoryBlock *sys_memory = host_memory;
+
+static uint32_t image_base;
+static uint32_t image_end;
+static volatile uint32_t current_pc;
+
+void kprintf(const char * format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+void vkprintf_pc(putc_func putc_f, void *putc_data, const char * format, va_list args)
+{
+    char buffer[1024];
+
+    vsnprintf(buffer, sizeof(buffer), format, args);
+
+    for (char *c = buffer; *c; c++)
+        putc_f(putc_data, *c);
+}
+
+/* Same maintenance as in the kernel, it is part of the cost of a new unit */
+void arm_flush_cache(uintptr_t addr, uint32_t length)
+{
+    length = (length + (addr & 63) + 63) & ~63;
+    addr &= ~63;
+
+    while (length)
+    {
+        asm volatile("dc cvau, %0"::"r"(addr));
+        addr += 64;
+        length -= 64;
+    }
+    asm volatile("dsb ish");
+}
+
+void arm_icache_invalidate(uintptr_t addr, uint32_t length)
+{
+    addr &= ~0x0000001000000000ULL;
+    length = (length + (addr & 63) + 63) & ~63;
+    addr &= ~63;
+
+    while (length)
+    {
+        asm volatile("ic ivau, %0"::"r"(addr));
+        addr += 64;
+        length -= 64;
+    }
+    asm volatile("dsb ish; isb");
+}
+
+/*
+    The image is mapped at its m68k address, so the reads go straight to memory. Anything
+    outside of it reads as ILLEGAL, which ends the unit
+*/
+static inline int in_image(uint32_t address, uint32_t size)
+{
+    return address >= image_base && address + size <= image_end;
+}
+
+uint8_t cache_read_8(enum CacheType type, uint32_t address)
+{
+    (void)type;
+    return in_image(address, 1) ? *(uint8_t *)(uintptr_t)address : 0x4a;
+}
+
+uint16_t cache_read_16(enum CacheType type, uint32_t address)
+{
+    (void)type;
+    return in_image(address, 2) ? BE16(*(uint16_t *)(uintptr_t)address) : 0x4afc;
+}
+
+uint32_t cache_read_32(enum CacheType type, uint32_t address)
+{
+    (void)type;
+    return in_image(address, 4) ? BE32(*(uint32_t *)(uintptr_t)address) : 0x4afc4afc;
+}
+
+uint64_t cache_read_64(enum CacheType type, uint32_t address)
+{
+    (void)type;
+    return in_image(address, 8) ? BE64(*(uint64_t *)(uintptr_t)address) : 0x4afc4afc4afc4afcULL;
+}
+
+void cache_invalidate_all(enum CacheType type) { (void)type; }
+void cache_invalidate_range(enum CacheType type, uint32_t address, uint32_t len) { (void)type; (void)address; (void)len; }
+
+/* Called from translated code only */
+void SYSBusTrampoline() { abort(); }
+uint64_t Load96bit(uintptr_t __ignore, uintptr_t base) { (void)__ignore; (void)base; abort(); }
+uint64_t Store96bit(uintptr_t value, uintptr_t base) { (void)value; (void)base; abort(); }
+
+double my_pow10(int exp)
+{
+    double r = 1.0;
+    double b = exp < 0 ? 0.1 : 10.0;
+
+    for (int e = _abs(exp); e; e >>= 1, b *= b)
+        if (e & 1)
+            r *= b;
+
+    return r;
+}
+
+void M68K_PrintContext(void *ctx) { (void)ctx; }
+void PMU_Dump() { }
+
+void disasm_open() { }
+void disasm_close() { }
+void disasm_print(uint16_t *m68k_addr, uint16_t m68k_count, uint32_t *arm_addr, size_t arm_size, uint32_t *arm_start)
+{
+    (void)m68k_addr; (void)m68k_count; (void)arm_addr; (void)arm_size; (void)arm_start;
+}
+
+of_node_t *dt_find_node(char *key) { (void)key; return NULL; }
+void dt_add_property(of_node_t *node, const char *propname, const void *propvalue, uint32_t proplen)
+{
+    (void)node; (void)propname; (void)propvalue; (void)proplen;
+}
+
+uintptr_t mmu_virt2phys(uintptr_t addr) { return addr; }
+int mmu_protect_page(uintptr_t virt, int read_only) { (void)virt; (void)read_only; return 0; }
+
+#if EMU68_M68K_MMU
+/* JC2F_M68K_MMU is never set here */
+uint8_t m68k_mmu_enabled;
+void M68K_MMUUpdate(uint32_t unused, uint32_t unused2) { (void)unused; (void)unused2; abort(); }
+void M68K_MMUFlush(uint32_t address, uint32_t opmode) { (void)address; (void)opmode; abort(); }
+void M68K_MMUTest(uint32_t address, uint32_t write) { (void)address; (void)write; abort(); }
+uint32_t *EMIT_MMUCall(uint32_t *ptr, void (*func)(uint32_t, uint32_t), uint8_t reg, uint32_t arg)
+{
+    (void)func; (void)reg; (void)arg;
+    return ptr;
+}
+#endif
+
+static void fault_handler(int sig)
+{
+    fprintf(stderr, "[JIT] Signal %d while translating m68k code at %08x\n", sig, current_pc);
+    _Exit(1);
+}
+
+static uint64_t time_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *map_pool(uintptr_t hint, size_t size)
+{
+    void *pool = mmap((void *)hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    return pool == MAP_FAILED ? NULL : pool;
+}
+
+static int load_image(const char *name, uint32_t base)
+{
+    FILE *f = fopen(name, "rb");
+    long size;
+    void *mem;
+
+    if (f == NULL)
+    {
+        perror(name);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (base == 0)
+    {
+        if (size == 512*1024)
+            base = 0x00f80000;
+        else if (size == 256*1024)
+            base = 0x00fc0000;
+        else
+            base = 0x00200000;
+    }
+
+    if (size <= 0 || (uint64_t)base + size + IMAGE_PAD > 0xffffffffULL || (base & 4095))
+    {
+        fprintf(stderr, "%s: image of %ld bytes does not fit at %08x\n", name, size, base);
+        fclose(f);
+        return -1;
+    }
+
+    mem = mmap((void *)(uintptr_t)base, size + IMAGE_PAD, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (mem != (void *)(uintptr_t)base)
+    {
+        fprintf(stderr, "cannot map the image at %08x, try another base\n", base);
+        fclose(f);
+        return -1;
+    }
+
+    if (fread(mem, 1, size, f) != (size_t)size)
+    {
+        perror(name);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    /* Read-only from now on, the translator may not write to it */
+    mprotect(mem, size + IMAGE_PAD, PROT_READ);
+
+    image_base = base;
+    image_end = base + size;
+
+    return 0;
+}
+
+struct PassResult {
+    uint32_t    units;
+    uint32_t    m68k;
+    uint32_t    arm;
+};
+
+static void translate_one(uint32_t pc, struct PassResult *res, uint32_t *next)
+{
+    struct M68KTranslationUnit *unit;
+
+    current_pc = pc;
+    unit = M68K_GetTranslationUnit((uint16_t *)(uintptr_t)pc);
+
+    res->units++;
+    res->m68k += unit->mt_Info->mi_M68kInsnCnt;
+    res->arm += unit->mt_Info->mi_ARMInsnCnt;
+
+    if (next)
+    {
+        uint32_t high = (uint32_t)(uintptr_t)unit->mt_M68kHigh;
+
+        *next = (high > pc) ? ((high + 1) & ~1) : pc + 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t base = 0;
+    uint32_t entries[MAX_ENTRIES];
+    int entry_count = 0;
+    int passes = 10;
+    int depth = EMU68_M68K_INSN_DEPTH;
+    int stats = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:i:e:rs")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                base = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                passes = atoi(optarg);
+                break;
+            case 'i':
+                depth = atoi(optarg);
+                break;
+            case 'e':
+                if (entry_count < MAX_ENTRIES)
+                    entries[entry_count++] = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                jit_report = 1;
+                break;
+            case 's':
+                stats = 1;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-b base] [-n passes] [-i depth] [-e entry]... [-r] [-s] image\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc || passes < 1 || depth < 1)
+    {
+        fprintf(stderr, "usage: %s [-b base] [-n passes] [-i depth] [-e entry]... [-r] [-s] image\n", argv[0]);
+        return 1;
+    }
+
+    if (load_image(argv[optind], base))
+        return 1;
+
+    void *data_pool = map_pool(0, DATA_POOL_SIZE);
+    void *jit_pool = map_pool(JIT_POOL_HINT, JIT_POOL_SIZE);
+
+    if (data_pool == NULL || jit_pool == NULL || ((uintptr_t)jit_pool + JIT_POOL_SIZE) > 0x0000001000000000ULL)
+    {
+        fprintf(stderr, "cannot map memory pools\n");
+        return 1;
+    }
+
+    tlsf = tlsf_init_with_memory(data_pool, DATA_POOL_SIZE);
+    jit_tlsf = tlsf_init_with_memory(jit_pool, JIT_POOL_SIZE);
+
+#if SET_FEATURES_AT_RUNTIME
+    Features.ARM_SUPPORTS_LSE = (getauxval(AT_HWCAP) & HWCAP_ATOMICS) != 0;
+#endif
+
+    signal(SIGSEGV, fault_handler);
+    signal(SIGBUS, fault_handler);
+    signal(SIGILL, fault_handler);
+
+    __m68k_state = &m68k_state;
+
+    JITStats_Init();
+    M68K_InitializeCache();
+
+    m68k_state.JIT_CACHE_TOTAL = M68K_GetCacheTotal();
+    m68k_state.JIT_CACHE_FREE = M68K_GetCacheFree();
+    m68k_state.JIT_CACHE_PINNED = M68K_GetCachePinned();
+    m68k_state.JIT_UNIT_COUNT = 0;
+    m68k_state.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
+    m68k_state.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
+    m68k_state.JIT_CONTROL |= (depth & JCCB_INSN_DEPTH_MASK) << JCCB_INSN_DEPTH;
+    m68k_state.JIT_CONTROL |= (EMU68_BRANCH_INLINE_DISTANCE & JCCB_INLINE_RANGE_MASK) << JCCB_INLINE_RANGE;
+    m68k_state.JIT_CONTROL |= (EMU68_MAX_LOOP_COUNT & JCCB_LOOP_COUNT_MASK) << JCCB_LOOP_COUNT;
+    /* CCR scan depth as set up by the PiStorm builds */
+    m68k_state.JIT_CONTROL2 = EMU68_CCR_SCAN_DEPTH << JC2B_CCR_SCAN_DEPTH;
+
+    kprintf("[JIT] Image %s at %08x-%08x, %d passes, %s\n", argv[optind], image_base, image_end - 1,
+        passes, entry_count ? "entry points" : "sweep");
+
+    struct PassResult total = { 0, 0, 0 };
+    uint64_t total_us = 0;
+    uint64_t best_us = ~0ULL;
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        struct PassResult res = { 0, 0, 0 };
+        uint64_t t0 = time_us();
+
+        if (entry_count)
+        {
+            for (int i = 0; i < entry_count; i++)
+                translate_one(entries[i], &res, NULL);
+        }
+        else
+        {
+            uint32_t pc = image_base;
+
+            while (pc < image_end)
+                translate_one(pc, &res, &pc);
+        }
+
+        uint64_t us = time_us() - t0;
+
+        total_us += us;
+        if (us < best_us)
+            best_us = us;
+
+        total.units += res.units;
+        total.m68k += res.m68k;
+        total.arm += res.arm;
+
+        if (stats && pass == passes - 1)
+            M68K_DumpStats();
+
+        /* Not part of the measured time, the next pass starts with an empty cache */
+        M68K_ReleaseRAMUnits(JS_RELEASE_CINV_ALL);
+    }
+
+    if (total_us == 0)
+        total_us = 1;
+    if (best_us == 0)
+        best_us = 1;
+
+    printf("[JIT] Host: passes=%d units=%u m68k=%u arm=%u bytes=%llu us=%llu best_us=%llu units_per_s=%llu bytes_per_s=%llu\n",
+        passes, total.units / passes, total.m68k / passes, total.arm / passes,
+        4ULL * total.arm / passes, (unsigned long long)total_us / passes, (unsigned long long)best_us,
+        (unsigned long long)total.units * 1000000 / total_us, 4ULL * total.arm * 1000000 / total_us);
+
+    return 0;
+}
@@ -0,0 +1,449 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*
+    Decoder of JIT cache snapshots. MOVEC to JITEXPORT prints the snapshot to the console as
+    [JITX] lines of hex digits, see M68K_ExportUnits. The tool picks the last complete snapshot
+    out of a captured console log, checks its length and CRC32 and lists the units ranked by
+    use count. With -d the ARM code of listed units is disassembled with Capstone, every m68k
+    instruction start from the PC map is marked in front of its ARM code.
+
+        jitexport [-s] [-d] [-n count] [-a address] log
+
+    -s  rank units by size of ARM code instead of use count
+    -d  disassemble listed units
+    -n  list given number of units only, 20 by default, 0 lists all
+    -a  list only units whose m68k range contains the address
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <capstone/capstone.h>
+
+#define JIT_EXPORT_VERSION  1
+#define UNIT_HEADER         68
+
+#if CS_API_MAJOR >= 6
+#define CS_ARCH_AARCH64_HOST CS_ARCH_AARCH64
+#else
+#define CS_ARCH_AARCH64_HOST CS_ARCH_ARM64
+#endif
+
+struct Unit {
+    uint32_t        u_Entry;
+    uint32_t        u_Low;
+    uint32_t        u_High;
+    uint32_t        u_Tier;
+    uint32_t        u_M68kInsnCnt;
+    uint32_t        u_ARMInsnCnt;
+    uint32_t        u_PrologueSize;
+    uint32_t        u_EpilogueSize;
+    uint32_t        u_Exits;
+    uint64_t        u_UseCount;
+    uint64_t        u_FetchCount;
+    uint64_t        u_ARMAddress;
+    uint32_t        u_PCMapSize;
+    const uint8_t * u_ARMCode;
+    const uint8_t * u_PCMap;
+};
+
+static uint8_t *stream;
+static uint32_t stream_size;
+static uint32_t stream_alloc;
+
+static int by_size;
+
+static uint32_t crc32(const uint8_t *p, uint32_t size)
+{
+    uint32_t crc = 0xffffffff;
+
+    /* Same as crc32b of the ARM, no final inversion */
+    while (size--)
+    {
+        crc ^= *p++;
+        for (int i=0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+
+    return crc;
+}
+
+static void append(uint8_t b)
+{
+    if (stream_size == stream_alloc)
+    {
+        stream_alloc = stream_alloc ? 2 * stream_alloc : 65536;
+        stream = realloc(stream, stream_alloc);
+        if (stream == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    stream[stream_size++] = b;
+}
+
+static int hexdigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+    Collect the stream of the last complete snapshot. Other console output may be interleaved
+    with the snapshot, only lines with [JITX] tag are looked at. Returns 0 if no snapshot
+    with matching length and CRC was found
+*/
+static int read_log(FILE *f)
+{
+    char line[4096];
+    int inside = 0;
+    int found = 0;
+    uint8_t *good = NULL;
+    uint32_t good_size = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char *p = strstr(line, "[JITX] ");
+        uint32_t size, crc;
+
+        if (p == NULL)
+            continue;
+        p += 7;
+
+        if (strncmp(p, "BEGIN", 5) == 0)
+        {
+            inside = 1;
+            stream_size = 0;
+        }
+        else if (sscanf(p, "END %u bytes crc %x", &size, &crc) == 2)
+        {
+            if (!inside)
+                continue;
+            inside = 0;
+
+            if (size != stream_size || crc != crc32(stream, stream_size))
+            {
+                fprintf(stderr, "Snapshot of %u bytes is damaged, skipped\n", size);
+                continue;
+            }
+
+            free(good);
+            good = malloc(stream_size);
+            if (good == NULL)
+            {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+            memcpy(good, stream, stream_size);
+            good_size = stream_size;
+            found++;
+        }
+        else if (inside)
+        {
+            while (hexdigit(p[0]) >= 0 && hexdigit(p[1]) >= 0)
+            {
+                append((hexdigit(p[0]) << 4) | hexdigit(p[1]));
+                p += 2;
+            }
+        }
+    }
+
+    free(stream);
+    stream = good;
+    stream_size = good_size;
+
+    return found;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+    return ((uint64_t)get32(p) << 32) | get32(p + 4);
+}
+
+static const uint8_t *get_varint(const uint8_t *p, uint32_t *value)
+{
+    uint32_t v = 0;
+    int shift = 0;
+
+    do {
+        v |= (uint32_t)(*p & 0x7f) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+
+    *value = v;
+
+    return p;
+}
+
+static struct Unit *parse(uint32_t *count, uint32_t *min_uses)
+{
+    const uint8_t *p = stream + 16;
+    const uint8_t *end = stream + stream_size;
+    struct Unit *units;
+
+    if (stream_size < 16 || memcmp(stream, "E68J", 4) != 0)
+    {
+        fprintf(stderr, "Not a JIT snapshot\n");
+        return NULL;
+    }
+
+    if (get32(stream + 4) != JIT_EXPORT_VERSION)
+    {
+        fprintf(stderr, "Snapshot version %u is not supported\n", get32(stream + 4));
+        return NULL;
+    }
+
+    *count = get32(stream + 8);
+    *min_uses = get32(stream + 12);
+
+    units = calloc(*count ? *count : 1, sizeof(struct Unit));
+    if (units == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+
+    for (uint32_t i=0; i < *count; i++)
+    {
+        struct Unit *u = &units[i];
+        uint32_t size;
+
+        if (end - p < UNIT_HEADER || (size = get32(p)) > (uint32_t)(end - p - 4) || size < UNIT_HEADER - 4)
+        {
+            fprintf(stderr, "Snapshot is truncated at unit %u\n", i);
+            free(units);
+            return NULL;
+        }
+
+        u->u_Entry = get32(p + 4);
+        u->u_Low = get32(p + 8);
+        u->u_High = get32(p + 12);
+        u->u_Tier = get32(p + 16);
+        u->u_M68kInsnCnt = get32(p + 20);
+        u->u_ARMInsnCnt = get32(p + 24);
+        u->u_PrologueSize = get32(p + 28);
+        u->u_EpilogueSize = get32(p + 32);
+        u->u_Exits = get32(p + 36);
+        u->u_UseCount = get64(p + 40);
+        u->u_FetchCount = get64(p + 48);
+        u->u_ARMAddress = get64(p + 56);
+        u->u_PCMapSize = get32(p + 64);
+        u->u_ARMCode = p + UNIT_HEADER;
+        u->u_PCMap = u->u_ARMCode + 4 * u->u_ARMInsnCnt;
+
+        if (UNIT_HEADER - 4 + 4 * u->u_ARMInsnCnt + u->u_PCMapSize > size)
+        {
+            fprintf(stderr, "Unit %u is damaged\n", i);
+            free(units);
+            return NULL;
+        }
+
+        p += 4 + size;
+    }
+
+    return units;
+}
+
+static int compare(const void *a, const void *b)
+{
+    const struct Unit *ua = a;
+    const struct Unit *ub = b;
+
+    if (by_size && ua->u_ARMInsnCnt != ub->u_ARMInsnCnt)
+        return ua->u_ARMInsnCnt < ub->u_ARMInsnCnt ? 1 : -1;
+    if (ua->u_UseCount != ub->u_UseCount)
+        return ua->u_UseCount < ub->u_UseCount ? 1 : -1;
+    return ua->u_Entry < ub->u_Entry ? -1 : ua->u_Entry > ub->u_Entry;
+}
+
+static void disassemble(csh handle, const struct Unit *u)
+{
+    const uint8_t *map = u->u_PCMap;
+    const uint8_t *map_end = u->u_PCMap + u->u_PCMapSize;
+    uint32_t next_offset = 0;
+    uint32_t m68k_pc = u->u_Entry;
+    int have_next = 0;
+    cs_insn *insn = cs_malloc(handle);
+
+    /* Entries of PC map are deltas of ARM offset and zig-zag deltas of m68k PC in words */
+    if (map < map_end)
+    {
+        uint32_t d, z;
+        map = get_varint(map, &d);
+        map = get_varint(map, &z);
+        next_offset = d;
+        m68k_pc += 2 * (int32_t)((z >> 1) ^ -(z & 1));
+        have_next = 1;
+    }
+
+    for (uint32_t i=0; i < u->u_ARMInsnCnt; i++)
+    {
+        const uint8_t *code = u->u_ARMCode + 4 * i;
+        size_t size = 4;
+        uint64_t address = u->u_ARMAddress + 4 * i;
+
+        if (i == 0)
+            printf("        ; prologue\n");
+        if (i == u->u_PrologueSize && u->u_PrologueSize)
+            printf("        ; body\n");
+        if (i == u->u_ARMInsnCnt - u->u_EpilogueSize && u->u_EpilogueSize)
+            printf("        ; epilogue\n");
+
+        while (have_next && next_offset == i)
+        {
+            printf("    %08x:\n", m68k_pc);
+
+            have_next = 0;
+            if (map < map_end)
+            {
+                uint32_t d, z;
+                map = get_varint(map, &d);
+                map = get_varint(map, &z);
+                next_offset += d;
+                m68k_pc += 2 * (int32_t)((z >> 1) ^ -(z & 1));
+                have_next = 1;
+            }
+        }
+
+        if (cs_disasm_iter(handle, &code, &size, &address, insn))
+            printf("        %010llx  %02x%02x%02x%02x  %-8s %s\n", (unsigned long long)(u->u_ARMAddress + 4 * i),
+                u->u_ARMCode[4*i+3], u->u_ARMCode[4*i+2], u->u_ARMCode[4*i+1], u->u_ARMCode[4*i],
+                insn->mnemonic, insn->op_str);
+        else
+            printf("        %010llx  %02x%02x%02x%02x  .inst\n", (unsigned long long)(u->u_ARMAddress + 4 * i),
+                u->u_ARMCode[4*i+3], u->u_ARMCode[4*i+2], u->u_ARMCode[4*i+1], u->u_ARMCode[4*i]);
+    }
+
+    cs_free(insn, 1);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s] [-d] [-n count] [-a address] log\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int disasm = 0;
+    uint32_t limit = 20;
+    uint32_t address = 0;
+    int have_address = 0;
+    uint32_t count, min_uses, listed = 0;
+    uint64_t total_uses = 0, total_arm = 0;
+    struct Unit *units;
+    csh handle = 0;
+    FILE *f;
+    int c;
+
+    while ((c = getopt(argc, argv, "sdn:a:")) != -1)
+    {
+        switch (c)
+        {
+            case 's':
+                by_size = 1;
+                break;
+            case 'd':
+                disasm = 1;
+                break;
+            case 'n':
+                limit = strtoul(optarg, NULL, 0);
+                break;
+            case 'a':
+                address = strtoul(optarg, NULL, 16);
+                have_address = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (optind != argc - 1)
+        usage(argv[0]);
+
+    f = fopen(argv[optind], "r");
+    if (f == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if (!read_log(f))
+    {
+        fprintf(stderr, "No complete JIT snapshot in %s\n", argv[optind]);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    units = parse(&count, &min_uses);
+    if (units == NULL)
+        return 1;
+
+    if (disasm && cs_open(CS_ARCH_AARCH64_HOST, CS_MODE_LITTLE_ENDIAN, &handle) != CS_ERR_OK)
+    {
+        fprintf(stderr, "Capstone has no AArch64 support\n");
+        return 1;
+    }
+
+    qsort(units, count, sizeof(struct Unit), compare);
+
+    for (uint32_t i=0; i < count; i++)
+    {
+        total_uses += units[i].u_UseCount;
+        total_arm += units[i].u_ARMInsnCnt;
+    }
+
+    printf("%u units used at least %u times, %llu uses, %llu ARM instructions\n\n", count, min_uses,
+        (unsigned long long)total_uses, (unsigned long long)total_arm);
+    printf(" rank  entry     m68k range         tier  m68k   ARM  exits          uses  share       fetches\n");
+
+    for (uint32_t i=0; i < count && (limit == 0 || listed < limit); i++)
+    {
+        const struct Unit *u = &units[i];
+
+        if (have_address && (address < u->u_Low || address >= u->u_High))
+            continue;
+
+        printf("%5u  %08x  %08x-%08x  %4u  %4u  %4u  %5u  %12llu  %4.1f%%  %12llu\n", i + 1, u->u_Entry,
+            u->u_Low, u->u_High, u->u_Tier, u->u_M68kInsnCnt, u->u_ARMInsnCnt, u->u_Exits,
+            (unsigned long long)u->u_UseCount, total_uses ? 100.0 * u->u_UseCount / total_uses : 0.0,
+            (unsigned long long)u->u_FetchCount);
+
+        if (disasm)
+        {
+            disassemble(handle, u);
+            printf("\n");
+        }
+
+        listed++;
+    }
+
+    if (disasm)
+        cs_close(&handle);
+
+    free(units);
+    free(stream);
+
+    return 0;
+}